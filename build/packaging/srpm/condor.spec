@@ -1150,6 +1150,7 @@ rm -rf %{buildroot}
 %_mandir/man1/condor_chirp.1.gz
 %_mandir/man1/condor_cod.1.gz
 %_mandir/man1/condor_config_val.1.gz
+%_mandir/man1/condor_convert_classad_log.1.gz
 %_mandir/man1/condor_convert_history.1.gz
 %_mandir/man1/condor_dagman.1.gz
 %_mandir/man1/condor_fetchlog.1.gz
@@ -1281,6 +1282,7 @@ rm -rf %{buildroot}
 %_sbindir/condor_c-gahp
 %_sbindir/condor_c-gahp_worker_thread
 %_sbindir/condor_collector
+%_sbindir/condor_convert_classad_log
 %_sbindir/condor_convert_history
 %_sbindir/condor_credd
 %_sbindir/condor_fetchlog
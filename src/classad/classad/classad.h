@@ -834,6 +834,7 @@ class ClassAd : public ExprTree
 		friend 	class ExprTree;
 		friend 	class EvalState;
 		friend 	class ClassAdIterator;
+		friend 	class CompiledExpr;
 
 
 		bool _GetExternalReferences( const ExprTree *, const ClassAd *, 
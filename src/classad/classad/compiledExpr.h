@@ -0,0 +1,136 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2019, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+
+#ifndef __CLASSAD_COMPILED_EXPR_H__
+#define __CLASSAD_COMPILED_EXPR_H__
+
+#include <string>
+#include <vector>
+#include "classad/exprTree.h"
+
+namespace classad {
+
+/** A flattened form of an expression tree, for expressions that are
+	evaluated over and over against different ads, such as a job's
+	Requirements during matchmaking or a query constraint.
+	<p>
+	Compile() turns the operators, attribute references and literals of
+	the tree into a linear program for a small value stack, so evaluation
+	does not recurse through virtual calls for every node, literals are
+	not copied out of the tree, and the && || and ?: short cuts are
+	plain jumps.  Function calls, lists and nested ClassAds are kept
+	as references to the original nodes and evaluated by them.
+	<p>
+	Evaluate() gives exactly the same result as ExprTree::Evaluate() on
+	the compiled tree.  The ad named on the left of a '.', such as
+	TARGET in TARGET.Memory, is looked up once per evaluation rather
+	than once per reference.  The tree must not be deleted or modified while
+	the CompiledExpr is in use.  Evaluate() does not modify the program,
+	so several threads may evaluate the same CompiledExpr concurrently.
+*/
+class CompiledExpr
+{
+	public:
+		CompiledExpr();
+		~CompiledExpr();
+
+		/** Compile an expression.
+			@param tree The expression; it is referenced, not copied.
+			@return true on success.  Expressions containing ClassAd
+				literals are not compiled, because evaluating those
+				depends on the parent scope of the tree.
+		*/
+		bool Compile( const ExprTree *tree );
+
+		/// Discard the program
+		void Clear();
+
+		/// True if Compile() succeeded
+		bool IsCompiled() const { return tree != NULL; }
+
+		/// The expression that was compiled
+		const ExprTree *GetTree() const { return tree; }
+
+		/** Evaluate the program.  Same as ExprTree::Evaluate(state, val)
+			on the compiled tree.
+			@param state The current evaluation state
+			@param val The result of the evaluation
+			@return false if evaluation failed
+		*/
+		bool Evaluate( EvalState &state, Value &val ) const;
+
+		/** Evaluate the program in the scope of an ad.  Same as
+			scope->EvaluateExpr(tree, val) on the compiled tree.
+		*/
+		bool Evaluate( const ClassAd *scope, Value &val ) const;
+
+		/// Number of instructions in the program, for debugging
+		int Size() const { return (int)code.size(); }
+
+	private:
+		enum OpCode {
+			PUSH_CONST,		// push consts[arg]
+			EVAL_TREE,		// push result of node->Evaluate()
+			LOAD_ATTR,		// push value of attribute names[arg], arg2 is absolute flag
+			LOAD_SCOPE,		// LOAD_ATTR of the ad on the left of a '.', the
+							// ad found is kept in scopes[arg2] for the rest
+							// of the evaluation
+			SELECT_ATTR,	// replace top ad with its attribute names[arg]
+			UNARY_OP,		// apply operator arg2 to top
+			BINARY_OP,		// apply operator arg2 to the top two values
+			AND_JUMP,		// if top is false, jump to arg
+			OR_JUMP,		// if top is true, jump to arg
+			TERNARY_JUMP,	// pop condition, if false jump to arg,
+							// if not a boolean evaluate node and jump to arg2
+			JUMP			// jump to arg
+		};
+
+		struct Instruction {
+			OpCode op;
+			int arg;
+			int arg2;
+			const ExprTree *node;
+		};
+
+		bool _Compile( const ExprTree *tree, int depth );
+		int nameIndex( const std::string &name );
+		int emit( OpCode op, int arg, int arg2, const ExprTree *node );
+		bool run( EvalState &state, Value *stack, Value &val ) const;
+		bool loadAttr( const Instruction &ins, EvalState &state, Value &val ) const;
+		static bool evalLookup( int rc, ExprTree *found, const ClassAd *curAd,
+								EvalState &state, Value &val );
+		static bool containsClassAd( const ExprTree *tree );
+
+			// no copying; the program refers to nodes of the tree
+		CompiledExpr( const CompiledExpr & );
+		CompiledExpr &operator=( const CompiledExpr & );
+
+		const ExprTree *tree;
+		std::vector<Instruction> code;
+		std::vector<Value> consts;
+		std::vector<std::string> names;
+		std::vector<int> scope_slots;	// for each name, its slot in scopes or -1
+		int num_scopes;
+		int max_stack;
+};
+
+} // classad
+
+#endif//__CLASSAD_COMPILED_EXPR_H__
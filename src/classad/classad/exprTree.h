@@ -208,6 +208,7 @@ class ExprTree
 		friend class ExprListIterator;
 		friend class ClassAd;
 		friend class CachedExprEnvelope;
+		friend class CompiledExpr;
 
 		/// Copy constructor
         ExprTree(const ExprTree &tree);
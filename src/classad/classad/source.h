@@ -46,6 +46,17 @@ class ClassAdParser
 		void SetOldClassAd( bool old_syntax );
 		bool GetOldClassAd() const;
 
+		/** Keep the errors of this parser to itself rather than setting
+			CondorErrMsg and CondorErrno, which all threads share, so that
+			parsers can be used by several threads at once.
+			@param private_errors Whether to keep the errors private.
+		*/
+		void SetPrivateErrors( bool private_errors );
+		/** The last error of a parser that keeps its errors private.
+			@return the message, or an empty string
+		*/
+		const std::string &GetErrorMessage() const { return errorMessage; }
+
 		/** Parse a ClassAd 
 			@param buffer Buffer containing the string representation of the
 				classad.
@@ -126,6 +137,10 @@ class ClassAdParser
 		Lexer	lexer;
 
 		bool oldClassAd;
+		bool privateErrors;
+		std::string errorMessage;
+
+		void setParseError( const std::string &msg );
 
 		// mutually recursive parsing functions
 		bool parseExpression( ExprTree*&, bool=false);
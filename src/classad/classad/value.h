@@ -384,7 +384,7 @@ class Value
 				break;
 
 			case STRING_VALUE:
-				delete strValue;
+				if ( ! _IsSmallString()) { delete strValue; }
 				break;
 
 			case ABSOLUTE_TIME_VALUE:
@@ -407,6 +407,25 @@ class Value
 		friend class ClassAd;
 		friend class ExprTree;
 
+			// Short strings are stored in smallStrValue rather than in
+			// a separately allocated std::string, so that evaluating and
+			// comparing things like Arch, OpSys and Owner never calls
+			// malloc.  The last byte of smallStrValue is zero when the
+			// string is stored there, and non-zero when strValue is used.
+			// Strings with embedded NUL characters always use strValue.
+		enum {
+			SMALL_STRING_SIZE = 16,
+			SMALL_STRING_MAX = SMALL_STRING_SIZE - 2
+		};
+		bool _IsSmallString() const { return smallStrValue[SMALL_STRING_SIZE-1] == 0; }
+		const char *_StringData() const {
+			return _IsSmallString() ? smallStrValue : strValue->c_str();
+		}
+		size_t _StringSize() const {
+			return _IsSmallString() ? strlen(smallStrValue) : strValue->size();
+		}
+		void _SetString( const char *str, size_t cch );
+
 		union {
 			bool			booleanValue;
 			long long		integerValue;
@@ -418,6 +437,7 @@ class Value
 			double			relTimeValueSecs;
 			abstime_t		*absTimeValueSecs;
 			std::string		*strValue;
+			char			smallStrValue[SMALL_STRING_SIZE];
 		};
 
 		ValueType 		valueType;	// the type of the value
@@ -533,7 +553,7 @@ IsStringValue( const char *&s ) const
 	// So it best to only touch it if it exists.
 	// (Example: the strcat classad function)
 	if (valueType == STRING_VALUE) {
-		s = strValue->c_str( );
+		s = _StringData( );
 		return true;
 	} else {
 		return false;
@@ -544,7 +564,7 @@ inline bool Value::
 IsStringValue( char *s, int len ) const
 {
 	if( valueType == STRING_VALUE ) {
-		strncpy( s, strValue->c_str( ), len );
+		strncpy( s, _StringData( ), len );
 		if( s && len && s[len-1] ) s[len-1] = '\0';
 		return( true );
 	}
@@ -555,7 +575,11 @@ inline bool Value::
 IsStringValue( std::string &s ) const
 {
 	if ( valueType == STRING_VALUE ) {
-		s = *strValue;
+		if ( _IsSmallString( ) ) {
+			s = smallStrValue;
+		} else {
+			s = *strValue;
+		}
 		return true;
 	} else {
 		return false;
@@ -566,7 +590,7 @@ inline bool Value::
 IsStringValue( int &size ) const
 {
     if (valueType == STRING_VALUE) {
-        size = (int)strValue->size();
+        size = (int)_StringSize();
         return true;
     } else {
         size = -1;
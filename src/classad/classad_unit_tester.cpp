@@ -64,6 +64,7 @@ public:
     bool  check_operator;
     bool  check_collection;
     bool  check_utils;
+    bool  check_compiled;
 	void  ParseCommandLine(int argc, char **argv);
 };
 
@@ -96,6 +97,7 @@ static void test_exprlist(const Parameters &parameters, Results &results);
 static void test_value(const Parameters &parameters, Results &results);
 static void test_collection(const Parameters &parameters, Results &results);
 static void test_utils(const Parameters &parameters, Results &results);
+static void test_compiled(const Parameters &parameters, Results &results);
 static bool check_in_view(ClassAdCollection *collection, string view_name, string classad_name);
 static void print_version(void);
 
@@ -128,6 +130,7 @@ void Parameters::ParseCommandLine(
     check_operator      = false;
     check_collection    = false;
     check_utils         = false;
+    check_compiled      = false;
 
 	// Then we parse to see what the user wants. 
 	for (int arg_index = 1; arg_index < argc; arg_index++) {
@@ -174,6 +177,9 @@ void Parameters::ParseCommandLine(
             selected_test       = true;
 		} else if (!strcasecmp(argv[arg_index], "-utils")){
             check_utils         = true;
+            selected_test       = true;
+		} else if (!strcasecmp(argv[arg_index], "-compiled")){
+            check_compiled      = true;
             selected_test       = true;
 		} else {
             cout << "Unknown argument: " << argv[arg_index] << endl;
@@ -201,6 +207,7 @@ void Parameters::ParseCommandLine(
         cout << "    -operator:   test the Operator class.\n";
         cout << "    -collection: test the Collection class.\n";
         cout << "    -utils:      test little utilities.\n";
+        cout << "    -compiled:   test the CompiledExpr class.\n";
         exit(1);
     }
     if (!selected_test) {
@@ -297,6 +304,9 @@ int main(
     if (parameters.check_all || parameters.check_utils) {
         test_utils(parameters, results);
     }
+    if (parameters.check_all || parameters.check_compiled) {
+        test_compiled(parameters, results);
+    }
 
     /* ----- Report ----- */
     cout << endl;
@@ -735,6 +745,51 @@ static void test_value(const Parameters &, Results &results)
     TEST("String is 'Robert-Houdin'", (0 == strcmp(s, "Robert-Houdin")));
     TEST("GetType gives STRING_VALUE", (v.GetType() == Value::STRING_VALUE));
 
+    // Short strings are kept inside the Value and long ones are not;
+    // make sure moving between the two works in every direction.
+    string str;
+    int size = 0;
+    const char *long_str = "a string that is too long to be stored inline";
+    v.SetStringValue("short");
+    TEST("Short string", v.IsStringValue(str) && str == "short");
+    v.SetStringValue(long_str);
+    TEST("Short to long string", v.IsStringValue(str) && str == long_str);
+    v.SetStringValue("12345678901234");
+    TEST("Long to short string", v.IsStringValue(str) && str == "12345678901234");
+    v.SetStringValue("123456789012345");
+    TEST("Short to longer string", v.IsStringValue(str) && str == "123456789012345");
+    v.SetStringValue("");
+    TEST("Empty string", v.IsStringValue(size) && size == 0);
+    v.SetStringValue(string("nul\0inside", 10));
+    TEST("Embedded NUL", v.IsStringValue(str) && str == string("nul\0inside", 10));
+    TEST("Size with embedded NUL", v.IsStringValue(size) && size == 10);
+    v.SetStringValue("Robert-Houdin");
+    v.IsStringValue(s);
+    v.SetStringValue(s + 7);
+    TEST("Assign from own short string", v.IsStringValue(str) && str == "Houdin");
+    v.SetStringValue(long_str);
+    v.IsStringValue(s);
+    v.SetStringValue(s + 2);
+    TEST("Assign from own long string", v.IsStringValue(str) && str == long_str + 2);
+    v.IsStringValue(s);
+    v.SetStringValue(s + 30);
+    TEST("Assign short from own long string", v.IsStringValue(str) && str == long_str + 32);
+
+    Value v2;
+    v2.SetStringValue("LINUX");
+    v.CopyFrom(v2);
+    TEST("Copy short string", v.IsStringValue(str) && str == "LINUX");
+    TEST("Copied short string is same", v.SameAs(v2));
+    v2.SetStringValue(long_str);
+    TEST("Short and long strings differ", !v.SameAs(v2));
+    v = v2;
+    TEST("Copy long string", v.IsStringValue(str) && str == long_str);
+    TEST("Copied long string is same", v.SameAs(v2));
+    v = v;
+    TEST("Self assignment", v.IsStringValue(str) && str == long_str);
+    v.SetIntegerValue(1);
+    TEST("String to integer", v.IsIntegerValue(i) && i == 1);
+
     abstime_t at = { 10, 10 };
     v.SetAbsoluteTimeValue(at);
     at.secs = at.offset = 0;
@@ -1026,6 +1081,133 @@ static void test_utils(const Parameters &, Results &results)
     return;
 }
 
+/*********************************************************************
+ *
+ * Function: test_compiled
+ * Purpose:  Test that compiled expressions evaluate exactly like the
+ *           trees they were compiled from.
+ *
+ *********************************************************************/
+static void test_compiled(const Parameters &, Results &results)
+{
+    ClassAdParser parser;
+
+    cout << "Testing compiled expressions...\n";
+
+    const char *left_text =
+        "[ Memory = 2048; Disk = 100000; Arch = \"X86_64\"; OpSys = \"LINUX\";"
+        "  KFlops = 1000; Busy = false; Count = 3; Name = \"slot1@host\";"
+        "  Nested = [ Inner = 7; Outer = Count ]; Ads = { [ A = 1 ], [ A = 2 ] };"
+        "  Loop = Loop + 1; ]";
+    const char *right_text =
+        "[ RequestMemory = 1024; RequestDisk = 5000; Rank = Target.KFlops / 10;"
+        "  Owner = \"alice\"; Undef = undefined; Err = error; Count = 5; ]";
+
+    ClassAd *left = parser.ParseClassAd(left_text);
+    ClassAd *right = parser.ParseClassAd(right_text);
+    TEST("Parsed left ad", left != NULL);
+    TEST("Parsed right ad", right != NULL);
+    if (!left || !right) {
+        delete left;
+        delete right;
+        return;
+    }
+
+    MatchClassAd mad(left, right);
+
+    const char *exprs[] = {
+        "Memory >= RIGHT.RequestMemory && Disk >= RIGHT.RequestDisk",
+        "Arch == \"X86_64\" && OpSys == \"LINUX\"",
+        "Memory * 2 + Count - 7 / 2 % 3",
+        "-Memory + +Count",
+        "!Busy && !(Count > 2)",
+        "~Count | 4 ^ 2 & 7 << 1 >> 1 >>> 1",
+        "Busy || Count",
+        "Count && Busy",
+        "NoSuchAttr && false",
+        "NoSuchAttr || true",
+        "NoSuchAttr && true",
+        "NoSuchAttr || false",
+        "Busy ? 1 : 2",
+        "Count ? \"yes\" : \"no\"",
+        "NoSuchAttr ? 1 : 2",
+        "Owner ? 1 : 2",
+        "Owner ? 1 : error",
+        "Owner ? undefined : error",
+        "\"str\" ? Err : 3",
+        "NoSuchAttr ?: 5",
+        "((Memory))",
+        "Nested.Inner + Nested.Outer",
+        "Nested.NoSuch",
+        "Ads.A",
+        "Memory.Foo",
+        "NoSuchAttr.Foo",
+        "MY.Memory + TARGET.RequestMemory",
+        "TARGET.Rank",
+        "OTHER.Owner == \"alice\"",
+        "Count",
+        ".Count",
+        "RequestMemory",
+        "Undef =?= undefined",
+        "Err =!= error",
+        "Loop",
+        "Count < 2.5 && Count >= 3.0",
+        "\"abc\" < \"abd\" && \"ABC\" == \"abc\"",
+        "strcat(Name, \"-\", Count)",
+        "ifThenElse(Busy, 1, size(Name))",
+        "member(Count, { 1, 2, 3 })",
+        "{ 1, 2, 3 }[1]",
+        "isUndefined(NoSuchAttr) && isError(Err)",
+        "2K + 1M",
+        "Memory > 1024 ? (Disk > 1000 ? \"big\" : \"small\") : (Busy ? 3 : 4)",
+        "Busy ? 1 : (Count ? 2 : 3) + (Undef ? 4 : 5)",
+        "TARGET.Memory + target.memory + Target.Disk + TARGET.NoSuch",
+        "MY.Count + my.count * TARGET.Count - OTHER.Count",
+        "Nested.Inner + Nested.Outer * Nested.Inner",
+        "Ads.A + Ads.A",
+        "NoSuchAttr.Foo + NoSuchAttr.Bar",
+        "TARGET.Count > 2 ? TARGET.Count : MY.Count",
+        NULL
+    };
+
+    for (int i = 0; exprs[i]; i++) {
+        ExprTree *tree = parser.ParseExpression(exprs[i]);
+        TEST("Parsed expression", tree != NULL);
+        if (!tree) {
+            continue;
+        }
+
+        CompiledExpr compiled;
+        TEST("Compiled expression", compiled.Compile(tree));
+
+        ClassAd *scopes[] = { left, right, NULL };
+        for (int j = 0; scopes[j]; j++) {
+            Value tree_val, compiled_val;
+            EvalState tree_state, compiled_state;
+            tree_state.SetScopes(scopes[j]);
+            compiled_state.SetScopes(scopes[j]);
+            bool tree_rval = tree->Evaluate(tree_state, tree_val);
+            bool compiled_rval = compiled.Evaluate(compiled_state, compiled_val);
+            bool same = (tree_rval == compiled_rval) && tree_val.SameAs(compiled_val);
+            if (!same) {
+                cout << "  mismatch for " << exprs[i] << ": " << tree_val
+                     << " vs " << compiled_val << endl;
+            }
+            TEST("Compiled evaluation matches tree evaluation", same);
+            TEST("Scope is restored", compiled_state.curAd == tree_state.curAd);
+        }
+        delete tree;
+    }
+
+    ExprTree *tree = parser.ParseExpression("[ A = 1 ].A + 1");
+    CompiledExpr compiled;
+    TEST("Nested ClassAd literal is not compiled", tree && !compiled.Compile(tree));
+    TEST("Failed compile is not compiled", !compiled.IsCompiled());
+    delete tree;
+
+    return;
+}
+
 /*********************************************************************
  *
  * Function: print_version
@@ -0,0 +1,575 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2019, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+
+#include "classad/common.h"
+#include "classad/classad.h"
+#include "classad/classadCache.h"
+#include "classad/compiledExpr.h"
+
+using namespace std;
+
+namespace classad {
+
+	// programs that need no more stack than this evaluate without
+	// touching the heap
+static const int SMALL_STACK = 16;
+
+	// how many different ads named on the left of a '.' are remembered
+	// during one evaluation
+static const int MAX_SCOPES = 8;
+
+CompiledExpr::
+CompiledExpr() : tree(NULL), num_scopes(0), max_stack(0)
+{
+}
+
+
+CompiledExpr::
+~CompiledExpr()
+{
+}
+
+
+void CompiledExpr::
+Clear()
+{
+	tree = NULL;
+	code.clear();
+	consts.clear();
+	names.clear();
+	scope_slots.clear();
+	num_scopes = 0;
+	max_stack = 0;
+}
+
+
+bool CompiledExpr::
+Compile( const ExprTree *expr )
+{
+	Clear();
+	if( !expr || containsClassAd( expr ) ) {
+		return false;
+	}
+	if( !_Compile( expr, 0 ) ) {
+		Clear();
+		return false;
+	}
+	tree = expr;
+	return true;
+}
+
+
+int CompiledExpr::
+emit( OpCode op, int arg, int arg2, const ExprTree *node )
+{
+	Instruction ins;
+	ins.op = op;
+	ins.arg = arg;
+	ins.arg2 = arg2;
+	ins.node = node;
+	code.push_back( ins );
+	return (int)code.size() - 1;
+}
+
+
+	// Attribute names are compared without regard to case, so each
+	// name is stored once no matter how it is spelled.
+int CompiledExpr::
+nameIndex( const string &name )
+{
+	for( size_t i = 0; i < names.size(); i++ ) {
+		if( strcasecmp( names[i].c_str(), name.c_str() ) == 0 ) {
+			return (int)i;
+		}
+	}
+	names.push_back( name );
+	scope_slots.push_back( -1 );
+	return (int)names.size() - 1;
+}
+
+
+	// Emit code that leaves the value of expr on top of the stack.
+	// depth is the number of values already on the stack.
+bool CompiledExpr::
+_Compile( const ExprTree *expr, int depth )
+{
+	if( !expr ) {
+		return false;
+	}
+	if( depth + 1 > max_stack ) {
+		max_stack = depth + 1;
+	}
+
+	switch( expr->GetKind( ) ) {
+		case ExprTree::LITERAL_NODE: {
+			Value val;
+			((const Literal*)expr)->GetValue( val );
+			if( val.IsListValue( ) || val.IsClassAdValue( ) ) {
+				emit( EVAL_TREE, 0, 0, expr );
+			} else {
+				consts.push_back( val );
+				emit( PUSH_CONST, (int)consts.size() - 1, 0, expr );
+			}
+			return true;
+		}
+
+		case ExprTree::ATTRREF_NODE: {
+			ExprTree *base = NULL;
+			string attr;
+			bool abs = false;
+			((const AttributeReference*)expr)->GetComponents( base, attr, abs );
+			int name = nameIndex( attr );
+			if( !base ) {
+				emit( LOAD_ATTR, name, abs, expr );
+				return true;
+			}
+
+				// the ad that MY or TARGET refer to is the same for every
+				// reference, so it only has to be looked up the first time
+			ExprTree *base_base = NULL;
+			string base_attr;
+			bool base_abs = false;
+			if( base->GetKind( ) == ExprTree::ATTRREF_NODE ) {
+				((const AttributeReference*)base)->GetComponents( base_base, base_attr, base_abs );
+			}
+			int base_name = -1;
+			if( base->GetKind( ) == ExprTree::ATTRREF_NODE && !base_base && !base_abs ) {
+				base_name = nameIndex( base_attr );
+				if( scope_slots[base_name] < 0 && num_scopes < MAX_SCOPES ) {
+					scope_slots[base_name] = num_scopes++;
+				}
+			}
+			if( base_name >= 0 && scope_slots[base_name] >= 0 ) {
+				emit( LOAD_SCOPE, base_name, scope_slots[base_name], base );
+			} else if( !_Compile( base, depth ) ) {
+				return false;
+			}
+			emit( SELECT_ATTR, name, 0, expr );
+			return true;
+		}
+
+		case ExprTree::OP_NODE: {
+			Operation::OpKind op = Operation::__NO_OP__;
+			ExprTree *t1 = NULL, *t2 = NULL, *t3 = NULL;
+			((const Operation*)expr)->GetComponents( op, t1, t2, t3 );
+
+			if( op == Operation::PARENTHESES_OP ) {
+				return _Compile( t1, depth );
+			}
+
+			if( op == Operation::TERNARY_OP ) {
+				if( !t1 || !t2 || !t3 ) {
+						// the "a ?: b" form; leave it to the tree
+					emit( EVAL_TREE, 0, 0, expr );
+					return true;
+				}
+				if( !_Compile( t1, depth ) ) {
+					return false;
+				}
+				int branch = emit( TERNARY_JUMP, 0, 0, expr );
+				if( !_Compile( t2, depth ) ) {
+					return false;
+				}
+				int skip = emit( JUMP, 0, 0, NULL );
+				code[branch].arg = (int)code.size();
+				if( !_Compile( t3, depth ) ) {
+					return false;
+				}
+				code[skip].arg = (int)code.size();
+				code[branch].arg2 = (int)code.size();
+				return true;
+			}
+
+			if( op == Operation::LOGICAL_AND_OP || op == Operation::LOGICAL_OR_OP ) {
+				if( !_Compile( t1, depth ) ) {
+					return false;
+				}
+				int branch = emit( op == Operation::LOGICAL_AND_OP ? AND_JUMP : OR_JUMP,
+								   0, 0, NULL );
+				if( !_Compile( t2, depth + 1 ) ) {
+					return false;
+				}
+				emit( BINARY_OP, 0, op, expr );
+				code[branch].arg = (int)code.size();
+				return true;
+			}
+
+			if( t1 && t2 && !t3 ) {
+				if( !_Compile( t1, depth ) || !_Compile( t2, depth + 1 ) ) {
+					return false;
+				}
+				emit( BINARY_OP, 0, op, expr );
+				return true;
+			}
+
+			if( t1 && !t2 && !t3 ) {
+				if( !_Compile( t1, depth ) ) {
+					return false;
+				}
+				emit( UNARY_OP, 0, op, expr );
+				return true;
+			}
+
+			emit( EVAL_TREE, 0, 0, expr );
+			return true;
+		}
+
+		case ExprTree::EXPR_ENVELOPE: {
+			const ExprTree *inner = ((const CachedExprEnvelope*)expr)->get( );
+			if( !inner ) {
+				emit( EVAL_TREE, 0, 0, expr );
+				return true;
+			}
+			return _Compile( inner, depth );
+		}
+
+		case ExprTree::FN_CALL_NODE:
+		case ExprTree::EXPR_LIST_NODE:
+		default:
+			emit( EVAL_TREE, 0, 0, expr );
+			return true;
+	}
+}
+
+
+bool CompiledExpr::
+containsClassAd( const ExprTree *expr )
+{
+	if( !expr ) {
+		return false;
+	}
+
+	switch( expr->GetKind( ) ) {
+		case ExprTree::LITERAL_NODE: {
+			Value val;
+			((const Literal*)expr)->GetValue( val );
+			return val.IsClassAdValue( ) || val.IsListValue( );
+		}
+
+		case ExprTree::ATTRREF_NODE: {
+			ExprTree *base = NULL;
+			string attr;
+			bool abs = false;
+			((const AttributeReference*)expr)->GetComponents( base, attr, abs );
+			return containsClassAd( base );
+		}
+
+		case ExprTree::OP_NODE: {
+			Operation::OpKind op = Operation::__NO_OP__;
+			ExprTree *t1 = NULL, *t2 = NULL, *t3 = NULL;
+			((const Operation*)expr)->GetComponents( op, t1, t2, t3 );
+			return containsClassAd( t1 ) || containsClassAd( t2 ) ||
+				containsClassAd( t3 );
+		}
+
+		case ExprTree::FN_CALL_NODE: {
+			string name;
+			vector<ExprTree*> args;
+			((const FunctionCall*)expr)->GetComponents( name, args );
+			for( size_t i = 0; i < args.size(); i++ ) {
+				if( containsClassAd( args[i] ) ) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		case ExprTree::EXPR_LIST_NODE: {
+			vector<ExprTree*> exprs;
+			((const ExprList*)expr)->GetComponents( exprs );
+			for( size_t i = 0; i < exprs.size(); i++ ) {
+				if( containsClassAd( exprs[i] ) ) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+		case ExprTree::EXPR_ENVELOPE:
+			return containsClassAd( ((const CachedExprEnvelope*)expr)->get( ) );
+
+		case ExprTree::CLASSAD_NODE:
+		default:
+			return true;
+	}
+}
+
+
+bool CompiledExpr::
+Evaluate( EvalState &state, Value &val ) const
+{
+	if( !tree ) {
+		val.SetErrorValue( );
+		return false;
+	}
+
+		// the tree knows how to print each step
+	if( state.debug ) {
+		return tree->Evaluate( state, val );
+	}
+
+	if( max_stack <= SMALL_STACK ) {
+		Value stack[SMALL_STACK];
+		return run( state, stack, val );
+	}
+	vector<Value> stack( max_stack );
+	return run( state, &stack[0], val );
+}
+
+
+bool CompiledExpr::
+Evaluate( const ClassAd *scope, Value &val ) const
+{
+	EvalState state;
+	state.SetScopes( scope );
+	return Evaluate( state, val );
+}
+
+
+	// Finish an attribute lookup the way AttributeReference::_Evaluate()
+	// does: evaluate what was found in the scope it was found in, then
+	// return to the scope we started from.
+bool CompiledExpr::
+evalLookup( int rc, ExprTree *found, const ClassAd *curAd, EvalState &state,
+			Value &val )
+{
+	switch( rc ) {
+		case ExprTree::EVAL_OK: {
+			if( state.depth_remaining <= 0 ) {
+				val.SetErrorValue( );
+				state.curAd = curAd;
+				return false;
+			}
+				// most attributes are literals, which need no evaluation
+			if( found->GetKind( ) == ExprTree::LITERAL_NODE ) {
+				((const Literal*)found)->GetValue( val );
+				state.curAd = curAd;
+				return true;
+			}
+			state.depth_remaining--;
+			bool rval = found->Evaluate( state, val );
+			state.depth_remaining++;
+			state.curAd = curAd;
+			return rval;
+		}
+		case ExprTree::EVAL_UNDEF:
+			val.SetUndefinedValue( );
+			state.curAd = curAd;
+			return true;
+		case ExprTree::EVAL_ERROR:
+			val.SetErrorValue( );
+			state.curAd = curAd;
+			return true;
+		case ExprTree::EVAL_FAIL:
+		default:
+			return false;
+	}
+}
+
+
+	// Push the value of an attribute the way AttributeReference::_Evaluate()
+	// does for a reference with no ad on the left of the '.'.
+bool CompiledExpr::
+loadAttr( const Instruction &ins, EvalState &state, Value &val ) const
+{
+	const ClassAd *curAd = state.curAd;
+	bool absolute = ins.op == LOAD_ATTR && ins.arg2;
+	const ClassAd *current = absolute ? state.rootAd : state.curAd;
+	ExprTree *found = NULL;
+	int rc;
+	if( absolute && !current ) {
+		rc = ExprTree::EVAL_FAIL;
+	} else if( !current ) {
+		rc = ExprTree::EVAL_UNDEF;
+	} else {
+		rc = current->LookupInScope( names[ins.arg], found, state );
+		if( !absolute && rc == ExprTree::EVAL_UNDEF && current->alternateScope ) {
+			rc = current->alternateScope->LookupInScope( names[ins.arg],
+														 found, state );
+		}
+	}
+	return evalLookup( rc, found, curAd, state, val );
+}
+
+
+bool CompiledExpr::
+run( EvalState &state, Value *stack, Value &val ) const
+{
+	int sp = 0;
+	size_t pc = 0;
+	size_t end = code.size( );
+	Value result, dummy;
+	bool b;
+	ClassAd *scopes[MAX_SCOPES];
+
+	for( int i = 0; i < num_scopes; i++ ) {
+		scopes[i] = NULL;
+	}
+
+	while( pc < end ) {
+		const Instruction &ins = code[pc++];
+		switch( ins.op ) {
+			case PUSH_CONST:
+				stack[sp++].CopyFrom( consts[ins.arg] );
+				break;
+
+			case EVAL_TREE:
+				if( !ins.node->Evaluate( state, stack[sp] ) ) {
+					val.SetErrorValue( );
+					return false;
+				}
+				sp++;
+				break;
+
+			case LOAD_ATTR:
+				if( !loadAttr( ins, state, stack[sp] ) ) {
+					val.SetErrorValue( );
+					return false;
+				}
+				sp++;
+				break;
+
+			case LOAD_SCOPE: {
+					// state.curAd is the same every time we get here, so
+					// the name refers to the same ad every time
+				ClassAd *ad = scopes[ins.arg2];
+				if( ad ) {
+					stack[sp++].SetClassAdValue( ad );
+					break;
+				}
+				if( !loadAttr( ins, state, stack[sp] ) ) {
+					val.SetErrorValue( );
+					return false;
+				}
+					// an ad made up by a function call is not kept
+				if( stack[sp].GetType( ) == Value::CLASSAD_VALUE &&
+					stack[sp].IsClassAdValue( ad ) ) {
+					scopes[ins.arg2] = ad;
+				}
+				sp++;
+				break;
+			}
+
+			case SELECT_ATTR: {
+				Value &top = stack[sp-1];
+				ClassAd *ad = NULL;
+				if( top.IsUndefinedValue( ) || top.IsErrorValue( ) ) {
+					break;
+				}
+				if( top.IsClassAdValue( ad ) ) {
+						// top may own the ad, keep it alive while we
+						// evaluate into top
+					Value base;
+					base.CopyFrom( top );
+					const ClassAd *curAd = state.curAd;
+					ExprTree *found = NULL;
+					int rc = ad->LookupInScope( names[ins.arg], found, state );
+					if( !evalLookup( rc, found, curAd, state, top ) ) {
+						val.SetErrorValue( );
+						return false;
+					}
+				} else if( top.IsListValue( ) ) {
+						// rare; let the tree apply the reference to each
+						// element of the list
+					if( !ins.node->Evaluate( state, top ) ) {
+						val.SetErrorValue( );
+						return false;
+					}
+				} else {
+					top.SetErrorValue( );
+				}
+				break;
+			}
+
+			case UNARY_OP:
+				if( Operation::_doOperation( (Operation::OpKind)ins.arg2, stack[sp-1],
+											 dummy, dummy, true, false, false, result,
+											 &state ) == Operation::SIG_NONE ) {
+					val.SetErrorValue( );
+					return false;
+				}
+				stack[sp-1].CopyFrom( result );
+				break;
+
+			case BINARY_OP:
+				if( Operation::_doOperation( (Operation::OpKind)ins.arg2, stack[sp-2],
+											 stack[sp-1], dummy, true, true, false,
+											 result, &state ) == Operation::SIG_NONE ) {
+					val.SetErrorValue( );
+					return false;
+				}
+				sp--;
+				stack[sp-1].CopyFrom( result );
+				break;
+
+			case AND_JUMP:
+				if( stack[sp-1].IsBooleanValueEquiv( b ) && !b ) {
+					stack[sp-1].SetBooleanValue( false );
+					pc = ins.arg;
+				}
+				break;
+
+			case OR_JUMP:
+				if( stack[sp-1].IsBooleanValueEquiv( b ) && b ) {
+					stack[sp-1].SetBooleanValue( true );
+					pc = ins.arg;
+				}
+				break;
+
+			case TERNARY_JUMP:
+				if( stack[sp-1].IsBooleanValueEquiv( b ) ) {
+					sp--;
+					if( !b ) {
+						pc = ins.arg;
+					}
+				} else {
+						// the condition is not a boolean, so the result
+						// is ERROR or UNDEFINED, but which one depends on
+						// both of the other operands.  Evaluate them the
+						// way Operation::_Evaluate() does.
+					Operation::OpKind op = Operation::__NO_OP__;
+					ExprTree *t1 = NULL, *t2 = NULL, *t3 = NULL;
+					Value val2, val3;
+					((const Operation*)ins.node)->GetComponents( op, t1, t2, t3 );
+					if( !t2->Evaluate( state, val2 ) || !t3->Evaluate( state, val3 ) ) {
+						val.SetErrorValue( );
+						return false;
+					}
+					if( Operation::_doOperation( op, stack[sp-1], val2, val3, true, true,
+												 true, result, &state ) == Operation::SIG_NONE ) {
+						val.SetErrorValue( );
+						return false;
+					}
+					stack[sp-1].CopyFrom( result );
+					pc = ins.arg2;
+				}
+				break;
+
+			case JUMP:
+				pc = ins.arg;
+				break;
+		}
+	}
+
+	val.CopyFrom( stack[0] );
+	return true;
+}
+
+} // classad
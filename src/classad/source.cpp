@@ -36,7 +36,7 @@ namespace classad {
 
 ClassAdParser::
 ClassAdParser ()
-	: oldClassAd(false)
+	: oldClassAd(false), privateErrors(false)
 {
 }
 
@@ -60,6 +60,24 @@ GetOldClassAd() const
 	return oldClassAd;
 }
 
+void ClassAdParser::
+SetPrivateErrors( bool private_errors )
+{
+	privateErrors = private_errors;
+	errorMessage.clear();
+}
+
+void ClassAdParser::
+setParseError( const string &msg )
+{
+	if( privateErrors ) {
+		errorMessage = msg;
+	} else {
+		CondorErrno = ERR_PARSE_ERROR;
+		CondorErrMsg = msg;
+	}
+}
+
 bool ClassAdParser::
 ParseExpression( const string &buffer, ExprTree *&tree, bool full )
 {
@@ -365,9 +383,8 @@ parseExpression( ExprTree *&tree, bool full )
 			// we have a middle expression
 			parseExpression(treeM);
 			if( ( tt = lexer.ConsumeToken() ) != Lexer::LEX_COLON ) {
-				CondorErrno = ERR_PARSE_ERROR;
-				CondorErrMsg="expected LEX_COLON, but got "+
-					string(Lexer::strLexToken(tt));
+				setParseError( "expected LEX_COLON, but got "+
+					string(Lexer::strLexToken(tt)) );
 				if( treeL ) delete treeL; 
 				if( treeM ) delete treeM;
 				tree = NULL;
@@ -390,9 +407,8 @@ parseExpression( ExprTree *&tree, bool full )
 
 	// if a full parse was requested, ensure that input is exhausted
 	if( full && ( lexer.ConsumeToken() != Lexer::LEX_END_OF_INPUT ) ) {
-		CondorErrno = ERR_PARSE_ERROR;
-		CondorErrMsg = "expected LEX_END_OF_INPUT on full parse, but got " + 
-			string(Lexer::strLexToken(tt));
+		setParseError( "expected LEX_END_OF_INPUT on full parse, but got " + 
+			string(Lexer::strLexToken(tt)) );
 		return false;
 	}
 	return true;
@@ -884,9 +900,8 @@ parsePostfixExpression(ExprTree *&tree)
 		
 			// field selection operation
 			if( ( tt = lexer.ConsumeToken( &tv ) ) != Lexer::LEX_IDENTIFIER ) {
-				CondorErrno = ERR_PARSE_ERROR;
-				CondorErrMsg = "second argument of selector must be an "
-					"identifier (got" + string(Lexer::strLexToken(tt)) + ")";
+				setParseError( "second argument of selector must be an "
+					"identifier (got" + string(Lexer::strLexToken(tt)) + ")" );
 				if( treeL ) delete treeL;
 				tree = NULL;
 				return false;
@@ -965,9 +980,8 @@ parsePrimaryExpression(ExprTree *&tree)
 				return ( tree != NULL );
 			}
 			// not an identifier following the '.'
-			CondorErrno = ERR_PARSE_ERROR;
-			CondorErrMsg = "need identifier in selection expression (got" + 
-				string(Lexer::strLexToken(tt)) + ")";
+			setParseError( "need identifier in selection expression (got" + 
+				string(Lexer::strLexToken(tt)) + ")" );
 			tree = NULL;
 			return( false );
 
@@ -982,9 +996,8 @@ parsePrimaryExpression(ExprTree *&tree)
                 }
 
 				if( ( tt = lexer.ConsumeToken() ) != Lexer::LEX_CLOSE_PAREN ) {
-					CondorErrno = ERR_PARSE_ERROR;
-					CondorErrMsg = "exptected LEX_CLOSE_PAREN, but got " +
-						string(Lexer::strLexToken(tt));
+					setParseError( "exptected LEX_CLOSE_PAREN, but got " +
+						string(Lexer::strLexToken(tt)) );
 					if( treeL ) delete treeL;
 					tree = NULL;
 					return false;
@@ -1097,9 +1110,8 @@ parseArgumentList( vector<ExprTree*>& argList )
 
 	argList.clear( );
 	if( ( tt = lexer.ConsumeToken() ) != Lexer::LEX_OPEN_PAREN ) {
-		CondorErrno = ERR_PARSE_ERROR;
-		CondorErrMsg="expected LEX_OPEN_PAREN but got "+
-			string(Lexer::strLexToken(tt));
+		setParseError( "expected LEX_OPEN_PAREN but got "+
+			string(Lexer::strLexToken(tt)) );
 		return false;
 	}
 
@@ -1134,9 +1146,8 @@ parseArgumentList( vector<ExprTree*>& argList )
 				itr++;
 			}
 			argList.clear( );
-			CondorErrno = ERR_PARSE_ERROR;
-			CondorErrMsg = "expected LEX_COMMA or LEX_CLOSE_PAREN but got " + 
-				string( Lexer::strLexToken( tt ) );
+			setParseError( "expected LEX_COMMA or LEX_CLOSE_PAREN but got " + 
+				string( Lexer::strLexToken( tt ) ) );
 			return false;
 		}
 	}
@@ -1173,17 +1184,15 @@ parseClassAd( ClassAd &ad , bool full )
             continue;
         }
 		if( tt != Lexer::LEX_IDENTIFIER ) {
-			CondorErrno = ERR_PARSE_ERROR;
-			CondorErrMsg = "while parsing classad:  expected LEX_IDENTIFIER " 
-				" but got " + string( Lexer::strLexToken( tt ) );
+			setParseError( "while parsing classad:  expected LEX_IDENTIFIER " 
+				" but got " + string( Lexer::strLexToken( tt ) ) );
 			return false;
 		}
 
 		// consume the intermediate '='
 		if( ( tt = lexer.ConsumeToken() ) != Lexer::LEX_BOUND_TO ) {
-			CondorErrno = ERR_PARSE_ERROR;
-			CondorErrMsg = "while parsing classad:  expected LEX_BOUND_TO " 
-				" but got " + string( Lexer::strLexToken( tt ) );
+			setParseError( "while parsing classad:  expected LEX_BOUND_TO " 
+				" but got " + string( Lexer::strLexToken( tt ) ) );
 			return false;
 		}
 
@@ -1203,9 +1212,8 @@ parseClassAd( ClassAd &ad , bool full )
 		// the next token must be a ';' or a ']'
 		tt = lexer.PeekToken();
 		if( tt != Lexer::LEX_SEMICOLON && tt != Lexer::LEX_CLOSE_BOX ) {
-			CondorErrno = ERR_PARSE_ERROR;
-			CondorErrMsg = "while parsing classad:  expected LEX_SEMICOLON or "
-				"LEX_CLOSE_BOX but got " + string( Lexer::strLexToken( tt ) );
+			setParseError( "while parsing classad:  expected LEX_SEMICOLON or "
+				"LEX_CLOSE_BOX but got " + string( Lexer::strLexToken( tt ) ) );
 			return( false );
 		}
 
@@ -1222,9 +1230,8 @@ parseClassAd( ClassAd &ad , bool full )
 
 	// if a full parse was requested, ensure that input is exhausted
 	if( full && ( lexer.ConsumeToken() != Lexer::LEX_END_OF_INPUT ) ) {
-		CondorErrno = ERR_PARSE_ERROR;
-		CondorErrMsg = "while parsing classad:  expected LEX_END_OF_INPUT for "
-			"full parse but got " + string( Lexer::strLexToken( tt ) );
+		setParseError( "while parsing classad:  expected LEX_END_OF_INPUT for "
+			"full parse but got " + string( Lexer::strLexToken( tt ) ) );
 		return false;
 	}
 
@@ -1243,9 +1250,8 @@ parseExprList( ExprList *&list , bool full )
 	vector<ExprTree*>	loe;
 
 	if( ( tt = lexer.ConsumeToken() ) != Lexer::LEX_OPEN_BRACE ) {
-		CondorErrno = ERR_PARSE_ERROR;
-		CondorErrMsg = "while parsing expression list:  expected LEX_OPEN_BRACE"
-			" but got " + string( Lexer::strLexToken( tt ) );
+		setParseError( "while parsing expression list:  expected LEX_OPEN_BRACE"
+			" but got " + string( Lexer::strLexToken( tt ) ) );
 		return false;
 	}
 	tt = lexer.PeekToken();
@@ -1253,10 +1259,9 @@ parseExprList( ExprList *&list , bool full )
 		// parse the expression
 		parseExpression( tree );
 		if( tree == NULL ) {
-			CondorErrno = ERR_PARSE_ERROR;
-			CondorErrMsg = "while parsing expression list:  expected "
+			setParseError( "while parsing expression list:  expected "
 				"LEX_CLOSE_BRACE or LEX_COMMA but got "+
-				string(Lexer::strLexToken(tt));
+				string(Lexer::strLexToken(tt)) );
 			vector<ExprTree*>::iterator i = loe.begin( );
 			while(i != loe.end()) {
 				delete *i;
@@ -1274,10 +1279,9 @@ parseExprList( ExprList *&list , bool full )
 			lexer.ConsumeToken();
 		else
 		if( tt != Lexer::LEX_CLOSE_BRACE ) {
-			CondorErrno = ERR_PARSE_ERROR;
-			CondorErrMsg = "while parsing expression list:  expected "
+			setParseError( "while parsing expression list:  expected "
 				"LEX_CLOSE_BRACE or LEX_COMMA but got "+
-				string(Lexer::strLexToken(tt));
+				string(Lexer::strLexToken(tt)) );
 			vector<ExprTree*>::iterator i = loe.begin( );
 			while(i != loe.end()) {
 				delete *i;
@@ -1295,10 +1299,9 @@ parseExprList( ExprList *&list , bool full )
 
 	// if a full parse was requested, ensure that input is exhausted
 	if( full && ( lexer.ConsumeToken() != Lexer::LEX_END_OF_INPUT ) ) {
-		CondorErrno = ERR_PARSE_ERROR;
-		CondorErrMsg = "while parsing expression list:  expected "
+		setParseError( "while parsing expression list:  expected "
 			"LEX_END_OF_INPUT for full parse but got "+
-			string(Lexer::strLexToken(tt));
+			string(Lexer::strLexToken(tt)) );
 		if( list ) delete list;
 		return false;
 	}
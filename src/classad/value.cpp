@@ -155,9 +155,15 @@ IsBooleanValueEquiv(bool &b) const
 void Value::
 CopyFrom( const Value &val )
 {
-	// optimization, when copying string to string, we can skip the delete/new of the string buffer
-	if (valueType == STRING_VALUE && val.valueType == valueType) {
-		*strValue = *(val.strValue);
+	if (val.valueType == STRING_VALUE) {
+		if (this != &val) {
+			if (val._IsSmallString()) {
+				_SetString(val.smallStrValue, strlen(val.smallStrValue));
+			} else {
+				_SetString(val.strValue->data(), val.strValue->size());
+			}
+			factor = val.factor;
+		}
 		return;
 	}
 
@@ -166,9 +172,6 @@ CopyFrom( const Value &val )
 	factor = val.factor;
 
 	switch (val.valueType) {
-		case STRING_VALUE:
-			strValue = new string( *val.strValue);
-			return;
 
 		case BOOLEAN_VALUE:
 			booleanValue = val.booleanValue;
@@ -256,42 +259,58 @@ SetErrorValue (void)
 }
 
 void Value::
-SetStringValue( const string &s )
+_SetString( const char *s, size_t cch )
 {
-	// optimization, when copying string to string, we can skip the delete/new of the string buffer
-	if (valueType == STRING_VALUE) {
-		*strValue = s;
+	bool small = cch <= SMALL_STRING_MAX && ! memchr(s, '\0', cch);
+
+	if (valueType == STRING_VALUE && ! _IsSmallString()) {
+		// optimization, when copying string to string, we can skip the delete/new of the string buffer
+		if ( ! small) {
+			strValue->assign(s, cch);
+			return;
+		}
+		// s may point into the string we are about to free
+		char buf[SMALL_STRING_SIZE];
+		memcpy(buf, s, cch);
+		delete strValue;
+		memcpy(smallStrValue, buf, cch);
+		smallStrValue[cch] = '\0';
+		smallStrValue[SMALL_STRING_SIZE-1] = 0;
 		return;
 	}
-	_Clear();
-	valueType = STRING_VALUE;
-	strValue = new string( s );
+
+	if (valueType != STRING_VALUE) {
+		_Clear();
+		valueType = STRING_VALUE;
+	}
+	if (small) {
+		// s may point into smallStrValue
+		memmove(smallStrValue, s, cch);
+		smallStrValue[cch] = '\0';
+		smallStrValue[SMALL_STRING_SIZE-1] = 0;
+	} else {
+		string *str = new string( s, cch );
+		strValue = str;
+		smallStrValue[SMALL_STRING_SIZE-1] = 1;
+	}
+}
+
+void Value::
+SetStringValue( const string &s )
+{
+	_SetString( s.data(), s.size() );
 }
 
 void Value::
 SetStringValue( const char *s )
 {
-	// optimization, when copying string to string, we can skip the delete/new of the string buffer
-	if (valueType == STRING_VALUE) {
-		*strValue = s;
-		return;
-	}
-	_Clear();
-	valueType = STRING_VALUE;
-	strValue = new string( s );
+	_SetString( s, strlen(s) );
 }
 
 void Value::
 SetStringValue( const char *s, size_t cch )
 {
-	// optimization, when copying string to string, we can skip the delete/new of the string buffer
-	if (valueType == STRING_VALUE) {
-		strValue->assign(s, cch);
-		return;
-	}
-	_Clear();
-	valueType = STRING_VALUE;
-	strValue = new string( s, cch );
+	_SetString( s, cch );
 }
 
 void Value::
@@ -394,7 +413,8 @@ SameAs(const Value &otherValue) const
                        && absTimeValueSecs->offset == otherValue.absTimeValueSecs->offset);
             break;
         case Value::STRING_VALUE:
-            is_same = (*strValue == *otherValue.strValue);
+            is_same = (_StringSize() == otherValue._StringSize() &&
+                       memcmp(_StringData(), otherValue._StringData(), _StringSize()) == 0);
             break;
 		default:
 			break;
@@ -447,7 +467,7 @@ ostream& operator<<(ostream &stream, Value &value)
 		break;
 	}
 	case Value::STRING_VALUE:
-		stream << *value.strValue;
+		stream.write(value._StringData(), value._StringSize());
 		break;
 	default:
 		break;
@@ -78,6 +78,7 @@ int CollectorDaemon::__failed__;
 List<ClassAd>* CollectorDaemon::__ClassAdResultList__;
 std::string CollectorDaemon::__adType__;
 ExprTree *CollectorDaemon::__filter__;
+AdTypes CollectorDaemon::__whichAds__;
 
 TrackTotals* CollectorDaemon::normalTotals = NULL;
 int CollectorDaemon::submittorRunningJobs;
@@ -114,6 +115,8 @@ int CollectorDaemon::max_pending_query_workers = 50;
 int CollectorDaemon::max_query_worktime = 0;
 int CollectorDaemon::active_query_workers = 0;
 int CollectorDaemon::pending_query_workers = 0;
+CollectorQueryPool CollectorDaemon::query_threads;
+int CollectorDaemon::max_query_threads = -1;
 
 #ifdef TRACK_QUERIES_BY_SUBSYS
 bool CollectorDaemon::want_track_queries_by_subsys = false;
@@ -394,6 +397,8 @@ void CollectorDaemon::Init()
 	// install command handlers for updates
 	daemonCore->Register_CommandWithPayload(UPDATE_STARTD_AD,"UPDATE_STARTD_AD",
 		receive_update,"receive_update",ADVERTISE_STARTD_PERM);
+	daemonCore->Register_CommandWithPayload(UPDATE_STARTD_AD_DELTA,"UPDATE_STARTD_AD_DELTA",
+		receive_update,"receive_update",ADVERTISE_STARTD_PERM);
 	daemonCore->Register_CommandWithPayload(MERGE_STARTD_AD,"MERGE_STARTD_AD",
 		receive_update,"receive_update",NEGOTIATOR);
 	daemonCore->Register_CommandWithPayload(UPDATE_SCHEDD_AD,"UPDATE_SCHEDD_AD",
@@ -469,6 +474,9 @@ void CollectorDaemon::Init()
 
 	// add an exponential moving average counter of updates received.
 	daemonCore->dc_stats.NewProbe("Collector", "UpdatesReceived", AS_COUNT | IS_CLS_SUM_EMA_RATE | IF_BASICPUB);
+	// and of startd delta updates, and those that could not be merged because we don't have the ad they are relative to.
+	daemonCore->dc_stats.NewProbe("Collector", "DeltaUpdatesReceived", AS_COUNT | IS_CLS_SUM_EMA_RATE | IF_BASICPUB);
+	daemonCore->dc_stats.NewProbe("Collector", "DeltaUpdatesRejected", AS_COUNT | IS_CLS_SUM_EMA_RATE | IF_BASICPUB);
 
 	// add a reaper for our query threads spawned off via Create_Thread
 	if ( ReaperId == -1 ) {
@@ -476,6 +484,21 @@ void CollectorDaemon::Init()
 						&CollectorDaemon::QueryReaper,
 						"CollectorDaemon::QueryReaper()");
 	}	
+
+	if ( max_query_threads > 0 ) {
+		// The classad library builds some of its tables the first time
+		// they are needed; make sure that happens here, before any
+		// query thread could need them.
+		ClassAd warm_up;
+		long long now = 0;
+		warm_up.AssignExpr("WarmUp", "int(time()) + CurrentTime");
+		warm_up.EvaluateAttrInt("WarmUp", now);
+
+		if ( ! query_threads.start(max_query_threads, max_pending_query_workers,
+								   run_query_thread, finish_query_thread) ) {
+			dprintf(D_ALWAYS, "Failed to start query threads, queries will be answered by forked workers\n");
+		}
+	}
 }
 
 collector_runtime_probe HandleQuery_runtime;
@@ -647,9 +670,28 @@ int CollectorDaemon::receive_query_cedar(int command,
 			high_prio_query = true;
 		}
 
+		// Queries for the collector ads may include our own ad, which is
+		// given fresh statistics as it is sent, so leave them to the
+		// forked workers.
+		bool use_thread = query_threads.numThreads() > 0 &&
+			whichAds != COLLECTOR_AD && whichAds != (AdTypes) -1;
+
+		if ( use_thread ) {
+			if ( submit_query_thread( query_entry, high_prio_query ) ) {
+				cad = NULL; // set this to NULL so we won't delete it below; finish_query_thread will
+				return_status = KEEP_STREAM; // tell daemoncore to not mess with socket when we return
+			} else {
+				dprintf( D_ALWAYS,
+					"QueryThread: dropping %s priority query request due to max pending queries of %d ( threads %d active %d pending %d )\n",
+					high_prio_query ? "high" : "low",
+					max_pending_query_workers, query_threads.numThreads(),
+					query_threads.numActive(), query_threads.numPending() );
+				collectorStats.global.DroppedQueries += 1;
+			}
+		}
 		// Now that we know if the incoming query is high priority or not,
 		// place it into the proper queue if we don't already have too many pending.
-		if ( ((high_prio_query==false) &&
+		else if ( ((high_prio_query==false) &&
 			  (active_query_workers + pending_query_workers <  max_query_workers + max_pending_query_workers - reserved_for_highprio_query_workers))
 			 ||
 			 ((high_prio_query==true) &&
@@ -674,7 +716,7 @@ int CollectorDaemon::receive_query_cedar(int command,
 		}
 
 		// Update a few statistics
-		if ( !daemonCore->DoFakeCreateThread() ) {  // if we are configured to really fork()...
+		if ( !use_thread && !daemonCore->DoFakeCreateThread() ) {  // if we are configured to really fork()...
 			if (did_we_fork == TRUE) {
 				// A new worker was forked off
 				if (is_locate) { rt.runtime = &HandleLocateForked_runtime; } else { rt.runtime = &HandleQueryForked_runtime; }
@@ -838,11 +880,12 @@ int CollectorDaemon::QueryReaper(int pid, int /* exit_status */ )
 }
 
 
-int CollectorDaemon::receive_query_cedar_worker_thread(void *in_query_entry, Stream* sock)
+bool CollectorDaemon::want_filter_private_ads(Stream *sock, AdTypes whichAds)
 {
-	int return_status = TRUE;
-	double begin = condor_gettimestamp_double();
-	List<ClassAd> results;
+		// Always send private attributes in private ads.
+	if (whichAds == STARTD_PVT_AD) {
+		return false;
+	}
 
 		// If our peer is at least 8.9.3 and has NEGOTIATOR authz, then we'll
 		// trust it to handle our capabilities.
@@ -856,36 +899,24 @@ int CollectorDaemon::receive_query_cedar_worker_thread(void *in_query_entry, Str
 			filter_private_ads = false;
 		}
 	}
+	return filter_private_ads;
+}
 
-	// Pull out relavent state from query_entry
-	pending_query_entry_t *query_entry = (pending_query_entry_t *) in_query_entry;
-	ClassAd *cad = query_entry->cad;
-	bool is_locate = query_entry->is_locate;
-	AdTypes whichAds = query_entry->whichAds;
-
-		// Always send private attributes in private ads.
-	if (whichAds == STARTD_PVT_AD) {
-		filter_private_ads = false;
-	}
-
-	// Perform the query
-
-	if (whichAds != (AdTypes) -1) {
-		process_query_public (whichAds, cad, &results);
-	}
-
-	double end_query = condor_gettimestamp_double();
-	double end_write = 0.0;
-
-	// send the results via cedar			
-	sock->timeout(QueryTimeout); // set up a network timeout of a longer duration
+// Send the results of a query.  Returns 0 if sending an ad failed, in
+// which case the client is given up on, and 1 otherwise.  When in_thread
+// is true, this is called by a query thread and must not change any of
+// the results, which other threads may be reading.
+int CollectorDaemon::send_query_response(Stream *sock, ClassAd *cad, AdTypes whichAds,
+										 List<ClassAd> &results, bool filter_private_ads,
+										 bool in_thread, std::string &projection)
+{
 	sock->encode();
 	results.Rewind();
 	ClassAd *curr_ad = NULL;
 	int more = 1;
 	
 		// See if query ad asks for server-side projection
-	string projection = "";
+	projection = "";
 		// turn projection string into a set of attributes
 	classad::References proj;
 	bool evaluate_projection = false;
@@ -898,6 +929,7 @@ int CollectorDaemon::receive_query_cedar_worker_thread(void *in_query_entry, Str
 		// (the negotiator sends this sort of projection)
 		evaluate_projection = true;
 	}
+	std::unique_ptr<classad::MatchClassAd> projection_mad;
 
 	while ( (curr_ad=results.Next()) )
 	{
@@ -909,6 +941,7 @@ int CollectorDaemon::receive_query_cedar_worker_thread(void *in_query_entry, Str
 		// our persistent collector ad.
 		ClassAd * stats_ad = NULL;
 		if ((whichAds == COLLECTOR_AD) && collector.isSelfAd(curr_ad)) {
+			ASSERT( !in_thread );
 			dprintf(D_ALWAYS,"Query includes collector's self ad\n");
 			// update stats in the collector ad before we return it.
 			std::string stats_config;
@@ -927,7 +960,27 @@ int CollectorDaemon::receive_query_cedar_worker_thread(void *in_query_entry, Str
 		if (evaluate_projection) {
 			proj.clear();
 			projection.clear();
-			if (EvalString(ATTR_PROJECTION, cad, curr_ad, projection) && ! projection.empty()) {
+			bool have_projection;
+			if (in_thread || query_threads.numThreads() > 0) {
+					// EvalString() uses a global match ad, which also
+					// points the parent scope of the ad at itself.  Query
+					// threads may be reading the same ad, so match against
+					// a private ad that falls through to it instead.
+				if ( ! projection_mad) {
+					projection_mad.reset(new classad::MatchClassAd());
+				}
+				ClassAd target;
+				target.ChainToAd(curr_ad);
+				projection_mad->ReplaceLeftAd(cad);
+				projection_mad->ReplaceRightAd(&target);
+				have_projection = cad->EvaluateAttrString(ATTR_PROJECTION, projection);
+				projection_mad->RemoveLeftAd();
+				projection_mad->RemoveRightAd();
+				target.Unchain();
+			} else {
+				have_projection = EvalString(ATTR_PROJECTION, cad, curr_ad, projection);
+			}
+			if (have_projection && ! projection.empty()) {
 				StringTokenIterator list(projection);
 				const std::string * attr;
 				while ((attr = list.next_string())) { proj.insert(*attr); }
@@ -945,15 +998,13 @@ int CollectorDaemon::receive_query_cedar_worker_thread(void *in_query_entry, Str
         {
             dprintf (D_ALWAYS,
                     "Error sending query result to client -- aborting\n");
-            return_status = 0;
-			goto END;
+			return 0;
         }
 
 		if (sock->deadline_expired()) {
 			dprintf( D_ALWAYS,
 				"QueryWorker: max_worktime expired while sending query result to client -- aborting\n");
-			return_status = 0;
-			goto END;
+			return 0;
 		}
 
 	} // end of while loop for next result ad to send
@@ -971,30 +1022,173 @@ int CollectorDaemon::receive_query_cedar_worker_thread(void *in_query_entry, Str
 		dprintf (D_ALWAYS, "Error flushing CEDAR socket\n");
 	}
 
-	end_write = condor_gettimestamp_double();
+	return 1;
+}
 
+static void
+log_query_info(int matched, int skipped, double query_time, double send_time,
+			   AdTypes whichAds, ExprTree *filter, bool is_locate, int limit,
+			   const char *subsys, Stream *sock, const std::string &projection,
+			   bool filter_private_ads)
+{
+	std::string requirements;
+	if (filter) {
+		ExprTreeToString(filter, requirements);
+	}
 	dprintf (D_ALWAYS,
 			 "Query info: matched=%d; skipped=%d; query_time=%f; send_time=%f; type=%s; requirements={%s}; locate=%d; limit=%d; from=%s; peer=%s; projection={%s}; filter_private_ads=%d\n",
-			 __numAds__,
-			 __failed__,
-			 end_query - begin,
-			 end_write - end_query,
+			 matched,
+			 skipped,
+			 query_time,
+			 send_time,
 			 AdTypeToString(whichAds),
-			 ExprTreeToString(__filter__),
+			 requirements.c_str(),
 			 is_locate,
-			 (__resultLimit__ == INT_MAX) ? 0 : __resultLimit__,
-			 query_entry->subsys,
+			 (limit == INT_MAX) ? 0 : limit,
+			 subsys,
 			 sock->peer_description(),
 			 projection.c_str(),
 			 filter_private_ads);
-END:
-	
-	// All done.  Deallocate memory allocated in this method.  Note that DaemonCore 
-	// will supposedly free() the query_entry struct itself and also delete sock.
+}
+
+int CollectorDaemon::receive_query_cedar_worker_thread(void *in_query_entry, Stream* sock)
+{
+	int return_status = TRUE;
+	double begin = condor_gettimestamp_double();
+	List<ClassAd> results;
+
+	// Pull out relavent state from query_entry
+	pending_query_entry_t *query_entry = (pending_query_entry_t *) in_query_entry;
+	ClassAd *cad = query_entry->cad;
+	bool is_locate = query_entry->is_locate;
+	AdTypes whichAds = query_entry->whichAds;
+
+	bool filter_private_ads = want_filter_private_ads(sock, whichAds);
+
+	// Perform the query
+
+	if (whichAds != (AdTypes) -1) {
+		process_query_public (whichAds, cad, &results);
+	}
+
+	double end_query = condor_gettimestamp_double();
+	double end_write = 0.0;
+
+	// send the results via cedar			
+	sock->timeout(QueryTimeout); // set up a network timeout of a longer duration
+	std::string projection;
+	return_status = send_query_response(sock, cad, whichAds, results, filter_private_ads, false, projection);
+	if ( ! return_status) {
+		return return_status;
+	}
+
+	end_write = condor_gettimestamp_double();
+
+	log_query_info(__numAds__, __failed__, end_query - begin, end_write - end_query,
+				   whichAds, __filter__, is_locate, __resultLimit__,
+				   query_entry->subsys, sock, projection, filter_private_ads);
+
+	// All done.  Note that DaemonCore will supposedly free() the
+	// query_entry struct itself and also delete sock.
 
 	return return_status;
 }
 
+// Prepare a query to be answered by a query thread, and hand it to one.
+// Everything that needs daemon core or the tables is done here, on the
+// main thread: the thread gets a snapshot of the ads that may match.
+// Returns false, and leaves the query to the caller, if there are already
+// too many queries waiting for a thread.
+bool CollectorDaemon::submit_query_thread(pending_query_entry_t *query_entry, bool high_prio)
+{
+	CollectorQuery *q = new CollectorQuery();
+	q->begin = condor_gettimestamp_double();
+	q->whichAds = query_entry->whichAds;
+	q->is_locate = query_entry->is_locate;
+	strncpy(q->subsys, query_entry->subsys, COUNTOF(q->subsys));
+	q->subsys[COUNTOF(q->subsys)-1] = 0;
+	q->filter_private_ads = want_filter_private_ads(query_entry->sock, q->whichAds);
+
+	q->filter = prepare_query(q->whichAds, query_entry->cad, q->adType, q->resultLimit);
+	if (q->filter) {
+		q->snapshot = collector.takeSnapshot(q->whichAds, q->filter, q->ads);
+	}
+
+	query_entry->sock->timeout(QueryTimeout); // set up a network timeout of a longer duration
+	q->sock = query_entry->sock;
+	q->query = query_entry->cad;
+	if ( ! query_threads.submit(q, high_prio)) {
+		q->sock = NULL;
+		q->query = NULL;
+		collector.releaseSnapshot(q->snapshot);
+		delete q;
+		return false;
+	}
+
+	collectorStats.global.PendingQueries = pending_query_workers + query_threads.numPending();
+	return true;
+}
+
+// Answer a query on a query thread.  This must not change anything
+// shared with the main thread or the other query threads: not the ads in
+// the snapshot, and not the statics used by process_query_public().
+void CollectorDaemon::run_query_thread(CollectorQuery *q)
+{
+	if ( q->sock->deadline_expired() || static_cast<Sock *>(q->sock)->readReady() ) {
+		dprintf( D_ALWAYS,
+			"QueryThread: dropping stale query request because %s\n",
+			q->sock->deadline_expired() ? "max worktime expired" : "client gone" );
+		return;
+	}
+
+	List<ClassAd> results;
+	int numAds = 0;
+	int failed = 0;
+	if (q->filter) {
+		for (size_t i = 0; i < q->ads.size() && numAds < q->resultLimit; ++i) {
+			ClassAd *cad = q->ads[i];
+			if ( !q->adType.empty() ) {
+				std::string type = "";
+				cad->LookupString( ATTR_MY_TYPE, type );
+				if ( strcasecmp( type.c_str(), q->adType.c_str() ) != 0 ) {
+					continue;
+				}
+			}
+
+			classad::Value result;
+			bool val;
+			if ( EvalExprTree( q->filter, cad, NULL, result ) &&
+				 result.IsBooleanValueEquiv(val) && val ) {
+				numAds++;
+				results.Append(cad);
+			} else {
+				failed++;
+			}
+		}
+		dprintf (D_ALWAYS, "(Sending %d ads in response to query)\n", numAds);
+	}
+
+	double end_query = condor_gettimestamp_double();
+
+	std::string projection;
+	if ( ! send_query_response(q->sock, q->query, q->whichAds, results, q->filter_private_ads, true, projection)) {
+		return;
+	}
+
+	log_query_info(numAds, failed, end_query - q->begin, condor_gettimestamp_double() - end_query,
+				   q->whichAds, q->filter, q->is_locate, q->resultLimit,
+				   q->subsys, q->sock, projection, q->filter_private_ads);
+}
+
+void CollectorDaemon::finish_query_thread(CollectorQuery *q)
+{
+	collector.releaseSnapshot(q->snapshot);
+	delete q;
+
+	collectorStats.global.ActiveQueryWorkers = active_query_workers + query_threads.numActive();
+	collectorStats.global.PendingQueries = pending_query_workers + query_threads.numPending();
+}
+
 AdTypes
 CollectorDaemon::receive_query_public( int command )
 {
@@ -1235,6 +1429,9 @@ int CollectorDaemon::receive_update(int command, Stream* sock)
 #endif
 
 	daemonCore->dc_stats.AddToAnyProbe("UpdatesReceived", 1);
+	if (command == UPDATE_STARTD_AD_DELTA) {
+		daemonCore->dc_stats.AddToAnyProbe("DeltaUpdatesReceived", 1);
+	}
 
 	/* assume the ad is malformed... other functions set this value */
 	insert = -3;
@@ -1273,6 +1470,13 @@ int CollectorDaemon::receive_update(int command, Stream* sock)
 			// which already does all the necessary logging.
 		}
 
+		if (insert == -5)
+		{
+			// A delta update relative to an ad we don't have,
+			// the startd will send the whole ad in a while.
+			daemonCore->dc_stats.AddToAnyProbe("DeltaUpdatesRejected", 1);
+		}
+
 		return FALSE;
 
 	}
@@ -1280,6 +1484,12 @@ int CollectorDaemon::receive_update(int command, Stream* sock)
 	CollectorEngine_ru_collect_runtime += rt.tick(rt_last);
 #endif
 
+		// a delta update has been merged into the whole ad,
+		// which is what the plugins and view collectors get.
+	if (command == UPDATE_STARTD_AD_DELTA) {
+		command = UPDATE_STARTD_AD;
+	}
+
 	/* let the off-line plug-in have at it */
 	offline_plugin_.update ( command, *cad );
 
@@ -1287,6 +1497,9 @@ int CollectorDaemon::receive_update(int command, Stream* sock)
 	CollectorPluginManager::Update(command, *cad);
 #endif
 
+		// the plugins may have changed the ad in place
+	collector.reindexAd(cad);
+
 #ifdef PROFILE_RECEIVE_UPDATE
 	CollectorEngine_ru_plugins_runtime += rt.tick(rt_last);
 #endif
@@ -1427,6 +1640,11 @@ int CollectorDaemon::receive_update_expect_ack(int command,
     CollectorPluginManager::Update ( command, *cad );
 #endif
 
+		// the plugins may have changed the ad in place
+	if (cad) {
+		collector.reindexAd(cad);
+	}
+
 	if (viewCollectorTypes || UPDATE_STARTD_AD_WITH_ACK == command) {
 		forward_classad_to_view_collector(command,
 										  ATTR_MY_TYPE,
@@ -1500,35 +1718,34 @@ int CollectorDaemon::query_scanFunc (ClassAd *cad)
 }
 
 
-void CollectorDaemon::process_query_public (AdTypes whichAds,
-											ClassAd *query,
-											List<ClassAd>* results)
+// Find the constraint of a query, and rewrite it as the configuration
+// asks.  Returns NULL if the query has no constraint.  Also returns the
+// MyType to restrict the results to, and the maximum number of results.
+ExprTree *CollectorDaemon::prepare_query (AdTypes whichAds,
+										  ClassAd *query,
+										  std::string &adType,
+										  int &resultLimit)
 {
-	// set up for hashtable scan
-	__query__ = query;
-	__numAds__ = 0;
-	__failed__ = 0;
-	__ClassAdResultList__ = results;
 	// An empty adType means don't check the MyType of the ads.
 	// This means either the command indicates we're only checking one
 	// type of ad, or the query's TargetType is "Any" (match all ad types).
-	__adType__ = "";
+	adType = "";
 	if ( whichAds == GENERIC_AD || whichAds == ANY_AD ) {
-		query->LookupString( ATTR_TARGET_TYPE, __adType__ );
-		if ( strcasecmp( __adType__.c_str(), "any" ) == 0 ) {
-			__adType__ = "";
+		query->LookupString( ATTR_TARGET_TYPE, adType );
+		if ( strcasecmp( adType.c_str(), "any" ) == 0 ) {
+			adType = "";
 		}
 	}
 
-	__filter__ = query->LookupExpr( ATTR_REQUIREMENTS );
-	if ( __filter__ == NULL ) {
+	ExprTree *filter = query->LookupExpr( ATTR_REQUIREMENTS );
+	if ( filter == NULL ) {
 		dprintf (D_ALWAYS, "Query missing %s\n", ATTR_REQUIREMENTS );
-		return;
+		return NULL;
 	}
 
-	__resultLimit__ = INT_MAX; // no limit
-	if ( ! query->LookupInteger(ATTR_LIMIT_RESULTS, __resultLimit__) || __resultLimit__ <= 0) {
-		__resultLimit__ = INT_MAX; // no limit
+	resultLimit = INT_MAX; // no limit
+	if ( ! query->LookupInteger(ATTR_LIMIT_RESULTS, resultLimit) || resultLimit <= 0) {
+		resultLimit = INT_MAX; // no limit
 	}
 
 	// See if we should exclude Collector Ads from generic queries.  Still
@@ -1540,13 +1757,13 @@ void CollectorDaemon::process_query_public (AdTypes whichAds,
 		dprintf(D_FULLDEBUG, "Received query with generic type; filtering collector ads\n");
 		MyString modified_filter;
 		modified_filter.formatstr("(%s) && (MyType =!= \"Collector\")",
-			ExprTreeToString(__filter__));
+			ExprTreeToString(filter));
 		query->AssignExpr(ATTR_REQUIREMENTS,modified_filter.Value());
-		__filter__ = query->LookupExpr(ATTR_REQUIREMENTS);
-		if ( __filter__ == NULL ) {
+		filter = query->LookupExpr(ATTR_REQUIREMENTS);
+		if ( filter == NULL ) {
 			dprintf (D_ALWAYS, "Failed to parse modified filter: %s\n", 
 				modified_filter.Value());
-			return;
+			return NULL;
 		}
 		dprintf(D_FULLDEBUG,"Query after modification: *%s*\n",modified_filter.Value());
 	}
@@ -1562,19 +1779,36 @@ void CollectorDaemon::process_query_public (AdTypes whichAds,
 		if (!checks_absent) {
 			MyString modified_filter;
 			modified_filter.formatstr("(%s) && (%s =!= True)",
-				ExprTreeToString(__filter__),ATTR_ABSENT);
+				ExprTreeToString(filter),ATTR_ABSENT);
 			query->AssignExpr(ATTR_REQUIREMENTS,modified_filter.Value());
-			__filter__ = query->LookupExpr(ATTR_REQUIREMENTS);
-			if ( __filter__ == NULL ) {
+			filter = query->LookupExpr(ATTR_REQUIREMENTS);
+			if ( filter == NULL ) {
 				dprintf (D_ALWAYS, "Failed to parse modified filter: %s\n", 
 					modified_filter.Value());
-				return;
+				return NULL;
 			}
 			dprintf(D_FULLDEBUG,"Query after modification: *%s*\n",modified_filter.Value());
 		}
 	}
 
-	if (!collector.walkHashTable (whichAds, query_scanFunc))
+	return filter;
+}
+
+void CollectorDaemon::process_query_public (AdTypes whichAds,
+											ClassAd *query,
+											List<ClassAd>* results)
+{
+	// set up for hashtable scan
+	__query__ = query;
+	__numAds__ = 0;
+	__failed__ = 0;
+	__ClassAdResultList__ = results;
+	__filter__ = prepare_query( whichAds, query, __adType__, __resultLimit__ );
+	if ( __filter__ == NULL ) {
+		return;
+	}
+
+	if (!collector.walkHashTable (whichAds, __filter__, query_scanFunc))
 	{
 		dprintf (D_ALWAYS, "Error sending query response\n");
 	}
@@ -1614,7 +1848,11 @@ int CollectorDaemon::setAttrLastHeardFrom (ClassAd* cad, unsigned long time)
 	if ( EvalExprTree( __filter__, cad, NULL, result ) &&
 		 result.IsBooleanValueEquiv(val) && val ) {
 
-		cad->Assign( ATTR_LAST_HEARD_FROM, time );
+			// a query thread may be reading this ad
+		cad = collector.writableAd( __whichAds__, cad );
+		if ( cad ) {
+			cad->Assign( ATTR_LAST_HEARD_FROM, time );
+		}
         __numAds__++;
     }
 
@@ -1646,6 +1884,7 @@ void CollectorDaemon::process_invalidation (AdTypes whichAds, ClassAd &query, St
 
 		// set up for hashtable scan
 		__query__ = &query;
+		__whichAds__ = whichAds;
 		__filter__ = query.LookupExpr( ATTR_REQUIREMENTS );
 		// An empty adType means don't check the MyType of the ads.
 		// This means either the command indicates we're only checking
@@ -1839,6 +2078,19 @@ void CollectorDaemon::Config()
 	// This it temporary (for 8.7.0) just in case we need to turn off the new getClassAdEx options
 	collector.m_get_ad_options = param_integer("COLLECTOR_GETAD_OPTIONS", GET_CLASSAD_FAST | GET_CLASSAD_LAZY_PARSE);
 	collector.m_get_ad_options &= (GET_CLASSAD_LAZY_PARSE | GET_CLASSAD_FAST | GET_CLASSAD_NO_CACHE);
+
+	// The query threads are started by Init(), so changing the number
+	// of them requires a restart.
+	if ( max_query_threads < 0 ) {
+		max_query_threads = param_integer("COLLECTOR_QUERY_THREADS", 0, 0);
+	}
+	// A lazily parsed ad is parsed by whoever first reads it, which
+	// could be any number of query threads at once.
+	if ( max_query_threads > 0 && (collector.m_get_ad_options & GET_CLASSAD_LAZY_PARSE) ) {
+		dprintf(D_ALWAYS, "COLLECTOR_QUERY_THREADS is set, disabling lazy-parse in COLLECTOR_GETAD_OPTIONS\n");
+		collector.m_get_ad_options &= ~GET_CLASSAD_LAZY_PARSE;
+	}
+
 	MyString opts;
 	if (collector.m_get_ad_options & GET_CLASSAD_FAST) { opts += "fast "; }
 	if (collector.m_get_ad_options & GET_CLASSAD_NO_CACHE) { opts += "no-cache "; }
@@ -1846,6 +2098,10 @@ void CollectorDaemon::Config()
 	if (opts.empty()) { opts = "none "; }
 	dprintf(D_ALWAYS, "COLLECTOR_GETAD_OPTIONS set to %s(0x%x)\n", opts.c_str(), collector.m_get_ad_options);
 
+	std::string index_attrs;
+	param(index_attrs, "COLLECTOR_QUERY_INDEX_ATTRS");
+	collector.setQueryIndexAttrs(index_attrs.c_str());
+
 	tmp = param(COLLECTOR_REQUIREMENTS);
 	MyString collector_req_err;
 	if( !collector.setCollectorRequirements( tmp, collector_req_err ) ) {
@@ -2010,6 +2266,7 @@ void CollectorDaemon::Exit()
 		daemonCore->Cancel_Timer(UpdateTimerId);
 		UpdateTimerId = -1;
 	}
+	query_threads.stop();
 	free( CollectorName );
 	delete ad;
 	delete collectorsToUpdate;
@@ -2032,6 +2289,7 @@ void CollectorDaemon::Shutdown()
 		daemonCore->Cancel_Timer(UpdateTimerId);
 		UpdateTimerId = -1;
 	}
+	query_threads.stop();
 	free( CollectorName );
 	delete ad;
 	delete collectorsToUpdate;
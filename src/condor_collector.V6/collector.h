@@ -28,6 +28,7 @@
 #include "forkwork.h"
 
 #include "collector_engine.h"
+#include "collector_query_pool.h"
 #include "collector_stats.h"
 #include "dc_collector.h"
 #include "offline_plugin.h"
@@ -104,6 +105,9 @@ public:
     static int receive_update_expect_ack(int, Stream*);
 
 	static void process_query_public(AdTypes, ClassAd*, List<ClassAd>*);
+	static ExprTree *prepare_query(AdTypes, ClassAd*, std::string &adType, int &resultLimit);
+	static bool want_filter_private_ads(Stream*, AdTypes);
+	static int send_query_response(Stream*, ClassAd*, AdTypes, List<ClassAd> &, bool filter_private_ads, bool in_thread, std::string &projection);
 	static ClassAd * process_global_query( const char *constraint, void *arg );
 	static int select_by_match( ClassAd *cad );
 	static void process_invalidation(AdTypes, ClassAd&, Stream*);
@@ -166,6 +170,13 @@ public:
 	static int active_query_workers;
 	static int pending_query_workers;
 
+	// queries answered by threads, see COLLECTOR_QUERY_THREADS
+	static CollectorQueryPool query_threads;
+	static int max_query_threads;  // from config file, at startup only
+	static bool submit_query_thread(pending_query_entry_t *, bool high_prio);
+	static void run_query_thread(CollectorQuery *);
+	static void finish_query_thread(CollectorQuery *);
+
 #ifdef TRACK_QUERIES_BY_SUBSYS
 	static bool want_track_queries_by_subsys;
 #endif
@@ -190,6 +201,7 @@ protected:
 	static int __failed__;
 	static std::string __adType__;
 	static ExprTree *__filter__;
+	static AdTypes __whichAds__;
 
 	static TrackTotals* normalTotals;
 	static int submittorRunningJobs;
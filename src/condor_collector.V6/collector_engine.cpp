@@ -30,6 +30,8 @@ extern "C" void event_mgr (void);
 #include "condor_attributes.h"
 #include "condor_daemon_core.h"
 #include "classad_merge.h"
+#include "daemon.h"
+#include "dc_message.h"
 
 //-------------------------------------------------------------
 
@@ -38,7 +40,6 @@ extern "C" void event_mgr (void);
 
 static void killHashTable (CollectorHashTable &);
 static int killGenericHashTable(CollectorHashTable *);
-static void purgeHashTable (CollectorHashTable &);
 
 int 	engine_clientTimeoutHandler (Service *);
 int 	engine_housekeepingHandler  (Service *);
@@ -72,6 +73,7 @@ CollectorEngine::CollectorEngine (CollectorStats *stats ) :
 	collectorStats = stats;
 	m_collector_requirements = NULL;
 	m_get_ad_options = 0;
+	m_snapshotSeq = 0;
 }
 
 
@@ -93,6 +95,12 @@ CollectorEngine::
 	killHashTable (HadAds);
 	killHashTable (GridAds);
 	GenericAds.walk(killGenericHashTable);
+	clearQueryIndexes();
+
+	for (size_t i = 0; i < m_retiredAds.size(); ++i) {
+		delete m_retiredAds[i].second;
+	}
+	m_retiredAds.clear();
 
 	if(m_collector_requirements) {
 		delete m_collector_requirements;
@@ -222,9 +230,16 @@ CollectorEngine::invalidateAds(AdTypes adType, ClassAd &query)
 	ClassAd  *ad;
 	AdNameHashKey  hk;
 	MyString hkString;
+		// IsAHalfMatch() points the parent scope of the ad at a match ad,
+		// which a query thread reading the ad would see, so match against
+		// a private ad that falls through to it instead.
+	ClassAd target;
 	(*table).startIterations();
 	while ((*table).iterate (ad)) {
-		if (IsAHalfMatch(&query, ad)) {
+		target.ChainToAd(ad);
+		bool matched = IsAHalfMatch(&query, m_snapshots.empty() ? ad : &target);
+		target.Unchain();
+		if (matched) {
 			(*table).getCurrentKey(hk);
 			hk.sprint(hkString);
 			if ((*table).remove(hk) == -1) {
@@ -235,7 +250,9 @@ CollectorEngine::invalidateAds(AdTypes adType, ClassAd &query)
 				dprintf(D_ALWAYS,
 						"\t\t**** Invalidating ad: \"%s\"\n",
 						hkString.Value());
-				delete ad;
+				CollectorAttrIndex *index = queryIndex(*table);
+				if (index) { index->remove(ad); }
+				retireAd(ad);
 				count++;
 			}
 		}
@@ -311,6 +328,228 @@ walkHashTable (AdTypes adType, int (*scanFunction)(ClassAd *))
 }
 
 
+int CollectorEngine::
+walkHashTable (AdTypes adType, classad::ExprTree *constraint, int (*scanFunction)(ClassAd *))
+{
+	CollectorHashTable *table = NULL;
+	CollectorEngine::HashFunc func;
+	CollectorAttrIndex *index = NULL;
+	if (ANY_AD != adType && GENERIC_AD != adType && LookupByAdType(adType, table, func)) {
+		index = queryIndex(*table);
+	}
+
+	std::vector<ClassAd*> ads;
+	if (!index || !constraint || !index->candidates(constraint, ads)) {
+		return walkHashTable(adType, scanFunction);
+	}
+
+	dprintf(D_FULLDEBUG, "Query index selected %d of %d ads\n",
+			(int)ads.size(), (int)index->size());
+	for (std::vector<ClassAd*>::iterator it = ads.begin(); it != ads.end(); ++it) {
+		if (!scanFunction(*it)) {
+			break;
+		}
+	}
+
+	return 1;
+}
+
+void CollectorEngine::
+setQueryIndexAttrs (const char *attrs)
+{
+	classad::References new_attrs;
+	StringList attr_list(attrs);
+	const char *attr;
+	attr_list.rewind();
+	while ((attr = attr_list.next())) {
+			// the collector itself changes these in place all the time
+		if (strcasecmp(attr, ATTR_LAST_HEARD_FROM) == 0 ||
+			strcasecmp(attr, ATTR_LAST_FORWARDED) == 0 ||
+			strcasecmp(attr, ATTR_SHOULD_FORWARD) == 0) {
+			dprintf(D_ALWAYS, "COLLECTOR_QUERY_INDEX_ATTRS: cannot index %s, ignoring it\n", attr);
+			continue;
+		}
+		new_attrs.insert(attr);
+	}
+
+	if (new_attrs == m_queryIndexAttrs) {
+		return;
+	}
+	m_queryIndexAttrs = new_attrs;
+	clearQueryIndexes();
+	if (m_queryIndexAttrs.empty()) {
+		return;
+	}
+
+	static const AdTypes indexed_types[] = {
+		STARTD_AD, STARTD_PVT_AD, SCHEDD_AD, SUBMITTOR_AD, LICENSE_AD,
+		MASTER_AD, CKPT_SRVR_AD, COLLECTOR_AD, STORAGE_AD, ACCOUNTING_AD,
+		NEGOTIATOR_AD, HAD_AD, GRID_AD,
+	};
+	for (size_t i = 0; i < COUNTOF(indexed_types); ++i) {
+		CollectorHashTable *table;
+		CollectorEngine::HashFunc func;
+		if (!LookupByAdType(indexed_types[i], table, func)) {
+			continue;
+		}
+		CollectorAttrIndex *index = new CollectorAttrIndex(m_queryIndexAttrs);
+		ClassAd *ad;
+		table->startIterations();
+		while (table->iterate(ad)) {
+			index->insert(ad);
+		}
+		m_queryIndexes[table] = index;
+	}
+
+	std::string names;
+	for (classad::References::const_iterator it = m_queryIndexAttrs.begin(); it != m_queryIndexAttrs.end(); ++it) {
+		if (!names.empty()) { names += ","; }
+		names += *it;
+	}
+	dprintf(D_ALWAYS, "Query indexes built on %s\n", names.c_str());
+}
+
+void CollectorEngine::
+reindexAd (ClassAd *ad)
+{
+	std::map<const CollectorHashTable*, CollectorAttrIndex*>::iterator it;
+	for (it = m_queryIndexes.begin(); it != m_queryIndexes.end(); ++it) {
+		if (it->second->contains(ad)) {
+			it->second->reindex(ad);
+			return;
+		}
+	}
+}
+
+CollectorAttrIndex *CollectorEngine::
+queryIndex (const CollectorHashTable &table) const
+{
+	std::map<const CollectorHashTable*, CollectorAttrIndex*>::const_iterator it = m_queryIndexes.find(&table);
+	if (it == m_queryIndexes.end()) {
+		return NULL;
+	}
+	return it->second;
+}
+
+void CollectorEngine::
+clearQueryIndexes ()
+{
+	std::map<const CollectorHashTable*, CollectorAttrIndex*>::iterator it;
+	for (it = m_queryIndexes.begin(); it != m_queryIndexes.end(); ++it) {
+		delete it->second;
+	}
+	m_queryIndexes.clear();
+}
+
+std::vector<ClassAd*> *CollectorEngine::snapshotAds = NULL;
+
+int CollectorEngine::
+snapshotScanFunc (ClassAd *ad)
+{
+	snapshotAds->push_back(ad);
+	return 1;
+}
+
+unsigned long CollectorEngine::
+takeSnapshot (AdTypes adType, classad::ExprTree *constraint, std::vector<ClassAd*> &ads)
+{
+	ads.clear();
+	snapshotAds = &ads;
+	walkHashTable(adType, constraint, snapshotScanFunc);
+	snapshotAds = NULL;
+
+	m_snapshots.insert(++m_snapshotSeq);
+	return m_snapshotSeq;
+}
+
+void CollectorEngine::
+releaseSnapshot (unsigned long snapshot)
+{
+	std::multiset<unsigned long>::iterator it = m_snapshots.find(snapshot);
+	if (it == m_snapshots.end()) {
+		return;
+	}
+	m_snapshots.erase(it);
+
+		// an ad retired after snapshot N was taken can only be in
+		// snapshots numbered N or less
+	while (!m_retiredAds.empty() &&
+		   (m_snapshots.empty() || m_retiredAds.front().first < *m_snapshots.begin())) {
+		delete m_retiredAds.front().second;
+		m_retiredAds.pop_front();
+	}
+}
+
+void CollectorEngine::
+retireAd (ClassAd *ad)
+{
+	if (m_snapshots.empty()) {
+		delete ad;
+	} else {
+		m_retiredAds.push_back(std::make_pair(m_snapshotSeq, ad));
+	}
+}
+
+ClassAd *CollectorEngine::
+writableAd (CollectorHashTable &table, AdNameHashKey &hk, ClassAd *ad)
+{
+	if (m_snapshots.empty()) {
+		return ad;
+	}
+
+		// Replacing the value of an existing key neither moves nor
+		// rehashes anything, so this is safe while iterating the table.
+	ClassAd *copy = new ClassAd(*ad);
+	if (table.insert(hk, copy, true) == -1) {
+		EXCEPT( "Error replacing ad" );
+	}
+	CollectorAttrIndex *index = queryIndex(table);
+	if (index) {
+		index->remove(ad);
+		index->insert(copy);
+	}
+	if (isSelfAd(ad)) { __self_ad__ = copy; }
+	retireAd(ad);
+	return copy;
+}
+
+ClassAd *CollectorEngine::
+writableAd (AdTypes adType, ClassAd *ad)
+{
+	if (m_snapshots.empty()) {
+		return ad;
+	}
+
+		// the generic tables and the concrete tables walked for
+		// ANY_AD are told apart by MyType
+	std::string my_type;
+	AdTypes type = adType;
+	if (GENERIC_AD == adType || ANY_AD == adType) {
+		ad->LookupString(ATTR_MY_TYPE, my_type);
+		type = AdTypeFromString(my_type.c_str());
+	}
+
+	CollectorHashTable *table = NULL;
+	CollectorEngine::HashFunc func;
+	AdNameHashKey hk;
+	ClassAd *found = NULL;
+	if (LookupByAdType(type, table, func) && (*func)(hk, ad) &&
+		table->lookup(hk, found) != -1 && found == ad) {
+		return writableAd(*table, hk, ad);
+	}
+	if ((GENERIC_AD == adType || ANY_AD == adType) &&
+		GenericAds.lookup(MyString(my_type), table) != -1 &&
+		makeGenericAdHashKey(hk, ad) &&
+		table->lookup(hk, found) != -1 && found == ad) {
+		return writableAd(*table, hk, ad);
+	}
+
+	dprintf(D_ALWAYS, "Failed to find %s ad to update\n", my_type.empty() ? AdTypeToString(adType) : my_type.c_str());
+	return NULL;
+}
+
+
+
 CollectorHashTable *CollectorEngine::findOrCreateTable(MyString &type)
 {
 	CollectorHashTable *table=0;
@@ -555,7 +794,8 @@ collect (int command,ClassAd *clientAd,const condor_sockaddr& from,int &insert,S
 		repeatStartdAds = param_integer("COLLECTOR_REPEAT_STARTD_ADS",0);
 	}
 
-	if( !ValidateClassAd(command,clientAd,sock) ) {
+		// a delta update is validated after it is merged, see mergeStartdAdDelta
+	if( command != UPDATE_STARTD_AD_DELTA && !ValidateClassAd(command,clientAd,sock) ) {
 	    insert = -4;
 		return NULL;
 	}
@@ -569,7 +809,8 @@ collect (int command,ClassAd *clientAd,const condor_sockaddr& from,int &insert,S
 	{
 	  case UPDATE_STARTD_AD:
 	  case UPDATE_STARTD_AD_WITH_ACK:
-		if ( repeatStartdAds > 0 ) {
+	  case UPDATE_STARTD_AD_DELTA:
+		if ( repeatStartdAds > 0 && command != UPDATE_STARTD_AD_DELTA ) {
 			clientAdToRepeat = new ClassAd(*clientAd);
 		}
 		if (!makeStartdAdHashKey (hk, clientAd))
@@ -585,8 +826,15 @@ collect (int command,ClassAd *clientAd,const condor_sockaddr& from,int &insert,S
 		CollectorEngine_rucc_makeHashKey_runtime.Add(rt.tick(rt_last));
 #endif
 
-		retVal=updateClassAd (StartdAds, "StartdAd     ", "Start",
-							  clientAd, hk, hashString, insert, from );
+		if (command == UPDATE_STARTD_AD_DELTA) {
+			retVal = mergeStartdAdDelta(clientAd, hk, hashString, insert, sock);
+			if ( ! retVal) {
+				break;
+			}
+		} else {
+			retVal=updateClassAd (StartdAds, "StartdAd     ", "Start",
+								  clientAd, hk, hashString, insert, from );
+		}
 
 #ifdef PROFILE_RECEIVE_UPDATE
 		if (last_updateClassAd_was_insert) { CollectorEngine_rucc_insertAd_runtime.Add(rt.tick(rt_last));
@@ -957,7 +1205,9 @@ int CollectorEngine::remove (AdTypes t_AddType, const ClassAd & c_query, bool *q
 				hk.sprint( hkString );
 				iRet = !table->remove(hk);
 				dprintf (D_ALWAYS,"\t\t**** Removed(%d) ad(s): \"%s\"\n", iRet, hkString.Value() );
-				delete pAd;
+				CollectorAttrIndex *index = queryIndex(*table);
+				if (index) { index->remove(pAd); }
+				retireAd(pAd);
 			}
 		}
 	}
@@ -978,9 +1228,11 @@ int CollectorEngine::expire( AdTypes adType, const ClassAd & query, bool * query
 
             ClassAd * cAd = NULL;
             if( hTable->lookup( hKey, cAd ) != -1 ) {
+                cAd = writableAd( *hTable, hKey, cAd );
                 cAd->Assign( ATTR_LAST_HEARD_FROM, 1 );
                 
                 if( CollectorDaemon::offline_plugin_.expire( * cAd ) == true ) {
+                    reindexAd( cAd );
                     return rVal;
                 }
                 
@@ -995,7 +1247,9 @@ int CollectorEngine::expire( AdTypes adType, const ClassAd & query, bool * query
                 hKey.sprint( hkString );                
                 dprintf( D_ALWAYS, "\t\t**** Removed(%d) stale ad(s): \"%s\"\n", rVal, hkString.Value() );
 
-                delete cAd;
+                CollectorAttrIndex *index = queryIndex( *hTable );
+                if( index ) { index->remove( cAd ); }
+                retireAd( cAd );
             }
         }
     }
@@ -1011,6 +1265,11 @@ remove (AdTypes adType, AdNameHashKey &hk)
 	if (!LookupByAdType(adType, table, func)) {
 		return 0;
 	}
+	CollectorAttrIndex *index = queryIndex(*table);
+	ClassAd *ad = NULL;
+	if (index && table->lookup(hk, ad) != -1) {
+		index->remove(ad);
+	}
 	return !table->remove(hk);
 }
 
@@ -1075,6 +1334,9 @@ updateClassAd (CollectorHashTable &hashTable,
 			new_ad->Assign( ATTR_LAST_FORWARDED, (int)time(NULL) );
 		}
 
+		CollectorAttrIndex *index = queryIndex(hashTable);
+		if (index) { index->insert(new_ad); }
+
 		return new_ad;
 	}
 	else
@@ -1124,7 +1386,13 @@ updateClassAd (CollectorHashTable &hashTable,
 
 		if (isSelfAd(old_ad)) { __self_ad__ = new_ad; }
 
-		delete old_ad;
+		CollectorAttrIndex *index = queryIndex(hashTable);
+		if (index) {
+			index->remove(old_ad);
+			index->insert(new_ad);
+		}
+
+		retireAd(old_ad);
 
 		insert = 0;
 		return new_ad;
@@ -1160,6 +1428,8 @@ mergeClassAd (CollectorHashTable &hashTable,
 		dprintf (D_FULLDEBUG, "%s: Merging update for ... \"%s\"\n",
 				 adType, hashString.Value() );
 
+		old_ad = writableAd(hashTable, hk, old_ad);
+
 			// Do not allow changes to some attributes
 		ClassAd new_ad_copy(*new_ad);
 		new_ad_copy.Delete(ATTR_AUTHENTICATED_IDENTITY);
@@ -1168,12 +1438,157 @@ mergeClassAd (CollectorHashTable &hashTable,
 
 		// Now, finally, merge the new ClassAd into the old one
 		MergeClassAds(old_ad,&new_ad_copy,true);
+
+		CollectorAttrIndex *index = queryIndex(hashTable);
+		if (index) { index->reindex(old_ad); }
 	}
 	delete new_ad;
 	return old_ad;
 }
 
 
+// Merge a delta update from a startd (see STARTD_SEND_DELTA_UPDATES) into the
+// stored startd ad.  The delta holds the attributes that changed since the
+// update whose UpdateDeltaGeneration is the UpdateDeltaBase of the delta, so
+// if the stored ad is not that update (because we missed an update, or we
+// restarted) the delta is refused, and the ad will be brought up to date by
+// the next full update from the startd.
+// Returns the stored ad and deletes the delta on success, otherwise returns
+// NULL and the caller deletes the delta.
+ClassAd * CollectorEngine::
+mergeStartdAdDelta (ClassAd *delta_ad,
+					AdNameHashKey &hk,
+					const MyString &hashString,
+					int  &insert,
+					Sock *sock)
+{
+	ClassAd *old_ad = NULL;
+	long long base = -1, stored = 0;
+	delta_ad->LookupInteger(ATTR_UPDATE_DELTA_BASE, base);
+	if (StartdAds.lookup(hk, old_ad) == -1 ||
+		! old_ad->LookupInteger(ATTR_UPDATE_DELTA_GENERATION, stored) || stored != base)
+	{
+		dprintf(D_FULLDEBUG, "StartdAd     : Ignoring delta update for \"%s\" from generation %lld, have %lld\n",
+				hashString.Value(), base, old_ad ? stored : -1LL);
+		requestFullStartdUpdate(delta_ad);
+		insert = -5;
+		return NULL;
+	}
+
+	StringList removed;
+	std::string removed_str;
+	if (delta_ad->LookupString(ATTR_UPDATE_DELTA_REMOVED, removed_str)) {
+		removed.initializeFromString(removed_str.c_str());
+	}
+	delta_ad->Delete(ATTR_UPDATE_DELTA_BASE);
+	delta_ad->Delete(ATTR_UPDATE_DELTA_REMOVED);
+	const char *attr;
+
+		// COLLECTOR_REQUIREMENTS must be evaluated against the whole ad
+	if (m_collector_requirements) {
+		ClassAd merged(*old_ad);
+		MergeClassAds(&merged, delta_ad, true);
+		removed.rewind();
+		while ((attr = removed.next())) { merged.Delete(attr); }
+		if ( ! ValidateClassAd(UPDATE_STARTD_AD, &merged, sock)) {
+			insert = -4;
+			return NULL;
+		}
+	}
+
+	dprintf(D_FULLDEBUG, "StartdAd     : Merging delta update for ... \"%s\"\n", hashString.Value());
+	collectorStats->update("Start", old_ad, delta_ad);
+
+	old_ad = writableAd(StartdAds, hk, old_ad);
+
+	bool forward = false;
+	int last_forwarded = 0;
+	if (m_forwardFilteringEnabled) {
+		old_ad->LookupInteger(ATTR_LAST_FORWARDED, last_forwarded);
+		if (last_forwarded + m_forwardInterval < time(NULL)) {
+			forward = true;
+		} else {
+			classad::Value old_val;
+			classad::Value new_val;
+			m_forwardWatchList.rewind();
+			while ((attr = m_forwardWatchList.next())) {
+				if (delta_ad->LookupExpr(attr) &&
+					old_ad->EvaluateAttr(attr, old_val) &&
+					delta_ad->EvaluateAttr(attr, new_val) &&
+					! new_val.SameAs(old_val))
+				{
+					forward = true;
+					break;
+				}
+			}
+		}
+	}
+
+		// the identity of this update replaces that of the last one, even if it has none
+	if ( ! delta_ad->LookupExpr(ATTR_AUTHENTICATED_IDENTITY)) {
+		old_ad->Delete(ATTR_AUTHENTICATED_IDENTITY);
+		old_ad->Delete(ATTR_AUTHENTICATION_METHOD);
+	}
+	MergeClassAds(old_ad, delta_ad, true);
+	removed.rewind();
+	while ((attr = removed.next())) { old_ad->Delete(attr); }
+	old_ad->Assign(ATTR_LAST_HEARD_FROM, (int)time(NULL));
+
+	if (m_forwardFilteringEnabled) {
+		old_ad->Assign(ATTR_SHOULD_FORWARD, forward);
+		old_ad->Assign(ATTR_LAST_FORWARDED, forward ? (int)time(NULL) : last_forwarded);
+	}
+
+	CollectorAttrIndex *index = queryIndex(StartdAds);
+	if (index) { index->reindex(old_ad); }
+
+	insert = 0;
+	delete delta_ad;
+	return old_ad;
+}
+
+
+// Ask the startd that sent a delta update we could not merge to send full
+// updates, rather than leave its ad stale until the next full update it
+// would send anyway.  Each startd is asked at most once every
+// FULL_UPDATE_REQUEST_INTERVAL seconds.  The request is not acknowledged,
+// if it is lost the next delta that can't be merged asks again.
+#define FULL_UPDATE_REQUEST_INTERVAL 30
+
+void CollectorEngine::
+requestFullStartdUpdate (ClassAd *delta_ad)
+{
+	std::string addr;
+	if ( ! delta_ad->LookupString(ATTR_MY_ADDRESS, addr) || addr.empty()) {
+		return;
+	}
+
+	time_t now = time(NULL);
+	std::map<std::string, time_t>::iterator it = m_fullUpdateRequests.find(addr);
+	if (it != m_fullUpdateRequests.end() && now - it->second < FULL_UPDATE_REQUEST_INTERVAL) {
+		return;
+	}
+	if (m_fullUpdateRequests.size() > 1000) {
+		for (it = m_fullUpdateRequests.begin(); it != m_fullUpdateRequests.end(); ) {
+			if (now - it->second >= FULL_UPDATE_REQUEST_INTERVAL) {
+				m_fullUpdateRequests.erase(it++);
+			} else {
+				++it;
+			}
+		}
+	}
+	m_fullUpdateRequests[addr] = now;
+
+	dprintf(D_FULLDEBUG, "StartdAd     : Asking the startd at %s for a full update\n", addr.c_str());
+	classy_counted_ptr<Daemon> startd = new Daemon(DT_STARTD, addr.c_str());
+	classy_counted_ptr<DCCommandOnlyMsg> msg = new DCCommandOnlyMsg(STARTD_FULL_UPDATE_REQUEST);
+	msg->setStreamType(startd->hasUDPCommandPort() ? Stream::safe_sock : Stream::reli_sock);
+	msg->setTimeout(20);
+	msg->setDeadlineTimeout(60);
+	startd->sendMsg(msg.get());
+}
+
+
 void
 CollectorEngine::
 housekeeper()
@@ -1243,8 +1658,10 @@ housekeeper()
 }
 
 void CollectorEngine::
-cleanHashTable (CollectorHashTable &hashTable, time_t now, HashFunc makeKey) const
+cleanHashTable (CollectorHashTable &hashTable, time_t now, HashFunc makeKey)
 {
+	CollectorAttrIndex *index = queryIndex(hashTable);
+
 	ClassAd  *ad;
 	int   	 timeStamp;
 	int		 max_lifetime;
@@ -1283,8 +1700,10 @@ cleanHashTable (CollectorHashTable &hashTable, time_t now, HashFunc makeKey) con
 				   potentially mark the ad absent. if expire() returns false, then delete
 				   the ad as planned; if it return true, it was likely marked as absent,
 				   so then this ad should NOT be deleted. */
+				ad = writableAd( hashTable, hk, ad );
 				if ( CollectorDaemon::offline_plugin_.expire( *ad ) == true ) {
 					// plugin say to not delete this ad, so continue
+					if (index) { index->reindex(ad); }
 					continue;
 				} else {
 					dprintf (D_ALWAYS,"\t\t**** Removing stale ad: \"%s\"\n", hkString.Value() );
@@ -1294,7 +1713,8 @@ cleanHashTable (CollectorHashTable &hashTable, time_t now, HashFunc makeKey) con
 			{
 				dprintf (D_ALWAYS, "\t\tError while removing ad\n");
 			}
-			delete ad;
+			if (index) { index->remove(ad); }
+			retireAd(ad);
 		}
 	}
 }
@@ -1367,9 +1787,10 @@ CollectorEngine::LookupByAdType(AdTypes adType,
 }
 
 
-static void
+void CollectorEngine::
 purgeHashTable( CollectorHashTable &table )
 {
+	CollectorAttrIndex *index = queryIndex(table);
 	ClassAd* ad;
 	AdNameHashKey hk;
 	table.startIterations();
@@ -1377,7 +1798,8 @@ purgeHashTable( CollectorHashTable &table )
 		if( table.remove(hk) == -1 ) {
 			dprintf( D_ALWAYS, "\t\tError while removing ad\n" );
 		}		
-		delete ad;
+		if (index) { index->remove(ad); }
+		retireAd(ad);
 	}
 }
 
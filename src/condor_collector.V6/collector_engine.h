@@ -23,8 +23,12 @@
 #include "condor_classad.h"
 
 #include "collector_stats.h"
+#include "collector_index.h"
 #include "hashkey.h"
 
+#include <deque>
+#include <set>
+
 class CollectorEngine : public Service
 {
   public:
@@ -70,6 +74,36 @@ class CollectorEngine : public Service
 	// walk specified hash table with the given visit procedure
 	int walkHashTable (AdTypes, int (*)(ClassAd *));
 
+	// as above, but if the table has a query index, only visit the ads
+	// that may match the constraint.  The visit procedure must still
+	// evaluate the constraint itself.
+	int walkHashTable (AdTypes, classad::ExprTree *constraint, int (*)(ClassAd *));
+
+	// set the attributes to keep query indexes on, from
+	// COLLECTOR_QUERY_INDEX_ATTRS.  Rebuilds the indexes if the list changed.
+	void setQueryIndexAttrs (const char *attrs);
+
+	// must be called after an ad in one of the tables is changed in
+	// place, rather than replaced by a new update, so the query index
+	// sees the new values.
+	void reindexAd (ClassAd *ad);
+
+	// Snapshots for the query threads (see COLLECTOR_QUERY_THREADS).
+	// takeSnapshot() fills ads with the ads of the given type that may
+	// match the constraint, as walkHashTable() would visit them.  Until
+	// the snapshot is released, none of these ads is changed or deleted:
+	// an ad that is replaced or removed is kept until no snapshot can
+	// still refer to it, and an ad that would be changed in place is
+	// first replaced by a copy.  Only the main thread may call these.
+	unsigned long takeSnapshot (AdTypes, classad::ExprTree *constraint, std::vector<ClassAd*> &ads);
+	void releaseSnapshot (unsigned long snapshot);
+
+	// returns the ad to change in place of ad, which must be an ad of the
+	// given type in one of the tables.  If a snapshot is active, this is
+	// a copy that has replaced ad in its table.  Returns NULL if the ad
+	// could not be found.
+	ClassAd *writableAd (AdTypes, ClassAd *ad);
+
 	// Walk through a specific (non-generic, non-ANY) table using a lambda
 	template<typename T>
 	int walkConcreteTable(AdTypes adType, T scanFunction) {
@@ -154,7 +188,8 @@ class CollectorEngine : public Service
 
 	void  housekeeper ();
 	int  housekeeperTimerID;
-	void cleanHashTable (CollectorHashTable &, time_t, HashFunc) const;
+	void cleanHashTable (CollectorHashTable &, time_t, HashFunc);
+	void purgeHashTable (CollectorHashTable &);
 	ClassAd* updateClassAd(CollectorHashTable&,const char*, const char *,
 						   ClassAd*,AdNameHashKey&, const MyString &, int &, 
 						   const condor_sockaddr& );
@@ -168,6 +203,35 @@ class CollectorEngine : public Service
 							int  &insert,
 							const condor_sockaddr& /*from*/ );
 
+	ClassAd * mergeStartdAdDelta (ClassAd *delta_ad,
+								  AdNameHashKey &hk,
+								  const MyString &hashString,
+								  int  &insert,
+								  Sock *sock);
+
+	// the startds we asked for a full update because we could not merge
+	// a delta update from them, and when we last asked
+	std::map<std::string, time_t> m_fullUpdateRequests;
+	void requestFullStartdUpdate (ClassAd *delta_ad);
+
+	// query indexes, for the tables returned by LookupByAdType only
+	classad::References m_queryIndexAttrs;
+	std::map<const CollectorHashTable*, CollectorAttrIndex*> m_queryIndexes;
+	CollectorAttrIndex *queryIndex (const CollectorHashTable &table) const;
+	void clearQueryIndexes ();
+
+	// snapshots taken by takeSnapshot() and not yet released, and the
+	// ads that have left the tables since the oldest of them, with the
+	// number of the last snapshot taken before each was removed
+	unsigned long m_snapshotSeq;
+	std::multiset<unsigned long> m_snapshots;
+	std::deque<std::pair<unsigned long, ClassAd*> > m_retiredAds;
+	static std::vector<ClassAd*> *snapshotAds;
+	static int snapshotScanFunc (ClassAd *ad);
+	// delete an ad that has been removed from its table
+	void retireAd (ClassAd *ad);
+	ClassAd *writableAd (CollectorHashTable &, AdNameHashKey &, ClassAd *ad);
+
 	// support for dynamically created tables
 	CollectorHashTable *findOrCreateTable(MyString &str);
 
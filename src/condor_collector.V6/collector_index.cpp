@@ -0,0 +1,326 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2019, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_classad.h"
+#include "condor_debug.h"
+#include "compat_classad_util.h"
+#include "stl_string_utils.h"
+#include "collector_index.h"
+
+#include <math.h>
+
+// Attr or MY.Attr, which is how a query constraint refers to the
+// attributes of the ad it is evaluated against.
+static bool
+IsAdAttrRef( classad::ExprTree *expr, std::string &attr )
+{
+	expr = SkipExprParens( expr );
+	if ( !expr || expr->GetKind() != classad::ExprTree::ATTRREF_NODE ) {
+		return false;
+	}
+
+	classad::ExprTree *scope = NULL;
+	bool absolute = false;
+	((classad::AttributeReference*)expr)->GetComponents( scope, attr, absolute );
+	if ( absolute ) {
+		return false;
+	}
+	if ( !scope ) {
+		return true;
+	}
+
+	std::string scope_name;
+	return ExprTreeIsAttrRef( SkipExprParens( scope ), scope_name, &absolute ) &&
+		!absolute && strcasecmp( scope_name.c_str(), "MY" ) == 0;
+}
+
+static bool
+IsLiteralValue( classad::ExprTree *expr, classad::Value &val )
+{
+	expr = SkipExprParens( expr );
+	if ( !expr || expr->GetKind() != classad::ExprTree::LITERAL_NODE ) {
+		return false;
+	}
+		// GetValue() applies the number factor, e.g. 2G
+	((classad::Literal*)expr)->GetValue( val );
+	return true;
+}
+
+// Integers and reals compare with each other; booleans are left out
+// because the index keeps them with the other non-indexable values.
+static bool
+IsIndexableNumber( const classad::Value &val, double &num )
+{
+	long long ival;
+	if ( val.IsIntegerValue( ival ) ) {
+		num = (double)ival;
+		return true;
+	}
+	return val.IsRealValue( num ) && !isnan( num );
+}
+
+// Attr <op> literal or literal <op> Attr, with the operator flipped in the
+// second case so that it always reads Attr <op> literal.
+static bool
+IsAttrCmpLiteral( classad::ExprTree *tree, classad::Operation::OpKind &op,
+				  std::string &attr, classad::Value &val )
+{
+	tree = SkipExprParens( tree );
+	if ( !tree || tree->GetKind() != classad::ExprTree::OP_NODE ) {
+		return false;
+	}
+
+	classad::ExprTree *t1, *t2, *t3;
+	((classad::Operation*)tree)->GetComponents( op, t1, t2, t3 );
+	switch ( op ) {
+	case classad::Operation::EQUAL_OP:
+	case classad::Operation::META_EQUAL_OP:
+	case classad::Operation::LESS_THAN_OP:
+	case classad::Operation::LESS_OR_EQUAL_OP:
+	case classad::Operation::GREATER_THAN_OP:
+	case classad::Operation::GREATER_OR_EQUAL_OP:
+		break;
+	default:
+		return false;
+	}
+
+	if ( IsAdAttrRef( t1, attr ) && IsLiteralValue( t2, val ) ) {
+		return true;
+	}
+	if ( !IsLiteralValue( t1, val ) || !IsAdAttrRef( t2, attr ) ) {
+		return false;
+	}
+	switch ( op ) {
+	case classad::Operation::LESS_THAN_OP:
+		op = classad::Operation::GREATER_THAN_OP; break;
+	case classad::Operation::LESS_OR_EQUAL_OP:
+		op = classad::Operation::GREATER_OR_EQUAL_OP; break;
+	case classad::Operation::GREATER_THAN_OP:
+		op = classad::Operation::LESS_THAN_OP; break;
+	case classad::Operation::GREATER_OR_EQUAL_OP:
+		op = classad::Operation::LESS_OR_EQUAL_OP; break;
+	default:
+		break;
+	}
+	return true;
+}
+
+// If any clause of a && chain is not true, neither is the chain, so an
+// ad must satisfy every clause to match the whole expression.
+static void
+SplitAndClauses( classad::ExprTree *tree, std::vector<classad::ExprTree*> &clauses )
+{
+	tree = SkipExprParens( tree );
+	if ( !tree ) {
+		return;
+	}
+	if ( tree->GetKind() == classad::ExprTree::OP_NODE ) {
+		classad::Operation::OpKind op;
+		classad::ExprTree *t1, *t2, *t3;
+		((classad::Operation*)tree)->GetComponents( op, t1, t2, t3 );
+		if ( op == classad::Operation::LOGICAL_AND_OP ) {
+			SplitAndClauses( t1, clauses );
+			SplitAndClauses( t2, clauses );
+			return;
+		}
+	}
+	clauses.push_back( tree );
+}
+
+
+CollectorAttrIndex::CollectorAttrIndex( const classad::References &attrs )
+{
+	m_attrs.resize( attrs.size() );
+	size_t i = 0;
+	for ( classad::References::const_iterator it = attrs.begin(); it != attrs.end(); ++it, ++i ) {
+		m_attrs[i].attr = *it;
+	}
+}
+
+const CollectorAttrIndex::AttrIndex *
+CollectorAttrIndex::findAttr( const std::string &attr ) const
+{
+	for ( size_t i = 0; i < m_attrs.size(); ++i ) {
+		if ( strcasecmp( m_attrs[i].attr.c_str(), attr.c_str() ) == 0 ) {
+			return &m_attrs[i];
+		}
+	}
+	return NULL;
+}
+
+void
+CollectorAttrIndex::insert( ClassAd *ad )
+{
+	if ( contains( ad ) ) {
+		remove( ad );
+	}
+
+	std::vector<Posting> &postings = m_postings[ad];
+	postings.resize( m_attrs.size() );
+	for ( size_t i = 0; i < m_attrs.size(); ++i ) {
+		AttrIndex &idx = m_attrs[i];
+		Posting &posting = postings[i];
+
+		classad::ExprTree *tree = SkipExprEnvelope( ad->Lookup( idx.attr ) );
+		if ( !tree ) {
+			posting.kind = Posting::ABSENT;
+			continue;
+		}
+
+		classad::Value val;
+		std::string str;
+		double num;
+		if ( IsLiteralValue( tree, val ) && val.IsStringValue( str ) ) {
+			lower_case( str );
+			posting.kind = Posting::STRING;
+			posting.str = idx.strings.insert( StringMap::value_type( str, AdSet() ) ).first;
+			posting.str->second.insert( ad );
+		} else if ( IsLiteralValue( tree, val ) && IsIndexableNumber( val, num ) ) {
+			posting.kind = Posting::NUMBER;
+			posting.num = idx.numbers.insert( NumberMap::value_type( num, ad ) );
+		} else {
+			posting.kind = Posting::OTHER;
+			idx.others.insert( ad );
+		}
+	}
+}
+
+void
+CollectorAttrIndex::remove( ClassAd *ad )
+{
+	std::map<ClassAd*, std::vector<Posting> >::iterator it = m_postings.find( ad );
+	if ( it == m_postings.end() ) {
+		return;
+	}
+
+	for ( size_t i = 0; i < m_attrs.size(); ++i ) {
+		AttrIndex &idx = m_attrs[i];
+		Posting &posting = it->second[i];
+		switch ( posting.kind ) {
+		case Posting::STRING:
+			posting.str->second.erase( ad );
+			if ( posting.str->second.empty() ) {
+				idx.strings.erase( posting.str );
+			}
+			break;
+		case Posting::NUMBER:
+			idx.numbers.erase( posting.num );
+			break;
+		case Posting::OTHER:
+			idx.others.erase( ad );
+			break;
+		case Posting::ABSENT:
+			break;
+		}
+	}
+	m_postings.erase( it );
+}
+
+bool
+CollectorAttrIndex::candidates( classad::ExprTree *constraint, std::vector<ClassAd*> &ads ) const
+{
+	std::vector<classad::ExprTree*> clauses;
+	SplitAndClauses( constraint, clauses );
+
+	const AttrIndex *best = NULL;
+	const AdSet *best_set = NULL;
+	NumberMap::const_iterator best_lo, best_hi;
+	size_t best_count = 0;
+
+	for ( size_t i = 0; i < clauses.size(); ++i ) {
+		classad::Operation::OpKind op;
+		std::string attr;
+		classad::Value val;
+		if ( !IsAttrCmpLiteral( clauses[i], op, attr, val ) ) {
+			continue;
+		}
+		const AttrIndex *idx = findAttr( attr );
+		if ( !idx ) {
+			continue;
+		}
+
+		const AdSet *set = NULL;
+		NumberMap::const_iterator lo = idx->numbers.end();
+		NumberMap::const_iterator hi = idx->numbers.end();
+		size_t count = 0;
+		std::string str;
+		double num;
+		if ( val.IsStringValue( str ) ) {
+			if ( op != classad::Operation::EQUAL_OP &&
+				 op != classad::Operation::META_EQUAL_OP ) {
+				continue;
+			}
+			lower_case( str );
+			StringMap::const_iterator it = idx->strings.find( str );
+			if ( it != idx->strings.end() ) {
+				set = &it->second;
+				count = set->size();
+			}
+		} else if ( IsIndexableNumber( val, num ) ) {
+				// Bounds are always inclusive: integers too large to
+				// convert exactly to a double may compare equal here
+				// when they are not.  The caller evaluates the real
+				// comparison anyway.
+			switch ( op ) {
+			case classad::Operation::EQUAL_OP:
+			case classad::Operation::META_EQUAL_OP:
+				lo = idx->numbers.lower_bound( num );
+				hi = idx->numbers.upper_bound( num );
+				break;
+			case classad::Operation::LESS_THAN_OP:
+			case classad::Operation::LESS_OR_EQUAL_OP:
+				lo = idx->numbers.begin();
+				hi = idx->numbers.upper_bound( num );
+				break;
+			default:
+				lo = idx->numbers.lower_bound( num );
+				hi = idx->numbers.end();
+				break;
+			}
+			count = std::distance( lo, hi );
+		} else {
+			continue;
+		}
+		count += idx->others.size();
+
+		if ( !best || count < best_count ) {
+			best = idx;
+			best_set = set;
+			best_lo = lo;
+			best_hi = hi;
+			best_count = count;
+		}
+	}
+
+	if ( !best ) {
+		return false;
+	}
+
+	ads.clear();
+	ads.reserve( best_count );
+	if ( best_set ) {
+		ads.insert( ads.end(), best_set->begin(), best_set->end() );
+	}
+	for ( NumberMap::const_iterator it = best_lo; it != best_hi; ++it ) {
+		ads.push_back( it->second );
+	}
+	ads.insert( ads.end(), best->others.begin(), best->others.end() );
+	return true;
+}
@@ -0,0 +1,87 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2019, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef __COLLECTOR_INDEX_H__
+#define __COLLECTOR_INDEX_H__
+
+#include "condor_classad.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+// Secondary indexes over the ads of one collector table, used to cut
+// down the number of ads a query constraint is evaluated against.
+//
+// For each indexed attribute, the ads whose value is a string literal are
+// kept by the lower-cased string (== on strings ignores case), and the ads
+// whose value is a number are kept ordered by value.  Ads where the
+// attribute is any other expression are always candidates.  Ads that do
+// not have the attribute at all can never satisfy a comparison of it with
+// a literal, so they are never candidates.
+//
+// The index points at the ads of the table but does not own them.  The
+// CollectorEngine calls insert() and remove() as ads enter and leave the
+// table, and reindex() after an ad in the table is changed in place.
+class CollectorAttrIndex {
+ public:
+	CollectorAttrIndex(const classad::References &attrs);
+
+	void insert(ClassAd *ad);
+	void remove(ClassAd *ad);
+	void reindex(ClassAd *ad) { remove(ad); insert(ad); }
+	bool contains(ClassAd *ad) const { return m_postings.count(ad) != 0; }
+	size_t size() const { return m_postings.size(); }
+
+		// Look through the top level && clauses of constraint for a
+		// comparison between an indexed attribute and a literal, and
+		// pick the one that selects the fewest ads.  Returns false if
+		// there is no such clause, in which case all ads must be
+		// checked.  Otherwise ads is set to a superset of the ads that
+		// match; the caller must still evaluate the whole constraint
+		// against each of them.
+	bool candidates(classad::ExprTree *constraint, std::vector<ClassAd*> &ads) const;
+
+ private:
+	typedef std::set<ClassAd*> AdSet;
+	typedef std::map<std::string, AdSet> StringMap;
+	typedef std::multimap<double, ClassAd*> NumberMap;
+
+	struct AttrIndex {
+		std::string attr;
+		StringMap strings;
+		NumberMap numbers;
+		AdSet others;
+	};
+
+		// where an ad was put in one AttrIndex, so it can be taken out
+		// again even if the ad has since been changed.
+	struct Posting {
+		enum Kind { ABSENT, STRING, NUMBER, OTHER } kind;
+		StringMap::iterator str;
+		NumberMap::iterator num;
+	};
+
+	const AttrIndex *findAttr(const std::string &attr) const;
+
+	std::vector<AttrIndex> m_attrs;
+	std::map<ClassAd*, std::vector<Posting> > m_postings;
+};
+
+#endif
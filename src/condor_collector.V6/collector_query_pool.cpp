@@ -0,0 +1,280 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2019, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_daemon_core.h"
+#include "collector_query_pool.h"
+
+CollectorQuery::CollectorQuery()
+	: sock(NULL), query(NULL), whichAds(NO_AD), is_locate(false),
+	filter_private_ads(true), filter(NULL), resultLimit(INT_MAX),
+	snapshot(0), begin(0.0)
+{
+	subsys[0] = 0;
+}
+
+CollectorQuery::~CollectorQuery()
+{
+	delete sock;
+	delete query;
+}
+
+CollectorQueryPool::CollectorQueryPool()
+	: m_num_threads(0), m_max_pending(0), m_active(0), m_shutdown(false),
+	m_run(NULL), m_done_handler(NULL), m_pipe_fd(-1)
+{
+	m_pipe[0] = m_pipe[1] = -1;
+#ifdef HAVE_PTHREADS
+	pthread_mutex_init(&m_lock, NULL);
+	pthread_cond_init(&m_work_cv, NULL);
+#endif
+}
+
+CollectorQueryPool::~CollectorQueryPool()
+{
+	stop();
+#ifdef HAVE_PTHREADS
+	pthread_cond_destroy(&m_work_cv);
+	pthread_mutex_destroy(&m_lock);
+#endif
+}
+
+bool
+CollectorQueryPool::start(int num_threads, int max_pending, QueryHandler run, QueryHandler done)
+{
+	if (num_threads < 1 || m_num_threads > 0) {
+		return false;
+	}
+
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+	m_max_pending = max_pending;
+	m_run = run;
+	m_done_handler = done;
+
+	if (!daemonCore->Create_Pipe(m_pipe, true, false, true, true) ||
+		!daemonCore->Get_Pipe_FD(m_pipe[1], &m_pipe_fd))
+	{
+		dprintf(D_ALWAYS, "QueryThreads: failed to create pipe\n");
+		if (m_pipe[0] != -1) {
+			daemonCore->Close_Pipe(m_pipe[0]);
+			daemonCore->Close_Pipe(m_pipe[1]);
+		}
+		m_pipe[0] = m_pipe[1] = -1;
+		m_pipe_fd = -1;
+		return false;
+	}
+	daemonCore->Register_Pipe(m_pipe[0], "query thread pipe",
+		(PipeHandlercpp)&CollectorQueryPool::reapQueries,
+		"CollectorQueryPool::reapQueries", this);
+
+		// dprintf only takes its lock when it knows about threads.
+	dprintf_make_thread_safe();
+
+	m_shutdown = false;
+	for (int i = 0; i < num_threads; ++i) {
+		pthread_t tid;
+		int rc = pthread_create(&tid, NULL, CollectorQueryPool::threadMain, this);
+		if (rc != 0) {
+			EXCEPT("Failed to create query thread: %s", strerror(rc));
+		}
+		m_threads.push_back(tid);
+	}
+	m_num_threads = num_threads;
+
+	dprintf(D_ALWAYS, "Queries will be answered by %d thread%s\n",
+			num_threads, num_threads == 1 ? "" : "s");
+	return true;
+#else
+	(void)max_pending;
+	(void)run;
+	(void)done;
+	dprintf(D_ALWAYS, "QueryThreads: threads are not supported on this platform\n");
+	return false;
+#endif
+}
+
+void
+CollectorQueryPool::stop()
+{
+	if (m_num_threads == 0) {
+		return;
+	}
+
+#ifdef HAVE_PTHREADS
+	pthread_mutex_lock(&m_lock);
+	m_shutdown = true;
+	pthread_cond_broadcast(&m_work_cv);
+	pthread_mutex_unlock(&m_lock);
+
+	for (size_t i = 0; i < m_threads.size(); ++i) {
+		pthread_join(m_threads[i], NULL);
+	}
+	m_threads.clear();
+#endif
+	m_num_threads = 0;
+
+		// the threads are gone, so everything left is ours
+	std::deque<CollectorQuery *> left;
+	left.swap(m_done);
+	left.insert(left.end(), m_high_prio.begin(), m_high_prio.end());
+	left.insert(left.end(), m_low_prio.begin(), m_low_prio.end());
+	m_high_prio.clear();
+	m_low_prio.clear();
+	for (size_t i = 0; i < left.size(); ++i) {
+		m_done_handler(left[i]);
+	}
+
+	if (m_pipe[0] != -1) {
+		daemonCore->Close_Pipe(m_pipe[0]);
+		daemonCore->Close_Pipe(m_pipe[1]);
+		m_pipe[0] = m_pipe[1] = -1;
+		m_pipe_fd = -1;
+	}
+}
+
+int
+CollectorQueryPool::numActive()
+{
+	int n;
+#ifdef HAVE_PTHREADS
+	pthread_mutex_lock(&m_lock);
+#endif
+	n = m_active;
+#ifdef HAVE_PTHREADS
+	pthread_mutex_unlock(&m_lock);
+#endif
+	return n;
+}
+
+int
+CollectorQueryPool::numPending()
+{
+	int n;
+#ifdef HAVE_PTHREADS
+	pthread_mutex_lock(&m_lock);
+#endif
+	n = (int)(m_high_prio.size() + m_low_prio.size());
+#ifdef HAVE_PTHREADS
+	pthread_mutex_unlock(&m_lock);
+#endif
+	return n;
+}
+
+bool
+CollectorQueryPool::submit(CollectorQuery *q, bool high_prio)
+{
+	if (m_num_threads == 0) {
+		return false;
+	}
+
+	bool queued = false;
+#ifdef HAVE_PTHREADS
+	pthread_mutex_lock(&m_lock);
+#endif
+	int pending = (int)(m_high_prio.size() + m_low_prio.size());
+	if (pending < m_max_pending) {
+		if (high_prio) {
+			m_high_prio.push_back(q);
+		} else {
+			m_low_prio.push_back(q);
+		}
+		queued = true;
+	}
+#ifdef HAVE_PTHREADS
+	if (queued) {
+		pthread_cond_signal(&m_work_cv);
+	}
+	pthread_mutex_unlock(&m_lock);
+#endif
+	return queued;
+}
+
+#ifdef HAVE_PTHREADS
+void *
+CollectorQueryPool::threadMain(void *arg)
+{
+	CollectorQueryPool *pool = (CollectorQueryPool *)arg;
+
+#ifndef WIN32
+		// leave all signal handling to the daemon core thread
+	sigset_t mask;
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+#endif
+
+	pthread_mutex_lock(&pool->m_lock);
+	for (;;) {
+		while (!pool->m_shutdown && pool->m_high_prio.empty() && pool->m_low_prio.empty()) {
+			pthread_cond_wait(&pool->m_work_cv, &pool->m_lock);
+		}
+		if (pool->m_shutdown) {
+			break;
+		}
+		CollectorQuery *q;
+		if (!pool->m_high_prio.empty()) {
+			q = pool->m_high_prio.front();
+			pool->m_high_prio.pop_front();
+		} else {
+			q = pool->m_low_prio.front();
+			pool->m_low_prio.pop_front();
+		}
+		pool->m_active++;
+		pthread_mutex_unlock(&pool->m_lock);
+
+		pool->m_run(q);
+
+		pthread_mutex_lock(&pool->m_lock);
+		pool->m_active--;
+		pool->m_done.push_back(q);
+
+			// wake up the main thread.  If the pipe is full, there
+			// are wake ups pending already.
+		char c = 0;
+		if (write(pool->m_pipe_fd, &c, 1) < 0 && errno != EAGAIN) {
+			dprintf(D_ALWAYS, "QueryThreads: failed to write to pipe: %s\n",
+					strerror(errno));
+		}
+	}
+	pthread_mutex_unlock(&pool->m_lock);
+	return NULL;
+}
+#endif
+
+int
+CollectorQueryPool::reapQueries(int pipe_end)
+{
+	char buf[64];
+	while (daemonCore->Read_Pipe(pipe_end, buf, sizeof(buf)) > 0) {
+	}
+
+	std::deque<CollectorQuery *> done;
+#ifdef HAVE_PTHREADS
+	pthread_mutex_lock(&m_lock);
+#endif
+	done.swap(m_done);
+#ifdef HAVE_PTHREADS
+	pthread_mutex_unlock(&m_lock);
+#endif
+
+	for (size_t i = 0; i < done.size(); ++i) {
+		m_done_handler(done[i]);
+	}
+	return TRUE;
+}
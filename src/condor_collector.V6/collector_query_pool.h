@@ -0,0 +1,142 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2019, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef __COLLECTOR_QUERY_POOL_H__
+#define __COLLECTOR_QUERY_POOL_H__
+
+#include "condor_classad.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+// A query that has been read and prepared by the main thread, to be
+// answered by a CollectorQueryPool thread.
+struct CollectorQuery {
+	CollectorQuery();
+	~CollectorQuery();	// deletes sock and query
+
+	Stream *sock;
+	ClassAd *query;
+	AdTypes whichAds;
+	bool is_locate;
+	bool filter_private_ads;
+	char subsys[15];
+
+		// the constraint (owned by query), the MyType to restrict generic
+		// queries to, and the maximum number of results
+	classad::ExprTree *filter;
+	std::string adType;
+	int resultLimit;
+
+		// the ads that may match, see CollectorEngine::takeSnapshot()
+	unsigned long snapshot;
+	std::vector<ClassAd*> ads;
+
+	double begin;
+};
+
+// A pool of threads inside the collector that answer queries, used in
+// place of forking a worker process per query.  See
+// COLLECTOR_QUERY_THREADS.
+//
+// The main thread reads each query, rewrites its constraint and takes a
+// snapshot of the ads that may match it from the CollectorEngine, then
+// submits it to the pool.  A pool thread evaluates the constraint
+// against the snapshot and sends the results, while the main thread
+// goes on handling updates.  The engine does not change or delete any
+// ad in a snapshot until it is released.
+//
+// Once a query has been answered, the pool thread hands it back to the
+// main thread through a DaemonCore pipe, so that the snapshot is
+// released and the socket is closed by the main thread.
+//
+// A pool thread sends the results with putClassAd().  What that touches
+// is either the query's own or only read while threads run:
+//   - per query: the socket, with its buffers, encryption state and peer
+//     version, and the projection and the MatchClassAd it is evaluated
+//     with (see send_query_response())
+//   - per call: the ClassAdUnParser and the buffers that putClassAd()
+//     makes on its stack
+//   - read only: the ads of the snapshot and the expressions they share
+//     through the ClassAd cache, which are parsed when read since lazy
+//     parsing is off with query threads; the pool threads take no
+//     references to cache entries, so only the main thread changes the
+//     cache.  Also the table of private attributes, and the flags set by
+//     AttrList_setPublishServerTime() and AttrList_setSendBinary(), which
+//     only the main thread sets, on reconfig.
+// dprintf() is made thread safe by start().  test_classad_put_threads
+// sends ads read through the cache from several threads at once.
+class CollectorQueryPool : public Service {
+ public:
+	typedef void (*QueryHandler)(CollectorQuery *);
+
+	CollectorQueryPool();
+	~CollectorQueryPool();
+
+		// Start num_threads threads.  run is called by a pool thread
+		// to answer a query, done by the main thread afterwards; done
+		// must delete the query.  Returns false if the threads or the
+		// pipe could not be created, or threads are not supported.
+	bool start(int num_threads, int max_pending, QueryHandler run, QueryHandler done);
+		// Wait for the threads to finish the queries they are
+		// answering, and drop the ones that have not been started.
+	void stop();
+
+	int numThreads() const { return m_num_threads; }
+		// queries being answered, and queries waiting for a thread
+	int numActive();
+	int numPending();
+
+		// Queue a query.  Returns false, and leaves the query to the
+		// caller, if too many queries are already waiting.
+	bool submit(CollectorQuery *q, bool high_prio);
+
+ private:
+	int reapQueries(int pipe_end);
+#ifdef HAVE_PTHREADS
+	static void *threadMain(void *arg);
+#endif
+
+	std::deque<CollectorQuery *> m_high_prio;
+	std::deque<CollectorQuery *> m_low_prio;
+	std::deque<CollectorQuery *> m_done;
+	int m_num_threads;
+	int m_max_pending;
+	int m_active;
+	bool m_shutdown;
+	QueryHandler m_run;
+	QueryHandler m_done_handler;
+
+		// pool threads write a byte to m_pipe_fd when they add to
+		// m_done; m_pipe[0] is registered with DaemonCore
+	int m_pipe[2];
+	int m_pipe_fd;
+
+#ifdef HAVE_PTHREADS
+	std::vector<pthread_t> m_threads;
+	pthread_mutex_t m_lock;
+	pthread_cond_t m_work_cv;
+#endif
+};
+
+#endif
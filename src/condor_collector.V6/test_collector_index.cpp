@@ -0,0 +1,264 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for CollectorAttrIndex, the query index of COLLECTOR_QUERY_INDEX_ATTRS.
+// For each constraint, the candidates must include every ad that matches
+// it, the way query_scanFunc() evaluates it, each ad once, and fewer ads
+// than the table when the constraint is selective.  Ads where an indexed
+// attribute is a string, a number, another expression or absent are mixed,
+// and the index must stay right as ads are changed and removed.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_classad.h"
+#include "condor_attributes.h"
+#include "collector_index.h"
+#include "test_check.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
+static const int NUM_ADS = 1000;
+
+static void
+make_ad( int i, ClassAd &ad )
+{
+	std::string machine;
+	formatstr( machine, "Host%d.example.com", i / 10 );
+	ad.Assign( ATTR_MACHINE, machine );
+
+	static const char *states[] = { "Unclaimed", "Claimed", "Owner", "Matched" };
+	switch ( i % 23 ) {
+	case 5:
+			// not a literal, so a candidate for any State
+		ad.AssignExpr( ATTR_STATE, "ifThenElse(Cpus > 2, \"Claimed\", \"Unclaimed\")" );
+		break;
+	case 11:
+		break;
+	case 17:
+			// a number where strings are expected
+		ad.Assign( ATTR_STATE, i );
+		break;
+	default:
+		ad.Assign( ATTR_STATE, states[i % 4] );
+	}
+
+	ad.Assign( ATTR_CPUS, i % 8 + 1 );
+	switch ( i % 31 ) {
+	case 3:
+		ad.Assign( ATTR_MEMORY, (i % 16) * 1024.5 );
+		break;
+	case 7:
+		ad.AssignExpr( ATTR_MEMORY, "Cpus * 1024" );
+		break;
+	case 13:
+		ad.Assign( ATTR_MEMORY, true );
+		break;
+	case 19:
+		ad.AssignExpr( ATTR_MEMORY, "undefined" );
+		break;
+	default:
+		ad.Assign( ATTR_MEMORY, (i % 16) * 1024 );
+	}
+}
+
+// The ads of the table that match constraint, as query_scanFunc() decides.
+static std::set<ClassAd *>
+matching_ads( classad::ExprTree *constraint, const std::vector<ClassAd *> &ads )
+{
+	std::set<ClassAd *> matches;
+	for ( size_t i = 0; i < ads.size(); ++i ) {
+		classad::Value result;
+		bool val;
+		if ( EvalExprTree( constraint, ads[i], NULL, result ) &&
+			 result.IsBooleanValueEquiv( val ) && val ) {
+			matches.insert( ads[i] );
+		}
+	}
+	return matches;
+}
+
+// Checks the candidates for a constraint against the ads that match it.
+// If indexed is false, the index must not be usable for it.  Returns the
+// number of candidates.
+static size_t
+check_constraint( const char *what, CollectorAttrIndex &index, const char *constraint_str,
+                  const std::vector<ClassAd *> &ads, bool indexed )
+{
+	classad::ExprTree *constraint = NULL;
+	if ( ParseClassAdRvalExpr( constraint_str, constraint ) != 0 ) {
+		check_failed( "%s: cannot parse %s", what, constraint_str );
+		return 0;
+	}
+	std::set<ClassAd *> matches = matching_ads( constraint, ads );
+	std::vector<ClassAd *> candidates;
+	bool used = index.candidates( constraint, candidates );
+	delete constraint;
+
+	if ( used != indexed ) {
+		check_failed( "%s: %s %s the index", what, constraint_str, used ? "used" : "did not use" );
+		return 0;
+	}
+	if ( ! indexed ) {
+		check_passed( "%s: %s is not indexed", what, constraint_str );
+		return 0;
+	}
+
+	std::set<ClassAd *> unique( candidates.begin(), candidates.end() );
+	int missing = 0;
+	for ( std::set<ClassAd *>::iterator it = matches.begin(); it != matches.end(); ++it ) {
+		if ( ! unique.count( *it ) ) {
+			missing++;
+		}
+	}
+	if ( unique.size() != candidates.size() ) {
+		check_failed( "%s: %s gives %d candidates, %d of them more than once", what, constraint_str,
+			(int)candidates.size(), (int)( candidates.size() - unique.size() ) );
+	} else if ( missing ) {
+		check_failed( "%s: %s misses %d of the %d ads that match", what, constraint_str,
+			missing, (int)matches.size() );
+	} else if ( matches.empty() && candidates.size() == ads.size() ) {
+		check_failed( "%s: %s matches nothing but gives every ad", what, constraint_str );
+	} else {
+		check_passed( "%s: %s gives %d candidates for %d matches of %d ads", what, constraint_str,
+			(int)candidates.size(), (int)matches.size(), (int)ads.size() );
+	}
+	return candidates.size();
+}
+
+static void
+check_constraints( const char *what, CollectorAttrIndex &index, const std::vector<ClassAd *> &ads )
+{
+	const char *indexed[] = {
+		"State == \"Claimed\"",
+		"State =?= \"claimed\"",
+		"MY.State == \"Owner\"",
+		"State == \"CLAIMED\"",
+		"\"Matched\" == State",
+		"State == \"NoSuchState\"",
+		"(State == \"Unclaimed\") && Cpus > 4",
+		"Cpus > 4 && Memory >= 8192",
+		"Memory == 4096",
+		"Memory =?= 4096.0",
+		"Memory < 2048",
+		"Memory <= 2048",
+		"1024 > Memory",
+		"Memory > 14000",
+		"Memory >= 3074.5",
+		"Machine == \"host7.example.com\" && State == \"Claimed\"",
+		"Machine == \"Host7.example.com\" && Memory > 1",
+	};
+	for ( size_t i = 0; i < sizeof(indexed) / sizeof(indexed[0]); ++i ) {
+		check_constraint( what, index, indexed[i], ads, true );
+	}
+
+	const char *not_indexed[] = {
+		"State == \"Claimed\" || State == \"Owner\"",
+		"Cpus > 4",
+		"State != \"Claimed\"",
+		"TARGET.State == \"Claimed\"",
+		"State == Machine",
+		"State > \"Claimed\"",
+		"Memory == true",
+	};
+	for ( size_t i = 0; i < sizeof(not_indexed) / sizeof(not_indexed[0]); ++i ) {
+		check_constraint( what, index, not_indexed[i], ads, false );
+	}
+}
+
+static void
+test_index()
+{
+	classad::References attrs;
+	attrs.insert( ATTR_MACHINE );
+	attrs.insert( ATTR_STATE );
+	attrs.insert( "memory" );	// attribute names ignore case
+	CollectorAttrIndex index( attrs );
+
+	std::vector<ClassAd *> ads;
+	for ( int i = 0; i < NUM_ADS; ++i ) {
+		ClassAd *ad = new ClassAd();
+		make_ad( i, *ad );
+		ads.push_back( ad );
+		index.insert( ad );
+	}
+	check( "every ad is in the index", index.size() == ads.size() );
+	check_constraints( "new ads", index, ads );
+
+	size_t one_machine = check_constraint( "new ads", index,
+		"Machine == \"host7.example.com\"", ads, true );
+	check( "a query for one machine gives only its ads",
+		one_machine == 10 );
+
+		// change some ads in place, as the offline plugin does
+	for ( int i = 0; i < NUM_ADS; i += 3 ) {
+		ClassAd *ad = ads[i];
+		if ( i % 2 ) {
+			ad->Assign( ATTR_STATE, "Backfill" );
+			ad->Assign( ATTR_MEMORY, 65536 );
+		} else {
+			ad->Delete( ATTR_STATE );
+			ad->AssignExpr( ATTR_MEMORY, "Cpus * 2048" );
+		}
+		index.reindex( ad );
+	}
+	index.insert( ads[1] );	// inserting an ad again replaces its entries
+	check( "reindexing keeps one entry per ad", index.size() == ads.size() );
+	check_constraints( "changed ads", index, ads );
+	check_constraint( "changed ads", index, "State == \"Backfill\"", ads, true );
+	check_constraint( "changed ads", index, "Memory >= 65536", ads, true );
+
+		// remove every other ad from the table
+	std::vector<ClassAd *> kept;
+	for ( size_t i = 0; i < ads.size(); ++i ) {
+		if ( i % 2 ) {
+			kept.push_back( ads[i] );
+		} else {
+			index.remove( ads[i] );
+			index.remove( ads[i] );	// removing an ad that is not there does nothing
+			delete ads[i];
+		}
+	}
+	ads.swap( kept );
+	check( "removed ads leave the index", index.size() == ads.size() );
+	check_constraints( "after removals", index, ads );
+
+		// a removed ad must never come back as a candidate
+	for ( size_t i = 0; i < ads.size(); ++i ) {
+		index.remove( ads[i] );
+	}
+	std::vector<ClassAd *> candidates;
+	classad::ExprTree *constraint = NULL;
+	ParseClassAdRvalExpr( "Memory >= 0", constraint );
+	bool used = index.candidates( constraint, candidates );
+	delete constraint;
+	check( "an empty index gives no candidates", index.size() == 0 && used && candidates.empty() );
+
+	for ( size_t i = 0; i < ads.size(); ++i ) {
+		delete ads[i];
+	}
+}
+
+int
+main( int /*argc*/, char ** /*argv*/ )
+{
+	test_index();
+	return check_results();
+}
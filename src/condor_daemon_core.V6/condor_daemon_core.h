@@ -1062,6 +1062,17 @@ class DaemonCore : public Service
                         const char * event_descrip,
                         Service *    s);
 
+    /** Like Register_Timer(), but deltawhen and period are in
+        milliseconds, for timers that should not wait for the next
+        whole second.
+        @return                Timer id or -1 on error
+    */
+    int Register_Timer_Ms (unsigned  deltawhen_ms,
+                           unsigned  period_ms,
+                           TimerHandlercpp handler,
+                           const char * event_descrip,
+                           Service * s);
+
     /** 
         @param timeslice       Timeslice object specifying interval parameters
         @param event           Function to call when timer fires.
@@ -1098,6 +1109,11 @@ class DaemonCore : public Service
     */
     int Reset_Timer ( int id, unsigned when, unsigned period = 0 );
 
+    /** Like Reset_Timer(), but when and period are in milliseconds.
+        @return 0 if successful, -1 on failure (timer not found)
+    */
+    int Reset_Timer_Ms ( int id, unsigned when_ms, unsigned period_ms = 0 );
+
     /** Change a timer's period.  Recompute time to fire next based on this
 		new period and how long this timer has been waiting.
         @param id The timer's ID
@@ -1512,6 +1528,15 @@ class DaemonCore : public Service
 		DCTokenRequester *requester = nullptr, const std::string &identity = "",
 		const std::string &authz_name = "");
 
+		/**
+		   Evaluate the DAEMON_SHUTDOWN and DAEMON_SHUTDOWN_FAST
+		   expressions in the context of the given ad, and begin
+		   shutting down if either is true. sendUpdates() does this
+		   for its first ad, a daemon that sends only part of its ad
+		   to the collectors should call this with the whole ad.
+		*/
+	void evalDaemonShutdownExprs(ClassAd* ad);
+
 	DCCollectorAdSequences & getUpdateAdSeq() { return m_collector_list->getAdSeq(); }
 
 	bool getStartTime(int & startTime);
@@ -1607,6 +1632,7 @@ class DaemonCore : public Service
 	   //stats_entry_recent<int64_t> SockBytes;      //  number of bytes passed though the socket (can we do this?)
 	   //stats_entry_recent<int64_t> PipeBytes;      //  number of bytes passed though the socket
 	   stats_entry_recent<int> DebugOuts;      //  number of dprintf calls that were written to output.
+	   stats_entry_recent<int> DebugOutsDropped; //  number of dprintf calls dropped because the async log buffer was full
       #ifdef WIN32
 	   stats_entry_recent<int> AsyncPipe;      //  number of times async_pipe was signalled
       #endif
@@ -1713,6 +1739,7 @@ class DaemonCore : public Service
 	int m_iMaxReapsPerCycle; // maximum number reapers to invoke per event loop
 	int m_MaxTimeSkip;
 	int m_iMaxUdpMsgsPerCycle;	// max number of udp messages read per loop
+	bool m_use_epoll;	// Driver() keeps its fds registered with epoll
 
     void Inherit( void );  // called in main()
 	void InitDCCommandSocket( int command_port );  // called in main()
@@ -33,6 +33,8 @@
 #include "condor_constants.h"
 #include "dc_service.h"
 #include "condor_timeslice.h"
+#include <unordered_map>
+#include <vector>
 
 #ifdef WIN32
 #include <time.h>
@@ -73,23 +75,28 @@ const unsigned	TIMER_NEVER = 0xffffffff;
 
 const time_t TIME_T_NEVER	= 0x7fffffff;
 
+// Timer deadlines are kept in milliseconds since the epoch; this one
+// sorts after all others.
+const int64_t TIMER_NEVER_MS = 0x7fffffffffffffffLL;
+
 
 //-----------------------------------------------------------------------------
 /// Not_Yet_Documented
 struct tagTimer {
-    /** Not_Yet_Documented */ time_t            when;
-    /** Not_Yet_Documented */ time_t            period_started;
-    /** Not_Yet_Documented */ unsigned          period;
+    /** Deadline, in ms since the epoch */  int64_t       when_ms;
+    /** Start of the current period, in ms */ int64_t     period_started_ms;
+    /** Period in ms, 0 for a one-shot */   int64_t       period_ms;
     /** Not_Yet_Documented */ int               id;
     /** Not_Yet_Documented */ TimerHandler             handler;
     /** Not_Yet_Documented */ TimerHandlercpp          handlercpp;
     /** Not_Yet_Documented */ class Service*    service; 
-    /** Not_Yet_Documented */ struct tagTimer*  next;
     /** Not_Yet_Documented */ char*             event_descrip;
     /** Not_Yet_Documented */ void*             data_ptr;
     /** Not_Yet_Documented */ Timeslice *       timeslice;
 	/** Not_Yet_Documented */ Release           release;
 	/** Not_Yet_Documented */ Releasecpp        releasecpp;
+    /** Insertion order, breaks ties in when_ms */ unsigned long long seq;
+    /** Position in the TimerManager's heap */ size_t  heap_index;
 };
 
 ///
@@ -171,6 +178,15 @@ class TimerManager
                   TimerHandlercpp handler,
                   const char * event_descrip);
 
+    /** Like NewTimer(), but deltawhen and period are in milliseconds.
+        @return The ID of the new timer, or -1 on failure
+    */
+    int NewTimerMs (Service*     s,
+                    unsigned     deltawhen_ms,
+                    TimerHandlercpp handler,
+                    const char * event_descrip,
+                    unsigned     period_ms       =  0);
+
     /** Not_Yet_Documented.
         @param id The ID of the timer
 		@param release_data_ptr True if the timer's data_ptr should be freed
@@ -188,6 +204,11 @@ class TimerManager
     */
     int ResetTimer(int tid, unsigned when, unsigned period = 0, bool recompute_when=false, Timeslice const *new_timeslice=NULL);
 
+    /** Like ResetTimer(), but when and period are in milliseconds.
+        @return 0 if successful, -1 on failure (timer not found)
+    */
+    int ResetTimerMs(int tid, unsigned when_ms, unsigned period_ms = 0);
+
 	/**
        This is equivalent to calling ResetTimer with recompute_when=true.
 	   @param tid The ID of the timer
@@ -227,11 +248,17 @@ class TimerManager
     /// Not_Yet_Documented.
     void DumpTimerList(int, const char* = NULL );
 
-    /** Not_Yet_Documented.
-        @return Not_Yet_Documented
+    /** Call the handlers of the timers that are due.
+        @return seconds until the next timer is due, rounded up, or -1
+                if there are no timers
     */
     int Timeout(int * pNumFired = NULL, double * pruntime = NULL); 
 
+    /** Like Timeout(), but returns milliseconds until the next timer
+        is due, or -1 if there are no timers.
+    */
+    int TimeoutMs(int * pNumFired = NULL, double * pruntime = NULL);
+
     /// Not_Yet_Documented.
     void Start();
     
@@ -241,28 +268,38 @@ class TimerManager
     TimerManager();
     
     int NewTimer (Service*   s,
-                  unsigned   deltawhen,
+                  int64_t    deltawhen_ms,
                   TimerHandler handler,
                   TimerHandlercpp handlercpp,
 				  Release	 release,
 				  Releasecpp releasecpp,
                   const char *event_descrip,
-                  unsigned   period          =  0,
+                  int64_t    period_ms       =  0,
 				  const Timeslice *timeslice = NULL);
 
-	void RemoveTimer( Timer *timer, Timer *prev );
+	int ResetTimerMs(int id, int64_t when_ms, int64_t period_ms,
+					 bool recompute_when, Timeslice const *new_timeslice);
+
+	void RemoveTimer( Timer *timer );
 	void InsertTimer( Timer *new_timer );
 	void DeleteTimer( Timer *timer );
 
 	/*
 	  @param id The id of the timer to find
-	  @param prev If not NULL, this will be set to previous timer in list
 	  @return pointer to timer with specified id or NULL if not found
 	 */
-	Timer *GetTimer( int id, Timer **prev );
-
-    Timer*  timer_list;
-	Timer*  list_tail;
+	Timer *GetTimer( int id );
+
+		// timer_heap is a binary min-heap ordered on (when_ms, seq), so
+		// that timers due at the same time are called in the order they
+		// were (re)scheduled.
+	void HeapUp( size_t i );
+	void HeapDown( size_t i );
+	void CollectDue( size_t i, int64_t now_ms, std::vector<Timer*> &due );
+
+	std::vector<Timer*> timer_heap;
+	std::unordered_map<int, Timer*> timer_by_id;
+	unsigned long long timer_seq;
     int     timer_ids;
     Timer*  in_timeout;
     bool    did_reset;
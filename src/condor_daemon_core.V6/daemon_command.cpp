@@ -913,6 +913,10 @@ DaemonCommandProtocol::CommandProtocolResult DaemonCommandProtocol::ReadCommand(
 								dprintf (D_SECURITY, "DC_AUTHENTICATE: generating 3DES key for session %s...\n", m_sid);
 								m_key = new KeyInfo(rbuf, 24, CONDOR_3DES);
 								break;
+							case 'A': // aes
+								dprintf (D_SECURITY, "DC_AUTHENTICATE: generating AES key for session %s...\n", m_sid);
+								m_key = new KeyInfo(rbuf, 24, CONDOR_AESGCM);
+								break;
 							default:
 								dprintf (D_SECURITY, "DC_AUTHENTICATE: generating RANDOM key for session %s...\n", m_sid);
 								m_key = new KeyInfo(rbuf, 24);
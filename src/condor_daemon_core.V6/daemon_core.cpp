@@ -112,6 +112,8 @@ CRITICAL_SECTION Big_fat_mutex; // coarse grained mutex for debugging purposes
 
 #include "systemd_manager.h"
 
+#include <algorithm>
+
 static const char* EMPTY_DESCRIP = "<NULL>";
 
 // special errno values that may be returned from Create_Process
@@ -466,6 +468,7 @@ DaemonCore::DaemonCore(int ComSize,int SigSize,
 	m_shared_port_endpoint = NULL;
 	nRegisteredSocks = 0;
 	m_iMaxUdpMsgsPerCycle = 1;
+	m_use_epoll = false;
 }
 
 // DaemonCore destructor. Delete the all the various handler tables, plus
@@ -954,6 +957,12 @@ int	DaemonCore::Register_Timer(unsigned deltawhen, unsigned period,
 	return( t.NewTimer(s, deltawhen, handler, event_descrip, period) );
 }
 
+int	DaemonCore::Register_Timer_Ms(unsigned deltawhen_ms, unsigned period_ms,
+				TimerHandlercpp handler, const char *event_descrip, Service* s )
+{
+	return( t.NewTimerMs(s, deltawhen_ms, handler, event_descrip, period_ms) );
+}
+
 int DaemonCore::Register_Timer (const Timeslice &timeslice,TimerHandler handler,const char * event_descrip)
 {
 	return t.NewTimer(timeslice, handler, event_descrip );
@@ -977,6 +986,11 @@ int DaemonCore::Reset_Timer( int id, unsigned when, unsigned period )
 	return( t.ResetTimer(id,when,period) );
 }
 
+int DaemonCore::Reset_Timer_Ms( int id, unsigned when_ms, unsigned period_ms )
+{
+	return( t.ResetTimerMs(id,when_ms,period_ms) );
+}
+
 int DaemonCore::Reset_Timer_Period ( int id, unsigned period )
 {
 	return( t.ResetTimerPeriod(id,period) );
@@ -1779,6 +1793,10 @@ int DaemonCore::Register_Socket(Stream *iosock, const char* iosock_descrip,
 		}
 	}
 
+	// The fd number may have been reused since a persistent selector
+	// last saw it, so make sure it watches the file it refers to now.
+	Selector::fd_opened(fd_to_register);
+
 	// Found a blank entry at index i. Now add in the new data.
 	(*sockTable)[i].servicing_tid = 0;
 	(*sockTable)[i].remove_asap = false;
@@ -2191,6 +2209,10 @@ int DaemonCore::Register_Pipe(int pipe_end, const char* pipe_descrip,
 
     dc_stats.NewProbe("Pipe", handler_descrip, AS_COUNT | IS_RCT | IF_NONZERO | IF_VERBOSEPUB);
 
+#ifndef WIN32
+	Selector::fd_opened((*pipeHandleTable)[index]);
+#endif
+
 	// Found a blank entry at index i. Now add in the new data.
 	(*pipeTable)[i].pentry = NULL;
 	(*pipeTable)[i].call_handler = false;
@@ -2415,6 +2437,7 @@ int DaemonCore::Close_Pipe( int pipe_end )
 	}
 #else
 	int pipefd = (*pipeHandleTable)[index];
+	Selector::fd_closing(pipefd);
 	if ( close(pipefd) < 0 ) {
 		dprintf(D_ALWAYS,
 			"Close_Pipe(pipefd=%d) failed, errno=%d\n",pipefd,errno);
@@ -3055,6 +3078,8 @@ DaemonCore::reconfig(void) {
     if( m_iMaxReapsPerCycle != 0 ) {
         dprintf(D_FULLDEBUG,"Setting maximum reaps per cycle %d.\n", m_iMaxReapsPerCycle);
     }
+
+	m_use_epoll = param_boolean("DAEMON_CORE_USE_EPOLL", false);
 		// Initialize the collector list for ClassAd updates
 	initCollectorList();
 
@@ -3354,6 +3379,14 @@ void DaemonCore::Driver()
 	time_t		timeout;
 	time_t min_deadline;
 
+		// With a persistent selector, Driver() only looks at the
+		// sockets it reports ready and the ones with a deadline, so it
+		// keeps the sockTable index of each fd it watches.
+	std::vector<int> sock_of_fd;		// -1 if the fd is not a socket we watch
+	std::vector<int> sock_fds;			// the fds set in sock_of_fd
+	std::vector<int> deadline_socks;	// sockets with a deadline
+	std::vector<int> dispatch_socks;	// sockets to check, in table order
+
 #ifndef WIN32
 	sigset_t fullset, emptyset;
 	sigfillset( &fullset );
@@ -3486,7 +3519,7 @@ void DaemonCore::Driver()
 		//   starve commands...
 
         int num_timers_fired = 0;
-		timeout = t.Timeout(&num_timers_fired, &runtime);
+		int timeout_ms = t.TimeoutMs(&num_timers_fired, &runtime);
 
 		num_timers_fired += num_pumpwork_fired;
 		dc_stats.TimersFired = num_timers_fired;
@@ -3496,10 +3529,14 @@ void DaemonCore::Driver()
 		}
 
 		if ( sent_signal == TRUE ) {
-			timeout = 0;
+			timeout_ms = 0;
 		}
-		if ( timeout < 0 ) {
+		long timeout_usec = 0;
+		if ( timeout_ms < 0 ) {
 			timeout = TIME_T_NEVER;
+		} else {
+			timeout = timeout_ms / 1000;
+			timeout_usec = ( timeout_ms % 1000 ) * 1000;
 		}
 
         // accumulate signal runtime (including timers) as SignalRuntime
@@ -3510,8 +3547,25 @@ void DaemonCore::Driver()
 		// Setup what socket descriptors to select on.  We recompute this
 		// every time because 1) some timeout handler may have removed/added
 		// sockets, and 2) it ain't that expensive....
+		// With DAEMON_CORE_USE_EPOLL, the selector keeps the descriptors
+		// registered with the kernel and only passes on what changed.
+		if ( selector.is_persistent() != m_use_epoll ) {
+			if ( !selector.set_persistent( m_use_epoll ) ) {
+				dprintf( D_ALWAYS, "DaemonCore: epoll is not available, "
+						 "ignoring DAEMON_CORE_USE_EPOLL\n" );
+				m_use_epoll = false;
+			} else {
+				dprintf( D_FULLDEBUG, "DaemonCore: %s epoll\n",
+						 m_use_epoll ? "using" : "no longer using" );
+			}
+		}
 		selector.reset();
 		min_deadline = 0;
+		for ( size_t j = 0; j < sock_fds.size(); j++ ) {
+			sock_of_fd[sock_fds[j]] = -1;
+		}
+		sock_fds.clear();
+		deadline_socks.clear();
 		for (i = 0; i < nSock; i++) {
 				// NOTE: keep the following logic for building the
 				// fdset in sync with DaemonCore::ServiceCommandSocket()
@@ -3554,6 +3608,15 @@ void DaemonCore::Driver()
 					}
 				}
 
+				if ( selector.is_persistent() ) {
+					int sockfd = (*sockTable)[i].iosock->get_file_desc();
+					if ( sockfd >= (int)sock_of_fd.size() ) {
+						sock_of_fd.resize( sockfd + 1, -1 );
+					}
+					sock_of_fd[sockfd] = i;
+					sock_fds.push_back( sockfd );
+				}
+
 					// If this socket times out sooner than
 					// our select timeout, adjust the select timeout.
 				time_t deadline = (*sockTable)[i].iosock->get_deadline();
@@ -3561,6 +3624,7 @@ void DaemonCore::Driver()
 					if(min_deadline == 0 || min_deadline > deadline) {
 						min_deadline = deadline;
 					}
+					deadline_socks.push_back( i );
 				}
             }
 		}
@@ -3570,6 +3634,7 @@ void DaemonCore::Driver()
 			if(deadline_timeout < timeout) {
 				if(deadline_timeout < 0) deadline_timeout = 0;
 				timeout = deadline_timeout;
+				timeout_usec = 0;
 			}
 		}
 
@@ -3626,7 +3691,7 @@ void DaemonCore::Driver()
 		LeaveCriticalSection(&Big_fat_mutex);
 #endif
 
-		selector.set_timeout( timeout );
+		selector.set_timeout( timeout, timeout_usec );
 
 		errno = 0;
 		time_t time_before = time(NULL);
@@ -3752,8 +3817,35 @@ void DaemonCore::Driver()
 				dprintf(D_ALWAYS,"Received a superuser command\n");
 			}
 
+			// A persistent selector tells us which fds are ready, so only
+			// those sockets and the ones that may have timed out need a
+			// look.  Otherwise, look at the whole socket table.
+			dispatch_socks.clear();
+			if ( selector.is_persistent() ) {
+				const std::vector<int> &ready = selector.ready_fds();
+				for ( size_t j = 0; j < ready.size(); j++ ) {
+					int fd = ready[j];
+					if ( fd < (int)sock_of_fd.size() && sock_of_fd[fd] >= 0 ) {
+						dispatch_socks.push_back( sock_of_fd[fd] );
+					}
+				}
+				for ( size_t j = 0; j < deadline_socks.size(); j++ ) {
+						// another thread may have cancelled it during the select
+					Stream *iosock = (*sockTable)[deadline_socks[j]].iosock;
+					time_t deadline = iosock ? iosock->get_deadline() : 0;
+					if ( deadline && deadline < now ) {
+						dispatch_socks.push_back( deadline_socks[j] );
+					}
+				}
+				std::sort( dispatch_socks.begin(), dispatch_socks.end() );
+				dispatch_socks.erase( std::unique( dispatch_socks.begin(), dispatch_socks.end() ),
+									  dispatch_socks.end() );
+			}
+			int num_dispatch = selector.is_persistent() ? (int)dispatch_socks.size() : nSock;
+
 			// scan through the socket table to find which ones select() set
-			for(i = 0; i < nSock; i++) {
+			for(int j = 0; j < num_dispatch; j++) {
+				i = selector.is_persistent() ? dispatch_socks[j] : j;
 				if ( (*sockTable)[i].iosock && 
 					 (*sockTable)[i].servicing_tid==0 &&
 					 (*sockTable)[i].remove_asap == false ) 
@@ -3881,12 +3973,14 @@ void DaemonCore::Driver()
 
 #else
 							// UNIX
+							// use a separate selector, so a persistent one
+							// does not drop all the other fds
 							int pipefd = (*pipeHandleTable)[(*pipeTable)[i].index];
-							selector.reset();
-							selector.set_timeout( 0 );
-							selector.add_fd( pipefd, Selector::IO_READ );
-							selector.execute();
-							if ( selector.timed_out() ) {
+							Selector recheck;
+							recheck.set_timeout( 0 );
+							recheck.add_fd( pipefd, Selector::IO_READ );
+							recheck.execute();
+							if ( recheck.timed_out() ) {
 								// nothing available, try the next entry...
 								continue;
 							}
@@ -3959,9 +4053,13 @@ void DaemonCore::Driver()
 			dc_stats.PipeRuntime += (runtime - group_runtime);
 			group_runtime = runtime;
 
-			// Now loop through all sock entries, calling handlers if required.
-			for(i = 0; i < nSock; i++) {
-				if ( (*sockTable)[i].iosock ) {	// if a valid entry...
+			// Now loop through the sock entries we checked, calling
+			// handlers if required.  A handler may cancel sockets,
+			// which leaves their entries empty, or register new ones,
+			// which don't have call_handler set.
+			for(int j = 0; j < num_dispatch; j++) {
+				i = selector.is_persistent() ? dispatch_socks[j] : j;
+				if ( i < nSock && (*sockTable)[i].iosock ) {	// if a valid entry...
 
 					if ( (*sockTable)[i].call_handler ) {
 
@@ -3977,13 +4075,13 @@ void DaemonCore::Driver()
 							// read on the pipe could block?  to prevent this, we need
 							// to check one more time to make certain the pipe is ready
 							// for reading.
-							selector.reset();
-							selector.set_timeout( 0 );// set timeout for a poll
-							selector.add_fd( (*sockTable)[i].iosock->get_file_desc(),
-											 Selector::IO_READ );
+							Selector recheck;
+							recheck.set_timeout( 0 );// set timeout for a poll
+							recheck.add_fd( (*sockTable)[i].iosock->get_file_desc(),
+											Selector::IO_READ );
 
-							selector.execute();
-							if ( selector.timed_out() ) {
+							recheck.execute();
+							if ( recheck.timed_out() ) {
 								// nothing available, try the next entry...
 								continue;
 							}
@@ -11002,23 +11100,29 @@ DaemonCore::sendUpdates( int cmd, ClassAd* ad1, ClassAd* ad2, bool nonblock,
 	ASSERT(m_collector_list);
 
 		// Now's our chance to evaluate the DAEMON_SHUTDOWN expressions.
+	evalDaemonShutdownExprs(ad1);
+
+		// Even if we just decided to shut ourselves down, we should
+		// still send the updates originally requested by the caller.
+	return m_collector_list->sendUpdates(cmd, ad1, ad2, nonblock, token_requester,
+		identity, authz_name);
+}
+
+void
+DaemonCore::evalDaemonShutdownExprs( ClassAd* ad )
+{
 	if (!m_in_daemon_shutdown_fast &&
-		evalExpr(ad1, "DAEMON_SHUTDOWN_FAST", ATTR_DAEMON_SHUTDOWN_FAST,
+		evalExpr(ad, "DAEMON_SHUTDOWN_FAST", ATTR_DAEMON_SHUTDOWN_FAST,
 				 "starting fast shutdown"))	{
 			// Daemon wants to quickly shut itself down and not restart.
 		beginDaemonShutdown(true);
 	}
 	else if (!m_in_daemon_shutdown &&
-			 evalExpr(ad1, "DAEMON_SHUTDOWN", ATTR_DAEMON_SHUTDOWN,
+			 evalExpr(ad, "DAEMON_SHUTDOWN", ATTR_DAEMON_SHUTDOWN,
 					  "starting graceful shutdown")) {
 			// Daemon wants to gracefully shut itself down and not restart.
 		beginDaemonShutdown(false);
 	}
-
-		// Even if we just decided to shut ourselves down, we should
-		// still send the updates originally requested by the caller.
-	return m_collector_list->sendUpdates(cmd, ad1, ad2, nonblock, token_requester,
-		identity, authz_name);
 }
 
 
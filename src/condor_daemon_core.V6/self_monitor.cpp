@@ -41,6 +41,11 @@ static void self_monitor()
     daemonCore->monitor_data.CollectData();
     daemonCore->dc_stats.Tick(daemonCore->monitor_data.last_sample_time);
     daemonCore->dc_stats.DebugOuts += dprintf_getCount();
+
+    static int last_dropped = 0;
+    int dropped = dprintf_getDroppedCount();
+    daemonCore->dc_stats.DebugOutsDropped += dropped - last_dropped;
+    last_dropped = dropped;
 }
 
 SelfMonitorData::SelfMonitorData()
@@ -56,6 +61,9 @@ SelfMonitorData::SelfMonitorData()
 	user_time = sys_time = -1;
 	registered_socket_count = 0;
 	cached_security_sessions = 0;
+	security_session_hits = 0;
+	security_session_misses = 0;
+	security_sessions_expired = 0;
     return;
 }
 
@@ -116,7 +124,11 @@ void SelfMonitorData::CollectData(void)
 
 	registered_socket_count = daemonCore->RegisteredSocketCount();
 
-	cached_security_sessions = daemonCore->getSecMan()->session_cache->count();
+	KeyCache *session_cache = daemonCore->getSecMan()->session_cache;
+	cached_security_sessions = session_cache->count();
+	security_session_hits = session_cache->lookupHits();
+	security_session_misses = session_cache->lookupMisses();
+	security_sessions_expired = session_cache->expiredCount();
 
 	// collect data on the udp port depth
 	if (daemonCore->wants_dc_udp_self()) {
@@ -146,6 +158,9 @@ bool SelfMonitorData::ExportData(ClassAd *ad, bool verbose /*=false*/) const
         ad->Assign("MonitorSelfAge",             age);
         ad->Assign("MonitorSelfRegisteredSocketCount", registered_socket_count);
         ad->Assign("MonitorSelfSecuritySessions", cached_security_sessions);
+        ad->Assign("MonitorSelfSecuritySessionHits", security_session_hits);
+        ad->Assign("MonitorSelfSecuritySessionMisses", security_session_misses);
+        ad->Assign("MonitorSelfSecuritySessionsExpired", security_sessions_expired);
         ad->Assign(ATTR_DETECTED_CPUS, param_integer("DETECTED_CORES", 0));
         ad->Assign(ATTR_DETECTED_MEMORY, param_integer("DETECTED_MEMORY", 0));
         if (verbose) {
@@ -235,6 +250,7 @@ void DaemonCore::Stats::Init(bool enable)
    //DC_STATS_ADD_RECENT(Pool, SockBytes,     IF_BASICPUB);
    //DC_STATS_ADD_RECENT(Pool, PipeBytes,     IF_BASICPUB);
    DC_STATS_ADD_RECENT(Pool, DebugOuts,     IF_VERBOSEPUB);
+   DC_STATS_ADD_RECENT(Pool, DebugOutsDropped, IF_BASICPUB);
    DC_STATS_ADD_RECENT(Pool, PumpCycle,     IF_VERBOSEPUB);
    STATS_POOL_ADD_VAL(Pool, "DC", UdpQueueDepth,  IF_BASICPUB);
    STATS_POOL_PUB_PEAK(Pool, "DC", UdpQueueDepth,  IF_BASICPUB);
@@ -288,6 +304,7 @@ void DaemonCore::Stats::Init(bool enable)
    //DC_STATS_PUB_DEBUG(Pool, SockBytes,     IF_BASICPUB);
    //DC_STATS_PUB_DEBUG(Pool, PipeBytes,     IF_BASICPUB);
    DC_STATS_PUB_DEBUG(Pool, DebugOuts,     IF_VERBOSEPUB);
+   DC_STATS_PUB_DEBUG(Pool, DebugOutsDropped, IF_BASICPUB);
    DC_STATS_PUB_DEBUG(Pool, PumpCycle,     IF_VERBOSEPUB);
 
 
@@ -75,6 +75,11 @@ public:
 	int           registered_socket_count;
 	// How many security sessions exist in the cache
 	int           cached_security_sessions;
+	// How many lookups in the security session cache found a session,
+	// how many did not, and how many sessions expired
+	long long     security_session_hits;
+	long long     security_session_misses;
+	long long     security_sessions_expired;
 
 private:
     int           _timer_id;
@@ -24,7 +24,8 @@
 #include "condor_debug.h"
 #include "condor_daemon_core.h"
 #include "condor_config.h"
-#include <unordered_set>
+#include "utc_time.h"
+#include <algorithm>
 
 static const char* DEFAULT_INDENT = "DaemonCore--> ";
 
@@ -36,6 +37,31 @@ extern void **curr_regdataptr;
 // disable warning about memory leaks due to exception. all memory freed on exit anyway
 MSC_DISABLE_WARNING(6211)
 
+static int64_t
+timer_now_ms()
+{
+	long usec = 0;
+	time_t now = condor_gettimestamp( usec );
+	return (int64_t)now * 1000 + usec / 1000;
+}
+
+// Convert a "when" or "period" from the public interface to ms.
+static int64_t
+timer_ms( unsigned value, int64_t scale )
+{
+	if ( value == TIMER_NEVER ) {
+		return TIMER_NEVER_MS;
+	}
+	return (int64_t)value * scale;
+}
+
+static inline bool
+TimerBefore( const Timer *a, const Timer *b )
+{
+	return a->when_ms < b->when_ms ||
+		( a->when_ms == b->when_ms && a->seq < b->seq );
+}
+
 TimerManager &
 TimerManager::GetTimerManager()
 {
@@ -52,8 +78,7 @@ TimerManager::TimerManager()
 	{
 		EXCEPT("TimerManager object exists!");
 	}
-	timer_list = NULL;
-	list_tail = NULL;
+	timer_seq = 0;
 	timer_ids = 0;
 	in_timeout = NULL;
 	_t = this; 
@@ -79,13 +104,13 @@ int TimerManager::NewTimer(unsigned deltawhen, TimerHandler handler,
 						   Release release, const char* event_descrip,
 						   unsigned period)
 {
-	return( NewTimer(NULL,deltawhen,handler,(TimerHandlercpp)NULL,release,(Releasecpp)NULL,event_descrip,period,NULL) );
+	return( NewTimer(NULL,timer_ms(deltawhen,1000),handler,(TimerHandlercpp)NULL,release,(Releasecpp)NULL,event_descrip,timer_ms(period,1000),NULL) );
 }
 
 int TimerManager::NewTimer(unsigned deltawhen, TimerHandler handler, const char* event_descrip,
 						   unsigned period)
 {
-	return( NewTimer((Service *)NULL,deltawhen,handler,(TimerHandlercpp)NULL,(Release)NULL,(Releasecpp)NULL,event_descrip,period,NULL) );
+	return( NewTimer((Service *)NULL,timer_ms(deltawhen,1000),handler,(TimerHandlercpp)NULL,(Release)NULL,(Releasecpp)NULL,event_descrip,timer_ms(period,1000),NULL) );
 }
 
 int TimerManager::NewTimer(Service* s, unsigned deltawhen, TimerHandlercpp handler, const char* event_descrip,
@@ -95,7 +120,17 @@ int TimerManager::NewTimer(Service* s, unsigned deltawhen, TimerHandlercpp handl
 		dprintf( D_DAEMONCORE,"DaemonCore NewTimer() called with c++ pointer & NULL Service*\n");
 		return -1;
 	}
-	return( NewTimer(s,deltawhen,(TimerHandler)NULL,handler,(Release)NULL,(Releasecpp)NULL,event_descrip,period,NULL) );
+	return( NewTimer(s,timer_ms(deltawhen,1000),(TimerHandler)NULL,handler,(Release)NULL,(Releasecpp)NULL,event_descrip,timer_ms(period,1000),NULL) );
+}
+
+int TimerManager::NewTimerMs(Service* s, unsigned deltawhen_ms, TimerHandlercpp handler, const char* event_descrip,
+							 unsigned period_ms)
+{
+	if ( !s ) {
+		dprintf( D_DAEMONCORE,"DaemonCore NewTimerMs() called with c++ pointer & NULL Service*\n");
+		return -1;
+	}
+	return( NewTimer(s,timer_ms(deltawhen_ms,1),(TimerHandler)NULL,handler,(Release)NULL,(Releasecpp)NULL,event_descrip,timer_ms(period_ms,1),NULL) );
 }
 
 int TimerManager::NewTimer (const Timeslice &timeslice,TimerHandler handler,const char * event_descrip)
@@ -111,10 +146,10 @@ int TimerManager::NewTimer (Service* s,const Timeslice &timeslice,TimerHandlercp
 
 // Add a new event in the timer list. if period is 0, this event is a one time
 // event instead of periodical
-int TimerManager::NewTimer(Service* s, unsigned deltawhen,
+int TimerManager::NewTimer(Service* s, int64_t deltawhen_ms,
 						   TimerHandler handler, TimerHandlercpp handlercpp,
 						   Release release, Releasecpp releasecpp,
-						   const char *event_descrip, unsigned period, 
+						   const char *event_descrip, int64_t period_ms,
 						   const Timeslice *timeslice)
 {
 	Timer*		new_timer;
@@ -134,22 +169,22 @@ int TimerManager::NewTimer(Service* s, unsigned deltawhen,
 	new_timer->handlercpp = handlercpp;
 	new_timer->release = release;
 	new_timer->releasecpp = releasecpp;
-	new_timer->period = period;
+	new_timer->period_ms = period_ms;
 	new_timer->service = s; 
 
 	if( timeslice ) {
 		new_timer->timeslice = new Timeslice( *timeslice );
-		deltawhen = new_timer->timeslice->getTimeToNextRun();
+		deltawhen_ms = timer_ms( new_timer->timeslice->getTimeToNextRun(), 1000 );
 	}
 	else {
 		new_timer->timeslice = NULL;
 	}
 
-	new_timer->period_started = time(NULL);
-	if ( TIMER_NEVER == deltawhen ) {
-		new_timer->when = TIME_T_NEVER;
+	new_timer->period_started_ms = timer_now_ms();
+	if ( TIMER_NEVER_MS == deltawhen_ms ) {
+		new_timer->when_ms = TIMER_NEVER_MS;
 	} else {
-		new_timer->when = deltawhen + new_timer->period_started;
+		new_timer->when_ms = deltawhen_ms + new_timer->period_started_ms;
 	}
 	new_timer->data_ptr = NULL;
 	if ( event_descrip ) 
@@ -159,7 +194,7 @@ int TimerManager::NewTimer(Service* s, unsigned deltawhen,
 
 
 	new_timer->id = timer_ids++;		
-
+	timer_by_id[new_timer->id] = new_timer;
 
 	InsertTimer( new_timer );
 
@@ -175,17 +210,17 @@ int TimerManager::NewTimer(Service* s, unsigned deltawhen,
 
 int TimerManager::ResetTimerPeriod(int id,unsigned period)
 {
-	return ResetTimer(id,0,period,true);
+	return ResetTimerMs(id,0,timer_ms(period,1000),true,NULL);
 }
 
 bool TimerManager::ResetTimerTimeslice(int id, Timeslice const &new_timeslice)
 {
-	return ResetTimer(id,0,0,false,&new_timeslice)==0;
+	return ResetTimerMs(id,0,0,false,&new_timeslice)==0;
 }
 
 bool TimerManager::GetTimerTimeslice(int id, Timeslice &timeslice)
 {
-	Timer *timer_ptr = GetTimer( id, NULL );
+	Timer *timer_ptr = GetTimer( id );
 	if( !timer_ptr || !timer_ptr->timeslice ) {
 		return false;
 	}
@@ -195,32 +230,44 @@ bool TimerManager::GetTimerTimeslice(int id, Timeslice &timeslice)
 
 time_t TimerManager::GetNextRuntime(int id)
 {
-	Timer *timer_ptr = GetTimer( id, NULL );
+	Timer *timer_ptr = GetTimer( id );
 	if (!timer_ptr) { return false; }
 
-	return timer_ptr->when;
+	if ( timer_ptr->when_ms == TIMER_NEVER_MS ) {
+		return TIME_T_NEVER;
+	}
+		// round up, so the timer is due by then
+	return (time_t)( ( timer_ptr->when_ms + 999 ) / 1000 );
 }
+
 int TimerManager::ResetTimer(int id, unsigned when, unsigned period,
 							 bool recompute_when,
 							 Timeslice const *new_timeslice)
+{
+	return ResetTimerMs(id, timer_ms(when,1000), timer_ms(period,1000),
+						recompute_when, new_timeslice);
+}
+
+int TimerManager::ResetTimerMs(int id, unsigned when_ms, unsigned period_ms)
+{
+	return ResetTimerMs(id, timer_ms(when_ms,1), timer_ms(period_ms,1), false, NULL);
+}
+
+int TimerManager::ResetTimerMs(int id, int64_t when_ms, int64_t period_ms,
+							   bool recompute_when,
+							   Timeslice const *new_timeslice)
 {
 	Timer*			timer_ptr;
-	Timer*			trail_ptr;
 
 	dprintf( D_DAEMONCORE,
-			 "In reset_timer(), id=%d, time=%d, period=%d\n",id,when,period);
-	if (timer_list == NULL) {
+			 "In reset_timer(), id=%d, time=%lldms, period=%lldms\n",id,
+			 (long long)when_ms,(long long)period_ms);
+	if (timer_heap.empty()) {
 		dprintf( D_DAEMONCORE, "Reseting Timer from empty list!\n");
 		return -1;
 	}
 
-	timer_ptr = timer_list;
-	trail_ptr = NULL;
-	while ( timer_ptr && timer_ptr->id != id ) {
-		trail_ptr = timer_ptr;
-		timer_ptr = timer_ptr->next;
-	}
-
+	timer_ptr = GetTimer( id );
 	if ( timer_ptr == NULL ) {
 		dprintf( D_ALWAYS, "Timer %d not found\n",id );
 		return -1;
@@ -233,52 +280,56 @@ int TimerManager::ResetTimer(int id, unsigned when, unsigned period,
 			*timer_ptr->timeslice = *new_timeslice;
 		}
 
-		timer_ptr->when = timer_ptr->timeslice->getNextStartTime();
+		timer_ptr->when_ms = (int64_t)timer_ptr->timeslice->getNextStartTime() * 1000;
 	}
 	else if ( timer_ptr->timeslice ) {
 		dprintf( D_DAEMONCORE, "Timer %d with timeslice can't be reset\n",
 				 id );
 		return 0;
 	} else if( recompute_when ) {
-		time_t old_when = timer_ptr->when;
-
-		timer_ptr->when = timer_ptr->period_started + period;
-
-			// sanity check
-		int wait_time = (int)timer_ptr->when - (int)time(NULL);
-		if( wait_time > (int64_t)period ) {
-			dprintf(D_ALWAYS,
-					"ResetTimer() tried to set next call to %d (%s) %ds into"
-					" the future, which is larger than the new period %d.\n",
-					id,
-					timer_ptr->event_descrip ? timer_ptr->event_descrip : "",
-					wait_time,
-					period);
-
-				// start a new period now to restore sanity
-			timer_ptr->period_started = time(NULL);
-			timer_ptr->when = timer_ptr->period_started + period;
+		int64_t old_when_ms = timer_ptr->when_ms;
+
+		if ( period_ms == TIMER_NEVER_MS ) {
+			timer_ptr->when_ms = TIMER_NEVER_MS;
+		} else {
+			timer_ptr->when_ms = timer_ptr->period_started_ms + period_ms;
+
+				// sanity check
+			int64_t wait_time_ms = timer_ptr->when_ms - timer_now_ms();
+			if( wait_time_ms > period_ms ) {
+				dprintf(D_ALWAYS,
+						"ResetTimer() tried to set next call to %d (%s) %.3fs into"
+						" the future, which is larger than the new period %.3f.\n",
+						id,
+						timer_ptr->event_descrip ? timer_ptr->event_descrip : "",
+						wait_time_ms / 1000.0,
+						period_ms / 1000.0);
+
+					// start a new period now to restore sanity
+				timer_ptr->period_started_ms = timer_now_ms();
+				timer_ptr->when_ms = timer_ptr->period_started_ms + period_ms;
+			}
 		}
 
 		dprintf(D_FULLDEBUG,
-				"Changing period of timer %d (%s) from %u to %u "
-				"(added %ds to time of next scheduled call)\n",
+				"Changing period of timer %d (%s) from %.3f to %.3f "
+				"(added %.3fs to time of next scheduled call)\n",
 				id, 
 				timer_ptr->event_descrip ? timer_ptr->event_descrip : "",
-				timer_ptr->period,
-				period,
-				(int)timer_ptr->when - (int)old_when);
+				timer_ptr->period_ms / 1000.0,
+				period_ms / 1000.0,
+				(timer_ptr->when_ms - old_when_ms) / 1000.0);
 	} else {
-		timer_ptr->period_started = time(NULL);
-		if ( when == TIMER_NEVER ) {
-			timer_ptr->when = TIME_T_NEVER;
+		timer_ptr->period_started_ms = timer_now_ms();
+		if ( when_ms == TIMER_NEVER_MS ) {
+			timer_ptr->when_ms = TIMER_NEVER_MS;
 		} else {
-			timer_ptr->when = when + timer_ptr->period_started;
+			timer_ptr->when_ms = when_ms + timer_ptr->period_started_ms;
 		}
 	}
-	timer_ptr->period = period;
+	timer_ptr->period_ms = period_ms;
 
-	RemoveTimer( timer_ptr, trail_ptr );
+	RemoveTimer( timer_ptr );
 	InsertTimer( timer_ptr );
 
 	if ( in_timeout == timer_ptr ) {
@@ -293,27 +344,21 @@ int TimerManager::ResetTimer(int id, unsigned when, unsigned period,
 int TimerManager::CancelTimer(int id)
 {
 	Timer*		timer_ptr;
-	Timer*		trail_ptr;
 
 	dprintf( D_DAEMONCORE, "In cancel_timer(), id=%d\n",id);
-	if (timer_list == NULL) {
+	if (timer_heap.empty()) {
 		dprintf( D_DAEMONCORE, "Removing Timer from empty list!\n");
 		return -1;
 	}
 
-	timer_ptr = timer_list;
-	trail_ptr = NULL;
-	while ( timer_ptr && timer_ptr->id != id ) {
-		trail_ptr = timer_ptr;
-		timer_ptr = timer_ptr->next;
-	}
-
+	timer_ptr = GetTimer( id );
 	if ( timer_ptr == NULL ) {
 		dprintf( D_ALWAYS, "Timer %d not found\n",id );
 		return -1;
 	}
 
-	RemoveTimer( timer_ptr, trail_ptr );
+	RemoveTimer( timer_ptr );
+	timer_by_id.erase( id );
 
 	if ( in_timeout == timer_ptr ) {
 		// We're inside the handler for this timer. Don't delete it,
@@ -329,21 +374,19 @@ int TimerManager::CancelTimer(int id)
 
 void TimerManager::CancelAllTimers()
 {
-	Timer		*timer_ptr;
+	std::vector<Timer*> timers;
+	timers.swap( timer_heap );
+	timer_by_id.clear();
 
-	while( timer_list != NULL ) {
-		timer_ptr = timer_list;
-		timer_list = timer_list->next;
-		if( in_timeout == timer_ptr ) {
+	for( size_t i = 0; i < timers.size(); i++ ) {
+		if( in_timeout == timers[i] ) {
 				// We get here if somebody calls exit from inside a timer.
 			did_cancel = true;
 		}
 		else {
-			DeleteTimer( timer_ptr );
+			DeleteTimer( timers[i] );
 		}
 	}
-	timer_list = NULL;
-	list_tail = NULL;
 }
 
 // Timeout() is called when a select() time out.  Returns number of seconds
@@ -352,94 +395,93 @@ void TimerManager::CancelAllTimers()
 // Timeout is not re-entrant).
 int
 TimerManager::Timeout(int * pNumFired /*= NULL*/, double * pruntime /*=NULL*/)
+{
+	int result = TimeoutMs( pNumFired, pruntime );
+	if ( result > 0 ) {
+			// round up, so that we do not busy poll until a timer is due
+		result = result / 1000 + ( result % 1000 ? 1 : 0 );
+	}
+	return result;
+}
+
+// Same as Timeout(), but the result is in milliseconds.
+int
+TimerManager::TimeoutMs(int * pNumFired /*= NULL*/, double * pruntime /*=NULL*/)
 {
 	int				result;
-	time_t			now;
+	int64_t			now_ms;
 	int				num_fires = 0;	// num of handlers called in this timeout
 
     if (pNumFired) *pNumFired = 0;
 
 	if ( in_timeout != NULL ) {
 		dprintf(D_DAEMONCORE,"DaemonCore Timeout() called and in_timeout is non-NULL\n");
-		if ( timer_list == NULL ) {
-			result = 0;
-		} else {
-			result = (timer_list->when) - time(NULL);
+		if ( timer_heap.empty() ) {
+			return 0;
 		}
-		if ( result < 0 ) {
-			result = 0;
+		int64_t wait_ms = timer_heap[0]->when_ms - timer_now_ms();
+		if ( wait_ms < 0 ) {
+			wait_ms = 0;
 		}
-		return(result);
+		return wait_ms > INT_MAX ? INT_MAX : (int)wait_ms;
 	}
 		
 	dprintf( D_DAEMONCORE, "In DaemonCore Timeout()\n");
 
-	if (timer_list == NULL) {
+	if (timer_heap.empty()) {
 		dprintf( D_DAEMONCORE, "Empty timer list, nothing to do\n" );
 	}
 
-	time(&now);
+	now_ms = timer_now_ms();
 
 	DumpTimerList(D_DAEMONCORE | D_FULLDEBUG);
 
     // if we are going to not limit the number of timer handlers we invoke,
-    // make a set now of all timers that are ready to go... below we will
-    // use this set in order to NOT invoke new timers that are inserted by
-    // timer handlers themselves.
-    std::unordered_set<int> readyTimerIds;
+    // make a list now of all timers that are ready to go, in the order they
+    // are due... below we will only invoke these, in order to NOT invoke new
+    // timers that are inserted by timer handlers themselves.
+    std::vector<int> readyTimerIds;
+    size_t nextReady = 0;
     if (max_timer_events_per_cycle == INT_MAX) {
-        in_timeout = timer_list;
-        while ((in_timeout != NULL) && (in_timeout->when <= now)) {
-            readyTimerIds.insert(in_timeout->id);
-            in_timeout = in_timeout->next;
+        std::vector<Timer*> due;
+        CollectDue(0, now_ms, due);
+        std::sort(due.begin(), due.end(), TimerBefore);
+        readyTimerIds.reserve(due.size());
+        for (size_t i = 0; i < due.size(); i++) {
+            readyTimerIds.push_back(due[i]->id);
         }
-        in_timeout = NULL;
     }
 
 	// loop until all handlers that should have been called by now or before
 	// are invoked and renewed if periodic.  Remember that NewTimer and CancelTimer
-	// keep the timer_list happily sorted on "when" for us.  We use "now" as a 
+	// keep the timer_heap ordered on "when_ms" for us.  We use "now_ms" as a
 	// variable so that if some of these handler functions run for a long time,
 	// we do not sit in this loop forever.
 	// we make certain we do not call more than "max_fires" handlers in a 
 	// single timeout --- this ensures that timers don't starve out the rest
 	// of daemonCore if a timer handler resets itself to 0.
-	while( (timer_list != NULL) && (timer_list->when <= now ) &&
-		   (num_fires < max_timer_events_per_cycle))
+	for (;;)
 	{
-        in_timeout = timer_list;
-
-        // In this code block, if there is no limit on how many timer handlers we will invoke,
-        // we want to skip over timers that got  added or reset by other timer handlers to make
-        // certain we aren't stuck here forever. So we will only call timer handlers that
-        // were ready to fire when we first entered Timeout().
         if (max_timer_events_per_cycle == INT_MAX) {
-            std::unordered_set<int>::iterator it;
-            bool call_handler = false;
-            // Skip handlers already invoked or added
-            do {
-                it = readyTimerIds.find(in_timeout->id);
-                if (it == readyTimerIds.end()) {
-                    // this timer was not ready when we first looked, so it must have been
-                    // added or reset by another timer callback.  in this case, skip this timer
-                    // callback (we will deal with it next time through the daemoncore loop).
-                    dprintf(D_DAEMONCORE, "Timer %d not fired (SKIPPED) cause added\n", in_timeout->id);
-                    in_timeout = in_timeout->next;
-                }
-                else {
-                    // this timer was ready to fire when we first looked at the timer list, so
-                    // we are going to go ahead and call its handler.  Erase it from our readyTimerIds
-                    // list, and then break out of loop to go ahead and call the handler.
-                    call_handler = true;
-                    readyTimerIds.erase(it);
-                }
-            } while ((!call_handler) && (in_timeout != NULL) && (in_timeout->when <= now));
-
-            if (!call_handler) {
-                // no timers left that we want to fire at this time, break out of outer while loop
+            // If there is no limit on how many timer handlers we will invoke,
+            // only call timer handlers that were ready to fire when we first
+            // entered Timeout(), and that have not since been canceled or
+            // reset into the future by other timer handlers.
+            if (nextReady >= readyTimerIds.size()) {
                 break;
             }
-        }  // end of block if max_timer_events_per_cycle == INT_MAX
+            in_timeout = GetTimer(readyTimerIds[nextReady++]);
+            if (in_timeout == NULL || in_timeout->when_ms > now_ms) {
+                in_timeout = NULL;
+                continue;
+            }
+        } else {
+            if (timer_heap.empty() || timer_heap[0]->when_ms > now_ms ||
+                num_fires >= max_timer_events_per_cycle) {
+                break;
+            }
+            in_timeout = timer_heap[0];
+        }
 
         num_fires++;
 
@@ -506,53 +548,46 @@ TimerManager::Timeout(int * pNumFired /*= NULL*/, double * pruntime /*=NULL*/)
 		} else if ( !did_reset ) {
 			// here we remove the timer we just serviced, or renew it if it is 
 			// periodic.
+			RemoveTimer( in_timeout );
 
-			// If a new timer was added at a time in the past
-			// (possible when resetting a timeslice timer), then
-			// it may have landed before the timer we just processed,
-			// meaning that we cannot assume prev==NULL in the call
-			// to RemoveTimer() below.
-
-			Timer *prev = NULL;
-			ASSERT( GetTimer(in_timeout->id,&prev) == in_timeout );
-			RemoveTimer( in_timeout, prev );
-
-			if ( in_timeout->period > 0 || in_timeout->timeslice ) {
-				in_timeout->period_started = time(NULL);
-				in_timeout->when = in_timeout->period_started;
+			if ( in_timeout->period_ms > 0 || in_timeout->timeslice ) {
+				in_timeout->period_started_ms = timer_now_ms();
 				if ( in_timeout->timeslice ) {
-					in_timeout->when += in_timeout->timeslice->getTimeToNextRun();
+					in_timeout->when_ms = in_timeout->period_started_ms +
+						timer_ms( in_timeout->timeslice->getTimeToNextRun(), 1000 );
+				} else if( in_timeout->period_ms == TIMER_NEVER_MS ) {
+					in_timeout->when_ms = TIMER_NEVER_MS;
 				} else {
-					if( in_timeout->period == TIMER_NEVER ) {
-						in_timeout->when = TIME_T_NEVER;
-					} else {
-						in_timeout->when += in_timeout->period;
-					}
+					in_timeout->when_ms = in_timeout->period_started_ms + in_timeout->period_ms;
 				}
 				InsertTimer( in_timeout );
 			} else {
 				// timer is not perodic; it is just a one-time event.  we just called
 				// the handler, so now just delete it. 
+				timer_by_id.erase( in_timeout->id );
 				DeleteTimer( in_timeout );
 			}
 		}
-	}  // end of while loop
+		in_timeout = NULL;
+	}  // end of loop
 
 
-	// set result to number of seconds until next event.  get an update on the
-	// time from time() in case the handlers we called above took significant time.
-	if ( timer_list == NULL ) {
+	// set result to number of ms until next event.  get an update on the
+	// time in case the handlers we called above took significant time.
+	if ( timer_heap.empty() ) {
 		// we set result to be -1 so that we do not busy poll.
 		// a -1 return value will tell the DaemonCore:Driver to use select with
 		// no timeout.
 		result = -1;
 	} else {
-		result = (timer_list->when) - time(NULL);
-		if (result < 0)
-			result = 0;
+		int64_t wait_ms = timer_heap[0]->when_ms - timer_now_ms();
+		if ( wait_ms < 0 ) {
+			wait_ms = 0;
+		}
+		result = wait_ms > INT_MAX ? INT_MAX : (int)wait_ms;
 	}
 
-	dprintf( D_DAEMONCORE, "DaemonCore Timeout() Complete, returning %d \n",result);
+	dprintf( D_DAEMONCORE, "DaemonCore Timeout() Complete, returning %dms\n",result);
     if (pNumFired) *pNumFired = num_fires;
 	in_timeout = NULL;
 	return(result);
@@ -563,7 +598,6 @@ TimerManager::Timeout(int * pNumFired /*= NULL*/, double * pruntime /*=NULL*/)
 
 void TimerManager::DumpTimerList(int flag, const char* indent)
 {
-	Timer		*timer_ptr;
 	const char	*ptmp;
 
 	// we want to allow flag to be "D_FULLDEBUG | D_DAEMONCORE",
@@ -580,8 +614,11 @@ void TimerManager::DumpTimerList(int flag, const char* indent)
 	dprintf(flag, "\n");
 	dprintf(flag, "%sTimers\n", indent);
 	dprintf(flag, "%s~~~~~~\n", indent);
-	for(timer_ptr = timer_list; timer_ptr != NULL; timer_ptr = timer_ptr->next)
+	std::vector<Timer*> timers( timer_heap );
+	std::sort( timers.begin(), timers.end(), TimerBefore );
+	for( size_t i = 0; i < timers.size(); i++ )
 	{
+		Timer *timer_ptr = timers[i];
 		if ( timer_ptr->event_descrip )
 			ptmp = timer_ptr->event_descrip;
 		else
@@ -589,7 +626,7 @@ void TimerManager::DumpTimerList(int flag, const char* indent)
 
 		std::string slice_desc;
 		if( !timer_ptr->timeslice ) {
-			formatstr(slice_desc, "period = %d, ", timer_ptr->period);
+			formatstr(slice_desc, "period = %.3f, ", timer_ptr->period_ms / 1000.0);
 		}
 		else {
 			formatstr_cat(slice_desc, "timeslice = %.3g, ",
@@ -612,8 +649,10 @@ void TimerManager::DumpTimerList(int flag, const char* indent)
 			}
 		}
 		dprintf(flag, 
-				"%sid = %d, when = %ld, %shandler_descrip=<%s>\n", 
-				indent, timer_ptr->id, (long)timer_ptr->when, 
+				"%sid = %d, when = %lld.%03d, %shandler_descrip=<%s>\n", 
+				indent, timer_ptr->id,
+				(long long)( timer_ptr->when_ms / 1000 ),
+				(int)( timer_ptr->when_ms % 1000 ),
 				slice_desc.c_str(),ptmp);
 	}
 	dprintf(flag, "\n");
@@ -648,68 +687,88 @@ void TimerManager::Start()
 	}
 }
 
-void TimerManager::RemoveTimer( Timer *timer, Timer *prev )
+void TimerManager::HeapUp( size_t i )
 {
-	if ( timer == NULL || ( prev && prev->next != timer ) ||
-		 ( !prev && timer != timer_list ) ) {
-		EXCEPT( "Bad call to TimerManager::RemoveTimer()!" );
+	Timer *timer = timer_heap[i];
+	while ( i > 0 ) {
+		size_t parent = ( i - 1 ) / 2;
+		if ( !TimerBefore( timer, timer_heap[parent] ) ) {
+			break;
+		}
+		timer_heap[i] = timer_heap[parent];
+		timer_heap[i]->heap_index = i;
+		i = parent;
+	}
+	timer_heap[i] = timer;
+	timer->heap_index = i;
+}
+
+void TimerManager::HeapDown( size_t i )
+{
+	Timer *timer = timer_heap[i];
+	size_t n = timer_heap.size();
+	for (;;) {
+		size_t child = 2 * i + 1;
+		if ( child >= n ) {
+			break;
+		}
+		if ( child + 1 < n && TimerBefore( timer_heap[child + 1], timer_heap[child] ) ) {
+			child++;
+		}
+		if ( !TimerBefore( timer_heap[child], timer ) ) {
+			break;
+		}
+		timer_heap[i] = timer_heap[child];
+		timer_heap[i]->heap_index = i;
+		i = child;
 	}
+	timer_heap[i] = timer;
+	timer->heap_index = i;
+}
 
-	if ( timer == timer_list ) {
-		timer_list = timer_list->next;
+// Add the timers in the subheap at i that are due by now_ms to due.
+void TimerManager::CollectDue( size_t i, int64_t now_ms, std::vector<Timer*> &due )
+{
+	if ( i >= timer_heap.size() || timer_heap[i]->when_ms > now_ms ) {
+		return;
 	}
-	if ( timer == list_tail ) {
-		list_tail = prev;
+	due.push_back( timer_heap[i] );
+	CollectDue( 2 * i + 1, now_ms, due );
+	CollectDue( 2 * i + 2, now_ms, due );
+}
+
+void TimerManager::RemoveTimer( Timer *timer )
+{
+	if ( timer == NULL || timer->heap_index >= timer_heap.size() ||
+		 timer_heap[timer->heap_index] != timer ) {
+		EXCEPT( "Bad call to TimerManager::RemoveTimer()!" );
 	}
-	if ( prev ) {
-		prev->next = timer->next;
+
+	size_t i = timer->heap_index;
+	Timer *last = timer_heap.back();
+	timer_heap.pop_back();
+	if ( last != timer ) {
+		timer_heap[i] = last;
+		last->heap_index = i;
+		HeapDown( i );
+		HeapUp( last->heap_index );
 	}
 }
 
 void TimerManager::InsertTimer( Timer *new_timer )
 {
-	if ( timer_list == NULL ) {
-		// list is empty, place ours in front
-		timer_list = new_timer;
-		list_tail = new_timer;
-		new_timer->next = NULL;
-			// since we have a new first timer, we must wake up select
+	// Timers with the same "when" are ordered by seq, so that a timer
+	// goes after the ones already due at the same time -- this makes
+	// certain we "round-robin" across timers that constantly reset
+	// themselves to zero.
+	new_timer->seq = timer_seq++;
+	new_timer->heap_index = timer_heap.size();
+	timer_heap.push_back( new_timer );
+	HeapUp( new_timer->heap_index );
+
+	if ( timer_heap[0] == new_timer ) {
+		// since we have a new first timer, we must wake up select
 		daemonCore->Wake_up_select();
-	} else {
-		// list is not empty, so keep timer_list ordered from soonest to
-		// farthest (i.e. sorted on "when").
-		// Note: when doing the comparisons, we always use "<" instead
-		// of "<=" -- this makes certain we "round-robin" across 
-		// timers that constantly reset themselves to zero.
-		if ( new_timer->when < timer_list->when ) {
-			// make the this new timer first in line
-			new_timer->next = timer_list;
-			timer_list = new_timer;
-			// since we have a new first timer, we must wake up select
-			daemonCore->Wake_up_select();
-		} else if ( new_timer->when == TIME_T_NEVER ) {
-			// Our new timer goes to the very back of the list.
-			new_timer->next = NULL;
-			list_tail->next = new_timer;
-			list_tail = new_timer;
-		} else {
-			Timer* timer_ptr;
-			Timer* trail_ptr = NULL;
-			for (timer_ptr = timer_list; timer_ptr != NULL; 
-				 timer_ptr = timer_ptr->next ) 
-			{
-				if (new_timer->when < timer_ptr->when) {
-					break;
-				}
-				trail_ptr = timer_ptr;
-			}
-			ASSERT( trail_ptr );
-			new_timer->next = timer_ptr;
-			trail_ptr->next = new_timer;
-			if ( trail_ptr == list_tail ) {
-				list_tail = new_timer;
-			}
-		}
 	}
 }
 
@@ -735,18 +794,11 @@ void TimerManager::DeleteTimer( Timer *timer )
 	delete timer;
 }
 
-Timer *TimerManager::GetTimer( int id, Timer **prev )
+Timer *TimerManager::GetTimer( int id )
 {
-	Timer *timer_ptr = timer_list;
-	if( prev ) {
-		*prev = NULL;
-	}
-	while ( timer_ptr && timer_ptr->id != id ) {
-		if( prev ) {
-			*prev = timer_ptr;
-		}
-		timer_ptr = timer_ptr->next;
+	std::unordered_map<int, Timer*>::const_iterator it = timer_by_id.find( id );
+	if ( it == timer_by_id.end() ) {
+		return NULL;
 	}
-
-	return timer_ptr;
+	return it->second;
 }
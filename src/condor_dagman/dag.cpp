@@ -102,7 +102,6 @@ Dag::Dag( /* const */ std::list<std::string> &dagFiles,
 	_useDagDir            (useDagDir),
 	_final_job (0),
 	_nodeNameHash		  (hashFunction),
-	_nodeIDHash			  (hashFuncInt),
 	_condorIDHash		  (hashFuncInt),
 	_noopIDHash			  (hashFuncInt),
     _numNodesDone         (0),
@@ -154,7 +153,7 @@ Dag::Dag( /* const */ std::list<std::string> &dagFiles,
 		PrintDagFiles( dagFiles );
 	}
 
- 	_readyQ = new PrioritySimpleList<Job*>;
+ 	_readyQ = new ReadyQueue;
 	_submitQ = new std::queue<Job*>;
 	if( !_readyQ || !_submitQ ) {
 		EXCEPT( "ERROR: out of memory (%s:%d)!", __FILE__, __LINE__ );
@@ -419,8 +418,8 @@ Dag::AddDependency( Job* parent, Job* child )
 
 //-------------------------------------------------------------------------
 Job * Dag::FindNodeByNodeID (const JobID_t jobID) const {
-	Job *	job = NULL;
-	if ( _nodeIDHash.lookup(jobID, job) != 0 ) {
+	Job *	job = _nodeIDIndex.Find( jobID );
+	if ( ! job ) {
     	debug_printf( DEBUG_NORMAL, "ERROR: job %d not found!\n", jobID);
 		dprintf(D_ALWAYS | D_BACKTRACE, "caller info");
 		job = NULL;
@@ -1571,17 +1570,16 @@ Dag::StartFinalNode()
 			// Note:  maybe we should change nodes in the prerun state
 			// to not ready here, to be more consistent.  But I'm not
 			// dealing with that for now.  wenger 2014-03-17
-		Job* job;
-		_readyQ->Rewind();
-		while ( _readyQ->Next( job ) ) {
+		_readyQ->RemoveIf( []( Job* job ) {
 			if ( !(job->GetType() == NodeType::FINAL) ) {
 				debug_printf( DEBUG_DEBUG_1,
 							"Removing node %s from ready queue\n",
 							job->GetJobName() );
-				_readyQ->DeleteCurrent();
 				job->SetStatus( Job::STATUS_NOT_READY );
+				return true;
 			}
-		}
+			return false;
+		} );
 
 			// Now start up the final node.
 		_final_job->SetStatus( Job::STATUS_READY );
@@ -1628,7 +1626,7 @@ Dag::SubmitReadyJobs(const Dagman &dm)
 	time_t cycleStart = time( NULL );
 
 		// Jobs deferred by category throttles.
-	PrioritySimpleList<Job*> deferredJobs;
+	ReadyQueue deferredJobs;
 
 	int numSubmitsThisCycle = 0;
 
@@ -1727,10 +1725,7 @@ Dag::SubmitReadyJobs(const Dagman &dm)
 		}
 
 			// remove & submit first job from ready queue
-		Job* job;
-		_readyQ->Rewind();
-		_readyQ->Next( job );
-		_readyQ->DeleteCurrent();
+		Job* job = _readyQ->PopFront();
 		ASSERT( job != NULL );
 
 		debug_printf( DEBUG_DEBUG_1, "Got node %s from the ready queue\n",
@@ -1787,9 +1782,8 @@ Dag::SubmitReadyJobs(const Dagman &dm)
 	}
 
 		// Put any deferred jobs back into the ready queue for next time.
-	deferredJobs.Rewind();
 	Job *job;
-	while ( deferredJobs.Next( job ) ) {
+	while ( (job = deferredJobs.PopFront()) ) {
 		debug_printf( DEBUG_DEBUG_1,
 					"Returning deferred node %s to the ready queue\n",
 					job->GetJobName() );
@@ -2059,15 +2053,11 @@ Dag::PrintReadyQ( debug_level_t level ) const {
 			dprintf( D_ALWAYS | D_NOHEADER, "<empty>\n" );
 			return;
 		}
-		_readyQ->Rewind();
-		Job* job = 0;
-		_readyQ->Next( job );
-		if( job ) {
-			dprintf( D_ALWAYS | D_NOHEADER, "%s", job->GetJobName() );
-		}
-		while( _readyQ->Next( job ) ) {
-			dprintf( D_ALWAYS | D_NOHEADER, ", %s", job->GetJobName() );
-		}
+		const char * sep = "";
+		_readyQ->ForEach( [&sep]( Job* job ) {
+			dprintf( D_ALWAYS | D_NOHEADER, "%s%s", sep, job->GetJobName() );
+			sep = ", ";
+		} );
 		dprintf( D_ALWAYS | D_NOHEADER, "\n" );
 	}
 }
@@ -3842,7 +3832,7 @@ bool Dag::Add( Job& job )
 {
 	int insertResult = _nodeNameHash.insert( job.GetJobName(), &job );
 	ASSERT( insertResult == 0 );
-	insertResult = _nodeIDHash.insert( job.GetJobID(), &job );
+	insertResult = _nodeIDIndex.Add( job.GetJobID(), &job ) ? 0 : -1;
 	ASSERT( insertResult == 0 );
 
 		// Final node status is set to STATUS_NOT_READY here, so it
@@ -3923,16 +3913,7 @@ Dag::RemoveNode( const char *name, MyString &whynot )
 			debug_printf( DEBUG_VERBOSE, "=== Ready Queue (Before) ===" );
 			PrintReadyQ( DEBUG_VERBOSE );
 
-			removed = false;
-			_readyQ->Rewind();
-			while( _readyQ->Next( candidate ) ) {
-				ASSERT( candidate );
-				if( candidate == node ) {
-					_readyQ->DeleteCurrent();
-					removed = true;
-					continue;
-				}
-			}
+			removed = _readyQ->Remove( node );
 			ASSERT( removed );
 			ASSERT( !_readyQ->IsMember( node ) );
 			debug_printf( DEBUG_VERBOSE, "=== Ready Queue (After) ===" );
@@ -5050,7 +5031,6 @@ Dag::AssumeOwnershipofNodes(const MyString &spliceName, OwnedMaterials *om)
 	Job *job = NULL;
 	int i;
 	MyString key;
-	JobID_t key_id;
 
 	ExtArray<Job*> *nodes = om->nodes;
 
@@ -5146,8 +5126,7 @@ Dag::AssumeOwnershipofNodes(const MyString &spliceName, OwnedMaterials *om)
 
 	// 3. Update our node id hash to include the new nodes.
 	for (i = 0; i < nodes->length(); i++) {
-		key_id = (*nodes)[i]->GetJobID();
-		if (_nodeIDHash.insert(key_id, (*nodes)[i]) != 0) {
+		if ( ! _nodeIDIndex.Add((*nodes)[i]->GetJobID(), (*nodes)[i])) {
 			debug_error(1, DEBUG_QUIET, 
 				"Found job id collision while taking ownership of node: %s\n",
 				(*nodes)[i]->GetJobName());
@@ -32,7 +32,8 @@
 #include "read_multiple_logs.h"
 #include "check_events.h"
 #include "condor_id.h"
-#include "prioritysimplelist.h"
+#include "ready_queue.h"
+#include "node_id_index.h"
 #include "throttle_by_category.h"
 #include "MyString.h"
 #include "../condor_utils/dagman_utils.h"
@@ -1096,7 +1097,8 @@ private:
 
 	HashTable<MyString, Job *>		_nodeNameHash;
 
-	HashTable<JobID_t, Job *>		_nodeIDHash;
+	// Nodes by node id.
+	NodeIDIndex						_nodeIDIndex;
 
 	// Hash by HTCondorID (really just by the cluster ID because all
 	// procs in the same cluster map to the same node).
@@ -1148,7 +1150,7 @@ private:
 	const CondorID *	_DAGManJobId;
 
 	// queue of jobs ready to be submitted to HTCondor
-	PrioritySimpleList<Job*>* _readyQ;
+	ReadyQueue* _readyQ;
 
 	// queue of submitted jobs not yet matched with submit events in
 	// the HTCondor job log
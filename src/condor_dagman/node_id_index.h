@@ -0,0 +1,80 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+
+#ifndef _NODE_ID_INDEX_H
+#define _NODE_ID_INDEX_H
+
+#include <vector>
+#include <stddef.h>
+
+class Job;
+
+// The nodes of a DAG by node id.  Node ids are handed out in order as nodes
+// are created, so the nodes are kept in a vector indexed by (node id - base)
+// rather than in a hash table.  The base is the lowest id added so far.
+class NodeIDIndex {
+public:
+	NodeIDIndex() : _base(0) {}
+
+	// Add a node, returns false if there already is a node with the id.
+	bool Add( int id, Job *node ) {
+		if ( id < 0 ) {
+			return false;
+		}
+		if ( _nodes.empty() ) {
+			_base = id;
+		} else if ( id < _base ) {
+				// The nodes of a splice can have lower ids than ours, since
+				// the splice may have been parsed first.  Make room at the front,
+				// at least doubling the size so that lifting many splices in
+				// any order doesn't shift the whole index every time.
+			int base = _base - (int)_nodes.size();
+			if ( base > id ) base = id;
+			if ( base < 0 ) base = 0;
+			_nodes.insert( _nodes.begin(), _base - base, (Job *)NULL );
+			_base = base;
+		}
+		size_t index = id - _base;
+		if ( index >= _nodes.size() ) {
+			_nodes.resize( index + 1, NULL );
+		}
+		if ( _nodes[index] ) {
+			return false;
+		}
+		_nodes[index] = node;
+		return true;
+	}
+
+	// returns the node with the given id, or NULL if there isn't one.
+	Job * Find( int id ) const {
+		if ( id < _base || (size_t)(id - _base) >= _nodes.size() ) {
+			return NULL;
+		}
+		return _nodes[id - _base];
+	}
+
+	int Base() const { return _base; }
+
+private:
+	std::vector<Job *> _nodes;
+	int _base;
+};
+
+#endif /* #ifndef _NODE_ID_INDEX_H */
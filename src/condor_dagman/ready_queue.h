@@ -0,0 +1,114 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+
+#ifndef _READY_QUEUE_H
+#define _READY_QUEUE_H
+
+#include <map>
+#include <deque>
+
+class Job;
+
+// The queue of nodes that are ready to be submitted.  Nodes come out in
+// priority order (numerically lower prio first, the same as PrioritySimpleList,
+// which this replaces), and in the order they were added within a priority.
+// A node can be added at the front or the back of the nodes of its priority.
+//
+// The nodes of each priority are kept in their own deque, so adding a node
+// and taking the first node cost O(log number of distinct priorities), which
+// is almost always 1, rather than the O(number of ready nodes) it took to
+// shift the array of a PrioritySimpleList, which made submitting a very wide
+// DAG quadratic.  Finding or removing a particular node is still linear, but
+// that only happens when the DAG is aborted, halted, or a node is reset.
+class ReadyQueue {
+public:
+	ReadyQueue() : _count(0) {}
+
+	void Append(Job* node, int prio) { _queues[prio].push_back(node); ++_count; }
+	void Prepend(Job* node, int prio) { _queues[prio].push_front(node); ++_count; }
+
+	bool IsEmpty() const { return _count == 0; }
+	int Number() const { return _count; }
+
+	// remove and return the first node, returns NULL if the queue is empty
+	Job* PopFront() {
+		auto it = _queues.begin();
+		if (it == _queues.end()) return NULL;
+		Job* node = it->second.front();
+		it->second.pop_front();
+		if (it->second.empty()) { _queues.erase(it); }
+		--_count;
+		return node;
+	}
+
+	// returns true if the given node is in the queue.
+	bool IsMember(const Job* node) const {
+		for (auto it = _queues.begin(); it != _queues.end(); ++it) {
+			for (auto jt = it->second.begin(); jt != it->second.end(); ++jt) {
+				if (*jt == node) return true;
+			}
+		}
+		return false;
+	}
+
+	// remove the given node from the queue, returns false if it was not in the queue.
+	bool Remove(const Job* node) {
+		return RemoveIf([node](Job* item) { return item == node; }) > 0;
+	}
+
+	// call fn for each node in queue order.
+	template <class Fn> void ForEach(Fn fn) const {
+		for (auto it = _queues.begin(); it != _queues.end(); ++it) {
+			for (auto jt = it->second.begin(); jt != it->second.end(); ++jt) {
+				fn(*jt);
+			}
+		}
+	}
+
+	// call fn for each node in queue order, removing the nodes for which it returns true.
+	// returns the number of nodes removed.
+	template <class Fn> int RemoveIf(Fn fn) {
+		int removed = 0;
+		for (auto it = _queues.begin(); it != _queues.end(); ) {
+			std::deque<Job*> & nodes = it->second;
+			for (auto jt = nodes.begin(); jt != nodes.end(); ) {
+				if (fn(*jt)) {
+					jt = nodes.erase(jt);
+					++removed;
+				} else {
+					++jt;
+				}
+			}
+			if (nodes.empty()) {
+				it = _queues.erase(it);
+			} else {
+				++it;
+			}
+		}
+		_count -= removed;
+		return removed;
+	}
+
+private:
+	std::map<int, std::deque<Job*> > _queues; // nodes by priority, in queue order
+	int _count;
+};
+
+#endif /* #ifndef _READY_QUEUE_H */
@@ -0,0 +1,258 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for the ReadyQueue and the NodeIDIndex of DAGMan.
+//
+// With -benchmark [nodes [layers]] it also runs a synthetic DAG of that
+// many nodes through the ready queue and node id lookups the way
+// Dag::SubmitReadyJobs() and Dag::ProcessSuccessfulSubmit() do, once with
+// ReadyQueue and NodeIDIndex and once with the PrioritySimpleList and
+// HashTable they replaced, and reports how long each took.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "HashTable.h"
+#include "prioritysimplelist.h"
+#include "stopwatch.h"
+#include "ready_queue.h"
+#include "node_id_index.h"
+#include "test_check.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// These tests never look inside a Job, so the nodes are just distinct
+// addresses in this array.
+static std::vector<char> node_storage;
+
+static Job *
+node( int ix )
+{
+	return reinterpret_cast<Job *>( &node_storage[ix] );
+}
+
+static int
+node_number( Job *job )
+{
+	return (int)( reinterpret_cast<char *>( job ) - &node_storage[0] );
+}
+
+// the node numbers in the order they come out of the queue
+static std::string
+drain( ReadyQueue &q )
+{
+	std::string order;
+	Job *job;
+	while ( (job = q.PopFront()) ) {
+		if ( ! order.empty() ) order += ',';
+		order += std::to_string( node_number( job ) );
+	}
+	return order;
+}
+
+static void
+test_ready_queue()
+{
+	ReadyQueue q;
+	check( "a new queue is empty", q.IsEmpty() && q.Number() == 0 && q.PopFront() == NULL );
+
+		// DAGMan adds nodes with the negated node priority, so that the
+		// highest priority nodes come out first
+	q.Append( node(1), 0 );
+	q.Append( node(2), -10 );
+	q.Append( node(3), 0 );
+	q.Append( node(4), 5 );
+	q.Append( node(5), -10 );
+	check( "nodes are counted", q.Number() == 5 && ! q.IsEmpty() );
+	check( "priority order, then first in first out", drain( q ) == "2,5,1,3,4" );
+	check( "a drained queue is empty", q.IsEmpty() && q.Number() == 0 );
+
+	q.Append( node(1), 0 );
+	q.Append( node(2), 0 );
+	q.Prepend( node(3), 0 );
+	q.Prepend( node(4), 1 );
+	q.Append( node(5), -1 );
+	q.Prepend( node(6), -1 );
+	check( "prepended nodes go first within their priority", drain( q ) == "6,5,3,1,2,4" );
+
+	for ( int ix = 1; ix <= 6; ++ix ) {
+		q.Append( node(ix), ix % 2 );
+	}
+	check( "membership", q.IsMember( node(3) ) && ! q.IsMember( node(7) ) );
+	check( "remove a node", q.Remove( node(3) ) && ! q.IsMember( node(3) ) && q.Number() == 5 );
+	check( "remove a node that isn't there", ! q.Remove( node(3) ) && q.Number() == 5 );
+	std::string order;
+	q.ForEach( [&order]( Job *job ) { order += std::to_string( node_number( job ) ); } );
+	check( "walk the queue in order", order == "24615" );
+	int removed = q.RemoveIf( []( Job *job ) { return node_number( job ) > 4; } );
+	check( "remove the nodes that match", removed == 2 && q.Number() == 3 );
+	check( "the rest keep their order", drain( q ) == "2,4,1" );
+}
+
+static void
+test_node_id_index()
+{
+	NodeIDIndex index;
+	check( "an empty index finds nothing", index.Find( 0 ) == NULL && index.Find( -1 ) == NULL );
+
+		// the first node added sets the base, as when the nodes of a DAG
+		// are numbered after those of a splice that was parsed first
+	check( "add the first node", index.Add( 100, node(100) ) && index.Base() == 100 );
+	check( "add the next nodes", index.Add( 101, node(101) ) && index.Add( 105, node(105) ) );
+	check( "find nodes above the base",
+		index.Find( 100 ) == node(100) && index.Find( 101 ) == node(101) && index.Find( 105 ) == node(105) );
+	check( "ids in the gaps and out of range are not found",
+		index.Find( 102 ) == NULL && index.Find( 106 ) == NULL && index.Find( 99 ) == NULL &&
+		index.Find( 0 ) == NULL && index.Find( -1 ) == NULL );
+	check( "an id can't be added twice", ! index.Add( 101, node(7) ) && index.Find( 101 ) == node(101) );
+	check( "negative ids can't be added", ! index.Add( -1, node(7) ) );
+
+		// lifting in a splice whose nodes were numbered before ours
+	check( "add a node below the base", index.Add( 98, node(98) ) );
+	check( "the base moves down", index.Base() <= 98 );
+	check( "find nodes on both sides of the old base",
+		index.Find( 98 ) == node(98) && index.Find( 100 ) == node(100) && index.Find( 105 ) == node(105) );
+	check( "the gap below the old base is empty", index.Find( 99 ) == NULL && index.Find( 97 ) == NULL );
+	check( "the base never goes below 0", index.Add( 1, node(1) ) && index.Base() >= 0 && index.Base() <= 1 );
+	check( "node 0 can be added", index.Add( 0, node(0) ) && index.Base() == 0 && index.Find( 0 ) == node(0) );
+	check( "every node is still found",
+		index.Find( 1 ) == node(1) && index.Find( 98 ) == node(98) && index.Find( 100 ) == node(100) &&
+		index.Find( 101 ) == node(101) && index.Find( 105 ) == node(105) );
+}
+
+// A synthetic DAG of the given number of nodes in layers, each node but
+// those of the first layer a child of two nodes of the layer before it.
+// Runs each node as soon as all of its parents are done.
+struct SyntheticDag {
+	int num_nodes;
+	int width;
+	int first_id;
+	std::vector<int> waiting; // unfinished parents of each node
+
+	SyntheticDag( int nodes, int layers ) : num_nodes( nodes ), width( nodes / layers ), first_id( 1000 ) {
+		if ( width < 1 ) width = 1;
+	}
+	void reset() {
+		waiting.assign( num_nodes, 0 );
+		for ( int ix = width; ix < num_nodes; ++ix ) {
+			waiting[ix] = (width > 1) ? 2 : 1;
+		}
+	}
+	// the node numbers of the children of a node
+	int children( int ix, int kids[2] ) const {
+		int child = ix + width;
+		if ( child >= num_nodes ) return 0;
+		kids[0] = child;
+		if ( width == 1 ) return 1;
+		int layer = child - child % width;
+		kids[1] = layer + (child + 1) % width;
+		return 2;
+	}
+	int priority( int ix ) const { return -(ix % 7); }
+};
+
+template <class Queue, class Append, class Pop, class Find>
+static double
+run_dag( SyntheticDag &dag, Queue &q, Append append, Pop pop, Find find, int &done )
+{
+	Stopwatch timer;
+	timer.start();
+	dag.reset();
+	done = 0;
+	for ( int ix = 0; ix < dag.width && ix < dag.num_nodes; ++ix ) {
+		append( q, node(ix), dag.priority( ix ) );
+	}
+	Job *job;
+	while ( (job = pop( q )) ) {
+		int ix = node_number( job );
+		++done;
+		int kids[2];
+		int num_kids = dag.children( ix, kids );
+		for ( int kx = 0; kx < num_kids; ++kx ) {
+			Job *child = find( dag.first_id + kids[kx] );
+			int cx = node_number( child );
+			if ( --dag.waiting[cx] == 0 ) {
+				append( q, child, dag.priority( cx ) );
+			}
+		}
+	}
+	return timer.stop();
+}
+
+static void
+benchmark( int num_nodes, int layers )
+{
+	SyntheticDag dag( num_nodes, layers );
+	node_storage.assign( num_nodes, 0 );
+
+	NodeIDIndex index;
+	HashTable<int, Job *> hash( hashFuncInt );
+	for ( int ix = 0; ix < num_nodes; ++ix ) {
+		index.Add( dag.first_id + ix, node(ix) );
+		hash.insert( dag.first_id + ix, node(ix) );
+	}
+
+	int done_new = 0, done_old = 0;
+	ReadyQueue ready;
+	double new_ms = run_dag( dag, ready,
+		[]( ReadyQueue &q, Job *job, int prio ) { q.Append( job, prio ); },
+		[]( ReadyQueue &q ) { return q.PopFront(); },
+		[&index]( int id ) { return index.Find( id ); },
+		done_new );
+
+	PrioritySimpleList<Job *> old_ready;
+	double old_ms = run_dag( dag, old_ready,
+		[]( PrioritySimpleList<Job *> &q, Job *job, int prio ) { q.Append( job, prio ); },
+		[]( PrioritySimpleList<Job *> &q ) {
+			Job *job = NULL;
+			q.Rewind();
+			if ( q.Next( job ) ) {
+				q.DeleteCurrent();
+			}
+			return job;
+		},
+		[&hash]( int id ) { Job *job = NULL; hash.lookup( id, job ); return job; },
+		done_old );
+
+	printf( "DAG of %d nodes in %d layers of %d: ReadyQueue and NodeIDIndex %.3f seconds, "
+		"PrioritySimpleList and HashTable %.3f seconds\n",
+		num_nodes, layers, dag.width, new_ms / 1000, old_ms / 1000 );
+	check( "every node of the benchmark DAG ran", done_new == num_nodes && done_old == num_nodes );
+}
+
+int
+main( int argc, char **argv )
+{
+	node_storage.assign( 200, 0 );
+	test_ready_queue();
+	test_node_id_index();
+
+	if ( argc > 1 && strcmp( argv[1], "-benchmark" ) == MATCH ) {
+		int num_nodes = (argc > 2) ? atoi( argv[2] ) : 100000;
+		int layers = (argc > 3) ? atoi( argv[3] ) : 4;
+		if ( num_nodes < 1 || layers < 1 ) {
+			fprintf( stderr, "Usage: %s [-benchmark [nodes [layers]]]\n", argv[0] );
+			return 1;
+		}
+		benchmark( num_nodes, layers );
+	}
+
+	return check_results();
+}
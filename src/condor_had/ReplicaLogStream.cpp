@@ -0,0 +1,692 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_daemon_core.h"
+// for 'param' function
+#include "condor_config.h"
+// for 'Daemon' class
+#include "daemon.h"
+#include "daemon_types.h"
+#include "condor_attributes.h"
+#include "condor_fsync.h"
+#include "classad_log.h"
+#include "condor_md.h"
+
+#include "ReplicaLogStream.h"
+#include "Utils.h"
+
+// the most of the state file that is sent in one message
+#define STREAM_CHUNK_SIZE (1024 * 1024)
+// the most of the state file that is sent to one backup in one call of the
+// timer handler
+#define STREAM_SHIP_LIMIT (4 * STREAM_CHUNK_SIZE)
+// how much of the end of a backup's copy of the state file is compared with
+// the leader's, which covers at least the last transaction of most logs
+#define STREAM_VERIFY_SIZE (64 * 1024)
+
+ReplicaLogStream::ReplicaLogStream():
+	m_enabled( false ), m_connectionTimeout( DEFAULT_SEND_COMMAND_TIMEOUT ),
+	m_shipTimerId( -1 ), m_shipInterval( 1 ), m_committedEnd( 0 ), m_committedTime( 0 ),
+	m_sequenceNumber( 0 ), m_birthdate( 0 ), m_bytesSent( 0 ),
+	m_leaderSocket( NULL ), m_localEnd( 0 ), m_needsFullTransfer( false ),
+	m_bytesReceived( 0 ), m_lagBytes( 0 ), m_lagSeconds( 0 )
+{
+}
+
+ReplicaLogStream::~ReplicaLogStream()
+{
+	finalize( );
+}
+
+void
+ReplicaLogStream::initialize( const MyString& stateFilePath,
+                              int connectionTimeout )
+{
+	finalize( );
+
+	m_stateFilePath     = stateFilePath;
+	m_connectionTimeout = connectionTimeout;
+	m_committedEnd      = 0;
+	m_sequenceNumber    = 0;
+	m_birthdate         = 0;
+	m_enabled           = param_boolean( "REPLICATION_STREAM_LOG", false );
+	if( ! m_enabled ) {
+		return ;
+	}
+
+	m_shipInterval = param_integer( "REPLICATION_STREAM_INTERVAL", 1, 1 );
+	m_shipTimerId = daemonCore->Register_Timer( m_shipInterval, m_shipInterval,
+		(TimerHandlercpp) &ReplicaLogStream::shipTimer,
+		"ReplicaLogStream::shipTimer", this );
+	dprintf( D_ALWAYS, "ReplicaLogStream::initialize shipping committed "
+	         "transactions of %s every %d seconds\n",
+	         m_stateFilePath.Value( ), m_shipInterval );
+}
+
+void
+ReplicaLogStream::finalize( )
+{
+	closeStandbys( );
+	disconnectFromLeader( );
+	if( daemonCore ) {
+		utilCancelTimer( m_shipTimerId );
+	}
+}
+
+// Find out how much of the state file is committed, starting where the last
+// scan ended.  If the state file was rotated since then, the backups have
+// a prefix of the old file, so they must be dropped.
+bool
+ReplicaLogStream::scanStateFile( FILE* fp )
+{
+	long long     committedEnd = 0;
+	unsigned long sequenceNumber = 0;
+	time_t        birthdate = 0;
+	MyString      errmsg;
+
+	bool ok = ScanClassAdLogCommitted( fp, m_committedEnd, committedEnd,
+	                                   sequenceNumber, birthdate, errmsg );
+	if( ! ok || sequenceNumber != m_sequenceNumber ||
+		birthdate != m_birthdate ) {
+		if( m_committedEnd ) {
+			dprintf( D_ALWAYS, "ReplicaLogStream::scanStateFile %s was "
+			         "rotated, closing the connections to %d backups\n",
+			         m_stateFilePath.Value( ), (int)m_standbys.size( ) );
+			closeStandbys( );
+		}
+		errmsg.clear( );
+		ok = ScanClassAdLogCommitted( fp, 0, committedEnd,
+		                              sequenceNumber, birthdate, errmsg );
+	}
+	if( ! ok ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::scanStateFile cannot read %s: "
+		         "%s", m_stateFilePath.Value( ), errmsg.Value( ) );
+		closeStandbys( );
+		m_committedEnd   = 0;
+		m_sequenceNumber = 0;
+		m_birthdate      = 0;
+		return false;
+	}
+
+	if( committedEnd != m_committedEnd ) {
+		m_committedTime = time( NULL );
+	}
+	m_committedEnd   = committedEnd;
+	m_sequenceNumber = sequenceNumber;
+	m_birthdate      = birthdate;
+	return true;
+}
+
+// The digest of the STREAM_VERIFY_SIZE bytes of a state file before end,
+// or of all of them if there are fewer.
+static bool
+tailDigest( FILE* fp, long long end, std::string& digest )
+{
+	long long         start = MAX( 0LL, end - STREAM_VERIFY_SIZE );
+	std::vector<char> buffer( end - start );
+
+	if( fseek( fp, start, SEEK_SET ) != 0 ||
+		( ! buffer.empty( ) &&
+		  fread( &buffer[0], 1, buffer.size( ), fp ) != buffer.size( ) ) ) {
+		return false;
+	}
+	unsigned char* md = Condor_MD_MAC::computeOnce(
+		(const unsigned char*)buffer.data( ), buffer.size( ) );
+	if( ! md ) {
+		return false;
+	}
+	digest.clear( );
+	for( int index = 0; index < MAC_SIZE; ++index ) {
+		formatstr_cat( digest, "%02x", md[index] );
+	}
+	free( md );
+	return true;
+}
+
+bool
+ReplicaLogStream::prepareRequest( const char* stateFilePath, Request& request,
+                                  MyString& errmsg )
+{
+	// cut the local state file back to the last committed transaction,
+	// anything after that is part of a transaction that was cut off by the
+	// transfer of the file or by the loss of the previous connection
+	FILE* fp = safe_fopen_wrapper_follow( stateFilePath, "r+" );
+	if( ! fp ) {
+		errmsg.formatstr( "cannot open it, errno = %d\n", errno );
+		return false;
+	}
+	bool ok = ScanClassAdLogCommitted( fp, 0, request.offset,
+	                                   request.sequenceNumber,
+	                                   request.birthdate, errmsg );
+	if( ok && ftruncate( fileno( fp ), request.offset ) < 0 ) {
+		errmsg.formatstr( "ftruncate failed, errno = %d\n", errno );
+		ok = false;
+	}
+	if( ok && ! tailDigest( fp, request.offset, request.tailDigest ) ) {
+		errmsg.formatstr( "cannot read it, errno = %d\n", errno );
+		ok = false;
+	}
+	fclose( fp );
+	return ok;
+}
+
+int
+ReplicaLogStream::checkRequest( FILE* fp, long long committedEnd,
+                                unsigned long sequenceNumber, time_t birthdate,
+                                const Request& request )
+{
+	if( request.sequenceNumber != sequenceNumber ||
+		request.birthdate != birthdate || request.offset > committedEnd ) {
+		return STREAM_REFUSED;
+	}
+	// the same first record does not make the backup's copy a prefix of our
+	// state file, the backup may have committed transactions of its own when
+	// it was the leader
+	std::string digest;
+	if( ! tailDigest( fp, request.offset, digest ) ||
+		digest != request.tailDigest ) {
+		return STREAM_REFUSED;
+	}
+	return STREAM_ACCEPTED;
+}
+
+bool
+ReplicaLogStream::putRequest( Stream* stream, const Request& request )
+{
+	int64_t     offset = request.offset;
+	unsigned long sequenceNumber = request.sequenceNumber;
+	int64_t     birthdate = request.birthdate;
+	std::string tailDigest = request.tailDigest;
+
+	stream->encode( );
+	return stream->code( offset ) && stream->code( sequenceNumber ) &&
+	       stream->code( birthdate ) && stream->code( tailDigest ) &&
+	       stream->end_of_message( );
+}
+
+bool
+ReplicaLogStream::getRequest( Stream* stream, Request& request )
+{
+	int64_t offset = 0;
+	int64_t birthdate = 0;
+
+	stream->decode( );
+	if( ! stream->code( offset ) || ! stream->code( request.sequenceNumber ) ||
+		! stream->code( birthdate ) || ! stream->code( request.tailDigest ) ||
+		! stream->end_of_message( ) ) {
+		return false;
+	}
+	request.offset    = offset;
+	request.birthdate = (time_t)birthdate;
+	return true;
+}
+
+bool
+ReplicaLogStream::acceptStandby( Stream* stream,
+                                 const char* daemonSinfulString,
+                                 bool isLeader )
+{
+	Request request;
+
+	if( ! getRequest( stream, request ) ) {
+		dprintf( D_NETWORK, "ReplicaLogStream::acceptStandby cannot read "
+		         "the request of %s\n", daemonSinfulString );
+		return false;
+	}
+
+	int reply = STREAM_NOT_LEADER;
+	if( isLeader && m_enabled ) {
+		reply = STREAM_REFUSED;
+		FILE* fp = safe_fopen_wrapper_follow( m_stateFilePath.Value( ), "r" );
+		if( fp ) {
+			if( scanStateFile( fp ) ) {
+				reply = checkRequest( fp, m_committedEnd, m_sequenceNumber,
+				                      m_birthdate, request );
+			}
+			fclose( fp );
+		}
+	}
+	dprintf( D_ALWAYS, "ReplicaLogStream::acceptStandby %s has %lld bytes of "
+	         "log %lu, replying %d\n", daemonSinfulString, request.offset,
+	         request.sequenceNumber, reply );
+
+	// an accepted backup is told how much there is to catch up on
+	int64_t committedEnd  = m_committedEnd;
+	int64_t committedTime = m_committedTime;
+	stream->encode( );
+	if( ! stream->code( reply ) ||
+		( reply == STREAM_ACCEPTED && ( ! stream->code( committedEnd ) ||
+		                                ! stream->code( committedTime ) ) ) ||
+		! stream->end_of_message( ) ) {
+		dprintf( D_NETWORK, "ReplicaLogStream::acceptStandby cannot reply "
+		         "to %s\n", daemonSinfulString );
+		return false;
+	}
+	if( reply != STREAM_ACCEPTED ) {
+		return false;
+	}
+
+	// the backup never sends anything more, so the socket becomes readable
+	// only when the backup closes it
+	ReliSock* socket = static_cast<ReliSock*>( stream );
+	socket->timeout( m_connectionTimeout );
+	if( daemonCore->Register_Socket( socket, daemonSinfulString,
+			(SocketHandlercpp) &ReplicaLogStream::standbyHandler,
+			"ReplicaLogStream::standbyHandler", this ) < 0 ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::acceptStandby cannot register "
+		         "the socket of %s\n", daemonSinfulString );
+		return false;
+	}
+	Standby standby;
+	standby.socket       = socket;
+	standby.sinful       = daemonSinfulString;
+	standby.offset       = request.offset;
+	standby.backlogSince = 0;
+	m_standbys.push_back( standby );
+	return true;
+}
+
+void
+ReplicaLogStream::closeStandbys( )
+{
+	while( ! m_standbys.empty( ) ) {
+		dropStandby( m_standbys.size( ) - 1 );
+	}
+}
+
+size_t
+ReplicaLogStream::findStandby( Stream* stream ) const
+{
+	size_t index = 0;
+	while( index < m_standbys.size( ) && m_standbys[index].socket != stream ) {
+		++index;
+	}
+	return index;
+}
+
+void
+ReplicaLogStream::dropStandby( size_t index )
+{
+	dprintf( D_ALWAYS, "ReplicaLogStream::dropStandby closing the connection "
+	         "to %s\n", m_standbys[index].sinful.c_str( ) );
+	if( daemonCore ) {
+		daemonCore->Cancel_Socket( m_standbys[index].socket );
+	}
+	delete m_standbys[index].socket;
+	m_standbys.erase( m_standbys.begin( ) + index );
+}
+
+int
+ReplicaLogStream::standbyHandler( Stream* stream )
+{
+	size_t index = findStandby( stream );
+	if( index < m_standbys.size( ) ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::standbyHandler %s closed "
+		         "the connection\n", m_standbys[index].sinful.c_str( ) );
+		m_standbys.erase( m_standbys.begin( ) + index );
+	}
+	// daemon core closes and deletes the socket
+	return FALSE;
+}
+
+// the socket of a backup that could not take all of the last message can
+// take more of it
+int
+ReplicaLogStream::standbyWritableHandler( Stream* stream )
+{
+	size_t index = findStandby( stream );
+	if( index == m_standbys.size( ) ) {
+		return FALSE;
+	}
+	Standby&  standby = m_standbys[index];
+	ReliSock* socket = standby.socket;
+
+	int result = socket->finish_end_of_message( );
+	if( socket->clear_backlog_flag( ) ) {
+		return KEEP_STREAM;
+	}
+	if( ! result ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::standbyWritableHandler cannot "
+		         "send to %s\n", standby.sinful.c_str( ) );
+		m_standbys.erase( m_standbys.begin( ) + index );
+		// daemon core closes and deletes the socket
+		return FALSE;
+	}
+
+	// the message is out, go back to waiting for the backup to close the
+	// connection, and send it more right away
+	daemonCore->Cancel_Socket( socket );
+	if( daemonCore->Register_Socket( socket, standby.sinful.c_str( ),
+			(SocketHandlercpp) &ReplicaLogStream::standbyHandler,
+			"ReplicaLogStream::standbyHandler", this ) < 0 ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::standbyWritableHandler cannot "
+		         "register the socket of %s\n", standby.sinful.c_str( ) );
+		// the socket is no longer daemon core's to delete
+		delete socket;
+		m_standbys.erase( m_standbys.begin( ) + index );
+		return KEEP_STREAM;
+	}
+	standby.backlogSince = 0;
+	daemonCore->Reset_Timer( m_shipTimerId, 0, m_shipInterval );
+	return KEEP_STREAM;
+}
+
+// have daemon core tell us when the socket of the backup can take the rest
+// of the last message
+bool
+ReplicaLogStream::waitUntilWritable( Standby& standby )
+{
+	daemonCore->Cancel_Socket( standby.socket );
+	if( daemonCore->Register_Socket( standby.socket, standby.sinful.c_str( ),
+			(SocketHandlercpp) &ReplicaLogStream::standbyWritableHandler,
+			"ReplicaLogStream::standbyWritableHandler", this, ALLOW,
+			HANDLE_WRITE ) < 0 ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::waitUntilWritable cannot "
+		         "register the socket of %s\n", standby.sinful.c_str( ) );
+		return false;
+	}
+	standby.backlogSince = time( NULL );
+	return true;
+}
+
+void
+ReplicaLogStream::shipTimer( )
+{
+	if( m_standbys.empty( ) ) {
+		return ;
+	}
+	FILE* fp = safe_fopen_wrapper_follow( m_stateFilePath.Value( ), "r" );
+	if( ! fp ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::shipTimer cannot open %s, "
+		         "errno = %d\n", m_stateFilePath.Value( ), errno );
+		return ;
+	}
+	bool   behind = false;
+	time_t now = time( NULL );
+	if( scanStateFile( fp ) ) {
+		for( size_t index = 0; index < m_standbys.size( ); ) {
+			Standby& standby = m_standbys[index];
+			if( standby.backlogSince &&
+				now - standby.backlogSince > m_connectionTimeout ) {
+				dprintf( D_ALWAYS, "ReplicaLogStream::shipTimer %s has not "
+				         "taken anything for %d seconds\n",
+				         standby.sinful.c_str( ), (int)( now - standby.backlogSince ) );
+				dropStandby( index );
+			} else if( shipTo( fp, standby ) ) {
+				// a backup whose socket is full is sent more once it drains
+				behind = behind || ( standby.offset < m_committedEnd &&
+				                     ! standby.backlogSince );
+				++index;
+			} else {
+				dropStandby( index );
+			}
+		}
+	}
+	fclose( fp );
+
+	// a backup that is far behind gets the rest in later calls, which come
+	// right after daemon core has handled whatever else is waiting
+	daemonCore->Reset_Timer( m_shipTimerId, behind ? 0 : m_shipInterval,
+	                         m_shipInterval );
+}
+
+bool
+ReplicaLogStream::readCommitted( FILE* fp, long long offset, long long end,
+                                 std::vector<char>& buffer )
+{
+	size_t length = (size_t)MIN( end - offset, STREAM_CHUNK_SIZE );
+	buffer.resize( length );
+	return fseek( fp, offset, SEEK_SET ) == 0 &&
+	       fread( &buffer[0], 1, length, fp ) == length;
+}
+
+// send the backup the next part of what was committed since the last time,
+// at most STREAM_SHIP_LIMIT bytes so that other work is not held up, and
+// without blocking: when the socket can't take a whole message the rest of
+// it is sent by standbyWritableHandler( )
+bool
+ReplicaLogStream::shipTo( FILE* fp, Standby& standby )
+{
+	ReliSock* socket = standby.socket;
+	long long end = MIN( m_committedEnd, standby.offset + STREAM_SHIP_LIMIT );
+
+	while( standby.offset < end && ! standby.backlogSince ) {
+		if( ! readCommitted( fp, standby.offset, end, m_buffer ) ) {
+			dprintf( D_ALWAYS, "ReplicaLogStream::shipTo cannot read %d bytes "
+			         "at offset %lld of %s\n", (int)m_buffer.size( ),
+			         standby.offset, m_stateFilePath.Value( ) );
+			return false;
+		}
+
+		int     length        = (int)m_buffer.size( );
+		int64_t offset        = standby.offset;
+		int64_t committedEnd  = m_committedEnd;
+		int64_t committedTime = m_committedTime;
+		BlockingModeGuard guard( socket, true );
+		socket->encode( );
+		if( ! socket->code( offset ) || ! socket->code( committedEnd ) ||
+			! socket->code( committedTime ) || ! socket->code( length ) ||
+			socket->put_bytes( &m_buffer[0], length ) != length ||
+			! socket->end_of_message_nonblocking( ) ) {
+			dprintf( D_ALWAYS, "ReplicaLogStream::shipTo cannot send %d bytes "
+			         "to %s\n", length, standby.sinful.c_str( ) );
+			return false;
+		}
+		standby.offset += length;
+		m_bytesSent    += length;
+		if( socket->clear_backlog_flag( ) && ! waitUntilWritable( standby ) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool
+ReplicaLogStream::connectToLeader( const char* leaderSinfulString )
+{
+	disconnectFromLeader( );
+
+	Request  request;
+	MyString errmsg;
+
+	if( ! prepareRequest( m_stateFilePath.Value( ), request, errmsg ) ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::connectToLeader cannot use %s: "
+		         "%s", m_stateFilePath.Value( ), errmsg.Value( ) );
+		m_needsFullTransfer = true;
+		return false;
+	}
+
+	Daemon    daemon( DT_ANY, leaderSinfulString );
+	ReliSock* socket = new ReliSock;
+
+	socket->timeout( m_connectionTimeout );
+	socket->doNotEnforceMinimalCONNECT_TIMEOUT( );
+	if( ! socket->connect( leaderSinfulString, 0, false ) ||
+		! daemon.startCommand( REPLICATION_STREAM_LOG, socket,
+		                       m_connectionTimeout ) ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::connectToLeader cannot start "
+		         "command %s to %s\n", getCommandStringSafe(
+		         REPLICATION_STREAM_LOG ), leaderSinfulString );
+		delete socket;
+		return false;
+	}
+
+	char const* sinfulString = daemonCore->InfoCommandSinfulString( );
+	int         reply = STREAM_REFUSED;
+	int64_t     leaderEnd = 0, leaderTime = 0;
+
+	socket->encode( );
+	if( ! socket->put( sinfulString ) || ! putRequest( socket, request ) ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::connectToLeader cannot send "
+		         "the request to %s\n", leaderSinfulString );
+		delete socket;
+		return false;
+	}
+	socket->decode( );
+	if( ! socket->code( reply ) ||
+		( reply == STREAM_ACCEPTED && ( ! socket->code( leaderEnd ) ||
+		                                ! socket->code( leaderTime ) ) ) ||
+		! socket->end_of_message( ) ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::connectToLeader cannot read "
+		         "the reply of %s\n", leaderSinfulString );
+		delete socket;
+		return false;
+	}
+	if( reply != STREAM_ACCEPTED ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::connectToLeader %s %s\n",
+		         leaderSinfulString, reply == STREAM_REFUSED ?
+		         "has a different state file, it must be downloaded" :
+		         "is not the leader" );
+		if( reply == STREAM_REFUSED ) {
+			m_needsFullTransfer = true;
+		}
+		delete socket;
+		return false;
+	}
+
+	if( daemonCore->Register_Socket( socket, leaderSinfulString,
+			(SocketHandlercpp) &ReplicaLogStream::leaderHandler,
+			"ReplicaLogStream::leaderHandler", this ) < 0 ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::connectToLeader cannot register "
+		         "the socket to %s\n", leaderSinfulString );
+		delete socket;
+		return false;
+	}
+	dprintf( D_ALWAYS, "ReplicaLogStream::connectToLeader receiving "
+	         "transactions from %s after byte %lld of %s\n",
+	         leaderSinfulString, request.offset, m_stateFilePath.Value( ) );
+	m_leaderSocket = socket;
+	m_leaderSinful = leaderSinfulString;
+	m_localEnd     = request.offset;
+	m_lagBytes     = leaderEnd - m_localEnd;
+	m_lagSeconds   = m_lagBytes ? MAX( 0, (int)( time( NULL ) - leaderTime ) ) : 0;
+	return true;
+}
+
+void
+ReplicaLogStream::disconnectFromLeader( )
+{
+	if( m_leaderSocket ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::disconnectFromLeader closing "
+		         "the connection to %s\n", m_leaderSinful.c_str( ) );
+		if( daemonCore ) {
+			daemonCore->Cancel_Socket( m_leaderSocket );
+		}
+		delete m_leaderSocket;
+		m_leaderSocket = NULL;
+	}
+}
+
+int
+ReplicaLogStream::leaderHandler( Stream* stream )
+{
+	int64_t offset = 0, committedEnd = 0, committedTime = 0;
+	int     length = 0;
+
+	stream->decode( );
+	if( ! stream->code( offset ) || ! stream->code( committedEnd ) ||
+		! stream->code( committedTime ) || ! stream->code( length ) ||
+		length < 0 || length > STREAM_CHUNK_SIZE ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::leaderHandler the connection "
+		         "to %s was closed\n", m_leaderSinful.c_str( ) );
+		m_leaderSocket = NULL;
+		return FALSE;
+	}
+	m_buffer.resize( length );
+	if( ( length && stream->get_bytes( &m_buffer[0], length ) != length ) ||
+		! stream->end_of_message( ) ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::leaderHandler cannot read %d "
+		         "bytes from %s\n", length, m_leaderSinful.c_str( ) );
+		m_leaderSocket = NULL;
+		return FALSE;
+	}
+
+	if( ! appendToStateFile( m_stateFilePath.Value( ), m_localEnd, offset,
+	                         m_buffer.data( ), length ) ) {
+		// the leader is not sending what follows our copy, or we can't keep
+		// it, either way the copy is no good any more
+		m_needsFullTransfer = true;
+		m_leaderSocket = NULL;
+		return FALSE;
+	}
+	m_localEnd      += length;
+	m_bytesReceived += length;
+	m_lagBytes       = committedEnd - m_localEnd;
+	m_lagSeconds     = MAX( 0, (int)( time( NULL ) - committedTime ) );
+	dprintf( D_FULLDEBUG, "ReplicaLogStream::leaderHandler appended %d bytes "
+	         "to %s, %lld bytes behind\n", length, m_stateFilePath.Value( ),
+	         m_lagBytes );
+	return KEEP_STREAM;
+}
+
+bool
+ReplicaLogStream::appendToStateFile( const char* stateFilePath,
+                                     long long localEnd, long long offset,
+                                     const char* data, int length )
+{
+	if( offset != localEnd ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::appendToStateFile got bytes "
+		         "from offset %lld, but %s ends at %lld\n", offset,
+		         stateFilePath, localEnd );
+		return false;
+	}
+	int fd = safe_open_wrapper_follow( stateFilePath, O_WRONLY | O_LARGEFILE,
+	                                   0600 );
+	if( fd < 0 ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::appendToStateFile cannot open "
+		         "%s, errno = %d\n", stateFilePath, errno );
+		return false;
+	}
+	bool ok = lseek( fd, offset, SEEK_SET ) == (off_t)offset &&
+	          full_write( fd, data, length ) == length &&
+	          condor_fsync( fd, stateFilePath ) == 0;
+	if( ! ok ) {
+		dprintf( D_ALWAYS, "ReplicaLogStream::appendToStateFile cannot write "
+		         "%d bytes at offset %lld of %s, errno = %d\n", length, offset,
+		         stateFilePath, errno );
+	}
+	close( fd );
+	return ok;
+}
+
+void
+ReplicaLogStream::publish( ClassAd* ad ) const
+{
+	if( ! m_enabled || ! ad ) {
+		return ;
+	}
+	long long lagBytes = m_lagBytes;
+	int       lagSeconds = m_lagSeconds;
+	if( ! m_standbys.empty( ) ) {
+		// on the leader, how far behind the slowest backup is
+		lagBytes = 0;
+		for( size_t index = 0; index < m_standbys.size( ); ++index ) {
+			lagBytes = MAX( lagBytes,
+			                m_committedEnd - m_standbys[index].offset );
+		}
+		lagSeconds = lagBytes ? (int)( time( NULL ) - m_committedTime ) : 0;
+	}
+	ad->Assign( ATTR_REPLICATION_STREAM_STANDBYS, (int)m_standbys.size( ) );
+	ad->Assign( ATTR_REPLICATION_STREAM_CONNECTED, m_leaderSocket != NULL );
+	ad->Assign( ATTR_REPLICATION_STREAM_BYTES_SENT, m_bytesSent );
+	ad->Assign( ATTR_REPLICATION_STREAM_BYTES_RECEIVED, m_bytesReceived );
+	ad->Assign( ATTR_REPLICATION_STREAM_LAG_BYTES, lagBytes );
+	ad->Assign( ATTR_REPLICATION_STREAM_LAG_SECONDS, lagSeconds );
+}
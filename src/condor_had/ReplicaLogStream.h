@@ -0,0 +1,248 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef REPLICA_LOG_STREAM_H
+#define REPLICA_LOG_STREAM_H
+
+#include "condor_daemon_core.h"
+#include "reli_sock.h"
+#include "MyString.h"
+#include <string>
+#include <vector>
+
+/* Class      : ReplicaLogStream
+ * Description: when REPLICATION_STREAM_LOG is true, ships the committed
+ *              transactions of the state file, which must be a ClassAd log
+ *              such as the accountant log, from the replication leader to the
+ *              backup replication daemons over a connection that each backup
+ *              keeps open to the leader.  The backups append what they
+ *              receive to their own copy of the state file, so the whole file
+ *              only has to be transferred by 'condor_transferer' when a backup
+ *              joins the pool, or after the leader's state file was rotated.
+ *
+ *              A backup first cuts its copy of the state file back to the last
+ *              committed transaction, then sends the REPLICATION_STREAM_LOG
+ *              command with the size of the copy, the historical sequence
+ *              number and birthdate from its first record, and a digest of
+ *              the last STREAM_VERIFY_SIZE bytes of the copy.  The leader
+ *              accepts the backup when its own state file has the same
+ *              sequence number and birthdate, is at least as long, and has
+ *              the same bytes before that size, so that the copy is a prefix
+ *              of it.  A former leader that committed transactions the new
+ *              leader never received has a copy that is not, and is refused.
+ *              From then on the leader sends the backup whatever has been
+ *              committed past that every REPLICATION_STREAM_INTERVAL seconds,
+ *              without blocking on a backup that is slow to take it.  When
+ *              the leader's state file is rotated it closes all of the
+ *              connections, and the backups are refused until they have
+ *              downloaded the new file.
+ */
+class ReplicaLogStream: public Service
+{
+public:
+	// replies of the leader to REPLICATION_STREAM_LOG
+	enum { STREAM_NOT_LEADER = -1, STREAM_REFUSED = 0, STREAM_ACCEPTED = 1 };
+
+	// what a backup sends with REPLICATION_STREAM_LOG
+	struct Request {
+		Request( ): offset( 0 ), sequenceNumber( 0 ), birthdate( 0 ) { };
+		long long     offset;         // the size of its copy of the state file
+		unsigned long sequenceNumber; // from the first record of the copy
+		time_t        birthdate;      // from the first record of the copy
+		std::string   tailDigest;     // of the bytes just before offset
+	};
+
+	/* Function: ReplicaLogStream constructor
+	 */
+	ReplicaLogStream();
+	/* Function: ReplicaLogStream destructor
+	 */
+	~ReplicaLogStream();
+	/* Function   : initialize
+	 * Arguments  : stateFilePath     - OS path to the state file
+	 *              connectionTimeout - socket timeout
+	 * Description: closes all of the connections and rereads the configuration
+	 */
+	void initialize( const MyString& stateFilePath, int connectionTimeout );
+	/* Function   : finalize
+	 * Description: closes all of the connections and cancels the timer
+	 */
+	void finalize();
+	/* Function    : isEnabled
+	 * Return value: bool - whether REPLICATION_STREAM_LOG is true
+	 */
+	bool isEnabled() const { return m_enabled; };
+// Leader side
+	/* Function    : acceptStandby
+	 * Arguments   : stream             - the socket of the REPLICATION_STREAM_LOG
+	 *                                    command
+	 *               daemonSinfulString - the address of the backup
+	 *               isLeader           - whether this daemon is the leader
+	 * Return value: bool - whether the backup was accepted, in which case this
+	 *               object owns the stream from now on
+	 * Description : reads the backup's request and replies to it
+	 */
+	bool acceptStandby( Stream* stream, const char* daemonSinfulString,
+	                    bool isLeader );
+	/* Function   : closeStandbys
+	 * Description: closes the connections to all of the backups
+	 */
+	void closeStandbys();
+// End of leader side
+// Backup side
+	/* Function    : connectToLeader
+	 * Arguments   : leaderSinfulString - the address of the leader
+	 * Return value: bool - whether the leader accepted this backup
+	 * Description : cuts the local state file back to the last committed
+	 *               transaction and asks the leader to send what follows it;
+	 *               if the leader refuses, the state file must be downloaded
+	 *               in full before trying again
+	 */
+	bool connectToLeader( const char* leaderSinfulString );
+	/* Function   : disconnectFromLeader
+	 * Description: closes the connection to the leader
+	 */
+	void disconnectFromLeader();
+	/* Function    : isConnectedTo
+	 * Arguments   : leaderSinfulString - the address of the leader
+	 * Return value: bool - whether the transactions of the given leader are
+	 *               being received
+	 */
+	bool isConnectedTo( const char* leaderSinfulString ) const {
+		return m_leaderSocket && m_leaderSinful == leaderSinfulString;
+	};
+	/* Function    : isCaughtUp
+	 * Return value: bool - whether the local state file has everything the
+	 *               leader had committed when it last sent some of it
+	 */
+	bool isCaughtUp() const { return m_leaderSocket && m_lagBytes == 0; };
+	/* Function    : needsFullTransfer
+	 * Return value: bool - whether the leader refused this backup, so that the
+	 *               state file has to be downloaded by 'condor_transferer'
+	 */
+	bool needsFullTransfer() const { return m_needsFullTransfer; };
+	/* Function   : fullTransferDone
+	 * Description: notes that the state file was downloaded in full
+	 */
+	void fullTransferDone() { m_needsFullTransfer = false; };
+// End of backup side
+// The protocol, apart from the connections
+	/* Function    : prepareRequest
+	 * Arguments   : stateFilePath - OS path to the backup's state file
+	 *               request       - set to what the backup sends the leader
+	 *               errmsg        - why the state file can't be used
+	 * Return value: bool - success/failure value
+	 * Description : cuts the state file back to the last committed
+	 *               transaction, and describes what is left of it
+	 */
+	static bool prepareRequest( const char* stateFilePath, Request& request,
+	                            MyString& errmsg );
+	/* Function    : checkRequest
+	 * Arguments   : fp           - the leader's state file
+	 *               committedEnd - how much of it is committed
+	 *               sequenceNumber, birthdate - from its first record
+	 *               request      - what the backup sent
+	 * Return value: int - STREAM_ACCEPTED when the backup's copy of the state
+	 *               file is a prefix of the committed part of the leader's,
+	 *               STREAM_REFUSED otherwise
+	 */
+	static int checkRequest( FILE* fp, long long committedEnd,
+	                         unsigned long sequenceNumber, time_t birthdate,
+	                         const Request& request );
+	/* Function    : putRequest, getRequest
+	 * Arguments   : stream  - the socket of the REPLICATION_STREAM_LOG command
+	 *               request - the request to send, or that was received
+	 * Return value: bool - success/failure value
+	 */
+	static bool putRequest( Stream* stream, const Request& request );
+	static bool getRequest( Stream* stream, Request& request );
+	/* Function    : readCommitted
+	 * Arguments   : fp     - the leader's state file
+	 *               offset - where the backup's copy ends
+	 *               end    - how much of the leader's state file to send
+	 *               buffer - set to the bytes from offset, at most
+	 *                        STREAM_CHUNK_SIZE of them
+	 * Return value: bool - success/failure value
+	 */
+	static bool readCommitted( FILE* fp, long long offset, long long end,
+	                           std::vector<char>& buffer );
+	/* Function    : appendToStateFile
+	 * Arguments   : stateFilePath - OS path to the backup's state file
+	 *               localEnd      - where the backup's copy ends
+	 *               offset        - where the leader says the data goes
+	 *               data, length  - what the leader sent
+	 * Return value: bool - false when the data does not follow the copy or
+	 *               can't be written
+	 */
+	static bool appendToStateFile( const char* stateFilePath,
+	                               long long localEnd, long long offset,
+	                               const char* data, int length );
+// End of the protocol
+	/* Function   : publish
+	 * Arguments  : ad - the replication daemon ClassAd
+	 * Description: publishes the number of bytes shipped and how far behind
+	 *              the backups are
+	 */
+	void publish( ClassAd* ad ) const;
+
+private:
+	struct Standby {
+		ReliSock*   socket;
+		std::string sinful;
+		long long   offset;       // how much of the state file the backup has
+		time_t      backlogSince; // when a message to the backup could not
+		                          // all be sent without blocking, or 0
+	};
+
+	void shipTimer();
+	bool scanStateFile( FILE* fp );
+	bool shipTo( FILE* fp, Standby& standby );
+	bool waitUntilWritable( Standby& standby );
+	size_t findStandby( Stream* stream ) const;
+	void dropStandby( size_t index );
+	int  standbyHandler( Stream* stream );
+	int  standbyWritableHandler( Stream* stream );
+	int  leaderHandler( Stream* stream );
+
+	bool                 m_enabled;
+	MyString             m_stateFilePath;
+	int                  m_connectionTimeout;
+	int                  m_shipTimerId;
+	int                  m_shipInterval;
+	std::vector<char>    m_buffer;
+
+	// leader side: the backups, and what we know about the state file
+	std::vector<Standby> m_standbys;
+	long long            m_committedEnd;
+	time_t               m_committedTime; // when m_committedEnd last advanced
+	unsigned long        m_sequenceNumber;
+	time_t               m_birthdate;
+	long long            m_bytesSent;
+
+	// backup side: the connection to the leader
+	ReliSock*            m_leaderSocket;
+	std::string          m_leaderSinful;
+	long long            m_localEnd;
+	bool                 m_needsFullTransfer;
+	long long            m_bytesReceived;
+	long long            m_lagBytes;
+	int                  m_lagSeconds;
+};
+
+#endif // REPLICA_LOG_STREAM_H
@@ -91,6 +91,7 @@ ReplicatorStateMachine::finalizeDelta( )
     utilCancelTimer(m_versionRequestingTimerId);
     utilCancelTimer(m_versionDownloadingTimerId);
     utilCancelTimer(m_updateCollectorTimerId);
+    m_logStream.finalize( );
     m_replicationInterval               = -1;
     m_hadAliveTolerance                 = -1;
     m_maxTransfererLifeTime             = -1;
@@ -128,6 +129,7 @@ ReplicatorStateMachine::initialize( )
     registerCommand(REPLICATION_GIVING_UP_VERSION);
     registerCommand(REPLICATION_SOLICIT_VERSION);
     registerCommand(REPLICATION_SOLICIT_VERSION_REPLY);
+    registerCommand(REPLICATION_STREAM_LOG);
 }
 // clears all the inner structures and loads the configuration parameters'
 // values again
@@ -139,6 +141,7 @@ ReplicatorStateMachine::reinitialize()
     AbstractReplicatorStateMachine::reinitialize( );
 
     m_myVersion.initialize( m_stateFilePath, m_versionFilePath );
+    m_logStream.initialize( m_stateFilePath, m_connectionTimeout );
 
     m_replicationInterval =
 		param_integer("REPLICATION_INTERVAL",
@@ -313,6 +316,7 @@ ReplicatorStateMachine::afterLeaderStateHandler( )
     dprintf( D_ALWAYS, 
 			"ReplicatorStateMachine::afterLeaderStateHandler started\n" );
     broadcastVersion( REPLICATION_GIVING_UP_VERSION );
+    m_logStream.closeStandbys( );
     m_state = BACKUP;
 }
 
@@ -490,6 +494,8 @@ ReplicatorStateMachine::becomeLeader( )
     dprintf( D_FULLDEBUG, "ReplicatorStateMachine::becomeLeader "
             "last HAD alive time is set to %s", ctime( &m_lastHadAliveTime ) );       // selects new gid for the pool
     gidSelectionHandler( );
+    // the state file of this daemon is the one that counts from now on
+    m_logStream.disconnectFromLeader( );
     m_state = REPLICATION_LEADER;
 }
 /* Function   : onLeaderVersion
@@ -513,6 +519,36 @@ ReplicatorStateMachine::onLeaderVersion( Stream* stream )
     Version* newVersion = decodeVersionAndState( stream );
 	// comparing the received version to the local one
     bool downloadNeeded = replicaSelectionHandler( *newVersion );
+	// with REPLICATION_STREAM_LOG, the leader's transactions are appended to
+	// the local state file as they are committed, so that the file need not
+	// be downloaded.  That only holds for a leader with the same gid, the
+	// same history as ours, otherwise the choice above stands and the file is
+	// downloaded in full; as it is when the leader refuses to stream to us,
+	// because our copy is not a prefix of its state file.  The leader's
+	// version is taken over once everything it had committed has arrived.
+    if( m_logStream.isEnabled( ) && newVersion ) {
+        MyString    leaderSinful = newVersion->getSinfulString( );
+        const char* leaderSinfulString = leaderSinful.Value( );
+
+        if( ! newVersion->isComparable( m_myVersion ) ) {
+            m_logStream.disconnectFromLeader( );
+        } else {
+            if( ! m_logStream.isConnectedTo( leaderSinfulString ) &&
+                ! m_logStream.needsFullTransfer( ) &&
+                downloadTransferersNumber( ) == 0 ) {
+                m_logStream.connectToLeader( leaderSinfulString );
+            }
+            if( m_logStream.isConnectedTo( leaderSinfulString ) ) {
+                if( downloadNeeded && m_logStream.isCaughtUp( ) ) {
+                    m_myVersion.adopt( *newVersion );
+                }
+                // either taken over, or the rest is still on its way
+                downloadNeeded = false;
+            } else if( m_logStream.needsFullTransfer( ) ) {
+                downloadNeeded = true;
+            }
+        }
+    }
     // downloading the replica from the remote replication daemon, when the
 	// received version is better and there is no running downloading
 	// 'condor_transferers'  
@@ -520,6 +556,8 @@ ReplicatorStateMachine::onLeaderVersion( Stream* stream )
         dprintf( D_FULLDEBUG, "ReplicatorStateMachine::onLeaderVersion "
 				"downloading from %s\n", 
 				newVersion->getSinfulString( ).Value( ) );
+		// the downloaded file replaces the local one
+		m_logStream.disconnectFromLeader( );
 		if ( newVersion->knowsNewTransferProtocol() ) {
 			downloadNew( newVersion->getSinfulString( ).Value( ) );
 		} else {
@@ -555,6 +593,27 @@ ReplicatorStateMachine::onTransferFileNew( Stream *stream )
 	}
 }
 
+/* Function    : onStreamLog
+ * Arguments   : daemonSinfulString - the address of remote replication daemon,
+ *				 which sent the REPLICATION_STREAM_LOG command
+ *				 stream - socket, through which the data is received and sent
+ * Return value: int - KEEP_STREAM when the socket is kept open to send the
+ *				 committed transactions of the state file through it
+ * Description : handler of REPLICATION_STREAM_LOG command; accepting the
+ *				 backup replication daemon when this one is the leader
+ */
+int
+ReplicatorStateMachine::onStreamLog( char* daemonSinfulString, Stream* stream )
+{
+	dprintf( D_ALWAYS, "ReplicatorStateMachine::onStreamLog %s started\n",
+			 daemonSinfulString );
+	if( m_logStream.acceptStandby( stream, daemonSinfulString,
+								   m_state == REPLICATION_LEADER ) ) {
+		return KEEP_STREAM;
+	}
+	return FALSE;
+}
+
 /* Function   : onSolicitVersion
  * Arguments  : daemonSinfulString - the address of remote replication daemon,
  *              which sent the REPLICATION_SOLICIT_VERSION command 
@@ -632,6 +691,9 @@ ReplicatorStateMachine::downloadReplicaTransfererReaper(
     int returnValue = AbstractReplicatorStateMachine::
 						downloadReplicaTransfererReaper(pid, 
 														exitStatus);
+    if( returnValue == TRANSFERER_TRUE ) {
+        m_logStream.fullTransferDone( );
+    }
     if( returnValue == TRANSFERER_TRUE && 
 		replicatorStateMachine->m_state == VERSION_DOWNLOADING ) {
         replicatorStateMachine->versionDownloadingTimer( );
@@ -665,6 +727,13 @@ ReplicatorStateMachine::commandHandler( int command, Stream* stream )
     dprintf( /*D_COMMAND*/
              D_FULLDEBUG, "ReplicatorStateMachine::commandHandler received "
 			"command %s from %s\n", getCommandStringSafe(command), daemonSinfulString );
+	// the stream command reads and replies itself, and may keep the socket
+    if( command == REPLICATION_STREAM_LOG ) {
+        int result = onStreamLog( daemonSinfulString, stream );
+        free( daemonSinfulString );
+
+        return result;
+    }
     switch( command ) {
         case REPLICATION_LEADER_VERSION:
             onLeaderVersion( stream );
@@ -880,6 +949,7 @@ ReplicatorStateMachine::replicationTimer( )
 	// messages for about 'HAD_ALIVE_TOLERANCE' seconds only
     if( currentTime - m_lastHadAliveTime > m_hadAliveTolerance) {
         broadcastVersion( REPLICATION_GIVING_UP_VERSION );
+        m_logStream.closeStandbys( );
         m_state = BACKUP;
     }
 }
@@ -945,6 +1015,7 @@ void
 ReplicatorStateMachine::updateCollectors()
 {
     if (m_classAd) {
+       m_logStream.publish(m_classAd);
        daemonCore->sendUpdates (UPDATE_AD_GENERIC, m_classAd);
     }
 }
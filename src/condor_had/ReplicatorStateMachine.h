@@ -21,6 +21,7 @@
 #define REPLICATOR_STATE_MACHINE_H
 
 #include "AbstractReplicatorStateMachine.h"
+#include "ReplicaLogStream.h"
 
 /* Class      : ReplicatorStateMachine
  * Description: concrete class for replication service state machine,
@@ -144,6 +145,7 @@ private:
     void onSolicitVersionReply(Stream* stream);
     void onNewlyJoinedVersion(Stream* stream);
     void onGivingUpVersion(Stream* stream);
+    int  onStreamLog(char* daemonSinfulString, Stream* stream);
 // End of command handlers
 
     static Version* decodeVersionAndState( Stream* stream );
@@ -169,6 +171,8 @@ private:
 // End of timers
 	// last time HAD sent HAD_IN_LEADER_STATE
     time_t  m_lastHadAliveTime;
+	// ships the committed transactions of the state file to the backups
+	ReplicaLogStream m_logStream;
 
 // Debugging utilities
 	void printDataMembers() const
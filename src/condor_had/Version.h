@@ -151,6 +151,17 @@ public:
      * Description: sets the gid of the version
      */
 	void setGid(int newGid) { m_gid = newGid; save( ); };
+	/* Function   : adopt
+	 * Arguments  : version - the leader's version
+	 * Description: takes over the gid and logical clock of the leader's
+	 *              version, when the state file is kept up to date with the
+	 *              leader's by REPLICATION_STREAM_LOG rather than downloaded
+	 */
+	void adopt(const Version& version) {
+		m_gid = version.m_gid;
+		m_logicalClock = version.m_logicalClock;
+		save( );
+	};
 // End of mutators
 // Convertors
 	/* Function    : toString
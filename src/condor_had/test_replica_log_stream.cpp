@@ -0,0 +1,225 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for the protocol of ReplicaLogStream, apart from the connections:
+// a backup whose copy of the state file is a prefix of the leader's is
+// accepted and caught up chunk by chunk, and one that has diverged from the
+// leader, belongs to another log or is ahead of it is refused.  The request
+// is also sent over a socketpair to check that it arrives intact.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "reli_sock.h"
+#include "classad_log.h"
+#include "ReplicaLogStream.h"
+#include "test_check.h"
+
+#include <string>
+#include <vector>
+
+// Utils.cpp calls this on a crucial error
+void main_shutdown_graceful() { exit( 1 ); }
+
+static const char *leader_file = "test_replica_log_stream.leader";
+static const char *backup_file = "test_replica_log_stream.backup";
+
+static const char *log_head =
+	"107 3 CreationTimestamp 1234\n"
+	"105 \n"
+	"101 1.0 Job Machine\n"
+	"103 1.0 Owner \"alice\"\n"
+	"106 \n";
+
+// a committed transaction that sets an attribute to a value
+static std::string
+transaction( int number, const std::string &value )
+{
+	std::string text;
+	formatstr( text, "105 \n103 1.0 Attr%d \"%s\"\n106 \n", number, value.c_str() );
+	return text;
+}
+
+// Runs the leader's side of the request against its state file, returns
+// STREAM_ACCEPTED or STREAM_REFUSED, or -2 if the file can't be read.
+static int
+leader_check( const ReplicaLogStream::Request &request, long long &committed_end )
+{
+	unsigned long seq = 0;
+	time_t birthdate = 0;
+	MyString errmsg;
+	int reply = -2;
+
+	FILE *fp = safe_fopen_wrapper_follow( leader_file, "r" );
+	if ( fp ) {
+		if ( ScanClassAdLogCommitted( fp, 0, committed_end, seq, birthdate, errmsg ) ) {
+			reply = ReplicaLogStream::checkRequest( fp, committed_end, seq, birthdate, request );
+		}
+		fclose( fp );
+	}
+	return reply;
+}
+
+// Prepares the backup's request and has the leader check it.
+static int
+attach( ReplicaLogStream::Request &request, long long &committed_end )
+{
+	MyString errmsg;
+	if ( ! ReplicaLogStream::prepareRequest( backup_file, request, errmsg ) ) {
+		errmsg.chomp();
+		check_failed( "prepareRequest: %s", errmsg.Value() );
+		return -2;
+	}
+	return leader_check( request, committed_end );
+}
+
+// Ships what the leader has committed past the backup's copy, a chunk at a
+// time, the way the leader's timer does.
+static bool
+catch_up( long long offset, long long committed_end )
+{
+	std::vector<char> buffer;
+	FILE *fp = safe_fopen_wrapper_follow( leader_file, "r" );
+	if ( ! fp ) {
+		return false;
+	}
+	bool ok = true;
+	while ( ok && offset < committed_end ) {
+		ok = ReplicaLogStream::readCommitted( fp, offset, committed_end, buffer ) &&
+			ReplicaLogStream::appendToStateFile( backup_file, offset, offset,
+			                                     &buffer[0], (int)buffer.size() );
+		offset += buffer.size();
+	}
+	fclose( fp );
+	return ok;
+}
+
+static void
+test_attach_and_append()
+{
+	std::string leader = log_head;
+	for ( int i = 0; i < 100; ++i ) {
+		leader += transaction( i, std::string( 40000, 'a' + i % 26 ) );
+	}
+	std::string partial = transaction( 1000, "cut off" );
+	partial.resize( partial.size() / 2 );
+
+	// the backup has the first half of the log and part of a transaction
+	write_test_file( leader_file, leader );
+	write_test_file( backup_file, leader.substr( 0, leader.size() / 2 ) + partial );
+
+	ReplicaLogStream::Request request;
+	long long committed_end = 0;
+	int reply = attach( request, committed_end );
+	check( "a backup with a prefix of the log is accepted",
+	       reply == ReplicaLogStream::STREAM_ACCEPTED );
+	check( "the backup's copy is cut back to a committed transaction",
+	       request.offset <= (long long)leader.size() / 2 &&
+	       read_test_file( backup_file ) == leader.substr( 0, request.offset ) );
+	check( "the backup catches up in several chunks",
+	       committed_end - request.offset > 1024 * 1024 &&
+	       catch_up( request.offset, committed_end ) &&
+	       read_test_file( backup_file ) == leader );
+
+	// nothing left to send
+	reply = attach( request, committed_end );
+	check( "a backup that has all of the log is accepted",
+	       reply == ReplicaLogStream::STREAM_ACCEPTED &&
+	       request.offset == committed_end );
+
+	const char *data = "105 \n";
+	check( "data at the wrong offset is not appended",
+	       ! ReplicaLogStream::appendToStateFile( backup_file, request.offset,
+	                                              request.offset + 1, data, 5 ) &&
+	       read_test_file( backup_file ) == leader );
+}
+
+static void
+test_refused()
+{
+	std::string head = std::string( log_head ) + transaction( 1, "shared" );
+	ReplicaLogStream::Request request;
+	long long committed_end = 0;
+
+	// a former leader that committed a transaction the new leader never
+	// received, which committed one of its own that is at least as long
+	write_test_file( leader_file, head + transaction( 2, "the new leader's" ) );
+	write_test_file( backup_file, head + transaction( 2, "the old leader's" ) );
+	check( "a backup that diverged from the leader is refused",
+	       attach( request, committed_end ) == ReplicaLogStream::STREAM_REFUSED );
+
+	write_test_file( leader_file, head + transaction( 2, "the new leader's, and more" ) );
+	check( "a backup that diverged from a longer log is refused",
+	       attach( request, committed_end ) == ReplicaLogStream::STREAM_REFUSED );
+
+	// the same length and first record, different contents
+	std::string other = head;
+	other[other.size() - 10] = 'X';
+	write_test_file( leader_file, head );
+	write_test_file( backup_file, other );
+	check( "a backup with the same size and different contents is refused",
+	       attach( request, committed_end ) == ReplicaLogStream::STREAM_REFUSED );
+
+	write_test_file( backup_file, head + transaction( 2, "more" ) );
+	check( "a backup that is ahead of the leader is refused",
+	       attach( request, committed_end ) == ReplicaLogStream::STREAM_REFUSED );
+
+	std::string rotated = head;
+	rotated.replace( rotated.find( "1234" ), 4, "5678" );
+	write_test_file( backup_file, rotated );
+	check( "a backup with a copy of another log is refused",
+	       attach( request, committed_end ) == ReplicaLogStream::STREAM_REFUSED );
+}
+
+static void
+test_request_on_the_wire()
+{
+	int pair[2];
+	if ( socketpair( AF_UNIX, SOCK_STREAM, 0, pair ) != 0 ) {
+		check_failed( "socketpair failed: %s", strerror( errno ) );
+		return;
+	}
+	ReliSock sender, receiver;
+	sender.assignDomainSocket( pair[0] );
+	receiver.assignDomainSocket( pair[1] );
+
+	ReplicaLogStream::Request sent, received;
+	sent.offset = 5LL * 1024 * 1024 * 1024;
+	sent.sequenceNumber = 7;
+	sent.birthdate = 1234567890;
+	sent.tailDigest = "0123456789abcdef0123456789abcdef";
+	check( "the request is sent and received intact",
+	       ReplicaLogStream::putRequest( &sender, sent ) &&
+	       ReplicaLogStream::getRequest( &receiver, received ) &&
+	       received.offset == sent.offset &&
+	       received.sequenceNumber == sent.sequenceNumber &&
+	       received.birthdate == sent.birthdate &&
+	       received.tailDigest == sent.tailDigest );
+}
+
+int
+main( int /*argc*/, char ** /*argv*/ )
+{
+	test_attach_and_append();
+	test_refused();
+	test_request_on_the_wire();
+
+	unlink( leader_file );
+	unlink( backup_file );
+	return check_results();
+}
@@ -29,6 +29,8 @@
 #include "string_list.h"
 #include "simplelist.h"
 #include "condor_sockaddr.h"
+#include <unordered_map>
+#include <set>
 
 class SecMan;
 class KeyCacheEntry {
@@ -71,6 +73,10 @@ class KeyCacheEntry {
 	time_t               _lease_expiration; // time of lease expiration
 	bool                 _lingering; // true if session only exists
 	                                 // to catch lingering communication
+	time_t               _queued_expiration; // time this entry is queued
+	                                         // to expire at in its KeyCache
+
+	friend class KeyCache;
 };
 
 
@@ -90,23 +96,53 @@ public:
 	void expire(KeyCacheEntry*);
 	int  count();
 
+		// Must be called after changing the expiration of an entry
+		// with KeyCacheEntry::setExpiration(), so getExpiredKeys() finds it.
+	void expirationChanged(KeyCacheEntry *);
+
 	StringList * getExpiredKeys();
 	StringList * getKeysForPeerAddress(char const *addr);
 	StringList * getKeysForProcess(char const *parent_unique_id,int pid);
 
+		// counters since the cache was created.  only lookup() counts
+		// hits and misses, and a session counts as expired when it is
+		// removed after its expiration time.
+	long long lookupHits() const { return m_lookup_hits; }
+	long long lookupMisses() const { return m_lookup_misses; }
+	long long expiredCount() const { return m_expired; }
+
 private:
 	void copy_storage(const KeyCache &kc);
 	void delete_storage();
 
-	typedef HashTable<MyString, SimpleList<KeyCacheEntry *>* > KeyCacheIndex;
+	typedef std::unordered_map<std::string, KeyCacheEntry*> KeyCacheTable;
+	typedef std::unordered_map<std::string, std::set<KeyCacheEntry *> > KeyCacheIndex;
 
-	HashTable<MyString, KeyCacheEntry*> *key_table;
-	KeyCacheIndex *m_index;
+	KeyCacheTable key_table;
+	KeyCacheIndex m_index;
+
+		// Each entry that can expire, by the time it was queued to expire
+		// at, soonest first.  Renewing a lease doesn't requeue the entry,
+		// instead getExpiredKeys() checks each one that comes due and
+		// requeues it if it has not really expired yet.  So getExpiredKeys()
+		// only has to look at the entries that are (or were) due rather
+		// than every entry.
+	typedef std::pair<time_t, KeyCacheEntry *> KeyCacheDeadline;
+	std::set<KeyCacheDeadline> m_expirations;
+
+	long long m_lookup_hits;
+	long long m_lookup_misses;
+	long long m_expired;
 
 	void addToIndex(KeyCacheEntry *);
 	void removeFromIndex(KeyCacheEntry *);
 	void addToIndex(KeyCacheIndex *,MyString const &index,KeyCacheEntry *);
 	void removeFromIndex(KeyCacheIndex *,MyString const &index,KeyCacheEntry *);
+
+		// like lookup(), but for SecMan's own bookkeeping, which
+		// shouldn't count as a hit or a miss.
+	KeyCacheEntry * find(const char *key_id);
+	void dequeueExpiration(KeyCacheEntry *);
 	void makeServerUniqueId(MyString const &parent_id,int server_pid,MyString *result);
 };
 
@@ -32,6 +32,7 @@ void sanity_check();
 #endif /* not WIN32 */
 
 class Condor_MD_MAC;
+class Condor_Crypto_State;
 
 class Buf {
 	
@@ -82,6 +83,14 @@ public:
         bool computeMD(char * checkSUM, Condor_MD_MAC * checker);
         bool verifyMD(char * checkSUM, Condor_MD_MAC * checker);
 
+		// AES-GCM, see Condor_Crypt_AESGCM.  seal() encrypts the data
+		// after the header and the nonce space reserved in front of it,
+		// authenticates the header, and appends the tag.  open() takes a
+		// buffer holding a sealed packet without its header, and leaves
+		// the clear text to be read.
+	bool seal(Condor_Crypto_State * state, const char * hdr, int hdr_len);
+	bool open(Condor_Crypto_State * state, const char * hdr, int hdr_len);
+
 	void swap(Buf &);
 
 private:
@@ -86,6 +86,11 @@ public:
 
   void CheckMatches(ClassAdListDoesNotDeleteAds& ResourceList);  // Remove matches that are not claimed
 
+  // Between these, changes are committed to the log without being forced
+  // to disk, which is done once by EndNegotiationCycle()
+  void BeginNegotiationCycle();
+  void EndNegotiationCycle();
+
   int GetLastUpdateTime() const { return LastUpdateTime; }
 
   double GetLimit(const string& limit);
@@ -157,6 +162,15 @@ private:
 
   ClassAdLog<std::string, ClassAd*> * AcctLog;
   int LastUpdateTime;
+  int CycleNondurableLevel; // -1 when not between Begin/EndNegotiationCycle
+
+  // Indexes of the records in AcctLog, by name without the record prefix, so that
+  // a pass over the customers or the matches doesn't have to look at every record.
+  // They are kept up to date by SetAttribute*() and DeleteClassAd(), which are
+  // the only ways records are created, changed and destroyed.
+  set<string> CustomerNames;
+  map<string, string> ResourceUsers;           // the RemoteUser of each Resource record
+  map<string, set<string> > CustomerResources; // the Resource records of each RemoteUser
 
   HashTable<string, double> concurrencyLimits;
 
@@ -184,6 +198,11 @@ private:
 
   bool DeleteClassAd(const string& Key);
 
+  void BuildIndexes();
+  void IndexRecord(const string& Key);
+  void IndexResourceUser(const string& ResourceName, const string& CustomerName);
+  void UnindexRecord(const string& Key);
+
   void SetAttributeInt(const string& Key, const string& AttrName, int AttrValue);
   void SetAttributeFloat(const string& Key, const string& AttrName, float AttrValue);
   void SetAttributeString(const string& Key, const string& AttrName, const string& AttrValue);
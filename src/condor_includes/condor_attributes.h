@@ -747,6 +747,9 @@
 #define ATTR_CLASSAD_LIFETIME  "ClassAdLifetime"
 #define ATTR_UPDATE_PRIO  "UpdatePrio"
 #define ATTR_UPDATE_SEQUENCE_NUMBER  "UpdateSequenceNumber"
+#define ATTR_UPDATE_DELTA_GENERATION  "UpdateDeltaGeneration"
+#define ATTR_UPDATE_DELTA_BASE  "UpdateDeltaBase"
+#define ATTR_UPDATE_DELTA_REMOVED  "UpdateDeltaRemoved"
 #define ATTR_USE_GRID_SHELL  "UseGridShell"
 #define ATTR_USE_PARROT  "UseParrot"
 #define ATTR_USER  "User"
@@ -924,6 +927,12 @@ extern const char ATTR_SEC_AUTHENTICATED_USER [];
 #define ATTR_TERMINATION_EXITREASON  "TerminationExitReason"
 
 #define ATTR_REPLICATION_LIST  "ReplicationList"
+#define ATTR_REPLICATION_STREAM_BYTES_RECEIVED  "ReplicationStreamBytesReceived"
+#define ATTR_REPLICATION_STREAM_BYTES_SENT  "ReplicationStreamBytesSent"
+#define ATTR_REPLICATION_STREAM_CONNECTED  "ReplicationStreamConnected"
+#define ATTR_REPLICATION_STREAM_LAG_BYTES  "ReplicationStreamLagBytes"
+#define ATTR_REPLICATION_STREAM_LAG_SECONDS  "ReplicationStreamLagSeconds"
+#define ATTR_REPLICATION_STREAM_STANDBYS  "ReplicationStreamStandbys"
 
 #define ATTR_TREQ_DIRECTION  "TransferDirection"
 #define ATTR_TREQ_INVALID_REQUEST  "InvalidRequest"
@@ -1092,6 +1101,13 @@ extern const char ATTR_SEC_AUTHENTICATED_USER [];
 #define ATTR_LAST_NEGOTIATION_CYCLE_PHASE2_CPU_TIME  "LastNegotiationCyclePhase2CpuTime"
 #define ATTR_LAST_NEGOTIATION_CYCLE_PHASE3_CPU_TIME  "LastNegotiationCyclePhase3CpuTime"
 #define ATTR_LAST_NEGOTIATION_CYCLE_PHASE4_CPU_TIME  "LastNegotiationCyclePhase4CpuTime"
+#define ATTR_LAST_NEGOTIATION_CYCLE_REQUIREMENTS_EVALUATIONS  "LastNegotiationCycleRequirementsEvaluations"
+#define ATTR_LAST_NEGOTIATION_CYCLE_RANK_EVALUATIONS  "LastNegotiationCycleRankEvaluations"
+#define ATTR_LAST_NEGOTIATION_CYCLE_MATCH_LIST_CACHE_HITS  "LastNegotiationCycleMatchListCacheHits"
+#define ATTR_LAST_NEGOTIATION_CYCLE_MATCH_LIST_CACHE_MISSES  "LastNegotiationCycleMatchListCacheMisses"
+#define ATTR_LAST_NEGOTIATION_CYCLE_MATCHMAKING_TIME  "LastNegotiationCycleMatchmakingTime"
+#define ATTR_LAST_NEGOTIATION_CYCLE_SCHEDD_TIME  "LastNegotiationCycleScheddTime"
+#define ATTR_LAST_NEGOTIATION_CYCLE_PREFETCH_TIME  "LastNegotiationCyclePrefetchTime"
 
 #define ATTR_JOB_MACHINE_ATTRS  "JobMachineAttrs"
 #define ATTR_MACHINE_ATTR_PREFIX  "MachineAttr"
@@ -1167,6 +1183,9 @@ extern const char ATTR_SEC_AUTHENTICATED_USER [];
 #define ATTR_SORT_EXPR_STRING "SortExprString"
 
 #define ATTR_MAX_TRANSFER_BYTES "MaxTransferBytes"
+#define ATTR_PARALLEL_TRANSFER_ADDRESS "ParallelTransferAddress"
+#define ATTR_PARALLEL_TRANSFER_COOKIE "ParallelTransferCookie"
+#define ATTR_PARALLEL_TRANSFER_STREAMS "ParallelTransferStreams"
 
 #define ATTR_REPORT_INTERVAL "ReportInterval"
 
@@ -189,6 +189,10 @@ NAMETABLE_DIRECTIVE:TABLE:DCTranslation
 #define GET_CEILING (SCHED_VERS+124)
 #define SET_CEILING (SCHED_VERS+125)
 
+// collector to startd: a delta update (UPDATE_STARTD_AD_DELTA) could not be merged,
+// so the next update of each slot should be a full one.
+#define STARTD_FULL_UPDATE_REQUEST (SCHED_VERS+126)
+
 
 // values used for "HowFast" in the draining request
 #define DRAIN_GRACEFUL 0
@@ -219,6 +223,7 @@ NAMETABLE_DIRECTIVE:TABLE:DCTranslation
 #define REPLICATION_SOLICIT_VERSION        (REPLICATION_COMMANDS_BASE + 4)
 #define REPLICATION_SOLICIT_VERSION_REPLY  (REPLICATION_COMMANDS_BASE + 5)
 #define REPLICATION_TRANSFER_FILE_NEW      (REPLICATION_COMMANDS_BASE + 6)
+#define REPLICATION_STREAM_LOG             (REPLICATION_COMMANDS_BASE + 7)
 
 /*
   The ClassAd-only protocol.  CA_CMD is the base command that's sent
@@ -354,6 +359,10 @@ const int UPDATE_OWN_SUBMITTOR_AD = 80;
 // Request a collector to retrieve an identity token from a schedd.
 const int IMPERSONATION_TOKEN_REQUEST = 81;
 
+// Like UPDATE_STARTD_AD, but the public ad has only the attributes that changed
+// since the update whose UpdateDeltaGeneration is the UpdateDeltaBase of this one.
+const int UPDATE_STARTD_AD_DELTA = 82;
+
 /* these comments are used to control command_table_generator.pl
 NAMETABLE_DIRECTIVE:END_SECTION:collector
 */
@@ -26,6 +26,7 @@
 
 #include "CryptKey.h"
 
+struct evp_cipher_ctx_st;	// EVP_CIPHER_CTX from <openssl/evp.h>
 
 class Condor_Crypto_State {
 
@@ -55,6 +56,18 @@ public:
     // CURRENTLY UNUSED: int m_additional_len;
     // CURRENTLY UNUSED: unsigned char *m_additional;
 
+    // AES-GCM only: cipher contexts holding the expanded key, and the
+    // nonces of both directions.  reset() leaves these alone, since a
+    // nonce must never be used twice with the same key.
+    // See Condor_Crypt_AESGCM.
+    struct evp_cipher_ctx_st *m_enc_ctx;
+    struct evp_cipher_ctx_st *m_dec_ctx;
+    unsigned char m_send_salt[8];
+    unsigned int m_send_count;
+    unsigned char m_recv_salt[8];
+    unsigned int m_recv_count;
+    bool m_recv_started;
+
 private:
     Condor_Crypto_State() {} ;
     Condor_Crypto_State(Condor_Crypto_State&) {};
@@ -0,0 +1,91 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef CONDOR_CRYPTO_AESGCM_H
+#define CONDOR_CRYPTO_AESGCM_H
+
+#include "condor_common.h"
+#include "condor_crypt.h"          // base class
+#include <string>
+
+// AES-256 in Galois/Counter Mode.  Unlike the other methods, this one
+// encrypts and authenticates whole messages, so ReliSock applies it to
+// each packet it sends (see ReliSock::SndMsg::snd_packet()) rather than
+// to each put().
+//
+// A sealed message is the nonce, the cipher text, which is as long as
+// the clear text, and the authentication tag.  The nonce is a random
+// salt chosen when the Condor_Crypto_State is made, followed by a count
+// of the messages sealed with it.  open() accepts messages in order
+// from the sender of the first message it accepted only, so messages
+// cannot be replayed, reordered, reflected back to their sender, or
+// spliced in from another connection that uses the same session key.
+class Condor_Crypt_AESGCM : public Condor_Crypt_Base {
+
+ public:
+    Condor_Crypt_AESGCM() {}
+    ~Condor_Crypt_AESGCM() {}
+
+    static const int NONCE_SIZE = 12;
+    static const int TAG_SIZE = 16;
+    static const int OVERHEAD = NONCE_SIZE + TAG_SIZE;
+
+    // Seal input_len bytes of clear text.  output must have room for
+    // input_len + OVERHEAD bytes; the cipher text is written at
+    // output + NONCE_SIZE, which may be the same as input.  The
+    // additional data (e.g. a packet header) is authenticated but
+    // not encrypted.
+    static bool seal(Condor_Crypto_State *s,
+                     const unsigned char *aad, int aad_len,
+                     const unsigned char *input, int input_len,
+                     unsigned char *output);
+
+    // Check and decrypt a sealed message of input_len bytes.  The
+    // input_len - OVERHEAD bytes of clear text are written to output,
+    // which may be input + NONCE_SIZE.  Returns false if the message
+    // or the additional data were tampered with, or the message is
+    // out of order.
+    static bool open(Condor_Crypto_State *s,
+                     const unsigned char *aad, int aad_len,
+                     const unsigned char *input, int input_len,
+                     unsigned char *output);
+
+    // Append the salts and counts of both directions to buf, and read
+    // them back from what was appended, returning where it ended or NULL
+    // if it is malformed.  A socket handed to another process carries on
+    // with the same nonces this way; the process that handed it over
+    // must not seal anything more with it.
+    static void serializeState(const Condor_Crypto_State *s, std::string &buf);
+    static const char *deserializeState(Condor_Crypto_State *s, const char *buf);
+
+    // seal() and open() a malloc()ed buffer, with no additional data.
+    bool encrypt(Condor_Crypto_State *s,
+                 const unsigned char * input,
+                 int          input_len, 
+                 unsigned char *&      output, 
+                 int&         output_len);
+
+    bool decrypt(Condor_Crypto_State *s,
+                 const unsigned char * input,
+                 int          input_len, 
+                 unsigned char *&      output, 
+                 int&         output_len);
+};
+
+#endif
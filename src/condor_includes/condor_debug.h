@@ -247,6 +247,16 @@ double dprintf_get_lock_delay(void);
 */
 int dprintf_getCount(void);
 
+/* get a count of dprintf messages dropped because the buffer for
+   <SUBSYS>_LOG_ASYNC_BUFFER was full (for statistics)
+*/
+int dprintf_getDroppedCount(void);
+
+/* wait until dprintf messages in the <SUBSYS>_LOG_ASYNC_BUFFER buffer
+   have been written to the log files
+*/
+void dprintf_async_flush(void);
+
 /* flush the buffered output that is created when TOOL_DEBUG_ON_ERROR is set
  */
 int dprintf_WriteOnErrorBuffer(FILE * out, int fClearBuffer);
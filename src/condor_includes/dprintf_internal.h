@@ -92,6 +92,7 @@ struct DebugFileInfo
 	bool rotate_by_time; // when true, logMax is a time interval for rotation
 	bool dont_panic;
 	void *userData;
+	long long asyncLength; // bytes written to the file, as far as DebugAsync knows
 	DebugFileInfo() :
 			outputTarget(FILE_OUT),
 			debugFP(0),
@@ -105,12 +106,14 @@ struct DebugFileInfo
 			rotate_by_time(false),
 			dont_panic(false),
 			userData(NULL),
+			asyncLength(0),
 			dprintfFunc(NULL)
 			{}
 	DebugFileInfo(const DebugFileInfo &dfi) : outputTarget(dfi.outputTarget), debugFP(NULL),
 		choice(dfi.choice), headerOpts(dfi.headerOpts),
 		logPath(dfi.logPath), maxLog(dfi.maxLog), logZero(dfi.logZero), maxLogNum(dfi.maxLogNum), want_truncate(dfi.want_truncate),
-		accepts_all(dfi.accepts_all), rotate_by_time(dfi.rotate_by_time), dont_panic(dfi.dont_panic), userData(dfi.userData), dprintfFunc(dfi.dprintfFunc) {}
+		accepts_all(dfi.accepts_all), rotate_by_time(dfi.rotate_by_time), dont_panic(dfi.dont_panic), userData(dfi.userData),
+		asyncLength(0), dprintfFunc(dfi.dprintfFunc) {}
 	DebugFileInfo(const dprintf_output_settings&);
 	~DebugFileInfo();
 	bool MatchesCatAndFlags(int cat_and_flags) const;
@@ -144,6 +147,19 @@ const char* _format_global_header(int cat_and_flags, int hdr_flags, DebugHeaderI
 void _dprintf_global_func(int cat_and_flags, int hdr_flags, DebugHeaderInfo & info, const char* message, DebugFileInfo* dbgInfo);
 void _dprintf_to_buffer(int cat_and_flags, int hdr_flags, DebugHeaderInfo & info, const char* message, DebugFileInfo* dbgInfo);
 
+// Asynchronous writes to the log files, see dprintf_async.cpp.
+// DebugAsync is true while _dprintf_global_func() should hand messages
+// for log files to the writer thread.
+extern int DebugAsync;
+extern long long DebugAsyncBufferSize;
+void dprintf_async_configure(long long buffer_size);
+// returns 1 if the message was queued, 0 if it was dropped and -1 if it
+// is too big for the buffer and must be written directly (the buffer
+// has been flushed in that case)
+int dprintf_async_write(int fd, const char *data, int len, bool may_drop);
+// write the buffer from a signal handler, without taking any locks
+void dprintf_async_crash_flush(void);
+
 #ifdef WIN32
 //Output to dbg string
 void dprintf_to_outdbgstr(int cat_and_flags, int hdr_flags, DebugHeaderInfo & info, const char* message, DebugFileInfo* dbgInfo);
@@ -197,6 +197,14 @@ public:
 	// returns -1 on failure, 0 for ok
 	int put_empty_file( filesize_t *size );
 
+	// True if the last get_file() or put_file() moved the data with
+	// splice() or sendfile(), see FILE_TRANSFER_ZERO_COPY.
+	bool last_file_zero_copy() const { return m_last_file_zero_copy; }
+
+	// True if put_file() sends the data just as it is in the file,
+	// with neither encryption nor sealing.
+	bool file_data_in_clear() const { return !get_encryption() && !seal_packets(); }
+
 	/// returns delegation_error on failure, delegation_ok on success,
 	/// and delegation_continue if the delegation is incomplete.
 	///
@@ -298,6 +306,11 @@ protected:
         virtual bool init_MD(CONDOR_MD_MODE mode, KeyInfo * key, const char * keyId);
         virtual bool set_encryption_id(const char * keyId);
 
+		// True when the crypto key is AES-GCM.  Every packet is then
+		// encrypted and authenticated as a whole, whatever the crypto
+		// and MD modes, and put_bytes()/get_bytes() leave it at that.
+	bool seal_packets() const;
+
 	/*
 	**	Types
 	*/
@@ -355,6 +368,11 @@ protected:
 		Buf			buf;
 		int snd_packet(char const *peer_description, int, int, int);
 
+			// Bytes to leave in front of the data of a packet for the
+			// header, and behind it for the AES-GCM tag.
+		int header_size() const;
+		int trailer_size() const;
+
 			// If there is a packet not flushed to the network, try to
 			// send it again.
 		int finish_packet(const char *peer_description, int sock, int timeout);
@@ -391,6 +409,7 @@ protected:
 	bool m_has_backlog;
 	bool m_read_would_block;
 	bool m_non_blocking;
+	bool m_last_file_zero_copy;
 
 	virtual void setTargetSharedPortID( char const *id );
 	virtual bool sendTargetSharedPortID();
@@ -400,6 +419,12 @@ private:
     ///
 	void init();				/* shared initialization method */
 
+		// get_file() and put_file() without copying the data to user
+		// space, see cedar_no_ckpt.cpp
+	bool zero_copy_allowed();
+	int get_file_zero_copy( int fd, filesize_t bytes_to_receive, filesize_t &total, class DCTransferQueue *xfer_q );
+	int put_file_zero_copy( int fd, filesize_t offset, filesize_t bytes_to_send, filesize_t &total, class DCTransferQueue *xfer_q );
+
 	bool connect_socketpair_impl( ReliSock & dest, condor_protocol proto, bool isLoopback );
 };
 
@@ -24,6 +24,7 @@
 #include "condor_io.h"
 #include "condor_debug.h"
 #include "condor_md.h"
+#include "condor_crypt_aesgcm.h"
 #include "condor_rw.h"
 
 unsigned long num_created = 0;
@@ -320,6 +321,45 @@ bool Buf::verifyMD(char * checkSUM, Condor_MD_MAC * checker)
     return checker->verifyMD((unsigned char *) checkSUM);
 }
 
+bool Buf::seal(Condor_Crypto_State * state, const char * hdr, int hdr_len)
+{
+	alloc_buf();
+
+	int data_len = _dta_sz - hdr_len - Condor_Crypt_AESGCM::NONCE_SIZE;
+	if (data_len < 0) {
+		return false;
+	}
+	if (num_free() < Condor_Crypt_AESGCM::TAG_SIZE) {
+		grow_buf(_dta_sz + Condor_Crypt_AESGCM::TAG_SIZE);
+	}
+
+	unsigned char *sealed = (unsigned char *) &_dta[hdr_len];
+	if (!Condor_Crypt_AESGCM::seal(state, (const unsigned char *) hdr, hdr_len,
+			sealed + Condor_Crypt_AESGCM::NONCE_SIZE, data_len, sealed)) {
+		return false;
+	}
+	_dta_sz += Condor_Crypt_AESGCM::TAG_SIZE;
+	return true;
+}
+
+bool Buf::open(Condor_Crypto_State * state, const char * hdr, int hdr_len)
+{
+	alloc_buf();
+
+	if (_dta_sz < Condor_Crypt_AESGCM::OVERHEAD) {
+		return false;
+	}
+
+	unsigned char *sealed = (unsigned char *) &_dta[0];
+	if (!Condor_Crypt_AESGCM::open(state, (const unsigned char *) hdr, hdr_len,
+			sealed, _dta_sz, sealed + Condor_Crypt_AESGCM::NONCE_SIZE)) {
+		return false;
+	}
+	_dta_sz -= Condor_Crypt_AESGCM::TAG_SIZE;
+	_dta_pt = Condor_Crypt_AESGCM::NONCE_SIZE;
+	return true;
+}
+
 void Buf::swap(Buf &other)
 {
 	char * tmp_dta = _dta;
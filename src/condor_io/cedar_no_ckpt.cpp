@@ -47,9 +47,14 @@
 #include "dc_transfer_queue.h"
 #include "limit_directory_access.h"
 
+#include "selector.h"
+
 #ifdef WIN32
 #include <mswsock.h>	// For TransmitFile()
 #endif
+#if defined(LINUX)
+#include <sys/sendfile.h>
+#endif
 
 const unsigned int PUT_FILE_EOM_NUM = 666;
 
@@ -135,6 +140,287 @@ ReliSock::get_file( filesize_t *size, const char *destination,
 	return result;
 }
 
+bool
+ReliSock::zero_copy_allowed()
+{
+		// The data must go out exactly as it is in the file.
+	return file_data_in_clear() &&
+		param_boolean( "FILE_TRANSFER_ZERO_COPY", true );
+}
+
+#if defined(LINUX)
+
+// Wait for the socket to be ready for io, for no longer than its timeout.
+// Returns false if it was not.
+static bool
+zero_copy_wait( SOCKET sock, Selector::IO_FUNC io, int timeout, const char *peer )
+{
+	Selector selector;
+	selector.add_fd( sock, io );
+	if ( timeout > 0 ) {
+		selector.set_timeout( timeout );
+	}
+	do {
+		selector.execute();
+	} while ( selector.signalled() );
+
+	if ( selector.timed_out() ) {
+		dprintf( D_ALWAYS, "ReliSock: timed out waiting %d seconds for %s\n",
+				 timeout, peer );
+		return false;
+	}
+	if ( selector.failed() ) {
+		dprintf( D_ALWAYS, "ReliSock: select() failed waiting for %s: %s\n",
+				 peer, strerror(selector.select_errno()) );
+		return false;
+	}
+	return true;
+}
+
+// Largest pipe get_file_zero_copy() asks for; 1 MiB is what the kernel
+// lets unprivileged processes have by default.
+static const int ZERO_COPY_PIPE_SIZE = 1024 * 1024;
+// Most put_file_zero_copy() asks sendfile() for at once.
+static const size_t ZERO_COPY_CHUNK = 4 * 1024 * 1024;
+
+// Receive the data for get_file() with splice(), from the socket into a
+// pipe and from the pipe into fd, so that it never passes through user
+// space.  Adds what was received to total.  Returns
+//  0 when all of it was received,
+//  1 if splice() does not work for these descriptors, in which case the
+//    caller receives the rest itself,
+//  GET_FILE_WRITE_FAILED if writing to fd failed (errno is set), in which
+//    case the caller receives and throws away the rest,
+//  -1 if receiving failed.
+int
+ReliSock::get_file_zero_copy( int fd, filesize_t bytes_to_receive, filesize_t &total, DCTransferQueue *xfer_q )
+{
+	if ( !prepare_for_nobuffering(stream_decode) ) {
+		return -1;
+	}
+
+	int pipe_fds[2];
+	if ( pipe2(pipe_fds, O_CLOEXEC) < 0 ) {
+		return 1;
+	}
+	fcntl( pipe_fds[1], F_SETPIPE_SZ, ZERO_COPY_PIPE_SIZE );
+	int pipe_size = fcntl( pipe_fds[1], F_GETPIPE_SZ );
+	if ( pipe_size <= 0 ) {
+		pipe_size = 65536;
+	}
+
+	int sock_flags = fcntl( _sock, F_GETFL );
+	bool set_nonblocking = sock_flags >= 0 && !(sock_flags & O_NONBLOCK);
+	if ( set_nonblocking ) {
+		fcntl( _sock, F_SETFL, sock_flags | O_NONBLOCK );
+	}
+
+	int result = 0;
+	int saved_errno = 0;
+	while ( total < bytes_to_receive ) {
+		struct timeval t1, t2;
+		if ( xfer_q ) {
+			condor_gettimestamp(t1);
+		}
+
+		size_t chunk = (size_t) MIN( (filesize_t) pipe_size, bytes_to_receive - total );
+		ssize_t nread = splice( _sock, NULL, pipe_fds[1], NULL, chunk,
+								SPLICE_F_MOVE | SPLICE_F_NONBLOCK );
+		if ( nread < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			if ( errno == EAGAIN || errno == EWOULDBLOCK ) {
+				if ( !zero_copy_wait(_sock, Selector::IO_READ, _timeout, peer_description()) ) {
+					result = -1;
+					break;
+				}
+				continue;
+			}
+			if ( total == 0 && (errno == EINVAL || errno == ENOSYS) ) {
+				result = 1;
+				break;
+			}
+			dprintf( D_ALWAYS, "ReliSock::get_file: splice() from %s failed: %s\n",
+					 peer_description(), strerror(errno) );
+			result = -1;
+			break;
+		}
+		if ( nread == 0 ) {
+			dprintf( D_ALWAYS, "ReliSock::get_file: connection to %s closed\n",
+					 peer_description() );
+			result = -1;
+			break;
+		}
+		_bytes_recvd += nread;
+
+		if ( xfer_q ) {
+			condor_gettimestamp(t2);
+			xfer_q->AddUsecNetRead(timersub_usec(t2, t1));
+		}
+
+		ssize_t left = nread;
+		while ( left > 0 && !saved_errno ) {
+			ssize_t nwritten = splice( pipe_fds[0], NULL, fd, NULL, left, SPLICE_F_MOVE );
+			if ( nwritten > 0 ) {
+				left -= nwritten;
+			} else if ( nwritten < 0 && errno == EINTR ) {
+				continue;
+			} else if ( nwritten < 0 && (errno == EINVAL || errno == ENOSYS) && !m_last_file_zero_copy ) {
+					// This file cannot be spliced to (it may be open for
+					// appending); write what is in the pipe, then let the
+					// caller do the rest.
+				result = 1;
+				break;
+			} else {
+				saved_errno = nwritten < 0 ? errno : EIO;
+				dprintf( D_ALWAYS, "ReliSock::get_file: splice() to file failed: %s\n",
+						 strerror(saved_errno) );
+			}
+		}
+
+			// The rest of what is in the pipe was read from the socket,
+			// so it must be written or thrown away here.
+		while ( left > 0 ) {
+			char buf[65536];
+			ssize_t nr = ::read( pipe_fds[0], buf, MIN( (ssize_t)sizeof(buf), left ) );
+			if ( nr <= 0 ) {
+				if ( nr < 0 && errno == EINTR ) {
+					continue;
+				}
+				result = -1;
+				break;
+			}
+			left -= nr;
+			for ( ssize_t written = 0; written < nr && !saved_errno; ) {
+				ssize_t rval = ::write( fd, &buf[written], nr - written );
+				if ( rval > 0 ) {
+					written += rval;
+				} else if ( rval < 0 && errno == EINTR ) {
+					continue;
+				} else {
+					saved_errno = rval < 0 ? errno : EIO;
+					dprintf( D_ALWAYS, "ReliSock::get_file: write() returned %d: %s\n",
+							 (int) rval, strerror(saved_errno) );
+				}
+			}
+		}
+
+		if ( xfer_q ) {
+			condor_gettimestamp(t1);
+				// reuse t2 above as start time for file write
+			xfer_q->AddUsecFileWrite(timersub_usec(t1, t2));
+			xfer_q->AddBytesReceived(nread);
+			xfer_q->ConsiderSendingReport(t1.tv_sec);
+		}
+
+		total += nread;
+		if ( result != 1 ) {
+			m_last_file_zero_copy = true;
+		}
+		if ( result != 0 ) {
+			break;
+		}
+		if ( saved_errno ) {
+			result = GET_FILE_WRITE_FAILED;
+			break;
+		}
+	}
+
+	if ( set_nonblocking ) {
+		fcntl( _sock, F_SETFL, sock_flags );
+	}
+	::close( pipe_fds[0] );
+	::close( pipe_fds[1] );
+
+	if ( result == 1 && saved_errno ) {
+		result = GET_FILE_WRITE_FAILED;
+	}
+	errno = saved_errno;
+	return result;
+}
+
+// Send the data for put_file() with sendfile(), so that it never passes
+// through user space.  Adds what was sent to total.  Returns 0 when all
+// of it was sent or the file ended early, 1 if sendfile() does not work
+// for fd and nothing was sent, in which case the caller sends the file,
+// and -1 if sending failed.
+int
+ReliSock::put_file_zero_copy( int fd, filesize_t offset, filesize_t bytes_to_send, filesize_t &total, DCTransferQueue *xfer_q )
+{
+	if ( !prepare_for_nobuffering(stream_encode) ) {
+		dprintf( D_ALWAYS, "ReliSock: put_file: failed to drain buffers!\n" );
+		return -1;
+	}
+
+	int sock_flags = fcntl( _sock, F_GETFL );
+	bool set_nonblocking = sock_flags >= 0 && !(sock_flags & O_NONBLOCK);
+	if ( set_nonblocking ) {
+		fcntl( _sock, F_SETFL, sock_flags | O_NONBLOCK );
+	}
+
+	off_t file_offset = offset;
+	int result = 0;
+	while ( total < bytes_to_send ) {
+		struct timeval t1, t2;
+		if ( xfer_q ) {
+			condor_gettimestamp(t1);
+		}
+
+		size_t chunk = (size_t) MIN( (filesize_t) ZERO_COPY_CHUNK, bytes_to_send - total );
+		ssize_t nbytes = sendfile( _sock, fd, &file_offset, chunk );
+
+		if ( xfer_q ) {
+				// We don't know how much of the time was spent reading
+				// from disk vs. writing to the network, so we just report
+				// it all as network i/o time.
+			condor_gettimestamp(t2);
+			xfer_q->AddUsecNetWrite(timersub_usec(t2, t1));
+		}
+
+		if ( nbytes < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			if ( errno == EAGAIN || errno == EWOULDBLOCK ) {
+				if ( !zero_copy_wait(_sock, Selector::IO_WRITE, _timeout, peer_description()) ) {
+					result = -1;
+					break;
+				}
+				continue;
+			}
+			if ( total == 0 && (errno == EINVAL || errno == ENOSYS) ) {
+				result = 1;
+				break;
+			}
+			dprintf( D_ALWAYS, "ReliSock::put_file: sendfile() to %s failed: %s\n",
+					 peer_description(), strerror(errno) );
+			result = -1;
+			break;
+		}
+		if ( nbytes == 0 ) {
+				// the file is shorter than it was, the caller
+				// reports that we sent too little
+			break;
+		}
+
+		m_last_file_zero_copy = true;
+		total += nbytes;
+		_bytes_sent += nbytes;
+		if ( xfer_q ) {
+			xfer_q->AddBytesSent(nbytes);
+			xfer_q->ConsiderSendingReport(t2.tv_sec);
+		}
+	}
+
+	if ( set_nonblocking ) {
+		fcntl( _sock, F_SETFL, sock_flags );
+	}
+	return result;
+}
+
+#endif // LINUX
+
 MSC_DISABLE_WARNING(6262) // function uses 64k of stack
 int
 ReliSock::get_file( filesize_t *size, int fd,
@@ -151,6 +437,8 @@ ReliSock::get_file( filesize_t *size, int fd,
 		// NOTE: the caller may pass fd=GET_FILE_NULL_FD, in which
 		// case we just read but do not write the data.
 
+	m_last_file_zero_copy = false;
+
 	// Read the filesize from the other end of the wire
 	if ( !get(filesize) || !end_of_message() ) {
 		dprintf(D_ALWAYS, 
@@ -176,8 +464,26 @@ ReliSock::get_file( filesize_t *size, int fd,
 		  RSC in the syscall library.  this code isn't like that.
 		*/
 
+	bool receive_failed = false;
+#if defined(LINUX)
+	if ( fd != GET_FILE_NULL_FD && bytes_to_receive > 0 &&
+		 (max_bytes < 0 || bytes_to_receive <= max_bytes) && zero_copy_allowed() )
+	{
+		int rc = get_file_zero_copy( fd, bytes_to_receive, total, xfer_q );
+		if ( rc == GET_FILE_WRITE_FAILED ) {
+				// Receive the rest, but throw it all away, as below.
+			saved_errno = errno;
+			fd = GET_FILE_NULL_FD;
+			retval = GET_FILE_WRITE_FAILED;
+		}
+		else if ( rc < 0 ) {
+			receive_failed = true;
+		}
+	}
+#endif
+
 	// Now, read it all in & save it
-	while( total < bytes_to_receive ) {
+	while( !receive_failed && total < bytes_to_receive ) {
 		struct timeval t1,t2;
 		if( xfer_q ) {
 			condor_gettimestamp(t1);
@@ -293,8 +599,8 @@ ReliSock::get_file( filesize_t *size, int fd,
 	}
 	else {
 		dprintf( D_FULLDEBUG,
-				 "get_file: wrote " FILESIZE_T_FORMAT " bytes to file\n",
-				 total );
+				 "get_file: wrote " FILESIZE_T_FORMAT " bytes to file%s\n",
+				 total, m_last_file_zero_copy ? " with splice()" : "" );
 	}
 
 	if ( total < filesize ) {
@@ -379,6 +685,7 @@ ReliSock::put_file( filesize_t *size, int fd, filesize_t offset, filesize_t max_
 	filesize_t	filesize;
 	filesize_t	total = 0;
 
+	m_last_file_zero_copy = false;
 
 	StatInfo filestat( fd );
 	if ( filestat.Error() ) {
@@ -444,11 +751,23 @@ ReliSock::put_file( filesize_t *size, int fd, filesize_t offset, filesize_t max_
 	// If the file has a non-zero size, send it
 	if ( bytes_to_send > 0 ) {
 
+#if defined(LINUX)
+		// Without encryption, let the kernel send the file straight
+		// from the page cache.
+		if ( zero_copy_allowed() ) {
+			int rc = put_file_zero_copy( fd, offset, bytes_to_send, total, xfer_q );
+			if ( rc < 0 ) {
+				return -1;
+			}
+		}
+#endif
+
 #if defined(WIN32)
 		// On Win32, if we don't need encryption, use the super-efficient Win32
 		// TransmitFile system call. Also, TransmitFile does not support
 		// file sizes over 2GB, so we avoid that case as well.
 		if (  (!get_encryption()) &&
+			  (!seal_packets()) &&
 			  (0 == offset) &&
 			  (bytes_to_send < INT_MAX)  ) {
 
@@ -493,10 +812,10 @@ ReliSock::put_file( filesize_t *size, int fd, filesize_t offset, filesize_t max_
 		char buf[65536];
 		int nbytes, nrd;
 
-		// On Unix, always send the file using put_bytes_nobuffer().
+		// Otherwise, send the file using put_bytes_nobuffer().
 		// Note that on Win32, we use this method as well if encryption 
 		// is required.
-		while (total < bytes_to_send) {
+		while (!m_last_file_zero_copy && total < bytes_to_send) {
 			struct timeval t1;
 			struct timeval t2;
 			if( xfer_q ) {
@@ -543,7 +862,8 @@ ReliSock::put_file( filesize_t *size, int fd, filesize_t offset, filesize_t max_
 	}
 
 	dprintf(D_FULLDEBUG,
-			"ReliSock: put_file: sent " FILESIZE_T_FORMAT " bytes\n", total);
+			"ReliSock: put_file: sent " FILESIZE_T_FORMAT " bytes%s\n", total,
+			m_last_file_zero_copy ? " with sendfile()" : "");
 
 	if (total < bytes_to_send) {
 		dprintf(D_ALWAYS,
@@ -29,6 +29,7 @@
 // function in each method object.
 #include <openssl/des.h>
 #include <openssl/blowfish.h>
+#include <openssl/evp.h>
 
 Condor_Crypto_State::Condor_Crypto_State(Protocol proto, KeyInfo &key) :
     m_keyInfo(key)
@@ -44,6 +45,13 @@ Condor_Crypto_State::Condor_Crypto_State(Protocol proto, KeyInfo &key) :
     m_ivec = NULL;
     m_method_key_data_len = 0;
     m_method_key_data = NULL;
+    m_enc_ctx = NULL;
+    m_dec_ctx = NULL;
+    memset(m_send_salt, 0, sizeof(m_send_salt));
+    m_send_count = 0;
+    memset(m_recv_salt, 0, sizeof(m_recv_salt));
+    m_recv_count = 0;
+    m_recv_started = false;
 
     // there should probably be a static function in each crypto object to do
     // these conversions so that the state object doesn't need any specifc
@@ -79,6 +87,35 @@ Condor_Crypto_State::Condor_Crypto_State(Protocol proto, KeyInfo &key) :
             m_ivec = (unsigned char*)malloc(m_ivec_len);
             break;
         }
+        case CONDOR_AESGCM: {
+            // Session keys are 24 bytes, and the keys of non-negotiated
+            // sessions are 16, so hash them up to the 32 that AES-256
+            // wants.  The contexts are keyed once here, which saves
+            // the key expansion on every packet.
+            unsigned char aes_key[32];
+            unsigned int aes_key_len = sizeof(aes_key);
+            if (!EVP_Digest(m_keyInfo.getKeyData(), m_keyInfo.getKeyLength(),
+                            aes_key, &aes_key_len, EVP_sha256(), NULL)) {
+                EXCEPT("CRYPTO: failed to derive AES key");
+            }
+
+            m_enc_ctx = EVP_CIPHER_CTX_new();
+            m_dec_ctx = EVP_CIPHER_CTX_new();
+            if (!m_enc_ctx || !m_dec_ctx ||
+                !EVP_EncryptInit_ex(m_enc_ctx, EVP_aes_256_gcm(), NULL, aes_key, NULL) ||
+                !EVP_DecryptInit_ex(m_dec_ctx, EVP_aes_256_gcm(), NULL, aes_key, NULL))
+            {
+                EXCEPT("CRYPTO: failed to initialize AES-GCM");
+            }
+            memset(aes_key, 0, sizeof(aes_key));
+
+            // Every copy of the key gets its own salt, so that two
+            // sockets sharing a session never send the same nonce.
+            if (RAND_bytes(m_send_salt, sizeof(m_send_salt)) != 1) {
+                EXCEPT("CRYPTO: failed to generate AES-GCM nonce");
+            }
+            break;
+        }
         default:
             dprintf(D_ALWAYS, "CRYPTO: WARNING: Initialized crypto state for unknown proto %i.\n", proto);
             break;
@@ -92,6 +129,8 @@ Condor_Crypto_State::Condor_Crypto_State(Protocol proto, KeyInfo &key) :
 Condor_Crypto_State::~Condor_Crypto_State() {
     if(m_ivec) free(m_ivec);
     if(m_method_key_data) free(m_method_key_data);
+    if(m_enc_ctx) EVP_CIPHER_CTX_free(m_enc_ctx);
+    if(m_dec_ctx) EVP_CIPHER_CTX_free(m_dec_ctx);
     // CURRENTLY UNUSED: if(m_additional) free(m_additional);
 }
 
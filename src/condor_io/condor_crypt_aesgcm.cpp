@@ -0,0 +1,200 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ * 
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+
+#include "condor_common.h"
+#include "condor_crypt_aesgcm.h"
+#include "condor_debug.h"
+#include "stl_string_utils.h"
+#include <openssl/evp.h>
+
+// The nonce is the sender's salt, then its message count in network
+// byte order.
+static void
+make_nonce(unsigned char *nonce, const unsigned char *salt, unsigned int count)
+{
+    memcpy(nonce, salt, 8);
+    count = htonl(count);
+    memcpy(nonce + 8, &count, 4);
+}
+
+bool Condor_Crypt_AESGCM :: seal(Condor_Crypto_State *cs,
+                                 const unsigned char *aad, int aad_len,
+                                 const unsigned char *input, int input_len,
+                                 unsigned char *output)
+{
+    EVP_CIPHER_CTX *ctx = cs->m_enc_ctx;
+    if (!ctx || input_len < 0) {
+        return false;
+    }
+    if (cs->m_send_count == 0xffffffff) {
+            // rather than wrap around and use a nonce again
+        dprintf(D_ALWAYS, "CRYPTO: AES-GCM key has sealed too many messages\n");
+        return false;
+    }
+
+    unsigned char *nonce = output;
+    unsigned char *cipher_text = output + NONCE_SIZE;
+    unsigned char *tag = cipher_text + input_len;
+    make_nonce(nonce, cs->m_send_salt, cs->m_send_count);
+
+    int len = 0;
+    if (!EVP_EncryptInit_ex(ctx, NULL, NULL, NULL, nonce) ||
+        (aad_len > 0 && !EVP_EncryptUpdate(ctx, NULL, &len, aad, aad_len)) ||
+        !EVP_EncryptUpdate(ctx, cipher_text, &len, input, input_len) ||
+        !EVP_EncryptFinal_ex(ctx, cipher_text + len, &len) ||
+        !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, TAG_SIZE, tag))
+    {
+        dprintf(D_ALWAYS, "CRYPTO: AES-GCM encryption failed\n");
+        return false;
+    }
+
+    cs->m_send_count++;
+    return true;
+}
+
+bool Condor_Crypt_AESGCM :: open(Condor_Crypto_State *cs,
+                                 const unsigned char *aad, int aad_len,
+                                 const unsigned char *input, int input_len,
+                                 unsigned char *output)
+{
+    EVP_CIPHER_CTX *ctx = cs->m_dec_ctx;
+    if (!ctx || input_len < OVERHEAD) {
+        return false;
+    }
+
+    const unsigned char *nonce = input;
+    const unsigned char *cipher_text = input + NONCE_SIZE;
+    int cipher_text_len = input_len - OVERHEAD;
+    const unsigned char *tag = cipher_text + cipher_text_len;
+
+    unsigned int count;
+    memcpy(&count, nonce + 8, 4);
+    count = ntohl(count);
+
+        // A sender's messages must arrive in order.  The salt of the
+        // first message we accept is the peer's from then on, so that
+        // messages sealed with another copy of the session key, e.g. on
+        // another connection, cannot be spliced in.  A socket handed to
+        // another process takes the salts and counts along with it (see
+        // Sock::serializeCryptoInfo()), so it never needs a new salt.
+        // Our own salt means the message is one of ours, sent back.
+    if (memcmp(nonce, cs->m_send_salt, 8) == 0) {
+        dprintf(D_ALWAYS, "CRYPTO: AES-GCM message was sent by us, rejecting it\n");
+        return false;
+    }
+    if (cs->m_recv_started && memcmp(nonce, cs->m_recv_salt, 8) != 0) {
+        dprintf(D_ALWAYS, "CRYPTO: AES-GCM message is from another sender, rejecting it\n");
+        return false;
+    }
+    unsigned int expected = cs->m_recv_started ? cs->m_recv_count : 0;
+    if (count != expected) {
+        dprintf(D_ALWAYS, "CRYPTO: AES-GCM message %u is out of order, expected %u\n",
+                count, expected);
+        return false;
+    }
+
+    int len = 0;
+    if (!EVP_DecryptInit_ex(ctx, NULL, NULL, NULL, nonce) ||
+        (aad_len > 0 && !EVP_DecryptUpdate(ctx, NULL, &len, aad, aad_len)) ||
+        !EVP_DecryptUpdate(ctx, output, &len, cipher_text, cipher_text_len) ||
+        !EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, TAG_SIZE, const_cast<unsigned char *>(tag)) ||
+        EVP_DecryptFinal_ex(ctx, output + len, &len) <= 0)
+    {
+        dprintf(D_ALWAYS, "CRYPTO: AES-GCM message failed authentication\n");
+        return false;
+    }
+
+    memcpy(cs->m_recv_salt, nonce, 8);
+    cs->m_recv_count = count + 1;
+    cs->m_recv_started = true;
+    return true;
+}
+
+// The state is written as :SALT:COUNT:SALT:COUNT:STARTED, sending first,
+// with the salts in hex.
+void Condor_Crypt_AESGCM :: serializeState(const Condor_Crypto_State *cs, std::string &buf)
+{
+    buf += ':';
+    for (int i = 0; i < 8; i++) {
+        formatstr_cat(buf, "%02X", cs->m_send_salt[i]);
+    }
+    formatstr_cat(buf, ":%u:", cs->m_send_count);
+    for (int i = 0; i < 8; i++) {
+        formatstr_cat(buf, "%02X", cs->m_recv_salt[i]);
+    }
+    formatstr_cat(buf, ":%u:%d", cs->m_recv_count, cs->m_recv_started ? 1 : 0);
+}
+
+const char * Condor_Crypt_AESGCM :: deserializeState(Condor_Crypto_State *cs, const char *buf)
+{
+    unsigned int send_salt[8], recv_salt[8];
+    unsigned int send_count = 0, recv_count = 0;
+    int started = 0, len = 0;
+    if (sscanf(buf, ":%2X%2X%2X%2X%2X%2X%2X%2X:%u:%2X%2X%2X%2X%2X%2X%2X%2X:%u:%d%n",
+               &send_salt[0], &send_salt[1], &send_salt[2], &send_salt[3],
+               &send_salt[4], &send_salt[5], &send_salt[6], &send_salt[7],
+               &send_count,
+               &recv_salt[0], &recv_salt[1], &recv_salt[2], &recv_salt[3],
+               &recv_salt[4], &recv_salt[5], &recv_salt[6], &recv_salt[7],
+               &recv_count, &started, &len) != 19) {
+        return NULL;
+    }
+    for (int i = 0; i < 8; i++) {
+        cs->m_send_salt[i] = (unsigned char)send_salt[i];
+        cs->m_recv_salt[i] = (unsigned char)recv_salt[i];
+    }
+    cs->m_send_count = send_count;
+    cs->m_recv_count = recv_count;
+    cs->m_recv_started = started != 0;
+    return buf + len;
+}
+
+bool Condor_Crypt_AESGCM :: encrypt(Condor_Crypto_State *cs,
+                                    const unsigned char *  input,
+                                    int              input_len, 
+                                    unsigned char *& output, 
+                                    int&             output_len)
+{
+    output_len = input_len + OVERHEAD;
+    output = (unsigned char *) malloc(output_len);
+    if (!output) {
+        return false;
+    }
+    return seal(cs, NULL, 0, input, input_len, output);
+}
+
+bool Condor_Crypt_AESGCM :: decrypt(Condor_Crypto_State *cs,
+                                    const unsigned char *  input,
+                                    int              input_len, 
+                                    unsigned char *& output, 
+                                    int&             output_len)
+{
+    output = NULL;
+    output_len = 0;
+    if (input_len < OVERHEAD) {
+        return false;
+    }
+    output = (unsigned char *) malloc(input_len - OVERHEAD + 1);
+    if (!output) {
+        return false;
+    }
+    output_len = input_len - OVERHEAD;
+    return open(cs, NULL, 0, input, input_len, output);
+}
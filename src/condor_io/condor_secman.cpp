@@ -2708,10 +2708,8 @@ SecMan::invalidateByParentAndPid(const char * parent, int pid) {
 bool SecMan :: invalidateKey(const char * key_id)
 {
     bool removed = true;
-    KeyCacheEntry * keyEntry = NULL;
-
-	int r = session_cache->lookup(key_id, keyEntry);
-	if (!r) {
+	KeyCacheEntry * keyEntry = session_cache->find(key_id);
+	if (!keyEntry) {
 		dprintf( D_SECURITY,
 				 "DC_INVALIDATE_KEY: security session %s not found in cache.\n",
 				 key_id);
@@ -3261,6 +3259,8 @@ Protocol CryptProtocolNameToEnum(char const *name) {
 	case '3': // 3des
 	case 'T': // Tripledes
 		return CONDOR_3DES;
+	case 'A': // aes
+		return CONDOR_AESGCM;
 	default:
 		return CONDOR_NO_PROTOCOL;
 	}
@@ -3378,11 +3378,8 @@ SecMan::CreateNonNegotiatedSecuritySession(DCpermission auth_level, char const *
 	KeyCacheEntry key(sesid,peer_sinful ? &peer_addr : NULL,keyinfo,&policy,expiration_time,0);
 
 	if( !session_cache->insert(key) ) {
-		KeyCacheEntry *existing = NULL;
+		KeyCacheEntry *existing = session_cache->find(sesid);
 		bool fixed = false;
-		if( !session_cache->lookup(sesid,existing) ) {
-			existing = NULL;
-		}
 		if( existing ) {
 			if( !LookupNonExpiredSession(sesid,existing) ) {
 					// the existing session must have expired, so try again
@@ -3622,13 +3619,14 @@ bool
 SecMan::SetSessionExpiration(char const *session_id,time_t expiration_time) {
 	ASSERT( session_id );
 
-	KeyCacheEntry *session_key = NULL;
-	if(!session_cache->lookup(session_id,session_key)) {
+	KeyCacheEntry *session_key = session_cache->find(session_id);
+	if(!session_key) {
 		dprintf(D_ALWAYS,"SECMAN: SetSessionExpiration failed to find "
 				"session %s\n",session_id);
 		return false;
 	}
 	session_key->setExpiration(expiration_time);
+	session_cache->expirationChanged(session_key);
 
 	dprintf(D_SECURITY,"Set expiration time for security session %s to %ds\n",session_id,(int)(expiration_time-time(NULL)));
 
@@ -3639,8 +3637,8 @@ bool
 SecMan::SetSessionLingerFlag(char const *session_id) {
 	ASSERT( session_id );
 
-	KeyCacheEntry *session_key = NULL;
-	if(!session_cache->lookup(session_id,session_key)) {
+	KeyCacheEntry *session_key = session_cache->find(session_id);
+	if(!session_key) {
 		dprintf(D_ALWAYS,"SECMAN: SetSessionLingerFlag failed to find "
 				"session %s\n",session_id);
 		return false;
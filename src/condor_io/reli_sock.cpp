@@ -26,6 +26,7 @@
 #include "internet.h"
 #include "condor_rw.h"
 #include "condor_md.h"
+#include "condor_crypt_aesgcm.h"
 #include "selector.h"
 #include "ccb_client.h"
 #include "condor_sockfunc.h"
@@ -47,6 +48,7 @@ ReliSock::init()
 	m_has_backlog = false;
 	m_read_would_block = false;
 	m_non_blocking = false;
+	m_last_file_zero_copy = false;
 	ignore_next_encode_eom = FALSE;
 	ignore_next_decode_eom = FALSE;
 	_bytes_sent = 0.0;
@@ -242,6 +244,11 @@ bool ReliSock::init_MD(CONDOR_MD_MODE mode, KeyInfo * key, const char * /* keyId
     return (snd_msg.init_MD(mode, key) && rcv_msg.init_MD(mode, key));
 }
 
+bool ReliSock::seal_packets() const
+{
+	return crypto_state_ && crypto_state_->m_keyInfo.getProtocol() == CONDOR_AESGCM;
+}
+
 ReliSock *
 ReliSock::accept()
 {
@@ -329,9 +336,25 @@ ReliSock::put_bytes_nobuffer( const char *buffer, int length, int send_size )
 	int pagesize = 65536;  // Optimize large writes to be page sized.
 	const char * cur;
 	unsigned char * buf = NULL;
+	int wire_length = length;
         
-	// First, encrypt the data if necessary
-	if (get_encryption()) {
+	// First, encrypt the data if necessary.  With AES-GCM, the data
+	// goes out as one sealed record: its length, then the sealed data.
+	if (seal_packets()) {
+		l_out = length + Condor_Crypt_AESGCM::OVERHEAD;
+		wire_length = 4 + l_out;
+		buf = (unsigned char *) malloc(wire_length);
+		ASSERT(buf);
+		uint32_t net_len = htonl((uint32_t) l_out);
+		memcpy(buf, &net_len, 4);
+		if (!Condor_Crypt_AESGCM::seal(crypto_state_, buf, 4,
+				(const unsigned char *) buffer, length, buf + 4)) {
+			dprintf(D_SECURITY, "Encryption failed\n");
+			goto error;
+		}
+		cur = (char *)buf;
+	}
+	else if (get_encryption()) {
 		if (!wrap((const unsigned char *) buffer, length,  buf , l_out)) {
 			dprintf(D_SECURITY, "Encryption failed\n");
 			goto error;
@@ -357,16 +380,16 @@ ReliSock::put_bytes_nobuffer( const char *buffer, int length, int send_size )
 	}
 
 	// Optimize transfer by writing in pagesized chunks.
-	for(i = 0; i < length;)
+	for(i = 0; i < wire_length;)
 	{
 		// If there is less then a page left.
-		if( (length - i) < pagesize ) {
-			result = condor_write(peer_description(), _sock, cur, (length - i), _timeout);
+		if( (wire_length - i) < pagesize ) {
+			result = condor_write(peer_description(), _sock, cur, (wire_length - i), _timeout);
 			if( result < 0 ) {
                                 goto error;
 			}
-			cur += (length - i);
-			i += (length - i);
+			cur += (wire_length - i);
+			i += (wire_length - i);
 		} else {  
 			// Send another page...
 			result = condor_write(peer_description(), _sock, cur, pagesize, _timeout);
@@ -383,7 +406,7 @@ ReliSock::put_bytes_nobuffer( const char *buffer, int length, int send_size )
         
         free(buf);
 
-	return i;
+	return length;
  error:
         dprintf(D_ALWAYS, "ReliSock::put_bytes_nobuffer: Send failed.\n");
 
@@ -425,6 +448,44 @@ ReliSock::get_bytes_nobuffer(char *buffer, int max_length, int receive_size)
                 goto error;
 	}
 
+	if (seal_packets()) {
+			// one sealed record, see put_bytes_nobuffer()
+		uint32_t net_len = 0;
+		int sealed_len;
+		if (condor_read(peer_description(), _sock, (char *)&net_len, 4, _timeout) != 4) {
+			dprintf(D_ALWAYS,
+				"ReliSock::get_bytes_nobuffer: Failed to receive file.\n");
+			goto error;
+		}
+		sealed_len = (int) ntohl(net_len);
+		if (sealed_len < Condor_Crypt_AESGCM::OVERHEAD ||
+			sealed_len - Condor_Crypt_AESGCM::OVERHEAD > length) {
+			dprintf(D_ALWAYS,
+				"ReliSock::get_bytes_nobuffer: data too large for buffer.\n");
+			goto error;
+		}
+		buf = (unsigned char *) malloc(sealed_len);
+		ASSERT(buf);
+		result = condor_read(peer_description(), _sock, (char *)buf, sealed_len, _timeout);
+		if (result != sealed_len) {
+			dprintf(D_ALWAYS,
+				"ReliSock::get_bytes_nobuffer: Failed to receive file.\n");
+			free(buf);
+			goto error;
+		}
+		if (!Condor_Crypt_AESGCM::open(crypto_state_, (unsigned char *)&net_len, 4,
+				buf, sealed_len, (unsigned char *)buffer)) {
+			dprintf(D_ALWAYS,
+				"ReliSock::get_bytes_nobuffer: Decryption failed.\n");
+			free(buf);
+			goto error;
+		}
+		free(buf);
+		result = sealed_len - Condor_Crypt_AESGCM::OVERHEAD;
+		_bytes_recvd += result;
+		return result;
+	}
+
 	result = condor_read(peer_description(), _sock, buffer, length, _timeout);
 
 	
@@ -586,7 +647,7 @@ ReliSock::put_bytes(const void *data, int sz)
         // Check to see if we need to encrypt
         // Okay, this is a bug! H.W. 9/25/2001
 
-        if (get_encryption()) {
+        if (get_encryption() && !seal_packets()) {
         	unsigned char * dta = NULL;
 			int l_out;
             if (!wrap((const unsigned char *)(data), sz, dta , l_out)) {
@@ -614,10 +675,11 @@ ReliSock::put_bytes_after_encryption(const void *dta, int sz) {
 
 	int		nw;
 	int 	tw = 0;
-	int		header_size = isOutgoing_Hash_on() ? MAX_HEADER_SIZE:NORMAL_HEADER_SIZE;
+	int		header_size = snd_msg.header_size();
+	int		trailer_size = snd_msg.trailer_size();
 	for(nw=0;;) {
 		
-		if (snd_msg.buf.full()) {
+		if (snd_msg.buf.num_free() <= trailer_size) {
 			int retval = snd_msg.snd_packet(peer_description(), _sock, FALSE, _timeout);
 			// This would block and the user asked us to work non-buffered - force the
 			// buffer to grow to hold the data for now.
@@ -634,7 +696,8 @@ ReliSock::put_bytes_after_encryption(const void *dta, int sz) {
 			snd_msg.buf.seek(header_size);
 		}
 		
-		if (dta && (tw = snd_msg.buf.put_max(&((const char *)dta)[nw], sz-nw)) < 0) {
+		if (dta && (tw = snd_msg.buf.put_max(&((const char *)dta)[nw],
+				MIN(sz-nw, snd_msg.buf.num_free() - trailer_size))) < 0) {
 			return -1;
 		}
 		
@@ -674,7 +737,7 @@ ReliSock::get_bytes(void *dta, int max_sz)
 	bytes = rcv_msg.buf.get(dta, max_sz);
 
 	if (bytes > 0) {
-            if (get_encryption()) {
+            if (get_encryption() && !seal_packets()) {
                 unwrap((unsigned char *) dta, bytes, data, length);
                 memcpy(dta, data, bytes);
                 free(data);
@@ -769,7 +832,7 @@ int ReliSock::RcvMsg::rcv_packet( char const *peer_description, SOCKET _sock, in
 		goto read_packet;
 	}
 
-	header_size = (mode_ != MD_OFF) ? MAX_HEADER_SIZE : NORMAL_HEADER_SIZE;
+	header_size = (mode_ != MD_OFF && !p_sock->seal_packets()) ? MAX_HEADER_SIZE : NORMAL_HEADER_SIZE;
 	header_filled = 0;
 
 	retval = condor_read(peer_description,_sock,hdr,header_size,_timeout, 0, p_sock->is_non_blocking());
@@ -870,8 +933,22 @@ read_packet:
 		}
 	}
 
+	if (p_sock->seal_packets()) {
+			// The header is authenticated too.  Rebuild it, since
+			// it is gone if the packet arrived in pieces.
+		char sealed_hdr[NORMAL_HEADER_SIZE];
+		sealed_hdr[0] = (char) m_end;
+		len_t = (int) htonl(m_tmp->num_used());
+		memcpy(&sealed_hdr[1], &len_t, 4);
+		if (!m_tmp->open(p_sock->crypto_state_, sealed_hdr, NORMAL_HEADER_SIZE)) {
+			delete m_tmp;
+			m_tmp = NULL;
+			dprintf(D_ALWAYS, "IO: Packet decryption failed!\n");
+			return FALSE;
+		}
+	}
         // Now, check MD
-        if (mode_ != MD_OFF) {
+        else if (mode_ != MD_OFF) {
             if (!m_tmp->verifyMD(cksum_ptr, mdChecker_)) {
                 delete m_tmp;
 		m_tmp = NULL;
@@ -969,15 +1046,27 @@ int ReliSock::SndMsg::snd_packet( char const *peer_description, int _sock, int e
 	char	        hdr[MAX_HEADER_SIZE];
 	int		len, header_size;
 	int		ns;
+	bool	sealed = p_sock->seal_packets();
 
-	header_size = (mode_ != MD_OFF) ? MAX_HEADER_SIZE : NORMAL_HEADER_SIZE;
+		// When sealed, the nonce after the header and the tag added
+		// by seal() are part of the packet, not the header.
+	header_size = (mode_ != MD_OFF && !sealed) ? MAX_HEADER_SIZE : NORMAL_HEADER_SIZE;
 	hdr[0] = (char) end;
 	ns = buf.num_used() - header_size;
+	if (sealed) {
+		ns += Condor_Crypt_AESGCM::TAG_SIZE;
+	}
 	len = (int) htonl(ns);
 
 	memcpy(&hdr[1], &len, 4);
 
-	if (mode_ != MD_OFF) {
+	if (sealed) {
+		if (!buf.seal(p_sock->crypto_state_, hdr, header_size)) {
+			dprintf(D_ALWAYS, "IO: Failed to encrypt packet\n");
+			return FALSE;
+		}
+	}
+	else if (mode_ != MD_OFF) {
 		if (!buf.computeMD(&hdr[5], mdChecker_)) {
 			dprintf(D_ALWAYS, "IO: Failed to compute Message Digest/MAC\n");
 			return FALSE;
@@ -1002,6 +1091,19 @@ int ReliSock::SndMsg::snd_packet( char const *peer_description, int _sock, int e
 	return TRUE;
 }
 
+int ReliSock::SndMsg::header_size() const
+{
+	if (p_sock->seal_packets()) {
+		return NORMAL_HEADER_SIZE + Condor_Crypt_AESGCM::NONCE_SIZE;
+	}
+	return (mode_ != MD_OFF) ? MAX_HEADER_SIZE : NORMAL_HEADER_SIZE;
+}
+
+int ReliSock::SndMsg::trailer_size() const
+{
+	return p_sock->seal_packets() ? Condor_Crypt_AESGCM::TAG_SIZE : 0;
+}
+
 bool ReliSock::SndMsg::init_MD(CONDOR_MD_MODE mode, KeyInfo * key)
 {
     if (!buf.empty()) {
@@ -51,6 +51,7 @@
 #ifdef HAVE_EXT_OPENSSL
 #include "condor_crypt_blowfish.h"
 #include "condor_crypt_3des.h"
+#include "condor_crypt_aesgcm.h"
 #include "condor_md.h"                // Message authentication stuff
 #endif
 
@@ -609,6 +610,7 @@ int Sock::assignSocket( condor_protocol proto, SOCKET sockd ) {
 
 		_sock = sockd;
 		_state = sock_assigned;
+		Selector::fd_opened(_sock);
 		_who.clear();
 		condor_getpeername( _sock, _who );
 
@@ -676,6 +678,7 @@ int Sock::assignSocket( condor_protocol proto, SOCKET sockd ) {
 	}
 	
 	_state = sock_assigned;
+	Selector::fd_opened(_sock);
 
 	// If we called timeout() previously on this object, then called close() on the
 	// socket, we are now left with _timeout set to some positive value __BUT__ the
@@ -1764,6 +1767,7 @@ Sock::cancel_connect()
 		// now close the underlying socket.  do not call Sock::close()
 		// here, because we do not want all the CEDAR socket state
 		// (like the _who data member) cleared.
+	Selector::fd_closing(_sock);
 	::closesocket(_sock);
 	_sock = INVALID_SOCKET;
 	_state = sock_virgin;
@@ -1866,6 +1870,7 @@ int Sock::close()
 	}
 
 	if ( _sock != INVALID_SOCKET ) {
+		Selector::fd_closing(_sock);
 		if (::closesocket(_sock) < 0) {
 			dprintf( D_NETWORK, "CLOSE FAILED %s %s fd=%d\n",
 						type() == Stream::reli_sock ? "TCP" : "UDP",
@@ -2083,11 +2088,17 @@ char * Sock::serializeCryptoInfo() const
     // NOTE:
     // currently we are not serializing the ivec.  this works because the
     // crypto state (including ivec) is reset to zero after inheriting.
+    // AES-GCM nonces must never be used twice, and the peer only accepts
+    // the ones that follow the last, so those are serialized after the key.
+    std::string aesgcm_state;
+    if (len > 0 && get_crypto_key().getProtocol() == CONDOR_AESGCM) {
+        Condor_Crypt_AESGCM::serializeState(crypto_state_, aesgcm_state);
+    }
 
     // here we want to save our state into a buffer
     char * outbuf = NULL;
     if (len > 0) {
-        int buflen = len*2+32;
+        int buflen = len*2+32+aesgcm_state.length();
         outbuf = new char[buflen];
         sprintf(outbuf,"%d*%d*%d*", len*2, (int)get_crypto_key().getProtocol(),
                 (int)get_encryption());
@@ -2097,6 +2108,7 @@ char * Sock::serializeCryptoInfo() const
         for (int i=0; i < len; i++, kserial++, ptr+=2) {
             sprintf(ptr, "%02X", *kserial);
         }
+        strcpy(ptr, aesgcm_state.c_str());
     }
     else {
         outbuf = new char[2];
@@ -2192,6 +2204,10 @@ const char * Sock::serializeCryptoInfo(const char * buf)
         KeyInfo k((unsigned char *)kserial, len, (Protocol)protocol);
         set_crypto_key(encryption_mode==1, &k, 0);
         free(kserial);
+        if (protocol == CONDOR_AESGCM && *ptmp == ':') {
+            ptmp = Condor_Crypt_AESGCM::deserializeState(crypto_state_, ptmp);
+            ASSERT( ptmp );
+        }
 		ASSERT( *ptmp == '*' );
         // Now, skip over this one
         ptmp++;
@@ -2898,8 +2914,10 @@ Sock::initialize_crypto(KeyInfo * key)
 	crypto_mode_ = false;
 
     // Will try to do a throw/catch later on
+    Protocol proto = CONDOR_NO_PROTOCOL;
     if (key) {
-        switch (key->getProtocol()) 
+        proto = key->getProtocol();
+        switch (proto)
         {
 #ifdef HAVE_EXT_OPENSSL
         case CONDOR_BLOWFISH :
@@ -2910,6 +2928,19 @@ Sock::initialize_crypto(KeyInfo * key)
 			setCryptoMethodUsed("3DES");
             crypto_ = new Condor_Crypt_3des();
             break;
+        case CONDOR_AESGCM:
+			setCryptoMethodUsed("AES");
+			if (type() == Stream::safe_sock) {
+					// AES-GCM needs whole messages, which SafeSock
+					// does not encrypt, so UDP messages of an AES
+					// session are encrypted with Blowfish and the
+					// same key.  Both ends make the same choice.
+				proto = CONDOR_BLOWFISH;
+				crypto_ = new Condor_Crypt_Blowfish();
+			} else {
+				crypto_ = new Condor_Crypt_AESGCM();
+			}
+            break;
 #endif
         default:
             break;
@@ -2918,7 +2949,7 @@ Sock::initialize_crypto(KeyInfo * key)
 
     // if we made an object, make a state object as well
     if(crypto_) {
-        crypto_state_ = new Condor_Crypto_State(key->getProtocol(), *key);
+        crypto_state_ = new Condor_Crypto_State(proto, *key);
     }
 
     return (crypto_ != 0);
@@ -0,0 +1,334 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Checks of the CEDAR crypto methods, and their throughput.  AES-GCM must
+// turn away messages that were changed, replayed, sent back to us or
+// spliced in from another copy of the session key, and must carry on with
+// the same nonces after its state is handed to another process.  Messages
+// and files are sent over a pair of ReliSocks that seal their packets.
+//
+// Then each method encrypts and decrypts 64k blocks, the size
+// ReliSock::put_file() sends.  For the stream ciphers, the MAC that gives
+// them integrity is computed too, since AES-GCM does both in one pass.  By
+// default only 1MB goes through each method, which checks the round trip;
+// to measure the throughput, give a larger size, e.g. -mb 256.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "subsystem_info.h"
+#include "condor_crypt_3des.h"
+#include "condor_crypt_blowfish.h"
+#include "condor_crypt_aesgcm.h"
+#include "condor_md.h"
+#include "reli_sock.h"
+#include "test_check.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+static double
+now_usec()
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+static Condor_Crypt_Base *
+make_crypt( Protocol proto )
+{
+	switch ( proto ) {
+	case CONDOR_BLOWFISH: return new Condor_Crypt_Blowfish();
+	case CONDOR_3DES: return new Condor_Crypt_3des();
+	case CONDOR_AESGCM: return new Condor_Crypt_AESGCM();
+	default: return NULL;
+	}
+}
+
+// Returns MB/s for encrypting and then decrypting total_mb, or -1 if the
+// data did not survive the round trip.
+static double
+time_method( Protocol proto, bool with_mac, KeyInfo &key, int block_size, int total_mb )
+{
+	Condor_Crypt_Base *crypt = make_crypt( proto );
+	Condor_Crypto_State sender( proto, key );
+	Condor_Crypto_State receiver( proto, key );
+
+	std::vector<unsigned char> block( block_size );
+	for ( int i = 0; i < block_size; i++ ) {
+		block[i] = (unsigned char)( i * 7 );
+	}
+
+	long long blocks = (long long)total_mb * 1024 * 1024 / block_size;
+	bool ok = true;
+	double begin = now_usec();
+	for ( long long b = 0; b < blocks && ok; b++ ) {
+		unsigned char *sealed = NULL, *opened = NULL;
+		int sealed_len = 0, opened_len = 0;
+
+		ok = crypt->encrypt( &sender, &block[0], block_size, sealed, sealed_len );
+		if ( ok && with_mac ) {
+			unsigned char *mac = Condor_MD_MAC::computeOnce( sealed, sealed_len, &key );
+			ok = Condor_MD_MAC::verifyMD( mac, sealed, sealed_len, &key );
+			free( mac );
+		}
+		ok = ok && crypt->decrypt( &receiver, sealed, sealed_len, opened, opened_len );
+		ok = ok && opened_len == block_size && memcmp( opened, &block[0], block_size ) == 0;
+		free( sealed );
+		free( opened );
+
+			// the stream ciphers start over with each message
+		sender.reset();
+		receiver.reset();
+	}
+	double elapsed = now_usec() - begin;
+	delete crypt;
+
+	if ( !ok ) {
+		return -1;
+	}
+	return (double)blocks * block_size / ( 1024 * 1024 ) / ( elapsed / 1e6 );
+}
+
+static void
+check_aesgcm( KeyInfo &key )
+{
+	Condor_Crypto_State sender( CONDOR_AESGCM, key );
+	Condor_Crypto_State receiver( CONDOR_AESGCM, key );
+	Condor_Crypto_State other_sender( CONDOR_AESGCM, key );
+	const unsigned char hdr[] = "header";
+	const unsigned char msg[] = "the quick brown fox";
+	const int msg_len = sizeof(msg);
+	unsigned char sealed[3][sizeof(msg) + Condor_Crypt_AESGCM::OVERHEAD];
+	unsigned char other[sizeof(msg) + Condor_Crypt_AESGCM::OVERHEAD];
+	unsigned char opened[sizeof(msg)];
+	const int sealed_len = sizeof(sealed[0]);
+
+	for ( int i = 0; i < 3; i++ ) {
+		if ( !Condor_Crypt_AESGCM::seal( &sender, hdr, sizeof(hdr), msg, msg_len, sealed[i] ) ) {
+			check_failed( "seal() failed" );
+			return;
+		}
+	}
+	if ( !Condor_Crypt_AESGCM::seal( &other_sender, hdr, sizeof(hdr), msg, msg_len, other ) ) {
+		check_failed( "seal() failed" );
+		return;
+	}
+
+	sealed[0][Condor_Crypt_AESGCM::NONCE_SIZE] ^= 1;
+	check( "open() rejects a changed message",
+	       !Condor_Crypt_AESGCM::open( &receiver, hdr, sizeof(hdr), sealed[0], sealed_len, opened ) );
+	sealed[0][Condor_Crypt_AESGCM::NONCE_SIZE] ^= 1;
+	const unsigned char other_hdr[] = "HEADER";
+	check( "open() rejects a changed header",
+	       !Condor_Crypt_AESGCM::open( &receiver, other_hdr, sizeof(other_hdr), sealed[0], sealed_len, opened ) );
+
+	check( "open() rejects a message out of order",
+	       !Condor_Crypt_AESGCM::open( &receiver, hdr, sizeof(hdr), sealed[1], sealed_len, opened ) );
+	for ( int i = 0; i < 2; i++ ) {
+		std::string name;
+		formatstr( name, "open() accepts message %d in order", i );
+		check( name, Condor_Crypt_AESGCM::open( &receiver, hdr, sizeof(hdr), sealed[i], sealed_len, opened ) &&
+		             memcmp( opened, msg, msg_len ) == 0 );
+	}
+
+	check( "open() rejects a replayed message",
+	       !Condor_Crypt_AESGCM::open( &receiver, hdr, sizeof(hdr), sealed[1], sealed_len, opened ) );
+	check( "open() rejects a reflected message",
+	       !Condor_Crypt_AESGCM::open( &sender, hdr, sizeof(hdr), sealed[0], sealed_len, opened ) );
+
+		// the first message of another copy of the key, which a new
+		// receiver would accept, can't be spliced into this conversation
+	check( "open() rejects the first message of another sender mid-conversation",
+	       !Condor_Crypt_AESGCM::open( &receiver, hdr, sizeof(hdr), other, sealed_len, opened ) );
+	check( "open() still accepts the next message of the first sender",
+	       Condor_Crypt_AESGCM::open( &receiver, hdr, sizeof(hdr), sealed[2], sealed_len, opened ) );
+	Condor_Crypto_State new_receiver( CONDOR_AESGCM, key );
+	check( "open() accepts the first message of another sender on a new conversation",
+	       Condor_Crypt_AESGCM::open( &new_receiver, hdr, sizeof(hdr), other, sealed_len, opened ) );
+}
+
+// Hands the AES-GCM state of both ends to new copies of the key, the way
+// Sock::serializeCryptoInfo() does when a socket is passed to another
+// process, and checks that the conversation carries on.
+static void
+check_aesgcm_handoff( KeyInfo &key )
+{
+	Condor_Crypto_State sender( CONDOR_AESGCM, key );
+	Condor_Crypto_State receiver( CONDOR_AESGCM, key );
+	const unsigned char msg[] = "handed over";
+	const int msg_len = sizeof(msg);
+	unsigned char sealed[sizeof(msg) + Condor_Crypt_AESGCM::OVERHEAD];
+	unsigned char opened[sizeof(msg)];
+	const int sealed_len = sizeof(sealed);
+
+	bool ok = Condor_Crypt_AESGCM::seal( &sender, NULL, 0, msg, msg_len, sealed ) &&
+	          Condor_Crypt_AESGCM::open( &receiver, NULL, 0, sealed, sealed_len, opened );
+
+	std::string sender_state, receiver_state;
+	Condor_Crypt_AESGCM::serializeState( &sender, sender_state );
+	Condor_Crypt_AESGCM::serializeState( &receiver, receiver_state );
+	Condor_Crypto_State new_sender( CONDOR_AESGCM, key );
+	Condor_Crypto_State new_receiver( CONDOR_AESGCM, key );
+	const char *sender_end = Condor_Crypt_AESGCM::deserializeState( &new_sender, sender_state.c_str() );
+	const char *receiver_end = Condor_Crypt_AESGCM::deserializeState( &new_receiver, receiver_state.c_str() );
+	check( "the AES-GCM state is read back from what was written",
+	       ok && sender_end && *sender_end == '\0' && receiver_end && *receiver_end == '\0' );
+
+	check( "the handed over receiver accepts the next message of the old sender",
+	       Condor_Crypt_AESGCM::seal( &sender, NULL, 0, msg, msg_len, sealed ) &&
+	       Condor_Crypt_AESGCM::open( &new_receiver, NULL, 0, sealed, sealed_len, opened ) );
+	check( "the handed over sender is accepted by the old receiver",
+	       Condor_Crypt_AESGCM::seal( &new_sender, NULL, 0, msg, msg_len, sealed ) &&
+	       Condor_Crypt_AESGCM::open( &receiver, NULL, 0, sealed, sealed_len, opened ) );
+	check( "a malformed AES-GCM state is rejected",
+	       Condor_Crypt_AESGCM::deserializeState( &new_sender, ":00:1" ) == NULL );
+}
+
+// Sends messages both ways, and a file, over a pair of ReliSocks that
+// seal their packets with AES-GCM.
+static void
+check_relisock( KeyInfo &key )
+{
+	ReliSock writer, reader;
+	if ( !writer.connect_socketpair( reader ) ) {
+		check_failed( "cannot connect a socket pair" );
+		return;
+	}
+	writer.timeout( 20 );
+	reader.timeout( 20 );
+	check( "AES-GCM is enabled on both sockets",
+	       writer.set_crypto_key( true, &key ) && reader.set_crypto_key( true, &key ) &&
+	       writer.get_encryption() && reader.get_encryption() );
+
+		// more than one packet's worth, in both directions
+	std::string sent( 300000, 'x' ), received;
+	for ( size_t i = 0; i < sent.size(); i++ ) {
+		sent[i] = (char)( 'a' + i % 26 );
+	}
+	writer.encode();
+	bool ok = writer.code( sent ) && writer.end_of_message();
+	reader.decode();
+	ok = ok && reader.code( received ) && reader.end_of_message();
+	check( "a sealed message arrives intact", ok && received == sent );
+
+	int reply = 0;
+	reader.encode();
+	ok = reader.put( 42 ) && reader.end_of_message();
+	writer.decode();
+	ok = ok && writer.get( reply ) && writer.end_of_message();
+	check( "a sealed reply arrives intact", ok && reply == 42 );
+
+	const char *src = "test_crypto.src";
+	const char *dst = "test_crypto.dst";
+	std::string data( 3 * 1024 * 1024 + 17, '\0' );
+	for ( size_t i = 0; i < data.size(); i++ ) {
+		data[i] = (char)( i * 131 );
+	}
+	if ( !write_test_file( src, data ) ) {
+		check_failed( "cannot write %s", src );
+		return;
+	}
+
+		// the socket buffers hold less than the file, so it is sent
+		// by a child process
+	fflush( stdout );
+	pid_t pid = fork();
+	if ( pid == 0 ) {
+		filesize_t size = 0;
+		writer.encode();
+		int rc = writer.put_file( &size, src );
+		_exit( rc == 0 && writer.end_of_message() && size == (filesize_t)data.size() ? 0 : 1 );
+	}
+	filesize_t size = 0;
+	reader.decode();
+	ok = reader.get_file( &size, dst ) == 0 && reader.end_of_message();
+	int status = -1;
+	waitpid( pid, &status, 0 );
+	check( "put_file() with AES-GCM sends the file intact",
+	       ok && WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+	       size == (filesize_t)data.size() && read_test_file( dst ) == data );
+	check( "put_file() with AES-GCM does not send the file in the clear",
+	       !writer.file_data_in_clear() && !reader.last_file_zero_copy() );
+	unlink( src );
+	unlink( dst );
+}
+
+int
+main( int argc, char *argv[] )
+{
+	int total_mb = 1;
+	int block_size = 65536;
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( strcmp( argv[i], "-mb" ) == 0 && i + 1 < argc ) {
+			total_mb = atoi( argv[++i] );
+		} else if ( strcmp( argv[i], "-block" ) == 0 && i + 1 < argc ) {
+			block_size = atoi( argv[++i] );
+		} else {
+			fprintf( stderr, "usage: %s [-mb <megabytes>] [-block <bytes>]\n", argv[0] );
+			return 1;
+		}
+	}
+	if ( total_mb < 1 ) {
+		total_mb = 1;
+	}
+	if ( block_size < 1 ) {
+		block_size = 1;
+	}
+
+		// the socket pair is bound to the loopback interface of the
+		// protocols that the configuration enables
+	set_mySubSystem( "TEST_CRYPTO", SUBSYSTEM_TYPE_TOOL );
+	config();
+
+	unsigned char *key_data = Condor_Crypt_Base::randomKey( 24 );
+	KeyInfo key( key_data, 24, CONDOR_AESGCM );
+	free( key_data );
+
+	check_aesgcm( key );
+	check_aesgcm_handoff( key );
+	check_relisock( key );
+
+	struct {
+		const char *name;
+		Protocol proto;
+		bool with_mac;
+	} methods[] = {
+		{ "BLOWFISH", CONDOR_BLOWFISH, false },
+		{ "BLOWFISH+MAC", CONDOR_BLOWFISH, true },
+		{ "3DES", CONDOR_3DES, false },
+		{ "3DES+MAC", CONDOR_3DES, true },
+		{ "AES-GCM", CONDOR_AESGCM, false },
+	};
+
+	printf( "%-14s %12s\n", "method", "MB/s" );
+	for ( size_t m = 0; m < sizeof(methods) / sizeof(methods[0]); m++ ) {
+		double mbs = time_method( methods[m].proto, methods[m].with_mac, key, block_size, total_mb );
+		if ( mbs < 0 ) {
+			check_failed( "%s: data did not survive the round trip", methods[m].name );
+			continue;
+		}
+		printf( "%-14s %12.1f\n", methods[m].name, mbs );
+	}
+
+	return check_results();
+}
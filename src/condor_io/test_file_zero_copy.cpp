@@ -0,0 +1,155 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for ReliSock::put_file() and get_file() without encryption, which
+// on Linux move the data with sendfile() and splice() (see
+// FILE_TRANSFER_ZERO_COPY).  Files larger than the socket buffers are sent
+// over a pair of ReliSocks, from the start and from an offset, and must
+// arrive intact.  Then each side is made to fall back to the read()/write()
+// loop: with the knob turned off, with a file that is open for appending,
+// which splice() won't write to, and with a socket that sendfile() won't
+// write to.  last_file_zero_copy() must report which way each side went.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "subsystem_info.h"
+#include "reli_sock.h"
+#include "test_check.h"
+
+#include <stdio.h>
+#include <string>
+
+static const char *src_file = "test_file_zero_copy.src";
+static const char *dst_file = "test_file_zero_copy.dst";
+
+enum {
+	SENDER_APPEND_SOCKET = 1, // O_APPEND on the sending socket
+	RECEIVER_APPEND_FILE = 2, // the received file is open for appending
+};
+
+// Sends src_file, from offset on, to dst_file over a new pair of
+// ReliSocks.  The socket buffers hold less than the file, so it is sent
+// by a child process, whose exit status says whether its put_file()
+// worked and whether it used sendfile().
+static void
+check_transfer( const char *name, const std::string &data, filesize_t offset, int flags,
+                bool expect_send_zero_copy, bool expect_receive_zero_copy )
+{
+	ReliSock writer, reader;
+	if ( !writer.connect_socketpair( reader ) ) {
+		check_failed( "%s: cannot connect a socket pair", name );
+		return;
+	}
+	writer.timeout( 20 );
+	reader.timeout( 20 );
+
+	fflush( stdout );
+	pid_t pid = fork();
+	if ( pid == 0 ) {
+		if ( flags & SENDER_APPEND_SOCKET ) {
+			int fl = fcntl( writer.get_file_desc(), F_GETFL );
+			fcntl( writer.get_file_desc(), F_SETFL, fl | O_APPEND );
+		}
+		int fd = safe_open_wrapper_follow( src_file, O_RDONLY );
+		filesize_t size = 0;
+		writer.encode();
+			// put_file() gives the size of the whole file
+		if ( fd < 0 || writer.put_file( &size, fd, offset ) != 0 || !writer.end_of_message() ||
+		     size != (filesize_t)data.size() )
+		{
+			_exit( 1 );
+		}
+		_exit( writer.last_file_zero_copy() ? 0 : 2 );
+	}
+	if ( pid < 0 ) {
+		check_failed( "%s: fork, errno = %d", name, errno );
+		return;
+	}
+
+	int open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+	if ( flags & RECEIVER_APPEND_FILE ) {
+		open_flags |= O_APPEND;
+	}
+	int fd = safe_open_wrapper_follow( dst_file, open_flags, 0644 );
+	filesize_t size = 0;
+	reader.decode();
+	bool received = fd >= 0 && reader.get_file( &size, fd ) == 0 && reader.end_of_message();
+	bool receive_zero_copy = reader.last_file_zero_copy();
+	if ( fd >= 0 ) {
+		close( fd );
+	}
+
+	int status = -1;
+	waitpid( pid, &status, 0 );
+	int sent = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+	if ( sent != 0 && sent != 2 ) {
+		check_failed( "%s: put_file() failed (status %d)", name, status );
+	} else if ( !received || size != (filesize_t)data.size() - offset ||
+	            read_test_file( dst_file ) != data.substr( offset ) )
+	{
+		check_failed( "%s: the file did not arrive intact, %lld of %lld bytes",
+			name, (long long)size, (long long)( data.size() - offset ) );
+	} else if ( (sent == 0) != expect_send_zero_copy ) {
+		check_failed( "%s: put_file() %s sendfile()", name, sent == 0 ? "used" : "did not use" );
+	} else if ( receive_zero_copy != expect_receive_zero_copy ) {
+		check_failed( "%s: get_file() %s splice()", name, receive_zero_copy ? "used" : "did not use" );
+	} else {
+		check_passed( "%s", name );
+	}
+	unlink( dst_file );
+}
+
+int
+main( int /*argc*/, char ** /*argv*/ )
+{
+		// the socket pair is bound to the loopback interface of the
+		// protocols that the configuration enables
+	set_mySubSystem( "TEST_FILE_ZERO_COPY", SUBSYSTEM_TYPE_TOOL );
+	config();
+
+	std::string data( 5 * 1024 * 1024 + 17, '\0' );
+	for ( size_t i = 0; i < data.size(); i++ ) {
+		data[i] = (char)( i * 131 + i / 4096 );
+	}
+	if ( !write_test_file( src_file, data ) ) {
+		check_failed( "cannot write %s", src_file );
+		return check_results();
+	}
+
+#if defined(LINUX)
+	bool zero_copy = true;
+#else
+	bool zero_copy = false;
+#endif
+	check_transfer( "sendfile() and splice()", data, 0, 0, zero_copy, zero_copy );
+	check_transfer( "sendfile() from an offset", data, 1000001, 0, zero_copy, zero_copy );
+	check_transfer( "a file open for appending is written with write()",
+		data, 0, RECEIVER_APPEND_FILE, zero_copy, false );
+	check_transfer( "a socket sendfile() can't write to is written with send()",
+		data, 0, SENDER_APPEND_SOCKET, false, zero_copy );
+
+	param_insert( "FILE_TRANSFER_ZERO_COPY", "false" );
+	check_transfer( "FILE_TRANSFER_ZERO_COPY = false", data, 0, 0, false, false );
+
+	unlink( src_file );
+
+	return check_results();
+}
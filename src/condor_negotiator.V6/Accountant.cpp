@@ -83,6 +83,7 @@ Accountant::Accountant():
   DefaultPriorityFactor = 1e3;
   HalfLifePeriod = 1.0f;
   LastUpdateTime = 0;
+  CycleNondurableLevel = -1;
   MaxAcctLogSize = 1000000;
   NiceUserPriorityFactor = 1e10;
   RemoteUserPriorityFactor = 1e7;
@@ -194,6 +195,7 @@ void Accountant::Initialize(GroupEntry* root_group)
     AcctLog=new ClassAdLog<std::string,ClassAd*>(LogFileName.c_str());
     dprintf(D_ACCOUNTANT,"Accountant::Initialize - LogFileName=%s\n",
 					LogFileName.c_str());
+    BuildIndexes();
   }
 
   // get last update time
@@ -204,8 +206,6 @@ void Accountant::Initialize(GroupEntry* root_group)
   // if at startup, do a sanity check to make certain number of resource
   // records for a user and what the user record says jives
   if ( first_time ) {
-	  std::string HK;
-	  ClassAd* ad;
 	  StringList users;
 	  int resources_used, resources_used_really;
 	  int total_overestimated_resources = 0;
@@ -219,14 +219,8 @@ void Accountant::Initialize(GroupEntry* root_group)
 	  dprintf(D_ACCOUNTANT,"Sanity check on number of resources per user\n");
 
 		// first find all the users
-	  AcctLog->table.startIterations();
-	  while (AcctLog->table.iterate(HK,ad)) {
-		char const *key = HK.c_str();
-			// skip records that are not customer records...
-		if (strncmp(CustomerRecord.c_str(),key,CustomerRecord.length())) continue;
-		char const *thisUser = &(key[CustomerRecord.length()]);
-			// if we made it here, append to our list of users
-		users.append( thisUser );
+	  for (set<string>::iterator it = CustomerNames.begin(); it != CustomerNames.end(); ++it) {
+		users.append( it->c_str() );
 	  }
 		// ok, now StringList users has all the users.  for each user,
 		// compare what the customer record claims for usage -vs- actual
@@ -488,13 +482,9 @@ void Accountant::ResetAllUsage()
 {
   dprintf(D_ACCOUNTANT,"Accountant::ResetAllUsage\n");
   time_t T=time(0);
-  std::string HK;
-  ClassAd* ad;
 
-  AcctLog->table.startIterations();
-  while (AcctLog->table.iterate(HK,ad)) {
-	char const *key = HK.c_str();
-	if (strncmp(CustomerRecord.c_str(),key,CustomerRecord.length())) continue;
+  for (set<string>::iterator it = CustomerNames.begin(); it != CustomerNames.end(); ++it) {
+	string key = CustomerRecord + *it;
 	AcctLog->BeginTransaction();
     SetAttributeFloat(key,AccumulatedUsageAttr,0);
     SetAttributeFloat(key,WeightedAccumulatedUsageAttr,0);
@@ -875,17 +865,8 @@ void Accountant::DisplayLog()
 
 void Accountant::DisplayMatches()
 {
-  std::string HK;
-  ClassAd* ad;
-  string ResourceName;
-  AcctLog->table.startIterations();
-  while (AcctLog->table.iterate(HK,ad)) {
-	char const *key = HK.c_str();
-    if (strncmp(ResourceRecord.c_str(),key,ResourceRecord.length())) continue;
-    ResourceName=key+ResourceRecord.length();
-    std::string RemoteUser;
-    ad->LookupString(RemoteUserAttr,RemoteUser);
-    printf("Customer=%s , Resource=%s\n",RemoteUser.c_str(),ResourceName.c_str());
+  for (map<string, string>::iterator it = ResourceUsers.begin(); it != ResourceUsers.end(); ++it) {
+    printf("Customer=%s , Resource=%s\n",it->second.c_str(),it->first.c_str());
   }
 }
 
@@ -913,7 +894,6 @@ void Accountant::UpdatePriorities()
 
   dprintf(D_ACCOUNTANT,"(ACCOUNTANT) Updating priorities - AgingFactor=%8.3f , TimePassed=%d\n",AgingFactor,TimePassed);
 
-  std::string HK;
   ClassAd* ad;
 
 	  // Each iteration of the loop should be atomic for consistency,
@@ -921,11 +901,12 @@ void Accountant::UpdatePriorities()
 	  // whole loop in one transaction for efficiency.
   AcctLog->BeginTransaction();
 
-  AcctLog->table.startIterations();
-  while (AcctLog->table.iterate(HK,ad)) {
-	char const *key = HK.c_str();
-	if (strncmp(CustomerRecord.c_str(),key,CustomerRecord.length())) continue;
-		UpdateOnePriority(T, TimePassed, AgingFactor, key, ad);
+	  // UpdateOnePriority may delete the record, and so change the index
+  vector<string> customers(CustomerNames.begin(), CustomerNames.end());
+  for (vector<string>::iterator it = customers.begin(); it != customers.end(); ++it) {
+	string key = CustomerRecord + *it;
+	if (AcctLog->table.lookup(key,ad) == -1) continue;
+	UpdateOnePriority(T, TimePassed, AgingFactor, key.c_str(), ad);
   }
 
   AcctLog->CommitTransaction();
@@ -1070,13 +1051,13 @@ void Accountant::CheckMatches(ClassAdListDoesNotDeleteAds& ResourceList)
   dprintf(D_ACCOUNTANT,"(Accountant) Checking Matches\n");
 
   ClassAd* ResourceAd;
-  std::string HK;
-  ClassAd* ad;
   string ResourceName;
-  std::string CustomerName;
 
-	  // Create a hash table for speedier lookups of Resource ads.
+	  // Create a hash table for speedier lookups of Resource ads,
+	  // and remember the name of each so we only build it once.
   HashTable<string,ClassAd *> resource_hash(hashFunction);
+  vector<std::pair<string, ClassAd*> > resources;
+  resources.reserve(ResourceList.MyLength());
   ResourceList.Open();
   while ((ResourceAd=ResourceList.Next())!=NULL) {
     ResourceName = GetResourceName(ResourceAd);
@@ -1085,22 +1066,20 @@ void Accountant::CheckMatches(ClassAdListDoesNotDeleteAds& ResourceList)
       dprintf(D_ALWAYS, "WARNING: found duplicate key: %s\n", ResourceName.c_str());
       dPrintAd(D_FULLDEBUG, *ResourceAd);
     }
+    resources.push_back(std::make_pair(ResourceName, ResourceAd));
   }
   ResourceList.Close();
 
-  // Remove matches that were broken
-  AcctLog->table.startIterations();
-  while (AcctLog->table.iterate(HK,ad)) {
-    char const *key = HK.c_str();
-    if (strncmp(ResourceRecord.c_str(),key,ResourceRecord.length())) continue;
-    ResourceName=key+ResourceRecord.length();
+  // Remove matches that were broken, RemoveMatch changes the index so walk a copy of it
+  vector<std::pair<string, string> > matches(ResourceUsers.begin(), ResourceUsers.end());
+  for (vector<std::pair<string, string> >::iterator it = matches.begin(); it != matches.end(); ++it) {
+    ResourceName = it->first;
+    const string & CustomerName = it->second;
     if( resource_hash.lookup(ResourceName,ResourceAd) < 0 ) {
       dprintf(D_ACCOUNTANT,"Resource %s class-ad wasn't found in the resource list.\n",ResourceName.c_str());
       RemoveMatch(ResourceName);
     }
 	else {
-		// Here we need to figure out the CustomerName.
-      ad->LookupString(RemoteUserAttr,CustomerName);
       if (!CheckClaimedOrMatched(ResourceAd, CustomerName)) {
         dprintf(D_ACCOUNTANT,"Resource %s was not claimed by %s - removing match\n",ResourceName.c_str(),CustomerName.c_str());
         RemoveMatch(ResourceName);
@@ -1108,13 +1087,17 @@ void Accountant::CheckMatches(ClassAdListDoesNotDeleteAds& ResourceList)
     }
   }
 
-  // Scan startd ads and add matches that are not registered
-  ResourceList.Open();
-  while ((ResourceAd=ResourceList.Next())!=NULL) {
+  // Scan startd ads and add matches that are not registered,
+  // most claims were registered on an earlier cycle, so check for those first.
+  for (vector<std::pair<string, ClassAd*> >::iterator it = resources.begin(); it != resources.end(); ++it) {
     string cust_name;
-    if (IsClaimed(ResourceAd, cust_name)) AddMatch(cust_name, ResourceAd);
+    if ( ! IsClaimed(it->second, cust_name)) continue;
+    map<string, string>::iterator match = ResourceUsers.find(it->first);
+    if (match != ResourceUsers.end() && match->second == cust_name && ! it->second->LookupExpr(CP_MATCH_COST)) {
+      continue;
+    }
+    AddMatch(cust_name, it->second);
   }
-  ResourceList.Close();
 
 	  // Recalculate limits from the set of resources that are reporting
   LoadLimits(ResourceList);
@@ -1129,8 +1112,6 @@ void Accountant::CheckMatches(ClassAdListDoesNotDeleteAds& ResourceList)
 ClassAd* Accountant::ReportState(const string& CustomerName) {
     dprintf(D_ACCOUNTANT,"Reporting State for customer %s\n",CustomerName.c_str());
 
-    std::string HK;
-    ClassAd* ResourceAd;
     int StartTime;
 
     ClassAd* ad = new ClassAd();
@@ -1141,30 +1122,29 @@ ClassAd* Accountant::ReportState(const string& CustomerName) {
     if (isGroup && (cgrp != CustomerName)) return ad;
 
     int ResourceNum=1;
-    AcctLog->table.startIterations();
-    while (AcctLog->table.iterate(HK,ResourceAd)) {
-        if (strncmp(ResourceRecord.c_str(), HK.c_str(), ResourceRecord.length())) continue;
-
-        std::string rname;
-        if (ResourceAd->LookupString(RemoteUserAttr, rname)==0) continue;
-
+    for (map<string, set<string> >::iterator cit = CustomerResources.begin(); cit != CustomerResources.end(); ++cit) {
+        const string & rname = cit->first;
         if (isGroup) {
             string rgrp = GetAssignedGroup(rname)->name;
             if (cgrp != rgrp) continue;
-        } else {
-            // customername is a traditional submitter: group.username@host
-            if (CustomerName != rname) continue;
+            ResourceNum += cit->second.size();
+            continue;
+        }
+
+        // customername is a traditional submitter: group.username@host
+        if (CustomerName != rname) continue;
 
+        for (set<string>::iterator rit = cit->second.begin(); rit != cit->second.end(); ++rit) {
             string tmp;
             formatstr(tmp, "Name%d", ResourceNum);
-            ad->Assign(tmp, HK.c_str()+ResourceRecord.length());
+            ad->Assign(tmp, *rit);
 
-            if (ResourceAd->LookupInteger(StartTimeAttr,StartTime)==0) StartTime=0;
+            if (!GetAttributeInt(ResourceRecord+*rit,StartTimeAttr,StartTime)) StartTime=0;
             formatstr(tmp, "StartTime%d", ResourceNum);
             ad->Assign(tmp, StartTime);
-        }
 
-        ResourceNum++;
+            ResourceNum++;
+        }
     }
 
     return ad;
@@ -1182,25 +1162,20 @@ void Accountant::CheckResources(const string& CustomerName, int& NumResources, f
     // This is a defunct group:
     if (isGroup && (cgrp != CustomerName)) return;
 
-    std::string HK;
-    ClassAd* ResourceAd;
-    AcctLog->table.startIterations();
-    while (AcctLog->table.iterate(HK, ResourceAd)) {
-        if (strncmp(ResourceRecord.c_str(), HK.c_str(), ResourceRecord.length())) continue;
-
-        string rname;
-        if (ResourceAd->LookupString(RemoteUserAttr, rname) == 0) continue;
-
+    for (map<string, set<string> >::iterator cit = CustomerResources.begin(); cit != CustomerResources.end(); ++cit) {
+        const string & rname = cit->first;
         if (isGroup) {
             if (cgrp != GetAssignedGroup(rname)->name) continue;
         } else {
             if (CustomerName != rname) continue;
         }
 
-        NumResources += 1;
-        float SlotWeight = 1.0;
-        ResourceAd->LookupFloat(SlotWeightAttr, SlotWeight);
-        NumResourcesRW += SlotWeight;
+        for (set<string>::iterator rit = cit->second.begin(); rit != cit->second.end(); ++rit) {
+            NumResources += 1;
+            float SlotWeight = 1.0;
+            GetAttributeFloat(ResourceRecord+*rit, SlotWeightAttr, SlotWeight);
+            NumResourcesRW += SlotWeight;
+        }
     }
 }
 
@@ -1233,12 +1208,10 @@ ClassAd* Accountant::ReportState(bool rollup) {
     // attributes up the group hierarchy
     ReportGroups(hgq_root_group, ad, rollup, gnmap);
 
-    std::string HK;
     ClassAd* CustomerAd = NULL;
-    AcctLog->table.startIterations();
-    while (AcctLog->table.iterate(HK,CustomerAd)) {
-        if (strncmp(CustomerRecord.c_str(), HK.c_str(), CustomerRecord.length())) continue;
-        string CustomerName = HK.c_str()+CustomerRecord.length();
+    for (set<string>::iterator it = CustomerNames.begin(); it != CustomerNames.end(); ++it) {
+        const string & CustomerName = *it;
+        if (AcctLog->table.lookup(CustomerRecord+CustomerName, CustomerAd) == -1) continue;
 
         bool isGroup=false;
         GroupEntry* cgrp = GetAssignedGroup(CustomerName, isGroup);
@@ -1623,6 +1596,86 @@ int Accountant::CheckClaimedOrMatched(ClassAd* ResourceAd, const string& Custome
 
 }
 
+//------------------------------------------------------------------
+// Batch the log writes of a negotiation cycle
+//------------------------------------------------------------------
+
+void Accountant::BeginNegotiationCycle()
+{
+  if (CycleNondurableLevel < 0) {
+    CycleNondurableLevel = AcctLog->IncNondurableCommitLevel();
+  }
+}
+
+void Accountant::EndNegotiationCycle()
+{
+  if (CycleNondurableLevel < 0) return;
+  AcctLog->DecNondurableCommitLevel(CycleNondurableLevel);
+  CycleNondurableLevel = -1;
+  AcctLog->ForceLog();
+}
+
+//------------------------------------------------------------------
+// Maintain the indexes of the customer and resource records
+//------------------------------------------------------------------
+
+void Accountant::BuildIndexes()
+{
+  CustomerNames.clear();
+  ResourceUsers.clear();
+  CustomerResources.clear();
+
+  std::string HK;
+  ClassAd* ad;
+  AcctLog->table.startIterations();
+  while (AcctLog->table.iterate(HK,ad)) {
+    IndexRecord(HK);
+    std::string RemoteUser;
+    if (HK.compare(0, ResourceRecord.length(), ResourceRecord) == 0 &&
+        ad->LookupString(RemoteUserAttr, RemoteUser)) {
+      IndexResourceUser(HK.substr(ResourceRecord.length()), RemoteUser);
+    }
+  }
+  dprintf(D_ACCOUNTANT, "Accountant::BuildIndexes - %d customer and %d resource records\n",
+          (int)CustomerNames.size(), (int)ResourceUsers.size());
+}
+
+void Accountant::IndexRecord(const string& Key)
+{
+  if (Key.compare(0, CustomerRecord.length(), CustomerRecord) == 0) {
+    CustomerNames.insert(Key.substr(CustomerRecord.length()));
+  } else if (Key.compare(0, ResourceRecord.length(), ResourceRecord) == 0) {
+    ResourceUsers.insert(std::make_pair(Key.substr(ResourceRecord.length()), string()));
+  }
+}
+
+void Accountant::IndexResourceUser(const string& ResourceName, const string& CustomerName)
+{
+  string & user = ResourceUsers[ResourceName];
+  if ( ! user.empty()) {
+    map<string, set<string> >::iterator it = CustomerResources.find(user);
+    if (it != CustomerResources.end()) {
+      it->second.erase(ResourceName);
+      if (it->second.empty()) CustomerResources.erase(it);
+    }
+  }
+  user = CustomerName;
+  if ( ! user.empty()) {
+    CustomerResources[user].insert(ResourceName);
+  }
+}
+
+void Accountant::UnindexRecord(const string& Key)
+{
+  if (Key.compare(0, CustomerRecord.length(), CustomerRecord) == 0) {
+    CustomerNames.erase(Key.substr(CustomerRecord.length()));
+  } else if (Key.compare(0, ResourceRecord.length(), ResourceRecord) == 0) {
+    string ResourceName = Key.substr(ResourceRecord.length());
+    IndexResourceUser(ResourceName, string());
+    ResourceUsers.erase(ResourceName);
+  }
+}
+
 //------------------------------------------------------------------
 // Get Class Ad
 //------------------------------------------------------------------
@@ -1646,6 +1699,7 @@ bool Accountant::DeleteClassAd(const string& Key)
 
   LogDestroyClassAd* log=new LogDestroyClassAd(Key.c_str());
   AcctLog->AppendLog(log);
+  UnindexRecord(Key);
   return true;
 }
 
@@ -1658,6 +1712,7 @@ void Accountant::SetAttributeInt(const string& Key, const string& AttrName, int
   if (AcctLog->AdExistsInTableOrTransaction(Key) == false) {
     LogNewClassAd* log=new LogNewClassAd(Key.c_str(),"*","*");
     AcctLog->AppendLog(log);
+    IndexRecord(Key);
   }
   char value[50];
   sprintf(value,"%d",AttrValue);
@@ -1674,6 +1729,7 @@ void Accountant::SetAttributeFloat(const string& Key, const string& AttrName, fl
   if (AcctLog->AdExistsInTableOrTransaction(Key) == false) {
     LogNewClassAd* log=new LogNewClassAd(Key.c_str(),"*","*");
     AcctLog->AppendLog(log);
+    IndexRecord(Key);
   }
   
   char value[255];
@@ -1691,12 +1747,17 @@ void Accountant::SetAttributeString(const string& Key, const string& AttrName, c
   if (AcctLog->AdExistsInTableOrTransaction(Key) == false) {
     LogNewClassAd* log=new LogNewClassAd(Key.c_str(),"*","*");
     AcctLog->AppendLog(log);
+    IndexRecord(Key);
   }
   
   string value;
   formatstr(value,"\"%s\"",AttrValue.c_str());
   LogSetAttribute* log=new LogSetAttribute(Key.c_str(),AttrName.c_str(),value.c_str());
   AcctLog->AppendLog(log);
+
+  if (AttrName == RemoteUserAttr && Key.compare(0, ResourceRecord.length(), ResourceRecord) == 0) {
+    IndexResourceUser(Key.substr(ResourceRecord.length()), AttrValue);
+  }
 }
 
 //------------------------------------------------------------------
@@ -128,6 +128,45 @@ public:
 	std::set<std::string> submitters_out_of_time;
 	std::set<std::string> submitters_failed;
 	std::set<std::string> schedds_out_of_time;
+
+    // Profile of where the time went, for NEGOTIATOR_CYCLE_PROFILE_LOG
+    // and the cycle totals in the negotiator ad.
+    struct AutoclusterProfile {
+        AutoclusterProfile() : requests(0), matches(0), requirements_evaluations(0), matchmaking_time(0.0) {}
+        int requests;
+        int matches;
+        int requirements_evaluations;
+        double matchmaking_time;
+    };
+    struct SubmitterProfile {
+        SubmitterProfile() : negotiations(0), jobs_considered(0), matches(0), rejections(0),
+            requirements_evaluations(0), rank_evaluations(0),
+            match_list_cache_hits(0), match_list_cache_misses(0),
+            negotiate_time(0.0), matchmaking_time(0.0), schedd_time(0.0) {}
+        int negotiations;
+        int jobs_considered;
+        int matches;
+        int rejections;
+        int requirements_evaluations;
+        int rank_evaluations;
+        int match_list_cache_hits;
+        int match_list_cache_misses;
+        double negotiate_time;     // total time in negotiate()
+        double matchmaking_time;   // time in matchmakingAlgorithm()
+        double schedd_time;        // time starting negotiation with and reading requests from the schedd
+        std::map<int, AutoclusterProfile> autoclusters;
+    };
+    std::map<std::string, SubmitterProfile> submitter_profiles;
+        // the submitter we are negotiating with now, points to no_submitter
+        // outside of negotiate() so the counters can be bumped unconditionally
+    SubmitterProfile *current_submitter;
+    SubmitterProfile no_submitter;
+
+    double prefetch_time;
+    int prefetches_attempted;
+    int prefetches_succeeded;
+
+    SubmitterProfile totals() const;
 };
 
 NegotiationCycleStats::NegotiationCycleStats():
@@ -160,10 +199,64 @@ NegotiationCycleStats::NegotiationCycleStats():
     submitters_share_limit(),
     submitters_out_of_time(),
     submitters_failed(),
-    schedds_out_of_time()
+    schedds_out_of_time(),
+    current_submitter(&no_submitter),
+    prefetch_time(0.0),
+    prefetches_attempted(0),
+    prefetches_succeeded(0)
 {
 }
 
+NegotiationCycleStats::SubmitterProfile
+NegotiationCycleStats::totals() const
+{
+	SubmitterProfile sum;
+	std::map<std::string, SubmitterProfile>::const_iterator it;
+	for (it = submitter_profiles.begin(); it != submitter_profiles.end(); ++it) {
+		const SubmitterProfile &p = it->second;
+		sum.negotiations += p.negotiations;
+		sum.jobs_considered += p.jobs_considered;
+		sum.matches += p.matches;
+		sum.rejections += p.rejections;
+		sum.requirements_evaluations += p.requirements_evaluations;
+		sum.rank_evaluations += p.rank_evaluations;
+		sum.match_list_cache_hits += p.match_list_cache_hits;
+		sum.match_list_cache_misses += p.match_list_cache_misses;
+		sum.negotiate_time += p.negotiate_time;
+		sum.matchmaking_time += p.matchmaking_time;
+		sum.schedd_time += p.schedd_time;
+	}
+	return sum;
+}
+
+	// Adds the time from construction to destruction to a profile counter.
+class ProfileTimer
+{
+public:
+	ProfileTimer(double &total) : m_total(total), m_start(_condor_debug_get_time_double()) {}
+	~ProfileTimer() { m_total += _condor_debug_get_time_double() - m_start; }
+private:
+	double &m_total;
+	double m_start;
+};
+
+	// Makes a submitter's profile the current one for the life of a call to
+	// negotiate(), and charges the time to it.
+class SubmitterProfileScope
+{
+public:
+	SubmitterProfileScope(NegotiationCycleStats *stats, NegotiationCycleStats::SubmitterProfile &profile)
+		: m_stats(stats), m_timer(profile.negotiate_time)
+	{
+		profile.negotiations++;
+		m_stats->current_submitter = &profile;
+	}
+	~SubmitterProfileScope() { m_stats->current_submitter = &m_stats->no_submitter; }
+private:
+	NegotiationCycleStats *m_stats;
+	ProfileTimer m_timer;
+};
+
 
 static MyString MachineAdID(ClassAd * ad)
 {
@@ -458,6 +551,7 @@ Matchmaker ()
 											 ResourcesInUseByUsersGroup_classad_func );
 	slotWeightStr = 0;
 	m_staticRanks = false;
+	m_matchPool = NULL;
 	m_dryrun = false;
 }
 
@@ -474,6 +568,7 @@ Matchmaker::
 	delete PreemptionRank;
 	delete NegotiatorPreJobRank;
 	delete NegotiatorPostJobRank;
+	delete m_matchPool;
 	delete sockCache;
 	if (MatchList) {
 		delete MatchList;
@@ -711,6 +806,7 @@ reinitialize ()
 	dprintf (D_ALWAYS,"MAX_TIME_PER_SCHEDD = %d sec\n",MaxTimePerSchedd);
 	dprintf (D_ALWAYS,"MAX_TIME_PER_PIESPIN = %d sec\n",MaxTimePerSpin);
 
+	PreemptionRankProgram.Clear();
 	if (PreemptionRank) {
 		delete PreemptionRank;
 		PreemptionRank = NULL;
@@ -721,11 +817,13 @@ reinitialize ()
 			EXCEPT ("Error parsing PREEMPTION_RANK expression: %s", tmp);
 		}
 	}
+	PreemptionRankProgram.Compile(PreemptionRank);
 
 	dprintf (D_ALWAYS,"PREEMPTION_RANK = %s\n", (tmp?tmp:"None"));
 
 	if( tmp ) free( tmp );
 
+	NegotiatorPreJobRankProgram.Clear();
 	if (NegotiatorPreJobRank) delete NegotiatorPreJobRank;
 	NegotiatorPreJobRank = NULL;
 	tmp = param("NEGOTIATOR_PRE_JOB_RANK");
@@ -734,11 +832,13 @@ reinitialize ()
 			EXCEPT ("Error parsing NEGOTIATOR_PRE_JOB_RANK expression: %s", tmp);
 		}
 	}
+	NegotiatorPreJobRankProgram.Compile(NegotiatorPreJobRank);
 
 	dprintf (D_ALWAYS,"NEGOTIATOR_PRE_JOB_RANK = %s\n", (tmp?tmp:"None"));
 
 	if( tmp ) free( tmp );
 
+	NegotiatorPostJobRankProgram.Clear();
 	if (NegotiatorPostJobRank) delete NegotiatorPostJobRank;
 	NegotiatorPostJobRank = NULL;
 	tmp = param("NEGOTIATOR_POST_JOB_RANK");
@@ -747,6 +847,7 @@ reinitialize ()
 			EXCEPT ("Error parsing NEGOTIATOR_POST_JOB_RANK expression: %s", tmp);
 		}
 	}
+	NegotiatorPostJobRankProgram.Compile(NegotiatorPostJobRank);
 
 	dprintf (D_ALWAYS,"NEGOTIATOR_POST_JOB_RANK = %s\n", (tmp?tmp:"None"));
 	
@@ -843,6 +944,18 @@ reinitialize ()
 
 	m_staticRanks = param_boolean("NEGOTIATOR_IGNORE_JOB_RANKS", false);
 
+	int num_threads = param_integer("NEGOTIATOR_NUM_THREADS", 1, 1);
+	if (num_threads > 1) {
+		if ( ! m_matchPool) {
+			m_matchPool = new MatchmakerPool();
+		}
+		m_matchPool->reconfig(num_threads, NegotiatorPreJobRank,
+			NegotiatorPostJobRank, PreemptionRank);
+	} else if (m_matchPool) {
+		delete m_matchPool;
+		m_matchPool = NULL;
+	}
+
 	if( first_time ) {
 		first_time = false;
 	} else {
@@ -1654,6 +1767,8 @@ negotiationTime ()
 	job_attr_references = compute_significant_attrs(startdAds);
 
 	// ----- Recalculate priorities for schedds
+	// the accountant's log is forced to disk once, at the end of the cycle
+	accountant.BeginNegotiationCycle();
 	accountant.UpdatePriorities();
 	accountant.CheckMatches( startdAds );
 
@@ -2085,6 +2200,7 @@ negotiationTime ()
     }
 
     // ----- Done with the negotiation cycle
+    accountant.EndNegotiationCycle();
     dprintf( D_ALWAYS, "---------- Finished Negotiation Cycle ----------\n" );
 
     completedLastCycleTime = time(NULL);
@@ -2105,6 +2221,8 @@ negotiationTime ()
 	negotiation_cycle_stats[0]->phase2_cpu_time -= negotiation_cycle_stats[0]->phase4_cpu_time;
 	negotiation_cycle_stats[0]->cpu_time = end_cycle_usage - start_usage_phase1;
 
+	writeNegotiationCycleProfile();
+
     // if we got any reconfig requests during the cycle it is safe to service them now:
     if (daemonCore->GetNeedReconfig()) {
         daemonCore->SetNeedReconfig(false);
@@ -3168,7 +3286,10 @@ negotiateWithGroup ( int untrimmed_num_startds,
 		start_time_prefetch = time(NULL);
 		start_usage_prefetch = get_rusage_utime();
 
-		prefetchResourceRequestLists(submitterAds);
+		{
+			ProfileTimer prefetch_timer(negotiation_cycle_stats[0]->prefetch_time);
+			prefetchResourceRequestLists(submitterAds);
+		}
 
 		negotiation_cycle_stats[0]->prefetch_duration = time(NULL) - start_time_prefetch;
 		negotiation_cycle_stats[0]->prefetch_cpu_time += get_rusage_utime() - start_usage_prefetch;
@@ -4475,6 +4596,8 @@ Matchmaker::prefetchResourceRequestLists(ClassAdListDoesNotDeleteAds &submitterA
 		sockCache->invalidateSock(it->first);
 	}
 	dprintf(D_ALWAYS, "Prefetch summary: %u attempted, %u successful.\n", attemptedPrefetches, successfulPrefetches);
+	negotiation_cycle_stats[0]->prefetches_attempted += attemptedPrefetches;
+	negotiation_cycle_stats[0]->prefetches_succeeded += successfulPrefetches;
 	if (timedOutPrefetches)
 	{
 		dprintf(D_ALWAYS, "There were %u prefetches in progress when timeout limit was reached.\n", timedOutPrefetches);
@@ -4725,7 +4848,14 @@ negotiate(char const* groupName, char const *submitterName, const ClassAd *submi
 
 	numMatched = 0;
 
-	classad_shared_ptr<ResourceRequestList> request_list = startNegotiate(submitterName, *submitterAd, sock);
+	NegotiationCycleStats::SubmitterProfile &profile = negotiation_cycle_stats[0]->submitter_profiles[submitterName];
+	SubmitterProfileScope profile_scope(negotiation_cycle_stats[0], profile);
+
+	classad_shared_ptr<ResourceRequestList> request_list;
+	{
+		ProfileTimer schedd_timer(profile.schedd_time);
+		request_list = startNegotiate(submitterName, *submitterAd, sock);
+	}
 	if (!request_list.get()) {return MM_ERROR;}
 
 	std::string scheddAddr;
@@ -4792,7 +4922,10 @@ negotiate(char const* groupName, char const *submitterName, const ClassAd *submi
 		}
 
 		// 2a.  ask for job information
-		if ( !request_list->getRequest(request,cluster,proc,autocluster,sock, schedd_will_match) ) {
+		double schedd_start = _condor_debug_get_time_double();
+		bool got_request = request_list->getRequest(request,cluster,proc,autocluster,sock, schedd_will_match);
+		profile.schedd_time += _condor_debug_get_time_double() - schedd_start;
+		if ( !got_request ) {
 			// Failed to get a request.  Check to see if it is because
 			// of an error talking to the schedd.
 			if ( request_list->hadError() ) {
@@ -4824,6 +4957,9 @@ negotiate(char const* groupName, char const *submitterName, const ClassAd *submi
 	
 
         negotiation_cycle_stats[0]->num_jobs_considered += 1;
+        profile.jobs_considered++;
+        NegotiationCycleStats::AutoclusterProfile &ac_profile = profile.autoclusters[autocluster];
+        ac_profile.requests++;
 
         // information regarding the negotiating group context:
         string negGroupName = (groupName != NULL) ? groupName : hgq_root_group->name.c_str();
@@ -4869,12 +5005,18 @@ negotiate(char const* groupName, char const *submitterName, const ClassAd *submi
 		{
             remoteUser = "";
 			// 2e(i).  find a compatible offer
+			double mm_start = _condor_debug_get_time_double();
+			int evals_before = profile.requirements_evaluations;
 			offer=matchmakingAlgorithm(submitterName, scheddAddr.c_str(), request,
                                              startdAds, priority,
                                              limitUsed, limitUsedUnclaimed,
                                              submitterLimit, submitterLimitUnclaimed,
 											 pieLeft,
 											 only_consider_startd_rank);
+			double mm_time = _condor_debug_get_time_double() - mm_start;
+			profile.matchmaking_time += mm_time;
+			ac_profile.matchmaking_time += mm_time;
+			ac_profile.requirements_evaluations += profile.requirements_evaluations - evals_before;
 
 			if( !offer )
 			{
@@ -4890,6 +5032,7 @@ negotiate(char const* groupName, char const *submitterName, const ClassAd *submi
 						cluster, proc, submitterName, scheddAddr.c_str());
 
 				negotiation_cycle_stats[0]->rejections++;
+				profile.rejections++;
 
 				if( rejForSubmitterLimit ) {
                     negotiation_cycle_stats[0]->submitters_share_limit.insert(submitterName);
@@ -5057,6 +5200,8 @@ negotiate(char const* groupName, char const *submitterName, const ClassAd *submi
         if (remoteUser == "") limitUsedUnclaimed += match_cost;
 		pieLeft -= match_cost;
 		negotiation_cycle_stats[0]->matches++;
+		profile.matches++;
+		ac_profile.matches++;
 	}
 
 
@@ -5311,6 +5456,8 @@ matchmakingAlgorithm(const char *submitterName, const char *scheddAddr, ClassAd
 		 MatchList->cache_still_valid(request,PreemptionReq,PreemptionRank,
 					preemption_req_unstable,preemption_rank_unstable) )
 	{
+		negotiation_cycle_stats[0]->current_submitter->match_list_cache_hits++;
+
 		// we can use cached information.  pop off the best
 		// candidate from our sorted list.
 		while( (cached_bestSoFar = MatchList->pop_candidate(candidateDslotClaims)) ) {
@@ -5359,6 +5506,9 @@ matchmakingAlgorithm(const char *submitterName, const char *scheddAddr, ClassAd
 		return cached_bestSoFar;
 	}
 
+	NegotiationCycleStats::SubmitterProfile *profile = negotiation_cycle_stats[0]->current_submitter;
+	profile->match_list_cache_misses++;
+
 		// Delete our old MatchList, since we know that if we made it here
 		// we no longer are dealing with a job from the same autocluster.
 		// (someday we will store it in case we see another job with
@@ -5390,22 +5540,45 @@ matchmakingAlgorithm(const char *submitterName, const char *scheddAddr, ClassAd
 	rejForSubmitterLimit = 0;
 
 	bool allow_pslot_preemption = param_boolean("ALLOW_PSLOT_PREEMPTION", false);
+	bool jobWantsMultiMatch = false;
+	request.LookupBool(ATTR_WANT_PSLOT_PREEMPTION, jobWantsMultiMatch);
+	bool may_multi_match = ConsiderPreemption && allow_pslot_preemption && jobWantsMultiMatch;
 	double allocatedWeight = 0.0;
-		// Set up for parallel matchmaking, if enabled
-	std::vector<ClassAd *> par_candidates;
-	std::vector<ClassAd *> par_matches;
 
-	int num_threads =  param_integer("NEGOTIATOR_NUM_THREADS", 1);
-	if (num_threads > 1) {
+		// If we have matchmaking threads, evaluate Requirements and the
+		// ranks of every candidate up front.  The scan below then only
+		// visits the candidates that matched (plus any the pool left for
+		// us), in the same order as startdAds.
+	std::vector<ClassAd *> par_candidates;
+	std::vector<MatchmakerPool::Result> par_results;
+	MatchmakerPool::Result *par_result = NULL;
+	size_t par_index = 0;
+	if (m_matchPool) {
 		startdAds.Open();
 		par_candidates.reserve(startdAds.Length());
 		while ((candidate = startdAds.Next())) {
 			par_candidates.push_back(candidate);
 		}
 		startdAds.Close();
-		ParallelIsAMatch(&request, par_candidates, par_matches, num_threads, false);
+		m_matchPool->evaluate(request, par_candidates, ConsiderPreemption, par_results);
+		for (size_t i = 0; i < par_results.size(); ++i) {
+			if (par_results[i].evaluated) {
+				profile->requirements_evaluations++;
+				if (par_results[i].is_match && !m_staticRanks) {
+					profile->rank_evaluations++;
+				}
+			}
+		}
 	}
 
+		// The request's Requirements and Rank are evaluated against every
+		// candidate that the matchmaking threads did not evaluate, so
+		// compile them once.
+	classad::CompiledExpr requestRequirements;
+	classad::CompiledExpr requestRank;
+	requestRequirements.Compile(request.Lookup(ATTR_REQUIREMENTS));
+	requestRank.Compile(request.Lookup(ATTR_RANK));
+
 	// scan the offer ads
 	startdAds.Open ();
 	std::string machineAddr;
@@ -5414,7 +5587,20 @@ matchmakingAlgorithm(const char *submitterName, const char *scheddAddr, ClassAd
 	bool isIPv6 = false;
 	getSinfulStringProtocolBools( false, false, scheddAddr, isIPv4, isIPv6 );
 
-	while ((candidate = startdAds.Next ())) {
+	for (;;) {
+		if (m_matchPool) {
+			if (par_index >= par_results.size()) {
+				break;
+			}
+			par_result = &par_results[par_index++];
+			if (par_result->evaluated && !par_result->is_match && !may_multi_match) {
+				continue;
+			}
+			candidate = par_result->ad;
+		} else if ( ! (candidate = startdAds.Next())) {
+			break;
+		}
+
 		bool v4 = false;
 		bool v6 = false;
 		candidate->LookupString( "MyAddress", machineAddr );
@@ -5441,47 +5627,46 @@ matchmakingAlgorithm(const char *submitterName, const char *scheddAddr, ClassAd
 			}
 		}
 
-        consumption_map_t consumption;
-        bool has_cp = cp_supports_policy(*candidate);
-        bool cp_sufficient = true;
-        if (has_cp) {
-            // replace RequestXxx attributes (temporarily) with values derived from
-            // the consumption policy, so that Requirements expressions evaluate in a
-            // manner consistent with the check on CP resources
-            cp_override_requested(request, *candidate, consumption);
-            cp_sufficient = cp_sufficient_assets(*candidate, consumption);
-        }
-
-		// The candidate offer and request must match.
-        // When candidate supports a consumption policy, then resources
-        // requested via consumption policy must also be available from
-        // the resource
 		bool is_a_match = false;
-		if (num_threads > 1) {
-			is_a_match = cp_sufficient &&
-				(par_matches.end() !=
-					std::find(par_matches.begin(), par_matches.end(), candidate));
+		if (par_result && par_result->evaluated) {
+			is_a_match = par_result->is_match;
 		} else {
-			is_a_match = cp_sufficient && IsAMatch(&request, candidate);
-		}
+			consumption_map_t consumption;
+			bool has_cp = cp_supports_policy(*candidate);
+			bool cp_sufficient = true;
+			if (has_cp) {
+				// replace RequestXxx attributes (temporarily) with values derived from
+				// the consumption policy, so that Requirements expressions evaluate in a
+				// manner consistent with the check on CP resources
+				cp_override_requested(request, *candidate, consumption);
+				cp_sufficient = cp_sufficient_assets(*candidate, consumption);
+			}
 
-        if (has_cp) {
-            // put original values back for RequestXxx attributes
-            cp_restore_requested(request, consumption);
-        }
+			// The candidate offer and request must match.
+			// When candidate supports a consumption policy, then resources
+			// requested via consumption policy must also be available from
+			// the resource
+			if (cp_sufficient) {
+				classad::MatchClassAd *mad = getTheMatchAd(&request, candidate);
+				is_a_match = MatchmakerPool::evalMatch(*mad, &request, requestRequirements);
+				releaseTheMatchAd();
+				profile->requirements_evaluations++;
+			}
+
+			if (has_cp) {
+				// put original values back for RequestXxx attributes
+				cp_restore_requested(request, consumption);
+			}
+		}
 
 		candidatePreemptState = NO_PREEMPTION;
 
 		candidateDslotClaims.clear();
-		if (!is_a_match && ConsiderPreemption) {
-			bool jobWantsMultiMatch = false;
-			request.LookupBool(ATTR_WANT_PSLOT_PREEMPTION, jobWantsMultiMatch);
-			if (allow_pslot_preemption && jobWantsMultiMatch) {
-				// Note: after call to pslotMultiMatch(), iff is_a_match == True,
-				// then candidatePreemptState will be updated as well as candidateDslotClaims
-				is_a_match = pslotMultiMatch(&request, candidate,submitterName,
-					only_for_startdrank, candidateDslotClaims, candidatePreemptState);
-			}
+		if (!is_a_match && may_multi_match) {
+			// Note: after call to pslotMultiMatch(), iff is_a_match == True,
+			// then candidatePreemptState will be updated as well as candidateDslotClaims
+			is_a_match = pslotMultiMatch(&request, candidate,submitterName,
+				only_for_startdrank, candidateDslotClaims, candidatePreemptState);
 		}
 
 		int cluster_id=-1,proc_id=-1;
@@ -5627,7 +5812,34 @@ matchmakingAlgorithm(const char *submitterName, const char *scheddAddr, ClassAd
 			}
 		}
 
-		calculateRanks(request, candidate, candidatePreemptState, candidateRankValue, candidatePreJobRankValue, candidatePostJobRankValue, candidatePreemptRankValue);
+		if (par_result && par_result->evaluated && par_result->is_match && !m_staticRanks) {
+				// ranks were computed by the matchmaking threads
+			if (par_result->eval_errors & MatchmakerPool::EVAL_ERR_PRE_JOB_RANK) {
+				dprintf(D_ALWAYS, "Failed to evaluate NEGOTIATOR_PRE_JOB_RANK expression to a float.\n");
+			}
+			if (par_result->eval_errors & MatchmakerPool::EVAL_ERR_POST_JOB_RANK) {
+				dprintf(D_ALWAYS, "Failed to evaluate NEGOTIATOR_POST_JOB_RANK expression to a float.\n");
+			}
+			candidatePreJobRankValue = par_result->PreJobRankValue;
+			candidateRankValue = par_result->RankValue;
+			candidatePostJobRankValue = par_result->PostJobRankValue;
+			candidatePreemptRankValue = -(FLT_MAX);
+			if (candidatePreemptState != NO_PREEMPTION) {
+				if (par_result->has_preempt_rank) {
+					if (par_result->eval_errors & MatchmakerPool::EVAL_ERR_PREEMPT_RANK) {
+						dprintf(D_ALWAYS, "Failed to evaluate PREEMPTION_RANK expression to a float.\n");
+					}
+					candidatePreemptRankValue = par_result->PreemptRankValue;
+				} else {
+					candidatePreemptRankValue = EvalNegotiatorMatchRank(
+						"PREEMPTION_RANK",PreemptionRank,
+						request, candidate);
+				}
+			}
+		} else {
+			calculateRanks(request, candidate, candidatePreemptState, candidateRankValue, candidatePreJobRankValue, candidatePostJobRankValue, candidatePreemptRankValue, &requestRank);
+			profile->rank_evaluations++;
+		}
 
 		if ( MatchList ) {
 			MatchList->add_candidate(
@@ -5849,7 +6061,8 @@ calculateRanks(ClassAd &request,
                double &candidateRankValue,
                double &candidatePreJobRankValue,
                double &candidatePostJobRankValue,
-               double &candidatePreemptRankValue
+               double &candidatePreemptRankValue,
+               const classad::CompiledExpr *requestRank
               )
 {
 	if (m_staticRanks) {
@@ -5866,28 +6079,39 @@ calculateRanks(ClassAd &request,
 		}
 	}
 
-	candidatePreJobRankValue = EvalNegotiatorMatchRank(
-		"NEGOTIATOR_PRE_JOB_RANK",NegotiatorPreJobRank,
-		request, candidate);
+	// Evaluate all the ranks in one match ad, with the compiled
+	// expressions, the same way the matchmaking threads do.
+	getTheMatchAd(&request, candidate);
+	bool failed = false;
 
-	// calculate the request's rank of the candidate
-	double tmp;
-	if(!EvalFloat(ATTR_RANK, &request, candidate, tmp)) {
-		tmp = 0.0;
+	candidatePreJobRankValue = MatchmakerPool::evalRank(NegotiatorPreJobRank,
+		NegotiatorPreJobRankProgram, candidate, failed);
+	if (failed) {
+		dprintf(D_ALWAYS, "Failed to evaluate NEGOTIATOR_PRE_JOB_RANK expression to a float.\n");
 	}
-	candidateRankValue = tmp;
 
-	candidatePostJobRankValue = EvalNegotiatorMatchRank(
-		"NEGOTIATOR_POST_JOB_RANK",NegotiatorPostJobRank,
-		request, candidate);
+	// calculate the request's rank of the candidate
+	classad::CompiledExpr not_compiled;
+	candidateRankValue = MatchmakerPool::evalRequestRank(&request, candidate,
+		requestRank ? *requestRank : not_compiled);
+
+	candidatePostJobRankValue = MatchmakerPool::evalRank(NegotiatorPostJobRank,
+		NegotiatorPostJobRankProgram, candidate, failed);
+	if (failed) {
+		dprintf(D_ALWAYS, "Failed to evaluate NEGOTIATOR_POST_JOB_RANK expression to a float.\n");
+	}
 
 	candidatePreemptRankValue = -(FLT_MAX);
 	if(candidatePreemptState != NO_PREEMPTION) {
-		candidatePreemptRankValue = EvalNegotiatorMatchRank(
-			"PREEMPTION_RANK",PreemptionRank,
-			request, candidate);
+		candidatePreemptRankValue = MatchmakerPool::evalRank(PreemptionRank,
+			PreemptionRankProgram, candidate, failed);
+		if (failed) {
+			dprintf(D_ALWAYS, "Failed to evaluate PREEMPTION_RANK expression to a float.\n");
+		}
 	}
 
+	releaseTheMatchAd();
+
 	if (m_staticRanks) {
 		// only get here on cache miss
 		struct JobRanks ranks;
@@ -7069,7 +7293,14 @@ Matchmaker::publishNegotiationCycleStats( ClassAd *ad )
         ATTR_LAST_NEGOTIATION_CYCLE_SUBMITTERS_SHARE_LIMIT,
         ATTR_LAST_NEGOTIATION_CYCLE_ACTIVE_SUBMITTER_COUNT,
         ATTR_LAST_NEGOTIATION_CYCLE_MATCH_RATE,
-        ATTR_LAST_NEGOTIATION_CYCLE_MATCH_RATE_SUSTAINED
+        ATTR_LAST_NEGOTIATION_CYCLE_MATCH_RATE_SUSTAINED,
+        ATTR_LAST_NEGOTIATION_CYCLE_REQUIREMENTS_EVALUATIONS,
+        ATTR_LAST_NEGOTIATION_CYCLE_RANK_EVALUATIONS,
+        ATTR_LAST_NEGOTIATION_CYCLE_MATCH_LIST_CACHE_HITS,
+        ATTR_LAST_NEGOTIATION_CYCLE_MATCH_LIST_CACHE_MISSES,
+        ATTR_LAST_NEGOTIATION_CYCLE_MATCHMAKING_TIME,
+        ATTR_LAST_NEGOTIATION_CYCLE_SCHEDD_TIME,
+        ATTR_LAST_NEGOTIATION_CYCLE_PREFETCH_TIME
     };
     const int nattrs = sizeof(attrs)/sizeof(*attrs);
 
@@ -7122,7 +7353,116 @@ Matchmaker::publishNegotiationCycleStats( ClassAd *ad )
 		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_SUBMITTERS_FAILED, i, s->submitters_failed);
 		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_SUBMITTERS_OUT_OF_TIME, i, s->submitters_out_of_time);
         SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_SUBMITTERS_SHARE_LIMIT, i, s->submitters_share_limit);
+
+		NegotiationCycleStats::SubmitterProfile sum = s->totals();
+		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_REQUIREMENTS_EVALUATIONS, i, sum.requirements_evaluations);
+		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_RANK_EVALUATIONS, i, sum.rank_evaluations);
+		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_MATCH_LIST_CACHE_HITS, i, sum.match_list_cache_hits);
+		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_MATCH_LIST_CACHE_MISSES, i, sum.match_list_cache_misses);
+		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_MATCHMAKING_TIME, i, sum.matchmaking_time);
+		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_SCHEDD_TIME, i, sum.schedd_time);
+		SetAttrN( ad, ATTR_LAST_NEGOTIATION_CYCLE_PREFETCH_TIME, i, s->prefetch_time);
+	}
+}
+
+	// Append a record of the cycle that just finished to NEGOTIATOR_CYCLE_PROFILE_LOG,
+	// one ClassAd per line in JSON form, with the time spent and the number of
+	// expressions evaluated for each submitter and for its most expensive autoclusters.
+void Matchmaker::writeNegotiationCycleProfile()
+{
+	std::string filename;
+	if ( ! param(filename, "NEGOTIATOR_CYCLE_PROFILE_LOG")) {
+		return;
+	}
+	NegotiationCycleStats *s = negotiation_cycle_stats[0];
+	NegotiationCycleStats::SubmitterProfile sum = s->totals();
+	const int max_autoclusters = 10;
+
+	ClassAd record;
+	record.Assign("StartTime", (long long)s->start_time);
+	record.Assign("EndTime", (long long)s->end_time);
+	record.Assign("Duration", (long long)s->duration);
+	record.Assign("CpuTime", s->cpu_time);
+	record.Assign("PrefetchTime", s->prefetch_time);
+	record.Assign("PrefetchesAttempted", s->prefetches_attempted);
+	record.Assign("PrefetchesSucceeded", s->prefetches_succeeded);
+	record.Assign("JobsConsidered", sum.jobs_considered);
+	record.Assign("Matches", sum.matches);
+	record.Assign("Rejections", sum.rejections);
+	record.Assign("RequirementsEvaluations", sum.requirements_evaluations);
+	record.Assign("RankEvaluations", sum.rank_evaluations);
+	record.Assign("MatchListCacheHits", sum.match_list_cache_hits);
+	record.Assign("MatchListCacheMisses", sum.match_list_cache_misses);
+	record.Assign("MatchmakingTime", sum.matchmaking_time);
+	record.Assign("ScheddTime", sum.schedd_time);
+
+	std::vector<classad::ExprTree*> submitters;
+	for (auto it = s->submitter_profiles.begin(); it != s->submitter_profiles.end(); ++it) {
+		const NegotiationCycleStats::SubmitterProfile &p = it->second;
+		ClassAd *sad = new ClassAd();
+		sad->Assign("Name", it->first);
+		sad->Assign("Negotiations", p.negotiations);
+		sad->Assign("JobsConsidered", p.jobs_considered);
+		sad->Assign("Matches", p.matches);
+		sad->Assign("Rejections", p.rejections);
+		sad->Assign("RequirementsEvaluations", p.requirements_evaluations);
+		sad->Assign("RankEvaluations", p.rank_evaluations);
+		sad->Assign("MatchListCacheHits", p.match_list_cache_hits);
+		sad->Assign("MatchListCacheMisses", p.match_list_cache_misses);
+		sad->Assign("NegotiateTime", p.negotiate_time);
+		sad->Assign("MatchmakingTime", p.matchmaking_time);
+		sad->Assign("ScheddTime", p.schedd_time);
+
+			// only the autoclusters that took the most matchmaking time
+		std::vector<std::pair<double, int> > by_time;
+		for (auto ac = p.autoclusters.begin(); ac != p.autoclusters.end(); ++ac) {
+			by_time.push_back(std::make_pair(ac->second.matchmaking_time, ac->first));
+		}
+		std::sort(by_time.begin(), by_time.end(), std::greater<std::pair<double, int> >());
+		if ((int)by_time.size() > max_autoclusters) {
+			by_time.resize(max_autoclusters);
+		}
+		std::vector<classad::ExprTree*> autoclusters;
+		for (auto ac = by_time.begin(); ac != by_time.end(); ++ac) {
+			const NegotiationCycleStats::AutoclusterProfile &acp = p.autoclusters.find(ac->second)->second;
+			ClassAd *acad = new ClassAd();
+			acad->Assign("AutoClusterId", ac->second);
+			acad->Assign("Requests", acp.requests);
+			acad->Assign("Matches", acp.matches);
+			acad->Assign("RequirementsEvaluations", acp.requirements_evaluations);
+			acad->Assign("MatchmakingTime", acp.matchmaking_time);
+			autoclusters.push_back(acad);
+		}
+		sad->Assign("AutoClusterCount", (long long)p.autoclusters.size());
+		sad->Insert("AutoClusters", classad::ExprList::MakeExprList(autoclusters));
+		submitters.push_back(sad);
+	}
+	record.Insert("Submitters", classad::ExprList::MakeExprList(submitters));
+
+	std::string line;
+	classad::ClassAdJsonUnParser unparser(true);
+	unparser.Unparse(line, &record);
+	line += '\n';
+
+		// rotate the log when it gets too big, keeping one old copy
+	long long max_size = param_integer("MAX_NEGOTIATOR_CYCLE_PROFILE_LOG", 10*1024*1024, 0);
+	struct stat st;
+	if (max_size > 0 && stat(filename.c_str(), &st) == 0 && st.st_size + (long long)line.size() > max_size) {
+		std::string old_filename = filename + ".old";
+		if (rename(filename.c_str(), old_filename.c_str()) < 0) {
+			dprintf(D_ALWAYS, "Failed to rotate %s to %s: %s\n", filename.c_str(), old_filename.c_str(), strerror(errno));
+		}
+	}
+
+	int fd = safe_open_wrapper_follow(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if (fd < 0) {
+		dprintf(D_ALWAYS, "Failed to open %s for the negotiation cycle profile: %s\n", filename.c_str(), strerror(errno));
+		return;
+	}
+	if (full_write(fd, line.c_str(), line.size()) != (ssize_t)line.size()) {
+		dprintf(D_ALWAYS, "Failed to write the negotiation cycle profile to %s: %s\n", filename.c_str(), strerror(errno));
 	}
+	close(fd);
 }
 
 double
@@ -28,6 +28,7 @@
 #include "dc_collector.h"
 #include "condor_ver_info.h"
 #include "matchmaker_negotiate.h"
+#include "matchmaker_pool.h"
 
 #include <vector>
 #include <string>
@@ -144,7 +145,7 @@ class Matchmaker : public Service
 		void forwardAccountingData(std::set<std::string> &names);
 		void forwardGroupAccounting(CollectorList *cl, GroupEntry *ge);
 
-		void calculateRanks(ClassAd &request, ClassAd *offer, PreemptState candidatePreemptState, double &candidateRankValue, double &candidatePreJobRankValue, double &candidatePostJobRankValue, double &candidatePreemptRankValue);
+		void calculateRanks(ClassAd &request, ClassAd *offer, PreemptState candidatePreemptState, double &candidateRankValue, double &candidatePreJobRankValue, double &candidatePostJobRankValue, double &candidatePreemptRankValue, const classad::CompiledExpr *requestRank = NULL);
 
 		void setDryRun(bool d) {m_dryrun = d;}
 		bool getDryRun() const {return m_dryrun;}
@@ -377,6 +378,10 @@ class Matchmaker : public Service
 		bool preemption_rank_unstable;
 		ExprTree *NegotiatorPreJobRank;  // rank applied before job rank
 		ExprTree *NegotiatorPostJobRank; // rank applied after job rank
+			// the rank expressions compiled, for calculateRanks()
+		classad::CompiledExpr PreemptionRankProgram;
+		classad::CompiledExpr NegotiatorPreJobRankProgram;
+		classad::CompiledExpr NegotiatorPostJobRankProgram;
 		bool want_globaljobprio;	// cached value of config knob USE_GLOBAL_JOB_PRIOS
 		bool want_matchlist_caching;	// should we cache matches per autocluster?
 		bool PublishCrossSlotPrios; // value of knob NEGOTIATOR_CROSS_SLOT_PRIOS, default of false
@@ -396,6 +401,10 @@ class Matchmaker : public Service
 
 		bool m_staticRanks;
 
+			// Worker threads for matchmakingAlgorithm(), NULL unless
+			// NEGOTIATOR_NUM_THREADS > 1.
+		MatchmakerPool *m_matchPool;
+
 		StringList NegotiatorMatchExprNames;
 		StringList NegotiatorMatchExprValues;
 
@@ -617,6 +626,7 @@ class Matchmaker : public Service
 
 		void StartNewNegotiationCycleStat();
 		void publishNegotiationCycleStats( ClassAd *ad );
+		void writeNegotiationCycleProfile();
 
 		double calculate_subtree_usage(GroupEntry *group);
 };
@@ -0,0 +1,466 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2019, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include <float.h>
+#include "condor_debug.h"
+#include "condor_attributes.h"
+#include "condor_classad.h"
+#include "consumption_policy.h"
+#include "matchmaker_pool.h"
+
+// Number of candidates a worker claims at a time.  Small enough that
+// the work stays balanced when some slot ads are much more expensive to
+// evaluate than others, large enough that the lock is not contended.
+#define MATCHMAKER_POOL_MIN_CHUNK 16
+
+MatchmakerPool::Worker::Worker()
+	: pool(NULL), PreJobRank(NULL), PostJobRank(NULL), PreemptionRank(NULL),
+	generation(0)
+#ifdef HAVE_PTHREADS
+	, started(false)
+#endif
+{
+}
+
+MatchmakerPool::Worker::~Worker()
+{
+	delete PreJobRank;
+	delete PostJobRank;
+	delete PreemptionRank;
+}
+
+void
+MatchmakerPool::Worker::setExprs(classad::ExprTree *pre_job_rank,
+	classad::ExprTree *post_job_rank, classad::ExprTree *preemption_rank)
+{
+	delete PreJobRank;
+	delete PostJobRank;
+	delete PreemptionRank;
+	PreJobRank = pre_job_rank ? pre_job_rank->Copy() : NULL;
+	PostJobRank = post_job_rank ? post_job_rank->Copy() : NULL;
+	PreemptionRank = preemption_rank ? preemption_rank->Copy() : NULL;
+	PreJobRankProgram.Compile(PreJobRank);
+	PostJobRankProgram.Compile(PostJobRank);
+	PreemptionRankProgram.Compile(PreemptionRank);
+}
+
+MatchmakerPool::MatchmakerPool()
+	: m_request(NULL), m_candidates(NULL), m_results(NULL),
+	m_want_preempt_rank(false), m_next_index(0),
+	m_chunk_size(MATCHMAKER_POOL_MIN_CHUNK), m_generation(0),
+	m_busy_workers(0), m_shutdown(false)
+{
+#ifdef HAVE_PTHREADS
+	pthread_mutex_init(&m_lock, NULL);
+	pthread_cond_init(&m_work_cv, NULL);
+	pthread_cond_init(&m_done_cv, NULL);
+#endif
+}
+
+MatchmakerPool::~MatchmakerPool()
+{
+	stopThreads();
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		delete m_workers[i];
+	}
+	m_workers.clear();
+#ifdef HAVE_PTHREADS
+	pthread_cond_destroy(&m_done_cv);
+	pthread_cond_destroy(&m_work_cv);
+	pthread_mutex_destroy(&m_lock);
+#endif
+}
+
+void
+MatchmakerPool::reconfig(int num_threads, classad::ExprTree *pre_job_rank,
+	classad::ExprTree *post_job_rank, classad::ExprTree *preemption_rank)
+{
+#ifndef HAVE_PTHREADS
+	num_threads = 1;
+#endif
+	if (num_threads < 1) {
+		num_threads = 1;
+	}
+
+	if (num_threads != numThreads()) {
+		stopThreads();
+		for (size_t i = 0; i < m_workers.size(); ++i) {
+			delete m_workers[i];
+		}
+		m_workers.clear();
+		for (int i = 0; i < num_threads; ++i) {
+			Worker *w = new Worker();
+			w->pool = this;
+			m_workers.push_back(w);
+		}
+	}
+
+		// The threads are idle between calls to evaluate(), so it is
+		// safe to swap the expressions out from under them.
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		m_workers[i]->setExprs(pre_job_rank, post_job_rank, preemption_rank);
+	}
+
+	startThreads();
+
+	dprintf(D_ALWAYS, "Matchmaking will use %d thread%s\n",
+			num_threads, num_threads == 1 ? "" : "s");
+}
+
+void
+MatchmakerPool::startThreads()
+{
+#ifdef HAVE_PTHREADS
+	if (m_workers.size() > 1) {
+			// dprintf only takes its lock when it knows about threads.
+			// Classad functions called by workers may log.
+		dprintf_make_thread_safe();
+	}
+
+	m_shutdown = false;
+		// worker 0 is the calling thread
+	for (size_t i = 1; i < m_workers.size(); ++i) {
+		Worker *w = m_workers[i];
+		if (w->started) {
+			continue;
+		}
+		w->generation = m_generation;
+		int rc = pthread_create(&w->tid, NULL, MatchmakerPool::threadMain, w);
+		if (rc != 0) {
+			EXCEPT("Failed to create matchmaking thread: %s", strerror(rc));
+		}
+		w->started = true;
+	}
+#endif
+}
+
+void
+MatchmakerPool::stopThreads()
+{
+#ifdef HAVE_PTHREADS
+	pthread_mutex_lock(&m_lock);
+	m_shutdown = true;
+	pthread_cond_broadcast(&m_work_cv);
+	pthread_mutex_unlock(&m_lock);
+
+	for (size_t i = 1; i < m_workers.size(); ++i) {
+		Worker *w = m_workers[i];
+		if (w->started) {
+			pthread_join(w->tid, NULL);
+			w->started = false;
+		}
+	}
+	m_shutdown = false;
+#endif
+}
+
+#ifdef HAVE_PTHREADS
+void *
+MatchmakerPool::threadMain(void *arg)
+{
+	Worker *w = (Worker *)arg;
+	MatchmakerPool *pool = w->pool;
+
+#ifndef WIN32
+		// leave all signal handling to the daemon core thread
+	sigset_t mask;
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+#endif
+
+	pthread_mutex_lock(&pool->m_lock);
+	for (;;) {
+		while (!pool->m_shutdown && w->generation == pool->m_generation) {
+			pthread_cond_wait(&pool->m_work_cv, &pool->m_lock);
+		}
+		if (pool->m_shutdown) {
+			break;
+		}
+		w->generation = pool->m_generation;
+		pthread_mutex_unlock(&pool->m_lock);
+
+		pool->runWorker(w);
+
+		pthread_mutex_lock(&pool->m_lock);
+		if (--pool->m_busy_workers == 0) {
+			pthread_cond_signal(&pool->m_done_cv);
+		}
+	}
+	pthread_mutex_unlock(&pool->m_lock);
+	return NULL;
+}
+#endif
+
+bool
+MatchmakerPool::nextChunk(size_t &begin, size_t &end)
+{
+	bool found = false;
+#ifdef HAVE_PTHREADS
+	pthread_mutex_lock(&m_lock);
+#endif
+	size_t count = m_candidates->size();
+	if (m_next_index < count) {
+		begin = m_next_index;
+		end = begin + m_chunk_size;
+		if (end > count) {
+			end = count;
+		}
+		m_next_index = end;
+		found = true;
+	}
+#ifdef HAVE_PTHREADS
+	pthread_mutex_unlock(&m_lock);
+#endif
+	return found;
+}
+
+void
+MatchmakerPool::runWorker(Worker *w)
+{
+	const std::vector<ClassAd*> &candidates = *m_candidates;
+	std::vector<Result> &results = *m_results;
+
+		// Lookups on the shell fall through to the request, so
+		// the request itself is never inserted into a match ad.
+	w->request_shell.ChainToAd(m_request);
+	w->mad.ReplaceLeftAd(&w->request_shell);
+
+	size_t begin = 0, end = 0;
+	while (nextChunk(begin, end)) {
+		for (size_t i = begin; i < end; ++i) {
+			evalCandidate(w, candidates[i], results[i]);
+		}
+	}
+
+	w->mad.RemoveLeftAd();
+	w->request_shell.Unchain();
+}
+
+double
+MatchmakerPool::evalRank(classad::ExprTree *expr, const classad::CompiledExpr &program,
+	ClassAd *resource, bool &failed)
+{
+	double rank = -(FLT_MAX);
+	failed = false;
+	if (!expr) {
+		return rank;
+	}
+
+		// Same as Matchmaker::EvalNegotiatorMatchRank(), but the
+		// resource is already the right ad of this worker's match ad.
+	classad::Value result;
+	double val;
+	bool ok;
+	if (program.IsCompiled()) {
+		ok = program.Evaluate(resource, result);
+	} else {
+		const classad::ClassAd *old_scope = expr->GetParentScope();
+		expr->SetParentScope(resource);
+		ok = resource->EvaluateExpr(expr, result);
+		expr->SetParentScope(old_scope);
+	}
+	if (ok && result.IsNumber(val)) {
+		rank = (float)val;
+	} else {
+		failed = true;
+	}
+	return rank;
+}
+
+bool
+MatchmakerPool::evalMatch(classad::MatchClassAd &mad, ClassAd *request,
+	const classad::CompiledExpr &requirements)
+{
+	if (!requirements.IsCompiled()) {
+		return mad.symmetricMatch();
+	}
+
+		// Same as symmetricMatch(), which evaluates
+		// RIGHT.requirements && LEFT.requirements in the match ad,
+		// but with the request's Requirements compiled.
+	classad::Value right_val, left_val, result;
+	bool b = false;
+	if (!mad.EvaluateAttr("leftMatchesRight", right_val)) {
+		return false;
+	}
+	if (right_val.IsBooleanValueEquiv(b) && !b) {
+		return false;
+	}
+
+	classad::EvalState state;
+	state.SetScopes(request);
+	if (!requirements.Evaluate(state, left_val)) {
+		return false;
+	}
+
+	classad::Operation::Operate(classad::Operation::LOGICAL_AND_OP,
+		right_val, left_val, result);
+	if (result.IsBooleanValueEquiv(b)) {
+		return b;
+	}
+	return false;
+}
+
+double
+MatchmakerPool::evalRequestRank(ClassAd *request, ClassAd *candidate,
+	const classad::CompiledExpr &rank)
+{
+	double tmp = 0.0;
+	if (rank.IsCompiled()) {
+		classad::Value val;
+		classad::EvalState state;
+		state.SetScopes(request);
+		if (!rank.Evaluate(state, val) || !val.IsNumber(tmp)) {
+			tmp = 0.0;
+		}
+	} else if (request->Lookup(ATTR_RANK)) {
+		if (!request->EvaluateAttrNumber(ATTR_RANK, tmp)) {
+			tmp = 0.0;
+		}
+	} else if (candidate->Lookup(ATTR_RANK)) {
+		if (!candidate->EvaluateAttrNumber(ATTR_RANK, tmp)) {
+			tmp = 0.0;
+		}
+	}
+	return tmp;
+}
+
+void
+MatchmakerPool::evalCandidate(Worker *w, ClassAd *candidate, Result &r)
+{
+	r.ad = candidate;
+
+		// Consumption policies temporarily rewrite RequestXXX in the
+		// request, which cannot be done while other threads read it.
+	if (cp_supports_policy(*candidate)) {
+		r.evaluated = false;
+		return;
+	}
+	r.evaluated = true;
+
+	w->mad.ReplaceRightAd(candidate);
+
+	r.is_match = evalMatch(w->mad, &w->request_shell, m_request_requirements);
+	if (r.is_match) {
+		bool failed = false;
+
+		r.PreJobRankValue = evalRank(w->PreJobRank, w->PreJobRankProgram,
+			candidate, failed);
+		if (failed) r.eval_errors |= EVAL_ERR_PRE_JOB_RANK;
+
+		r.RankValue = evalRequestRank(&w->request_shell, candidate, m_request_rank);
+
+		r.PostJobRankValue = evalRank(w->PostJobRank, w->PostJobRankProgram,
+			candidate, failed);
+		if (failed) r.eval_errors |= EVAL_ERR_POST_JOB_RANK;
+
+			// Only a claimed slot can end up in a preempting match, so
+			// don't bother with PREEMPTION_RANK for the rest.
+		r.PreemptRankValue = -(FLT_MAX);
+		if (m_want_preempt_rank &&
+			(candidate->Lookup(ATTR_REMOTE_USER) ||
+			 candidate->Lookup(ATTR_ACCOUNTING_GROUP) ||
+			 candidate->Lookup(ATTR_PREEMPTING_USER) ||
+			 candidate->Lookup(ATTR_PREEMPTING_ACCOUNTING_GROUP)))
+		{
+			r.PreemptRankValue = evalRank(w->PreemptionRank,
+				w->PreemptionRankProgram, candidate, failed);
+			if (failed) r.eval_errors |= EVAL_ERR_PREEMPT_RANK;
+			r.has_preempt_rank = true;
+		}
+	}
+
+	w->mad.RemoveRightAd();
+}
+
+void
+MatchmakerPool::evaluate(ClassAd &request, const std::vector<ClassAd*> &candidates,
+	bool want_preempt_rank, std::vector<Result> &results)
+{
+	results.clear();
+	results.resize(candidates.size());
+	if (candidates.empty()) {
+		return;
+	}
+	ASSERT( !m_workers.empty() );
+
+		// Every worker evaluates the same request Requirements and
+		// Rank against its candidates, so compile them once here.
+		// Only an expression with a nested ClassAd in it can't be
+		// compiled.  Evaluated as a tree, its TARGET references would go
+		// through the request, which is not in the worker's match ad,
+		// rather than the shell, so leave the request to the serial loop.
+	classad::ExprTree *requirements = request.Lookup(ATTR_REQUIREMENTS);
+	classad::ExprTree *rank = request.Lookup(ATTR_RANK);
+	m_request_requirements.Compile(requirements);
+	m_request_rank.Compile(rank);
+	if ((requirements && !m_request_requirements.IsCompiled()) ||
+		(rank && !m_request_rank.IsCompiled()))
+	{
+		for (size_t i = 0; i < candidates.size(); ++i) {
+			results[i].ad = candidates[i];
+		}
+		m_request_requirements.Clear();
+		m_request_rank.Clear();
+		return;
+	}
+
+	m_request = &request;
+	m_candidates = &candidates;
+	m_results = &results;
+	m_want_preempt_rank = want_preempt_rank;
+	m_next_index = 0;
+
+		// aim for several chunks per worker so a slow worker does
+		// not hold up the whole call
+	m_chunk_size = candidates.size() / (m_workers.size() * 8);
+	if (m_chunk_size < MATCHMAKER_POOL_MIN_CHUNK) {
+		m_chunk_size = MATCHMAKER_POOL_MIN_CHUNK;
+	}
+
+#ifdef HAVE_PTHREADS
+	bool use_threads = m_workers.size() > 1 && candidates.size() > m_chunk_size;
+	if (use_threads) {
+		pthread_mutex_lock(&m_lock);
+		m_busy_workers = (int)m_workers.size() - 1;
+		m_generation++;
+		pthread_cond_broadcast(&m_work_cv);
+		pthread_mutex_unlock(&m_lock);
+	}
+#endif
+
+	runWorker(m_workers[0]);
+
+#ifdef HAVE_PTHREADS
+	if (use_threads) {
+		pthread_mutex_lock(&m_lock);
+		while (m_busy_workers > 0) {
+			pthread_cond_wait(&m_done_cv, &m_lock);
+		}
+		pthread_mutex_unlock(&m_lock);
+	}
+#endif
+
+	m_request_requirements.Clear();
+	m_request_rank.Clear();
+	m_request = NULL;
+	m_candidates = NULL;
+	m_results = NULL;
+}
@@ -0,0 +1,177 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2019, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef _MATCHMAKER_POOL_H
+#define _MATCHMAKER_POOL_H
+
+#include "condor_classad.h"
+#include <vector>
+
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+// A persistent pool of worker threads owned by the negotiator that
+// evaluates one resource request against every candidate slot ad.
+// For each candidate the pool evaluates the symmetric Requirements
+// match and, for the ones that match, the job Rank,
+// NEGOTIATOR_PRE_JOB_RANK, NEGOTIATOR_POST_JOB_RANK and (for claimed
+// slots) PREEMPTION_RANK.  The caller then reduces over the results in
+// candidate order, so tie-breaking is identical to the serial loop.
+//
+// Each worker evaluates through its own MatchClassAd, with a private
+// empty ad chained to the request as the left ad, so the request is
+// never copied and never has its scope changed while workers run.
+// The rank expressions are copied per worker on reconfig, because
+// evaluation sets the parent scope of the expression being evaluated.
+// Where possible the rank expressions and the request's Requirements
+// and Rank are compiled (see classad::CompiledExpr), which needs no
+// parent scope; the request's are compiled once per call to evaluate()
+// and shared by all workers.  A request whose Requirements or Rank can't
+// be compiled is left to the serial loop.  The negotiator's serial loop
+// evaluates through the same functions with compiled expressions of its
+// own.
+//
+// The calling thread acts as worker 0, so a pool of N threads starts
+// N-1 extra threads.  Without pthreads the pool runs everything on the
+// calling thread.
+class MatchmakerPool {
+ public:
+
+	struct Result {
+		Result() : ad(NULL), evaluated(false), is_match(false),
+			has_preempt_rank(false), eval_errors(0),
+			RankValue(0.0), PreJobRankValue(0.0),
+			PostJobRankValue(0.0), PreemptRankValue(0.0) {}
+
+		ClassAd *ad;
+			// false if the candidate needs the serial code path,
+			// e.g. it has a consumption policy that must temporarily
+			// rewrite the request.
+		bool evaluated;
+		bool is_match;
+			// PreemptRankValue is only computed for claimed slots
+		bool has_preempt_rank;
+			// bitmask of EVAL_ERR_* for rank expressions that did
+			// not evaluate to a number; reported by the caller since
+			// workers do not dprintf.
+		int eval_errors;
+		double RankValue;
+		double PreJobRankValue;
+		double PostJobRankValue;
+		double PreemptRankValue;
+	};
+
+	enum {
+		EVAL_ERR_PRE_JOB_RANK  = 0x1,
+		EVAL_ERR_POST_JOB_RANK = 0x2,
+		EVAL_ERR_PREEMPT_RANK  = 0x4,
+	};
+
+	MatchmakerPool();
+	~MatchmakerPool();
+
+		// (Re)configure the pool.  Starts or stops threads as needed and
+		// replaces the per-worker copies of the rank expressions.  The
+		// expressions are only inspected, the caller keeps ownership.
+	void reconfig(int num_threads, classad::ExprTree *pre_job_rank,
+		classad::ExprTree *post_job_rank, classad::ExprTree *preemption_rank);
+
+	int numThreads() const { return (int)m_workers.size(); }
+
+		// Evaluate request against all candidates.  On return results
+		// holds exactly one entry per candidate, in the same order.
+		// The request and the candidate ads must not be modified by
+		// anyone else until this returns.
+	void evaluate(ClassAd &request, const std::vector<ClassAd*> &candidates,
+		bool want_preempt_rank, std::vector<Result> &results);
+
+		// The evaluation of one candidate, also used by the negotiator's
+		// serial loop.  The request and the candidate must be the left
+		// and right ads of a match ad, and the compiled expressions are
+		// used where they are compiled.
+
+		// Same as mad.symmetricMatch(), requirements is the request's.
+	static bool evalMatch(classad::MatchClassAd &mad, ClassAd *request,
+		const classad::CompiledExpr &requirements);
+		// Same as EvalFloat(ATTR_RANK, request, candidate, ...), or 0.0
+		// if that fails; rank is the request's.
+	static double evalRequestRank(ClassAd *request, ClassAd *candidate,
+		const classad::CompiledExpr &rank);
+		// Same as Matchmaker::EvalNegotiatorMatchRank(), but sets failed
+		// rather than logging.
+	static double evalRank(classad::ExprTree *expr, const classad::CompiledExpr &program,
+		ClassAd *resource, bool &failed);
+
+ private:
+
+	struct Worker {
+		Worker();
+		~Worker();
+		void setExprs(classad::ExprTree *pre_job_rank,
+			classad::ExprTree *post_job_rank, classad::ExprTree *preemption_rank);
+
+		MatchmakerPool *pool;
+		ClassAd request_shell;
+		classad::MatchClassAd mad;
+		classad::ExprTree *PreJobRank;
+		classad::ExprTree *PostJobRank;
+		classad::ExprTree *PreemptionRank;
+		classad::CompiledExpr PreJobRankProgram;
+		classad::CompiledExpr PostJobRankProgram;
+		classad::CompiledExpr PreemptionRankProgram;
+		unsigned int generation;
+#ifdef HAVE_PTHREADS
+		pthread_t tid;
+		bool started;
+#endif
+	};
+
+	void startThreads();
+	void stopThreads();
+	void runWorker(Worker *w);
+	bool nextChunk(size_t &begin, size_t &end);
+	void evalCandidate(Worker *w, ClassAd *candidate, Result &r);
+#ifdef HAVE_PTHREADS
+	static void *threadMain(void *arg);
+#endif
+
+	std::vector<Worker*> m_workers;
+
+		// state of the evaluate() call currently in progress
+	ClassAd *m_request;
+	const std::vector<ClassAd*> *m_candidates;
+	std::vector<Result> *m_results;
+	bool m_want_preempt_rank;
+	classad::CompiledExpr m_request_requirements;
+	classad::CompiledExpr m_request_rank;
+	size_t m_next_index;
+	size_t m_chunk_size;
+	unsigned int m_generation;
+	int m_busy_workers;
+	bool m_shutdown;
+
+#ifdef HAVE_PTHREADS
+	pthread_mutex_t m_lock;
+	pthread_cond_t m_work_cv;
+	pthread_cond_t m_done_cv;
+#endif
+};
+
+#endif
@@ -0,0 +1,489 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for the evaluation of requests against candidate slots in
+// MatchmakerPool, which the negotiator's serial loop shares.  Checks that
+// the match and the ranks, evaluated with compiled expressions, are the
+// same as IsAMatch(), EvalFloat() and the tree evaluation of the
+// negotiator's rank expressions, for requests whose expressions compile
+// and for ones that don't, which evaluate() leaves to the serial loop.
+// Then checks that evaluate() gives the same results, in the same order,
+// with one thread and with several, and that reconfig() starts and stops
+// the threads it should and hands them new rank expressions.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "condor_classad.h"
+#include "condor_attributes.h"
+#include "matchmaker_pool.h"
+#include "test_check.h"
+
+#include <float.h>
+#include <string>
+#include <vector>
+#if defined(LINUX)
+#include <dirent.h>
+#endif
+
+static const char *pre_job_rank_str =
+	"(10000000 * My.Rank) + (1000000 * (RemoteOwner =?= UNDEFINED)) - (100000 * Cpus) - Memory";
+static const char *post_job_rank_str =
+	"(RemoteOwner =?= UNDEFINED) * (ifthenElse(isUndefined(KFlops), 1000, Kflops) - SlotID - 1.0e10*(Offline=?=True))";
+static const char *preemption_rank_str =
+	"(RemoteUserPrio * 1000000) - ifThenElse(isUndefined(TotalJobRuntime), 0, TotalJobRuntime)";
+
+// Slot ads with a variety of values, some claimed, some with a Rank of
+// their own and some missing attributes the expressions refer to.
+static void
+make_slots( std::vector<ClassAd *> &slots, int count )
+{
+	for ( int i = 0; i < count; ++i ) {
+		std::string text;
+		formatstr( text,
+			"MyType = \"Machine\"\n"
+			"TargetType = \"Job\"\n"
+			"Name = \"slot%d@host%d\"\n"
+			"Arch = \"%s\"\n"
+			"OpSys = \"LINUX\"\n"
+			"Memory = %d\n"
+			"Cpus = %d\n"
+			"Disk = %d\n"
+			"SlotID = %d\n"
+			"Start = %s\n"
+			"Requirements = START\n",
+			i % 8 + 1, i / 8, i % 10 ? "X86_64" : "INTEL",
+			1024 + (i % 7) * 1024, 1 + i % 4, 200000 + i, i % 8 + 1,
+			i % 13 ? "TARGET.Owner =!= \"mallory\"" : "false" );
+		if ( i % 3 == 0 ) {
+			formatstr_cat( text,
+				"RemoteOwner = \"bob\"\nRemoteUser = \"bob@host\"\n"
+				"RemoteUserPrio = %d.5\nTotalJobRuntime = %d\n",
+				i % 5, i * 10 );
+		}
+		if ( i % 5 ) {
+			formatstr_cat( text, "KFlops = %d\n", 1000000 + i );
+		}
+		if ( i % 4 == 0 ) {
+			formatstr_cat( text, "Rank = TARGET.RequestMemory > %d\n", 1024 * (i % 3) );
+		}
+		if ( i % 11 == 0 ) {
+			text += "Offline = true\n";
+		}
+		if ( i % 50 == 7 ) {
+				// left to the serial loop by MatchmakerPool::evaluate()
+			text += "PartitionableSlot = true\nMachineResources = \"Cpus Memory\"\n"
+				"ConsumptionCpus = 1\nConsumptionMemory = 1024\n";
+		}
+		ClassAd *ad = new ClassAd();
+		initAdFromString( text.c_str(), *ad );
+		slots.push_back( ad );
+	}
+}
+
+static void
+make_request( ClassAd &request, const char *requirements, const char *rank )
+{
+	initAdFromString(
+		"MyType = \"Job\"\n"
+		"TargetType = \"Machine\"\n"
+		"Owner = \"alice\"\n"
+		"RequestCpus = 1\n"
+		"RequestMemory = 2048\n"
+		"RequestDisk = 100000\n", request );
+	request.AssignExpr( ATTR_REQUIREMENTS, requirements );
+	if ( rank ) {
+		request.AssignExpr( ATTR_RANK, rank );
+	}
+}
+
+// The way the negotiator evaluated its rank expressions before.
+static double
+tree_rank( classad::ExprTree *expr, ClassAd &request, ClassAd *slot )
+{
+	classad::Value result;
+	double val;
+	if ( EvalExprTree( expr, slot, &request, result ) && result.IsNumber( val ) ) {
+		return (float)val;
+	}
+	return -(FLT_MAX);
+}
+
+static void
+check_serial( const char *name, const char *requirements, const char *rank,
+              const std::vector<ClassAd *> &slots )
+{
+	ClassAd request;
+	make_request( request, requirements, rank );
+
+	classad::ExprTree *pre = NULL, *post = NULL, *preempt = NULL;
+	ParseClassAdRvalExpr( pre_job_rank_str, pre );
+	ParseClassAdRvalExpr( post_job_rank_str, post );
+	ParseClassAdRvalExpr( preemption_rank_str, preempt );
+	classad::CompiledExpr pre_prog, post_prog, preempt_prog;
+	pre_prog.Compile( pre );
+	post_prog.Compile( post );
+	preempt_prog.Compile( preempt );
+
+	classad::CompiledExpr req_prog, rank_prog;
+	req_prog.Compile( request.Lookup( ATTR_REQUIREMENTS ) );
+	rank_prog.Compile( request.Lookup( ATTR_RANK ) );
+
+	int matches = 0, differ = 0;
+	for ( size_t i = 0; i < slots.size(); ++i ) {
+		ClassAd *slot = slots[i];
+		bool expect_match = IsAMatch( &request, slot );
+		double expect_rank = 0.0;
+		if ( ! EvalFloat( ATTR_RANK, &request, slot, expect_rank ) ) {
+			expect_rank = 0.0;
+		}
+		double expect_pre = tree_rank( pre, request, slot );
+		double expect_post = tree_rank( post, request, slot );
+		double expect_preempt = tree_rank( preempt, request, slot );
+
+		bool failed = false;
+		classad::MatchClassAd *mad = getTheMatchAd( &request, slot );
+		bool is_match = MatchmakerPool::evalMatch( *mad, &request, req_prog );
+		double rank_val = MatchmakerPool::evalRequestRank( &request, slot, rank_prog );
+		double pre_val = MatchmakerPool::evalRank( pre, pre_prog, slot, failed );
+		double post_val = MatchmakerPool::evalRank( post, post_prog, slot, failed );
+		double preempt_val = MatchmakerPool::evalRank( preempt, preempt_prog, slot, failed );
+		releaseTheMatchAd();
+
+		matches += expect_match;
+		if ( is_match != expect_match || rank_val != expect_rank || pre_val != expect_pre ||
+		     post_val != expect_post || preempt_val != expect_preempt )
+		{
+			if ( differ++ < 3 ) {
+				check_failed( "%s: slot %d: match %d/%d rank %g/%g pre %g/%g post %g/%g preempt %g/%g",
+					name, (int)i, is_match, expect_match, rank_val, expect_rank,
+					pre_val, expect_pre, post_val, expect_post, preempt_val, expect_preempt );
+			}
+		}
+	}
+	if ( differ == 0 ) {
+		if ( matches == 0 || matches == (int)slots.size() ) {
+			check_failed( "%s: %d of %d slots matched, the test needs some of each",
+				name, matches, (int)slots.size() );
+		} else {
+			check_passed( "%s, %d of %d slots matched", name, matches, (int)slots.size() );
+		}
+	}
+
+	delete pre;
+	delete post;
+	delete preempt;
+}
+
+static void
+test_serial_evaluation()
+{
+	std::vector<ClassAd *> slots;
+	make_slots( slots, 400 );
+
+	const char *requirements =
+		"(TARGET.Arch == \"X86_64\") && (TARGET.OpSys == \"LINUX\") && "
+		"(TARGET.Disk >= RequestDisk) && (TARGET.Memory >= RequestMemory) && "
+		"(TARGET.Cpus >= RequestCpus)";
+	check_serial( "compiled Requirements and Rank", requirements,
+		"TARGET.KFlops / 1000 + (TARGET.RemoteOwner =?= UNDEFINED)", slots );
+	check_serial( "no job Rank, the slot's is used", requirements, NULL, slots );
+	check_serial( "Requirements that are undefined for some slots",
+		"TARGET.KFlops > 1000002 || TARGET.Memory > 4096", "TARGET.NoSuchAttr", slots );
+		// a nested ClassAd literal is not compiled
+	check_serial( "Requirements that are not compiled",
+		"[ a = TARGET.Memory ].a >= RequestMemory", "[ r = TARGET.Cpus ].r", slots );
+
+	for ( size_t i = 0; i < slots.size(); ++i ) {
+		delete slots[i];
+	}
+}
+
+// The number of threads in this process, or -1 if that is not known.
+static int
+count_threads()
+{
+#if defined(LINUX)
+	DIR *dir = opendir( "/proc/self/task" );
+	if ( ! dir ) {
+		return -1;
+	}
+	int count = 0;
+	struct dirent *de;
+	while ( (de = readdir( dir )) ) {
+		if ( de->d_name[0] != '.' ) {
+			++count;
+		}
+	}
+	closedir( dir );
+	return count;
+#else
+	return -1;
+#endif
+}
+
+static bool
+same_result( const MatchmakerPool::Result &a, const MatchmakerPool::Result &b )
+{
+	return a.ad == b.ad && a.evaluated == b.evaluated && a.is_match == b.is_match &&
+		a.has_preempt_rank == b.has_preempt_rank && a.eval_errors == b.eval_errors &&
+		a.RankValue == b.RankValue && a.PreJobRankValue == b.PreJobRankValue &&
+		a.PostJobRankValue == b.PostJobRankValue && a.PreemptRankValue == b.PreemptRankValue;
+}
+
+// Compares results with the ones from a single thread, returns the number
+// of candidates that differ.
+static int
+compare_results( const char *name, const std::vector<MatchmakerPool::Result> &results,
+                 const std::vector<MatchmakerPool::Result> &expected )
+{
+	if ( results.size() != expected.size() ) {
+		check_failed( "%s: %d results, expected %d", name, (int)results.size(), (int)expected.size() );
+		return (int)expected.size();
+	}
+	int differ = 0;
+	for ( size_t i = 0; i < results.size(); ++i ) {
+		if ( ! same_result( results[i], expected[i] ) && differ++ < 3 ) {
+			const MatchmakerPool::Result &r = results[i], &e = expected[i];
+			check_failed( "%s: candidate %d: ad %s, match %d/%d rank %g/%g pre %g/%g post %g/%g preempt %g/%g",
+				name, (int)i, r.ad == e.ad ? "same" : "differs", r.is_match, e.is_match,
+				r.RankValue, e.RankValue, r.PreJobRankValue, e.PreJobRankValue,
+				r.PostJobRankValue, e.PostJobRankValue, r.PreemptRankValue, e.PreemptRankValue );
+		}
+	}
+	return differ;
+}
+
+// Checks the results of evaluate() with one thread against the serial
+// evaluation of each candidate.  If the request's expressions don't
+// compile, every candidate must be left to the serial loop.
+static void
+check_single_thread( const char *name, ClassAd &request, const std::vector<ClassAd *> &slots,
+                     classad::ExprTree *pre, classad::ExprTree *post, classad::ExprTree *preempt,
+                     bool compiled, const std::vector<MatchmakerPool::Result> &results )
+{
+	int matches = 0, skipped = 0, preempt_ranks = 0, differ = 0;
+	for ( size_t i = 0; i < slots.size() && i < results.size(); ++i ) {
+		const MatchmakerPool::Result &r = results[i];
+		ClassAd *slot = slots[i];
+		if ( ! r.evaluated ) {
+			skipped++;
+			if ( r.ad != slot && differ++ < 3 ) {
+				check_failed( "%s: candidate %d: not the candidate's ad", name, (int)i );
+			}
+			continue;
+		}
+		if ( ! compiled ) {
+			if ( differ++ < 3 ) {
+				check_failed( "%s: candidate %d: evaluated in the pool", name, (int)i );
+			}
+			continue;
+		}
+		bool expect_match = IsAMatch( &request, slot );
+		bool ok = r.ad == slot && r.is_match == expect_match;
+		if ( ok && r.is_match ) {
+			matches++;
+			double expect_rank = 0.0;
+			if ( ! EvalFloat( ATTR_RANK, &request, slot, expect_rank ) ) {
+				expect_rank = 0.0;
+			}
+			ok = r.RankValue == expect_rank &&
+				r.PreJobRankValue == tree_rank( pre, request, slot ) &&
+				r.PostJobRankValue == tree_rank( post, request, slot );
+			if ( r.has_preempt_rank ) {
+				preempt_ranks++;
+				ok = ok && r.PreemptRankValue == tree_rank( preempt, request, slot );
+			}
+		}
+		if ( ! ok && differ++ < 3 ) {
+			double expect_rank = 0.0;
+			if ( ! EvalFloat( ATTR_RANK, &request, slot, expect_rank ) ) {
+				expect_rank = 0.0;
+			}
+			check_failed( "%s: candidate %d: match %d/%d rank %g/%g pre %g/%g post %g/%g",
+				name, (int)i, r.is_match, expect_match, r.RankValue, expect_rank,
+				r.PreJobRankValue, tree_rank( pre, request, slot ),
+				r.PostJobRankValue, tree_rank( post, request, slot ) );
+		}
+	}
+	if ( differ == 0 && results.size() == slots.size() ) {
+		if ( ! compiled ) {
+			check_passed( "%s: one thread leaves all %d candidates to the serial loop",
+				name, (int)slots.size() );
+		} else if ( matches == 0 || skipped == 0 || preempt_ranks == 0 ) {
+			check_failed( "%s: %d matches, %d left to the serial loop and %d preemption ranks, "
+				"the test needs some of each", name, matches, skipped, preempt_ranks );
+		} else {
+			check_passed( "%s: one thread gives the serial results, %d matches of %d",
+				name, matches, (int)slots.size() );
+		}
+	}
+}
+
+static void
+check_threads( const char *name, const char *requirements, const char *rank,
+               bool compiled, const std::vector<ClassAd *> &slots )
+{
+	ClassAd request;
+	make_request( request, requirements, rank );
+
+	classad::ExprTree *pre = NULL, *post = NULL, *preempt = NULL;
+	ParseClassAdRvalExpr( pre_job_rank_str, pre );
+	ParseClassAdRvalExpr( post_job_rank_str, post );
+	ParseClassAdRvalExpr( preemption_rank_str, preempt );
+
+	MatchmakerPool pool;
+	pool.reconfig( 1, pre, post, preempt );
+	std::vector<MatchmakerPool::Result> expected;
+	pool.evaluate( request, slots, true, expected );
+	check_single_thread( name, request, slots, pre, post, preempt, compiled, expected );
+
+	const int thread_counts[] = { 2, 3, 4, 8 };
+	for ( size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); ++t ) {
+		int n = thread_counts[t];
+		pool.reconfig( n, pre, post, preempt );
+			// the threads take the candidates in a different order each time
+		int differ = 0;
+		for ( int rep = 0; rep < 5; ++rep ) {
+			std::vector<MatchmakerPool::Result> results;
+			pool.evaluate( request, slots, true, results );
+			differ += compare_results( name, results, expected );
+		}
+		if ( differ == 0 ) {
+			check_passed( "%s: %d threads give the results of one", name, n );
+		}
+	}
+
+	delete pre;
+	delete post;
+	delete preempt;
+}
+
+static void
+test_parallel_evaluation()
+{
+	std::vector<ClassAd *> slots;
+	make_slots( slots, 2000 );
+
+	check_threads( "compiled Requirements and Rank",
+		"(TARGET.Arch == \"X86_64\") && (TARGET.Memory >= RequestMemory) && (TARGET.Cpus >= RequestCpus)",
+		"TARGET.KFlops / 1000 + (TARGET.RemoteOwner =?= UNDEFINED)", true, slots );
+		// TARGET in a nested ClassAd must resolve through the real request
+	check_threads( "Requirements that are not compiled",
+		"[ a = TARGET.Memory ].a >= RequestMemory", "TARGET.KFlops", false, slots );
+	check_threads( "Rank that is not compiled",
+		"TARGET.Memory >= RequestMemory", "[ r = TARGET.Cpus ].r", false, slots );
+
+	for ( size_t i = 0; i < slots.size(); ++i ) {
+		delete slots[i];
+	}
+}
+
+// reconfig() starts the threads it needs and stops the others, and
+// evaluate() gives the same results after each change, with the rank
+// expressions of the last reconfig().
+static void
+test_reconfig()
+{
+	std::vector<ClassAd *> slots;
+	make_slots( slots, 500 );
+	ClassAd request;
+	make_request( request, "TARGET.Memory >= RequestMemory", "TARGET.Memory" );
+
+	classad::ExprTree *pre = NULL, *post = NULL, *preempt = NULL;
+	ParseClassAdRvalExpr( pre_job_rank_str, pre );
+	ParseClassAdRvalExpr( post_job_rank_str, post );
+	ParseClassAdRvalExpr( preemption_rank_str, preempt );
+
+	int base_threads = count_threads();
+	std::vector<MatchmakerPool::Result> expected;
+	{
+		MatchmakerPool pool;
+		pool.reconfig( 1, pre, post, preempt );
+		pool.evaluate( request, slots, true, expected );
+		bool same_threads = base_threads < 0 || count_threads() == base_threads;
+
+		const int thread_counts[] = { 4, 2, 2, 6, 0, 3 };
+		bool threads_ok = same_threads, results_ok = true;
+		for ( size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); ++t ) {
+			int n = thread_counts[t];
+			pool.reconfig( n, pre, post, preempt );
+			int want = n < 1 ? 1 : n;
+			if ( pool.numThreads() != want ||
+			     ( base_threads >= 0 && count_threads() != base_threads + want - 1 ) )
+			{
+				check_failed( "reconfig to %d threads: the pool has %d, the process %d more than it started with",
+					n, pool.numThreads(), count_threads() - base_threads );
+				threads_ok = false;
+			}
+			std::vector<MatchmakerPool::Result> results;
+			pool.evaluate( request, slots, true, results );
+			results_ok = results_ok && compare_results( "after reconfig", results, expected ) == 0;
+		}
+		check( "reconfig() starts and stops threads to match the new count", threads_ok );
+		check( "evaluate() gives the same results after each reconfig()", results_ok );
+
+			// the same number of threads, without NEGOTIATOR_PRE_JOB_RANK
+			// and with a different PREEMPTION_RANK
+		classad::ExprTree *new_preempt = NULL;
+		ParseClassAdRvalExpr( "TotalJobRuntime", new_preempt );
+		pool.reconfig( 3, NULL, post, new_preempt );
+		std::vector<MatchmakerPool::Result> results;
+		pool.evaluate( request, slots, true, results );
+		bool new_exprs = results.size() == expected.size() &&
+			( base_threads < 0 || count_threads() == base_threads + 2 );
+		int preempt_ranks = 0;
+		for ( size_t i = 0; new_exprs && i < results.size(); ++i ) {
+			const MatchmakerPool::Result &r = results[i];
+			if ( ! r.is_match ) {
+				continue;
+			}
+			new_exprs = r.PreJobRankValue == -(FLT_MAX) && ! ( r.eval_errors & MatchmakerPool::EVAL_ERR_PRE_JOB_RANK ) &&
+				r.PostJobRankValue == expected[i].PostJobRankValue;
+			if ( r.has_preempt_rank ) {
+				preempt_ranks++;
+				int runtime = 0;
+				r.ad->LookupInteger( "TotalJobRuntime", runtime );
+				new_exprs = new_exprs && r.PreemptRankValue == (double)runtime;
+			}
+		}
+		check( "reconfig() with the same number of threads gives them the new rank expressions",
+		       new_exprs && preempt_ranks > 0 );
+		delete new_preempt;
+	}
+	check( "destroying the pool stops its threads",
+	       base_threads < 0 || count_threads() == base_threads );
+
+	delete pre;
+	delete post;
+	delete preempt;
+	for ( size_t i = 0; i < slots.size(); ++i ) {
+		delete slots[i];
+	}
+}
+
+int
+main( int /*argc*/, char ** /*argv*/ )
+{
+	test_serial_evaluation();
+	test_parallel_evaluation();
+	test_reconfig();
+
+	return check_results();
+}
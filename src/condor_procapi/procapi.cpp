@@ -117,6 +117,13 @@ procHashNode::procHashNode()
 	minfaultrate = 0L;
 	creation_time = 0L;
 	garbage = false;
+	env_cached = false;
+	penvid = NULL;
+}
+
+procHashNode::~procHashNode()
+{
+	delete penvid;
 }
 
 ProcAPI::~ProcAPI() {
@@ -252,7 +259,7 @@ ProcAPI::getProcInfo( pid_t pid, piPTR& pi, int &status )
 
 		   We don't care if it fails, its optional
 		*/
-	fillProcInfoEnv(pi);
+	fillProcInfoEnv(pi, procRaw.comm);
 
 		// success
 	return PROCAPI_SUCCESS;
@@ -267,9 +274,16 @@ ProcAPI::getPSSInfo( pid_t pid, procInfo& procRaw, int &status )
 	int number_of_attempts;
 	const int max_attempts = 5;
 
-	char *use_pss;
-	use_pss = getenv("_condor_USE_PSS");
-	if ((use_pss == 0) || (*use_pss == 'f') || (*use_pss == 'F')) {
+		// reading smaps is much more expensive than reading stat, since
+		// the kernel has to walk every mapping of the process, so only do
+		// it when PSS was asked for.  The environment doesn't change, so
+		// only look at it once.
+	static int use_pss = -1;
+	if (use_pss < 0) {
+		const char *env = getenv("_condor_USE_PSS");
+		use_pss = (env && *env != 'f' && *env != 'F') ? 1 : 0;
+	}
+	if ( ! use_pss) {
 		return PROCAPI_SUCCESS;
 	}
 
@@ -424,7 +438,7 @@ ProcAPI::getProcInfoRaw( pid_t pid, procInfoRaw& procRaw, int &status )
 // actually seems to work in Linux...nice, but annoyingly different.
 
 	char path[64];
-	FILE *fp;
+	int fd = -1;
 	
 	int number_of_attempts;
 	long i;
@@ -452,7 +466,7 @@ ProcAPI::getProcInfoRaw( pid_t pid, procInfoRaw& procRaw, int &status )
 		// set the sample time
 		procRaw.sample_time = secsSinceEpoch();
 
-		if( (fp = safe_fopen_wrapper_follow(path, "r")) == NULL ) {
+		if( (fd = safe_open_wrapper_follow(path, O_RDONLY)) < 0 ) {
 			if( errno == ENOENT ) {
 				// /proc/pid doesn't exist
 				status = PROCAPI_NOPID;
@@ -482,10 +496,12 @@ ProcAPI::getProcInfoRaw( pid_t pid, procInfoRaw& procRaw, int &status )
 	        // format of /proc/self/stat is
 	        // pid (ProcessName) State number number number number...
 	        // The process name can have spaces in it, so read the
-	        // whole line in with fgets, whack the spaces, then 
-	        // parse again with sprintf
-	        char line[512];
-		if (fgets(line, 512, fp) == NULL) {
+	        // whole line in with a single read, whack the spaces, then 
+	        // parse again with sscanf.  The kernel generates the whole
+	        // file on the first read, so there is no point in buffering it.
+	        char line[1024];
+		ssize_t line_len = read(fd, line, sizeof(line) - 1);
+		if (line_len <= 0) {
 			// couldn't read the right number of entries.
 			status = PROCAPI_UNSPECIFIED;
 			dprintf( D_ALWAYS, 
@@ -493,12 +509,13 @@ ProcAPI::getProcInfoRaw( pid_t pid, procInfoRaw& procRaw, int &status )
 				 path, errno,  strerror(errno));
 
 			// don't leak for the next attempt;
-			fclose( fp );
-			fp = NULL;
+			close( fd );
+			fd = -1;
 
 			// try again
 			continue;
 		}
+		line[line_len] = '\0';
 
 		char *rparen = strrchr(line, ')');
 		char *lparen = strchr(line, '(');
@@ -533,8 +550,8 @@ ProcAPI::getProcInfoRaw( pid_t pid, procInfoRaw& procRaw, int &status )
 				 path, line, errno );
 
 			// don't leak for the next attempt;
-			fclose( fp );
-			fp = NULL;
+			close( fd );
+			fd = -1;
 
 			// try again
 			continue;
@@ -542,6 +559,8 @@ ProcAPI::getProcInfoRaw( pid_t pid, procInfoRaw& procRaw, int &status )
 
 		// covert imgsize_bytes to k
 		procRaw.imgsize = imgsize_bytes/1024;
+		strncpy(procRaw.comm, s, sizeof(procRaw.comm) - 1);
+		procRaw.comm[sizeof(procRaw.comm) - 1] = '\0';
 
 		// do a small verification of the read in data...
 		if ( pid == procRaw.pid ) {
@@ -556,6 +575,10 @@ ProcAPI::getProcInfoRaw( pid_t pid, procInfoRaw& procRaw, int &status )
 		// number_of_attempts.
 		status = PROCAPI_GARBLED;
 
+		// don't leak for the next attempt;
+		close( fd );
+		fd = -1;
+
 	} 	// end of while number_of_attempts < 0
 
 	// Make sure the data is good before continuing.
@@ -569,19 +592,19 @@ ProcAPI::getProcInfoRaw( pid_t pid, procInfoRaw& procRaw, int &status )
 				"garbage! Aborting read.\n", num_attempts, path);
 		}
 
-		if (fp != NULL) {
-			fclose( fp );
-			fp = NULL;
+		if (fd >= 0) {
+			close( fd );
+			fd = -1;
 		}
 
 		return PROCAPI_FAILURE;
 	}
 
 	// grab the process owner uid
-	procRaw.owner = getFileOwner(fileno(fp));
+	procRaw.owner = getFileOwner(fd);
 
 		// close the file
-	fclose( fp );
+	close( fd );
 
 		// only one value for times
 	procRaw.user_time_2 = 0;
@@ -591,15 +614,45 @@ ProcAPI::getProcInfoRaw( pid_t pid, procInfoRaw& procRaw, int &status )
 }
 
 int 
-ProcAPI::fillProcInfoEnv(piPTR pi)
+ProcAPI::fillProcInfoEnv(piPTR pi, const char *comm)
 {
+		// the environment of a process only changes when it calls exec(),
+		// which keeps the pid and creation time, so if we've already read it
+		// for this process (do_usage_sampling() has just looked it up by pid
+		// and creation time) and it is still running the same program, use
+		// what we found then.
 	char path[64];
-	int read_size = (1024 * 1024);
+	std::string exe = comm;
+	char exe_path[PATH_MAX];
+	sprintf( path, "/proc/%d/exe", pi->pid );
+	ssize_t exe_len = readlink(path, exe_path, sizeof(exe_path));
+	if ( exe_len > 0 ) {
+		exe += ' ';
+		exe.append(exe_path, exe_len);
+	}
+
+	procHashNode *phn = NULL;
+	if ( procHash->lookup(pi->pid, phn) == 0 && phn->env_cached ) {
+		if ( phn->env_exe == exe ) {
+			if ( phn->penvid ) {
+				pidenvid_copy(&pi->penvid, phn->penvid);
+			}
+			return PROCAPI_SUCCESS;
+		}
+		phn->env_cached = false;
+		delete phn->penvid;
+		phn->penvid = NULL;
+	}
+
+	int read_size = (64 * 1024);
 	int bytes_read;
 	int bytes_read_so_far = 0;
 	int fd;
-	char *env_buffer = NULL;
-	int multiplier = 2;
+
+		// These are reused for every process, they only grow to fit the
+		// largest environment we have seen.
+	static std::vector<char> env_buffer;
+	static std::vector<char *> env_environ;
 
 		// open the environment proc file
 	sprintf( path, "/proc/%d/environ", pi->pid );
@@ -614,98 +667,80 @@ ProcAPI::fillProcInfoEnv(piPTR pi)
 		// buffer since the user supplies the environment and I don't want
 		// to produce a buffer overrun. However, you can't stat() this file
 		// to see how big it is so I just have to keep reading until I stop.
+		if (env_buffer.size() < (size_t)read_size) {
+			env_buffer.resize(read_size);
+		}
 		do {
-			if (env_buffer == NULL) {
-				env_buffer = (char*)malloc(sizeof(char) * read_size);
-				if ( env_buffer == NULL ) {
-					EXCEPT( "Procapi::getProcInfo: Out of memory!");
-				}
-			} else {
-				env_buffer = (char*)realloc(env_buffer, read_size * multiplier);
-				if ( env_buffer == NULL ) {
-					EXCEPT( "Procapi::getProcInfo: Out of memory!");
-				}
-				multiplier++;
-			}
-
-			bytes_read = full_read(fd, env_buffer+bytes_read_so_far, read_size);
+			read_size = (int)env_buffer.size() - bytes_read_so_far;
+			bytes_read = full_read(fd, &env_buffer[bytes_read_so_far], read_size);
 			// We have seen cases where read() returns a value in the 1GB
 			// range. Retrying after a lseek() and/or reopening the file
 			// gave the same result. So just give up in that case.
 			if ( bytes_read < 0 || bytes_read > read_size ) {
 				close( fd );
-				free( env_buffer );
 				return PROCAPI_SUCCESS;
 			}
 
 			bytes_read_so_far += bytes_read;
 
-			// if I read right up to the end of the buffer size, assume more...
-			// in the case of no more data, but this is true, then the buffer
-			// will grow again, but no more will be read.
+			// if I filled the buffer, assume more... in the case of no more
+			// data, but this is true, then the buffer will grow, but no more
+			// will be read.
+			if (bytes_read == read_size) {
+				env_buffer.resize(env_buffer.size() * 2);
+			}
 		} while (bytes_read == read_size);
 
 		close(fd);
 
 		// now convert the format, which are NUL delimited strings to the 
-		// usual format of an environ.
-
-		// count the entries
-		int entries = 0;
+		// usual format of an environ, with pointers to the strings in
+		// env_buffer and a NULL at the end.
+		env_environ.clear();
 		int index = 0;
-		while(index < bytes_read_so_far) {
-			if (env_buffer[index] == '\0') {
-				entries++;
-			}
-			index++;
-		}
-
-		// allocate a buffer to hold pointers to the strings in env_buffer so 
-		// it mimics and environ variable. The addition +1 is for the end NULL;
-		char **env_environ;
-		env_environ = (char**)malloc(sizeof(char *) * (entries + 1));
-		if (env_environ == NULL) {
-			EXCEPT( "Procapi::getProcInfo: Out of memory!");
-		}
-
-		// set up the pointers from the env_environ into the env_buffer
-		index = 0;
-		long i;
-		for (i = 0; i < entries; i++) {
-			env_environ[i] = &env_buffer[index];
+		while (index < bytes_read_so_far) {
+			env_environ.push_back(&env_buffer[index]);
 
 			// find the start of the next entry
 			while (index < bytes_read_so_far && env_buffer[index] != '\0') {
 				index++;
 			}
 
-			// move over the \0 to the start of the next piece. At the end
-			// of the buffer, this will point to garabge memory, but the for 
-			// loop index will fire and this index won't be used.
+			// move over the \0 to the start of the next piece.
 			index++;
 		}
-	
-		// the last entry must be NULL to simulate the environ variable.
-		env_environ[i] = NULL;
+		// an entry without a \0 at the end of the buffer is dropped, the
+		// environment was truncated there.
+		if (bytes_read_so_far > 0 && env_buffer[bytes_read_so_far - 1] != '\0') {
+			env_environ.pop_back();
+		}
+		env_environ.push_back(NULL);
 
 		// if this pid happens to have any ancestor environment id variables,
 		// then filter them out and put it into the PidEnvID table for this
 		// proc. 
-		if (pidenvid_filter_and_insert(&pi->penvid, env_environ) 
+		if (pidenvid_filter_and_insert(&pi->penvid, &env_environ[0]) 
 			== PIDENVID_OVERSIZED)
 		{
 			EXCEPT("ProcAPI::getProcInfo: Discovered too many ancestor id "
 					"environment variables in pid %u. Programmer Error.",
 					pi->pid);
 		}
+	}
 
-		// don't leak memory of the environ buffer
-		free(env_buffer);
-		env_buffer = NULL;
-
-		// get rid of the container to simulate the environ convention
-		free(env_environ);
-		env_environ = NULL;
+		// remember what we found, so we don't have to read it again.  Most
+		// processes don't have any ancestor ids, those don't need a copy.
+		// If we couldn't read the environment, or it was empty, as it is
+		// while a process is starting up or exiting, we try again next time.
+	if ( phn && fd != -1 && bytes_read_so_far > 0 ) {
+		phn->env_cached = true;
+		phn->env_exe = exe;
+		delete phn->penvid;
+		phn->penvid = NULL;
+		if ( pi->penvid.ancestors[0].active ) {
+			phn->penvid = new PidEnvID;
+			pidenvid_copy(phn->penvid, &pi->penvid);
+		}
 	}
 
 	return PROCAPI_SUCCESS;
@@ -1788,22 +1823,23 @@ ProcAPI::do_usage_sampling( piPTR& pi,
         }
     } 
 
-		// if we got that phn from the hashtable, remove it now.
-	if ( phn ) {
-		procHash->remove(pi->pid);
-	}
-
-		// put new vals back into hashtable
-	struct procHashNode * new_phn = new procHashNode;
-	new_phn->lasttime = now;
-	new_phn->oldtime  = ustime;   // store raw data for next call...
-	new_phn->oldminf  = nowminf;  //  ""
-	new_phn->oldmajf  = nowmajf;  //  ""
-	new_phn->oldusage = pi->cpuusage;  // Also store results in case the
-	new_phn->minfaultrate = pi->minfault;   // next sample is < 1 sec
-	new_phn->majfaultrate = pi->majfault;   // from now.
-	new_phn->creation_time = pi->creation_time;
-	procHash->insert( pi->pid, new_phn );
+		// if this is the first time we've seen this process, add it to
+		// the hashtable, otherwise update the node we found in place, which
+		// keeps anything else we know about the process (like its environment)
+	if ( ! phn ) {
+		phn = new procHashNode;
+		procHash->insert( pi->pid, phn );
+	}
+
+		// put new vals into the hashtable
+	phn->lasttime = now;
+	phn->oldtime  = ustime;   // store raw data for next call...
+	phn->oldminf  = nowminf;  //  ""
+	phn->oldmajf  = nowmajf;  //  ""
+	phn->oldusage = pi->cpuusage;  // Also store results in case the
+	phn->minfaultrate = pi->minfault;   // next sample is < 1 sec
+	phn->majfaultrate = pi->majfault;   // from now.
+	phn->creation_time = pi->creation_time;
 
 		// due to some funky problems, do some sanity checking here for
 		// strange numbers:
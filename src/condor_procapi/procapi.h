@@ -318,6 +318,8 @@ typedef struct procInfoRaw{
 // special process flags for Linux
 #ifdef LINUX
 	  unsigned long proc_flags;
+	  // the command name from /proc/<pid>/stat, in parentheses
+	  char comm[24];
 #endif //LINUX
 }procInfoRaw;
 
@@ -332,6 +334,8 @@ typedef struct procInfoRaw{
 struct procHashNode {
   /// Ctor
   procHashNode();
+  /// Dtor
+  ~procHashNode();
   /// the last time (secs) this data was retrieved.
   double lasttime;
   /// old cpu usage number (raw, not percent)
@@ -353,6 +357,18 @@ struct procHashNode {
 	  Then everytime we access this procHashNode we set it to false.  After an hour has passed,
 	  any node which still has garbage set to true is deleted. */
   bool garbage;
+  /** true once the ancestor environment ids of this process have been read
+	  from /proc/<pid>/environ, which only changes when the process calls
+	  exec(), so it only has to be read again when env_exe changes. */
+  bool env_cached;
+  /// the command name and executable of the process when env_cached was set
+  std::string env_exe;
+  /// the ancestor environment ids found, or NULL if there were none.
+  PidEnvID *penvid;
+
+ private:
+  procHashNode(const procHashNode &);
+  procHashNode & operator=(const procHashNode &);
 };
 
 /** pidHashFunc() is the hashing function used by ProcAPI for its
@@ -589,7 +605,7 @@ class ProcAPI {
 #ifdef LINUX
 	  // extracts the environment from the system
 	  // Currently only have a linux implementation
-  static int fillProcInfoEnv(piPTR);
+  static int fillProcInfoEnv(piPTR, const char *comm);
 	  // updates the statically stored boottime variable if neccessary
 	  // something similar probably belongs in sys_api
   static int checkBootTime(long now);
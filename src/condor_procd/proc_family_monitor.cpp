@@ -24,6 +24,7 @@
 #include "login_tracker.h"
 #include "environment_tracker.h"
 #include "parent_tracker.h"
+#include <chrono>
 
 #if !defined(WIN32)
 #include "glexec_kill.unix.h"
@@ -44,7 +45,10 @@ ProcFamilyMonitor::ProcFamilyMonitor(pid_t pid,
 	m_everybody_else(NULL),
 	m_family_table(pidHashFunc),
 	m_member_table(pidHashFunc),
-	m_except_if_pid_dies(except_if_pid_dies)
+	m_except_if_pid_dies(except_if_pid_dies),
+	m_snapshot_count(0),
+	m_snapshot_total_time(0.0),
+	m_snapshot_max_time(0.0)
 {
 	// the snapshot interval must either be non-negative or -1, which
 	// means infinite (higher layers should enforce this)
@@ -538,6 +542,8 @@ ProcFamilyMonitor::snapshot()
 {
 	dprintf(D_ALWAYS, "taking a snapshot...\n");
 
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+
 	// get a snapshot of all processes on the system
 	// TODO: should we do something here if ProcAPI returns a NULL result?
 	// (the algorithm below will handle it just fine, but its probably an
@@ -569,10 +575,13 @@ ProcFamilyMonitor::snapshot()
 	// processes of some sort), and the code below gets confused
 	// when multiple processes with a single PID are in our list
 	//
+	int num_procs = 0;
+	int num_known = 0;
 	procInfo** prev_ptr = &pi_list;
 	procInfo* curr = pi_list;
 	while (curr != NULL) {
 
+		num_procs++;
 		if (curr->pid == 0) {
 			*prev_ptr = curr->next;
 			delete curr;
@@ -591,6 +600,7 @@ ProcFamilyMonitor::snapshot()
 			//
 			*prev_ptr = curr->next;
 			pm->still_alive(curr);
+			num_known++;
 		}
 		else {
 			// this process is not in any of our families, so it stays
@@ -663,7 +673,22 @@ ProcFamilyMonitor::snapshot()
 	//
 	update_max_image_sizes(m_tree);
 
-	dprintf(D_ALWAYS, "...snapshot complete\n");
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	m_snapshot_count++;
+	m_snapshot_total_time += elapsed;
+	if (elapsed > m_snapshot_max_time) {
+		m_snapshot_max_time = elapsed;
+	}
+
+	dprintf(D_ALWAYS,
+	        "...snapshot complete: %d processes (%d already tracked) in %.3f seconds "
+	        "(%d snapshots, average %.3f seconds, max %.3f seconds)\n",
+	        num_procs,
+	        num_known,
+	        elapsed,
+	        m_snapshot_count,
+	        m_snapshot_total_time / m_snapshot_count,
+	        m_snapshot_max_time);
 }
 
 void
@@ -171,6 +171,14 @@ private:
 	// Otherwise we don't.
 	bool m_except_if_pid_dies;
 
+	// what our snapshots have cost so far: how many we've taken and the
+	// total and longest time one took, in seconds. these are logged after
+	// each snapshot
+	//
+	int m_snapshot_count;
+	double m_snapshot_total_time;
+	double m_snapshot_max_time;
+
 	// the "tracker" objects we use for finding processes that belong
 	// to the families we're tracking
 	//
@@ -51,6 +51,7 @@ JobCluster::JobCluster()
 #ifdef USE_AUTOCLUSTER_TO_JOBID_MAP
 	, keep_job_ids(false)
 #endif
+	, verify_sigs(false)
 {
 }
 
@@ -64,6 +65,7 @@ JobCluster::~JobCluster()
 void JobCluster::clear()
 {
 	cluster_map.clear();
+	cluster_sigs.clear();
 #ifdef USE_AUTOCLUSTER_TO_JOBID_MAP
 	cluster_use.clear();
 	cluster_gone.clear();
@@ -167,53 +169,170 @@ JobCluster::JobIdSetMap::iterator JobCluster::brute_force_find_job_id_set(const
 //
 void JobCluster::collect_garbage(bool brute_force) // free the deleted clusters
 {
-	if (cluster_gone.empty() && ! brute_force)
-		return;
-
-	// scan the cluster collection, checking to see if there are no longer any referring jobs.
-	JobSigidMap::iterator it;
-	for (it = cluster_map.begin(); it != cluster_map.end(); /*advance at bottom of loop!*/) {
-		bool gone = cluster_gone.find(it->second) != cluster_gone.end();
-		if (brute_force || gone) {
-			// found a deleted cluster. but we should double check to see that it's really unused.
-			JobIdSetMap::iterator jit = cluster_use.find(it->second);
-			if (jit != cluster_use.end()) {
-				gone = false;
-				if (brute_force) {
-					gone = true;
-					JOB_ID_KEY jid;
-					jit->second.rewind();
-					while (jit->second.next(jid)) {
-						if (GetJobAd(jid)) {
-							gone = false;
-							break;
-						}
-					}
-					if (gone) { cluster_use.erase(jit); }
+	if (brute_force) {
+		for (JobIdSetMap::iterator jit = cluster_use.begin(); jit != cluster_use.end(); ++jit) {
+			bool gone = true;
+			JOB_ID_KEY jid;
+			jit->second.rewind();
+			while (jit->second.next(jid)) {
+				if (GetJobAd(jid)) {
+					gone = false;
+					break;
 				}
 			}
+			if (gone) { cluster_gone.insert(jit->first); }
 		}
-		// advance here so that we can erase the previous entry if needed.
-		JobSigidMap::iterator last = it++;
-		if (gone) { cluster_map.erase(last); }
+	}
+
+	// only the autoclusters that lost their last job need to be looked at,
+	// but double check that they are still unused, since a job may have rejoined.
+	for (std::set<int>::iterator it = cluster_gone.begin(); it != cluster_gone.end(); ++it) {
+		JobIdSetMap::iterator jit = cluster_use.find(*it);
+		if (jit != cluster_use.end()) {
+			if ( ! brute_force && ! jit->second.empty()) {
+				continue;
+			}
+			cluster_use.erase(jit);
+		}
+		erase_cluster(*it);
 	}
 	cluster_gone.clear();
 }
 
 #endif
 
+void JobCluster::erase_cluster(int id)
+{
+	JobClusterSigMap::iterator it = cluster_sigs.find(id);
+	if (it != cluster_sigs.end()) {
+		JobSigidMap::iterator mit = cluster_map.find(it->second.hash);
+		if (mit != cluster_map.end() && mit->second == id) {
+			cluster_map.erase(mit);
+		}
+		cluster_sigs.erase(it);
+	}
+}
+
 extern int    last_autocluster_classad_cache_hit;
 
+// A streaming form of the 128 bit (x64) MurmurHash3 hash from
+// http://code.google.com/p/smhasher/wiki/MurmurHash3
+// used to hash the signature of a job without building it as a string.
+//
+class JobSignatureHasher {
+public:
+	JobSignatureHasher() : h1(0), h2(0), total(0), tail_len(0) {}
+	void add(const char * data, size_t len);
+	void add(const std::string & str) { add(str.data(), str.size()); }
+	JobSignatureHash finish();
+
+private:
+	static uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+	static uint64_t load64(const unsigned char * p) { uint64_t k; memcpy(&k, p, sizeof(k)); return k; }
+	static uint64_t fmix64(uint64_t k) {
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdULL;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53ULL;
+		k ^= k >> 33;
+		return k;
+	}
+	void mix_k1(uint64_t k1) { k1 *= c1; k1 = rotl64(k1,31); k1 *= c2; h1 ^= k1; }
+	void mix_k2(uint64_t k2) { k2 *= c2; k2 = rotl64(k2,33); k2 *= c1; h2 ^= k2; }
+	void block(const unsigned char * p) {
+		mix_k1(load64(p));
+		h1 = rotl64(h1,27); h1 += h2; h1 = h1*5+0x52dce729;
+		mix_k2(load64(p+8));
+		h2 = rotl64(h2,31); h2 += h1; h2 = h2*5+0x38495ab5;
+	}
+
+	static const uint64_t c1 = 0x87c37b91114253d5ULL;
+	static const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+	uint64_t h1, h2;
+	size_t total;
+	unsigned char tail[16];
+	size_t tail_len;
+};
+
+void JobSignatureHasher::add(const char * data, size_t len)
+{
+	const unsigned char * p = (const unsigned char *)data;
+	total += len;
+	if (tail_len) {
+		size_t cb = MIN(sizeof(tail) - tail_len, len);
+		memcpy(tail + tail_len, p, cb);
+		tail_len += cb;
+		p += cb;
+		len -= cb;
+		if (tail_len < sizeof(tail)) {
+			return;
+		}
+		block(tail);
+		tail_len = 0;
+	}
+	for ( ; len >= sizeof(tail); p += sizeof(tail), len -= sizeof(tail)) {
+		block(p);
+	}
+	if (len) {
+		memcpy(tail, p, len);
+		tail_len = len;
+	}
+}
+
+JobSignatureHash JobSignatureHasher::finish()
+{
+	uint64_t k1 = 0, k2 = 0;
+	for (size_t ix = tail_len; ix > 8; --ix) {
+		k2 ^= (uint64_t)tail[ix-1] << ((ix-9)*8);
+	}
+	if (tail_len > 8) { mix_k2(k2); }
+	for (size_t ix = MIN(tail_len, 8); ix > 0; --ix) {
+		k1 ^= (uint64_t)tail[ix-1] << ((ix-1)*8);
+	}
+	if (tail_len) { mix_k1(k1); }
+
+	h1 ^= total; h2 ^= total;
+	h1 += h2; h2 += h1;
+	h1 = fmix64(h1); h2 = fmix64(h2);
+	h1 += h2; h2 += h1;
+
+	JobSignatureHash sig;
+	sig.lo = h1;
+	sig.hi = h2;
+	return sig;
+}
+
+// add "attr = value\n" to the signature hash.  The value is always unparsed,
+// even when the expression cache holds its text, because that text is just
+// whatever the first job with the value had, white space and all.  Hashing it
+// would put jobs with identical values into different autoclusters depending
+// on whether their values came through the cache.
+static void
+hash_sig_item(JobSignatureHasher & hasher, const std::string & attr, ExprTree * tree, classad::ClassAdUnParser & unp, std::string & buf)
+{
+	hasher.add(attr);
+	hasher.add(" = ", 3);
+	if (tree) {
+		buf.clear();
+		unp.Unparse(buf, tree);
+		hasher.add(buf);
+	}
+	hasher.add("\n", 1);
+}
+
 int JobCluster::getClusterid(JobQueueJob & job, bool expand_refs, std::string * final_list)
 {
 	int cur_id = -1;
 
-	// we want to summarize job into a string "signature"
+	// we want to summarize job into a "signature"
 	// the signature will consist of "key1=val1\nkey2=val2\n"
 	// for each of the keys in the significant_attrs list and (if expand_refs is true)
 	// the keys that the significant_attrs values refer to that are internal references.
 	// the order of the keys in the signature will be the same as the order specified in significant_attrs
 	// followed by the expanded keys in case-insensitive alpha order.
+	// Rather than building the signature as a string, we hash it, and only build
+	// the string when the hash is new (or when verifying the hash).
 
 	// first put build a set of class ad values, one for each significant attribute
 	//
@@ -253,24 +372,19 @@ int JobCluster::getClusterid(JobQueueJob & job, bool expand_refs, std::string *
 
 	// sigset now contains the values of all the attributes we need,
 	// significant attibutes are first, followed by expanded attributes
-	// we build a signature essentially by printing it all out in one big string
+	// hash the signature, and build the final list of attributes
 	//
 	bool need_sep = false; // true after the first item, (when we need to print separators)
-	std::string signature;
-	signature.reserve(strlen(significant_attrs) + exattrs.size()*20 + sigset.size()*20); // make a guess as to how much space the signature will take.
-
 	classad::ClassAdUnParser unp;
 	unp.SetOldClassAd( true, true );
+	JobSignatureHasher hasher;
+	std::string buf;
 
 	// first put the pre-defined significant attrs in the sig
 	list.rewind();
 	int ix = 0;
 	while ((attr = list.next_string())) {
-		ExprTree * tree = sigset[ix];
-		signature += *attr;
-		signature += " = ";
-		if (tree) { unp.Unparse(signature, tree); }
-		signature += '\n';
+		hash_sig_item(hasher, *attr, sigset[ix], unp, buf);
 		if (final_list) {
 			if (need_sep) { (*final_list) += ','; }
 			final_list->append(*attr);
@@ -281,11 +395,7 @@ int JobCluster::getClusterid(JobQueueJob & job, bool expand_refs, std::string *
 
 	// now put out the expanded attribs (if any)
 	for (classad::References::iterator it = exattrs.begin(); it != exattrs.end(); ++it) {
-		ExprTree * tree = sigset[ix];
-		signature += *it;
-		signature += " = ";
-		if (tree) { unp.Unparse(signature, tree); }
-		signature += '\n';
+		hash_sig_item(hasher, *it, sigset[ix], unp, buf);
 		if (final_list) {
 			if (need_sep) { (*final_list) += ','; }
 			final_list->append(*it);
@@ -293,17 +403,57 @@ int JobCluster::getClusterid(JobQueueJob & job, bool expand_refs, std::string *
 		}
 		++ix;
 	}
+	JobSignatureHash hash = hasher.finish();
+
+	// print the signature as a string, this is needed for new autoclusters so that
+	// they can be returned by an aggregation query, or when verifying the hash
+	auto print_signature = [&](std::string & signature) {
+		signature.reserve(strlen(significant_attrs) + exattrs.size()*20 + sigset.size()*20); // make a guess as to how much space the signature will take.
+		list.rewind();
+		int jx = 0;
+		while ((attr = list.next_string())) {
+			ExprTree * tree = sigset[jx++];
+			signature += *attr;
+			signature += " = ";
+			if (tree) { unp.Unparse(signature, tree); }
+			signature += '\n';
+		}
+		for (classad::References::iterator it = exattrs.begin(); it != exattrs.end(); ++it) {
+			ExprTree * tree = sigset[jx++];
+			signature += *it;
+			signature += " = ";
+			if (tree) { unp.Unparse(signature, tree); }
+			signature += '\n';
+		}
+	};
+	std::string signature;
+	if (verify_sigs) {
+		print_signature(signature);
+	}
 
-	// now check the signature against the current cluster map
+	// now check the signature hash against the current cluster map
 	// and either return the matching cluster id, or a new cluster id.
 	JobSigidMap::iterator it;
-	it = cluster_map.find(signature);
-	if (it != cluster_map.end()) {
-		cur_id = it->second;
+	while ((it = cluster_map.find(hash)) != cluster_map.end()) {
+		if ( ! verify_sigs || cluster_sigs[it->second].signature == signature) {
+			cur_id = it->second;
+			break;
+		}
+		// two different signatures have the same hash, perturb the hash until it is unique
+		dprintf(D_ALWAYS | D_ERROR, "Autocluster signature hash collision between autocluster %d and job %d.%d\n",
+			it->second, job.jid.cluster, job.jid.proc);
+		hash.lo += 1;
 	}
-	else {
+	if (cur_id < 0) {
 		cur_id = next_id++;
-		cluster_map.insert(JobSigidMap::value_type(signature,cur_id));
+		cluster_map.insert(JobSigidMap::value_type(hash,cur_id));
+		JobClusterSig & sig = cluster_sigs[cur_id];
+		sig.hash = hash;
+		if (verify_sigs) {
+			sig.signature.swap(signature);
+		} else {
+			print_signature(sig.signature);
+		}
 	}
 
 #ifdef USE_AUTOCLUSTER_TO_JOBID_MAP
@@ -507,6 +657,8 @@ bool AutoCluster::config(const classad::References &basic_attrs, const char* sig
 
 	}
 
+	verifySignatures(param_boolean("AUTOCLUSTER_VERIFY_SIGNATURES", false));
+
 	bool replace_attrs = sig_attrs_came_from_config_file;
 	bool changed = this->setSigAttrs(new_sig_attrs, true, replace_attrs);
 	if (changed) {
@@ -535,21 +687,29 @@ void AutoCluster::mark()
 
 void AutoCluster::sweep()
 {
-	JobSigidMap::iterator it,next;
-	for( it = cluster_map.begin();
-		 it != cluster_map.end();
+#ifdef USE_AUTOCLUSTER_TO_JOBID_MAP
+	if (keep_job_ids) {
+		// we know which jobs are in each autocluster, so only the autoclusters
+		// that lost their last job since the last sweep need to be removed.
+		collect_garbage(false);
+		return;
+	}
+#endif
+	JobClusterSigMap::iterator it,next;
+	for( it = cluster_sigs.begin();
+		 it != cluster_sigs.end();
 		 it = next )
 	{
 		next = it;
 		next++; // avoid invalid iterator if we delete this element
 
-		int id = it->second;
+		int id = it->first;
 		JobClusterIDs::iterator in_use;
 		in_use = cluster_in_use.find(id);
 		if (in_use == cluster_in_use.end()) {
 				// found an entry to remove.
 			dprintf(D_FULLDEBUG,"removing auto cluster id %d\n",id);
-			cluster_map.erase( it );
+			erase_cluster(id);
 		}
 	}
 }
@@ -646,6 +806,7 @@ void AutoCluster::removeFromAutocluster(JobQueueJob &job)
 		JobIdSetMap::iterator it = cluster_use.find(job.autocluster_id);
 		if (it != cluster_use.end()) {
 			it->second.erase(job.jid);
+			if (it->second.empty()) { cluster_gone.insert(job.autocluster_id); }
 		}
 #endif
 		job.Delete(ATTR_AUTO_CLUSTER_ID);
@@ -739,17 +900,17 @@ bool JobAggregationResults::compute()
 bool JobAggregationResults::rewind()
 {
 	results_returned = 0;
-	pause_position.clear();
-	it = jc.cluster_map.begin();
-	return it != jc.cluster_map.end();
+	pause_position = -1;
+	it = jc.cluster_sigs.begin();
+	return it != jc.cluster_sigs.end();
 }
 
 // pause iterator, remember the key of the current item, when we resume
 // we will pick back up at that point.
 void JobAggregationResults::pause()
 {
-	pause_position.clear();
-	if (it != jc.cluster_map.end()) {
+	pause_position = -1;
+	if (it != jc.cluster_sigs.end()) {
 		pause_position = it->first;
 	}
 }
@@ -763,34 +924,34 @@ ClassAd * JobAggregationResults::next()
 
 	// if we are resuming from a paused state, we don't have a valid iterator
 	// so we have to find the the element we paused at or the first one after it.
-	if ( ! pause_position.empty()) {
-		it = jc.cluster_map.lower_bound(pause_position);
-		pause_position.clear();
+	if (pause_position >= 0) {
+		it = jc.cluster_sigs.lower_bound(pause_position);
+		pause_position = -1;
 	}
 
 	// in case we never enter the loop, clear our 'current' ad here.
 	ad.Clear();
 
 	// we may have to look at multiple items in order to find one to return
-	while (it != jc.cluster_map.end()) {
+	while (it != jc.cluster_sigs.end()) {
 
 		ad.Clear();
 
-		// the autocluster key (or signature), is a string containing key value
+		// the autocluster signature, is a string containing key value
 		// pairs separated by \n. So we can easily turn it into a classad.
-		StringTokenIterator iter(it->first, 100, "\n");
+		StringTokenIterator iter(it->second.signature, 100, "\n");
 		const char * line;
 		while ((line = iter.next())) {
 			(void) ad.Insert(line);
 		}
 		if (this->is_def_autocluster) {
-			ad.Assign(ATTR_AUTO_CLUSTER_ID,it->second);
+			ad.Assign(ATTR_AUTO_CLUSTER_ID,it->first);
 		} else {
-			ad.Assign("Id",it->second);
+			ad.Assign("Id",it->first);
 		}
 	#ifdef USE_AUTOCLUSTER_TO_JOBID_MAP
 		int cJobs = 0;
-		JobCluster::JobIdSetMap::iterator jit = jc.cluster_use.find(it->second);
+		JobCluster::JobIdSetMap::iterator jit = jc.cluster_use.find(it->first);
 		if (jit != jc.cluster_use.end()) {
 			JobIdSet & jids = jit->second;
 			cJobs = jids.count();
@@ -26,11 +26,22 @@
 
 #include "condor_classad.h"
 #include <generic_stats.h>
+#include <unordered_map>
 
 class JobIdSet;
 class JobAggregationResults;
 class JobQueueJob;
 
+// 128 bit hash of the signature of a job, see JobCluster::getClusterid
+struct JobSignatureHash {
+	uint64_t lo;
+	uint64_t hi;
+	bool operator==(const JobSignatureHash & rhs) const { return lo == rhs.lo && hi == rhs.hi; }
+};
+struct JobSignatureHashHasher {
+	size_t operator()(const JobSignatureHash & sig) const { return (size_t)sig.lo; }
+};
+
 class JobCluster {
 public:
 	JobCluster();
@@ -40,6 +51,8 @@ public:
 #ifdef USE_AUTOCLUSTER_TO_JOBID_MAP
 	void keepJobIds(bool keep) { keep_job_ids = keep; }
 #endif
+	// when true, check that jobs with the same signature hash really have the same signature
+	void verifySignatures(bool verify) { verify_sigs = verify; }
 	int getClusterid(JobQueueJob &job, bool expand_refs, std::string * final_list);
 	int size();
 	void clear();
@@ -50,8 +63,15 @@ public:
 
 protected:
 	friend class JobAggregationResults;
-	typedef std::map<std::string,int> JobSigidMap;
-	JobSigidMap cluster_map;  // map of signature to a cluster id
+	typedef std::unordered_map<JobSignatureHash, int, JobSignatureHashHasher> JobSigidMap;
+	JobSigidMap cluster_map;  // map of signature hash to a cluster id
+	struct JobClusterSig {
+		JobSignatureHash hash;
+		std::string signature; // "key1 = val1\nkey2 = val2\n" for each significant attribute
+	};
+	typedef std::map<int, JobClusterSig> JobClusterSigMap;
+	JobClusterSigMap cluster_sigs; // map of cluster id to its signature
+	void erase_cluster(int id);  // remove a cluster from cluster_map and cluster_sigs
 #ifdef USE_AUTOCLUSTER_TO_JOBID_MAP
 	typedef std::map<int, JobIdSet> JobIdSetMap;
 	JobIdSetMap cluster_use; // map clusterId to a set of jobIds
@@ -63,6 +83,7 @@ protected:
 #ifdef USE_AUTOCLUSTER_TO_JOBID_MAP
 	bool keep_job_ids;
 #endif
+	bool verify_sigs;
 };
 
 /** This class manages the computation auto cluster ids for jobs based
@@ -164,7 +185,7 @@ protected:
 class JobAggregationResults {
 public:
 	JobAggregationResults(JobCluster& jc_, const char * proj_, int limit_, classad::ExprTree * constraint_=NULL, bool is_def_=false)
-		: jc(jc_), projection(proj_?proj_:""), constraint(NULL), is_def_autocluster(is_def_), return_jobid_limit(0), result_limit(limit_), results_returned(0)
+		: jc(jc_), projection(proj_?proj_:""), constraint(NULL), is_def_autocluster(is_def_), return_jobid_limit(0), result_limit(limit_), results_returned(0), pause_position(-1)
 	{
 		if (constraint_) constraint = constraint_->Copy();
 	}
@@ -190,8 +211,8 @@ protected:
 	int  result_limit;
 	int  results_returned;
 	ClassAd ad;
-	JobCluster::JobSigidMap::iterator it;
-	std::string pause_position; // holds the key that the iterator was pointing to before we paused.
+	JobCluster::JobClusterSigMap::iterator it;
+	int pause_position; // holds the cluster id that the iterator was pointing to before we paused, or -1
 };
 
 
@@ -27,6 +27,7 @@
 
 #include "basename.h"
 #include "qmgmt.h"
+#include "qmgmt_group_commit.h"
 #include "condor_qmgr.h"
 #include "classad_collection.h"
 #include "prio_rec.h"
@@ -109,12 +110,17 @@ ClassAdLog<K,AD>::filter_iterator::operator++(int)
 		}
 
 		if (m_requirements) {
-			classad::ExprTree &requirements = *const_cast<classad::ExprTree*>(m_requirements);
-			const classad::ClassAd *old_scope = requirements.GetParentScope();
-			requirements.SetParentScope( tmp_ad );
 			classad::Value result;
-			int retval = requirements.Evaluate(result);
-			requirements.SetParentScope(old_scope);
+			int retval;
+			if (m_program) {
+				retval = m_program->Evaluate(tmp_ad, result);
+			} else {
+				classad::ExprTree &requirements = *const_cast<classad::ExprTree*>(m_requirements);
+				const classad::ClassAd *old_scope = requirements.GetParentScope();
+				requirements.SetParentScope( tmp_ad );
+				retval = requirements.Evaluate(result);
+				requirements.SetParentScope(old_scope);
+			}
 			if (!retval) {
 				dprintf(D_FULLDEBUG, "Unable to evaluate ad.\n");
 				continue;
@@ -239,6 +245,26 @@ static void HandleFlushJobQueueLogTimer();
 static int dirty_notice_interval = 0;
 static void PeriodicDirtyAttributeNotification();
 static void ScheduleJobQueueLogFlush();
+static int handle_q_continue(Stream *sock);
+
+// The schedd's side of the group commit of the job queue log, see
+// JobQueueGroupCommit.  The data of each connection is its QmgmtPeer.
+class ScheddGroupCommit : public JobQueueGroupCommit {
+ public:
+	ScheddGroupCommit() : m_timer_id(-1) {}
+
+ protected:
+	void syncLog();
+	void scheduleSync(int delay_ms);
+	bool resume(ReliSock *sock, void *data);
+	void close(ReliSock *sock, void *data);
+
+ private:
+	void timerFired() { m_timer_id = -1; sync(); }
+
+	int m_timer_id;
+};
+static ScheddGroupCommit group_commit;
 
 bool qmgmt_all_users_trusted = false;
 static std::vector<std::string> super_users;
@@ -1270,6 +1296,7 @@ InitQmgmt()
     cluster_maximum_val = param_integer("SCHEDD_CLUSTER_MAXIMUM_VALUE",0,0);
 
 	flush_job_queue_log_delay = param_integer("SCHEDD_JOB_QUEUE_LOG_FLUSH_DELAY",5,0);
+	group_commit.config();
 	dirty_notice_interval = param_integer("SCHEDD_JOB_QUEUE_NOTIFY_UPDATES",30,0);
 }
 
@@ -2069,6 +2096,10 @@ DestroyJobQueue( void )
 	// object deleted by the time the child cleanup is attempted.
 	schedd_forker.DeleteAll( );
 
+		// Clients waiting for their commits to be synced get their
+		// replies now.
+	group_commit.sync();
+
 	if (JobQueueDirty) {
 			// We can't destroy it until it's clean.
 		CleanJobQueue();
@@ -2861,7 +2892,14 @@ handle_q(int cmd, Stream *sock)
 				break;
 			}
 		}
-	} while(rval >= 0);
+	} while(rval == 0);
+
+	if( rval > 0 ) {
+			// The connection was set aside until its commit is synced,
+			// see JobQueueGroupCommit.
+		ASSERT( fork_status != FORK_CHILD );
+		return KEEP_STREAM;
+	}
 
 
 	unsetQSock();
@@ -2885,6 +2923,50 @@ handle_q(int cmd, Stream *sock)
 	return 0;
 }
 
+// Called when a connection set aside by the group commit has more
+// requests for us.
+static int
+handle_q_continue(Stream *sock)
+{
+	QmgmtPeer *peer = (QmgmtPeer *)daemonCore->GetDataPtr();
+	ASSERT( peer && peer->getReliSock() == sock );
+
+	if( sock->deadline_expired() ) {
+		dprintf( D_FULLDEBUG, "QMGR Connection from %s was idle for too long, closing it\n",
+		         sock->peer_description() );
+		delete peer;
+		return 0;
+	}
+	sock->set_deadline( 0 );
+
+	if( Q_SOCK ) {
+		unsetQSock();
+	}
+	if( !setQmgmtConnectionInfo(peer) ) {
+		EXCEPT("handle_q_continue: Unable to set the qmgmt connection!!");
+	}
+
+		// Queries that fork are only made on read-only connections,
+		// which are never set aside.
+	bool may_fork = false;
+	int rval;
+	do {
+		rval = do_Q_request( *Q_SOCK, may_fork );
+	} while(rval == 0);
+
+	if( rval > 0 ) {
+			// set aside again, until the next sync
+		daemonCore->Cancel_Socket( sock );
+		return KEEP_STREAM;
+	}
+
+	unsetQSock();
+	dprintf(D_FULLDEBUG, "QMGR Connection closed\n");
+	AbortTransactionAndRecomputeClusters();
+
+	return 0;
+}
+
 int GetMyProxyPassword (int, int, char **);
 
 int get_myproxy_password_handler(int /*i*/, Stream *socket) {
@@ -5004,6 +5086,49 @@ HandleFlushJobQueueLogTimer()
 	JobQueue->FlushLog();
 }
 
+void
+ScheddGroupCommit::syncLog()
+{
+		// A durable commit or a log rotation since may have done it
+		// for us already.
+	if (JobQueue->GetSyncedSeq() != JobQueue->GetCommitSeq()) {
+		JobQueue->ForceLog();
+	}
+}
+
+void
+ScheddGroupCommit::scheduleSync(int delay_ms)
+{
+	if (m_timer_id != -1) {
+		daemonCore->Cancel_Timer(m_timer_id);
+		m_timer_id = -1;
+	}
+	if (delay_ms >= 0) {
+		m_timer_id = daemonCore->Register_Timer_Ms(delay_ms, 0,
+			(TimerHandlercpp)&ScheddGroupCommit::timerFired,
+			"JobQueueGroupCommit::sync", this);
+	}
+}
+
+bool
+ScheddGroupCommit::resume(ReliSock *sock, void *data)
+{
+	if (daemonCore->Register_Socket(sock, "QMGMT connection",
+			handle_q_continue, "handle_q_continue") < 0)
+	{
+		return false;
+	}
+	daemonCore->Register_DataPtr(data);
+	return true;
+}
+
+void
+ScheddGroupCommit::close(ReliSock *sock, void *data)
+{
+	delete (QmgmtPeer *)data;
+	delete sock;
+}
+
 int
 SetTimerAttribute( int cluster, int proc, const char *attr_name, int dur )
 {
@@ -5632,7 +5757,7 @@ AddSessionAttributes(const std::list<std::string> &new_ad_keys)
 	}
 }
 
-int CommitTransactionInternal( bool durable, CondorError * errorStack );
+int CommitTransactionInternal( bool durable, CondorError * errorStack, bool defer_sync = false );
 
 void
 CommitTransactionOrDieTrying() {
@@ -5676,7 +5801,33 @@ CommitTransactionAndLive( SetAttributeFlags_t flags,
 	return CommitTransactionInternal( durable, errorStack );
 }
 
-int CommitTransactionInternal( bool durable, CondorError * errorStack ) {
+int
+CommitTransactionAndDeferSync( SetAttributeFlags_t flags,
+                               CondorError * errorStack,
+                               bool may_defer,
+                               bool & sync_deferred )
+{
+	sync_deferred = false;
+	if( !may_defer || flags != 0 || !group_commit.enabled() ) {
+		return CommitTransactionAndLive( flags, errorStack );
+	}
+
+		// an empty transaction writes nothing, so there is nothing to wait for
+	unsigned long seq = JobQueue->GetCommitSeq();
+	int rval = CommitTransactionInternal( true, errorStack, true );
+	sync_deferred = rval >= 0 && JobQueue->GetCommitSeq() != seq;
+	return rval;
+}
+
+void
+DeferCommitTransactionReply( int terrno, CondorError * errstack )
+{
+	QmgmtPeer *peer = getQmgmtConnectionInfo();
+	ASSERT( peer );
+	group_commit.defer( peer->getReliSock(), peer, terrno, errstack );
+}
+
+int CommitTransactionInternal( bool durable, CondorError * errorStack, bool defer_sync ) {
 
 	std::list<std::string> new_ad_keys;
 	
@@ -5756,6 +5907,10 @@ int CommitTransactionInternal( bool durable, CondorError * errorStack ) {
 		JobQueue->CommitNondurableTransaction(commit_comment);
 		ScheduleJobQueueLogFlush();
 	}
+	else if( defer_sync ) {
+			// the caller waits for the group commit to sync it
+		JobQueue->CommitNondurableTransaction(commit_comment);
+	}
 	else {
 		JobQueue->CommitTransaction(commit_comment);
 	}
@@ -535,6 +535,14 @@ private:
 	bool completed;
 };
 
+// Group commit of the job queue log, see SCHEDD_JOB_QUEUE_GROUP_COMMIT_WINDOW.
+// If may_defer and group commit is enabled, a durable commit is written to
+// the log but not synced, and sync_deferred is set.  The CommitTransaction
+// RPC then hands its reply to DeferCommitTransactionReply(), which sets the
+// connection aside and sends the reply once a sync covers the commit.
+int CommitTransactionAndDeferSync(SetAttributeFlags_t flags, CondorError * errorStack, bool may_defer, bool & sync_deferred);
+void DeferCommitTransactionReply(int terrno, CondorError * errstack);
+
 // new for 8.3, use a non-string type as the key for the JobQueue
 // and a type derived from ClassAd for the payload.
 typedef JOB_ID_KEY JobQueueKey;
@@ -0,0 +1,139 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "condor_classad.h"
+#include "condor_version.h"
+#include "qmgmt_group_commit.h"
+
+int
+SendCommitTransactionReply(ReliSock *syscall_sock, int rval, int terrno, CondorError &errstack)
+{
+	syscall_sock->encode();
+	if( !syscall_sock->code(rval) ) {
+		return -1;
+	}
+	const CondorVersionInfo *vers = syscall_sock->get_peer_version();
+	bool send_classad = vers && vers->built_since_version(8, 3, 4);
+	bool always_send_classad = vers && vers->built_since_version(8, 7, 4);
+	if( rval < 0 ) {
+		if( !syscall_sock->code(terrno) ) {
+			return -1;
+		}
+	}
+	if( rval < 0 && send_classad ) {
+		// Send a classad, for less backwards-incompatibility.
+		int code = 1;
+		const char * reason = "QMGMT rejected job submission.";
+		if(! errstack.empty()) {
+			code = 2;
+			reason = errstack.message();
+		}
+
+		ClassAd reply;
+		reply.Assign( "ErrorCode", code );
+		reply.Assign( "ErrorReason", reason );
+		if( !putClassAd( syscall_sock, reply ) ) {
+			return -1;
+		}
+	} else if( always_send_classad ) {
+		ClassAd reply;
+
+		std::string reason;
+		if(! errstack.empty()) {
+			reason = errstack.getFullText();
+			reply.Assign( "WarningReason", reason );
+		}
+
+		if( !putClassAd( syscall_sock, reply ) ) {
+			return -1;
+		}
+	}
+
+	if( !syscall_sock->end_of_message() ) {
+		return -1;
+	}
+	return 0;
+}
+
+void
+JobQueueGroupCommit::config()
+{
+	m_window_ms = param_integer("SCHEDD_JOB_QUEUE_GROUP_COMMIT_WINDOW", 0, 0);
+	m_max_commits = param_integer("SCHEDD_JOB_QUEUE_GROUP_COMMIT_MAX", 100, 1);
+	if ( ! enabled()) {
+		sync();
+	}
+}
+
+void
+JobQueueGroupCommit::defer(ReliSock *sock, void *data, int terrno, CondorError *errstack)
+{
+	Waiting w;
+	w.sock = sock;
+	w.data = data;
+	w.terrno = terrno;
+	w.errstack = errstack;
+	m_waiting.push_back(w);
+
+	if ((int)m_waiting.size() >= m_max_commits) {
+			// the group is full, sync as soon as we are back in DaemonCore
+		scheduleSync(0);
+		m_sync_scheduled = true;
+	} else if ( ! m_sync_scheduled) {
+		scheduleSync(m_window_ms);
+		m_sync_scheduled = true;
+	}
+}
+
+void
+JobQueueGroupCommit::sync()
+{
+	if (m_sync_scheduled) {
+		scheduleSync(-1);
+		m_sync_scheduled = false;
+	}
+	if (m_waiting.empty()) {
+		return;
+	}
+
+	syncLog();
+	dprintf(D_FULLDEBUG, "Synced job queue log for %d commits\n", (int)m_waiting.size());
+
+	std::vector<Waiting> waiting;
+	waiting.swap(m_waiting);
+	for (size_t i = 0; i < waiting.size(); ++i) {
+		ReliSock *sock = waiting[i].sock;
+
+		bool keep = SendCommitTransactionReply(sock, 0, waiting[i].terrno, *waiting[i].errstack) >= 0;
+		delete waiting[i].errstack;
+		if (keep) {
+				// an idle client must not hold its connection forever
+			sock->set_deadline_timeout(QMGMT_TIMEOUT);
+			if (resume(sock, waiting[i].data)) {
+				continue;
+			}
+		}
+
+		dprintf(D_FULLDEBUG, "QMGR Connection closed\n");
+		close(sock, waiting[i].data);
+	}
+}
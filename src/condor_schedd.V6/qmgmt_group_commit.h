@@ -0,0 +1,86 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef _QMGMT_GROUP_COMMIT_H
+#define _QMGMT_GROUP_COMMIT_H
+
+#include "dc_service.h"
+#include "reli_sock.h"
+#include "CondorError.h"
+
+#include <vector>
+
+// How long a connection that was set aside may go without sending its
+// next request once it has its reply, which is as long as the clients
+// wait for the schedd (SHADOW_QMGMT_TIMEOUT).
+#define QMGMT_TIMEOUT 300
+
+// Sends the reply to a CommitTransaction RPC, returns -1 if it could not
+// be sent.
+int SendCommitTransactionReply(ReliSock * sock, int rval, int terrno, CondorError & errstack);
+
+// Group commit of the job queue log.  When the window is not 0, a
+// CommitTransaction RPC writes its transaction to the log without
+// syncing it, and the connection is set aside.  One sync then covers
+// every commit made within the window (or up to max_commits of them),
+// after which each client gets its reply and its connection is
+// watched for more requests again, for up to QMGMT_TIMEOUT seconds.
+//
+// This class decides when to sync and sends the replies; the schedd's
+// subclass (in qmgmt.cpp) provides the timer, the log and DaemonCore's
+// watch of the connections.
+class JobQueueGroupCommit : public Service {
+ public:
+	JobQueueGroupCommit() : m_window_ms(0), m_max_commits(1), m_sync_scheduled(false) {}
+	virtual ~JobQueueGroupCommit() {}
+
+	void config();
+	bool enabled() const { return m_window_ms > 0; }
+	size_t numWaiting() const { return m_waiting.size(); }
+		// takes ownership of sock, data and errstack
+	void defer(ReliSock *sock, void *data, int terrno, CondorError *errstack);
+		// sync the log now and reply to all waiting clients
+	void sync();
+
+ protected:
+		// makes every commit written to the log so far durable
+	virtual void syncLog() = 0;
+		// arranges for sync() to be called delay_ms from now, or cancels
+		// that if delay_ms is -1
+	virtual void scheduleSync(int delay_ms) = 0;
+		// has DaemonCore watch the connection for its next request,
+		// returns false if it can't
+	virtual bool resume(ReliSock *sock, void *data) = 0;
+		// closes the connection
+	virtual void close(ReliSock *sock, void *data) = 0;
+
+ private:
+	struct Waiting {
+		ReliSock *sock;
+		void *data;
+		int terrno;
+		CondorError *errstack;
+	};
+	std::vector<Waiting> m_waiting;
+	int m_window_ms;
+	int m_max_commits;
+	bool m_sync_scheduled;
+};
+
+#endif
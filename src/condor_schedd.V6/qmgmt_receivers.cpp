@@ -29,6 +29,7 @@
 #include "authentication.h"
 
 #include "qmgmt.h"
+#include "qmgmt_group_commit.h"
 #include "condor_qmgr.h"
 #include "qmgmt_constants.h"
 
@@ -672,46 +673,20 @@ do_Q_request(QmgmtPeer &Q_PEER, bool &may_fork)
 		} else {
 			errstack.reset(new CondorError());
 			errno = 0;
-			rval = CommitTransactionAndLive( flags, errstack.get() );
+			bool sync_deferred = false;
+			rval = CommitTransactionAndDeferSync( flags, errstack.get(),
+				!Q_PEER.getReadOnly(), sync_deferred );
 			terrno = errno;
-		}
-		dprintf( D_SYSCALLS, "\tflags = %d, rval = %d, errno = %d\n", flags, rval, terrno );
-
-		syscall_sock->encode();
-		assert( syscall_sock->code(rval) );
-		const CondorVersionInfo *vers = syscall_sock->get_peer_version();
-		bool send_classad = vers && vers->built_since_version(8, 3, 4);
-		bool always_send_classad = vers && vers->built_since_version(8, 7, 4);
-		if( rval < 0 ) {
-			assert( syscall_sock->code(terrno) );
-		}
-		if( rval < 0 && send_classad ) {
-			// Send a classad, for less backwards-incompatibility.
-			int code = 1;
-			const char * reason = "QMGMT rejected job submission.";
-			if(! errstack->empty()) {
-				code = 2;
-				reason = errstack->message();
-			}
-
-			ClassAd reply;
-			reply.Assign( "ErrorCode", code );
-			reply.Assign( "ErrorReason", reason );
-			assert( putClassAd( syscall_sock, reply ) );
-		} else if( always_send_classad ) {
-			ClassAd reply;
-
-			std::string reason;
-			if(! errstack->empty()) {
-				reason = errstack->getFullText();
-				reply.Assign( "WarningReason", reason );
+			if( sync_deferred ) {
+					// the reply is sent once the commit is on disk
+				dprintf( D_SYSCALLS, "\tflags = %d, rval = %d, reply deferred\n", flags, rval );
+				DeferCommitTransactionReply( terrno, errstack.release() );
+				return 1;
 			}
-
-			assert( putClassAd( syscall_sock, reply ) );
 		}
+		dprintf( D_SYSCALLS, "\tflags = %d, rval = %d, errno = %d\n", flags, rval, terrno );
 
-		assert( syscall_sock->end_of_message() );;
-		return 0;
+		return SendCommitTransactionReply( syscall_sock, rval, terrno, *errstack );
 	}
 
 	case CONDOR_GetAttributeFloat:
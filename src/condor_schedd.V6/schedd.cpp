@@ -8277,10 +8277,9 @@ PostInitJobQueue()
 						"Scheduler::WriteRestartReport", &scheduler );
 
 		// The below must happen _after_ InitJobQueue is called.
-	if ( scheduler.autocluster.config(scheduler.MinimalSigAttrs) ) {
-		// clear out auto cluster id attributes
-		WalkJobQueue(clear_autocluster_id);
-	}
+		// There is no need to walk the queue to clear out the auto cluster
+		// id attributes as reconfig does, InitJobQueue already cleared them.
+	scheduler.autocluster.config(scheduler.MinimalSigAttrs);
 
 		//
 		// Update the SchedDInterval attributes in jobs if they
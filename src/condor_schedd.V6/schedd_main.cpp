@@ -43,6 +43,7 @@
 #include "ipv6_hostname.h"
 #include "credmon_interface.h"
 #include "directory_util.h"
+#include "stopwatch.h"
 
 #if defined(HAVE_DLOPEN)
 #include "ScheddPlugin.h"
@@ -164,7 +165,12 @@ main_init(int argc, char* argv[])
 
 	int max_historical_logs = param_integer( "MAX_JOB_QUEUE_LOG_ROTATIONS", DEFAULT_MAX_JOB_QUEUE_LOG_ROTATIONS );
 
+		// Time how long it takes from here until we can answer queries
+	Stopwatch recovery_time;
+	recovery_time.start();
+
 	InitJobQueue(job_queue_name.Value(),max_historical_logs);
+	double init_time = recovery_time.get_ms() / 1000;
 	PostInitJobQueue();
 
 		// Initialize the dedicated scheduler stuff
@@ -173,6 +179,10 @@ main_init(int argc, char* argv[])
 		// Do a timeout now at startup to get the ball rolling...
 	scheduler.timeout();
 
+	scheduler.stats.JobQueueRecoveryTime = recovery_time.stop() / 1000;
+	dprintf( D_ALWAYS, "Job queue recovered in %.3f seconds (%.3f loading the job queue log)\n",
+			 scheduler.stats.JobQueueRecoveryTime, init_time );
+
 #if defined(HAVE_DLOPEN)
 	ScheddPluginManager::Initialize();
 	ClassAdLogPluginManager::Initialize();
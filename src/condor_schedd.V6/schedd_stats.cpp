@@ -179,6 +179,7 @@ void ScheddStatistics::InitMain()
    // default window size to 1 quantum, we may set it to something else later.
    if ( ! this->RecentWindowQuantum) this->RecentWindowQuantum = 1;
    this->RecentWindowMax = this->RecentWindowQuantum;
+   this->JobQueueRecoveryTime = 0;
 
    InitJobCounters(Pool, IF_BASICPUB);
 
@@ -287,6 +288,7 @@ void ScheddStatistics::Publish(ClassAd & ad, int flags) const
 {
    if ((flags & IF_PUBLEVEL) > 0) {
       ad.Assign("StatsLifetime", (int)StatsLifetime);
+      ad.Assign("JobQueueRecoveryTime", JobQueueRecoveryTime);
       ad.Assign("JobsSizesHistogramBuckets", default_sizes_set);
       ad.Assign("JobsRuntimesHistogramBuckets", default_lifes_set);
       if (flags & IF_VERBOSEPUB)
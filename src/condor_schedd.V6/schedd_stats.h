@@ -131,6 +131,9 @@ typedef struct ScheddStatistics : public ScheddJobCounters {
    //stats_entry_recent<int> ShadowExceptions;     // number of times shadows have excepted
    stats_entry_recent<int> ShadowsReconnections; // number of times shadows have reconnected
 
+   // how long the schedd took to load the job queue and become ready to answer queries when it started.
+   double JobQueueRecoveryTime;
+
 
    // non-published values
    time_t InitTime;            // last time we init'ed the structure
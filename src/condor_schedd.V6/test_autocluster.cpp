@@ -0,0 +1,124 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for JobCluster::getClusterid().  Jobs with the same significant
+// attributes must land in one autocluster no matter how their values were
+// written or whether they came through the expression cache, and jobs
+// that differ must not.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "autocluster.h"
+#include "qmgmt.h"
+#include "schedd_stats.h"
+#include "test_check.h"
+
+#include <stdio.h>
+#include <string>
+
+// The parts of the schedd that autocluster.cpp uses and these tests don't.
+double last_autocluster_runtime;
+bool   last_autocluster_make_sig;
+int    last_autocluster_type = 0;
+int    last_autocluster_classad_cache_hit = 0;
+void JobQueueBase::PopulateFromAd() {}
+void JobQueueJob::PopulateFromAd() {}
+JobQueueJob* GetJobAd(const PROC_ID&) { return NULL; }
+void WalkJobQueue3(queue_job_scan_func, void*, schedd_runtime_probe &) {}
+
+static const char *sig_attrs = "Owner,RequestMemory,Requirements";
+
+// Makes a job, inserting each of the attribute values either through the
+// expression cache or by parsing it directly.
+static JobQueueJob *
+make_job( int proc, const char *requirements, bool via_cache, const char *owner )
+{
+	JobQueueJob *job = new JobQueueJob( JobQueueBase::entry_type_job );
+	job->jid.cluster = 1;
+	job->jid.proc = proc;
+
+	const char *attrs[][2] = {
+		{ "Owner", owner },
+		{ "RequestMemory", "1024" },
+		{ "RequestDisk", "( 2048 )" },
+		{ "Requirements", requirements },
+	};
+	for ( auto & attr : attrs ) {
+		std::string name = attr[0];
+		std::string rhs = attr[1];
+		if ( via_cache ) {
+			job->InsertViaCache( name, rhs );
+		} else {
+			classad::ClassAdParser parser;
+			parser.SetOldClassAd( true );
+			job->Insert( name, parser.ParseExpression( rhs ) );
+		}
+	}
+	return job;
+}
+
+static void
+test_identical_jobs( bool verify )
+{
+	JobCluster clusters;
+	clusters.setSigAttrs( sig_attrs, false, true );
+	clusters.verifySignatures( verify );
+
+	const char *reqs = "TARGET.Memory >= RequestMemory && TARGET.Disk >= RequestDisk";
+	JobQueueJob *jobs[] = {
+			// the first job with a value puts its text into the cache
+		make_job( 0, "TARGET.Memory  >=  RequestMemory  &&  TARGET.Disk >= RequestDisk", true, "\"alice\"" ),
+		make_job( 1, reqs, true, "\"alice\"" ),
+		make_job( 2, reqs, false, "\"alice\"" ),
+		make_job( 3, reqs, true, "\"bob\"" ),
+		make_job( 4, "TARGET.Memory >= 2 * RequestMemory && TARGET.Disk >= RequestDisk", false, "\"alice\"" ),
+	};
+	const int num_jobs = (int)(sizeof(jobs) / sizeof(jobs[0]));
+	int ids[num_jobs];
+	std::string attrs;
+	for ( int ix = 0; ix < num_jobs; ++ix ) {
+		attrs.clear();
+		ids[ix] = clusters.getClusterid( *jobs[ix], true, &attrs );
+	}
+
+	std::string prefix = verify ? "verified " : "";
+	check( (prefix + "values with extra white space share an autocluster").c_str(), ids[0] == ids[1] );
+	check( (prefix + "cached and uncached values share an autocluster").c_str(), ids[1] == ids[2] );
+	check( (prefix + "a different owner gets a new autocluster").c_str(), ids[3] != ids[0] );
+	check( (prefix + "a different requirement gets a new autocluster").c_str(), ids[4] != ids[0] && ids[4] != ids[3] );
+	check( (prefix + "the references of the requirements are significant").c_str(),
+		attrs == "Owner,RequestMemory,Requirements,RequestDisk" );
+	check( (prefix + "a job asked again stays in its autocluster").c_str(),
+		clusters.getClusterid( *jobs[2], true, NULL ) == ids[0] );
+
+	for ( auto job : jobs ) {
+		delete job;
+	}
+}
+
+int
+main( int /*argc*/, char ** /*argv*/ )
+{
+	classad::ClassAdSetExpressionCaching( true );
+
+	test_identical_jobs( false );
+	test_identical_jobs( true );
+
+	return check_results();
+}
@@ -0,0 +1,227 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for the deferred CommitTransaction replies of the group commit of
+// the job queue log (see SCHEDD_JOB_QUEUE_GROUP_COMMIT_WINDOW).  Clients
+// over socketpairs check that no reply arrives before the sync, that one
+// sync answers every waiting client along with the warnings of its commit,
+// that connections get a deadline when they are watched again, and that
+// a client that went away is closed rather than watched.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "condor_classad.h"
+#include "condor_version.h"
+#include "qmgmt_group_commit.h"
+#include "test_check.h"
+
+#include <poll.h>
+#include <vector>
+
+class TestGroupCommit : public JobQueueGroupCommit {
+ public:
+	TestGroupCommit() : syncs(0), delay_ms(-1) {}
+
+	int syncs;
+	int delay_ms; // of the sync that is scheduled, -1 if there is none
+	std::vector<ReliSock *> resumed;
+	std::vector<void *> closed;
+
+ protected:
+	void syncLog() { ++syncs; }
+	void scheduleSync(int delay) { delay_ms = delay; }
+	bool resume(ReliSock *sock, void *) { resumed.push_back(sock); return true; }
+	void close(ReliSock *sock, void *data) { closed.push_back(data); delete sock; }
+};
+
+struct Client {
+	ReliSock *server; // owned by the group commit once deferred
+	ReliSock client;
+};
+
+static CondorVersionInfo peer_version;
+
+static bool
+connect_client( Client &c )
+{
+	int pair[2];
+	if ( socketpair( AF_UNIX, SOCK_STREAM, 0, pair ) != 0 ) {
+		check_failed( "socketpair failed: %s", strerror( errno ) );
+		return false;
+	}
+	c.server = new ReliSock();
+	c.server->assignDomainSocket( pair[0] );
+	c.server->set_peer_version( &peer_version );
+	c.client.assignDomainSocket( pair[1] );
+	return true;
+}
+
+static bool
+reply_waiting( Client &c )
+{
+	struct pollfd pfd;
+	pfd.fd = c.client.get_file_desc();
+	pfd.events = POLLIN;
+	return poll( &pfd, 1, 0 ) > 0;
+}
+
+// Reads a CommitTransaction reply the way the client does, returns false
+// if there is none.
+static bool
+read_reply( Client &c, int &rval, std::string &warning )
+{
+	ClassAd reply;
+	c.client.decode();
+	c.client.timeout( 5 );
+	if ( ! c.client.code( rval ) || ! getClassAd( &c.client, reply ) || ! c.client.end_of_message() ) {
+		return false;
+	}
+	warning.clear();
+	reply.LookupString( "WarningReason", warning );
+	return true;
+}
+
+static void
+test_replies_after_sync()
+{
+	param_insert( "SCHEDD_JOB_QUEUE_GROUP_COMMIT_WINDOW", "20" );
+	param_insert( "SCHEDD_JOB_QUEUE_GROUP_COMMIT_MAX", "10" );
+	TestGroupCommit gc;
+	gc.config();
+
+	Client clients[3];
+	for ( int i = 0; i < 3; ++i ) {
+		if ( ! connect_client( clients[i] ) ) {
+			return;
+		}
+		CondorError *errstack = new CondorError();
+		if ( i == 1 ) {
+			errstack->push( "QMGMT", 1, "the job has a warning" );
+		}
+		gc.defer( clients[i].server, (void *)(intptr_t)i, 0, errstack );
+	}
+	check( "the first deferred reply schedules a sync in the window",
+	       gc.delay_ms == 20 && gc.syncs == 0 && gc.numWaiting() == 3 );
+
+	bool any_reply = false;
+	for ( int i = 0; i < 3; ++i ) {
+		any_reply = any_reply || reply_waiting( clients[i] );
+	}
+	check( "no client has a reply before the sync", ! any_reply );
+
+	time_t now = time( NULL );
+	gc.sync();
+	check( "one sync covers every waiting commit",
+	       gc.syncs == 1 && gc.numWaiting() == 0 && gc.delay_ms == -1 );
+
+	bool replied = true;
+	for ( int i = 0; i < 3; ++i ) {
+		int rval = -1;
+		std::string warning;
+		if ( ! read_reply( clients[i], rval, warning ) || rval != 0 ||
+		     (i == 1) != (warning.find( "the job has a warning" ) != std::string::npos) )
+		{
+			check_failed( "client %d: rval %d, warning '%s'", i, rval, warning.c_str() );
+			replied = false;
+		}
+	}
+	check( "each client gets its reply and the warnings of its commit", replied );
+
+	bool deadlines = gc.resumed.size() == 3 && gc.closed.empty();
+	for ( size_t i = 0; deadlines && i < gc.resumed.size(); ++i ) {
+		time_t deadline = gc.resumed[i]->get_deadline();
+		deadlines = deadline >= now + QMGMT_TIMEOUT && deadline <= time( NULL ) + QMGMT_TIMEOUT;
+	}
+	check( "the connections are watched again with a deadline", deadlines );
+	for ( size_t i = 0; i < gc.resumed.size(); ++i ) {
+		delete gc.resumed[i];
+	}
+
+	gc.sync();
+	check( "a sync with nothing waiting does not sync the log", gc.syncs == 1 );
+}
+
+static void
+test_full_group()
+{
+	param_insert( "SCHEDD_JOB_QUEUE_GROUP_COMMIT_WINDOW", "1000" );
+	param_insert( "SCHEDD_JOB_QUEUE_GROUP_COMMIT_MAX", "2" );
+	TestGroupCommit gc;
+	gc.config();
+
+	Client clients[2];
+	if ( ! connect_client( clients[0] ) || ! connect_client( clients[1] ) ) {
+		return;
+	}
+	gc.defer( clients[0].server, NULL, 0, new CondorError() );
+	bool windowed = gc.delay_ms == 1000;
+	gc.defer( clients[1].server, NULL, 0, new CondorError() );
+	check( "a full group is synced right away", windowed && gc.delay_ms == 0 );
+
+		// turning group commit off syncs whatever is waiting
+	param_insert( "SCHEDD_JOB_QUEUE_GROUP_COMMIT_WINDOW", "0" );
+	gc.config();
+	check( "disabling group commit replies to the waiting clients",
+	       ! gc.enabled() && gc.syncs == 1 && gc.resumed.size() == 2 &&
+	       reply_waiting( clients[0] ) && reply_waiting( clients[1] ) );
+	for ( size_t i = 0; i < gc.resumed.size(); ++i ) {
+		delete gc.resumed[i];
+	}
+}
+
+static void
+test_client_gone()
+{
+	param_insert( "SCHEDD_JOB_QUEUE_GROUP_COMMIT_WINDOW", "20" );
+	param_insert( "SCHEDD_JOB_QUEUE_GROUP_COMMIT_MAX", "10" );
+	TestGroupCommit gc;
+	gc.config();
+
+	Client clients[2];
+	if ( ! connect_client( clients[0] ) || ! connect_client( clients[1] ) ) {
+		return;
+	}
+	gc.defer( clients[0].server, (void *)1, 0, new CondorError() );
+	gc.defer( clients[1].server, (void *)2, 0, new CondorError() );
+	clients[0].client.close();
+
+	gc.sync();
+	int rval = -1;
+	std::string warning;
+	check( "a client that went away is closed, the others get their replies",
+	       gc.closed.size() == 1 && gc.closed[0] == (void *)1 &&
+	       gc.resumed.size() == 1 && gc.resumed[0] == clients[1].server &&
+	       read_reply( clients[1], rval, warning ) && rval == 0 );
+	for ( size_t i = 0; i < gc.resumed.size(); ++i ) {
+		delete gc.resumed[i];
+	}
+}
+
+int
+main( int /*argc*/, char ** /*argv*/ )
+{
+	signal( SIGPIPE, SIG_IGN );
+
+	test_replies_after_sync();
+	test_full_group();
+	test_client_gone();
+
+	return check_results();
+}
@@ -1123,8 +1123,16 @@ ResMgr::send_update( int cmd, ClassAd* public_ad, ClassAd* private_ad,
 		// Increment the resmgr's count of updates.
 	num_updates++;
 
-	int res = daemonCore->sendUpdates(cmd, public_ad, private_ad, nonblock, &m_token_requester,
-		DCTokenRequester::default_identity, "ADVERTISE_STARTD");
+	int res;
+	if (cmd == UPDATE_STARTD_AD_DELTA) {
+			// the caller has already evaluated DAEMON_SHUTDOWN against the whole ad,
+			// which we can't do here since the delta has only part of it.
+		res = daemonCore->getCollectorList()->sendUpdates(cmd, public_ad, private_ad, nonblock,
+			&m_token_requester, DCTokenRequester::default_identity, "ADVERTISE_STARTD");
+	} else {
+		res = daemonCore->sendUpdates(cmd, public_ad, private_ad, nonblock, &m_token_requester,
+			DCTokenRequester::default_identity, "ADVERTISE_STARTD");
+	}
 
 	if (first_time) {
 		first_time = false;
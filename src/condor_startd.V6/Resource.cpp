@@ -310,6 +310,8 @@ Resource::Resource( CpuAttributes* cap, int rid, bool multiple_slots, Resource*
 	r_no_collector_updates = SlotType::type_param_boolean(cap, "HIDDEN", false);
 
 	update_tid = -1;
+	r_delta_generation = 0;
+	r_last_full_update = 0;
 
 	r_cpu_busy = 0;
 	r_cpu_busy_start_time = 0;
@@ -1536,20 +1538,103 @@ Resource::do_update( void )
 #endif
 #endif
 
+	int update_cmd = UPDATE_STARTD_AD;
+	ClassAd delta_ad;
+	ClassAd *update_ad = &public_ad;
+	if (param_boolean("STARTD_SEND_DELTA_UPDATES", false)) {
+			// evaluate DAEMON_SHUTDOWN against the whole ad, since the delta won't have all of it.
+		daemonCore->evalDaemonShutdownExprs(&public_ad);
+		if (make_delta_update(public_ad, delta_ad)) {
+			update_cmd = UPDATE_STARTD_AD_DELTA;
+			update_ad = &delta_ad;
+		}
+	} else {
+		reset_delta_update();
+	}
+
 		// Send class ads to collector(s)
-	rval = resmgr->send_update( UPDATE_STARTD_AD, &public_ad,
+	rval = resmgr->send_update( update_cmd, update_ad,
 								&private_ad, true );
 	if( rval ) {
-		dprintf( D_FULLDEBUG, "Sent update to %d collector(s)\n", rval );
+		dprintf( D_FULLDEBUG, "Sent %supdate to %d collector(s)\n",
+				 (update_cmd == UPDATE_STARTD_AD_DELTA) ? "delta " : "", rval );
 	} else {
 		dprintf( D_ALWAYS, "Error sending update to collector(s)\n" );
 	}
+	if( rval < daemonCore->getCollectorList()->number() ) {
+			// a collector that missed this update can't merge a delta relative
+			// to it, so start over with a full update
+		reset_delta_update();
+	}
 
 	// We _must_ reset update_tid to -1 before we return so
 	// the class knows there is no pending update.
 	update_tid = -1;
 }
 
+// Make the next update a full one, for instance because a collector
+// told us that it could not merge a delta update.
+void
+Resource::reset_delta_update( void )
+{
+	r_delta_generation = 0;
+	r_delta_base_ad.Clear();
+}
+
+// Turn the public ad into a delta update holding only the attributes that
+// changed since the last update, plus those the collector needs to find the
+// ad to merge the delta into.  Returns false if a full update should be sent
+// instead, which is the case for the first update, after a failed update,
+// and once every STARTD_DELTA_UPDATE_FULL_INTERVAL seconds so that a
+// collector that missed an update or restarted will get the whole ad back.
+// Either way public_ad becomes the base of the next delta.
+bool
+Resource::make_delta_update(ClassAd & public_ad, ClassAd & delta_ad)
+{
+	time_t now = time(NULL);
+	int full_interval = param_integer("STARTD_DELTA_UPDATE_FULL_INTERVAL", 600, 0);
+	long long base = r_delta_generation;
+	bool full = ! base || (now - r_last_full_update) >= full_interval;
+
+	if ( ! full) {
+		std::string removed;
+		for (auto it = r_delta_base_ad.begin(); it != r_delta_base_ad.end(); ++it) {
+			if ( ! public_ad.Lookup(it->first)) {
+				if ( ! removed.empty()) { removed += ","; }
+				removed += it->first;
+			}
+		}
+		for (auto it = public_ad.begin(); it != public_ad.end(); ++it) {
+			ExprTree *old_expr = r_delta_base_ad.Lookup(it->first);
+			if ( ! old_expr || ! old_expr->SameAs(it->second)) {
+				delta_ad.Insert(it->first, it->second->Copy());
+			}
+		}
+			// Machine is part of the key of the update sequence numbers, and with
+			// DaemonStartTime the collector can tell which updates were lost.
+		const char * key_attrs[] = { ATTR_MY_TYPE, ATTR_TARGET_TYPE, ATTR_NAME, ATTR_MACHINE,
+			ATTR_MY_ADDRESS, ATTR_STARTD_IP_ADDR, ATTR_DAEMON_START_TIME };
+		for (size_t i = 0; i < COUNTOF(key_attrs); ++i) {
+			if ( ! delta_ad.Lookup(key_attrs[i])) {
+				CopyAttribute(key_attrs[i], delta_ad, public_ad);
+			}
+		}
+		if ( ! removed.empty()) {
+			delta_ad.Assign(ATTR_UPDATE_DELTA_REMOVED, removed);
+		}
+		delta_ad.Assign(ATTR_UPDATE_DELTA_BASE, base);
+		delta_ad.Assign(ATTR_UPDATE_DELTA_GENERATION, base + 1);
+		dprintf(D_FULLDEBUG, "Delta update has %d of %d attributes\n", delta_ad.size(), public_ad.size());
+	} else {
+		r_last_full_update = now;
+	}
+
+	r_delta_base_ad = public_ad;
+	r_delta_generation = base + 1;
+	public_ad.Assign(ATTR_UPDATE_DELTA_GENERATION, r_delta_generation);
+	return ! full;
+}
+
 // build a slot ad from whole cloth, used for updating the collector, etc
 // it is an ERROR to pass r_classad as input ad here!!
 void Resource::publish_single_slot_ad(ClassAd & ad, time_t cur_time, Purpose purpose)
@@ -1672,6 +1757,8 @@ Resource::update_with_ack( void )
 
 	publish_private(&private_ad);
 
+		// this ad has no delta generation, so the next regular update must be a full one
+	reset_delta_update();
 
     if ( !putClassAd ( socket, public_ad ) ) {
 
@@ -283,6 +283,8 @@ public:
 
 	void	update( void );		// Schedule to update the central manager.
 	void	do_update( void );			// Actually update the CM
+	bool	make_delta_update(ClassAd & public_ad, ClassAd & delta_ad); // see STARTD_SEND_DELTA_UPDATES
+	void	reset_delta_update( void );	// make the next update a full one
 	void    process_update_ad(ClassAd & ad, int snapshot=0); // change the update ad before we send it 
     int     update_with_ack( void );    // Actually update the CM and wait for an ACK
 	void	final_update( void );		// Send a final update to the CM
@@ -421,6 +423,13 @@ private:
 
 	int			update_tid;	// DaemonCore timer id for update delay
 
+		// The public ad of the last update sent to the collectors, and its
+		// generation, which the next delta update is relative to.
+		// A generation of 0 means the next update must be a full one.
+	ClassAd		r_delta_base_ad;
+	long long	r_delta_generation;
+	time_t		r_last_full_update;
+
 	int		r_cpu_busy;
 	time_t	r_cpu_busy_start_time;
 	time_t	r_last_compute_condor_load;
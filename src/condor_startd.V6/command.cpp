@@ -319,6 +319,17 @@ command_pckpt_all(int, Stream* )
 }
 
 
+int
+command_full_update_request(int, Stream* ) 
+{
+	dprintf( D_FULLDEBUG, "A collector could not merge a delta update, "
+			 "sending full updates\n" );
+	resmgr->walk( &Resource::reset_delta_update );
+	resmgr->walk( &Resource::update );
+	return TRUE;
+}
+
+
 int
 command_x_event(int, Stream* s ) 
 {
@@ -86,6 +86,7 @@ int command_release_claim(int, Stream* );
 */
 int command_vacate_all(int, Stream* );
 int command_pckpt_all(int, Stream* );
+int command_full_update_request(int, Stream* );
 int command_x_event(int, Stream* );
 int	command_give_state(int, Stream* );
 int	command_give_totals_classad( int, Stream* );
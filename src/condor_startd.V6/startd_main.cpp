@@ -320,6 +320,9 @@ main_init( int, char* argv[] )
 								  command_x_event,
 								  "command_x_event", ALLOW,
 								  D_FULLDEBUG ); 
+	daemonCore->Register_Command( STARTD_FULL_UPDATE_REQUEST, "STARTD_FULL_UPDATE_REQUEST",
+								  command_full_update_request,
+								  "command_full_update_request", DAEMON );
 	daemonCore->Register_Command( PCKPT_ALL_JOBS, "PCKPT_ALL_JOBS", 
 								  command_pckpt_all,
 								  "command_pckpt_all", DAEMON );
@@ -0,0 +1,186 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Convert ClassAd logs such as the job_queue.log between the ascii
+// and binary formats, see CLASSAD_LOG_BINARY.
+
+#include "condor_common.h"
+#include "condor_config.h"
+#include "condor_debug.h"
+#include "condor_distribution.h"
+#include "match_prefix.h"
+#include "classad_log.h"
+#include "stopwatch.h"
+
+static void usage(const char* name);
+static bool convertLog(const char *filename, bool binary, bool benchmark);
+static bool benchmarkLoad(const char *filename);
+
+int
+main(int argc, const char* argv[])
+{
+	int format = -1;
+	bool benchmark = false;
+	int first_file = 0;
+
+	myDistro->Init( argc, argv );
+	set_priv_initialize(); // allow uid switching if root
+	config();
+
+	for (int i = 1; i < argc; i++) {
+		if (argv[i][0] != '-') {
+			if ( ! first_file) first_file = i;
+			continue;
+		}
+		if (is_dash_arg_prefix(argv[i], "help", 1)) {
+			usage(argv[0]);
+			exit(0);
+		} else if (is_dash_arg_prefix(argv[i], "binary", 1)) {
+			format = 1;
+		} else if (is_dash_arg_prefix(argv[i], "ascii", 1)) {
+			format = 0;
+		} else if (is_dash_arg_prefix(argv[i], "benchmark", 2)) {
+			benchmark = true;
+		} else if (is_dash_arg_prefix(argv[i], "debug", 1)) {
+			dprintf_set_tool_debug("TOOL", 0);
+		} else {
+			fprintf(stderr, "Unknown argument %s\n", argv[i]);
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (format < 0 || ! first_file) {
+		usage(argv[0]);
+		exit(1);
+	}
+
+	int rval = 0;
+	for (int i = first_file; i < argc; i++) {
+		if (argv[i][0] == '-') continue;
+		if ( ! convertLog(argv[i], format == 1, benchmark)) {
+			rval = 1;
+		}
+	}
+	return rval;
+}
+
+
+static void
+usage(const char* name)
+{
+	printf("Usage: %s [-help] [-debug] [-benchmark] -binary|-ascii <list of log files>\n", name);
+	printf("    -binary     Convert the logs to the binary format\n");
+	printf("    -ascii      Convert the logs to the ascii format\n");
+	printf("    -benchmark  Time loading each log before and after converting it\n");
+}
+
+
+static bool
+convertLog(const char *filename, bool binary, bool benchmark)
+{
+	if (benchmark && ! benchmarkLoad(filename)) {
+		return false;
+	}
+
+	std::string new_filename(filename);
+	new_filename += ".new";
+
+	unsigned long records = 0;
+	MyString errmsg;
+	if ( ! ConvertClassAdLog(filename, new_filename.c_str(), binary, records, errmsg)) {
+		fprintf(stderr, "Failed to convert %s: %s", filename, errmsg.Value());
+		return false;
+	}
+	if ( ! errmsg.empty()) {
+		fprintf(stderr, "%s", errmsg.Value());
+	}
+	struct stat old_st, new_st;
+	if (stat(filename, &old_st) == 0 && stat(new_filename.c_str(), &new_st) == 0 && old_st.st_size > 0) {
+		printf("Converted %lu records of %s to the %s format, %lld bytes before and %lld bytes after (%.1f%%)\n",
+			records, filename, binary ? "binary" : "ascii",
+			(long long)old_st.st_size, (long long)new_st.st_size,
+			100.0 * (double)new_st.st_size / (double)old_st.st_size);
+	} else {
+		printf("Converted %lu records of %s to the %s format\n", records, filename, binary ? "binary" : "ascii");
+	}
+
+	if (benchmark && ! benchmarkLoad(new_filename.c_str())) {
+		unlink(new_filename.c_str());
+		return false;
+	}
+
+	std::string old_filename(filename);
+	old_filename += ".oldver";
+	if (rename(filename, old_filename.c_str()) < 0) {
+		fprintf(stderr, "Failed to rename %s to %s: %s\n", filename, old_filename.c_str(), strerror(errno));
+		unlink(new_filename.c_str());
+		return false;
+	}
+	if (rename(new_filename.c_str(), filename) < 0) {
+		fprintf(stderr, "Failed to rename %s to %s: %s\n", new_filename.c_str(), filename, strerror(errno));
+		rename(old_filename.c_str(), filename);
+		return false;
+	}
+	printf("The original log was renamed to %s\n", old_filename.c_str());
+	return true;
+}
+
+
+// Load the log the way a daemon does when it starts up, and report how long it took.
+static bool
+benchmarkLoad(const char *filename)
+{
+	HashTable<std::string, ClassAd*> table(hashFunction);
+	ClassAdLogTable<std::string, ClassAd*> la(table);
+	unsigned long historical_sequence_number;
+	time_t original_log_birthdate;
+	bool is_clean, requires_successful_cleaning, binary;
+	MyString errmsg;
+
+	Stopwatch load_time;
+	load_time.start();
+	FILE *fp = LoadClassAdLog(filename, la, DefaultMakeClassAdLogTableEntry,
+		historical_sequence_number, original_log_birthdate,
+		is_clean, requires_successful_cleaning, binary, errmsg);
+	double load_ms = load_time.stop();
+	if ( ! fp) {
+		fprintf(stderr, "Failed to load %s: %s", filename, errmsg.Value());
+		return false;
+	}
+	long long size = 0;
+	if (fseek(fp, 0, SEEK_END) == 0) {
+		size = ftell(fp);
+	}
+	fclose(fp);
+
+	printf("Loaded %d ads from %s (%s format, %lld bytes) in %.3f seconds\n",
+		table.getNumElements(), filename, binary ? "binary" : "ascii", size, load_ms / 1000);
+
+		// free the ads, which also empties the expression cache so that the
+		// next load doesn't get a head start from this one.
+	std::string key;
+	ClassAd *ad;
+	table.startIterations();
+	while (table.iterate(key, ad) == 1) {
+		delete ad;
+	}
+	table.clear();
+	return true;
+}
@@ -37,6 +37,7 @@
 #include "match_prefix.h"
 #include "subsystem_info.h"
 #include "historyFileFinder.h"
+#include "historyIndex.h"
 #include "condor_id.h"
 #include "userlog_to_classads.h"
 #include "setenv.h"
@@ -47,6 +48,7 @@
 #include "history_utils.h"
 #include "backward_file_reader.h"
 #include <fcntl.h>  // for O_BINARY
+#include <algorithm>
 
 void Usage(const char* name, int iExitCode=1);
 
@@ -111,6 +113,7 @@ static void readHistoryRemote(classad::ExprTree *constraintExpr, bool want_start
 static void readHistoryFromFiles(bool fileisuserlog, const char *JobHistoryFileName, const char* constraint, ExprTree *constraintExpr);
 static void readHistoryFromFileOld(const char *JobHistoryFileName, const char* constraint, ExprTree *constraintExpr);
 static void readHistoryFromFileEx(const char *JobHistoryFileName, const char* constraint, ExprTree *constraintExpr, bool read_backwards);
+static bool readHistoryFromFileIndexed(const char *JobHistoryFileName, const char* constraint, ExprTree *constraintExpr, bool read_backwards);
 static void printJobAds(ClassAdList & jobs);
 static void printJob(ClassAd & ad);
 
@@ -1402,6 +1405,11 @@ static void readHistoryFromFileEx(const char *JobHistoryFileName, const char* co
 		return;
 	}
 
+	// if the history file has an index, we can skip the job ads that the index shows can't match.
+	if (readHistoryFromFileIndexed(JobHistoryFileName, constraint, constraintExpr, read_backwards)) {
+		return;
+	}
+
 	// the old function doesn't work for backwards, but it does work for forwards so go ahead and call it.
 	//
 	if ( ! read_backwards) {
@@ -1483,6 +1491,119 @@ static void readHistoryFromFileEx(const char *JobHistoryFileName, const char* co
 	reader.Close();
 }
 
+// Read the history file using its index, see historyIndex.h.  The index lets us skip the
+// job ads that can't match the constraint, and find the -since job, without reading or parsing
+// the job ads.  returns false without reading anything if there is no constraint or since
+// expression to use the index for, or if the history file has no index that we can trust.
+static bool readHistoryFromFileIndexed(const char *JobHistoryFileName, const char* constraint, ExprTree *constraintExpr, bool read_backwards)
+{
+	bool has_constraint = constraint && constraint[0] && constraintExpr;
+	bool has_since = read_backwards && sinceExpr; // forwards reading ignores the since expression
+	if ( ! has_constraint && ! has_since) {
+		return false;
+	}
+
+	int LogFd = safe_open_wrapper_follow(JobHistoryFileName, O_RDONLY | O_LARGEFILE, 0);
+	if (LogFd < 0) {
+		return false; // let the caller report the error
+	}
+	FILE *LogFile = fdopen(LogFd, "r");
+	if ( ! LogFile) {
+		close(LogFd);
+		return false;
+	}
+	struct stat si;
+	std::vector<HistoryIndexEntry> entries;
+	if (fstat(LogFd, &si) < 0 || ! readHistoryIndex(JobHistoryFileName, si.st_size, entries)) {
+		fclose(LogFile);
+		return false;
+	}
+
+	std::string buf;
+	std::vector<std::string> exprs;
+	size_t num_entries = entries.size();
+	for (size_t ix = 0; ix < num_entries; ++ix) {
+		const HistoryIndexEntry & entry = entries[read_backwards ? (num_entries - 1 - ix) : ix];
+
+		if (specifiedMatch > 0 && matchCount >= specifiedMatch)
+			break;
+		if (read_backwards && maxAds > 0 && adCount >= maxAds)
+			break;
+		if (abort_transfer)
+			break;
+
+		// a constraint that is anything but true means the job doesn't match
+		bool must_read = true;
+		if (has_constraint) {
+			HistoryIndexResult res = EvalHistoryIndexExpr(constraintExpr, entry);
+			must_read = (res == HISTORY_INDEX_TRUE || res == HISTORY_INDEX_UNKNOWN);
+		}
+		if (has_since) {
+			HistoryIndexResult res = EvalHistoryIndexExpr(sinceExpr, entry);
+			if (res == HISTORY_INDEX_TRUE) {
+				++adCount;
+				maxAds = adCount; // this will force us to stop scanning
+				break;
+			}
+			if (res == HISTORY_INDEX_UNKNOWN) {
+				must_read = true; // so that printJobIfConstraint can check the since expression
+			}
+		}
+		if ( ! must_read) {
+			if (read_backwards) ++adCount; // skipped jobs count towards the -scanlimit
+			continue;
+		}
+
+		// read the job ad, which ends with its banner line
+		buf.resize((size_t)(entry.end - entry.offset));
+		if (fseek(LogFile, entry.offset, SEEK_SET) < 0 ||
+			fread(&buf[0], 1, buf.size(), LogFile) != buf.size()) {
+			printf( "\t*** Error: Can't read job ad at offset %lld of history file: errno %d\n", entry.offset, errno);
+			break;
+		}
+
+		// split the ad into lines, dropping the banner, comments and blank lines.
+		exprs.clear();
+		size_t start = 0;
+		while (start < buf.size()) {
+			size_t eol = buf.find('\n', start);
+			if (eol == std::string::npos) eol = buf.size();
+			size_t line_len = eol - start;
+			if (line_len > 0 && buf[eol-1] == '\r') --line_len;
+			size_t len = line_len;
+			const char * psz = buf.c_str() + start;
+			while (len > 0 && (*psz == ' ' || *psz == '\t')) { ++psz; --len; }
+			if (len > 0 && *psz != '#' && ! starts_with(psz, "*** ")) {
+				exprs.push_back(buf.substr(start, line_len));
+			}
+			start = eol + 1;
+		}
+
+		if (read_backwards) {
+			// printJobIfConstraint wants the lines in the order that the backward reader produces them
+			std::reverse(exprs.begin(), exprs.end());
+			printJobIfConstraint(exprs, constraint, constraintExpr);
+		} else {
+			ClassAd ad;
+			bool valid = true;
+			for (size_t ii = 0; ii < exprs.size(); ++ii) {
+				if ( ! ad.Insert(exprs[ii])) {
+					printf( "\t*** Warning: Bad history file; skipping malformed ad(s)\n" );
+					valid = false;
+					break;
+				}
+			}
+			if (valid && exprs.size() > 0 && (! has_constraint || EvalExprBool(&ad, constraintExpr))) {
+				printJob(ad);
+				matchCount++;
+			}
+		}
+	}
+
+	fclose(LogFile);
+	return true;
+}
+
 // !!! ENTRIES IN THIS TABLE MUST BE SORTED BY THE FIRST FIELD !!
 static const CustomFormatFnTableItem LocalPrintFormats[] = {
 	{ "DATE",            ATTR_Q_DATE, 0, format_int_date, NULL },
@@ -437,10 +437,19 @@ check_spool_dir()
             continue;
         }
 
+            // or the index of a history file, which is .<history-file>.idx
+        if (   f[0] == '.'
+            && strlen(f+1) >= history_length
+            && strncmp(f+1, history, history_length) == 0) {
+            good_file( Spool, f );
+            continue;
+        }
+
 			// if startd_history is defined, so if it's one of those
 		if ( startd_history_length > 0 &&
 			strlen(f) >= startd_history_length &&
-			strncmp(f, startd_history, startd_history_length) == 0) {
+			(strncmp(f, startd_history, startd_history_length) == 0 ||
+			 (f[0] == '.' && strncmp(f+1, startd_history, startd_history_length) == 0))) {
 
 			good_file( Spool, f );
 			continue;
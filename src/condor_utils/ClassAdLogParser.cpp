@@ -59,6 +59,9 @@ ClassAdLogParser::ClassAdLogParser()
 {
 	log_fp = NULL;
 	m_close_fp = true;
+	m_format_known = false;
+	m_binary = false;
+	m_crcOffset = -1;
 	nextOffset = 0;
 	job_queue_name[0] = '\0';
 }
@@ -81,6 +84,7 @@ ClassAdLogParser::setFilePointer(FILE *fp)
 	closeFile();
 	log_fp = fp;
 	m_close_fp = false;
+	m_format_known = false;
 }
 
 ClassAdLogEntry*
@@ -122,6 +126,7 @@ ClassAdLogParser::openFile() {
         return FILE_OPEN_ERROR;
     }
 	m_close_fp = true;
+	m_format_known = false;
 	return FILE_OP_SUCCESS;
 }
 
@@ -164,6 +169,22 @@ ClassAdLogParser::readLogEntry(int &op_type)
         return FILE_READ_EOF;
     }
 
+		// a binary log begins with magic bytes rather than a record
+	if (log_fp && (nextOffset == 0 || ! m_format_known)) {
+		m_binary = ReadBinaryLogHeader(log_fp);
+		m_format_known = true;
+		if (m_binary && nextOffset < CLASSAD_LOG_BINARY_MAGIC_LEN) {
+			nextOffset = CLASSAD_LOG_BINARY_MAGIC_LEN;
+		}
+		if (fseek(log_fp, nextOffset, SEEK_SET) != 0) {
+			closeFile();
+			return FILE_READ_EOF;
+		}
+	}
+	if (log_fp && m_binary) {
+		return readBinaryLogEntry(op_type);
+	}
+
     if(log_fp) {
 	    rval = readHeader(log_fp, op_type);
 	    if (rval < 0) {
@@ -286,6 +307,108 @@ ClassAdLogParser::readLogEntry(int &op_type)
 	return FILE_READ_SUCCESS;
 }
 
+/*! read a record of a binary log, the fields of each type of
+ *  record are the words of the ascii record
+ */
+FileOpErrCode
+ClassAdLogParser::readBinaryLogEntry(int &op_type)
+{
+	std::vector<std::string> fields;
+
+		// the CRC can only be checked when we have read every record
+		// since the last one that carried a CRC
+	if (nextOffset != m_crcOffset) {
+		m_crc.Reset(nextOffset == CLASSAD_LOG_BINARY_MAGIC_LEN);
+	}
+	int rval = ReadBinaryLogRecord(log_fp, m_crc, op_type, fields);
+	m_crcOffset = (rval == 0 || rval == -1) ? nextOffset : ftell(log_fp);
+	if (rval == 0 || rval == -1) {
+			// the end of the log, or a record that is still being written
+		closeFile();
+		return FILE_READ_EOF;
+	}
+
+	lastCALogEntry.init(curCALogEntry.op_type);
+	lastCALogEntry = curCALogEntry;
+	curCALogEntry.init(op_type);
+	curCALogEntry.offset = nextOffset;
+
+	bool valid = rval > 0;
+	if (valid) {
+		switch(op_type) {
+			case CondorLogOp_LogHistoricalSequenceNumber:
+			case CondorLogOp_SetAttribute:
+				valid = fields.size() == 3;
+				if (valid) {
+					curCALogEntry.key = strdup(fields[0].c_str());
+					curCALogEntry.name = strdup(fields[1].c_str());
+					curCALogEntry.value = strdup(fields[2].c_str());
+				}
+				break;
+			case CondorLogOp_NewClassAd:
+				valid = fields.size() == 3;
+				if (valid) {
+					curCALogEntry.key = strdup(fields[0].c_str());
+					curCALogEntry.mytype = strdup(fields[1].c_str());
+					curCALogEntry.targettype = strdup(fields[2].c_str());
+				}
+				break;
+			case CondorLogOp_DestroyClassAd:
+				valid = fields.size() == 1;
+				if (valid) {
+					curCALogEntry.key = strdup(fields[0].c_str());
+				}
+				break;
+			case CondorLogOp_DeleteAttribute:
+				valid = fields.size() == 2;
+				if (valid) {
+					curCALogEntry.key = strdup(fields[0].c_str());
+					curCALogEntry.name = strdup(fields[1].c_str());
+				}
+				break;
+			case CondorLogOp_BeginTransaction:
+				valid = fields.empty();
+				break;
+			case CondorLogOp_EndTransaction:
+				valid = fields.size() <= 1;
+				if (valid && fields.size() == 1) {
+					curCALogEntry.value = strdup(fields[0].c_str());
+				}
+				break;
+			default:
+				valid = false;
+				break;
+		}
+	}
+
+	if ( ! valid) {
+			// as for the ascii format, a bad record inside of a
+			// complete transaction is fatal
+		int op;
+		while ((rval = ReadBinaryLogRecord(log_fp, m_crc, op, fields)) != 0 && rval != -1) {
+			if (rval > 0 && op == CondorLogOp_EndTransaction) {
+#ifdef _NO_CONDOR_
+				syslog(LOG_ERR, "Bad record with op=%d in corrupt logfile", op_type);
+#else
+				dprintf(D_ALWAYS, "Bad record with op=%d in corrupt logfile\n", op_type);
+#endif
+				return FILE_FATAL_ERROR;
+			}
+		}
+		closeFile();
+
+		curCALogEntry = lastCALogEntry;
+		curCALogEntry.offset = nextOffset;
+
+		return FILE_READ_EOF;
+	}
+
+	nextOffset = ftell(log_fp);
+	curCALogEntry.next_offset = nextOffset;
+
+	return FILE_READ_SUCCESS;
+}
+
 /*!
 	\warning each pointer must be freed by a calling funtion
 */
@@ -27,6 +27,7 @@
 #include "condor_common.h"
 #include "condor_io.h"
 #endif
+#include "log.h" // for BinaryLogCrc
 
 enum ParserErrCode {    PARSER_FAILURE,
 						PARSER_SUCCESS};
@@ -108,6 +109,7 @@ private:
 		// helper functions
 		// 
 	int 	readHeader(FILE *fp, int& op_type);
+	FileOpErrCode readBinaryLogEntry(int &op_type);
 	int 	readword(FILE *fp, char *&);
 	int 	readword(int, char *&);
 	int 	readline(FILE *fp, char *&);
@@ -133,6 +135,10 @@ private:
 
 	FILE 	*log_fp;
 	bool	m_close_fp;	// are we responsible for closing log_fp?
+	bool	m_format_known;	// have we checked whether log_fp is a binary log?
+	bool	m_binary;	// log_fp is a binary log, see log.h
+	BinaryLogCrc	m_crc;	// the running CRC of a binary log
+	long	m_crcOffset;	// where the record that m_crc leads up to begins
 };
 
 #endif /* _CLASSADLOGPARSER_H_ */
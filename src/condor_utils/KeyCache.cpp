@@ -53,6 +53,7 @@ KeyCacheEntry::KeyCacheEntry( char const *id_param, const condor_sockaddr * addr
 	_lease_interval = lease_interval;
 	_lease_expiration = 0;
 	_lingering = false;
+	_queued_expiration = 0;
 	renewLease();
 }
 
@@ -152,6 +153,8 @@ void KeyCacheEntry::copy_storage(const KeyCacheEntry &copy) {
 	_lease_interval = copy._lease_interval;
 	_lease_expiration = copy._lease_expiration;
 	_lingering = copy._lingering;
+		// a copy is in no cache's expiration queue
+	_queued_expiration = 0;
 }
 
 
@@ -171,22 +174,24 @@ void KeyCacheEntry::delete_storage() {
 }
 
 
-KeyCache::KeyCache() {
-	key_table = new HashTable<MyString, KeyCacheEntry*>(hashFunction);
-	m_index = new KeyCacheIndex(hashFunction);
-	dprintf ( D_SECURITY|D_FULLDEBUG, "KEYCACHE: created: %p\n", key_table );
+KeyCache::KeyCache() :
+	m_lookup_hits(0),
+	m_lookup_misses(0),
+	m_expired(0)
+{
+	dprintf ( D_SECURITY|D_FULLDEBUG, "KEYCACHE: created: %p\n", this );
 }
 
-KeyCache::KeyCache(const KeyCache& k) {
-	key_table = new HashTable<MyString, KeyCacheEntry*>(hashFunction);
-	m_index = new KeyCacheIndex(hashFunction);
+KeyCache::KeyCache(const KeyCache& k) :
+	m_lookup_hits(0),
+	m_lookup_misses(0),
+	m_expired(0)
+{
 	copy_storage(k);
 }
 
 KeyCache::~KeyCache() {
 	delete_storage();
-	delete key_table;
-	delete m_index;
 }
 	    
 const KeyCache& KeyCache::operator=(const KeyCache& k) {
@@ -199,42 +204,28 @@ const KeyCache& KeyCache::operator=(const KeyCache& k) {
 
 
 void KeyCache::copy_storage(const KeyCache &copy) {
-	dprintf ( D_SECURITY|D_FULLDEBUG, "KEYCACHE: created: %p\n", key_table );
+	dprintf ( D_SECURITY|D_FULLDEBUG, "KEYCACHE: created: %p\n", this );
 
 	// manually iterate all entries from the hash.  they are
 	// pointers, and we need to copy that object.
-	KeyCacheEntry* key_entry;
-	copy.key_table->startIterations();
-	while (copy.key_table->iterate(key_entry)) {
-		insert(*key_entry);
+	for (KeyCacheTable::const_iterator it = copy.key_table.begin(); it != copy.key_table.end(); ++it) {
+		insert(*it->second);
 	}
 }
 
 
 void KeyCache::delete_storage()
 {
-	if( key_table ) {
-			// Delete all entries from the hash
-		KeyCacheEntry* key_entry;
-		key_table->startIterations();
-		while( key_table->iterate(key_entry) ) {
-			if( key_entry ) {
-				delete key_entry;
-			}
+		// Delete all entries from the hash
+	for (KeyCacheTable::iterator it = key_table.begin(); it != key_table.end(); ++it) {
+		if( it->second ) {
+			delete it->second;
 		}
-		key_table->clear();
-		dprintf( D_SECURITY|D_FULLDEBUG, "KEYCACHE: deleted: %p\n", key_table );
-	}
-	if( m_index ) {
-		MyString index;
-		SimpleList<KeyCacheEntry *> *keylist=NULL;
-
-		m_index->startIterations();
-		while( m_index->iterate(index,keylist) ) {
-			delete keylist;
-		}
-		m_index->clear();
 	}
+	key_table.clear();
+	m_index.clear();
+	m_expirations.clear();
+	dprintf( D_SECURITY|D_FULLDEBUG, "KEYCACHE: deleted: %p\n", this );
 }
 
 
@@ -245,18 +236,14 @@ void KeyCache::clear()
 
 bool KeyCache::insert(KeyCacheEntry &e) {
 
-	// the key_table member is a HashTable which maps
-	// MyString's to KeyCacheEntry*'s.  (note the '*')
-
-	// the map_table member is a HashTable which maps
-	// MyString's to MyString's.
+	// the key_table member maps session ids to KeyCacheEntry*'s.
+	// (note the '*')
 
 	// create a new entry
 	KeyCacheEntry *new_ent = new KeyCacheEntry(e);
 
 	// stick a pointer to the entry in the table
-	// NOTE: HashTable's insert returns ZERO on SUCCESS!!!
-	bool retval = (key_table->insert(new_ent->id(), new_ent) == 0);
+	bool retval = key_table.emplace(new_ent->id(), new_ent).second;
 
 	if (!retval) {
 		// key was not inserted... delete
@@ -264,11 +251,31 @@ bool KeyCache::insert(KeyCacheEntry &e) {
 	}
 	else {
 		addToIndex(new_ent);
+		expirationChanged(new_ent);
 	}
 
 	return retval;
 }
 
+void KeyCache::expirationChanged(KeyCacheEntry *e) {
+	time_t expiration = e->expiration();
+	if (expiration == e->_queued_expiration) {
+		return;
+	}
+	dequeueExpiration(e);
+	if (expiration) {
+		m_expirations.insert(KeyCacheDeadline(expiration, e));
+		e->_queued_expiration = expiration;
+	}
+}
+
+void KeyCache::dequeueExpiration(KeyCacheEntry *e) {
+	if (e->_queued_expiration) {
+		m_expirations.erase(KeyCacheDeadline(e->_queued_expiration, e));
+		e->_queued_expiration = 0;
+	}
+}
+
 void
 KeyCache::makeServerUniqueId(MyString const &parent_id,int server_pid,MyString *result) {
 	ASSERT( result );
@@ -283,20 +290,26 @@ KeyCache::makeServerUniqueId(MyString const &parent_id,int server_pid,MyString *
 
 bool KeyCache::lookup(const char *key_id, KeyCacheEntry *&e_ptr) {
 
-	// use a temp pointer so that e_ptr is not modified
-	// if a match is not found
+	// e_ptr is not modified if a match is not found
 
-	KeyCacheEntry *tmp_ptr = NULL;
+	KeyCacheEntry *e = find(key_id);
+	if (!e) {
+		m_lookup_misses++;
+		return false;
+	}
 
-	// NOTE: HashTable's lookup returns ZERO on SUCCESS
-	bool res = (key_table->lookup(key_id, tmp_ptr) == 0);
+	// hand over the pointer
+	m_lookup_hits++;
+	e_ptr = e;
+	return true;
+}
 
-	if (res) {
-		// hand over the pointer
-		e_ptr = tmp_ptr;
+KeyCacheEntry * KeyCache::find(const char *key_id) {
+	KeyCacheTable::const_iterator it = key_table.find(key_id);
+	if (it == key_table.end()) {
+		return NULL;
 	}
-
-	return res;
+	return it->second;
 }
 
 void
@@ -315,11 +328,12 @@ KeyCache::addToIndex(KeyCacheEntry *key)
 
 	if (key->addr())
 		peer_addr = key->addr()->to_sinful();
-	addToIndex(m_index,peer_addr,key);
-	addToIndex(m_index,server_addr,key);
+	addToIndex(&m_index,peer_addr,key);
+		// the peer may be the server itself, which is indexed once
+	addToIndex(&m_index,server_addr,key);
 
 	makeServerUniqueId(parent_id,server_pid,&server_unique_id);
-	addToIndex(m_index,server_unique_id,key);
+	addToIndex(&m_index,server_unique_id,key);
 }
 
 void
@@ -339,11 +353,13 @@ KeyCache::removeFromIndex(KeyCacheEntry *key)
 
 	if (key->addr())
 		peer_addr = key->addr()->to_sinful();
-	removeFromIndex(m_index,peer_addr,key);
-	removeFromIndex(m_index,server_addr,key);
+	removeFromIndex(&m_index,peer_addr,key);
+	if (server_addr != peer_addr) {
+		removeFromIndex(&m_index,server_addr,key);
+	}
 
 	makeServerUniqueId(parent_id,server_pid,&server_unique_id);
-	removeFromIndex(m_index,server_unique_id,key);
+	removeFromIndex(&m_index,server_unique_id,key);
 }
 
 void
@@ -354,53 +370,51 @@ KeyCache::addToIndex(KeyCacheIndex *hash,MyString const &index,KeyCacheEntry *ke
 	}
 	ASSERT( key );
 
-	SimpleList<KeyCacheEntry *> *keylist=NULL;
-	if( hash->lookup(index,keylist)!=0 ) {
-		keylist = new SimpleList<KeyCacheEntry *>;
-		ASSERT( keylist );
-		bool inserted = hash->insert(index,keylist)==0;
-		ASSERT(inserted);
-	}
-	bool appended = keylist->Append(key);
-	ASSERT( appended );
+		// a key that is already under this index stays there once
+	(*hash)[index.Value()].insert(key);
 }
 
 void
 KeyCache::removeFromIndex(KeyCacheIndex *hash,MyString const &index,KeyCacheEntry *key)
 {
-	SimpleList<KeyCacheEntry *> *keylist=NULL;
-	if( hash->lookup(index,keylist)!=0 ) {
+	KeyCacheIndex::iterator it = hash->find(index.Value());
+	if( it == hash->end() ) {
 		return;
 	}
-	bool deleted = keylist->Delete(key);
+	bool deleted = it->second.erase(key) > 0;
 	ASSERT( deleted );
 
-	if( keylist->Length() == 0 ) {
-		delete keylist;
-		bool removed = hash->remove(index)==0;
-		ASSERT( removed );
+	if( it->second.empty() ) {
+		hash->erase(it);
 	}
 }
 
 bool KeyCache::remove(const char *key_id) {
 	// to remove a key:
 	// you first need to do a lookup, so we can get the pointer to delete.
-	KeyCacheEntry *tmp_ptr = NULL;
-
-	// NOTE: HashTable's lookup returns ZERO on SUCCESS
-	bool res = (key_table->lookup(key_id, tmp_ptr) == 0);
+	KeyCacheTable::iterator it = key_table.find(key_id);
+	if (it == key_table.end()) {
+		return false;
+	}
 
-	if (res) {
-		removeFromIndex( tmp_ptr );
+	KeyCacheEntry *tmp_ptr = it->second;
+	removeFromIndex( tmp_ptr );
+	dequeueExpiration( tmp_ptr );
 
-		// ** HEY **
-		// key_id could be pointing to the string tmp_ptr->id.  so, we'd
-		// better finish using key_id *before* we delete tmp_ptr.
-		res = (key_table->remove(key_id) == 0);
-		delete tmp_ptr;
+	// count the session as expired however it came to be removed, once
+	// it is past its time.
+	time_t expiration = tmp_ptr->expiration();
+	if (expiration && expiration <= time(0)) {
+		m_expired++;
 	}
 
-	return res;
+	// ** HEY **
+	// key_id could be pointing to the string tmp_ptr->id.  so, we'd
+	// better finish using key_id *before* we delete tmp_ptr.
+	key_table.erase(it);
+	delete tmp_ptr;
+
+	return true;
 }
 
 void KeyCache::expire(KeyCacheEntry *e) {
@@ -423,17 +437,27 @@ StringList * KeyCache::getExpiredKeys() {
     StringList * list = new StringList();
 	time_t cutoff_time = time(0);
 
-	// iterate through all entries from the hash
-	KeyCacheEntry* key_entry;
-    MyString id;
-	key_table->startIterations();
-	while (key_table->iterate(id, key_entry)) {
+	// look at the entries that are due, soonest first.  an entry may have
+	// had its lease renewed since it was queued, in which case it is
+	// queued again for its new expiration time.  entries that have
+	// expired stay queued until they are removed, in case the caller
+	// doesn't remove them.
+	std::vector<KeyCacheEntry *> requeue;
+	for (std::set<KeyCacheDeadline>::const_iterator it = m_expirations.begin();
+		 it != m_expirations.end() && it->first <= cutoff_time; ++it)
+	{
+		KeyCacheEntry *e = it->second;
 		// check the freshness date on that key
-		if (key_entry->expiration() && key_entry->expiration() <= cutoff_time) {
-            list->append(id.Value());
-			//expire(key_entry);
+		time_t expiration = e->expiration();
+		if (expiration && expiration <= cutoff_time) {
+			list->append(e->id());
+		} else {
+			requeue.push_back(e);
 		}
 	}
+	for (size_t i = 0; i < requeue.size(); ++i) {
+		expirationChanged(requeue[i]);
+	}
     return list;
 }
 
@@ -443,17 +467,15 @@ KeyCache::getKeysForPeerAddress(char const *addr)
 	if( !addr || !*addr ) {
 		return NULL;
 	}
-	SimpleList<KeyCacheEntry*> *keylist=NULL;
-	if( m_index->lookup(addr,keylist)!=0 ) {
+	KeyCacheIndex::const_iterator it = m_index.find(addr);
+	if( it == m_index.end() ) {
 		return NULL;
 	}
-	ASSERT( keylist );
 
 	StringList *keyids = new StringList;
-	KeyCacheEntry *key=NULL;
 
-	keylist->Rewind();
-	while( keylist->Next(key) ) {
+	for (std::set<KeyCacheEntry *>::const_iterator kt = it->second.begin(); kt != it->second.end(); ++kt) {
+		KeyCacheEntry *key = *kt;
 		std::string server_addr,peer_addr;
 		ClassAd *policy = key->policy();
 
@@ -476,17 +498,15 @@ KeyCache::getKeysForProcess(char const *parent_unique_id,int pid)
 	MyString server_unique_id;
 	makeServerUniqueId(parent_unique_id,pid,&server_unique_id);
 
-	SimpleList<KeyCacheEntry*> *keylist=NULL;
-	if( m_index->lookup(server_unique_id,keylist)!=0 ) {
+	KeyCacheIndex::const_iterator it = m_index.find(server_unique_id.Value());
+	if( it == m_index.end() ) {
 		return NULL;
 	}
-	ASSERT( keylist );
 
 	StringList *keyids = new StringList;
-	KeyCacheEntry *key=NULL;
 
-	keylist->Rewind();
-	while( keylist->Next(key) ) {
+	for (std::set<KeyCacheEntry *>::const_iterator kt = it->second.begin(); kt != it->second.end(); ++kt) {
+		KeyCacheEntry *key = *kt;
 		std::string this_parent_id;
 		MyString this_server_unique_id;
 		int this_server_pid=0;
@@ -507,6 +527,5 @@ KeyCache::getKeysForProcess(char const *parent_unique_id,int pid)
 }
 
 int KeyCache::count() {
-	ASSERT( key_table );
-	return key_table->getNumElements();
+	return (int)key_table.size();
 }
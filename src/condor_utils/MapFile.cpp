@@ -55,6 +55,16 @@
 // In all the V2 MapFile class uses about 2/3 of the memory that the V1 version did
 // when the map is populated with regex entries.  When it is populated with simple
 // literal keys, the memory usage is 1/3 of that of the V1 version.
+//
+// Large certificate and token map files are mostly regexes that are really just
+// an anchored literal (^/DC=org/.../CN=Some User$), a literal prefix (^prefix(.*)$)
+// or a literal suffix (^(.*)@domain$).  Consecutive regexes of these forms are kept
+// in a CanonicalMapAnchoredEntry, which finds the first of them that matches with
+// a few hash lookups rather than running each regex in turn.  Other regexes are
+// still tried one at a time, in order.
+//
+// Since the mapping is a pure function of the map and the input, the results of
+// recent lookups are cached, until the cache gets too big or the map is changed.
 
 struct hash_yourstring {
 	size_t operator()(const YourString & str) const {
@@ -66,6 +76,7 @@ typedef std::unordered_map<const YourString, const char *, hash_yourstring> LITE
 
 class CanonicalMapRegexEntry;
 class CanonicalMapHashEntry;
+class CanonicalMapAnchoredEntry;
 
 // note: NOT virtual so that we don't have the allocation cost of a VTBL per entry
 class CanonicalMapEntry {
@@ -75,9 +86,10 @@ public:
 	~CanonicalMapEntry();
 	bool matches(const char * principal, int cch, ExtArray<MyString> *groups, const char ** pcanon);
 	bool is_hash_type() const { return entry_type == 2; }
+	bool is_anchored_type() const { return entry_type == 3; }
 protected:
 	friend class MapFile;
-	char entry_type; // 0 = base, 1 = CanonicalMapRegexEntry, 2 = CanonicalMapHashEntry
+	char entry_type; // 0 = base, 1 = CanonicalMapRegexEntry, 2 = CanonicalMapHashEntry, 3 = CanonicalMapAnchoredEntry
 	char spare[sizeof(void*)-1];
 };
 
@@ -112,6 +124,44 @@ private:
 	LITERAL_HASH * hm;
 };
 
+// the regexes that can be matched by a CanonicalMapAnchoredEntry
+enum {
+	ANCHORED_NONE = 0,
+	ANCHORED_EXACT,      // ^literal$
+	ANCHORED_PREFIX,     // ^literal
+	ANCHORED_PREFIX_CAP, // ^literal(.*)$
+	ANCHORED_SUFFIX,     // literal$
+	ANCHORED_SUFFIX_CAP, // ^(.*)literal$  or (.*)literal$
+};
+
+class CanonicalMapAnchoredEntry : public CanonicalMapEntry {
+public:
+	CanonicalMapAnchoredEntry() : CanonicalMapEntry(3), am(NULL) {}
+	~CanonicalMapAnchoredEntry() { clear(); }
+	void clear();
+	void add(int kind, const std::string & literal, pcre * re, const char * canon);
+	bool matches(const char * principal, int cch, ExtArray<MyString> *groups, const char ** pcanon);
+	static CanonicalMapAnchoredEntry * is_type(CanonicalMapEntry * that) {
+		if (that && that->is_anchored_type()) { return reinterpret_cast<CanonicalMapAnchoredEntry*>(that); }
+		return NULL;
+	}
+private:
+	friend class MapFile;
+	struct Item {
+		int kind;
+		int cchLiteral;
+		pcre * re;  // used when the input has a newline, which the hash lookups can't handle
+		const char * canonicalization;
+	};
+	typedef std::unordered_map<std::string, int> ITEM_HASH; // literal -> index of the first item with that literal
+	struct Maps {
+		std::vector<Item> items;     // in the order they appear in the map file
+		ITEM_HASH exact, prefix, suffix;
+		std::vector<int> prefix_lengths, suffix_lengths; // distinct literal lengths, in ascending order
+	};
+	Maps * am;
+};
+
 class CanonicalMapList {
 protected:
 	friend class MapFile;
@@ -137,6 +187,8 @@ bool CanonicalMapEntry::matches(const char * principal, int cch, ExtArray<MyStri
 		return reinterpret_cast<CanonicalMapRegexEntry*>(this)->matches(principal, cch, groups, pcanon);
 	} else if (entry_type == 2) {
 		return reinterpret_cast<CanonicalMapHashEntry*>(this)->matches(principal, cch, groups, pcanon);
+	} else if (entry_type == 3) {
+		return reinterpret_cast<CanonicalMapAnchoredEntry*>(this)->matches(principal, cch, groups, pcanon);
 	}
 	return false;
 }
@@ -146,6 +198,8 @@ CanonicalMapEntry::~CanonicalMapEntry() {
 		reinterpret_cast<CanonicalMapRegexEntry*>(this)->clear();
 	} else if (entry_type == 2) {
 		reinterpret_cast<CanonicalMapHashEntry*>(this)->clear();
+	} else if (entry_type == 3) {
+		reinterpret_cast<CanonicalMapAnchoredEntry*>(this)->clear();
 	}
 }
 
@@ -154,6 +208,9 @@ CanonicalMapEntry::~CanonicalMapEntry() {
 
 MapFile::MapFile()
 {
+#if defined(USE_MAPFILE_V2) && defined(HAVE_PTHREADS) && !defined(WIN32)
+	pthread_mutex_init(&cache_lock, NULL);
+#endif
 }
 
 
@@ -161,6 +218,9 @@ MapFile::~MapFile()
 {
 #ifdef USE_MAPFILE_V2
 	clear();
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+	pthread_mutex_destroy(&cache_lock);
+#endif
 #endif
 }
 
@@ -209,6 +269,21 @@ int MapFile::size(MapFileUsage * pusage) // returns number of items in the map
 					cAllocs += chm; cbStructs += chm*sizeof(void*)*4; // key and value are each pointers, + hash entries need a next pointer and the hash value
 					cAllocs += 1; cbStructs += hitem->hm->bucket_count() * (sizeof(void*)+sizeof(size_t)); // each bucket must have an item list
 				}
+			} else if (item->entry_type == 3) {
+				CanonicalMapAnchoredEntry* aitem = reinterpret_cast<CanonicalMapAnchoredEntry*>(item);
+				++cAllocs; cbStructs += sizeof(*aitem);
+				if (aitem->am) {
+					size_t citems = aitem->am->items.size();
+					cHash += citems;
+					++cAllocs; cbStructs += sizeof(*aitem->am);
+					++cAllocs; cbStructs += citems * sizeof(CanonicalMapAnchoredEntry::Item);
+					cAllocs += citems; cbStructs += citems*sizeof(void*)*6; // hash node and the literal string
+					for (size_t ix = 0; ix < citems; ++ix) {
+						CanonicalMapAnchoredEntry::Item & ai = aitem->am->items[ix];
+						cbStructs += ai.cchLiteral;
+						if (ai.re) { cAllocs += 1; cbStructs += re_size(ai.re); }
+					}
+				}
 			} else if (item->entry_type == 1) {
 				CanonicalMapRegexEntry* ritem = reinterpret_cast<CanonicalMapRegexEntry*>(item);
 				++cAllocs; cbStructs += sizeof(*ritem);
@@ -240,6 +315,8 @@ int MapFile::size(MapFileUsage * pusage) // returns number of items in the map
 }
 void MapFile::reset() // remove all items, but do not free the allocation pool
 {
+	lookup_cache.clear();
+
 	// all of the strings are owned by the apool which deletes them when it is destructed
 	// we just have to free the CanonicalMapEntry(s)
 	for (METHOD_MAP::iterator it = methods.begin(); it != methods.end(); /*advance inside the loop*/) {
@@ -614,17 +691,16 @@ MapFile::GetCanonicalization(const MyString method,
 	bool match_found = false;
 
 #ifdef USE_MAPFILE_V2
-	const char * pcanon;
-	ExtArray<MyString> groups;
-
 	METHOD_MAP::iterator found = methods.find(method.c_str());
 	if (found != methods.end() && found->second) {
 #if 1
-		match_found = FindMapping(found->second, principal, &groups, &pcanon);
-		if (match_found) {
-			PerformSubstitution(groups, pcanon, canonicalization);
-		}
+		std::string cache_key(method.c_str());
+		cache_key += '\n';
+		cache_key += principal.c_str();
+		match_found = CachedMapping(found->second, cache_key, principal, canonicalization);
 #else
+		const char * pcanon;
+		ExtArray<MyString> groups;
 		for (CanonicalMapEntry * entry = found->second->first; entry; entry = entry->next) {
 			if (entry->matches(principal.c_str(), principal.Length(), &groups, &pcanon)) {
 				match_found = true;
@@ -685,12 +761,84 @@ CanonicalMapList* MapFile::GetMapList(const char * method) // method is NULL for
 }
 
 
+// If the regex pattern is one of the forms that a CanonicalMapAnchoredEntry can match,
+// return which one, and the literal part of the pattern. otherwise returns ANCHORED_NONE
+static int ParseAnchoredLiteral(const char * pattern, int options, std::string & literal)
+{
+	literal.clear();
+	// the literal must match exactly, (.*) is the same greedy or not, since it is anchored at both ends.
+	if (options & ~PCRE_UNGREEDY) {
+		return ANCHORED_NONE;
+	}
+
+	const char * p = pattern;
+	bool start_anchor = false, lead_capture = false;
+	if (*p == '^') { start_anchor = true; ++p; }
+	if (strncmp(p, "(.*)", 4) == 0) { lead_capture = true; p += 4; }
+
+	for (;;) {
+		char ch = *p;
+		if (ch == '\\') {
+			// backslash followed by anything but a letter or digit is that character, literally.
+			ch = p[1];
+			if ( ! ch || isalnum((unsigned char)ch)) {
+				return ANCHORED_NONE;
+			}
+			literal += ch;
+			p += 2;
+		} else if ( ! ch || strchr("^$.[]|()?*+{}", ch)) {
+			break;
+		} else {
+			literal += ch;
+			++p;
+		}
+	}
+
+	bool end_anchor = false, trail_capture = false;
+	if (strcmp(p, "$") == 0) {
+		end_anchor = true;
+	} else if (strcmp(p, "(.*)$") == 0) {
+		end_anchor = trail_capture = true;
+	} else if (*p) {
+		return ANCHORED_NONE;
+	}
+
+	if (lead_capture) {
+		return (end_anchor && ! trail_capture) ? ANCHORED_SUFFIX_CAP : ANCHORED_NONE;
+	}
+	if (start_anchor) {
+		if (trail_capture) return ANCHORED_PREFIX_CAP;
+		return end_anchor ? ANCHORED_EXACT : ANCHORED_PREFIX;
+	}
+	return (end_anchor && ! trail_capture) ? ANCHORED_SUFFIX : ANCHORED_NONE;
+}
+
 void MapFile::AddEntry(CanonicalMapList* list, int regex_opts, const char * principal, const char * canonicalization)
 {
 	//PRAGMA_REMIND("stringspace these??")
 	const char * canon = apool.insert(canonicalization);
 
-	if (regex_opts) {
+	lookup_cache.clear();
+
+	std::string literal;
+	int anchored = regex_opts ? ParseAnchoredLiteral(principal, regex_opts & ~PCRE_NOTEMPTY, literal) : ANCHORED_NONE;
+	if (anchored) {
+		regex_opts &= ~PCRE_NOTEMPTY; // we use this as a trigger, don't pass it down.
+		// we still need the compiled regex to match input that has a newline.
+		const char * errptr; int erroffset;
+		pcre * re = pcre_compile(principal, regex_opts, &errptr, &erroffset, NULL);
+		if ( ! re) {
+			dprintf(D_ALWAYS, "ERROR: Error compiling expression '%s' -- %s.  this entry will be ignored.\n", principal, errptr);
+			return;
+		}
+		// if the previous entry was an anchored entry, then we will just add this item to it
+		CanonicalMapAnchoredEntry * ame = CanonicalMapAnchoredEntry::is_type(list->last);
+		if ( ! ame) {
+			ame = new CanonicalMapAnchoredEntry();
+			list->append(ame);
+		}
+		ame->add(anchored, literal, re, canon);
+	} else if (regex_opts) {
 		regex_opts &= ~PCRE_NOTEMPTY; // we use this as a trigger, don't pass it down.
 		CanonicalMapRegexEntry * rxme = new CanonicalMapRegexEntry;
 		const char * errptr; int erroffset;
@@ -765,6 +913,126 @@ bool CanonicalMapRegexEntry::add(const char * pattern, int options, const char *
 	return false;
 }
 
+void CanonicalMapAnchoredEntry::clear()
+{
+	if (am) {
+		for (size_t ix = 0; ix < am->items.size(); ++ix) {
+			if (am->items[ix].re) pcre_free(am->items[ix].re);
+		}
+		delete am;
+	}
+	am = NULL;
+}
+
+static void insert_length(std::vector<int> & lengths, int len)
+{
+	std::vector<int>::iterator it = std::lower_bound(lengths.begin(), lengths.end(), len);
+	if (it == lengths.end() || *it != len) {
+		lengths.insert(it, len);
+	}
+}
+
+void CanonicalMapAnchoredEntry::add(int kind, const std::string & literal, pcre * re, const char * canon)
+{
+	if ( ! am) am = new Maps;
+	int index = (int)am->items.size();
+	Item item = { kind, (int)literal.size(), re, canon };
+	am->items.push_back(item);
+
+	// when there is more than one item with the same literal, only the first one can match
+	switch (kind) {
+	case ANCHORED_EXACT:
+		am->exact.insert(std::make_pair(literal, index));
+		break;
+	case ANCHORED_PREFIX:
+	case ANCHORED_PREFIX_CAP:
+		if (am->prefix.insert(std::make_pair(literal, index)).second) {
+			insert_length(am->prefix_lengths, item.cchLiteral);
+		}
+		break;
+	case ANCHORED_SUFFIX:
+	case ANCHORED_SUFFIX_CAP:
+		if (am->suffix.insert(std::make_pair(literal, index)).second) {
+			insert_length(am->suffix_lengths, item.cchLiteral);
+		}
+		break;
+	}
+}
+
+bool CanonicalMapAnchoredEntry::matches(const char * principal, int cch, ExtArray<MyString> *groups, const char ** pcanon)
+{
+	if ( ! am) return false;
+
+	// $ also matches before a trailing newline, and . does not match a newline,
+	// so leave input with a newline to the regexes, in order.
+	if (memchr(principal, '\n', cch)) {
+		const int max_group_count = 11; // only \0 through \9 allowed.
+		int ovector[3 * (max_group_count + 1)]; // +1 for the string itself
+		for (size_t ix = 0; ix < am->items.size(); ++ix) {
+			int rc = pcre_exec(am->items[ix].re, NULL, principal, cch, 0, 0, ovector, (int)COUNTOF(ovector));
+			if (rc <= 0) continue;
+			if (pcanon) *pcanon = am->items[ix].canonicalization;
+			if (groups) {
+				for (int i = 0; i < rc; i++) {
+					(*groups)[i].set(&principal[ovector[i * 2]], ovector[i * 2 + 1] - ovector[i * 2]);
+				}
+			}
+			return true;
+		}
+		return false;
+	}
+
+	// find the first item that matches, which is the one with the lowest index
+	int best = -1;
+	std::string key(principal, cch);
+	ITEM_HASH::iterator found = am->exact.find(key);
+	if (found != am->exact.end()) { best = found->second; }
+	for (size_t ix = 0; ix < am->prefix_lengths.size() && am->prefix_lengths[ix] <= cch; ++ix) {
+		key.assign(principal, am->prefix_lengths[ix]);
+		found = am->prefix.find(key);
+		if (found != am->prefix.end() && (best < 0 || found->second < best)) { best = found->second; }
+	}
+	for (size_t ix = 0; ix < am->suffix_lengths.size() && am->suffix_lengths[ix] <= cch; ++ix) {
+		key.assign(principal + cch - am->suffix_lengths[ix], am->suffix_lengths[ix]);
+		found = am->suffix.find(key);
+		if (found != am->suffix.end() && (best < 0 || found->second < best)) { best = found->second; }
+	}
+	if (best < 0) {
+		return false;
+	}
+
+	// return the same match groups that the regex would have
+	const Item & item = am->items[best];
+	if (pcanon) *pcanon = item.canonicalization;
+	if (groups) {
+		switch (item.kind) {
+		case ANCHORED_PREFIX:
+			(*groups)[0].set(principal, item.cchLiteral);
+			groups->truncate(0);
+			break;
+		case ANCHORED_PREFIX_CAP:
+			(*groups)[0].set(principal, cch);
+			(*groups)[1].set(principal + item.cchLiteral, cch - item.cchLiteral);
+			groups->truncate(1);
+			break;
+		case ANCHORED_SUFFIX:
+			(*groups)[0].set(principal + cch - item.cchLiteral, item.cchLiteral);
+			groups->truncate(0);
+			break;
+		case ANCHORED_SUFFIX_CAP:
+			(*groups)[0].set(principal, cch);
+			(*groups)[1].set(principal, cch - item.cchLiteral);
+			groups->truncate(1);
+			break;
+		default:
+			(*groups)[0].set(principal, cch);
+			groups->truncate(0);
+			break;
+		}
+	}
+	return true;
+}
+
 bool CanonicalMapHashEntry::add(const char * name, const char * canon)
 {
 	if ( ! hm) hm = new LITERAL_HASH;
@@ -785,15 +1053,12 @@ MapFile::GetUser(const MyString canonicalization,
 	bool match_found = false;
 
 #ifdef USE_MAPFILE_V2
-	const char * pcanon;
-	ExtArray<MyString> groups;
-
 	METHOD_MAP::iterator found = methods.find(NULL);
 	if (found != methods.end() && found->second) {
-		match_found = FindMapping(found->second, canonicalization, &groups, &pcanon);
-		if (match_found) {
-			PerformSubstitution(groups, pcanon, user);
-		}
+		// the usermap table has no method, so key it with a character no method can have
+		std::string cache_key(1, '\0');
+		cache_key += canonicalization.c_str();
+		match_found = CachedMapping(found->second, cache_key, canonicalization, user);
 	}
 #else
 	for (int entry = 0;
@@ -811,6 +1076,48 @@ MapFile::GetUser(const MyString canonicalization,
 
 
 #ifdef USE_MAPFILE_V2
+bool
+MapFile::CachedMapping(CanonicalMapList* list, const std::string & cache_key, const MyString & input, MyString & output)
+{
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+	pthread_mutex_lock(&cache_lock);
+#endif
+	LOOKUP_CACHE::iterator hit = lookup_cache.find(cache_key);
+	if (hit != lookup_cache.end()) {
+		bool cached_match = hit->second.first;
+		if (cached_match) { output += hit->second.second; }
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+		pthread_mutex_unlock(&cache_lock);
+#endif
+		return cached_match;
+	}
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+	pthread_mutex_unlock(&cache_lock);
+#endif
+
+	// the map itself is only read here, so the lock isn't held while matching
+	const char * pcanon;
+	ExtArray<MyString> groups;
+	MyString result;
+	bool match_found = FindMapping(list, input, &groups, &pcanon);
+	if (match_found) {
+		PerformSubstitution(groups, pcanon, result);
+	}
+
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+	pthread_mutex_lock(&cache_lock);
+#endif
+	if (lookup_cache.size() >= MAPFILE_LOOKUP_CACHE_SIZE) {
+		lookup_cache.clear();
+	}
+	lookup_cache[cache_key] = std::make_pair(match_found, std::string(result.c_str()));
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+	pthread_mutex_unlock(&cache_lock);
+#endif
+	output += result;
+	return match_found;
+}
+
 bool
 MapFile::FindMapping(CanonicalMapList* list,       // in: the mapping data set
 					const MyString & input,         // in: the input to be matched and mapped.
@@ -28,8 +28,15 @@
 #define USE_MAPFILE_V2 1
 #ifdef USE_MAPFILE_V2
 #include "pool_allocator.h"
+#include <unordered_map>
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+#include <pthread.h>
+#endif
 class CanonicalMapList;
 typedef std::map<const YourString, CanonicalMapList*, CaseIgnLTYourString> METHOD_MAP;
+// results of recent lookups, keyed by method and input. the value is whether there was a match, and the result
+typedef std::unordered_map<std::string, std::pair<bool, std::string> > LOOKUP_CACHE;
+#define MAPFILE_LOOKUP_CACHE_SIZE 1024 // the cache is cleared when it gets this big
 #endif
 
 typedef struct _MapFileUsage {
@@ -48,6 +55,8 @@ class MapFile
  public:
 	MapFile();
 	~MapFile();
+	MapFile(const MapFile &) = delete;
+	MapFile & operator=(const MapFile &) = delete;
 
 	int
 	ParseCanonicalizationFile(const MyString filename, bool assume_hash=false);
@@ -97,6 +106,12 @@ class MapFile
 #ifdef USE_MAPFILE_V2
 	ALLOCATION_POOL apool;
 	METHOD_MAP methods;
+	LOOKUP_CACHE lookup_cache; // cleared whenever an entry is added or removed
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+	// userMap() can be called from the negotiator's matchmaking threads, so
+	// lookups must hold this while they use the cache.
+	pthread_mutex_t cache_lock;
+#endif
 
 	// find or create a CanonicalMapList for the given method.
 	// use NULL as the method value for for the usermap file
@@ -105,6 +120,13 @@ class MapFile
 	// add CanonicalMapEntry of type regex or hash (if regex_opts==0) to the given list
 	void AddEntry(CanonicalMapList* list, int regex_opts, const char * principal, const char * canonicalization);
 
+	// FindMapping and PerformSubstitution, or the result of the last time we did that for this cache_key
+	bool
+	CachedMapping(CanonicalMapList* list,       // in: the mapping data set
+				const std::string & cache_key,  // in: the method and input
+				const MyString & input,         // in: the input to be matched and mapped.
+				MyString & output);             // out: the mapping is appended to this
+
 	bool
 	FindMapping(CanonicalMapList* list,       // in: the mapping data set
 				const MyString & input,         // in: the input to be matched and mapped.
@@ -27,17 +27,22 @@
 #include "util_lib_proto.h" // for rotate_file
 #include "iso_dates.h"
 #include "condor_email.h"
+#include "historyIndex.h"
 
 #include "classadHistory.h"
 
 static FILE *HistoryFile_fp = NULL;
 static int HistoryFile_RefCount = 0;
+static FILE *HistoryIndex_fp = NULL;
+static long long HistoryIndex_end = 0;     // offset in the history file after the last indexed ad
+static bool HistoryIndex_disabled = false; // true when the history file has ads that are not in the index
 
 char* JobHistoryFileName = NULL;
 char* JobHistoryParamName = NULL;
 bool        DoHistoryRotation = true;
 bool        DoDailyHistoryRotation = true;
 bool        DoMonthlyHistoryRotation = true;
+bool        DoHistoryIndex = true;
 filesize_t  MaxHistoryFileSize = 20 * 1024 * 1024; // 20MB;
 int         NumberBackupHistoryFiles = 2;
 char*       PerJobHistoryDir = NULL;
@@ -51,6 +56,8 @@ static int findHistoryOffset(FILE *LogFile);
 static FILE* OpenHistoryFile();
 static void CloseJobHistoryFile();
 static void RelinquishHistoryFile(FILE *fp);
+static void AppendHistoryIndex(const HistoryIndexEntry &entry);
+static void CloseHistoryIndex(bool remove_index);
 
 // --------------------------------------------------------------------------
 // --------- PUBLIC FUNCTIONS (called by schedd, startd, etc) ---------------
@@ -60,6 +67,7 @@ void
 InitJobHistoryFile(const char *history_param, const char *per_job_history_param) {
 
 	CloseJobHistoryFile();
+	HistoryIndex_disabled = false;
 	if( history_param ) {
 		free(JobHistoryParamName);
 		JobHistoryParamName = strdup(history_param);
@@ -74,6 +82,7 @@ InitJobHistoryFile(const char *history_param, const char *per_job_history_param)
     DoHistoryRotation = param_boolean("ENABLE_HISTORY_ROTATION", true);
     DoDailyHistoryRotation = param_boolean("ROTATE_HISTORY_DAILY", false);
     DoMonthlyHistoryRotation = param_boolean("ROTATE_HISTORY_MONTHLY", false);
+    DoHistoryIndex = param_boolean("ENABLE_HISTORY_INDEX", true);
 
 	long long default_history = 20 * 1024 * 1024;
 	long long history_filesize = 0;
@@ -144,6 +153,7 @@ AppendHistory(ClassAd* ad)
 	  failed = true;
   } else {
 	  int offset = findHistoryOffset(LogFile);
+	  long long ad_offset = ftell(LogFile); // findHistoryOffset leaves us at the end of the file
 	  if (!fPrintAd(LogFile, *ad)) {
 		  dprintf(D_ALWAYS, 
 				  "ERROR: failed to write job class ad to history file %s\n",
@@ -169,6 +179,17 @@ AppendHistory(ClassAd* ad)
                       "*** Offset = %d ClusterId = %d ProcId = %d Owner = \"%s\" CompletionDate = %d\n",
 				  offset, cluster, proc, owner.c_str(), completion);
 		  fflush( LogFile );
+
+		  if (DoHistoryIndex) {
+			  HistoryIndexEntry entry;
+			  entry.offset = ad_offset;
+			  entry.end = ftell(LogFile);
+			  entry.cluster = cluster;
+			  entry.proc = proc;
+			  entry.completion = completion;
+			  entry.owner = owner;
+			  AppendHistoryIndex(entry);
+		  }
       }
   }
 
@@ -333,6 +354,93 @@ CloseJobHistoryFile() {
 		fclose( HistoryFile_fp );
 		HistoryFile_fp = NULL;
 	}
+	CloseHistoryIndex(false);
+}
+
+// --------------------------------------------------------------------------
+// Add an entry for the ad just written to the history file to the index of
+// the history file, see historyIndex.h.  We only start an index along with
+// a new history file, and if the history file ever gets an ad that is not
+// in the index we give up on the index until the history file is rotated,
+// which is how condor_history knows whether it can trust the index.
+// --------------------------------------------------------------------------
+static void
+AppendHistoryIndex(const HistoryIndexEntry &entry)
+{
+	if (HistoryIndex_disabled) {
+		return;
+	}
+
+	std::string index_file;
+	historyIndexFilename(JobHistoryFileName, index_file);
+
+	if ( ! HistoryIndex_fp) {
+		if (entry.offset == 0) {
+			// a new history file, so start a new index.
+			HistoryIndex_fp = safe_fopen_wrapper_follow(index_file.c_str(), "w", 0644);
+		} else {
+			// we are appending to an existing history file, which we can only do if
+			// the index has all of the ads that are in it.
+			std::vector<HistoryIndexEntry> entries;
+			if (readHistoryIndex(JobHistoryFileName, entry.offset, entries)) {
+				HistoryIndex_fp = safe_fopen_wrapper_follow(index_file.c_str(), "a", 0644);
+			} else {
+				dprintf(D_FULLDEBUG, "History file %s is not indexed, it will be indexed after it is rotated\n",
+						JobHistoryFileName);
+				CloseHistoryIndex(true);
+				return;
+			}
+		}
+		if ( ! HistoryIndex_fp) {
+			dprintf(D_ALWAYS, "ERROR opening history index file (%s): %s\n",
+					index_file.c_str(), strerror(errno));
+			CloseHistoryIndex(true);
+			return;
+		}
+		HistoryIndex_end = entry.offset;
+	}
+
+	if (entry.offset != HistoryIndex_end) {
+		// something was written to the history file that isn't in the index.
+		dprintf(D_ALWAYS, "History file %s has changed behind the index, will stop indexing it until it is rotated\n",
+				JobHistoryFileName);
+		CloseHistoryIndex(true);
+		return;
+	}
+
+	std::string line;
+	formatHistoryIndexEntry(line, entry);
+	if (fputs(line.c_str(), HistoryIndex_fp) < 0 || fflush(HistoryIndex_fp) != 0) {
+		dprintf(D_ALWAYS, "ERROR writing to history index file (%s): %s\n",
+				index_file.c_str(), strerror(errno));
+		CloseHistoryIndex(true);
+		return;
+	}
+	HistoryIndex_end = entry.end;
+}
+
+// --------------------------------------------------------------------------
+// Close the index of the history file.  If remove_index is true the index
+// is deleted and we don't index the history file until it is rotated.
+// --------------------------------------------------------------------------
+static void
+CloseHistoryIndex(bool remove_index)
+{
+	if (HistoryIndex_fp) {
+		fclose(HistoryIndex_fp);
+		HistoryIndex_fp = NULL;
+	}
+	if (remove_index) {
+		HistoryIndex_disabled = true;
+		if (JobHistoryFileName) {
+			std::string index_file;
+			historyIndexFilename(JobHistoryFileName, index_file);
+			if (unlink(index_file.c_str()) < 0 && errno != ENOENT) {
+				dprintf(D_ALWAYS, "Failed to delete history index file %s: %s\n",
+						index_file.c_str(), strerror(errno));
+			}
+		}
+	}
 }
 
 // --------------------------------------------------------------------------
@@ -490,6 +598,13 @@ MaybeDeleteOneHistoryBackup(void)
                 if (!dir.Remove_Current_File()) {
                     dprintf(D_ALWAYS, "Failed to delete %s\n", oldest_history_filename);
                     num_backups = 0; // prevent looping forever
+                } else {
+                    // and delete the index of the history file, if it has one.
+                    std::string oldest_path(history_dir), index_file;
+                    oldest_path += DIR_DELIM_CHAR;
+                    oldest_path += oldest_history_filename;
+                    historyIndexFilename(oldest_path.c_str(), index_file);
+                    unlink(index_file.c_str());
                 }
             } else {
                 dprintf(D_ALWAYS, "Failed to find/delete %s\n", oldest_history_filename);
@@ -571,6 +686,18 @@ RotateHistory(void)
         dprintf(D_ALWAYS, "Failed to rotate history file to %s\n",
                 rotated_history_name.Value());
         dprintf(D_ALWAYS, "Because rotation failed, the history file may get very large.\n");
+    } else {
+        // The index goes along with the history file, and the new history file
+        // will get a new index.
+        std::string index_file, rotated_index_file;
+        historyIndexFilename(JobHistoryFileName, index_file);
+        historyIndexFilename(rotated_history_name.Value(), rotated_index_file);
+        if (rename(index_file.c_str(), rotated_index_file.c_str()) < 0 && errno != ENOENT) {
+            dprintf(D_ALWAYS, "Failed to rotate history index file to %s: %s\n",
+                    rotated_index_file.c_str(), strerror(errno));
+            unlink(index_file.c_str());
+        }
+        HistoryIndex_disabled = false;
     }
 
     return;
@@ -25,6 +25,7 @@
 extern bool        DoHistoryRotation;
 extern bool        DoDailyHistoryRotation;
 extern bool        DoMonthlyHistoryRotation;
+extern bool        DoHistoryIndex;
 extern filesize_t  MaxHistoryFileSize;
 extern int         NumberBackupHistoryFiles;
 extern char*       PerJobHistoryDir;
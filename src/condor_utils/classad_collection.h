@@ -150,6 +150,11 @@ public:
 		// This means doing both a flush and fsync.
   void ForceLog() { ClassAdLog<K,AD>::ForceLog(); }
 
+		// Sequence numbers of the last write to the log and of the
+		// last write known to be on disk, see ClassAdLog.
+  unsigned long GetCommitSeq() const { return ClassAdLog<K,AD>::GetCommitSeq(); }
+  unsigned long GetSyncedSeq() const { return ClassAdLog<K,AD>::GetSyncedSeq(); }
+
   ///
   Transaction* getActiveTransaction() { return ClassAdLog<K,AD>::getActiveTransaction(); }
   ///
@@ -30,6 +30,10 @@
 #include "classad_merge.h"
 #include "condor_fsync.h"
 #include "condor_attributes.h"
+#include "classad/classadCache.h"
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+#include <pthread.h>
+#endif
 
 #if defined(HAVE_DLOPEN)
 #include "ClassAdLogPlugin.h"
@@ -64,6 +68,274 @@ const ConstructClassAdLogTableEntry<ClassAd*> DefaultMakeClassAdLogTableEntry;
 #endif
 
 
+bool UseBinaryClassAdLog()
+{
+	return param_boolean("CLASSAD_LOG_BINARY", false);
+}
+
+
+// Read the next record of a log in either format
+static LogRecord *
+ReadClassAdLogEntry(FILE *fp, bool binary, BinaryLogCrc & crc, unsigned long recnum, const ConstructLogEntry & maker)
+{
+	if (binary) {
+		return InstantiateBinaryLogEntry(fp, crc, recnum, maker);
+	}
+	return ReadLogEntry(fp, recnum, InstantiateLogEntry, maker);
+}
+
+
+// When true, LogSetAttribute::ReadBody() leaves the value unparsed for LogRecordBatch.
+static bool DeferSetAttributeParse = false;
+
+// Reads the records of a log ahead in batches, and parses the values of the
+// SetAttribute records of each batch on several threads, so that the main
+// thread only has to insert the parsed expressions into the ads.  Parsing
+// the values is most of the cost of loading a large log.
+//
+class LogRecordBatch {
+public:
+	LogRecordBatch(FILE *fp, bool binary, BinaryLogCrc & crc, const ConstructLogEntry & maker, int num_threads);
+	~LogRecordBatch();
+	bool Enabled() const { return num_threads > 0; }
+	// returns the next record, and the offset of the record after it,
+	// or NULL at the end of the log, or at the first corrupt record.
+	LogRecord * Next(unsigned long recnum, long long & next_pos);
+
+private:
+	bool Fill(unsigned long recnum);
+	void SkipCorruptRecord(size_t ix, unsigned long recnum);
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+	void ParseValues(size_t first, size_t count);
+	struct ParseThreadArgs { LogRecordBatch *batch; size_t first; size_t count; };
+	static void * ParseThread(void *arg);
+#endif
+
+	FILE *fp;
+	bool binary;
+	BinaryLogCrc & crc;
+	const ConstructLogEntry & maker;
+	int num_threads;
+	bool at_end;
+	size_t next;
+	long long batch_pos; // offset of the first record of the batch
+	std::vector<LogRecord*> records;
+	std::vector<long long> positions; // offset of the record after each record
+	std::vector<char> parsed; // PARSE_OK, PARSE_FAILED or PARSE_SKIPPED for each record
+	bool parse_failed; // a parse thread found a value that does not parse
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+	pthread_mutex_t parse_lock; // protects parse_failed
+#endif
+
+	enum { PARSE_SKIPPED, PARSE_OK, PARSE_FAILED };
+
+	static const size_t max_records = 64*1024;
+};
+
+LogRecordBatch::LogRecordBatch(FILE *fp_arg, bool binary_arg, BinaryLogCrc & crc_arg, const ConstructLogEntry & maker_arg, int num_threads_arg)
+	: fp(fp_arg)
+	, binary(binary_arg)
+	, crc(crc_arg)
+	, maker(maker_arg)
+	, num_threads(num_threads_arg)
+	, at_end(false)
+	, next(0)
+	, batch_pos(0)
+	, parse_failed(false)
+{
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+	pthread_mutex_init(&parse_lock, NULL);
+#else
+	// without threads, the records are parsed as they are read
+	num_threads = 0;
+#endif
+	if (num_threads > 0) {
+		// the parser sets up its table of functions the first time it is used,
+		// make sure that happens on this thread rather than on the parse threads.
+		ExprTree * tree = NULL;
+		if (ParseClassAdRvalExpr("isUndefined(x)", tree) == 0) {
+			delete tree;
+		}
+	}
+}
+
+LogRecordBatch::~LogRecordBatch()
+{
+	for (size_t ix = next; ix < records.size(); ++ix) {
+		delete records[ix];
+	}
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+	pthread_mutex_destroy(&parse_lock);
+#endif
+}
+
+LogRecord *
+LogRecordBatch::Next(unsigned long recnum, long long & next_pos)
+{
+	if (next >= records.size()) {
+		if (at_end || ! Fill(recnum)) {
+			return NULL;
+		}
+	}
+	next_pos = positions[next];
+	return records[next++];
+}
+
+bool
+LogRecordBatch::Fill(unsigned long recnum)
+{
+	records.clear();
+	positions.clear();
+	next = 0;
+	batch_pos = ftell(fp);
+
+	DeferSetAttributeParse = true;
+	while (records.size() < max_records) {
+		LogRecord *log_rec = ReadClassAdLogEntry(fp, binary, crc, recnum + records.size(), maker);
+		if ( ! log_rec) {
+			at_end = true;
+			break;
+		}
+		records.push_back(log_rec);
+		positions.push_back(ftell(fp));
+	}
+	DeferSetAttributeParse = false;
+	if (records.empty()) {
+		return false;
+	}
+
+	// each thread parses every num_threads'th record, this thread included.
+	size_t count = records.size();
+	parsed.assign(count, PARSE_SKIPPED);
+	parse_failed = false;
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+	std::vector<ParseThreadArgs> args;
+	std::vector<pthread_t> threads;
+	args.reserve(num_threads);
+	for (int ii = 1; ii < num_threads && (size_t)ii < count; ++ii) {
+		args.push_back(ParseThreadArgs{this, (size_t)ii, count});
+		pthread_t th;
+		if (pthread_create(&th, NULL, ParseThread, &args.back()) == 0) {
+			threads.push_back(th);
+		}
+	}
+	ParseValues(0, count);
+	for (auto & th : threads) {
+		pthread_join(th, NULL);
+	}
+#endif
+
+	// A value that fails to parse may make the rest of the batch corrupt, so
+	// the parse threads stop at the first failure and this thread parses
+	// whatever they skipped, and whatever a thread that could not be created
+	// would have parsed.  Which values failed is kept in parsed.
+	for (size_t ix = 0; ix < count; ++ix) {
+		if (parsed[ix] == PARSE_SKIPPED && records[ix]->get_op_type() == CondorLogOp_SetAttribute) {
+			parsed[ix] = ((LogSetAttribute *)records[ix])->ParseValue() ? PARSE_OK : PARSE_FAILED;
+		}
+	}
+
+	// Values that don't parse are checked only for the ascii format, like
+	// LogSetAttribute::ReadBody() does.  In the binary format, Play() will
+	// try to parse the value again, like it does when the log is read serially.
+	if ( ! binary) {
+		bool strict = param_boolean("CLASSAD_LOG_STRICT_PARSING", true);
+		for (size_t ix = 0; ix < count; ++ix) {
+			if (parsed[ix] != PARSE_FAILED) continue;
+			LogSetAttribute * log = (LogSetAttribute *)records[ix];
+			if ( ! strict) {
+				dprintf(D_ALWAYS, "WARNING: strict classad parsing failed for expression: %s\n", log->get_value());
+				continue;
+			}
+			SkipCorruptRecord(ix, recnum + ix);
+			break;
+		}
+	}
+	return ! records.empty();
+}
+
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+// Parse the values of every num_threads'th record starting with first,
+// until one of them fails to parse on any thread.
+void
+LogRecordBatch::ParseValues(size_t first, size_t count)
+{
+	for (size_t ix = first; ix < count; ix += num_threads) {
+		if (records[ix]->get_op_type() != CondorLogOp_SetAttribute) {
+			continue;
+		}
+		pthread_mutex_lock(&parse_lock);
+		bool stop = parse_failed;
+		pthread_mutex_unlock(&parse_lock);
+		if (stop) {
+			break;
+		}
+		if (((LogSetAttribute *)records[ix])->ParseValue()) {
+			parsed[ix] = PARSE_OK;
+		} else {
+			parsed[ix] = PARSE_FAILED;
+			pthread_mutex_lock(&parse_lock);
+			parse_failed = true;
+			pthread_mutex_unlock(&parse_lock);
+			break;
+		}
+	}
+}
+
+void *
+LogRecordBatch::ParseThread(void *arg)
+{
+	ParseThreadArgs * args = (ParseThreadArgs *)arg;
+	args->batch->ParseValues(args->first, args->count);
+	return NULL;
+}
+#endif
+
+// A SetAttribute record whose value did not parse is a corrupt record, and
+// is handled the same way as InstantiateLogEntry() handles corrupt records:
+// it is fatal inside a complete transaction, otherwise it and everything after
+// it in the log is ignored.
+void
+LogRecordBatch::SkipCorruptRecord(size_t ix, unsigned long recnum)
+{
+	LogSetAttribute * log = (LogSetAttribute *)records[ix];
+	long long pos = ix ? positions[ix-1] : batch_pos;
+	dprintf(D_ALWAYS | D_ERROR, "WARNING: Encountered corrupt log record %lu (byte offset %lld)\n", recnum, pos);
+	dprintf(D_ALWAYS | D_ERROR, "    %d %s %s %s\n", log->get_op_type(), log->get_key(), log->get_name(), log->get_value());
+
+	for (size_t jx = ix + 1; jx < records.size(); ++jx) {
+		if (records[jx]->get_op_type() == CondorLogOp_EndTransaction) {
+			EXCEPT("Error: corrupt log record %lu (byte offset %lld) occurred inside closed transaction, recovery failed", recnum, pos);
+		}
+	}
+	unsigned long rest = recnum + (records.size() - ix);
+	for (size_t jx = ix; jx < records.size(); ++jx) {
+		delete records[jx];
+	}
+	records.resize(ix);
+	positions.resize(ix);
+
+	if ( ! at_end) {
+		DeferSetAttributeParse = true;
+		LogRecord *log_rec;
+		while ((log_rec = ReadClassAdLogEntry(fp, binary, crc, rest++, maker)) != NULL) {
+			int op_type = log_rec->get_op_type();
+			delete log_rec;
+			if (op_type == CondorLogOp_EndTransaction) {
+				EXCEPT("Error: corrupt log record %lu (byte offset %lld) occurred inside closed transaction, recovery failed", recnum, pos);
+			}
+		}
+		DeferSetAttributeParse = false;
+	}
+	if (ferror(fp)) {
+		EXCEPT("Error: failed recovering from corrupt log record %lu, errno=%d", recnum, errno);
+	}
+
+	fseek(fp, 0, SEEK_END);
+	at_end = true;
+}
+
+
 // non-templatized worker function that implements the log loading functionality of ClassAdLog
 //
 FILE* LoadClassAdLog(
@@ -74,6 +346,7 @@ FILE* LoadClassAdLog(
 	time_t & m_original_log_birthdate,
 	bool & is_clean,
 	bool & requires_successful_cleaning,
+	bool & binary,
 	MyString & errmsg)
 {
 	FILE* log_fp = NULL;
@@ -97,15 +370,23 @@ FILE* LoadClassAdLog(
 
 	is_clean = true; // was cleanly closed (until we find out otherwise)
 	requires_successful_cleaning = false;
+	binary = ReadBinaryLogHeader(log_fp);
+
+	Stopwatch load_time;
+	load_time.start();
 
-	// Read all of the log records
+	// Read all of the log records, parsing them on several threads if configured to
+	BinaryLogCrc crc;
+	LogRecordBatch batch(log_fp, binary, crc, maker, param_integer("CLASSAD_LOG_RECOVERY_THREADS", 0, 0, 256));
 	LogRecord		*log_rec;
 	unsigned long count = 0;
-	long long next_log_entry_pos = 0;
+	long long next_log_entry_pos = binary ? CLASSAD_LOG_BINARY_MAGIC_LEN : 0;
     long long curr_log_entry_pos = 0;
-	while ((log_rec = ReadLogEntry(log_fp, 1+count, InstantiateLogEntry, maker)) != 0) {
+	long long next_pos = 0;
+	while ((log_rec = batch.Enabled() ? batch.Next(1+count, next_pos)
+	                                  : ReadClassAdLogEntry(log_fp, binary, crc, 1+count, maker)) != 0) {
         curr_log_entry_pos = next_log_entry_pos;
-		next_log_entry_pos = ftell(log_fp);
+		next_log_entry_pos = batch.Enabled() ? next_pos : ftell(log_fp);
 		count++;
 		switch (log_rec->get_op_type()) {
 		case CondorLogOp_Error:
@@ -155,6 +436,8 @@ FILE* LoadClassAdLog(
 		}
 	}
 	long long final_log_entry_pos = ftell(log_fp);
+	dprintf(D_ALWAYS, "Read %lu records (%lld bytes) from %s log %s in %.3f seconds\n",
+		count, final_log_entry_pos, binary ? "binary" : "ascii", filename, load_time.stop() / 1000);
 	if( next_log_entry_pos != final_log_entry_pos ) {
 		// The log file has a broken line at the end so we _must_
 		// _not_ write anything more into this log.
@@ -178,8 +461,17 @@ FILE* LoadClassAdLog(
 		}
 	}
 	if(!count) {
+		if ( ! binary && final_log_entry_pos == 0 && UseBinaryClassAdLog()) {
+			// a new log, so start it in the configured format
+			if ( ! WriteBinaryLogHeader(log_fp)) {
+				errmsg.formatstr("write to %s failed, errno = %d\n", filename, errno);
+				fclose(log_fp);
+				return NULL;
+			}
+			binary = true;
+		}
 		log_rec = new LogHistoricalSequenceNumber( historical_sequence_number, m_original_log_birthdate );
-		if (log_rec->Write(log_fp) < 0) {
+		if (log_rec->Write(log_fp, binary) < 0) {
 			errmsg.formatstr("write to %s failed, errno = %d\n", filename, errno);
 			fclose(log_fp);
 			delete log_rec;
@@ -192,6 +484,207 @@ FILE* LoadClassAdLog(
 }
 
 
+bool ConvertClassAdLog(
+	const char * filename,
+	const char * new_filename,
+	bool binary,
+	unsigned long & records,
+	MyString & errmsg)
+{
+	records = 0;
+
+	FILE *fp = safe_fopen_wrapper_follow(filename, "r");
+	if ( ! fp) {
+		errmsg.formatstr("failed to open log %s, errno = %d\n", filename, errno);
+		return false;
+	}
+
+	int new_fd = safe_create_replace_if_exists(new_filename, O_WRONLY | O_CREAT | O_LARGEFILE | _O_NOINHERIT, 0600);
+	if (new_fd < 0) {
+		errmsg.formatstr("failed to create %s, errno = %d\n", new_filename, errno);
+		fclose(fp);
+		return false;
+	}
+	FILE *new_fp = fdopen(new_fd, "w");
+	if ( ! new_fp) {
+		errmsg.formatstr("failed to fdopen %s, errno = %d\n", new_filename, errno);
+		close(new_fd);
+		fclose(fp);
+		return false;
+	}
+
+	bool from_binary = ReadBinaryLogHeader(fp);
+	bool success = ! binary || WriteBinaryLogHeader(new_fp);
+
+		// copy the records as they are, an incomplete transaction at the
+		// end of the log is ignored by whoever loads the new file.
+	LogRecord *log_rec;
+	BinaryLogCrc crc, new_crc;
+	long long next_log_entry_pos = ftell(fp);
+	while (success && (log_rec = ReadClassAdLogEntry(fp, from_binary, crc, 1+records, DefaultMakeClassAdLogTableEntry)) != NULL) {
+		next_log_entry_pos = ftell(fp);
+		success = log_rec->Write(new_fp, binary, &new_crc) >= 0;
+		delete log_rec;
+		if (success) {
+			records++;
+		}
+	}
+	if ( ! success) {
+		errmsg.formatstr("write to %s failed, errno = %d\n", new_filename, errno);
+	} else if (next_log_entry_pos != ftell(fp)) {
+		errmsg.formatstr("Warning: ignored a corrupt or unterminated record at the end of %s\n", filename);
+	}
+	fclose(fp);
+
+	if (success && (fflush(new_fp) != 0 || condor_fsync(fileno(new_fp)) < 0)) {
+		errmsg.formatstr("fsync of %s failed, errno = %d\n", new_filename, errno);
+		success = false;
+	}
+	fclose(new_fp);
+	if ( ! success) {
+		unlink(new_filename);
+	}
+	return success;
+}
+
+
+static LogRecord * NewLogEntryOfType(int type, const ConstructLogEntry & ctor);
+
+// Read the next record of a log that may still be growing.  Unlike ReadClassAdLogEntry(),
+// a bad record is returned as a CondorLogOp_Error record rather than looking ahead for the
+// end of its transaction, since that may be a record the writer has only partly flushed.
+// In the ascii format, a record that does not end with a newline is also incomplete.
+static LogRecord *
+ReadGrowingClassAdLogEntry(FILE *fp, bool binary, BinaryLogCrc & crc)
+{
+	LogRecord *log_rec = NULL;
+	if (binary) {
+		int op_type = CondorLogOp_Error;
+		std::vector<std::string> fields;
+		int rval = ReadBinaryLogRecord(fp, crc, op_type, fields);
+		if (rval == 0) {
+			return NULL;
+		}
+		if (rval > 0 && valid_record_optype(op_type)) {
+			log_rec = NewLogEntryOfType(op_type, DefaultMakeClassAdLogTableEntry);
+			if (log_rec && log_rec->ReadBinaryBody(fields) < 0) {
+				delete log_rec;
+				log_rec = NULL;
+			}
+		}
+	} else {
+		char *opword = NULL;
+		if (LogRecord::readword(fp, opword) < 0) {
+			return NULL;
+		}
+		int op_type = CondorLogOp_Error;
+		YourStringDeserializer lex(opword);
+		if (lex.deserialize_int(&op_type) && valid_record_optype(op_type) && op_type != CondorLogOp_Error) {
+			log_rec = NewLogEntryOfType(op_type, DefaultMakeClassAdLogTableEntry);
+		}
+		free(opword);
+		if (log_rec) {
+			bool complete = log_rec->ReadBody(fp) >= 0 &&
+				fseek(fp, -1, SEEK_CUR) == 0 && fgetc(fp) == '\n';
+			if ( ! complete) {
+				delete log_rec;
+				log_rec = NULL;
+			}
+		}
+	}
+	if ( ! log_rec) {
+		log_rec = new LogRecordError();
+	}
+	return log_rec;
+}
+
+bool ScanClassAdLogCommitted(
+	FILE * fp,
+	long long start_offset,
+	long long & committed_end,
+	unsigned long & historical_sequence_number,
+	time_t & original_log_birthdate,
+	MyString & errmsg)
+{
+	committed_end = 0;
+	historical_sequence_number = 0;
+	original_log_birthdate = 0;
+
+	if (fseek(fp, 0, SEEK_END) != 0) {
+		errmsg.formatstr("failed to seek in log, errno = %d\n", errno);
+		return false;
+	}
+	long long size = ftell(fp);
+	if (start_offset < 0 || start_offset > size) {
+		errmsg.formatstr("offset %lld is beyond the end of the log (%lld bytes)\n", start_offset, size);
+		return false;
+	}
+
+	bool binary = ReadBinaryLogHeader(fp);
+	committed_end = ftell(fp);
+
+	BinaryLogCrc crc;
+	LogRecord *log_rec = ReadGrowingClassAdLogEntry(fp, binary, crc);
+	if ( ! log_rec) {
+		// an empty log
+		return true;
+	}
+	bool in_transaction = false;
+	switch (log_rec->get_op_type()) {
+	case CondorLogOp_LogHistoricalSequenceNumber:
+		historical_sequence_number = ((LogHistoricalSequenceNumber *)log_rec)->get_historical_sequence_number();
+		original_log_birthdate = ((LogHistoricalSequenceNumber *)log_rec)->get_timestamp();
+		committed_end = ftell(fp);
+		break;
+	case CondorLogOp_BeginTransaction:
+		in_transaction = true;
+		break;
+	case CondorLogOp_Error:
+		// the first record is still being written
+		delete log_rec;
+		return true;
+	default:
+		committed_end = ftell(fp);
+		break;
+	}
+	delete log_rec;
+
+	if (start_offset > committed_end) {
+		if (fseek(fp, start_offset, SEEK_SET) != 0) {
+			errmsg.formatstr("failed to seek to offset %lld in log, errno = %d\n", start_offset, errno);
+			return false;
+		}
+		committed_end = start_offset;
+		in_transaction = false;
+		crc.Reset(true);
+	}
+
+	while ((log_rec = ReadGrowingClassAdLogEntry(fp, binary, crc)) != NULL) {
+		int op_type = log_rec->get_op_type();
+		delete log_rec;
+		switch (op_type) {
+		case CondorLogOp_Error:
+			// the committed data ends at a bad record, which at the end of a growing
+			// log is usually one that the writer is in the middle of flushing.
+			return true;
+		case CondorLogOp_BeginTransaction:
+			in_transaction = true;
+			break;
+		case CondorLogOp_EndTransaction:
+			in_transaction = false;
+			committed_end = ftell(fp);
+			break;
+		default:
+			if ( ! in_transaction) {
+				committed_end = ftell(fp);
+			}
+			break;
+		}
+	}
+	return true;
+}
+
+
 int FlushClassAdLog(FILE* fp, bool force)
 {
 	if ( ! fp)
@@ -260,6 +753,7 @@ bool TruncateClassAdLog(
 	FILE* &log_fp,                  // in,out
 	unsigned long & historical_sequence_number, // in,out
 	time_t & m_original_log_birthdate, // in,out
+	bool & binary,                  // in,out
 	MyString & errmsg) // out
 {
 	MyString	tmp_log_filename;
@@ -288,10 +782,12 @@ bool TruncateClassAdLog(
 	unsigned long future_sequence_number = historical_sequence_number + 1;
 
 	// flush our current state into the temp file,
-	// with a future value for sequence number
+	// with a future value for sequence number,
+	// in the format that is configured now
+	bool new_binary = UseBinaryClassAdLog();
 	bool success = WriteClassAdLogState(new_log_fp, tmp_log_filename.Value(),
 		future_sequence_number, m_original_log_birthdate,
-		la, maker, errmsg);
+		la, maker, errmsg, new_binary);
 
 	fclose(log_fp);
 	log_fp = NULL;
@@ -328,6 +824,7 @@ bool TruncateClassAdLog(
 
 	// we successfully wrote and rotated, so we can update our sequence number
 	historical_sequence_number = future_sequence_number;
+	binary = new_binary;
 
 #ifndef WIN32
 	// POSIX does not provide any durability guarantees for rename().  Instead, we must
@@ -543,14 +1040,20 @@ bool WriteClassAdLogState(
 	time_t m_original_log_birthdate, // in
 	LoggableClassAdTable & la,
 	const ConstructLogEntry& maker,
-	MyString & errmsg)
+	MyString & errmsg,
+	bool binary)
 {
 	LogRecord	*log=NULL;
 	ExprTree	*expr=NULL;
 
+	if (binary && ! WriteBinaryLogHeader(fp)) {
+		errmsg.formatstr("write to %s failed, errno = %d", filename, errno);
+		return false;
+	}
+
 	// This must always be the first entry in the log.
 	log = new LogHistoricalSequenceNumber( historical_sequence_number, m_original_log_birthdate );
-	if (log->Write(fp) < 0) {
+	if (log->Write(fp, binary) < 0) {
 		errmsg.formatstr("write to %s failed, errno = %d", filename, errno);
 		delete log;
 		return false;
@@ -563,7 +1066,7 @@ bool WriteClassAdLogState(
 	la.startIterations();
 	while(la.nextIteration(key, ad)) {
 		log = new LogNewClassAd(key, GetMyTypeName(*ad), GetTargetTypeName(*ad), maker);
-		if (log->Write(fp) < 0) {
+		if (log->Write(fp, binary) < 0) {
 			errmsg.formatstr("write to %s failed, errno = %d", filename, errno);
 			delete log;
 			return false;
@@ -582,7 +1085,7 @@ bool WriteClassAdLogState(
 			if (expr) {
 				log = new LogSetAttribute(key, itr->first.c_str(),
 										  ExprTreeToString(expr));
-				if (log->Write(fp) < 0) {
+				if (log->Write(fp, binary) < 0) {
 					errmsg.formatstr("write to %s failed, errno = %d", filename, errno);
 					delete log;
 					return false;
@@ -653,6 +1156,32 @@ LogHistoricalSequenceNumber::WriteBody(FILE *fp)
 	return (fwrite(buf, 1, len, fp) < (unsigned)len) ? -1: len;
 }
 
+int
+LogHistoricalSequenceNumber::WriteBinaryBody(std::vector<std::string> & fields)
+{
+	fields.emplace_back(std::to_string(historical_sequence_number));
+	fields.emplace_back("CreationTimestamp");
+	fields.emplace_back(std::to_string((unsigned long)timestamp));
+	return 0;
+}
+
+int
+LogHistoricalSequenceNumber::ReadBinaryBody(const std::vector<std::string> & fields)
+{
+	if (fields.size() != 3) {
+		return -1;
+	}
+	YourStringDeserializer des(fields[0].c_str());
+	if ( ! des.deserialize_int(&historical_sequence_number)) {
+		return -1;
+	}
+	des = fields[2].c_str();
+	if ( ! des.deserialize_int(&timestamp)) {
+		return -1;
+	}
+	return 0;
+}
+
 LogNewClassAd::LogNewClassAd(const char *k, const char *m, const char *t, const ConstructLogEntry & c) : ctor(c)
 {
 	op_type = CondorLogOp_NewClassAd;
@@ -750,6 +1279,31 @@ LogNewClassAd::WriteBody(FILE* fp)
 	return rval + rval1;
 }
 
+int
+LogNewClassAd::WriteBinaryBody(std::vector<std::string> & fields)
+{
+		// empty types need no placeholder here
+	fields.emplace_back(key);
+	fields.emplace_back(mytype ? mytype : "");
+	fields.emplace_back(targettype ? targettype : "");
+	return 0;
+}
+
+int
+LogNewClassAd::ReadBinaryBody(const std::vector<std::string> & fields)
+{
+	if (fields.size() != 3) {
+		return -1;
+	}
+	free(key);
+	key = strdup(fields[0].c_str());
+	free(mytype);
+	mytype = strdup(fields[1].c_str());
+	free(targettype);
+	targettype = strdup(fields[2].c_str());
+	return 0;
+}
+
 LogDestroyClassAd::LogDestroyClassAd(const char *k, const ConstructLogEntry & c) : ctor(c)
 {
 	op_type = CondorLogOp_DestroyClassAd;
@@ -788,6 +1342,17 @@ LogDestroyClassAd::ReadBody(FILE* fp)
 	return readword(fp, key);
 }
 
+int
+LogDestroyClassAd::ReadBinaryBody(const std::vector<std::string> & fields)
+{
+	if (fields.size() != 1) {
+		return -1;
+	}
+	free(key);
+	key = strdup(fields[0].c_str());
+	return 0;
+}
+
 LogSetAttribute::LogSetAttribute(const char *k, const char *n, const char *val, bool dirty)
 {
 	op_type = CondorLogOp_SetAttribute;
@@ -815,6 +1380,46 @@ LogSetAttribute::~LogSetAttribute()
     if (value_expr != NULL) delete value_expr;
 }
 
+bool
+LogSetAttribute::ParseValue()
+{
+	if (value_expr) delete value_expr;
+	value_expr = NULL;
+	// LogRecordBatch parses values on several threads at once, so the
+	// parser must not set classad::CondorErrMsg, which they all share
+	classad::ClassAdParser parser;
+	parser.SetOldClassAd(true);
+	parser.SetPrivateErrors(true);
+	if ( ! parser.ParseExpression(value, value_expr, true)) {
+		if (value_expr) delete value_expr;
+		value_expr = NULL;
+		return false;
+	}
+	return true;
+}
+
+// Insert an expression that was parsed from value, using the expression
+// cache the same way that ClassAd::InsertViaCache() does.
+static bool
+InsertParsedViaCache(ClassAd * ad, std::string & attr, const char * value, ExprTree * tree)
+{
+	if (attr.empty()) {
+		delete tree;
+		return false;
+	}
+	if (classad::ClassAdGetExpressionCaching() && attr[0] != '\'') {
+		std::string rhs(value);
+		classad::CachedExprEnvelope * penv = classad::CachedExprEnvelope::check_hit(attr, rhs);
+		if (penv) {
+			delete tree;
+			tree = penv;
+		} else {
+			tree = classad::CachedExprEnvelope::cache(attr, tree, rhs);
+		}
+	}
+	return ad->Insert(attr, tree);
+}
+
 
 int
 LogSetAttribute::Play(void *data_structure)
@@ -826,7 +1431,15 @@ LogSetAttribute::Play(void *data_structure)
 		return -1;
 
 	std::string attr(name);
-	if (ad->InsertViaCache(attr, value)) {
+	bool inserted;
+	if (value_expr) {
+		// the value was parsed when this record was made or read, so don't parse it again
+		inserted = InsertParsedViaCache(ad, attr, value, value_expr);
+		value_expr = NULL; // the ad owns it now
+	} else {
+		inserted = ad->InsertViaCache(attr, value);
+	}
+	if (inserted) {
 		rval = TRUE;
 	} else {
 		rval = FALSE;
@@ -884,6 +1497,21 @@ LogSetAttribute::WriteBody(FILE* fp)
 	return rval1 + rval;
 }
 
+int
+LogSetAttribute::WriteBinaryBody(std::vector<std::string> & fields)
+{
+	// The binary format could hold a newline, but then the log could
+	// not be converted to the ascii format, so refuse them here as well.
+	if( strchr(key, '\n') || strchr(name, '\n') || strchr(value, '\n') ) {
+		dprintf(D_ALWAYS, "Refusing attempt to add '%s' = '%s' to record '%s' as it contains a newline, which is not allowed.\n", name, value, key);
+		return -1;
+	}
+	fields.emplace_back(key);
+	fields.emplace_back(name);
+	fields.emplace_back(value);
+	return 0;
+}
+
 int
 LogSetAttribute::ReadBody(FILE* fp)
 {
@@ -910,9 +1538,11 @@ LogSetAttribute::ReadBody(FILE* fp)
 
 	if (value_expr) delete value_expr;
 	value_expr = NULL;
-	if (ParseClassAdRvalExpr(value, value_expr)) {
-		if (value_expr) delete value_expr;
-		value_expr = NULL;
+	if (DeferSetAttributeParse) {
+		// LoadClassAdLog() will parse the value, see LogRecordBatch
+		return rval + rval1;
+	}
+	if ( ! ParseValue()) {
 		if (param_boolean("CLASSAD_LOG_STRICT_PARSING", true)) {
 			return -1;
 		} else {
@@ -922,6 +1552,28 @@ LogSetAttribute::ReadBody(FILE* fp)
 	return rval + rval1;
 }
 
+int
+LogSetAttribute::ReadBinaryBody(const std::vector<std::string> & fields)
+{
+	if (fields.size() != 3) {
+		return -1;
+	}
+	free(key);
+	key = strdup(fields[0].c_str());
+	free(name);
+	name = strdup(fields[1].c_str());
+	free(value);
+	value = strdup(fields[2].c_str());
+
+	// Unlike ReadBody(), don't parse the value to check it.  The checksum
+	// says that this is the value that was written, and the constructor
+	// only lets values that parse be written.  Play() parses it (or finds
+	// it in the expression cache), so this is the only parse on recovery.
+	if (value_expr) delete value_expr;
+	value_expr = NULL;
+	return 0;
+}
+
 
 LogDeleteAttribute::LogDeleteAttribute(const char *k, const char *n)
 {
@@ -976,6 +1628,27 @@ LogDeleteAttribute::WriteBody(FILE* fp)
 	return rval1 + rval;
 }
 
+int
+LogDeleteAttribute::WriteBinaryBody(std::vector<std::string> & fields)
+{
+	fields.emplace_back(key);
+	fields.emplace_back(name);
+	return 0;
+}
+
+int
+LogDeleteAttribute::ReadBinaryBody(const std::vector<std::string> & fields)
+{
+	if (fields.size() != 2) {
+		return -1;
+	}
+	free(key);
+	key = strdup(fields[0].c_str());
+	free(name);
+	name = strdup(fields[1].c_str());
+	return 0;
+}
+
 int
 LogBeginTransaction::Play(void *){
 #if defined(HAVE_DLOPEN)
@@ -1040,6 +1713,28 @@ LogEndTransaction::ReadBody( FILE* fp )
 	return( 1 );
 }
 
+int
+LogEndTransaction::WriteBinaryBody(std::vector<std::string> & fields)
+{
+	if (comment && comment[0]) {
+		fields.emplace_back(comment);
+	}
+	return 0;
+}
+
+int
+LogEndTransaction::ReadBinaryBody(const std::vector<std::string> & fields)
+{
+	if (fields.size() > 1) {
+		return -1;
+	}
+	free(comment);
+	if (fields.size() == 1) {
+		comment = strdup(fields[0].c_str());
+	}
+	return 0;
+}
+
 int
 LogDeleteAttribute::ReadBody(FILE* fp)
 {
@@ -1059,8 +1754,8 @@ LogDeleteAttribute::ReadBody(FILE* fp)
 	return rval + rval1;
 }
 
-LogRecord	*
-InstantiateLogEntry(FILE *fp, unsigned long recnum, int type, const ConstructLogEntry & ctor)
+static LogRecord *
+NewLogEntryOfType(int type, const ConstructLogEntry & ctor)
 {
 	LogRecord	*log_rec;
 
@@ -1093,6 +1788,16 @@ InstantiateLogEntry(FILE *fp, unsigned long recnum, int type, const ConstructLog
 		    return NULL;
 			break;
 	}
+	return log_rec;
+}
+
+LogRecord	*
+InstantiateLogEntry(FILE *fp, unsigned long recnum, int type, const ConstructLogEntry & ctor)
+{
+	LogRecord	*log_rec = NewLogEntryOfType(type, ctor);
+	if ( ! log_rec) {
+		return NULL;
+	}
 
 	long long pos = ftell(fp);
 
@@ -1158,6 +1863,47 @@ InstantiateLogEntry(FILE *fp, unsigned long recnum, int type, const ConstructLog
 	return log_rec;
 }
 
+LogRecord *
+InstantiateBinaryLogEntry(FILE *fp, BinaryLogCrc & crc, unsigned long recnum, const ConstructLogEntry & ctor)
+{
+	long long pos = ftell(fp);
+	int op_type = CondorLogOp_Error;
+	std::vector<std::string> fields;
+
+	int rval = ReadBinaryLogRecord(fp, crc, op_type, fields);
+	if (rval == 0) {
+		return NULL;
+	}
+	if (rval > 0) {
+		LogRecord *log_rec = valid_record_optype(op_type) ? NewLogEntryOfType(op_type, ctor) : NULL;
+		if (log_rec && log_rec->ReadBinaryBody(fields) >= 0) {
+			return log_rec;
+		}
+		delete log_rec;
+		rval = -2;
+	}
+
+	dprintf(D_ALWAYS | D_ERROR, "WARNING: Encountered corrupt log record %lu (byte offset %lld)\n", recnum, pos);
+
+	// As for the ascii format, a bad record inside a complete transaction
+	// is fatal, otherwise the bad record and everything after it is ignored.
+	// If the length of the bad record was garbage, the following records
+	// can't be found, so we can't tell whether the transaction was complete.
+	if (rval == -2) {
+		while ((rval = ReadBinaryLogRecord(fp, crc, op_type, fields)) != 0 && rval != -1) {
+			if (rval > 0 && op_type == CondorLogOp_EndTransaction) {
+				EXCEPT("Error: corrupt log record %lu (byte offset %lld) occurred inside closed transaction, recovery failed", recnum, pos);
+			}
+		}
+	}
+	if (ferror(fp)) {
+		EXCEPT("Error: failed recovering from corrupt log record %lu, errno=%d", recnum, errno);
+	}
+
+	fseek(fp, 0, SEEK_END);
+	return NULL;
+}
+
 // Force instantiation of the simple form of ClassAdLog, used the the Accountant
 //
 template class ClassAdLog<std::string,ClassAd*>;
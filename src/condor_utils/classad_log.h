@@ -94,6 +94,10 @@ public:
 			HashIterator<K,AD> m_cur;
 			bool m_found_ad;
 			const classad::ExprTree *m_requirements;
+				// m_requirements compiled for repeated evaluation, or
+				// NULL if it could not be compiled.  Shared by copies
+				// of the iterator.
+			classad_shared_ptr<classad::CompiledExpr> m_program;
 			int m_timeslice_ms;
 			int m_done;
 			int m_options;
@@ -106,7 +110,15 @@ public:
 				, m_requirements(requirements)
 				, m_timeslice_ms(timeslice_ms)
 				, m_done(at_end)
-				, m_options(0) {}
+				, m_options(0)
+			{
+				if (requirements && !at_end) {
+					m_program.reset(new classad::CompiledExpr());
+					if ( ! m_program->Compile(requirements)) {
+						m_program.reset();
+					}
+				}
+			}
 
 			~filter_iterator() {}
 			AD operator *() const {
@@ -171,6 +183,14 @@ public:
 		// This means doing both a flush and fsync.
 	void ForceLog();
 
+		// Each write to the log (a committed transaction, or a record
+		// appended outside of one) gets the next sequence number.
+		// GetSyncedSeq() is the last one known to be on disk.  This lets
+		// a caller that commits non-durably tell when a later ForceLog()
+		// or durable commit has made its commit durable as well.
+	unsigned long GetCommitSeq() const { return m_commit_seq; }
+	unsigned long GetSyncedSeq() const { return m_synced_seq; }
+
 	bool AdExistsInTableOrTransaction(const K& key);
 
 	// returns 1 and sets val if corresponding SetAttribute found
@@ -231,6 +251,7 @@ protected:
 private:
 	void LogState(FILE* fp);
 	FILE* log_fp;
+	bool m_binary_log; // log_fp is in the binary format, see CLASSAD_LOG_BINARY
 
 	char const *logFilename() { return log_filename_buf.Value(); }
 	MyString log_filename_buf;
@@ -239,6 +260,8 @@ private:
 	unsigned long historical_sequence_number;
 	time_t m_original_log_birthdate;
 	int m_nondurable_level;
+	unsigned long m_commit_seq;
+	unsigned long m_synced_seq;
 
 	bool SaveHistoricalLogs();
 };
@@ -255,6 +278,8 @@ public:
 private:
 	virtual int WriteBody(FILE *fp);
 	virtual int ReadBody(FILE *fp);
+	virtual int WriteBinaryBody(std::vector<std::string> & fields);
+	virtual int ReadBinaryBody(const std::vector<std::string> & fields);
 
 	virtual char const *get_key() {return NULL;}
 
@@ -331,6 +356,8 @@ public:
 private:
 	virtual int WriteBody(FILE *fp);
 	virtual int ReadBody(FILE* fp);
+	virtual int WriteBinaryBody(std::vector<std::string> & fields);
+	virtual int ReadBinaryBody(const std::vector<std::string> & fields);
 
 	const ConstructLogEntry & ctor;
 	char *key;
@@ -349,6 +376,8 @@ public:
 private:
 	virtual int WriteBody(FILE* fp) { size_t r=fwrite(key, sizeof(char), strlen(key), fp); return (r < strlen(key)) ? -1 : (int)r;}
 	virtual int ReadBody(FILE* fp);
+	virtual int WriteBinaryBody(std::vector<std::string> & fields) { fields.emplace_back(key); return 0; }
+	virtual int ReadBinaryBody(const std::vector<std::string> & fields);
 
 	const ConstructLogEntry & ctor;
 	char *key;
@@ -364,10 +393,15 @@ public:
 	char const *get_name() { return name; }
 	char const *get_value() { return value; }
     ExprTree* get_expr() { return value_expr; }
+	// Parse the value into the expression that Play() inserts, returns false if it doesn't parse.
+	// This is safe to call from a thread other than the main thread, see LoadClassAdLog().
+	bool ParseValue();
 
 private:
 	virtual int WriteBody(FILE* fp);
 	virtual int ReadBody(FILE* fp);
+	virtual int WriteBinaryBody(std::vector<std::string> & fields);
+	virtual int ReadBinaryBody(const std::vector<std::string> & fields);
 
 	char *key;
 	char *name;
@@ -387,6 +421,8 @@ public:
 private:
 	virtual int WriteBody(FILE* fp);
 	virtual int ReadBody(FILE* fp);
+	virtual int WriteBinaryBody(std::vector<std::string> & fields);
+	virtual int ReadBinaryBody(const std::vector<std::string> & fields);
 
 	char *key;
 	char *name;
@@ -402,6 +438,7 @@ private:
 
 	virtual int WriteBody(FILE* /*fp*/) {return 0;}
 	virtual int ReadBody(FILE* fp);
+	virtual int ReadBinaryBody(const std::vector<std::string> & fields) { return fields.empty() ? 0 : -1; }
 
 	virtual char const *get_key() {return NULL;}
 };
@@ -424,6 +461,8 @@ public:
 private:
 	virtual int WriteBody(FILE* fp);
 	virtual int ReadBody(FILE* fp);
+	virtual int WriteBinaryBody(std::vector<std::string> & fields);
+	virtual int ReadBinaryBody(const std::vector<std::string> & fields);
 
 	virtual char const *get_key() {return NULL;}
 	char * comment;
@@ -440,6 +479,7 @@ bool TruncateClassAdLog(
 	FILE* &log_fp,                  // in,out
 	unsigned long & historical_sequence_number, // in,out
 	time_t & m_original_log_birthdate, // in,out
+	bool & binary,                  // in,out: true if log_fp is in the binary format
 	MyString & errmsg);             // out
 
 bool WriteClassAdLogState(
@@ -449,7 +489,8 @@ bool WriteClassAdLogState(
 	time_t original_log_birthdate,  // in
 	LoggableClassAdTable & la,      // in
 	const ConstructLogEntry& maker, // in
-	MyString & errmsg);             // out
+	MyString & errmsg,              // out
+	bool binary = false);           // in: write the binary format
 
 FILE* LoadClassAdLog(
 	const char *filename,           // in
@@ -459,8 +500,35 @@ FILE* LoadClassAdLog(
 	time_t & m_original_log_birthdate, // in,out
 	bool & is_clean,  // out: true if log was shutdown cleanly
 	bool & requires_successful_cleaning, // out: true if log must be cleaned (i.e rotated) before it can be written to again.
+	bool & binary,                  // out: true if the log is in the binary format
 	MyString & errmsg);             // out, contains error or warning messages
 
+// true if CLASSAD_LOG_BINARY says that logs should be written in the binary format
+bool UseBinaryClassAdLog();
+
+// Copy each record of a log into a new file in the ascii or binary format,
+// transactions and all, so that the new file can replace the old one.
+bool ConvertClassAdLog(
+	const char * filename,          // in
+	const char * new_filename,      // in
+	bool binary,                    // in: format of the new file
+	unsigned long & records,        // out: number of records copied
+	MyString & errmsg);             // out
+
+// Find how much of an open log has been committed, i.e. the offset just past the last
+// record that is not part of an unfinished transaction.  The records are read starting
+// at start_offset, which must be 0 or a committed_end from an earlier scan of the same log.
+// The historical sequence number and birthdate come from the first record of the log,
+// they change when the log is rotated.  A bad or partly written record ends the committed
+// part of the log.  Used to ship a log to another machine as it grows.
+bool ScanClassAdLogCommitted(
+	FILE * fp,                      // in
+	long long start_offset,         // in
+	long long & committed_end,      // out
+	unsigned long & historical_sequence_number, // out
+	time_t & original_log_birthdate, // out
+	MyString & errmsg);             // out
+
 int FlushClassAdLog(FILE* fp, bool force);
 
 bool SaveHistoricalClassAdLogs(
@@ -493,6 +561,13 @@ LogRecord* InstantiateLogEntry(
 	int type,
 	const ConstructLogEntry & ctor);
 
+// the binary format counterpart of ReadLogEntry() and InstantiateLogEntry()
+LogRecord* InstantiateBinaryLogEntry(
+	FILE* fp,
+	BinaryLogCrc & crc,
+	unsigned long recnum,
+	const ConstructLogEntry & ctor);
+
 // Templated member functions that call the helper functions with the correct arguments.
 //
 
@@ -504,6 +579,8 @@ ClassAdLog<K,AD>::ClassAdLog(const char *filename,int max_historical_logs_arg,co
 	log_filename_buf = filename;
 	active_transaction = NULL;
 	m_nondurable_level = 0;
+	m_commit_seq = 0;
+	m_synced_seq = 0;
 
 	bool open_read_only = max_historical_logs_arg < 0;
 	if (open_read_only) { max_historical_logs_arg = -max_historical_logs_arg; }
@@ -512,20 +589,27 @@ ClassAdLog<K,AD>::ClassAdLog(const char *filename,int max_historical_logs_arg,co
 	bool is_clean = true;
 	bool requires_successful_cleaning = false;
 	MyString errmsg;
+	m_binary_log = false;
 
 	ClassAdLogTable<K,AD> la(table); // this gives the ability to add & remove table items.
 
 	log_fp = LoadClassAdLog(filename,
 		la, this->GetTableEntryMaker(),
 		historical_sequence_number, m_original_log_birthdate,
-		is_clean, requires_successful_cleaning, errmsg);
+		is_clean, requires_successful_cleaning, m_binary_log, errmsg);
 
 	if ( ! log_fp) {
 		EXCEPT("%s", errmsg.Value());
 	} else if ( ! errmsg.empty()) {
 		dprintf(D_ALWAYS, "ClassAdLog %s has the following issues: %s\n", filename, errmsg.Value());
 	}
-	if( !is_clean || requires_successful_cleaning ) {
+		// rotating the log writes it in the configured format
+	bool convert = ! open_read_only && m_binary_log != UseBinaryClassAdLog();
+	if (convert) {
+		dprintf(D_ALWAYS, "ClassAdLog %s is in the %s format, rotating it to convert it\n",
+			filename, m_binary_log ? "binary" : "ascii");
+	}
+	if( !is_clean || requires_successful_cleaning || convert ) {
 		if (open_read_only && requires_successful_cleaning) {
 			EXCEPT("Log %s is corrupt and needs to be cleaned before restarting HTCondor", filename);
 		}
@@ -542,7 +626,10 @@ ClassAdLog<K,AD>::ClassAdLog(const ConstructLogEntry* maker)
 {
 	active_transaction = NULL;
 	log_fp = NULL;
+	m_binary_log = false;
 	m_nondurable_level = 0;
+	m_commit_seq = 0;
+	m_synced_seq = 0;
 	max_historical_logs = 0;
 	historical_sequence_number = 0;
 }
@@ -584,9 +671,10 @@ ClassAdLog<K,AD>::AppendLog(LogRecord *log)
 	} else {
 			//MD: using file pointer
 		if (log_fp!=NULL) {
-			if (log->Write(log_fp) < 0) {
+			if (log->Write(log_fp, m_binary_log) < 0) {
 				EXCEPT("write to %s failed, errno = %d", logFilename(), errno);
 			}
+			m_commit_seq++;
 			if( m_nondurable_level == 0 ) {
 				ForceLog();  // flush and fsync
 			}
@@ -617,6 +705,7 @@ ClassAdLog<K,AD>::ForceLog()
 	if (err) {
 		EXCEPT("fsync of %s failed, errno = %d", logFilename(), err);
 	}
+	m_synced_seq = m_commit_seq;
 }
 
 template <typename K, typename AD>
@@ -642,7 +731,7 @@ ClassAdLog<K,AD>::TruncLog()
 	bool rotated = TruncateClassAdLog(logFilename(),
 		la, this->GetTableEntryMaker(),
 		log_fp, historical_sequence_number, m_original_log_birthdate,
-		errmsg);
+		m_binary_log, errmsg);
 	if ( ! log_fp) {
 		// if after rotation, the log is no longer open, the the failure is fatal, and we must except
 		EXCEPT("%s", errmsg.Value());
@@ -650,6 +739,10 @@ ClassAdLog<K,AD>::TruncLog()
 	if ( ! errmsg.empty()) {
 		dprintf(D_ALWAYS, "%s", errmsg.Value());
 	}
+	if (rotated) {
+			// the new log was written from the table and synced
+		m_synced_seq = m_commit_seq;
+	}
 
 	return rotated;
 }
@@ -722,7 +815,11 @@ ClassAdLog<K,AD>::CommitTransaction(const char * comment /*=NULL*/)
 		active_transaction->AppendLog(log);
 		bool nondurable = m_nondurable_level > 0;
 		ClassAdLogTable<K,AD> la(table);
-		active_transaction->Commit(log_fp, logFilename(), &la, nondurable );
+		active_transaction->Commit(log_fp, logFilename(), &la, nondurable, m_binary_log );
+		if (log_fp) {
+			m_commit_seq++;
+			if ( ! nondurable) { m_synced_seq = m_commit_seq; }
+		}
 	}
 	delete active_transaction;
 	active_transaction = NULL;
@@ -24,6 +24,8 @@
 #include "condor_attributes.h"
 #include "my_hostname.h"
 #include "string_list.h"
+#include "condor_version.h"
+#include "classad/classadCache.h"
 
 using namespace std;
 
@@ -45,8 +47,145 @@ void AttrList_setPublishServerTime(bool publish)
     publish_server_timeMangled = publish;
 }
 
+static bool send_binary_classads = true;
+void AttrList_setSendBinary(bool send_binary)
+{
+	send_binary_classads = send_binary;
+}
+
 static const char *SECRET_MARKER = "ZKM"; // "it's a Zecret Klassad, Mon!"
 
+// A ClassAd in the binary wire format is sent as BINARY_CLASSAD_MARKER in
+// place of the number of expressions, followed by the format version, the
+// number of expressions, and then for each expression its name, a one byte
+// type tag and its value.  Booleans, integers, reals and strings are sent as
+// values so that the receiver doesn't have to parse them.  Anything else is
+// sent as the unparsed expression, which the receiver parses lazily via the
+// ClassAd cache.  The old format never sends a negative number of expressions,
+// so a receiver can always tell which format it is reading, but only a peer
+// that is known to understand the binary format is sent it.
+static const int BINARY_CLASSAD_MARKER = -0x4341;
+static const int BINARY_CLASSAD_VERSION = 1;
+enum {
+	BINARY_ATTR_UNDEFINED = 'u',
+	BINARY_ATTR_ERROR = 'e',
+	BINARY_ATTR_BOOL = 'b',     // followed by one byte, 0 or 1
+	BINARY_ATTR_INTEGER = 'i',  // followed by a 64 bit integer
+	BINARY_ATTR_REAL = 'r',     // followed by the 64 bits of the double
+	BINARY_ATTR_STRING = 's',   // followed by the string
+	BINARY_ATTR_EXPR = 'x',     // followed by the unparsed expression
+	BINARY_ATTR_SECRET = 'z',   // followed by the unparsed expression, sent with put_secret
+};
+
+static bool _putClassAdBinaryOK(Stream *sock)
+{
+	if ( ! send_binary_classads) {
+		return false;
+	}
+	CondorVersionInfo const *peer_ver = sock->get_peer_version();
+	// 8.9.11 was released before the binary format existed, so the first
+	// version that can read it is 8.9.12
+	return peer_ver && peer_ver->built_since_version(8, 9, 12);
+}
+
+// Read the rest of a ClassAd in the binary wire format after BINARY_CLASSAD_MARKER.
+// Of the GET_CLASSAD_* options, only NO_CACHE, NO_CLEAR and LAZY_PARSE matter here.
+static bool getClassAdBinary( Stream *sock, classad::ClassAd& ad, int options )
+{
+	int version = 0;
+	int numExprs = 0;
+	if ( ! sock->get(version) || ! sock->get(numExprs)) {
+		dprintf(D_FULLDEBUG, "getClassAd FAILED to get binary ClassAd header.\n");
+		return false;
+	}
+	if (version != BINARY_CLASSAD_VERSION) {
+		dprintf(D_ALWAYS, "getClassAd FAILED, binary ClassAd version %d is not supported.\n", version);
+		return false;
+	}
+
+	bool use_cache = (options & GET_CLASSAD_NO_CACHE) == 0;
+	bool cache_lazy = (options & GET_CLASSAD_LAZY_PARSE) != 0;
+	if ( ! (options & GET_CLASSAD_NO_CLEAR)) {
+		ad.rehash(numExprs + 2 + 7);
+	}
+
+	std::string attr;
+	for (int ii = 0; ii < numExprs; ++ii) {
+		unsigned char tag = 0;
+		if ( ! sock->get(attr) || ! sock->get(tag)) {
+			dprintf(D_FULLDEBUG, "getClassAd FAILED to get binary attribute.\n");
+			return false;
+		}
+
+		bool inserted = false;
+		const char *strptr = NULL;
+		int cb = 0;
+		switch (tag) {
+		case BINARY_ATTR_UNDEFINED:
+			inserted = ad.InsertLiteral(attr, classad::Literal::MakeUndefined());
+			break;
+		case BINARY_ATTR_ERROR:
+			inserted = ad.InsertLiteral(attr, classad::Literal::MakeError());
+			break;
+		case BINARY_ATTR_BOOL: {
+			unsigned char bval = 0;
+			if ( ! sock->get(bval)) { return false; }
+			inserted = ad.InsertLiteral(attr, classad::Literal::MakeBool(bval != 0));
+			break;
+		}
+		case BINARY_ATTR_INTEGER: {
+			int64_t ival = 0;
+			if ( ! sock->get(ival)) { return false; }
+			inserted = ad.InsertLiteral(attr, classad::Literal::MakeLong(ival));
+			break;
+		}
+		case BINARY_ATTR_REAL: {
+			uint64_t bits = 0;
+			if ( ! sock->get(bits)) { return false; }
+			double rval;
+			memcpy(&rval, &bits, sizeof(rval));
+			inserted = ad.InsertLiteral(attr, classad::Literal::MakeReal(rval));
+			break;
+		}
+		case BINARY_ATTR_STRING:
+			if ( ! sock->get_string_ptr(strptr, cb) || ! strptr) { return false; }
+			inserted = ad.InsertLiteral(attr, classad::Literal::MakeString(strptr, cb > 0 ? cb-1 : 0));
+			break;
+		case BINARY_ATTR_EXPR:
+		case BINARY_ATTR_SECRET:
+			if (tag == BINARY_ATTR_SECRET) {
+				if ( ! sock->get_secret(strptr, cb) || ! strptr) {
+					dprintf(D_FULLDEBUG, "getClassAd Failed to read encrypted ClassAd expression.\n");
+					return false;
+				}
+			} else if ( ! sock->get_string_ptr(strptr, cb) || ! strptr) {
+				return false;
+			}
+			// we can't cache nested classads or lists, so just parse and insert them
+			if (use_cache && *strptr != '[' && *strptr != '{') {
+				inserted = ad.InsertViaCache(attr, strptr, cache_lazy);
+			} else {
+				classad::ClassAdParser parser;
+				parser.SetOldClassAd(true);
+				ExprTree *tree = parser.ParseExpression(strptr);
+				if (tree) {
+					inserted = ad.Insert(attr, tree);
+				}
+			}
+			break;
+		default:
+			dprintf(D_ALWAYS, "getClassAd FAILED, unknown binary type %d for %s\n", tag, attr.c_str());
+			return false;
+		}
+
+		if ( ! inserted) {
+			dprintf(D_ALWAYS, "getClassAd FAILED to insert binary %s\n", attr.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
 ClassAd *
 getClassAd( Stream *sock )
 {
@@ -74,6 +213,13 @@ bool getClassAd( Stream *sock, classad::ClassAd& ad )
  		return false;
 	}
 
+	if (numExprs == BINARY_CLASSAD_MARKER) {
+		if ( ! getClassAdBinary(sock, ad, GET_CLASSAD_LAZY_PARSE)) {
+			return false;
+		}
+		numExprs = 0;
+	}
+
 	// at least numExprs are coming, but we may add
 	// my, target, and a couple extra right away
 
@@ -251,11 +397,18 @@ bool getClassAdEx( Stream *sock, classad::ClassAd& ad, int options)
 		return false;
 	}
 
+	if (numExprs == BINARY_CLASSAD_MARKER) {
+		if ( ! getClassAdBinary(sock, ad, options)) {
+			return false;
+		}
+		numExprs = 0;
+	}
+
 	// at least numExprs are coming, but we may add
 	// my, target, and a couple extra right away
 	// Auth (id,method) update(total,seq,lost,history)
 
-	if ( ! (options & GET_CLASSAD_NO_CLEAR)) {
+	if ( ! (options & GET_CLASSAD_NO_CLEAR) && numExprs > 0) {
 		ad.rehash(numExprs + 2 + 7);
 	}
 
@@ -437,6 +590,26 @@ getClassAdNoTypes( Stream *sock, classad::ClassAd& ad )
  		return false;
 	}
 
+	if (numExprs == BINARY_CLASSAD_MARKER) {
+		if ( ! getClassAdBinary(sock, ad, GET_CLASSAD_NO_CACHE)) {
+			return false;
+		}
+			// rename ConcurrencyLimit.X to ConcurrencyLimit_X, as below
+		std::vector<std::string> limits;
+		for (auto it = ad.begin(); it != ad.end(); ++it) {
+			if (strncasecmp(it->first.c_str(), "ConcurrencyLimit.", 17) == 0) {
+				limits.push_back(it->first);
+			}
+		}
+		for (auto it = limits.begin(); it != limits.end(); ++it) {
+			ExprTree *tree = ad.Remove(*it);
+			std::string attr = *it;
+			attr[16] = '_';
+			ad.Insert(attr, tree);
+		}
+		return true;
+	}
+
 		// pack exprs into classad
 	buffer = "[";
 	for( int i = 0 ; i < numExprs ; i++ ) {
@@ -592,10 +765,84 @@ int putClassAd (Stream *sock, const classad::ClassAd& ad, int options, const cla
 	return retval;
 }
 
+// helper function for _putClassAd, sends one attribute either in the long form
+// "attr = expr" or in the binary format.  a secret attribute is sent encrypted.
+static bool _putClassAdAttr(Stream *sock, classad::ClassAdUnParser &unp, std::string &buf,
+	const std::string &attr, const classad::ExprTree *expr, bool binary, bool secret)
+{
+	if ( ! binary) {
+		buf = attr;
+		buf += " = ";
+		unp.Unparse(buf, expr);
+		if (secret) {
+			return sock->put(SECRET_MARKER) && sock->put_secret(buf.c_str());
+		}
+		return sock->put(buf);
+	}
+
+	if ( ! sock->put(attr)) {
+		return false;
+	}
+
+	const classad::ExprTree *tree = expr;
+	if (tree->GetKind() == classad::ExprTree::EXPR_ENVELOPE) {
+		tree = ((const classad::CachedExprEnvelope*)tree)->get();
+	}
+	if ( ! secret && tree && tree->GetKind() == classad::ExprTree::LITERAL_NODE) {
+		classad::Value::NumberFactor factor;
+		const classad::Value &val = ((const classad::Literal*)tree)->getValue(factor);
+		bool bval;
+		long long ival;
+		double rval;
+		const char *sval;
+		if (factor == classad::Value::NO_FACTOR) {
+			switch (val.GetType()) {
+			case classad::Value::UNDEFINED_VALUE:
+				return sock->put((unsigned char)BINARY_ATTR_UNDEFINED);
+			case classad::Value::ERROR_VALUE:
+				return sock->put((unsigned char)BINARY_ATTR_ERROR);
+			case classad::Value::BOOLEAN_VALUE:
+				val.IsBooleanValue(bval);
+				return sock->put((unsigned char)BINARY_ATTR_BOOL) && sock->put((unsigned char)(bval ? 1 : 0));
+			case classad::Value::INTEGER_VALUE:
+				val.IsIntegerValue(ival);
+				return sock->put((unsigned char)BINARY_ATTR_INTEGER) && sock->put((int64_t)ival);
+			case classad::Value::REAL_VALUE: {
+					// Stream::put(double) loses precision, so send the bits instead
+				val.IsRealValue(rval);
+				uint64_t bits;
+				memcpy(&bits, &rval, sizeof(bits));
+				return sock->put((unsigned char)BINARY_ATTR_REAL) && sock->put(bits);
+			}
+			case classad::Value::STRING_VALUE:
+				val.IsStringValue(sval);
+				return sock->put((unsigned char)BINARY_ATTR_STRING) && sock->put(sval);
+			default:
+				break;
+			}
+		}
+	}
+
+	buf.clear();
+	unp.Unparse(buf, expr);
+	if (secret) {
+		return sock->put((unsigned char)BINARY_ATTR_SECRET) && sock->put_secret(buf.c_str());
+	}
+	return sock->put((unsigned char)BINARY_ATTR_EXPR) && sock->put(buf);
+}
+
 // helper function for _putClassAd
-static int _putClassAdTrailingInfo(Stream *sock, const classad::ClassAd& /* ad */, bool send_server_time, bool excludeTypes)
+static int _putClassAdTrailingInfo(Stream *sock, const classad::ClassAd& /* ad */, bool send_server_time, bool excludeTypes, bool binary)
 {
-    if (send_server_time)
+    if (send_server_time && binary)
+    {
+        if (!sock->put(ATTR_SERVER_TIME) ||
+            !sock->put((unsigned char)BINARY_ATTR_INTEGER) ||
+            !sock->put((int64_t)time(NULL))) {
+            return false;
+        }
+    }
+    else if (send_server_time)
     {
         //insert in the current time from the server's (Schedd) point of
         //view. this is used so condor_q can compute some time values
@@ -694,7 +941,12 @@ int _putClassAd( Stream *sock, const classad::ClassAd& ad, int options,
 		send_server_time = true;
 	}
 
+	bool binary = _putClassAdBinaryOK(sock);
+
 	sock->encode( );
+	if (binary && ( ! sock->put(BINARY_CLASSAD_MARKER) || ! sock->put(BINARY_CLASSAD_VERSION))) {
+		return false;
+	}
 	if( !sock->code( numExprs ) ) {
 		return false;
 	}
@@ -727,25 +979,16 @@ int _putClassAd( Stream *sock, const classad::ClassAd& ad, int options,
 				continue;
 			}
 
-			buf = attr;
-			buf += " = ";
-			unp.Unparse( buf, expr );
-
-			if( ! crypto_is_noop && private_count &&
+			bool secret = ! crypto_is_noop && private_count &&
 				(ClassAdAttributeIsPrivate(attr) ||
-				(encrypted_attrs && (encrypted_attrs->find(attr) != encrypted_attrs->end()))) )
-			{
-				sock->put(SECRET_MARKER);
-
-				sock->put_secret(buf.c_str());
-			}
-			else if (!sock->put(buf) ){
+				(encrypted_attrs && (encrypted_attrs->find(attr) != encrypted_attrs->end())));
+			if ( ! _putClassAdAttr(sock, unp, buf, attr, expr, binary, secret)) {
 				return false;
 			}
 		}
 	}
 
-	return _putClassAdTrailingInfo(sock, ad, send_server_time, excludeTypes);
+	return _putClassAdTrailingInfo(sock, ad, send_server_time, excludeTypes, binary);
 }
 
 int _putClassAd( Stream *sock, const classad::ClassAd& ad, int options, const classad::References &whitelist, const classad::References *encrypted_attrs)
@@ -783,7 +1026,12 @@ int _putClassAd( Stream *sock, const classad::ClassAd& ad, int options, const cl
 	}
 
 
+	bool binary = _putClassAdBinaryOK(sock);
+
 	sock->encode( );
+	if (binary && ( ! sock->put(BINARY_CLASSAD_MARKER) || ! sock->put(BINARY_CLASSAD_VERSION))) {
+		return false;
+	}
 	if( !sock->code( numExprs ) ) {
 		return false;
 	}
@@ -796,25 +1044,13 @@ int _putClassAd( Stream *sock, const classad::ClassAd& ad, int options, const cl
 			continue;
 
 		classad::ExprTree const *expr = ad.Lookup(*attr);
-		buf = *attr;
-		buf += " = ";
-		unp.Unparse( buf, expr );
-
-		if ( ! crypto_is_noop &&
+		bool secret = ! crypto_is_noop &&
 			(ClassAdAttributeIsPrivate(*attr) ||
-			(encrypted_attrs && (encrypted_attrs->find(*attr) != encrypted_attrs->end())))
-		) {
-			if (!sock->put(SECRET_MARKER)) {
-				return false;
-			}
-			if (!sock->put_secret(buf.c_str())) {
-				return false;
-			}
-		}
-		else if ( ! sock->put(buf)){
+			(encrypted_attrs && (encrypted_attrs->find(*attr) != encrypted_attrs->end())));
+		if ( ! _putClassAdAttr(sock, unp, buf, *attr, expr, binary, secret)) {
 			return false;
 		}
 	}
 
-	return _putClassAdTrailingInfo(sock, ad, send_server_time, excludeTypes);
+	return _putClassAdTrailingInfo(sock, ad, send_server_time, excludeTypes, binary);
 }
@@ -31,6 +31,8 @@ class ReliSock;
 class Stream;
 
 void AttrList_setPublishServerTime(bool publish);
+// when true, ClassAds are sent in the binary wire format to peers that can read it
+void AttrList_setSendBinary(bool send_binary);
 
 classad::ClassAd* getClassAd( Stream *sock );
 
@@ -185,6 +185,7 @@ const struct Translation DCTranslation[] = {
         { "UPDATE_JOBAD", UPDATE_JOBAD },
 	{ "DRAIN_JOBS", DRAIN_JOBS },
 	{ "CANCEL_DRAIN_JOBS", CANCEL_DRAIN_JOBS },
+	{ "STARTD_FULL_UPDATE_REQUEST", STARTD_FULL_UPDATE_REQUEST },
 	{ "DC_AUTHENTICATE", DC_AUTHENTICATE },
 	{ "DC_SEC_QUERY", DC_SEC_QUERY },
 	{ "DC_NOP", DC_NOP },
@@ -238,6 +239,7 @@ const struct Translation DCTranslation[] = {
 	{ "REPLICATION_SOLICIT_VERSION", REPLICATION_SOLICIT_VERSION },
 	{ "REPLICATION_SOLICIT_VERSION_REPLY", REPLICATION_SOLICIT_VERSION_REPLY },
 	{ "REPLICATION_TRANSFER_FILE_NEW", REPLICATION_TRANSFER_FILE_NEW },
+	{ "REPLICATION_STREAM_LOG", REPLICATION_STREAM_LOG },
 	{ "QUERY_SCHEDD_HISTORY", QUERY_SCHEDD_HISTORY },
 	{ "QUERY_JOB_ADS", QUERY_JOB_ADS },
 	{ "SWAP_CLAIM_AND_ACTIVATION", SWAP_CLAIM_AND_ACTIVATION },
@@ -306,6 +308,7 @@ const struct Translation CollectorTranslation[] = {
 	{ "QUERY_GRID_ADS", QUERY_GRID_ADS },
 	{ "INVALIDATE_GRID_ADS", INVALIDATE_GRID_ADS },
 	{ "MERGE_STARTD_AD", MERGE_STARTD_AD },
+	{ "UPDATE_STARTD_AD_DELTA", UPDATE_STARTD_AD_DELTA },
 	{ "UPDATE_ACCOUNTING_AD", UPDATE_ACCOUNTING_AD },
 	{ "QUERY_ACCOUNTING_ADS", QUERY_ACCOUNTING_ADS },
 	{ "INVALIDATE_ACCOUNTING_ADS", INVALIDATE_ACCOUNTING_ADS },
@@ -76,6 +76,8 @@ void ClassAdReconfig()
 
 	classad::ClassAdSetExpressionCaching( param_boolean( "ENABLE_CLASSAD_CACHING", false ) );
 
+	AttrList_setSendBinary( param_boolean( "CLASSAD_WIRE_BINARY", true ) );
+
 	char *new_libs = param( "CLASSAD_USER_LIBS" );
 	if ( new_libs ) {
 		StringList new_libs_list( new_libs );
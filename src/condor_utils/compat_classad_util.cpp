@@ -25,9 +25,6 @@
 #include "classad/classadCache.h" // for CachedExprEnvelope
 
 #include "compat_classad_list.h"
-#ifdef _OPENMP
-#include <omp.h>
-#endif
 
 /* TODO This function needs to be tested.
  */
@@ -805,132 +802,6 @@ bool IsAMatch( ClassAd *ad1, ClassAd *ad2 )
 	return result;
 }
 
-static classad::MatchClassAd *match_pool = NULL;
-static ClassAd *target_pool = NULL;
-static std::vector<ClassAd*> *matched_ads = NULL;
-
-bool ParallelIsAMatch(ClassAd *ad1, std::vector<ClassAd*> &candidates, std::vector<ClassAd*> &matches, int threads, bool halfMatch)
-{
-	int adCount = candidates.size();
-	static int cpu_count = 0;
-	int current_cpu_count = threads;
-	int iterations = 0;
-	size_t matched = 0;
-
-	if(cpu_count != current_cpu_count)
-	{
-		cpu_count = current_cpu_count;
-		if(match_pool)
-		{
-			delete[] match_pool;
-			match_pool = NULL;
-		}
-		if(target_pool)
-		{
-			delete[] target_pool;
-			target_pool = NULL;
-		}
-		if(matched_ads)
-		{
-			delete[] matched_ads;
-			matched_ads = NULL;
-		}
-	}
-
-	if(!match_pool)
-		match_pool = new classad::MatchClassAd[cpu_count];
-	if(!target_pool)
-		target_pool = new ClassAd[cpu_count];
-	if(!matched_ads)
-		matched_ads = new std::vector<ClassAd*>[cpu_count];
-
-	if(!candidates.size())
-		return false;
-
-	for(int index = 0; index < cpu_count; index++)
-	{
-		target_pool[index].CopyFrom(*ad1);
-		match_pool[index].ReplaceLeftAd(&(target_pool[index]));
-		matched_ads[index].clear();
-	}
-
-	iterations = ((candidates.size() - 1) / cpu_count) + 1;
-
-#ifdef _OPENMP
-	omp_set_num_threads(cpu_count);
-#endif
-
-#pragma omp parallel
-	{
-
-#ifdef _OPENMP
-		int omp_id = omp_get_thread_num();
-#else
-		int omp_id = 0;
-#endif
-		for(int index = 0; index < iterations; index++)
-		{
-			bool result = false;
-			int offset = omp_id + index * cpu_count;
-			if(offset >= adCount)
-				break;
-			ClassAd *ad2 = candidates[offset];
-
-/*
-			if(halfMatch)
-			{
-				char const *my_target_type = target_pool[omp_id].GetTargetTypeName();
-				char const *target_type = ad2->GetMyTypeName();
-				if( !my_target_type ) {
-					my_target_type = "";
-				}
-				if( !target_type ) {
-					target_type = "";
-				}
-				if( strcasecmp(target_type,my_target_type) &&
-					strcasecmp(my_target_type,ANY_ADTYPE) )
-				{
-					result = false;
-					continue;
-				}
-			}
-*/
-
-
-			match_pool[omp_id].ReplaceRightAd(ad2);
-		
-			if(halfMatch)
-				result = match_pool[omp_id].rightMatchesLeft();
-			else
-				result = match_pool[omp_id].symmetricMatch();
-
-			match_pool[omp_id].RemoveRightAd();
-
-			if(result)
-			{
-				matched_ads[omp_id].push_back(ad2);
-			}
-		}
-	}
-
-	for(int index = 0; index < cpu_count; index++)
-	{
-		match_pool[index].RemoveLeftAd();
-		matched += matched_ads[index].size();
-	}
-
-	if(matches.capacity() < matched)
-		matches.reserve(matched);
-
-	for(int index = 0; index < cpu_count; index++)
-	{
-		if(matched_ads[index].size())
-			matches.insert(matches.end(), matched_ads[index].begin(), matched_ads[index].end());
-	}
-
-	return matches.size() > 0;
-}
-
 bool IsAHalfMatch( ClassAd *my, ClassAd *target )
 {
 		// The collector relies on this function to check the target type.
@@ -101,8 +101,6 @@ bool IsAMatch( ClassAd *ad1, ClassAd *ad2 );
 
 bool IsAHalfMatch( ClassAd *my, ClassAd *target );
 
-bool ParallelIsAMatch(ClassAd *ad1, std::vector<ClassAd*> &candidates, std::vector<ClassAd*> &matches, int threads, bool halfMatch = false);
-
 void AddClassAdXMLFileHeader(std::string &buffer);
 void AddClassAdXMLFileFooter(std::string &buffer);
 
@@ -89,6 +89,7 @@ void dprintf_make_thread_safe() {
 
 extern const char * const _condor_DebugCategoryNames[D_CATEGORY_COUNT];
 
+static bool debug_async_rotation_due(const DebugFileInfo* it, time_t now);
 static FILE *debug_lock_it(struct DebugFileInfo* it, const char *mode, int force_lock, bool dont_panic);
 static void debug_unlock_it(struct DebugFileInfo* it);
 static FILE *open_debug_file(struct DebugFileInfo* it, const char flags[], bool dont_panic);
@@ -219,6 +220,17 @@ int		LockFd = -1;
 
 int		log_keep_open = 0;
 
+/*
+ * When DebugAsync is set, messages for log files that are held open are
+ * written by a writer thread, see dprintf_async.cpp.
+ */
+int		DebugAsync = 0;
+long long	DebugAsyncBufferSize = 0;
+
+	/* set by _condor_dprintf_va() while a message for a log file
+	   should go to the writer thread */
+static bool dprintf_write_async = false;
+
 static bool DebugRotateLog = true;
 
 static	int DprintfBroken = 0;
@@ -321,7 +333,7 @@ DebugFileInfo::DebugFileInfo(const dprintf_output_settings& p) :
 	maxLog(p.logMax), logZero(0), maxLogNum(p.maxLogNum),
 	want_truncate(p.want_truncate), accepts_all(p.accepts_all),
 	rotate_by_time(p.rotate_by_time), dont_panic(false),
-	userData(0), dprintfFunc(_dprintf_global_func) {}
+	userData(0), asyncLength(0), dprintfFunc(_dprintf_global_func) {}
 
 bool DebugFileInfo::MatchesCatAndFlags(int cat_and_flags) const
 {
@@ -613,6 +625,18 @@ _dprintf_global_func(int cat_and_flags, int hdr_flags, DebugHeaderInfo & info, c
 	#endif // HAVE_BACKTRACE
 	}
 
+	if (dprintf_write_async) {
+			// D_FULLDEBUG messages may be dropped if the buffer is full
+		bool may_drop = (cat_and_flags & (D_FULLDEBUG | D_VERBOSE_MASK)) && ! (cat_and_flags & D_FAILURE);
+		rc = dprintf_async_write(fileno(dbgInfo->debugFP), buffer, bufpos, may_drop);
+		if (rc >= 0) {
+			if (rc > 0) {
+				dbgInfo->asyncLength += bufpos;
+			}
+			return;
+		}
+	}
+
 		// We attempt to write the log record with one call to
 		// write(), because then O_APPEND will ensure (on
 		// compliant file systems) that writes from different
@@ -999,6 +1023,15 @@ _condor_dprintf_va( int cat_and_flags, DPF_IDENT ident, const char* fmt, va_list
 				case SYSLOG: break;
 				default:
 				case FILE_OUT:
+					if (DebugAsync && it->debugFP && ! debug_async_rotation_due(&(*it), info.tv.tv_sec)) {
+						dprintf_write_async = true;
+						break;
+					}
+					if (DebugAsync) {
+							// the rotation check must see everything
+							// that was written before this message
+						dprintf_async_flush();
+					}
 					debug_lock_it(&(*it), NULL, 0, it->dont_panic);
 					funlock_it = true;
 					break;
@@ -1007,7 +1040,11 @@ _condor_dprintf_va( int cat_and_flags, DPF_IDENT ident, const char* fmt, va_list
 			}
 			
 			it->dprintfFunc(cat_and_flags, hdr_flags, info, message_buffer, &(*it));
+			dprintf_write_async = false;
 			if (funlock_it) {
+				if (DebugAsync && it->debugFP) {
+					it->asyncLength = lseek(fileno(it->debugFP), 0, SEEK_END);
+				}
 				debug_unlock_it(&(*it));
 			}
 		}
@@ -1212,6 +1249,25 @@ double dprintf_get_lock_delay(void) {
 	return ((double)DebugLockDelay)/(now-DebugLockDelayPeriodStarted);
 }
 
+// With DebugAsync, messages for a log file go to the writer thread
+// without checking the file, until our count of what has been written
+// to it says it is time to rotate.  The next message then goes through
+// debug_lock_it(), which checks the file itself.
+static bool
+debug_async_rotation_due(const DebugFileInfo* it, time_t now)
+{
+	if ( ! DebugRotateLog || ! it->maxLog) {
+		return false;
+	}
+	if (it->rotate_by_time) {
+		if ( ! it->logZero) {
+			return true;
+		}
+		return quantizeTimestamp(now, it->maxLog) - quantizeTimestamp((time_t)it->logZero, it->maxLog) >= it->maxLog;
+	}
+	return it->asyncLength >= it->maxLog;
+}
+
 static FILE *
 debug_lock_it(struct DebugFileInfo* it, const char *mode, int force_lock, bool dont_panic)
 {
@@ -1414,6 +1470,8 @@ debug_close_all_files()
 {
 	if ( ! DebugLogs) return;
 
+	dprintf_async_flush();
+
 	std::vector<DebugFileInfo>::iterator it;
 	for(it = DebugLogs->begin(); it < DebugLogs->end(); it++)
 	{
@@ -2423,16 +2481,22 @@ dprintf_dump_stack(void) {
 static int ParentLockFd = -1;
 static bool ParentDebugRotateLog = true;
 
+static int ParentDebugAsync = 0;
+
 void
 dprintf_before_shared_mem_clone() {
 	ParentLockFd = LockFd;
 	ParentDebugRotateLog = DebugRotateLog;
+	ParentDebugAsync = DebugAsync;
+		// the child writes directly, so write what came before first
+	dprintf_async_flush();
 }
 
 void
 dprintf_after_shared_mem_clone() {
 	LockFd = ParentLockFd;
 	DebugRotateLog = ParentDebugRotateLog;
+	DebugAsync = ParentDebugAsync;
 }
 
 void
@@ -2450,6 +2514,8 @@ dprintf_init_fork_child( bool cloned ) {
 	// and child that can result in the parent writing to a rotated log
 	// file.
 	DebugRotateLog = false;
+	// The writer thread for DebugAsync lives in the parent.
+	DebugAsync = 0;
 	if ( !cloned ) {
 		log_keep_open = 0;
 		std::vector<DebugFileInfo>::iterator it;
@@ -2487,6 +2553,10 @@ dprintf_dump_stack(void) {
 	int trace_size;
 	unsigned long args[3];
 
+	// Messages still waiting for the DebugAsync writer thread come
+	// before the stack dump.
+	dprintf_async_crash_flush();
+
 	// We're probably in a signal handler, so use the async-safe logging
 	// operations.
 	fd = safe_async_log_open();
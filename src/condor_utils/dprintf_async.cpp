@@ -0,0 +1,376 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2019, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+/*
+** Asynchronous writes for dprintf(), see <SUBSYS>_LOG_ASYNC_BUFFER.
+**
+** _dprintf_global_func() copies each formatted message into a ring
+** buffer instead of calling write(), and a writer thread empties the
+** buffer, writing runs of messages for the same log file with a single
+** writev().  The writer thread only writes; opening, rotating and
+** closing the log files is still done by the thread that calls
+** dprintf(), which waits for the buffer to empty before doing so.
+**
+** When the buffer is full, D_FULLDEBUG messages are dropped (and
+** counted), everything else waits for the writer thread to make room.
+*/
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "dprintf_internal.h"
+
+#if defined(HAVE_PTHREADS) && !defined(WIN32)
+
+#include <pthread.h>
+#include <sys/uio.h>
+
+// Each message in the ring is a header followed by the message, padded
+// so that the next header is aligned.  A header with fd -1 marks the
+// unused end of the buffer; the next message is at the beginning.
+struct AsyncRecord {
+	int fd;
+	int len;
+};
+
+static const size_t ASYNC_ALIGN = sizeof(AsyncRecord);
+static const long long ASYNC_MIN_SIZE = 64 * 1024;
+static const int ASYNC_MAX_IOV = 64;
+
+static pthread_mutex_t async_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t async_data_cv = PTHREAD_COND_INITIALIZER;  // writer waits for messages
+static pthread_cond_t async_space_cv = PTHREAD_COND_INITIALIZER; // callers wait for room, or a flush
+static pthread_t async_thread;
+static pid_t async_pid = 0;      // the process the writer thread runs in
+static char *async_buf = NULL;
+static size_t async_size = 0;
+static size_t async_head = 0;    // where the next message goes
+static size_t async_tail = 0;    // the oldest message not yet written
+static size_t async_used = 0;
+static bool async_stop = false;
+static int async_errno = 0;      // first error from the writer thread
+static int async_dropped = 0;    // dropped since the last note in the log
+static int async_dropped_total = 0;
+
+static size_t
+async_pad(size_t len)
+{
+	return (len + ASYNC_ALIGN - 1) & ~(ASYNC_ALIGN - 1);
+}
+
+static int
+async_writev(int fd, struct iovec *iov, int niov)
+{
+	while (niov > 0) {
+		ssize_t rc = writev(fd, iov, niov);
+		if (rc < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return errno;
+		}
+		while (niov > 0 && (size_t)rc >= iov->iov_len) {
+			rc -= iov->iov_len;
+			++iov;
+			--niov;
+		}
+		if (niov > 0) {
+			iov->iov_base = (char *)iov->iov_base + rc;
+			iov->iov_len -= rc;
+		}
+	}
+	return 0;
+}
+
+// Write the used bytes of the ring starting at pos, and return how many
+// bytes of the ring that was.  The caller does not hold the lock, which
+// is fine because messages are only ever added after these.  This is
+// also called from a signal handler, so it must stay async-signal safe.
+static size_t
+async_drain(size_t pos, size_t used, int &err)
+{
+	struct iovec iov[ASYNC_MAX_IOV];
+	int niov = 0;
+	int iov_fd = -1;
+	size_t done = 0;
+
+	while (done < used) {
+		AsyncRecord *rec = (AsyncRecord *)(async_buf + pos);
+		if (rec->fd < 0) {
+			done += async_size - pos;
+			pos = 0;
+			continue;
+		}
+		if (niov && (rec->fd != iov_fd || niov == ASYNC_MAX_IOV)) {
+			if ( ! err) err = async_writev(iov_fd, iov, niov);
+			niov = 0;
+		}
+		iov_fd = rec->fd;
+		iov[niov].iov_base = rec + 1;
+		iov[niov].iov_len = rec->len;
+		++niov;
+
+		size_t step = sizeof(AsyncRecord) + async_pad(rec->len);
+		done += step;
+		pos += step;
+		if (pos == async_size) {
+			pos = 0;
+		}
+	}
+	if (niov && ! err) {
+		err = async_writev(iov_fd, iov, niov);
+	}
+	return done;
+}
+
+static void *
+async_writer_main(void *)
+{
+	pthread_mutex_lock(&async_lock);
+	for (;;) {
+		while ( ! async_used && ! async_stop) {
+			pthread_cond_wait(&async_data_cv, &async_lock);
+		}
+		if ( ! async_used) {
+			break;
+		}
+		size_t tail = async_tail;
+		size_t used = async_used;
+		pthread_mutex_unlock(&async_lock);
+
+		int err = 0;
+		size_t done = async_drain(tail, used, err);
+
+		pthread_mutex_lock(&async_lock);
+		async_tail = (tail + done) % async_size;
+		async_used -= done;
+		if (err && ! async_errno) {
+			async_errno = err;
+		}
+		pthread_cond_broadcast(&async_space_cv);
+	}
+	pthread_mutex_unlock(&async_lock);
+	return NULL;
+}
+
+// Bytes of the ring that messages of total size need take up, counting
+// the end of the buffer if they do not fit before it.
+static size_t
+async_space_needed(size_t need)
+{
+	size_t at_end = async_size - async_head;
+	return (at_end < need) ? at_end + need : need;
+}
+
+// Copy a message into the ring, the caller has checked that it fits.
+static void
+async_put(int fd, const char *data, int len)
+{
+	size_t need = sizeof(AsyncRecord) + async_pad(len);
+	size_t at_end = async_size - async_head;
+	if (at_end < need) {
+		AsyncRecord *mark = (AsyncRecord *)(async_buf + async_head);
+		mark->fd = -1;
+		mark->len = 0;
+		async_used += at_end;
+		async_head = 0;
+	}
+	AsyncRecord *rec = (AsyncRecord *)(async_buf + async_head);
+	rec->fd = fd;
+	rec->len = len;
+	memcpy(rec + 1, data, len);
+	async_used += need;
+	async_head = (async_head + need) % async_size;
+}
+
+int
+dprintf_async_write(int fd, const char *data, int len, bool may_drop)
+{
+	char note[128];
+	int note_len = 0;
+	size_t need = sizeof(AsyncRecord) + async_pad(len);
+
+		// Leave room for the note about dropped messages, and make
+		// sure that an empty ring always has room for the message.
+	if (need + sizeof(AsyncRecord) + sizeof(note) > async_size / 2) {
+		dprintf_async_flush();
+		return -1;
+	}
+
+	pthread_mutex_lock(&async_lock);
+	for (;;) {
+		if (async_errno) {
+			int err = async_errno;
+			pthread_mutex_unlock(&async_lock);
+			_condor_dprintf_exit(err, "Error writing debug log\n");
+		}
+		note_len = 0;
+		if (async_dropped) {
+			note_len = snprintf(note, sizeof(note),
+				"(%d debug messages were dropped because the log buffer was full)\n",
+				async_dropped);
+			need += sizeof(AsyncRecord) + async_pad(note_len);
+		}
+		if (async_used + async_space_needed(need) <= async_size) {
+			break;
+		}
+		if (may_drop) {
+			async_dropped++;
+			async_dropped_total++;
+			pthread_mutex_unlock(&async_lock);
+			return 0;
+		}
+		if (note_len) {
+			need -= sizeof(AsyncRecord) + async_pad(note_len);
+		}
+		pthread_cond_wait(&async_space_cv, &async_lock);
+	}
+
+	if (note_len) {
+		async_put(fd, note, note_len);
+		async_dropped = 0;
+	}
+	async_put(fd, data, len);
+	pthread_cond_signal(&async_data_cv);
+	pthread_mutex_unlock(&async_lock);
+	return 1;
+}
+
+void
+dprintf_async_flush(void)
+{
+	if ( ! async_buf || async_pid != getpid()) {
+		return;
+	}
+	pthread_mutex_lock(&async_lock);
+	while (async_used) {
+		pthread_cond_wait(&async_space_cv, &async_lock);
+	}
+	pthread_mutex_unlock(&async_lock);
+}
+
+void
+dprintf_async_crash_flush(void)
+{
+	if ( ! async_buf || ! DebugAsync || async_pid != getpid()) {
+		return;
+	}
+		// We may have crashed holding the lock, or in the writer thread,
+		// so write whatever is in the ring without it.  Messages that the
+		// writer thread is writing right now may show up twice.
+	DebugAsync = 0;
+	int err = 0;
+	async_drain(async_tail, async_used, err);
+}
+
+// Write everything in the ring and stop the writer thread.
+static void
+async_shutdown(void)
+{
+	if ( ! async_buf) {
+		return;
+	}
+	if (async_pid == getpid()) {
+		DebugAsync = 0;
+		pthread_mutex_lock(&async_lock);
+		async_stop = true;
+		pthread_cond_signal(&async_data_cv);
+		pthread_mutex_unlock(&async_lock);
+		pthread_join(async_thread, NULL);
+	}
+	free(async_buf);
+	async_buf = NULL;
+	async_size = 0;
+}
+
+// A forked child has a copy of the ring, but not the writer thread, and
+// the lock may have been held by the writer thread when we forked.  The
+// parent writes whatever was in the ring, so the child writes directly.
+static void
+async_after_fork_child(void)
+{
+	DebugAsync = 0;
+	pthread_mutex_init(&async_lock, NULL);
+	pthread_cond_init(&async_data_cv, NULL);
+	pthread_cond_init(&async_space_cv, NULL);
+}
+
+void
+dprintf_async_configure(long long buffer_size)
+{
+	if (buffer_size > 0 && buffer_size < ASYNC_MIN_SIZE) {
+		buffer_size = ASYNC_MIN_SIZE;
+	}
+	size_t size = (size_t)buffer_size & ~(ASYNC_ALIGN - 1);
+	if (async_buf && async_pid == getpid() && size == async_size) {
+		DebugAsync = 1;
+		return;
+	}
+
+	async_shutdown();
+	if ( ! size) {
+		return;
+	}
+
+	async_buf = (char *)malloc(size);
+	if ( ! async_buf) {
+		return;
+	}
+	async_size = size;
+	async_head = async_tail = async_used = 0;
+	async_stop = false;
+	async_errno = 0;
+
+		// leave all signal handling to the threads that call dprintf()
+	sigset_t mask, omask;
+	sigfillset(&mask);
+	pthread_sigmask(SIG_BLOCK, &mask, &omask);
+	int rc = pthread_create(&async_thread, NULL, async_writer_main, NULL);
+	pthread_sigmask(SIG_SETMASK, &omask, NULL);
+	if (rc != 0) {
+		free(async_buf);
+		async_buf = NULL;
+		async_size = 0;
+		return;
+	}
+	async_pid = getpid();
+
+	static bool registered = false;
+	if ( ! registered) {
+		atexit(async_shutdown);
+		pthread_atfork(NULL, NULL, async_after_fork_child);
+		registered = true;
+	}
+	DebugAsync = 1;
+}
+
+int
+dprintf_getDroppedCount(void)
+{
+	return async_dropped_total;
+}
+
+#else // WIN32 or no threads, dprintf() always writes directly
+
+int dprintf_async_write(int, const char *, int, bool) { return -1; }
+void dprintf_async_flush(void) {}
+void dprintf_async_crash_flush(void) {}
+void dprintf_async_configure(long long) {}
+int dprintf_getDroppedCount(void) { return 0; }
+
+#endif
@@ -39,6 +39,7 @@ extern char		*DebugLock;
 extern const char* const _condor_DebugCategoryNames[D_CATEGORY_COUNT];
 extern int		DebugContinueOnOpenFailure;
 extern int		log_keep_open;
+extern long long	DebugAsyncBufferSize;
 extern char*	DebugTimeFormat;
 extern int		DebugLockIsMutex;
 extern char*	DebugLogDir;
@@ -358,6 +359,25 @@ dprintf_config( const char *subsys, struct dprintf_output_settings *p_info /* =
 		log_keep_open = param_boolean_int(pname, log_open_default);//dprintf_param_funcs->param_boolean_int(pname, log_open_default);
 	}
 
+		// Writing from a thread only works for log files that stay open
+		// and are not locked by other processes.
+	DebugAsyncBufferSize = 0;
+	if (log_keep_open && !DebugLock && !DebugShouldLockToAppend) {
+		(void)sprintf(pname, "%s_LOG_ASYNC_BUFFER", subsys);
+		pval = param(pname);
+		if (pval) {
+			long long size = 0;
+			bool unit_is_time = false;
+			if ( ! dprintf_parse_log_size(pval, size, unit_is_time) || size < 0 || unit_is_time) {
+				std::string m;
+				formatstr(m, "Invalid config %s = %s: %s must be a size, and may be followed by a units value\n", pname, pval, pname);
+				_condor_dprintf_exit(EINVAL, m.c_str());
+			}
+			DebugAsyncBufferSize = size;
+			free(pval);
+		}
+	}
+
 	/*
 	If LOGS_USE_TIMESTAMP is enabled, we will print out Unix timestamps
 	instead of the standard date format in all the log messages
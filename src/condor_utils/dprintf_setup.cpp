@@ -44,6 +44,9 @@ void dprintf_set_outputs(const struct dprintf_output_settings *p_info, int c_inf
 {
 	static int first_time = 1;
 
+	// messages waiting to be written refer to the old files
+	dprintf_async_flush();
+
 	std::vector<DebugFileInfo> *debugLogsOld = DebugLogs;
 	DebugLogs = new std::vector<DebugFileInfo>();
 
@@ -191,6 +194,8 @@ void dprintf_set_outputs(const struct dprintf_output_settings *p_info, int c_inf
 	first_time = 0;
 	_condor_dprintf_works = 1;
 
+	dprintf_async_configure(DebugAsyncBufferSize);
+
 	if(debugLogsOld)
 	{
 		
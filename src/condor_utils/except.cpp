@@ -90,6 +90,9 @@ _EXCEPT_(const char *fmt, ...)
 
 	va_end(pvar);
 
+		/* Make sure the message above is in the log before we go */
+	dprintf_async_flush();
+
 	if( _condor_except_should_dump_core ) {
 		abort();
 	}
@@ -48,6 +48,9 @@
 #include "data_reuse.h"
 #include "AWSv4-utils.h"
 #include "condor_random_num.h"
+#include "condor_crypt.h"
+#include "limit_directory_access.h"
+#include "file_transfer_stripes.h"
 #include "condor_sys.h"
 
 #include <fstream>
@@ -60,6 +63,7 @@
 #include <string>
 
 
+
 const char * const StdoutRemapName = "_condor_stdout";
 const char * const StderrRemapName = "_condor_stderr";
 
@@ -73,6 +77,11 @@ const char * const StderrRemapName = "_condor_stderr";
 // 6 - send a request to make a directory
 // 999 - send a classad telling what to do.
 //
+// If both sides agreed on parallel streams in their first GoAhead
+// messages, commands 1-3 are followed by the number of parallel streams
+// the file is striped across, or 0 if it follows on this connection as
+// usual.  See FILE_TRANSFER_PARALLEL_STREAMS.
+//
 // 999 subcommands (999 is followed by a filename and then a ClassAd):
 // 7 - ClassAd contains information about a URL upload performed by
 //     the upload side.
@@ -101,6 +110,26 @@ enum class TransferSubCommand {
 	SignUrls = 9
 };
 
+// True for the commands that are followed by the data of a file.
+static bool
+IsFileDataCommand(TransferCommand command)
+{
+	return command == TransferCommand::XferFile ||
+		command == TransferCommand::EnableEncryption ||
+		command == TransferCommand::DisableEncryption;
+}
+
+// How many parallel streams we want for large files, 0 for none.
+static int
+ParallelStreamsWanted()
+{
+#if defined(WIN32)
+	return 0;
+#else
+	return param_integer("FILE_TRANSFER_PARALLEL_STREAMS", 0, 0, 64);
+#endif
+}
+
 #define COMMIT_FILENAME ".ccommit.con"
 
 // Filenames are case insensitive on Win32, but case sensitive on Unix
@@ -2079,6 +2108,11 @@ FileTransfer::DoDownload( filesize_t *total_bytes, ReliSock *s)
 
 	downloadStartTime = condor_gettimestamp_double();
 
+	int sock_bufsize = param_integer("FILE_TRANSFER_SOCKET_BUFSIZE", 0, 0);
+	if ( sock_bufsize > 0 ) {
+		s->set_os_buffers(sock_bufsize, false);
+	}
+
 		/* Track the potential data reuse
 		 */
 	std::vector<ReuseInfo> reuse_info;
@@ -2156,6 +2190,11 @@ FileTransfer::DoDownload( filesize_t *total_bytes, ReliSock *s)
 		SpooledJobFiles::createJobSpoolDirectory(&jobAd,desired_priv_state);
 	}
 
+	ResetParallelStreams();
+	if( PeerDoesGoAhead ) {
+		ListenForParallelStreams(s);
+	}
+
 	bool sign_s3_urls = param_boolean("SIGN_S3_URLS", true) && PeerDoesS3Urls;
 
 		/*
@@ -2369,6 +2408,16 @@ FileTransfer::DoDownload( filesize_t *total_bytes, ReliSock *s)
 			this_file_max_bytes = 0;
 		}
 
+		int stripes = 0;
+		if( m_parallel_streams > 0 && IsFileDataCommand(xfer_command) ) {
+				// Our peer tells us whether this file comes over the
+				// parallel streams or the usual way.
+			if( !s->get(stripes) || !s->end_of_message() ) {
+				dprintf(D_FULLDEBUG,"DoDownload: exiting at %d\n",__LINE__);
+				return_and_resetpriv( -1 );
+			}
+		}
+
 
 		// On WinNT and apparently, some Unix, too, even doing an
 		// fsync on the file does not get rid of the lazy-write
@@ -2837,12 +2886,16 @@ FileTransfer::DoDownload( filesize_t *total_bytes, ReliSock *s)
 						error_buf.Value());
 				}
 			}
+		} else if ( stripes > 0 ) {
+			rc = ReceiveParallelFile( s, stripes, fullname.Value(), this_file_max_bytes, &bytes, xfer_queue );
+			thisFileStats.TransferCopyMethod = "parallel";
 		} else if ( TransferFilePermissions ) {
 			// We could create the target's parent directories, but since
 			// we need to have sent them along as explicit transfer items
 			// to preserve their permissions, let's just let this transfer
 			// fail if the remote side screwed up.
 			rc = s->get_file_with_permissions( &bytes, fullname.Value(), false, this_file_max_bytes, &xfer_queue );
+			thisFileStats.TransferCopyMethod = s->last_file_zero_copy() ? "zero-copy" : "buffered";
 			CondorError err;
 			if (rc == 0 && should_reuse && !m_reuse_dir->CacheFile(fullname.Value(), iter->checksum(),
 					iter->checksum_type(), reservation_id, err))
@@ -2857,6 +2910,7 @@ FileTransfer::DoDownload( filesize_t *total_bytes, ReliSock *s)
 		} else {
 			// See comment about directory creation above.
 			rc = s->get_file( &bytes, fullname.Value(), false, false, this_file_max_bytes, &xfer_queue );
+			thisFileStats.TransferCopyMethod = s->last_file_zero_copy() ? "zero-copy" : "buffered";
 		}
 
 		elapsed = time(NULL)-start;
@@ -3757,6 +3811,12 @@ FileTransfer::DoUpload(filesize_t *total_bytes, ReliSock *s)
 
 	*total_bytes = 0;
 	dprintf(D_FULLDEBUG,"entering FileTransfer::DoUpload\n");
+
+	int sock_bufsize = param_integer("FILE_TRANSFER_SOCKET_BUFSIZE", 0, 0);
+	if ( sock_bufsize > 0 ) {
+		s->set_os_buffers(sock_bufsize, true);
+	}
+	ResetParallelStreams();
 	dprintf(D_FULLDEBUG,"DoUpload: Output URL plugins %s be run\n",
 		should_invoke_output_plugins ? "will" : "will not");
 
@@ -4394,6 +4454,17 @@ FileTransfer::DoUpload(filesize_t *total_bytes, ReliSock *s)
 			this_file_max_bytes = 0;
 		}
 
+		int stripes = 0;
+		if( m_parallel_streams > 0 && IsFileDataCommand(file_command) ) {
+				// Tell our peer whether this file comes over the
+				// parallel streams or the usual way.
+			stripes = ParallelStripesForUpload( s, fullname.Value(), this_file_max_bytes );
+			if( !s->put(stripes) || !s->end_of_message() ) {
+				dprintf(D_FULLDEBUG,"DoUpload: exiting at %d\n",__LINE__);
+				return_and_resetpriv( -1 );
+			}
+		}
+
 		if ( file_command == TransferCommand::Other) {
 			// new-style, send classad
 
@@ -4546,10 +4617,35 @@ FileTransfer::DoUpload(filesize_t *total_bytes, ReliSock *s)
 				rc = PUT_FILE_OPEN_FAILED;
 				errno = EISDIR;
 			}
-		} else if ( TransferFilePermissions ) {
-			rc = s->put_file_with_permissions( &bytes, fullname.Value(), this_file_max_bytes, &xfer_queue );
 		} else {
-			rc = s->put_file( &bytes, fullname.Value(), 0, this_file_max_bytes, &xfer_queue );
+			// Per-transfer statistics for the file we send, like the
+			// ones DoDownload() records for the files it receives.
+			FileTransferStats thisFileStats;
+			thisFileStats.TransferFileName = dest_filename.Value();
+			thisFileStats.TransferProtocol = "cedar";
+			thisFileStats.TransferStartTime = condor_gettimestamp_double();
+			thisFileStats.TransferType = "upload";
+
+			if ( stripes > 0 ) {
+				rc = SendParallelFile( s, stripes, fullname.Value(), &bytes, xfer_queue );
+				thisFileStats.TransferCopyMethod = "parallel";
+			} else if ( TransferFilePermissions ) {
+				rc = s->put_file_with_permissions( &bytes, fullname.Value(), this_file_max_bytes, &xfer_queue );
+				thisFileStats.TransferCopyMethod = s->last_file_zero_copy() ? "zero-copy" : "buffered";
+			} else {
+				rc = s->put_file( &bytes, fullname.Value(), 0, this_file_max_bytes, &xfer_queue );
+				thisFileStats.TransferCopyMethod = s->last_file_zero_copy() ? "zero-copy" : "buffered";
+			}
+
+			thisFileStats.TransferEndTime = condor_gettimestamp_double();
+			thisFileStats.ConnectionTimeSeconds = thisFileStats.TransferEndTime - thisFileStats.TransferStartTime;
+			thisFileStats.TransferFileBytes = bytes;
+			thisFileStats.TransferTotalBytes = bytes;
+			thisFileStats.TransferSuccess = rc >= 0;
+
+			ClassAd thisFileStatsAd;
+			thisFileStats.Publish(thisFileStatsAd);
+			OutputFileTransferStats(thisFileStatsAd);
 		}
 		if( rc < 0 ) {
 			int the_error = errno;
@@ -4852,6 +4948,26 @@ FileTransfer::DoObtainAndSendTransferGoAhead(DCTransferQueue &xfer_queue,bool do
 		if( downloading ) {
 			msg.Assign(ATTR_MAX_TRANSFER_BYTES,MaxDownloadBytes);
 		}
+		if( go_ahead > 0 ) {
+			if( downloading && m_parallel_listener ) {
+					// Offer our peer parallel streams for large files.
+				msg.Assign(ATTR_PARALLEL_TRANSFER_ADDRESS,m_parallel_address);
+				msg.Assign(ATTR_PARALLEL_TRANSFER_COOKIE,m_parallel_cookie);
+				msg.Assign(ATTR_PARALLEL_TRANSFER_STREAMS,m_parallel_offered);
+			}
+			else if( !downloading && m_parallel_offered > 0 && !m_parallel_streams && !m_parallel_failed ) {
+					// Tell our peer how many of the offered parallel
+					// streams we will use, if any.
+				int streams = MIN( m_parallel_offered, ParallelStreamsWanted() );
+				msg.Assign(ATTR_PARALLEL_TRANSFER_STREAMS,streams);
+				if( streams > 0 ) {
+					m_parallel_streams = streams;
+				}
+				else {
+					m_parallel_failed = true;
+				}
+			}
+		}
 		if( go_ahead < 0 ) {
 				// tell our peer what exactly went wrong
 			msg.Assign(ATTR_TRY_AGAIN,try_again);
@@ -5015,6 +5131,30 @@ FileTransfer::DoReceiveTransferGoAhead(
 			free(hold_reason_buf);
 		}
 
+		if( go_ahead > 0 ) {
+			if( downloading && m_parallel_listener && !m_parallel_streams ) {
+					// This answers the offer in our own GoAhead message.
+				int streams = 0;
+				msg.LookupInteger(ATTR_PARALLEL_TRANSFER_STREAMS,streams);
+				if( streams > 0 && streams <= m_parallel_offered ) {
+					m_parallel_streams = streams;
+					dprintf(D_FULLDEBUG,"Peer will send large files over %d parallel streams.\n",streams);
+				}
+				else {
+					ResetParallelStreams();
+				}
+			}
+			else if( !downloading && !m_parallel_offered && !m_parallel_failed ) {
+				int streams = 0;
+				if( msg.LookupInteger(ATTR_PARALLEL_TRANSFER_STREAMS,streams) && streams > 0 &&
+					msg.LookupString(ATTR_PARALLEL_TRANSFER_ADDRESS,m_parallel_address) &&
+					msg.LookupString(ATTR_PARALLEL_TRANSFER_COOKIE,m_parallel_cookie) )
+				{
+					m_parallel_offered = streams;
+				}
+			}
+		}
+
 		break;
 	}
 
@@ -5034,6 +5174,321 @@ FileTransfer::DoReceiveTransferGoAhead(
 	return true;
 }
 
+void
+FileTransfer::ResetParallelStreams()
+{
+	m_parallel_listener.reset();
+	m_parallel_socks.clear();
+	m_parallel_address.clear();
+	m_parallel_cookie.clear();
+	m_parallel_offered = 0;
+	m_parallel_streams = 0;
+	m_parallel_failed = false;
+}
+
+#if !defined(WIN32)
+
+// How long the uploading side waits to connect a parallel stream.
+static const int PARALLEL_CONNECT_TIMEOUT = 20;
+
+// The sockets of the first stripes parallel streams.
+static std::vector<int>
+ParallelStreamFds(std::vector<std::unique_ptr<ReliSock>> &socks, int stripes)
+{
+	std::vector<int> fds;
+	for( int i = 0; i < stripes; i++ ) {
+		fds.push_back( socks[i]->get_file_desc() );
+	}
+	return fds;
+}
+
+// Called by the downloading side before the first GoAhead.  The
+// parallel streams are to connect to the address our peer reached us
+// at, so that they take the same way through the network.
+bool
+FileTransfer::ListenForParallelStreams(ReliSock *s)
+{
+	int streams = ParallelStreamsWanted();
+	if( streams <= 0 ) {
+		return false;
+	}
+
+	condor_sockaddr addr = s->my_addr();
+	std::unique_ptr<ReliSock> listener( new ReliSock() );
+	if( !listener->bind( addr.get_protocol(), false, 0, addr.is_loopback() ) ||
+		!listener->listen() )
+	{
+		dprintf( D_ALWAYS, "DoDownload: failed to listen for parallel streams, "
+				 "receiving all files over one connection.\n" );
+		return false;
+	}
+	addr.set_port( listener->get_port() );
+
+	char *cookie = Condor_Crypt_Base::randomHexKey( 16 );
+	m_parallel_cookie = cookie;
+	free( cookie );
+	m_parallel_address = addr.to_sinful().Value();
+	m_parallel_listener = std::move( listener );
+	m_parallel_offered = streams;
+	return true;
+}
+
+// The number of parallel streams to stripe a file across, or 0 to send
+// it the usual way.  Connects the streams the first time they are used.
+int
+FileTransfer::ParallelStripesForUpload(ReliSock *s, char const *fullname, filesize_t max_bytes)
+{
+		// The streams carry the data as it is in the file, so only
+		// use them for files that would not be encrypted anyway.
+	if( m_parallel_streams <= 0 || m_parallel_failed || !s->file_data_in_clear() ) {
+		return 0;
+	}
+
+	StatInfo st( fullname );
+	if( st.Error() || st.IsDirectory() ) {
+		return 0;
+	}
+	filesize_t min_size = (filesize_t)param_integer( "FILE_TRANSFER_PARALLEL_MIN_MB", 100, 1 ) * 1024 * 1024;
+	filesize_t size = st.GetFileSize();
+	if( size < min_size || (max_bytes >= 0 && size > max_bytes) ) {
+			// Files that are too big take the usual way, which
+			// knows how to report that.
+		return 0;
+	}
+
+	if( m_parallel_socks.empty() ) {
+		int sock_bufsize = param_integer( "FILE_TRANSFER_SOCKET_BUFSIZE", 0, 0 );
+		for( int index = 0; index < m_parallel_streams; index++ ) {
+			std::unique_ptr<ReliSock> sock( new ReliSock() );
+			sock->timeout( PARALLEL_CONNECT_TIMEOUT );
+			if( !sock->connect( m_parallel_address.c_str() ) ) {
+				dprintf( D_ALWAYS, "DoUpload: failed to connect parallel stream %d to %s\n",
+						 index, m_parallel_address.c_str() );
+				break;
+			}
+			sock->encode();
+			if( !sock->put( m_parallel_cookie ) || !sock->put( index ) || !sock->end_of_message() ) {
+				dprintf( D_ALWAYS, "DoUpload: failed to start parallel stream %d to %s\n",
+						 index, m_parallel_address.c_str() );
+				break;
+			}
+			if( sock_bufsize > 0 ) {
+				sock->set_os_buffers( sock_bufsize, true );
+			}
+			m_parallel_socks.push_back( std::move(sock) );
+		}
+		if( m_parallel_socks.empty() ) {
+			dprintf( D_ALWAYS, "DoUpload: sending all files over one connection.\n" );
+			m_parallel_failed = true;
+			return 0;
+		}
+		dprintf( D_FULLDEBUG, "DoUpload: connected %d parallel streams to %s\n",
+				 (int)m_parallel_socks.size(), m_parallel_address.c_str() );
+	}
+
+	return (int)m_parallel_socks.size();
+}
+
+// Send a file striped across the parallel streams.  The permissions and
+// size go over the main connection.  Returns like put_file().
+int
+FileTransfer::SendParallelFile(ReliSock *s, int stripes, char const *fullname, filesize_t *bytes, DCTransferQueue &xfer_queue)
+{
+	condor_mode_t file_mode = NULL_FILE_PERMISSIONS;
+	filesize_t filesize = 0;
+	int fd = -1;
+	int open_errno = 0;
+
+	*bytes = 0;
+	if( allow_shadow_access( fullname ) ) {
+		errno = 0;
+		fd = safe_open_wrapper_follow( fullname, O_RDONLY | O_LARGEFILE | _O_BINARY, 0 );
+	}
+	else {
+		errno = EACCES;
+	}
+	if( fd >= 0 ) {
+		StatInfo st( fd );
+		if( st.Error() ) {
+			errno = st.Errno();
+			close( fd );
+			fd = -1;
+		}
+		else {
+			filesize = st.GetFileSize();
+			if( TransferFilePermissions ) {
+				file_mode = (condor_mode_t)st.GetMode();
+			}
+		}
+	}
+	if( fd < 0 ) {
+		open_errno = errno;
+		dprintf( D_ALWAYS, "DoUpload: failed to open file %s, errno = %d.\n",
+				 fullname, open_errno );
+	}
+
+		// If the file could not be opened, our peer gets an empty one,
+		// as with put_file().
+	s->encode();
+	if( !s->code( file_mode ) || !s->put( filesize ) || !s->end_of_message() ) {
+		dprintf( D_ALWAYS, "DoUpload: failed to send size of %s\n", fullname );
+		if( fd >= 0 ) {
+			close( fd );
+		}
+		return -1;
+	}
+	if( fd < 0 ) {
+		errno = open_errno;
+		return PUT_FILE_OPEN_FAILED;
+	}
+
+	std::vector<ParallelStripe> parts = SplitIntoStripes( ParallelStreamFds( m_parallel_socks, stripes ), filesize );
+	int rc = MoveParallelStripes( parts, fd, true, s->get_timeout_raw(), xfer_queue );
+	close( fd );
+	if( rc < 0 ) {
+		return -1;
+	}
+
+	dprintf( D_FULLDEBUG, "DoUpload: sent " FILESIZE_T_FORMAT " bytes of %s over %d parallel streams\n",
+			 filesize, fullname, stripes );
+	*bytes = filesize;
+	return 0;
+}
+
+// Receive a file striped across the parallel streams, accepting the
+// streams that have not connected yet.  Returns like get_file().
+int
+FileTransfer::ReceiveParallelFile(ReliSock *s, int stripes, char const *fullname, filesize_t max_bytes, filesize_t *bytes, DCTransferQueue &xfer_queue)
+{
+	condor_mode_t file_mode = NULL_FILE_PERMISSIONS;
+	filesize_t filesize = 0;
+	int timeout = s->get_timeout_raw();
+
+	*bytes = 0;
+	if( stripes > m_parallel_streams || !m_parallel_listener || !s->file_data_in_clear() ) {
+		dprintf( D_ALWAYS, "DoDownload: peer wants to send %s over %d parallel streams, "
+				 "which we did not agree on.\n", fullname, stripes );
+		return -1;
+	}
+
+	s->decode();
+	if( !s->code( file_mode ) || !s->get( filesize ) || !s->end_of_message() ) {
+		dprintf( D_ALWAYS, "DoDownload: failed to receive size of %s\n", fullname );
+		return -1;
+	}
+	if( max_bytes >= 0 && filesize > max_bytes ) {
+		dprintf( D_ALWAYS, "DoDownload: not receiving " FILESIZE_T_FORMAT " bytes of %s, "
+				 "because max transfer size is exceeded.\n", filesize, fullname );
+		return GET_FILE_MAX_BYTES_EXCEEDED;
+	}
+
+	if( (int)m_parallel_socks.size() < stripes ) {
+		m_parallel_socks.resize( stripes );
+	}
+	time_t deadline = time(NULL) + timeout;
+	int sock_bufsize = param_integer( "FILE_TRANSFER_SOCKET_BUFSIZE", 0, 0 );
+	for(;;) {
+		int missing = (int)std::count( m_parallel_socks.begin(), m_parallel_socks.begin() + stripes, nullptr );
+		if( !missing ) {
+			break;
+		}
+		int left = (int)(deadline - time(NULL));
+		if( timeout > 0 && left <= 0 ) {
+			dprintf( D_ALWAYS, "DoDownload: timed out waiting for %d parallel streams\n", missing );
+			return -1;
+		}
+		m_parallel_listener->timeout( timeout > 0 ? left : 0 );
+		std::unique_ptr<ReliSock> sock( m_parallel_listener->accept() );
+		if( !sock ) {
+			dprintf( D_ALWAYS, "DoDownload: failed to accept parallel stream\n" );
+			return -1;
+		}
+		std::string cookie;
+		int index = -1;
+		sock->timeout( timeout );
+		sock->decode();
+		if( !sock->get( cookie ) || !sock->get( index ) || !sock->end_of_message() ||
+			cookie != m_parallel_cookie || index < 0 || index >= stripes || m_parallel_socks[index] )
+		{
+			dprintf( D_ALWAYS, "DoDownload: rejecting parallel stream from %s\n",
+					 sock->peer_description() );
+			continue;
+		}
+		if( sock_bufsize > 0 ) {
+			sock->set_os_buffers( sock_bufsize, false );
+		}
+		m_parallel_socks[index] = std::move( sock );
+	}
+
+	int fd = -1;
+	int open_errno = 0;
+	bool discard = !strcmp( fullname, NULL_FILE );
+	if( !discard ) {
+		if( allow_shadow_access( fullname ) ) {
+			errno = 0;
+			fd = safe_open_wrapper_follow( fullname, O_WRONLY | O_CREAT | O_TRUNC | _O_BINARY | O_LARGEFILE, 0600 );
+		}
+		else {
+			errno = EACCES;
+		}
+		if( fd < 0 ) {
+			open_errno = errno;
+			dprintf( D_ALWAYS, "DoDownload: failed to open file %s, errno = %d: %s.\n",
+					 fullname, open_errno, strerror(open_errno) );
+				// Receive the data anyway, and throw it away.
+		}
+	}
+
+	std::vector<ParallelStripe> parts = SplitIntoStripes( ParallelStreamFds( m_parallel_socks, stripes ), filesize );
+	int rc = MoveParallelStripes( parts, fd, false, timeout, xfer_queue );
+	int write_errno = errno;
+	if( fd >= 0 && close( fd ) != 0 ) {
+		write_errno = errno;
+		dprintf( D_ALWAYS, "DoDownload: close of %s failed, errno = %d (%s)\n",
+				 fullname, errno, strerror(errno) );
+		if( rc == 0 ) {
+			rc = GET_FILE_WRITE_FAILED;
+		}
+	}
+	if( rc < 0 && fd >= 0 ) {
+		unlink( fullname );
+	}
+	if( rc == -1 ) {
+		return -1;
+	}
+
+	*bytes = filesize;
+	if( !discard && fd < 0 ) {
+		errno = open_errno;
+		return GET_FILE_OPEN_FAILED;
+	}
+	if( rc < 0 ) {
+		errno = write_errno;
+		return rc;
+	}
+
+	if( !discard && file_mode != NULL_FILE_PERMISSIONS ) {
+		if( chmod( fullname, (mode_t)file_mode ) < 0 ) {
+			dprintf( D_ALWAYS, "DoDownload: failed to chmod file '%s': %s (errno: %d)\n",
+					 fullname, strerror(errno), errno );
+			return -1;
+		}
+	}
+
+	dprintf( D_FULLDEBUG, "DoDownload: received " FILESIZE_T_FORMAT " bytes of %s over %d parallel streams\n",
+			 filesize, fullname, stripes );
+	return 0;
+}
+
+#else // WIN32, where ParallelStreamsWanted() is always 0
+
+bool FileTransfer::ListenForParallelStreams(ReliSock *) { return false; }
+int FileTransfer::ParallelStripesForUpload(ReliSock *, char const *, filesize_t) { return 0; }
+int FileTransfer::SendParallelFile(ReliSock *, int, char const *, filesize_t *, DCTransferQueue &) { return -1; }
+int FileTransfer::ReceiveParallelFile(ReliSock *, int, char const *, filesize_t, filesize_t *, DCTransferQueue &) { return -1; }
+
+#endif
+
 int
 FileTransfer::ExitDoUpload(const filesize_t *total_bytes, int numFiles, ReliSock *s, priv_state saved_priv, bool socket_default_crypto, bool upload_success, bool do_upload_ack, bool do_download_ack, bool try_again, int hold_code, int hold_subcode, char const *upload_error_desc,int DoUpload_exit_line)
 {
@@ -5820,6 +6275,7 @@ int FileTransfer::OutputFileTransferStats( ClassAd &stats ) {
 	// Read name of statistics file from params
 	std::string stats_file_path;
 	if (!param( stats_file_path, "FILE_TRANSFER_STATS_LOG" )) {
+		set_priv(saved_priv);
 		return 1;
 	}
 
@@ -482,6 +482,18 @@ class FileTransfer final: public Service {
 	filesize_t MaxUploadBytes{-1};  // no limit by default
 	filesize_t MaxDownloadBytes{-1};
 
+	// Extra connections that large files are striped across, see
+	// FILE_TRANSFER_PARALLEL_STREAMS.  The downloading side listens
+	// for them and offers them in its first GoAhead message; the
+	// uploading side accepts the offer in its own and connects.
+	std::unique_ptr<ReliSock> m_parallel_listener;
+	std::vector<std::unique_ptr<ReliSock>> m_parallel_socks;
+	std::string m_parallel_address;
+	std::string m_parallel_cookie;
+	int m_parallel_offered{0};   // streams offered by the downloading side
+	int m_parallel_streams{0};   // streams agreed on, 0 if not striping
+	bool m_parallel_failed{false};
+
 	// stores the path to the proxy after one is received
 	MyString LocalProxyName;
 
@@ -523,6 +535,13 @@ class FileTransfer final: public Service {
 
 	std::string GetTransferQueueUser();
 
+	// Striping large files across extra connections to our peer.
+	void ResetParallelStreams();
+	bool ListenForParallelStreams(ReliSock *s);
+	int ParallelStripesForUpload(ReliSock *s, char const *fullname, filesize_t max_bytes);
+	int SendParallelFile(ReliSock *s, int stripes, char const *fullname, filesize_t *bytes, DCTransferQueue &xfer_queue);
+	int ReceiveParallelFile(ReliSock *s, int stripes, char const *fullname, filesize_t max_bytes, filesize_t *bytes, DCTransferQueue &xfer_queue);
+
 	// Report information about completed transfer from child thread.
 	bool WriteStatusToTransferPipe(filesize_t total_bytes);
 	ClassAd jobAd;
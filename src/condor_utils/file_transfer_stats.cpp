@@ -53,6 +53,8 @@ void FileTransferStats::Publish(classad::ClassAd &ad) const {
         ad.InsertAttr("HttpCacheHitOrMiss", HttpCacheHitOrMiss);
     if (!HttpCacheHost.empty())
         ad.InsertAttr("HttpCacheHost", HttpCacheHost);
+    if (!TransferCopyMethod.empty())
+        ad.InsertAttr("TransferCopyMethod", TransferCopyMethod);
     if (!TransferError.empty())
         ad.InsertAttr("TransferError", TransferError);
     if (!TransferFileName.empty())
@@ -45,6 +45,7 @@
 		
 		std::string HttpCacheHitOrMiss;
 		std::string HttpCacheHost;
+		std::string TransferCopyMethod;
 		std::string TransferError;
 		std::string TransferFileName;
 		std::string TransferHostName;
@@ -0,0 +1,197 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "reli_sock.h"
+#include "dc_transfer_queue.h"
+#include "selector.h"
+#include "utc_time.h"
+#include "file_transfer_stripes.h"
+
+#if defined(LINUX)
+#include <sys/sendfile.h>
+#endif
+
+#if !defined(WIN32)
+
+std::vector<ParallelStripe>
+SplitIntoStripes(const std::vector<int> &socks, filesize_t size)
+{
+	std::vector<ParallelStripe> result;
+	filesize_t stripes = (filesize_t)socks.size();
+	if( stripes <= 0 ) {
+		return result;
+	}
+	filesize_t per_stripe = (size + stripes - 1) / stripes;
+		// round up to whole chunks, so the joints are aligned
+	per_stripe = (per_stripe + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK * PARALLEL_CHUNK;
+	filesize_t offset = 0;
+	for( int sock : socks ) {
+		ParallelStripe stripe;
+		stripe.sock = sock;
+		stripe.offset = offset;
+		stripe.end = MIN( offset + per_stripe, size );
+		offset = stripe.end;
+		result.push_back( stripe );
+	}
+	return result;
+}
+
+int
+MoveParallelStripes( std::vector<ParallelStripe> &stripes, int fd, bool sending, int timeout, DCTransferQueue &xfer_queue )
+{
+	int result = 0;
+	int saved_errno = 0;
+	std::vector<char> buf;
+#if defined(LINUX)
+	if( !sending ) buf.resize( PARALLEL_CHUNK );
+#else
+	buf.resize( PARALLEL_CHUNK );
+#endif
+	Selector::IO_FUNC io = sending ? Selector::IO_WRITE : Selector::IO_READ;
+
+	for( auto &stripe : stripes ) {
+		int flags = fcntl( stripe.sock, F_GETFL );
+		fcntl( stripe.sock, F_SETFL, flags | O_NONBLOCK );
+	}
+
+	for(;;) {
+		Selector selector;
+		int active = 0;
+		for( auto &stripe : stripes ) {
+			if( stripe.offset < stripe.end ) {
+				selector.add_fd( stripe.sock, io );
+				active++;
+			}
+		}
+		if( !active ) {
+			break;
+		}
+		if( timeout > 0 ) {
+			selector.set_timeout( timeout );
+		}
+
+		struct timeval t1, t2;
+		condor_gettimestamp( t1 );
+		selector.execute();
+		if( selector.signalled() ) {
+			continue;
+		}
+		if( selector.timed_out() ) {
+			dprintf( D_ALWAYS, "FILETRANSFER: timed out after %d seconds waiting for parallel streams\n",
+					 timeout );
+			result = -1;
+			break;
+		}
+		if( selector.failed() ) {
+			dprintf( D_ALWAYS, "FILETRANSFER: select() failed waiting for parallel streams: %s\n",
+					 strerror(selector.select_errno()) );
+			result = -1;
+			break;
+		}
+
+		long usec_file = 0;
+		for( auto &stripe : stripes ) {
+			if( stripe.offset >= stripe.end || !selector.fd_ready( stripe.sock, io ) ) {
+				continue;
+			}
+			size_t want = (size_t)MIN( stripe.end - stripe.offset, (filesize_t)PARALLEL_CHUNK );
+			ssize_t n;
+			if( sending ) {
+#if defined(LINUX)
+				off_t off = stripe.offset;
+				n = sendfile( stripe.sock, fd, &off, want );
+#else
+				n = pread( fd, &buf[0], want, stripe.offset );
+				if( n > 0 ) {
+					n = ::send( stripe.sock, &buf[0], n, 0 );
+				}
+#endif
+			}
+			else {
+				n = ::recv( stripe.sock, &buf[0], want, 0 );
+			}
+			if( n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ) {
+				continue;
+			}
+			if( n <= 0 ) {
+				dprintf( D_ALWAYS, "FILETRANSFER: failed to %s parallel stream at offset " FILESIZE_T_FORMAT ": %s\n",
+						 sending ? "send on" : "receive from", stripe.offset,
+						 n < 0 ? strerror(errno) : (sending ? "file is shorter than expected" : "connection closed") );
+				result = -1;
+				break;
+			}
+
+			if( !sending && fd >= 0 && result == 0 ) {
+				struct timeval w1, w2;
+				condor_gettimestamp( w1 );
+				for( ssize_t written = 0; written < n; ) {
+					ssize_t rval = pwrite( fd, &buf[written], n - written, stripe.offset + written );
+					if( rval <= 0 ) {
+						saved_errno = rval < 0 ? errno : ENOSPC;
+						dprintf( D_ALWAYS, "FILETRANSFER: pwrite() failed: %s (errno=%d)\n",
+								 strerror(saved_errno), saved_errno );
+							// Keep receiving, but throw it all away, so
+							// that the wire protocol stays well defined.
+						result = GET_FILE_WRITE_FAILED;
+						break;
+					}
+					written += rval;
+				}
+				condor_gettimestamp( w2 );
+				usec_file += timersub_usec( w2, w1 );
+			}
+
+			stripe.offset += n;
+			if( sending ) {
+				xfer_queue.AddBytesSent( n );
+			}
+			else {
+				xfer_queue.AddBytesReceived( n );
+			}
+		}
+		if( result == -1 ) {
+			break;
+		}
+
+		condor_gettimestamp( t2 );
+		if( sending ) {
+				// We don't know how much of the time was spent reading
+				// from disk vs. writing to the network, so we just report
+				// it all as network i/o time.
+			xfer_queue.AddUsecNetWrite( timersub_usec(t2, t1) );
+		}
+		else {
+			xfer_queue.AddUsecNetRead( timersub_usec(t2, t1) - usec_file );
+			xfer_queue.AddUsecFileWrite( usec_file );
+		}
+		xfer_queue.ConsiderSendingReport( t2.tv_sec );
+	}
+
+	for( auto &stripe : stripes ) {
+		int flags = fcntl( stripe.sock, F_GETFL );
+		fcntl( stripe.sock, F_SETFL, flags & ~O_NONBLOCK );
+	}
+
+	errno = saved_errno;
+	return result;
+}
+
+#endif
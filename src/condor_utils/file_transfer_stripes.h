@@ -0,0 +1,56 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef _FILE_TRANSFER_STRIPES_H
+#define _FILE_TRANSFER_STRIPES_H
+
+// Moving a large file striped across the parallel streams of a
+// FileTransfer, see FILE_TRANSFER_PARALLEL_STREAMS.
+
+#include <vector>
+
+class DCTransferQueue;
+
+#if !defined(WIN32)
+
+// Most that is moved over one parallel stream at a time.  Stripes start
+// on a multiple of it.
+static const size_t PARALLEL_CHUNK = 1024 * 1024;
+
+// The part of a file that one parallel stream carries.
+struct ParallelStripe {
+	int sock;
+	filesize_t offset;	// the next byte to send or receive
+	filesize_t end;
+};
+
+// Split a file into one contiguous stripe per stream.  Both sides must
+// come up with the same stripes, as only the file size is sent.
+std::vector<ParallelStripe> SplitIntoStripes(const std::vector<int> &socks, filesize_t size);
+
+// Move the stripes of a file between fd and the parallel streams, all
+// at once, until they are done.  When receiving, fd may be -1 to throw
+// the data away.  Returns 0 on success, -1 if a stream failed, or
+// GET_FILE_WRITE_FAILED if writing to fd failed (errno is set), in
+// which case the rest of the data is received and thrown away.
+int MoveParallelStripes(std::vector<ParallelStripe> &stripes, int fd, bool sending, int timeout, DCTransferQueue &xfer_queue);
+
+#endif
+
+#endif
@@ -0,0 +1,238 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_classad.h"
+#include "condor_attributes.h"
+#include "compat_classad_util.h"
+#include "basename.h"
+#include "stl_string_utils.h"
+#include "historyIndex.h"
+
+void historyIndexFilename(const char * history_file, std::string & index_file)
+{
+	const char * base = condor_basename(history_file);
+	index_file.assign(history_file, base - history_file);
+	index_file += '.';
+	index_file += base;
+	index_file += ".idx";
+}
+
+void formatHistoryIndexEntry(std::string & line, const HistoryIndexEntry & entry)
+{
+	formatstr(line, "%lld %lld %d %d %lld %s\n",
+		entry.offset, entry.end, entry.cluster, entry.proc, entry.completion,
+		entry.owner.empty() ? "?" : entry.owner.c_str());
+}
+
+bool parseHistoryIndexEntry(const char * line, HistoryIndexEntry & entry)
+{
+	int owner_pos = 0;
+	if (sscanf(line, "%lld %lld %d %d %lld %n",
+			&entry.offset, &entry.end, &entry.cluster, &entry.proc, &entry.completion, &owner_pos) != 5
+		|| ! owner_pos) {
+		return false;
+	}
+	// the owner is the rest of the line, the line must end with a newline
+	const char * owner = line + owner_pos;
+	const char * eol = strchr(owner, '\n');
+	if ( ! eol || eol == owner) {
+		return false;
+	}
+	entry.owner.assign(owner, eol - owner);
+	return entry.offset >= 0 && entry.end > entry.offset;
+}
+
+bool readHistoryIndex(const char * history_file, long long history_size, std::vector<HistoryIndexEntry> & entries)
+{
+	entries.clear();
+
+	std::string index_file;
+	historyIndexFilename(history_file, index_file);
+	FILE * fp = safe_fopen_wrapper_follow(index_file.c_str(), "r");
+	if ( ! fp) {
+		return false;
+	}
+
+	// the entries must cover the history file from start to end without gaps
+	// otherwise the history file was written (in part) without the index
+	bool valid = true;
+	long long next_offset = 0;
+	char buf[1024];
+	while (fgets(buf, sizeof(buf), fp)) {
+		HistoryIndexEntry entry;
+		if ( ! parseHistoryIndexEntry(buf, entry) || entry.offset != next_offset) {
+			valid = false;
+			break;
+		}
+		next_offset = entry.end;
+		entries.push_back(entry);
+	}
+	fclose(fp);
+
+	if ( ! valid || next_offset != history_size) {
+		dprintf(D_FULLDEBUG, "Ignoring index %s, it does not match %s\n", index_file.c_str(), history_file);
+		entries.clear();
+		return false;
+	}
+	return true;
+}
+
+// Evaluate a comparison between an attribute in the index and a literal.
+static HistoryIndexResult
+EvalHistoryIndexCompare(classad::Operation::OpKind op, classad::ExprTree * left, classad::ExprTree * right, const HistoryIndexEntry & entry)
+{
+	std::string attr;
+	classad::Value value;
+	bool absolute = false;
+
+	left = SkipExprParens(left);
+	right = SkipExprParens(right);
+	if (ExprTreeIsAttrRef(left, attr, &absolute) && ExprTreeIsLiteral(right, value)) {
+		// attr <op> literal
+	} else if (ExprTreeIsLiteral(left, value) && ExprTreeIsAttrRef(right, attr, &absolute)) {
+		// literal <op> attr, turn it around
+		switch (op) {
+		case classad::Operation::LESS_THAN_OP: op = classad::Operation::GREATER_THAN_OP; break;
+		case classad::Operation::LESS_OR_EQUAL_OP: op = classad::Operation::GREATER_OR_EQUAL_OP; break;
+		case classad::Operation::GREATER_OR_EQUAL_OP: op = classad::Operation::LESS_OR_EQUAL_OP; break;
+		case classad::Operation::GREATER_THAN_OP: op = classad::Operation::LESS_THAN_OP; break;
+		default: break;
+		}
+	} else {
+		return HISTORY_INDEX_UNKNOWN;
+	}
+	if (absolute) {
+		return HISTORY_INDEX_UNKNOWN;
+	}
+
+	bool result = false;
+	if (strcasecmp(attr.c_str(), ATTR_OWNER) == 0) {
+		std::string str;
+		if (entry.owner.empty() || entry.owner == "?" || ! value.IsStringValue(str)) {
+			return HISTORY_INDEX_UNKNOWN;
+		}
+		switch (op) {
+		case classad::Operation::EQUAL_OP: result = strcasecmp(entry.owner.c_str(), str.c_str()) == 0; break;
+		case classad::Operation::NOT_EQUAL_OP: result = strcasecmp(entry.owner.c_str(), str.c_str()) != 0; break;
+		case classad::Operation::META_EQUAL_OP: result = entry.owner == str; break;
+		case classad::Operation::META_NOT_EQUAL_OP: result = entry.owner != str; break;
+		default: return HISTORY_INDEX_UNKNOWN;
+		}
+		return result ? HISTORY_INDEX_TRUE : HISTORY_INDEX_FALSE;
+	}
+
+	long long ival;
+	if (strcasecmp(attr.c_str(), ATTR_CLUSTER_ID) == 0) {
+		ival = entry.cluster;
+	} else if (strcasecmp(attr.c_str(), ATTR_PROC_ID) == 0) {
+		ival = entry.proc;
+	} else if (strcasecmp(attr.c_str(), ATTR_COMPLETION_DATE) == 0) {
+		ival = entry.completion;
+	} else {
+		return HISTORY_INDEX_UNKNOWN;
+	}
+	if (ival < 0) {
+		// the job ad did not have this attribute (or it was not an integer)
+		return HISTORY_INDEX_UNKNOWN;
+	}
+
+	// =?= and =!= are false for an integer and a real, so only integer literals will do for those.
+	long long lit_int;
+	double lit;
+	if (value.IsIntegerValue(lit_int)) {
+		lit = (double)lit_int;
+	} else if (op == classad::Operation::META_EQUAL_OP || op == classad::Operation::META_NOT_EQUAL_OP ||
+		! value.IsRealValue(lit)) {
+		return HISTORY_INDEX_UNKNOWN;
+	}
+	double val = (double)ival;
+	switch (op) {
+	case classad::Operation::LESS_THAN_OP: result = val < lit; break;
+	case classad::Operation::LESS_OR_EQUAL_OP: result = val <= lit; break;
+	case classad::Operation::GREATER_OR_EQUAL_OP: result = val >= lit; break;
+	case classad::Operation::GREATER_THAN_OP: result = val > lit; break;
+	case classad::Operation::EQUAL_OP:
+	case classad::Operation::META_EQUAL_OP: result = val == lit; break;
+	case classad::Operation::NOT_EQUAL_OP:
+	case classad::Operation::META_NOT_EQUAL_OP: result = val != lit; break;
+	default: return HISTORY_INDEX_UNKNOWN;
+	}
+	return result ? HISTORY_INDEX_TRUE : HISTORY_INDEX_FALSE;
+}
+
+// The result is used both to skip job ads that can't match the constraint, which is
+// safe when the constraint would evaluate to anything other than true, and to stop at
+// the -since job, which is only safe when the since expression is known to be true.
+// So a comparison we can't evaluate could be anything, including undefined or error,
+// and the logical operators have to follow the ClassAd rules for those, for instance
+// error && false is error (not true) and !(undefined) is undefined.
+HistoryIndexResult EvalHistoryIndexExpr(classad::ExprTree * expr, const HistoryIndexEntry & entry)
+{
+	if ( ! expr) return HISTORY_INDEX_UNKNOWN;
+	expr = SkipExprParens(expr);
+	if (expr->GetKind() != classad::ExprTree::OP_NODE) {
+		bool bval;
+		if (ExprTreeIsLiteralBool(expr, bval)) {
+			return bval ? HISTORY_INDEX_TRUE : HISTORY_INDEX_FALSE;
+		}
+		return HISTORY_INDEX_UNKNOWN;
+	}
+
+	classad::Operation::OpKind op;
+	classad::ExprTree *t1, *t2, *t3;
+	((const classad::Operation*)expr)->GetComponents(op, t1, t2, t3);
+
+	if (op >= classad::Operation::__COMPARISON_START__ && op <= classad::Operation::__COMPARISON_END__) {
+		return EvalHistoryIndexCompare(op, t1, t2, entry);
+	}
+
+	HistoryIndexResult left, right;
+	switch (op) {
+	case classad::Operation::LOGICAL_NOT_OP:
+		left = EvalHistoryIndexExpr(t1, entry);
+		if (left == HISTORY_INDEX_TRUE) return HISTORY_INDEX_FALSE;
+		if (left == HISTORY_INDEX_FALSE) return HISTORY_INDEX_TRUE;
+		return HISTORY_INDEX_UNKNOWN;
+
+	case classad::Operation::LOGICAL_AND_OP:
+		left = EvalHistoryIndexExpr(t1, entry);
+		if (left == HISTORY_INDEX_FALSE) return HISTORY_INDEX_FALSE;
+		right = EvalHistoryIndexExpr(t2, entry);
+		if (left == HISTORY_INDEX_TRUE) return right;
+		if (left == HISTORY_INDEX_NOT_TRUE || right == HISTORY_INDEX_FALSE || right == HISTORY_INDEX_NOT_TRUE) {
+			return HISTORY_INDEX_NOT_TRUE;
+		}
+		return HISTORY_INDEX_UNKNOWN;
+
+	case classad::Operation::LOGICAL_OR_OP:
+		left = EvalHistoryIndexExpr(t1, entry);
+		if (left == HISTORY_INDEX_TRUE) return HISTORY_INDEX_TRUE;
+		right = EvalHistoryIndexExpr(t2, entry);
+		if (left == HISTORY_INDEX_FALSE) return right;
+		if (left == HISTORY_INDEX_NOT_TRUE && (right == HISTORY_INDEX_FALSE || right == HISTORY_INDEX_NOT_TRUE)) {
+			return HISTORY_INDEX_NOT_TRUE;
+		}
+		return HISTORY_INDEX_UNKNOWN;
+
+	default:
+		return HISTORY_INDEX_UNKNOWN;
+	}
+}
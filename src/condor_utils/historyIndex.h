@@ -0,0 +1,84 @@
+/***************************************************************
+ *
+ * Copyright (C) 1990-2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef _HISTORYINDEX_H_
+#define _HISTORYINDEX_H_
+
+#include <string>
+#include <vector>
+
+// Every history file written with ENABLE_HISTORY_INDEX has a sidecar index
+// file named .<history-file-name>.idx in the same directory, which is renamed
+// along with the history file when it is rotated.  The index has one line
+// for each job ad in the history file, in the same order, of the form
+//
+//    <offset> <end> <ClusterId> <ProcId> <CompletionDate> <Owner>
+//
+// where offset and end are the byte offsets of the first line of the ad
+// and of the line after its "***" banner.  An attribute that the ad did not
+// have is written as -1, or as ? for the Owner.
+//
+// The index lets a reader skip over the job ads that cannot match a
+// constraint on those attributes without reading or parsing them.  It is
+// a flat list in the order of the history file, with no sorted or keyed
+// part, so a reader still goes through every entry, even to find a single
+// job.  An entry is about 50 bytes against a few KB for a job ad, so the
+// scan of the index is a small part of the time a query used to take.
+
+namespace classad { class ExprTree; }
+
+class HistoryIndexEntry {
+public:
+	HistoryIndexEntry() : offset(0), end(0), cluster(-1), proc(-1), completion(-1) {}
+	long long offset;     // offset of the first line of the job ad
+	long long end;        // offset of the first byte after the banner line
+	int cluster;
+	int proc;
+	long long completion;
+	std::string owner;
+};
+
+// Build the name of the index file for the given history file.
+void historyIndexFilename(const char * history_file, std::string & index_file);
+
+// Format an index entry as a line of the index file, including the newline.
+void formatHistoryIndexEntry(std::string & line, const HistoryIndexEntry & entry);
+
+// Parse one line of an index file, returns false if the line is malformed.
+bool parseHistoryIndexEntry(const char * line, HistoryIndexEntry & entry);
+
+// Read the index of the given history file.  returns false if there is no index,
+// or if it does not describe every byte of a history file that is history_size bytes long,
+// in which case the caller should read the history file without the index.
+bool readHistoryIndex(const char * history_file, long long history_size, std::vector<HistoryIndexEntry> & entries);
+
+// The result of evaluating an expression using only the attributes in an index entry.
+enum HistoryIndexResult {
+	HISTORY_INDEX_FALSE,     // the expression evaluates to false for the job ad
+	HISTORY_INDEX_TRUE,      // the expression evaluates to true for the job ad
+	HISTORY_INDEX_NOT_TRUE,  // the expression evaluates to false, undefined or error
+	HISTORY_INDEX_UNKNOWN,   // the job ad must be read to know
+};
+
+// Evaluate an expression against the job ad described by an index entry.
+// Only comparisons between a literal and ClusterId, ProcId, CompletionDate or Owner,
+// combined with &&, || and ! are understood, anything else is HISTORY_INDEX_UNKNOWN.
+HistoryIndexResult EvalHistoryIndexExpr(classad::ExprTree * expr, const HistoryIndexEntry & entry);
+
+#endif
@@ -172,6 +172,219 @@ LogRecord::Write(FILE *fp)
 }
 
 
+// the records of the binary format, see log.h
+static const uint32_t BINARY_RECORD_MAX = 256 * 1024 * 1024;
+
+static uint32_t
+binary_crc32_update(uint32_t crc, const unsigned char *data, size_t len)
+{
+		// a function local static is initialized once, even when
+		// several threads get here at the same time
+	static const struct Crc32Table {
+		uint32_t entry[256];
+		Crc32Table() {
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++) {
+					c = (c & 1) ? (0xEDB88320 ^ (c >> 1)) : (c >> 1);
+				}
+				entry[i] = c;
+			}
+		}
+	} table;
+
+	for (size_t i = 0; i < len; i++) {
+		crc = table.entry[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+static void
+put_binary_varint(std::vector<unsigned char> & buf, uint32_t val)
+{
+	while (val >= 0x80) {
+		buf.push_back((unsigned char)(val | 0x80));
+		val >>= 7;
+	}
+	buf.push_back((unsigned char)val);
+}
+
+// returns false if the varint runs past end or is too long for a uint32_t
+static bool
+get_binary_varint(const unsigned char *& p, const unsigned char *end, uint32_t & val)
+{
+	val = 0;
+	for (int shift = 0; shift < 35 && p < end; shift += 7) {
+		unsigned char ch = *p++;
+		val |= (uint32_t)(ch & 0x7F) << shift;
+		if ( ! (ch & 0x80)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void
+put_binary_uint32(unsigned char *p, uint32_t val)
+{
+	p[0] = (unsigned char)(val);
+	p[1] = (unsigned char)(val >> 8);
+	p[2] = (unsigned char)(val >> 16);
+	p[3] = (unsigned char)(val >> 24);
+}
+
+static uint32_t
+get_binary_uint32(const unsigned char *p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int
+LogRecord::WriteBinary(FILE *fp, BinaryLogCrc *crc)
+{
+	std::vector<std::string> fields;
+	if (WriteBinaryBody(fields) < 0) {
+		return -1;
+	}
+
+		// without a transaction to share a CRC with, the record gets its own
+	BinaryLogCrc own_crc;
+	if ( ! crc) {
+		crc = &own_crc;
+	}
+	bool has_crc;
+	if (op_type == CondorLogOp_BeginTransaction) {
+		crc->in_transaction = true;
+		has_crc = false;
+	} else if (op_type == CondorLogOp_EndTransaction) {
+		crc->in_transaction = false;
+		has_crc = true;
+	} else {
+		has_crc = ! crc->in_transaction;
+	}
+
+	std::vector<unsigned char> body;
+	put_binary_varint(body, ((uint32_t)op_type << 1) | (has_crc ? 1 : 0));
+	for (const auto & field : fields) {
+		if (field.size() > BINARY_RECORD_MAX) {
+			return -1;
+		}
+		put_binary_varint(body, (uint32_t)field.size());
+		body.insert(body.end(), field.begin(), field.end());
+	}
+	if (body.size() > BINARY_RECORD_MAX) {
+		return -1;
+	}
+
+		// build the whole record so that it is written with one fwrite
+	std::vector<unsigned char> buf;
+	buf.reserve(body.size() + 9);
+	put_binary_varint(buf, (uint32_t)body.size());
+	buf.insert(buf.end(), body.begin(), body.end());
+	crc->crc = binary_crc32_update(crc->crc, &buf[0], buf.size());
+	if (has_crc) {
+		size_t len = buf.size();
+		buf.resize(len + 4);
+		put_binary_uint32(&buf[len], crc->crc ^ 0xFFFFFFFF);
+		crc->crc = 0xFFFFFFFF;
+	}
+
+	return (fwrite(&buf[0], 1, buf.size(), fp) < buf.size()) ? -1 : (int)buf.size();
+}
+
+bool
+WriteBinaryLogHeader(FILE *fp)
+{
+	return fwrite(CLASSAD_LOG_BINARY_MAGIC, 1, CLASSAD_LOG_BINARY_MAGIC_LEN, fp) == CLASSAD_LOG_BINARY_MAGIC_LEN;
+}
+
+bool
+ReadBinaryLogHeader(FILE *fp)
+{
+	char magic[CLASSAD_LOG_BINARY_MAGIC_LEN];
+	if (fseek(fp, 0, SEEK_SET) != 0) {
+		return false;
+	}
+	if (fread(magic, 1, sizeof(magic), fp) == sizeof(magic) &&
+		memcmp(magic, CLASSAD_LOG_BINARY_MAGIC, sizeof(magic)) == 0) {
+		return true;
+	}
+	fseek(fp, 0, SEEK_SET);
+	return false;
+}
+
+int
+ReadBinaryLogRecord(FILE *fp, BinaryLogCrc & crc, int & op_type, std::vector<std::string> & fields)
+{
+		// the length of the body, one byte at a time since we don't know how
+		// many bytes it has, and they count towards the CRC like the body.
+	unsigned char hdr[5];
+	size_t cb = 0;
+	uint32_t len = 0;
+	for (;;) {
+		int ch = fgetc(fp);
+		if (ch == EOF) {
+			return cb == 0 && feof(fp) ? 0 : -1;
+		}
+		hdr[cb] = (unsigned char)ch;
+		len |= (uint32_t)(ch & 0x7F) << (7 * cb);
+		cb++;
+		if ( ! (ch & 0x80)) {
+			break;
+		}
+		if (cb == sizeof(hdr)) {
+			return -1;
+		}
+	}
+	if (len == 0 || len > BINARY_RECORD_MAX) {
+		return -1;
+	}
+	std::vector<unsigned char> buf(len);
+	if (fread(&buf[0], 1, len, fp) < len) {
+		return -1;
+	}
+
+	const unsigned char *p = &buf[0];
+	const unsigned char *end = p + len;
+	uint32_t head = 0;
+	bool parsed = get_binary_varint(p, end, head);
+	bool has_crc = parsed && (head & 1);
+
+		// a truncated record leaves crc as it was, so that it can be read
+		// again once the rest of it has been written
+	uint32_t running = binary_crc32_update(crc.crc, hdr, cb);
+	running = binary_crc32_update(running, &buf[0], len);
+	if (has_crc) {
+		unsigned char tail[4];
+		if (fread(tail, 1, sizeof(tail), fp) < sizeof(tail)) {
+			return -1;
+		}
+		bool match = (running ^ 0xFFFFFFFF) == get_binary_uint32(tail);
+		bool checked = crc.synced;
+		crc.Reset(true);
+		if (checked && ! match) {
+			return -2;
+		}
+	} else {
+		crc.crc = running;
+	}
+	if ( ! parsed) {
+		return -2;
+	}
+
+	op_type = (int)(head >> 1);
+	fields.clear();
+	while (p < end) {
+		uint32_t cch = 0;
+		if ( ! get_binary_varint(p, end, cch) || cch > (size_t)(end - p)) {
+			return -2;
+		}
+		fields.emplace_back((const char *)p, cch);
+		p += cch;
+	}
+	return 1;
+}
+
 int
 LogRecord::Read(FILE *fp)
 {
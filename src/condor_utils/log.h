@@ -23,6 +23,7 @@
 #include "condor_common.h"
 #include "condor_classad.h"
 #include <string>
+#include <vector>
 using std::string;
 
 /* 
@@ -35,6 +36,22 @@ using std::string;
    log.  The Play() method is defined to perform the operation on
    the data structure passed in as an argument.  The argument is of
    type (void *) for generality.
+
+   A log may instead be written in a binary format (see CLASSAD_LOG_BINARY),
+   which begins with the CLASSAD_LOG_BINARY_MAGIC bytes.  Each binary
+   record is the length of its body followed by the body: the op_type
+   shifted left by one, with the low bit set if the record carries a CRC,
+   and then each field of the body as a length followed by that many
+   bytes.  The fields are the words that WriteBody writes for the ascii
+   format, and they can hold any characters, so no field needs to be
+   parsed or escaped when it is read back.  The lengths and the op_type
+   are unsigned LEB128 varints.
+
+   A record that carries a CRC is followed by the 4 byte little-endian
+   CRC-32 of every record since the previous record that carried one,
+   not counting the CRC's themselves.  The records of a transaction share
+   the CRC that follows its EndTransaction record, and every record that
+   is written outside of a transaction carries its own.
 */
 
 #define CondorLogOp_NewClassAd			101
@@ -46,6 +63,23 @@ using std::string;
 #define CondorLogOp_LogHistoricalSequenceNumber 107
 #define CondorLogOp_Error               999
 
+#define CLASSAD_LOG_BINARY_MAGIC		"\0CALog\x02\n"
+#define CLASSAD_LOG_BINARY_MAGIC_LEN	8
+
+// The running CRC-32 of the records of a binary log since the last record
+// that carried a CRC.  A writer passes one to each WriteBinary() of a
+// transaction, and a reader passes the same one to each ReadBinaryLogRecord().
+// A reader that starts somewhere other than the beginning of the log or the
+// end of a record that carried a CRC can't check the first CRC it reads.
+struct BinaryLogCrc {
+	explicit BinaryLogCrc(bool synced_arg = true) { Reset(synced_arg); }
+	void Reset(bool synced_arg) { crc = 0xFFFFFFFF; in_transaction = false; synced = synced_arg; }
+
+	uint32_t crc;
+	bool in_transaction;	// writer: a BeginTransaction has been written
+	bool synced;			// reader: crc covers all records since the last CRC
+};
+
 class LogRecord {
 public:
 	
@@ -54,10 +88,13 @@ public:
 	int get_op_type() const { return op_type; }
 
 	int Write(FILE *fp);
+	int WriteBinary(FILE *fp, BinaryLogCrc *crc = NULL);
+	int Write(FILE *fp, bool binary, BinaryLogCrc *crc = NULL) { return binary ? WriteBinary(fp, crc) : Write(fp); }
 	int Read(FILE *fp);
 	int ReadHeader(FILE *fp);
 	virtual int ReadBody(FILE *) { return 0; }
 	int ReadTail(FILE *fp);
+	virtual int ReadBinaryBody(const std::vector<std::string> & /*fields*/) { return 0; }
 
 	virtual int Play(void *) { return 0; }
 
@@ -73,6 +110,7 @@ private:
 	int WriteHeader(FILE *fp) const;
 	virtual int WriteBody(FILE *) { return 0; }
 	int WriteTail(FILE *fp);
+	virtual int WriteBinaryBody(std::vector<std::string> & /*fields*/) { return 0; }
 };
 
 class ConstructLogEntry
@@ -87,6 +125,19 @@ LogRecord *ReadLogEntry(FILE* fp, unsigned long recnum, LogRecord* (*Instantiate
 
 bool valid_record_optype(int optype);
 
+// Write the magic bytes that begin a binary log.
+bool WriteBinaryLogHeader(FILE *fp);
+
+// Check whether the file begins with the magic bytes of a binary log.  If it
+// does, fp is left just after them, otherwise fp is left at the beginning.
+bool ReadBinaryLogHeader(FILE *fp);
+
+// Read the next record of a binary log.  Returns 1 on success, 0 at the
+// end of the file, -1 if the record is truncated or so damaged that the
+// records after it cannot be found, and -2 if the record failed its CRC
+// or could not be parsed but fp was left at the start of the next record.
+int ReadBinaryLogRecord(FILE *fp, BinaryLogCrc & crc, int & op_type, std::vector<std::string> & fields);
+
 class LogRecordError : public LogRecord {
     public:
     LogRecordError() : LogRecord(), body() {
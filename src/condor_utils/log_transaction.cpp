@@ -52,7 +52,7 @@ Transaction::~Transaction()
 }
 
 void
-Transaction::Commit(FILE* fp, const char *filename, LoggableClassAdTable *data_structure, bool nondurable)
+Transaction::Commit(FILE* fp, const char *filename, LoggableClassAdTable *data_structure, bool nondurable, bool binary)
 {
 	LogRecord *log;
 	int fd;
@@ -69,9 +69,13 @@ Transaction::Commit(FILE* fp, const char *filename, LoggableClassAdTable *data_s
 		// narrow down the cause
 	time_t before, after;
 
+		// in the binary format, the records share the CRC that follows
+		// the EndTransaction record
+	BinaryLogCrc crc;
+
 	while( (log = ordered_op_log.Next()) ) {
 		if ( fp != NULL ) {
-			if ( log->Write( fp ) < 0 ) {
+			if ( log->Write( fp, binary, &crc ) < 0 ) {
 				EXCEPT( "write to %s failed, errno = %d", filename, errno );
 			}
 		}
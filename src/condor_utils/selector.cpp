@@ -49,6 +49,32 @@ int poll(struct fake_pollfd *, int, int)
 
 int Selector::_fd_select_size = -1;
 
+#ifdef SELECTOR_USE_EPOLL
+std::vector<Selector *> Selector::_persistent_selectors;
+
+static inline unsigned char
+io_bit( Selector::IO_FUNC interest )
+{
+	return (unsigned char)( 1 << interest );
+}
+
+static void
+epoll_event_for( int fd, unsigned int generation, unsigned char want, struct epoll_event &ev )
+{
+	memset( &ev, 0, sizeof(ev) );
+	ev.data.u64 = ( (uint64_t)generation << 32 ) | (uint32_t)fd;
+	if ( want & io_bit( Selector::IO_READ ) ) {
+		ev.events |= EPOLLIN;
+	}
+	if ( want & io_bit( Selector::IO_WRITE ) ) {
+		ev.events |= EPOLLOUT;
+	}
+	if ( want & io_bit( Selector::IO_EXCEPT ) ) {
+		ev.events |= EPOLLPRI;
+	}
+}
+#endif
+
 Selector::Selector()
 {
 #if defined(WIN32)
@@ -71,11 +97,17 @@ Selector::Selector()
 	save_write_fds = NULL;
 	save_except_fds = NULL;
 
+#ifdef SELECTOR_USE_EPOLL
+	m_epoll_fd = -1;
+	m_epoll_pid = 0;
+#endif
+
 	reset();
 }
 
 Selector::~Selector()
 {
+	set_persistent( false );
 	free( read_fds );
 }
 
@@ -120,6 +152,17 @@ Selector::reset()
 	timeout_wanted = false;
 	timeout.tv_sec = timeout.tv_usec = 0;
 
+#ifdef SELECTOR_USE_EPOLL
+	for ( size_t i = 0; i < m_want_fds.size(); i++ ) {
+		m_want[m_want_fds[i]] = 0;
+	}
+	m_want_fds.clear();
+	for ( size_t i = 0; i < m_ready_fds.size(); i++ ) {
+		m_ready[m_ready_fds[i]] = 0;
+	}
+	m_ready_fds.clear();
+#endif
+
 	max_fd = -1;
 	if ( save_read_fds != NULL ) {
 #if defined(WIN32)
@@ -223,6 +266,22 @@ Selector::add_fd( int fd, IO_FUNC interest )
 		free(fd_description);
 	}
 
+#ifdef SELECTOR_USE_EPOLL
+	if ( m_epoll_fd != -1 ) {
+		if ( fd >= (int)m_want.size() ) {
+			m_want.resize( fd + 1, 0 );
+			m_registered.resize( fd + 1, 0 );
+			m_ready.resize( fd + 1, 0 );
+			m_generation.resize( fd + 1, 0 );
+		}
+		if ( !m_want[fd] ) {
+			m_want_fds.push_back( fd );
+		}
+		m_want[fd] |= io_bit( interest );
+		return;
+	}
+#endif
+
 	if ((m_single_shot == SINGLE_SHOT_OK) && (m_poll.fd != fd)) {
 		init_fd_sets();
 		m_single_shot = SINGLE_SHOT_SKIP;
@@ -287,6 +346,15 @@ Selector::delete_fd( int fd, IO_FUNC interest )
 	}
 #endif
 
+#ifdef SELECTOR_USE_EPOLL
+	if ( m_epoll_fd != -1 ) {
+		if ( fd < (int)m_want.size() ) {
+			m_want[fd] &= ~io_bit( interest );
+		}
+		return;
+	}
+#endif
+
 	init_fd_sets();
 	m_single_shot = SINGLE_SHOT_SKIP;
 
@@ -341,12 +409,6 @@ Selector::execute()
 	struct timeval timeout_copy;
 	struct timeval	*tp;
 
-	if ( m_single_shot == SINGLE_SHOT_SKIP ) {
-		memcpy( read_fds, save_read_fds, fd_set_size * sizeof(fd_set) );
-		memcpy( write_fds, save_write_fds, fd_set_size * sizeof(fd_set) );
-		memcpy( except_fds, save_except_fds, fd_set_size * sizeof(fd_set) );
-	}
-
 	if( timeout_wanted ) {
 		timeout_copy = timeout;
 		tp = &timeout_copy;
@@ -354,6 +416,19 @@ Selector::execute()
 		tp = NULL;
 	}
 
+#ifdef SELECTOR_USE_EPOLL
+	if ( m_epoll_fd != -1 ) {
+		epoll_execute( tp );
+		return;
+	}
+#endif
+
+	if ( m_single_shot == SINGLE_SHOT_SKIP ) {
+		memcpy( read_fds, save_read_fds, fd_set_size * sizeof(fd_set) );
+		memcpy( write_fds, save_write_fds, fd_set_size * sizeof(fd_set) );
+		memcpy( except_fds, save_except_fds, fd_set_size * sizeof(fd_set) );
+	}
+
 		// select() ignores its first argument on Windows. We still track
 		// max_fd for the display() functions.
 	start_thread_safe("select");
@@ -392,6 +467,332 @@ Selector::execute()
 	return;
 }
 
+#ifdef SELECTOR_USE_EPOLL
+void
+Selector::epoll_execute( struct timeval *tp )
+{
+	struct epoll_event ev;
+	memset( &ev, 0, sizeof(ev) );
+
+		// Stop watching the fds nobody asked for since reset().
+	size_t kept = 0;
+	for ( size_t i = 0; i < m_registered_fds.size(); i++ ) {
+		int fd = m_registered_fds[i];
+		if ( !m_registered[fd] ) {
+			continue;	// dropped by fd_closing()
+		}
+		if ( !m_want[fd] ) {
+			epoll_ctl( m_epoll_fd, EPOLL_CTL_DEL, fd, &ev );
+			m_registered[fd] = 0;
+			continue;
+		}
+		m_registered_fds[kept++] = fd;
+	}
+	m_registered_fds.resize( kept );
+
+		// Register the new ones, and the ones whose interest changed.
+	for ( size_t i = 0; i < m_want_fds.size(); i++ ) {
+		int fd = m_want_fds[i];
+		unsigned char want = m_want[fd];
+		if ( !want || want == m_registered[fd] ) {
+			continue;
+		}
+
+		epoll_event_for( fd, m_generation[fd], want, ev );
+		int rc = epoll_ctl( m_epoll_fd, m_registered[fd] ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev );
+		if ( rc < 0 && errno == ENOENT ) {
+				// closed and reused without a call to fd_closing()
+			rc = epoll_ctl( m_epoll_fd, EPOLL_CTL_ADD, fd, &ev );
+		} else if ( rc < 0 && errno == EEXIST ) {
+			rc = epoll_ctl( m_epoll_fd, EPOLL_CTL_MOD, fd, &ev );
+		}
+		if ( rc < 0 ) {
+			_select_errno = errno;
+			_select_retval = -1;
+			dprintf( D_ALWAYS, "Selector: failed to watch fd %d: %s\n",
+					 fd, strerror( _select_errno ) );
+			state = FAILED;
+			return;
+		}
+
+		if ( !m_registered[fd] ) {
+			m_registered_fds.push_back( fd );
+		}
+		m_registered[fd] = want;
+	}
+
+	for ( size_t i = 0; i < m_ready_fds.size(); i++ ) {
+		m_ready[m_ready_fds[i]] = 0;
+	}
+	m_ready_fds.clear();
+
+	int timeout_ms = -1;
+	if ( tp ) {
+		long long ms = (long long)tp->tv_sec * 1000 + ( tp->tv_usec + 999 ) / 1000;
+		timeout_ms = ms > INT_MAX ? INT_MAX : (int)ms;
+	}
+	struct timeval begin;
+	gettimeofday( &begin, NULL );
+
+	m_events.resize( m_registered_fds.empty() ? 1 : m_registered_fds.size() );
+
+		// Wait again if all we got were the events of fds that are not
+		// ours any more.
+	for (;;) {
+		start_thread_safe("select");
+		int nfds = epoll_wait( m_epoll_fd, &m_events[0], (int)m_events.size(), timeout_ms );
+		_select_errno = errno;
+		stop_thread_safe("select");
+		_select_retval = nfds;
+
+		if( nfds < 0 ) {
+			state = ( _select_errno == EINTR ) ? SIGNALLED : FAILED;
+			return;
+		}
+		_select_errno = 0;
+		if ( nfds == 0 ) {
+			state = TIMED_OUT;
+			return;
+		}
+
+			// Report readiness the way select() would: an error or hangup
+			// makes an fd readable and writable, and only the interest it
+			// was registered for is reported.
+		bool stale = false;
+		for ( int i = 0; i < nfds; i++ ) {
+			int fd = (int)(uint32_t)m_events[i].data.u64;
+			unsigned int generation = (unsigned int)( m_events[i].data.u64 >> 32 );
+			if ( fd < 0 || fd >= (int)m_registered.size() ||
+				 !m_registered[fd] || generation != m_generation[fd] )
+			{
+					// The kernel still watches a file we dropped, which
+					// happens when an fd is closed without a call to
+					// fd_closing() while a forked child holds a copy of
+					// it.  If the fd is not in use, dropping it from the
+					// set works; otherwise the number now refers to
+					// another file and the only way to get rid of the
+					// old one is to start the set over.
+				if ( fd >= 0 && fd < (int)m_registered.size() && !m_registered[fd] &&
+					 epoll_ctl( m_epoll_fd, EPOLL_CTL_DEL, fd, &ev ) == 0 )
+				{
+					dprintf( D_FULLDEBUG, "Selector: dropped stale fd %d\n", fd );
+				} else {
+					stale = true;
+				}
+				continue;
+			}
+			uint32_t events = m_events[i].events;
+			unsigned char ready = 0;
+			if ( events & ( EPOLLIN | EPOLLHUP | EPOLLERR ) ) {
+				ready |= io_bit( IO_READ );
+			}
+			if ( events & ( EPOLLOUT | EPOLLHUP | EPOLLERR ) ) {
+				ready |= io_bit( IO_WRITE );
+			}
+			if ( events & ( EPOLLPRI | EPOLLERR ) ) {
+				ready |= io_bit( IO_EXCEPT );
+			}
+			ready &= m_registered[fd];
+			if ( ready ) {
+				m_ready[fd] = ready;
+				m_ready_fds.push_back( fd );
+			}
+		}
+
+		if ( stale && !epoll_rebuild() ) {
+			_select_errno = errno;
+			_select_retval = -1;
+			state = FAILED;
+			return;
+		}
+		_select_retval = (int)m_ready_fds.size();
+		if ( !m_ready_fds.empty() ) {
+			state = FDS_READY;
+			return;
+		}
+
+		if ( timeout_ms > 0 ) {
+			struct timeval now;
+			gettimeofday( &now, NULL );
+			long long elapsed_ms = ( now.tv_sec - begin.tv_sec ) * 1000LL +
+				( now.tv_usec - begin.tv_usec ) / 1000;
+			timeout_ms = elapsed_ms >= timeout_ms ? 0 : timeout_ms - (int)elapsed_ms;
+			begin = now;
+		}
+	}
+}
+
+// Replaces the epoll set with a new one that has just the fds we mean
+// to watch.  An fd that can't be added back was closed without a call
+// to fd_closing(); it is left out, and the next execute() adds it again
+// if it is still wanted, failing as select() would.
+bool
+Selector::epoll_rebuild()
+{
+	int epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+	if ( epoll_fd < 0 ) {
+		dprintf( D_ALWAYS, "Selector: epoll_create1() failed: %s\n",
+				 strerror( errno ) );
+		return false;
+	}
+	close( m_epoll_fd );
+	m_epoll_fd = epoll_fd;
+	m_epoll_pid = getpid();
+
+	size_t kept = 0;
+	for ( size_t i = 0; i < m_registered_fds.size(); i++ ) {
+		int fd = m_registered_fds[i];
+		if ( !m_registered[fd] ) {
+			continue;
+		}
+		struct epoll_event ev;
+		epoll_event_for( fd, m_generation[fd], m_registered[fd], ev );
+		if ( epoll_ctl( m_epoll_fd, EPOLL_CTL_ADD, fd, &ev ) < 0 ) {
+			dprintf( D_FULLDEBUG, "Selector: not watching fd %d again: %s\n",
+					 fd, strerror( errno ) );
+			m_registered[fd] = 0;
+			continue;
+		}
+		m_registered_fds[kept++] = fd;
+	}
+	m_registered_fds.resize( kept );
+	dprintf( D_FULLDEBUG, "Selector: rebuilt the epoll set with %d fds\n", (int)kept );
+	return true;
+}
+
+void
+Selector::epoll_display()
+{
+	dprintf( D_ALWAYS, "Watched FD's {" );
+	for ( size_t i = 0; i < m_registered_fds.size(); i++ ) {
+		int fd = m_registered_fds[i];
+		if ( m_registered[fd] ) {
+			dprintf( D_ALWAYS | D_NOHEADER, "%d%s%s%s ", fd,
+					 ( m_registered[fd] & io_bit( IO_READ ) ) ? "r" : "",
+					 ( m_registered[fd] & io_bit( IO_WRITE ) ) ? "w" : "",
+					 ( m_registered[fd] & io_bit( IO_EXCEPT ) ) ? "e" : "" );
+		}
+	}
+	dprintf( D_ALWAYS | D_NOHEADER, "} = %d\n", (int)m_registered_fds.size() );
+
+	if( state == FDS_READY ) {
+		dprintf( D_ALWAYS, "Ready FD's {" );
+		for ( size_t i = 0; i < m_ready_fds.size(); i++ ) {
+			int fd = m_ready_fds[i];
+			dprintf( D_ALWAYS | D_NOHEADER, "%d%s%s%s ", fd,
+					 ( m_ready[fd] & io_bit( IO_READ ) ) ? "r" : "",
+					 ( m_ready[fd] & io_bit( IO_WRITE ) ) ? "w" : "",
+					 ( m_ready[fd] & io_bit( IO_EXCEPT ) ) ? "e" : "" );
+		}
+		dprintf( D_ALWAYS | D_NOHEADER, "} = %d\n", (int)m_ready_fds.size() );
+	}
+}
+#endif
+
+bool
+Selector::set_persistent( bool persistent )
+{
+#ifdef SELECTOR_USE_EPOLL
+	if ( persistent == ( m_epoll_fd != -1 ) ) {
+		return true;
+	}
+
+	if ( persistent ) {
+		m_epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+		if ( m_epoll_fd < 0 ) {
+			dprintf( D_ALWAYS, "Selector: epoll_create1() failed: %s\n",
+					 strerror( errno ) );
+			m_epoll_fd = -1;
+			return false;
+		}
+		m_epoll_pid = getpid();
+		_persistent_selectors.push_back( this );
+	} else {
+		close( m_epoll_fd );
+		m_epoll_fd = -1;
+		for ( size_t i = 0; i < _persistent_selectors.size(); i++ ) {
+			if ( _persistent_selectors[i] == this ) {
+				_persistent_selectors.erase( _persistent_selectors.begin() + i );
+				break;
+			}
+		}
+		m_want.clear();
+		m_registered.clear();
+		m_ready.clear();
+		m_generation.clear();
+		m_want_fds.clear();
+		m_registered_fds.clear();
+		m_ready_fds.clear();
+		m_events.clear();
+	}
+	reset();
+	return true;
+#else
+	return !persistent;
+#endif
+}
+
+bool
+Selector::is_persistent() const
+{
+#ifdef SELECTOR_USE_EPOLL
+	return m_epoll_fd != -1;
+#else
+	return false;
+#endif
+}
+
+const std::vector<int> &
+Selector::ready_fds() const
+{
+#ifdef SELECTOR_USE_EPOLL
+	return m_ready_fds;
+#else
+	static const std::vector<int> none;
+	return none;
+#endif
+}
+
+void
+Selector::fd_closing( int fd )
+{
+#ifdef SELECTOR_USE_EPOLL
+	if ( _persistent_selectors.empty() || fd < 0 ) {
+		return;
+	}
+
+	pid_t pid = getpid();
+	for ( size_t i = 0; i < _persistent_selectors.size(); i++ ) {
+		Selector *s = _persistent_selectors[i];
+			// A forked child shares its parent's epoll set, so it must
+			// leave the registrations alone.
+		if ( s->m_epoll_pid != pid || fd >= (int)s->m_registered.size() ) {
+			continue;
+		}
+		if ( s->m_registered[fd] ) {
+			struct epoll_event ev;
+			memset( &ev, 0, sizeof(ev) );
+			epoll_ctl( s->m_epoll_fd, EPOLL_CTL_DEL, fd, &ev );
+			s->m_registered[fd] = 0;
+		}
+		s->m_ready[fd] = 0;
+		s->m_generation[fd]++;
+	}
+#else
+	(void)fd;
+#endif
+}
+
+void
+Selector::fd_opened( int fd )
+{
+		// Dropping the registration does what we need: if the fd still
+		// refers to the file that was registered, EPOLL_CTL_DEL removes
+		// it, and otherwise the DEL fails harmlessly.  Either way the
+		// next execute() does EPOLL_CTL_ADD for the file it refers to now.
+	fd_closing( fd );
+}
+
 int
 Selector::select_retval() const
 {
@@ -421,6 +822,17 @@ Selector::fd_ready( int fd, IO_FUNC interest )
 	}
 #endif
 
+#ifdef SELECTOR_USE_EPOLL
+	if ( m_epoll_fd != -1 ) {
+		return fd < (int)m_ready.size() && ( m_ready[fd] & io_bit( interest ) );
+	}
+#endif
+
+		// with a single fd, we poll()ed just that one
+	if ( SINGLE_SHOT_SKIP != m_single_shot && fd != m_poll.fd ) {
+		return false;
+	}
+
 	switch( interest ) {
 
 	  case IO_READ:
@@ -472,7 +884,9 @@ Selector::display()
 	//   poll() is used to query a single fd. Currently, it's only
 	//   called in DaemonCore::Driver(), where we should always be
 	//   in select() mode.
-	init_fd_sets();
+	if ( !is_persistent() ) {
+		init_fd_sets();
+	}
 
 	switch( state ) {
 
@@ -499,18 +913,26 @@ Selector::display()
 
 	dprintf( D_ALWAYS, "max_fd = %d\n", max_fd );
 
-	dprintf( D_ALWAYS, "Selection FD's\n" );
-	bool try_dup = ( (FAILED == state) &&  (EBADF == _select_errno) );
-	display_fd_set( "\tRead", save_read_fds, max_fd, try_dup );
-	display_fd_set( "\tWrite", save_write_fds, max_fd, try_dup );
-	display_fd_set( "\tExcept", save_except_fds, max_fd, try_dup );
-
-	if( state == FDS_READY ) {
-		dprintf( D_ALWAYS, "Ready FD's\n" );
-		display_fd_set( "\tRead", read_fds, max_fd );
-		display_fd_set( "\tWrite", write_fds, max_fd );
-		display_fd_set( "\tExcept", except_fds, max_fd );
+#ifdef SELECTOR_USE_EPOLL
+	if ( is_persistent() ) {
+		epoll_display();
+	} else
+#endif
+	{
+		dprintf( D_ALWAYS, "Selection FD's\n" );
+		bool try_dup = ( (FAILED == state) &&  (EBADF == _select_errno) );
+		display_fd_set( "\tRead", save_read_fds, max_fd, try_dup );
+		display_fd_set( "\tWrite", save_write_fds, max_fd, try_dup );
+		display_fd_set( "\tExcept", save_except_fds, max_fd, try_dup );
+
+		if( state == FDS_READY ) {
+			dprintf( D_ALWAYS, "Ready FD's\n" );
+			display_fd_set( "\tRead", read_fds, max_fd );
+			display_fd_set( "\tWrite", write_fds, max_fd );
+			display_fd_set( "\tExcept", except_fds, max_fd );
+		}
 	}
+
 	if( timeout_wanted ) {
 		dprintf( D_ALWAYS,
 			"Timeout = %ld.%06ld seconds\n", (long) timeout.tv_sec, 
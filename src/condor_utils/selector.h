@@ -27,6 +27,15 @@
 #define SELECTOR_USE_POLL 1
 #endif
 
+#if defined(LINUX)
+#define SELECTOR_USE_EPOLL 1
+#endif
+
+#ifdef SELECTOR_USE_EPOLL
+#include <sys/epoll.h>
+#endif
+#include <vector>
+
 #ifdef SELECTOR_USE_POLL
 #include <poll.h>
 #else
@@ -69,9 +78,43 @@ public:
 	bool fd_ready( int fd, IO_FUNC interest );
 	void display();
 
+		// In persistent mode, the descriptors stay registered with the
+		// kernel from one execute() to the next, and execute() only
+		// tells the kernel about the ones that were added or dropped
+		// since the last call.  Its cost then depends on the number of
+		// changes and of ready descriptors, not on the number of
+		// descriptors watched.  Callers still add all the descriptors
+		// they want after each reset().  Readiness is level-triggered,
+		// as with select().  Only available on Linux (epoll); returns
+		// false if persistent mode could not be turned on.
+	bool set_persistent( bool persistent );
+	bool is_persistent() const;
+
+		// In persistent mode, the descriptors that execute() found ready,
+		// so that callers can look at those alone.  Empty otherwise.
+	const std::vector<int> &ready_fds() const;
+
+		// Call before closing a descriptor that may be watched by a
+		// persistent Selector.  Otherwise the kernel keeps reporting
+		// events for it as long as a forked child holds a copy, and
+		// the Selector can miss a new descriptor that reuses its number.
+	static void fd_closing( int fd );
+
+		// Call when a descriptor that may be watched by a persistent
+		// Selector was just created or handed to a new owner.  Its
+		// number may have been reused without a call to fd_closing(),
+		// and the kernel dropped the old file from the epoll set when it
+		// was closed, so the next execute() registers it again.
+	static void fd_opened( int fd );
+
 private:
 
 	void init_fd_sets();
+#ifdef SELECTOR_USE_EPOLL
+	void epoll_execute( struct timeval *tp );
+	bool epoll_rebuild();
+	void epoll_display();
+#endif
 
 	enum SINGLE_SHOT {
 		SINGLE_SHOT_VIRGIN, SINGLE_SHOT_OK, SINGLE_SHOT_SKIP
@@ -95,6 +138,25 @@ private:
 #else
 	struct fake_pollfd m_poll;
 #endif
+
+#ifdef SELECTOR_USE_EPOLL
+	int		m_epoll_fd;
+	pid_t	m_epoll_pid;
+		// IO_FUNC bits per fd: wanted since reset(), registered with
+		// the kernel, and ready after execute()
+	std::vector<unsigned char> m_want;
+	std::vector<unsigned char> m_registered;
+	std::vector<unsigned char> m_ready;
+		// bumped by fd_closing(), and passed to the kernel along with the
+		// fd, so that execute() can tell the events of a file that was
+		// closed from those of the one that reused its number
+	std::vector<unsigned int> m_generation;
+	std::vector<int> m_want_fds;
+	std::vector<int> m_registered_fds;
+	std::vector<int> m_ready_fds;
+	std::vector<struct epoll_event> m_events;
+	static std::vector<Selector *> _persistent_selectors;
+#endif
 };
 
 void display_fd_set( const char *msg, fd_set *set, int max,
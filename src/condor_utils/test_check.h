@@ -0,0 +1,131 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+#ifndef _TEST_CHECK_H
+#define _TEST_CHECK_H
+
+// Checks for the stand-alone test_* programs that are registered with
+// condor_exe_test().  Each check prints "ok <name>" to stdout or
+// "FAILED <name>" to stderr and counts the failures, and main() ends with
+//
+//     return check_results();
+//
+// which prints a summary and returns the exit code for ctest.
+
+#include "condor_header_features.h"
+#include "safe_fopen.h"
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string>
+
+inline int &
+check_failure_count()
+{
+	static int failures = 0;
+	return failures;
+}
+
+inline void
+check_failed( const char *fmt, ... ) CHECK_PRINTF_FORMAT(1,2);
+
+// Reports a failed check, the message is formatted as by printf.
+inline void
+check_failed( const char *fmt, ... )
+{
+	va_list args;
+	va_start( args, fmt );
+	fputs( "FAILED ", stderr );
+	vfprintf( stderr, fmt, args );
+	fputc( '\n', stderr );
+	va_end( args );
+	check_failure_count()++;
+}
+
+inline void
+check_passed( const char *fmt, ... ) CHECK_PRINTF_FORMAT(1,2);
+
+// Reports a passed check, the message is formatted as by printf.
+inline void
+check_passed( const char *fmt, ... )
+{
+	va_list args;
+	va_start( args, fmt );
+	fputs( "ok ", stdout );
+	vprintf( fmt, args );
+	fputc( '\n', stdout );
+	va_end( args );
+}
+
+// Reports a check that passed if ok is true, returns ok.
+inline bool
+check( const std::string &name, bool ok )
+{
+	if ( ok ) {
+		check_passed( "%s", name.c_str() );
+	} else {
+		check_failed( "%s", name.c_str() );
+	}
+	return ok;
+}
+
+// Prints how many checks failed, returns the exit code of the test.
+inline int
+check_results()
+{
+	int failures = check_failure_count();
+	if ( failures ) {
+		fprintf( stderr, "%d tests FAILED\n", failures );
+		return 1;
+	}
+	printf( "all tests passed\n" );
+	return 0;
+}
+
+// Replaces the contents of a file, returns false if it can't be written.
+inline bool
+write_test_file( const char *filename, const std::string &data )
+{
+	FILE *fp = safe_fopen_wrapper_follow( filename, "w" );
+	if ( ! fp ) {
+		fprintf( stderr, "cannot create %s, errno = %d\n", filename, errno );
+		return false;
+	}
+	bool ok = fwrite( data.data(), 1, data.size(), fp ) == data.size();
+	return fclose( fp ) == 0 && ok;
+}
+
+// Returns the contents of a file, or an empty string if it can't be read.
+inline std::string
+read_test_file( const char *filename )
+{
+	std::string data;
+	FILE *fp = safe_fopen_wrapper_follow( filename, "r" );
+	if ( fp ) {
+		char buf[4096];
+		size_t cb;
+		while ( (cb = fread( buf, 1, sizeof(buf), fp )) > 0 ) {
+			data.append( buf, cb );
+		}
+		fclose( fp );
+	}
+	return data;
+}
+
+#endif
@@ -0,0 +1,443 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for the binary format of ClassAd logs (see CLASSAD_LOG_BINARY).
+// Converts an ascii log to the binary format and back and checks that
+// nothing changed, then loads binary logs whose last transaction was cut
+// short or had a byte changed, and checks that the CRC of the transaction
+// keeps the damaged records out of the loaded ads.  Then, as a restart
+// benchmark, writes a job queue log of synthetic jobs, loads it in each
+// format the way the schedd does when it starts, checks that both give
+// the same ads, and reports the size of each log and how long it took
+// to load.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "classad_log.h"
+#include "utc_time.h"
+#include "test_check.h"
+
+#include <stdio.h>
+#include <string>
+#include <map>
+
+static const char *log_file = "test_classad_log_binary.log";
+static const char *binary_file = "test_classad_log_binary.bin";
+static const char *ascii_file = "test_classad_log_binary.txt";
+
+// the first record, a committed transaction and a record outside of a transaction
+static const char *log_head =
+	"107 3 CreationTimestamp 1234\n"
+	"105 \n"
+	"101 1.0 Job Machine\n"
+	"103 1.0 Owner \"alice\"\n"
+	"103 1.0 Args \"-a b  \\\"c d\\\"\"\n"
+	"106 \n"
+	"103 1.0 JobStatus 1\n";
+// the last transaction, which the tests damage
+static const char *log_tail =
+	"105 \n"
+	"101 2.0 Job Machine\n"
+	"103 2.0 Owner \"bob\"\n"
+	"103 1.0 JobStatus 2\n"
+	"106 \n";
+
+// Converts the ascii log to the binary format, returns the size of the
+// binary log, or -1 if the conversion failed.
+static long long
+convert( const std::string &ascii )
+{
+	unsigned long records = 0;
+	MyString errmsg;
+	write_test_file( log_file, ascii );
+	if ( ! ConvertClassAdLog( log_file, binary_file, true, records, errmsg ) ) {
+		errmsg.chomp();
+		check_failed( "binary conversion: %s", errmsg.Value() );
+		return -1;
+	}
+	return (long long)read_test_file( binary_file ).size();
+}
+
+// Loads the log the way a daemon does, and checks the JobStatus of job 1.0
+// and whether job 2.0 exists.  A job_status of 0 means that JobStatus is
+// expected to be undefined.
+static void
+check_load( const char *name, const char *filename, int job_status, bool expect_job2 )
+{
+	HashTable<std::string, ClassAd*> table( hashFunction );
+	ClassAdLogTable<std::string, ClassAd*> la( table );
+	unsigned long seq = 0;
+	time_t birthdate = 0;
+	bool is_clean, requires_successful_cleaning, binary;
+	MyString errmsg;
+
+	FILE *fp = LoadClassAdLog( filename, la, DefaultMakeClassAdLogTableEntry,
+		seq, birthdate, is_clean, requires_successful_cleaning, binary, errmsg );
+	if ( ! fp ) {
+		errmsg.chomp();
+		check_failed( "%s: %s", name, errmsg.Value() );
+		return;
+	}
+	fclose( fp );
+
+	ClassAd *ad = NULL;
+	int status = 0;
+	std::string owner;
+	bool has_job2 = table.lookup( "2.0", ad ) == 0;
+	if ( table.lookup( "1.0", ad ) != 0 ) {
+		check_failed( "%s: job 1.0 is missing", name );
+	} else if ( ! ad->LookupString( "Owner", owner ) || owner != "alice" ) {
+		check_failed( "%s: job 1.0 has Owner '%s'", name, owner.c_str() );
+	} else if ( (ad->LookupInteger( "JobStatus", status ) ? status : 0) != job_status ) {
+		check_failed( "%s: job 1.0 has JobStatus %d, expected %d", name, status, job_status );
+	} else if ( has_job2 != expect_job2 ) {
+		check_failed( "%s: job 2.0 %s", name, has_job2 ? "was loaded" : "is missing" );
+	} else if ( seq != 3 || birthdate != 1234 || ! binary ) {
+		check_failed( "%s: sequence %lu, birthdate %ld, %s format",
+			name, seq, (long)birthdate, binary ? "binary" : "ascii" );
+	} else {
+		check_passed( "%s", name );
+	}
+
+	std::string key;
+	table.startIterations();
+	while ( table.iterate( key, ad ) == 1 ) {
+		delete ad;
+	}
+}
+
+// Changes the first byte of the given text in the binary log.
+static bool
+corrupt( const std::string &binary, const char *text )
+{
+	std::string data = binary;
+	size_t pos = data.find( text );
+	if ( pos == std::string::npos ) {
+		check_failed( "corrupt: no %s in the binary log", text );
+		return false;
+	}
+	data[pos] ^= 0x20;
+	return write_test_file( binary_file, data );
+}
+
+static void
+test_round_trip()
+{
+	std::string ascii = std::string( log_head ) + log_tail;
+	long long binary_size = convert( ascii );
+	if ( binary_size < 0 ) {
+		return;
+	}
+	unsigned long records = 0;
+	MyString errmsg;
+	if ( ! ConvertClassAdLog( binary_file, ascii_file, false, records, errmsg ) ) {
+		errmsg.chomp();
+		check_failed( "round trip: %s", errmsg.Value() );
+		return;
+	}
+	if ( read_test_file( ascii_file ) != ascii || records != 12 || ! errmsg.empty() ) {
+		check_failed( "round trip: %lu records, %s\n%s", records, errmsg.Value(),
+			read_test_file( ascii_file ).c_str() );
+	} else {
+		check_passed( "round trip, %d bytes ascii, %lld bytes binary", (int)ascii.size(), binary_size );
+	}
+
+	check_load( "load binary log", binary_file, 2, true );
+}
+
+static void
+test_truncated()
+{
+	long long head_end = convert( log_head );
+	long long both_end = convert( std::string( log_head ) + log_tail );
+	if ( head_end < 0 || both_end < 0 ) {
+		return;
+	}
+
+		// cut the last transaction off part of the way through each of its records
+	for ( long long cut = 1; cut < both_end - head_end; cut += 3 ) {
+		convert( std::string( log_head ) + log_tail );
+		if ( truncate( binary_file, both_end - cut ) != 0 ) {
+			check_failed( "truncate: errno = %d", errno );
+			return;
+		}
+		std::string name = "binary log cut " + std::to_string( cut ) + " bytes short";
+		check_load( name.c_str(), binary_file, 1, false );
+	}
+}
+
+static void
+test_corrupt()
+{
+	convert( std::string( log_head ) + log_tail );
+	std::string binary = read_test_file( binary_file );
+
+		// the records of the last transaction parse, only the CRC that
+		// follows its end can tell that one of them was changed
+	if ( corrupt( binary, "bob" ) ) {
+		check_load( "changed a value in the last transaction", binary_file, 1, false );
+	}
+	if ( corrupt( binary, "2.0" ) ) {
+		check_load( "changed a key in the last transaction", binary_file, 1, false );
+	}
+
+		// a record outside of a transaction has a CRC of its own
+	convert( log_head );
+	binary = read_test_file( binary_file );
+	if ( corrupt( binary, "JobStatus" ) ) {
+		check_load( "changed the last record outside of a transaction", binary_file, 0, false );
+	}
+
+#ifndef WIN32
+		// a changed record in a transaction that is followed by another
+		// committed one can't be recovered from
+	convert( std::string( log_head ) + log_tail );
+	binary = read_test_file( binary_file );
+	if ( corrupt( binary, "alice" ) ) {
+		fflush( stdout );
+		pid_t pid = fork();
+		if ( pid == 0 ) {
+			check_load( "changed a value in a committed transaction", binary_file, 2, true );
+			_exit( 0 );
+		}
+		int status = 0;
+		if ( pid < 0 || waitpid( pid, &status, 0 ) != pid ) {
+			check_failed( "fork, errno = %d", errno );
+		} else if ( WIFEXITED( status ) && WEXITSTATUS( status ) == 0 ) {
+			check_failed( "changed a value in a committed transaction: the log loaded" );
+		} else {
+			check_passed( "changed a value in a committed transaction" );
+		}
+	}
+#endif
+}
+
+// A job queue log of the given number of jobs, 100 to a cluster, with
+// the attributes condor_submit gives a vanilla job, followed by the
+// transactions that start each job and then complete half of them.
+static std::string
+make_job_queue_log( int jobs )
+{
+	std::string log = "107 1 CreationTimestamp 1600000000\n";
+	for ( int i = 0; i < jobs; ++i ) {
+		int cluster = 1 + i / 100, proc = i % 100;
+		formatstr_cat( log,
+			"105 \n"
+			"101 %d.%d Job Machine\n"
+			"103 %d.%d ClusterId %d\n"
+			"103 %d.%d ProcId %d\n"
+			"103 %d.%d Owner \"user%d\"\n"
+			"103 %d.%d User \"user%d@example.org\"\n"
+			"103 %d.%d Cmd \"/home/user%d/analysis/bin/run_analysis\"\n"
+			"103 %d.%d Args \"--input data_%d.root --output out_%d.root --events 10000\"\n"
+			"103 %d.%d Iwd \"/home/user%d/analysis/run%d\"\n"
+			"103 %d.%d Environment \"HOME=/home/user%d PATH=/usr/bin:/bin OMP_NUM_THREADS=1\"\n"
+			"103 %d.%d Requirements (TARGET.Arch == \"X86_64\") && (TARGET.OpSys == \"LINUX\") && (TARGET.Disk >= RequestDisk) && (TARGET.Memory >= RequestMemory) && (TARGET.HasFileTransfer)\n"
+			"103 %d.%d Rank TARGET.KFlops / 1000 + (TARGET.Memory >= 4096)\n"
+			"103 %d.%d RequestCpus 1\n"
+			"103 %d.%d RequestDisk DiskUsage\n"
+			"103 %d.%d RequestMemory ifthenelse(MemoryUsage =!= undefined,MemoryUsage,(ImageSize + 1023) / 1024)\n"
+			"103 %d.%d DiskUsage %d\n"
+			"103 %d.%d ImageSize %d\n"
+			"103 %d.%d JobUniverse 5\n"
+			"103 %d.%d JobPrio 0\n"
+			"103 %d.%d JobStatus 1\n"
+			"103 %d.%d QDate %d\n"
+			"103 %d.%d In \"/dev/null\"\n"
+			"103 %d.%d Out \"out.%d.%d\"\n"
+			"103 %d.%d Err \"err.%d.%d\"\n"
+			"103 %d.%d UserLog \"/home/user%d/analysis/run%d/job.log\"\n"
+			"103 %d.%d ShouldTransferFiles \"YES\"\n"
+			"103 %d.%d WhenToTransferOutput \"ON_EXIT\"\n"
+			"103 %d.%d TransferInput \"data_%d.root,config.json\"\n"
+			"103 %d.%d PeriodicRemove (JobStatus == 2) && (time() - EnteredCurrentStatus > 86400)\n"
+			"103 %d.%d OnExitRemove true\n"
+			"103 %d.%d LeaveJobInQueue false\n"
+			"106 \n",
+			cluster, proc,
+			cluster, proc, cluster,
+			cluster, proc, proc,
+			cluster, proc, i % 50,
+			cluster, proc, i % 50,
+			cluster, proc, i % 50,
+			cluster, proc, i, i,
+			cluster, proc, i % 50, cluster,
+			cluster, proc, i % 50,
+			cluster, proc,
+			cluster, proc,
+			cluster, proc,
+			cluster, proc,
+			cluster, proc,
+			cluster, proc, 1000 + i % 977,
+			cluster, proc, 20000 + i % 7919,
+			cluster, proc,
+			cluster, proc,
+			cluster, proc,
+			cluster, proc, 1600000000 + i,
+			cluster, proc,
+			cluster, proc, cluster, proc,
+			cluster, proc, cluster, proc,
+			cluster, proc, i % 50, cluster,
+			cluster, proc,
+			cluster, proc,
+			cluster, proc, i,
+			cluster, proc,
+			cluster, proc,
+			cluster, proc );
+	}
+	for ( int i = 0; i < jobs; ++i ) {
+		int cluster = 1 + i / 100, proc = i % 100;
+		formatstr_cat( log,
+			"105 \n"
+			"103 %d.%d JobStatus 2\n"
+			"103 %d.%d EnteredCurrentStatus %d\n"
+			"103 %d.%d JobCurrentStartDate %d\n"
+			"103 %d.%d RemoteHost \"slot1_%d@node%d.example.org\"\n"
+			"103 %d.%d NumJobStarts 1\n"
+			"106 \n",
+			cluster, proc,
+			cluster, proc, 1600100000 + i,
+			cluster, proc, 1600100000 + i,
+			cluster, proc, 1 + i % 32, i % 1000,
+			cluster, proc );
+		if ( i % 2 ) {
+			formatstr_cat( log,
+				"105 \n"
+				"103 %d.%d JobStatus 4\n"
+				"103 %d.%d ExitCode 0\n"
+				"103 %d.%d CompletionDate %d\n"
+				"103 %d.%d RemoteWallClockTime %d.0\n"
+				"106 \n",
+				cluster, proc,
+				cluster, proc,
+				cluster, proc, 1600200000 + i,
+				cluster, proc, 100000 - i );
+			}
+	}
+	return log;
+}
+
+// Loads the log the way a daemon does when it starts up, returns how long
+// that took in seconds, or -1 if it failed.  If ads is not NULL, it is set
+// to the loaded ads, printed.
+static double
+time_load( const char *filename, std::map<std::string, std::string> *ads )
+{
+	HashTable<std::string, ClassAd*> table( hashFunction );
+	ClassAdLogTable<std::string, ClassAd*> la( table );
+	unsigned long seq = 0;
+	time_t birthdate = 0;
+	bool is_clean, requires_successful_cleaning, binary;
+	MyString errmsg;
+
+	double start = condor_gettimestamp_double();
+	FILE *fp = LoadClassAdLog( filename, la, DefaultMakeClassAdLogTableEntry,
+		seq, birthdate, is_clean, requires_successful_cleaning, binary, errmsg );
+	double elapsed = condor_gettimestamp_double() - start;
+	if ( ! fp ) {
+		errmsg.chomp();
+		check_failed( "load %s: %s", filename, errmsg.Value() );
+		return -1;
+	}
+	fclose( fp );
+
+		// freeing the ads also empties the expression cache, so the next
+		// load doesn't get a head start from this one
+	std::string key;
+	ClassAd *ad;
+	table.startIterations();
+	while ( table.iterate( key, ad ) == 1 ) {
+		if ( ads ) {
+			std::string text;
+			sPrintAd( text, *ad );
+			(*ads)[key] = text;
+		}
+		delete ad;
+	}
+	return elapsed;
+}
+
+static void
+test_restart( int jobs, int iterations )
+{
+	long long binary_size = convert( make_job_queue_log( jobs ) );
+	if ( binary_size < 0 ) {
+		return;
+	}
+	long long ascii_size = (long long)read_test_file( log_file ).size();
+
+	std::map<std::string, std::string> ascii_ads, binary_ads;
+	if ( time_load( log_file, &ascii_ads ) < 0 || time_load( binary_file, &binary_ads ) < 0 ) {
+		return;
+	}
+	check( "the binary log loads the same ads as the ascii one",
+	       (int)ascii_ads.size() == jobs && ascii_ads == binary_ads );
+
+		// the best of the iterations, alternating between the formats
+	double best[2] = { -1, -1 };
+	for ( int i = 0; i < iterations; ++i ) {
+		for ( int b = 0; b < 2; ++b ) {
+			double t = time_load( b ? binary_file : log_file, NULL );
+			if ( t < 0 ) {
+				return;
+			}
+			if ( best[b] < 0 || t < best[b] ) {
+				best[b] = t;
+			}
+		}
+	}
+
+	printf( "%8s %8s %14s %10s\n", "jobs", "format", "bytes", "load (s)" );
+	printf( "%8d %8s %14lld %10.3f\n", jobs, "ascii", ascii_size, best[0] );
+	printf( "%8d %8s %14lld %10.3f\n", jobs, "binary", binary_size, best[1] );
+	printf( "binary/ascii: %.1f%% of the size, %.1f%% of the load time\n",
+		100.0 * binary_size / ascii_size, 100.0 * best[1] / best[0] );
+}
+
+int
+main( int argc, char *argv[] )
+{
+	int jobs = 2000;
+	int iterations = 3;
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( strcmp( argv[i], "-jobs" ) == 0 && i + 1 < argc ) {
+			jobs = atoi( argv[++i] );
+		} else if ( strcmp( argv[i], "-iterations" ) == 0 && i + 1 < argc ) {
+			iterations = atoi( argv[++i] );
+		} else {
+			fprintf( stderr, "usage: %s [-jobs <n>] [-iterations <n>]\n", argv[0] );
+			return 1;
+		}
+	}
+	if ( iterations < 1 ) {
+		iterations = 1;
+	}
+
+	test_round_trip();
+	test_truncated();
+	test_corrupt();
+	test_restart( jobs, iterations );
+
+	unlink( log_file );
+	unlink( binary_file );
+	unlink( ascii_file );
+
+	return check_results();
+}
@@ -0,0 +1,168 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for the commit and sync sequence numbers of a ClassAdLog, which the
+// schedd uses for group commit (see SCHEDD_JOB_QUEUE_GROUP_COMMIT_WINDOW).
+// Makes durable and non-durable commits, checks when the log says they are
+// on disk and what another reader of the log sees, then reloads the log and
+// checks that every commit made it.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "classad_log.h"
+#include "test_check.h"
+
+#include <stdio.h>
+#include <set>
+#include <string>
+
+typedef ClassAdLog<std::string, ClassAd*> JobLog;
+
+static const char *log_file = "test_classad_log_group_commit.log";
+
+// The keys and owners of the ads in a table, sorted by key, like "1.0=alice 2.0=bob".
+static std::string
+describe( HashTable<std::string, ClassAd*> & table )
+{
+	std::set<std::string> jobs;
+	std::string key;
+	ClassAd *ad = NULL;
+	table.startIterations();
+	while ( table.iterate( key, ad ) == 1 ) {
+		std::string owner;
+		ad->LookupString( "Owner", owner );
+		jobs.insert( key + "=" + owner );
+	}
+	std::string desc;
+	for ( auto & job : jobs ) {
+		if ( ! desc.empty() ) desc += ' ';
+		desc += job;
+	}
+	return desc;
+}
+
+// What a reader that opens the log now sees, the way condor_q -userlog or
+// the replication daemon would.
+static std::string
+read_log()
+{
+	HashTable<std::string, ClassAd*> table( hashFunction );
+	ClassAdLogTable<std::string, ClassAd*> la( table );
+	unsigned long seq = 0;
+	time_t birthdate = 0;
+	bool is_clean, requires_successful_cleaning, binary;
+	MyString errmsg;
+
+	FILE *fp = LoadClassAdLog( log_file, la, DefaultMakeClassAdLogTableEntry,
+		seq, birthdate, is_clean, requires_successful_cleaning, binary, errmsg );
+	if ( ! fp ) {
+		fprintf( stderr, "cannot read %s: %s", log_file, errmsg.Value() );
+		return "";
+	}
+	fclose( fp );
+
+	std::string desc = describe( table );
+	std::string key;
+	ClassAd *ad = NULL;
+	table.startIterations();
+	while ( table.iterate( key, ad ) == 1 ) {
+		delete ad;
+	}
+	return desc;
+}
+
+static void
+new_job( JobLog & log, const char *key, const char *owner )
+{
+	std::string value = std::string( "\"" ) + owner + "\"";
+	log.AppendLog( new LogNewClassAd( key, "Job", "Machine" ) );
+	log.AppendLog( new LogSetAttribute( key, "Owner", value.c_str() ) );
+}
+
+int
+main( int /*argc*/, char ** /*argv*/ )
+{
+	unlink( log_file );
+	JobLog *log = new JobLog( log_file );
+	unsigned long seq = log->GetCommitSeq();
+	check( "a new log is synced", log->GetSyncedSeq() == seq );
+
+	log->BeginTransaction();
+	new_job( *log, "1.0", "alice" );
+	log->CommitTransaction();
+	check( "a durable commit is synced", log->GetCommitSeq() == seq + 1 && log->GetSyncedSeq() == seq + 1 );
+	check( "a durable commit can be read", read_log() == "1.0=alice" );
+
+		// what the schedd does for each client commit in a group
+	log->BeginTransaction();
+	new_job( *log, "2.0", "bob" );
+	log->CommitNondurableTransaction();
+	log->BeginTransaction();
+	new_job( *log, "3.0", "carol" );
+	log->CommitNondurableTransaction();
+	check( "non-durable commits are counted but not synced",
+		log->GetCommitSeq() == seq + 3 && log->GetSyncedSeq() == seq + 1 );
+	check( "non-durable commits are not written yet", read_log() == "1.0=alice" );
+
+	log->ForceLog();
+	check( "one sync covers the group", log->GetSyncedSeq() == seq + 3 && log->GetCommitSeq() == seq + 3 );
+	check( "the group can be read after the sync", read_log() == "1.0=alice 2.0=bob 3.0=carol" );
+
+		// a durable commit by the schedd itself before the group sync makes
+		// the earlier non-durable commits durable too
+	log->BeginTransaction();
+	new_job( *log, "4.0", "dave" );
+	log->CommitNondurableTransaction();
+	unsigned long waiting = log->GetCommitSeq();
+	check( "a waiting commit is not synced", log->GetSyncedSeq() < waiting );
+	log->BeginTransaction();
+	log->AppendLog( new LogSetAttribute( "1.0", "Owner", "\"alice2\"" ) );
+	log->CommitTransaction();
+	check( "a durable commit syncs the commits before it", log->GetSyncedSeq() >= waiting &&
+		log->GetSyncedSeq() == log->GetCommitSeq() );
+	check( "the commits before it can be read",
+		read_log() == "1.0=alice2 2.0=bob 3.0=carol 4.0=dave" );
+
+		// a record outside of a transaction at a non-durable level
+	int old_level = log->IncNondurableCommitLevel();
+	log->AppendLog( new LogSetAttribute( "2.0", "Owner", "\"bob2\"" ) );
+	log->DecNondurableCommitLevel( old_level );
+	check( "a non-durable record is counted but not synced", log->GetSyncedSeq() < log->GetCommitSeq() );
+
+		// rotating the log writes and syncs all of the table
+	check( "rotate the log", log->TruncLog() );
+	check( "a rotated log is synced", log->GetSyncedSeq() == log->GetCommitSeq() );
+	check( "the rotated log can be read", read_log() == "1.0=alice2 2.0=bob2 3.0=carol 4.0=dave" );
+
+	log->BeginTransaction();
+	new_job( *log, "5.0", "erin" );
+	log->CommitNondurableTransaction();
+	log->ForceLog();
+	delete log;
+
+	log = new JobLog( log_file );
+	check( "the log reloads with every commit",
+		describe( log->table ) == "1.0=alice2 2.0=bob2 3.0=carol 4.0=dave 5.0=erin" );
+	check( "a reloaded log is synced", log->GetSyncedSeq() == log->GetCommitSeq() );
+	delete log;
+
+	unlink( log_file );
+
+	return check_results();
+}
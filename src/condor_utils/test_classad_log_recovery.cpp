@@ -0,0 +1,205 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for parsing the values of a ClassAd log on several threads (see
+// CLASSAD_LOG_RECOVERY_THREADS).  Loads logs with values that don't parse
+// in the last transaction, which was never committed, and with
+// CLASSAD_LOG_STRICT_PARSING false, all through the log, and checks that
+// the ads are the same as when the log is loaded on one thread, and that
+// the parse threads leave CondorErrMsg alone.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "classad_log.h"
+#include "test_check.h"
+
+#include <stdio.h>
+#include <string>
+#include <map>
+
+static const char *log_file = "test_classad_log_recovery.log";
+
+static const char *bad_values[] = {
+	"[[[",
+	"\"no end quote",
+	"1 +",
+	"foo(",
+	")",
+};
+static const int num_bad_values = sizeof(bad_values) / sizeof(bad_values[0]);
+
+// A committed transaction per job, with enough jobs that the records
+// take more than one batch.  Every bad_every'th job has a value that
+// doesn't parse, unless bad_every is 0.
+static std::string
+make_log( int jobs, int bad_every )
+{
+	std::string text = "107 3 CreationTimestamp 1234\n";
+	std::string rec;
+	for ( int i = 0; i < jobs; ++i ) {
+		formatstr( rec,
+			"105 \n"
+			"101 %d.0 Job Machine\n"
+			"103 %d.0 Owner \"user%d\"\n"
+			"103 %d.0 Requirements (TARGET.Memory > %d) && (TARGET.Arch == \"X86_64\")\n"
+			"103 %d.0 JobStatus %d\n",
+			i, i, i % 17, i, i * 3, i, 1 + i % 5 );
+		text += rec;
+		if ( bad_every && i % bad_every == 0 ) {
+			formatstr( rec, "103 %d.0 Broken %s\n", i, bad_values[i % num_bad_values] );
+			text += rec;
+		}
+		text += "106 \n";
+	}
+	return text;
+}
+
+typedef std::map<std::string, std::string> AdMap;
+
+// Loads the log with the given number of parse threads and returns the ads
+// as text, or false if the log could not be loaded.
+static bool
+load( int threads, AdMap &ads )
+{
+	std::string value = std::to_string( threads );
+	param_insert( "CLASSAD_LOG_RECOVERY_THREADS", value.c_str() );
+
+	HashTable<std::string, ClassAd*> table( hashFunction );
+	ClassAdLogTable<std::string, ClassAd*> la( table );
+	unsigned long seq = 0;
+	time_t birthdate = 0;
+	bool is_clean, requires_successful_cleaning, binary;
+	MyString errmsg;
+
+	ads.clear();
+	FILE *fp = LoadClassAdLog( log_file, la, DefaultMakeClassAdLogTableEntry,
+		seq, birthdate, is_clean, requires_successful_cleaning, binary, errmsg );
+	if ( ! fp ) {
+		errmsg.chomp();
+		check_failed( "load with %d threads: %s", threads, errmsg.Value() );
+		return false;
+	}
+	fclose( fp );
+
+	std::string key;
+	ClassAd *ad = NULL;
+	table.startIterations();
+	while ( table.iterate( key, ad ) == 1 ) {
+		sPrintAd( ads[key], *ad );
+		delete ad;
+	}
+	return true;
+}
+
+// Loads the log serially and on several threads, checks that the ads are
+// the same and that there are the expected number of them.  If check_errmsg
+// is true, also checks that loading on several threads doesn't set
+// CondorErrMsg.
+static void
+check_loads( const char *name, size_t expected_ads, bool check_errmsg )
+{
+	AdMap serial, threaded;
+	if ( ! load( 0, serial ) ) {
+		return;
+	}
+	classad::CondorErrMsg = "left alone";
+	for ( int threads = 2; threads <= 8; threads *= 2 ) {
+		if ( ! load( threads, threaded ) ) {
+			return;
+		}
+		if ( threaded != serial ) {
+			check_failed( "%s: the ads loaded on %d threads differ", name, threads );
+			return;
+		}
+	}
+	if ( serial.size() != expected_ads ) {
+		check_failed( "%s: %d ads, expected %d", name, (int)serial.size(), (int)expected_ads );
+	} else if ( check_errmsg && classad::CondorErrMsg != "left alone" ) {
+		check_failed( "%s: CondorErrMsg was set to '%s'", name, classad::CondorErrMsg.c_str() );
+	} else {
+		check_passed( "%s", name );
+	}
+}
+
+static void
+test_uncommitted()
+{
+	// the values that don't parse are in a transaction that wasn't committed,
+	// which ends the log, so all of them are in the last batch
+	std::string text = make_log( 70000, 0 ) + "105 \n";
+	for ( int i = 0; i < 200; ++i ) {
+		formatstr_cat( text, "103 %d.0 Broken %s\n", i, bad_values[i % num_bad_values] );
+		formatstr_cat( text, "103 %d.0 JobStatus 4\n", i );
+	}
+	write_test_file( log_file, text );
+
+	param_insert( "CLASSAD_LOG_STRICT_PARSING", "true" );
+	check_loads( "bad values in the uncommitted last transaction", 70000, true );
+
+	AdMap ads;
+	int status = 0;
+	ClassAd ad;
+	if ( load( 4, ads ) && ! ads.empty() ) {
+		initAdFromString( ads["0.0"].c_str(), ad );
+		check( "the uncommitted transaction was not applied",
+			ad.LookupInteger( "JobStatus", status ) && status == 1 &&
+			! ad.Lookup( "Broken" ) );
+	}
+}
+
+static void
+test_not_strict()
+{
+	write_test_file( log_file, make_log( 70000, 7 ) );
+	param_insert( "CLASSAD_LOG_STRICT_PARSING", "false" );
+		// Play() hands the values that didn't parse to InsertViaCache(),
+		// which tries them again on this thread and sets CondorErrMsg, as
+		// a serial load does
+	check_loads( "bad values in committed transactions, not strict", 70000, false );
+	param_insert( "CLASSAD_LOG_STRICT_PARSING", "true" );
+}
+
+static void
+test_private_errors()
+{
+	classad::ClassAdParser parser;
+	classad::ExprTree *tree = NULL;
+	parser.SetOldClassAd( true );
+	parser.SetPrivateErrors( true );
+	classad::CondorErrMsg = "left alone";
+	check( "a parser with private errors keeps its message",
+		! parser.ParseExpression( "[ a = 1 b = 2 ]", tree, true ) && ! tree &&
+		! parser.GetErrorMessage().empty() &&
+		classad::CondorErrMsg == "left alone" );
+	check( "a parser with private errors parses",
+		parser.ParseExpression( "1 + 2", tree, true ) && tree );
+	delete tree;
+}
+
+int
+main( int /*argc*/, char ** /*argv*/ )
+{
+	test_private_errors();
+	test_uncommitted();
+	test_not_strict();
+
+	unlink( log_file );
+	return check_results();
+}
@@ -0,0 +1,191 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for ScanClassAdLogCommitted(), which the replication daemon uses to
+// find how much of a growing ClassAd log it can ship to the backups.  Writes
+// logs that end with committed transactions, an unfinished transaction, and
+// records that are only partly written, in both the ascii and the binary
+// format, and checks where the scan says the committed part ends.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "classad_log.h"
+#include "test_check.h"
+
+#include <stdio.h>
+#include <string>
+
+static const char *log_file = "test_classad_log_scan.log";
+static const char *binary_file = "test_classad_log_scan.bin";
+
+// the first record, and a committed transaction
+static const char *log_head =
+	"107 3 CreationTimestamp 1234\n"
+	"105 \n"
+	"101 1.0 Job Machine\n"
+	"103 1.0 Owner \"alice\"\n"
+	"106 \n";
+// a second committed transaction
+static const char *log_next =
+	"105 \n"
+	"103 1.0 JobStatus 2\n"
+	"104 1.0 Owner\n"
+	"106 \n";
+
+static long long
+file_size( const char *filename )
+{
+	struct stat st;
+	return stat( filename, &st ) == 0 ? (long long)st.st_size : -1;
+}
+
+// Scans the log and checks the result, a committed_end of -1 means the scan
+// is expected to fail.
+static void
+check_scan( const char *name, const char *filename, long long start_offset,
+            long long expected_end, unsigned long expected_seq = 3,
+            time_t expected_birthdate = 1234 )
+{
+	long long committed_end = -1;
+	unsigned long seq = 0;
+	time_t birthdate = 0;
+	MyString errmsg;
+
+	FILE *fp = safe_fopen_wrapper_follow( filename, "r" );
+	if ( ! fp ) {
+		check_failed( "%s: cannot open %s", name, filename );
+		return;
+	}
+	bool ok = ScanClassAdLogCommitted( fp, start_offset, committed_end, seq, birthdate, errmsg );
+	fclose( fp );
+
+	if ( expected_end < 0 ) {
+		if ( ok ) {
+			check_failed( "%s: scan succeeded with committed end %lld", name, committed_end );
+		} else {
+			errmsg.chomp();
+			check_passed( "%s: %s", name, errmsg.Value() );
+		}
+		return;
+	}
+	if ( ! ok ) {
+		errmsg.chomp();
+		check_failed( "%s: %s", name, errmsg.Value() );
+	} else if ( committed_end != expected_end || seq != expected_seq || birthdate != expected_birthdate ) {
+		check_failed( "%s: committed end %lld, sequence %lu, birthdate %ld, expected %lld, %lu, %ld",
+			name, committed_end, seq, (long)birthdate, expected_end, expected_seq, (long)expected_birthdate );
+	} else {
+		check_passed( "%s: committed end %lld", name, committed_end );
+	}
+}
+
+static void
+test_ascii()
+{
+	std::string head = log_head;
+	std::string both = head + log_next;
+	long long head_end = head.size();
+	long long both_end = both.size();
+
+	write_test_file( log_file, "" );
+	check_scan( "empty log", log_file, 0, 0, 0, 0 );
+
+	write_test_file( log_file, "107 3 Creation" );
+	check_scan( "partly written first record", log_file, 0, 0, 0, 0 );
+
+	write_test_file( log_file, head );
+	check_scan( "committed transaction", log_file, 0, head_end );
+
+	write_test_file( log_file, both );
+	check_scan( "two committed transactions", log_file, 0, both_end );
+	check_scan( "scan from an earlier end", log_file, head_end, both_end );
+	check_scan( "scan from the end", log_file, both_end, both_end );
+	check_scan( "offset beyond the end", log_file, both_end + 1, -1 );
+
+	write_test_file( log_file, head + "105 \n103 1.0 JobStatus 2\n" );
+	check_scan( "unfinished transaction", log_file, 0, head_end );
+	check_scan( "unfinished transaction from an earlier end", log_file, head_end, head_end );
+
+		// the writer has flushed part of the next transaction
+	write_test_file( log_file, head + "105 \n103 1.0 JobStat" );
+	check_scan( "partly written attribute", log_file, 0, head_end );
+
+	write_test_file( log_file, head + "105 \n103 1.0 JobStatus 2\n106" );
+	check_scan( "partly written end of transaction", log_file, head_end, head_end );
+
+	write_test_file( log_file, head + "103 1.0 JobStatus 2" );
+	check_scan( "partly written record outside of a transaction", log_file, 0, head_end );
+
+	write_test_file( log_file, head + "123 1.0 JobStatus 2\n" );
+	check_scan( "bad record type", log_file, 0, head_end );
+
+		// records outside of a transaction are committed one by one
+	write_test_file( log_file, head + "103 1.0 JobStatus 2\n" );
+	check_scan( "record outside of a transaction", log_file, 0, head_end + 20 );
+
+	write_test_file( log_file, "105 \n101 1.0 Job Machine\n106 \n" );
+	check_scan( "no sequence number", log_file, 0, 30, 0, 0 );
+}
+
+static void
+test_binary()
+{
+	std::string head = log_head;
+	std::string both = head + log_next;
+	unsigned long records = 0;
+	MyString errmsg;
+
+	write_test_file( log_file, head );
+	if ( ! ConvertClassAdLog( log_file, binary_file, true, records, errmsg ) ) {
+		errmsg.chomp();
+		check_failed( "binary conversion: %s", errmsg.Value() );
+		return;
+	}
+	long long head_end = file_size( binary_file );
+	check_scan( "binary committed transaction", binary_file, 0, head_end );
+
+	write_test_file( log_file, both );
+	ConvertClassAdLog( log_file, binary_file, true, records, errmsg );
+	long long both_end = file_size( binary_file );
+	check_scan( "binary two committed transactions", binary_file, 0, both_end );
+	check_scan( "binary scan from an earlier end", binary_file, head_end, both_end );
+
+		// cut off the end of the second transaction part of the way through
+		// each of its last records
+	for ( long long cut = 1; cut < both_end - head_end; cut += 7 ) {
+		if ( truncate( binary_file, both_end - cut ) != 0 ) {
+			check_failed( "binary truncate: errno = %d", errno );
+			return;
+		}
+		std::string name = "binary log cut " + std::to_string( cut ) + " bytes short";
+		check_scan( name.c_str(), binary_file, head_end, head_end );
+	}
+}
+
+int
+main( int /*argc*/, char ** /*argv*/ )
+{
+	test_ascii();
+	test_binary();
+
+	unlink( log_file );
+	unlink( binary_file );
+
+	return check_results();
+}
@@ -35,6 +35,11 @@
 
 #include "my_hostname.h"
 #include "stream.h"
+#include "reli_sock.h"
+#include "condor_ver_info.h"
+#include "condor_version.h"
+#include "condor_config.h"
+#include "subsystem_info.h"
 #include <stdio.h>
 #include <stdlib.h>
 using namespace std;
@@ -126,7 +131,7 @@ void DummyStream::printContents()
 {
     std::vector<char*>::iterator itr;
 
-    printf("Size of vec: %d. Printing contents.\n", testVec.size() );
+    printf("Size of vec: %d. Printing contents.\n", (int)testVec.size() );
 
     for(itr = testVec.begin(); itr < testVec.end(); itr++)
     {
@@ -314,7 +319,7 @@ bool putOldClassAd ( DummyStream *sock, classad::ClassAd& ad, bool excludeTypes
 }
 //}}}
 
-char *classad_strings[] = 
+const char *classad_strings[] = 
 {
     "A = 1\n B = 2",
     "A = 1\n B = 3",
@@ -376,9 +381,12 @@ void setUpCompatClassAds(ClassAd** compC1, ClassAd** compC2,
         printf("creating compatclassads\n");
 
     int eofCheck, errorCheck, emptyCheck; 
-    (*compC1) = new ClassAd(c1FP, ",", eofCheck, errorCheck, emptyCheck); 
-    (*compC2)= new ClassAd(c2FP, ",", eofCheck, errorCheck, emptyCheck); 
-    (*compC3) = new ClassAd(c3FP, ",", eofCheck, errorCheck, emptyCheck); 
+    (*compC1) = new ClassAd;
+    (*compC2) = new ClassAd;
+    (*compC3) = new ClassAd;
+    InsertFromFile(c1FP, **compC1, ",", eofCheck, errorCheck, emptyCheck);
+    InsertFromFile(c2FP, **compC2, ",", eofCheck, errorCheck, emptyCheck);
+    InsertFromFile(c3FP, **compC3, ",", eofCheck, errorCheck, emptyCheck);
     fclose(c1FP); fclose(c2FP); fclose(c3FP);
 
     SetMyTypeName(*(*compC1), "compC1");
@@ -509,6 +517,144 @@ bool test_put_chained_ads(bool verbose)
 }
 //}}}
 
+//{{{ test_put_get_round_trip
+/* Sends an ad over a connected pair of ReliSocks with the real putClassAd()
+ *  and reads it back with getClassAd() or getClassAdEx().  The peer version
+ *  of the sender decides whether the ad goes in the text or the binary wire
+ *  format, and this checks that the one we expect was used.  The version is
+ *  set from the string the peer sends in the security handshake, the way
+ *  SecMan does it.  Every attribute must come back with the same value, and
+ *  the int sent after the ad must still be in sync.  Returns true if the
+ *  test failed.
+ */
+static const char *round_trip_ad =
+    "MyType = \"Job\"\n"
+    "TargetType = \"Machine\"\n"
+    "Count = 42\n"
+    "Big = 9223372036854775807\n"
+    "Negative = -17\n"
+    "Pi = 3.141592653589793\n"
+    "Tiny = 1.0E-300\n"
+    "Yes = true\n"
+    "No = false\n"
+    "Name = \"a \\\"quoted\\\" name\"\n"
+    "Empty = \"\"\n"
+    "Nothing = undefined\n"
+    "Broken = error\n"
+    "Sum = Count + 8\n"
+    "Requirements = (TARGET.Memory >= 1024) && (MY.Count > 0)\n"
+    "List = { 1, \"two\", 3.0 }\n"
+    "Nested = [ A = 1; B = \"b\" ]\n";
+
+bool test_put_get_round_trip(const char *peer_version, bool binary, int get_options, bool verbose)
+{
+    const int trailer = 0x5eed;
+    bool failed = false;
+
+    ClassAd sent;
+    if ( ! initAdFromString(round_trip_ad, sent)) {
+        printf("FAILED to parse the round trip ad\n");
+        return true;
+    }
+
+    ReliSock writer, reader;
+    if ( ! writer.connect_socketpair(reader)) {
+        printf("FAILED to connect a socket pair\n");
+        return true;
+    }
+    writer.timeout(10);
+    reader.timeout(10);
+
+        // the binary format is only sent to peers known to read it
+    ClassAd auth_info;
+    std::string remote_version;
+    auth_info.Assign(ATTR_SEC_REMOTE_VERSION, peer_version);
+    if (auth_info.LookupString(ATTR_SEC_REMOTE_VERSION, remote_version)) {
+        CondorVersionInfo ver_info(remote_version.c_str());
+        writer.set_peer_version(&ver_info);
+    }
+
+        // first check which format goes on the wire
+    writer.encode();
+    if ( ! putClassAd(&writer, sent) || ! writer.end_of_message()) {
+        printf("FAILED to put the ad\n");
+        return true;
+    }
+    int numExprs = 0;
+    reader.decode();
+    if ( ! reader.code(numExprs)) {
+        printf("FAILED to get the number of expressions\n");
+        return true;
+    }
+        // this discards the rest of the ad
+    reader.end_of_message();
+    if ((numExprs < 0) != binary) {
+        printf("FAILED, expected the %s format but got %d for the number of expressions\n",
+               binary ? "binary" : "text", numExprs);
+        failed = true;
+    }
+
+        // then send it again followed by the trailer, and read it all back
+    int got_trailer = 0;
+    ClassAd received;
+    writer.encode();
+    if ( ! putClassAd(&writer, sent) || ! writer.put(trailer) ||
+         ! writer.end_of_message()) {
+        printf("FAILED to put the ad\n");
+        return true;
+    }
+    reader.decode();
+    bool got = get_options ? getClassAdEx(&reader, received, get_options)
+                           : getClassAd(&reader, received);
+    if ( ! got || ! reader.code(got_trailer) || ! reader.end_of_message()) {
+        printf("FAILED to get the ad\n");
+        return true;
+    }
+    if (got_trailer != trailer) {
+        printf("FAILED, the stream is out of sync: read %d after the ad\n", got_trailer);
+        failed = true;
+    }
+
+    if (verbose) {
+        printf("Received:\n"); fPrintAd(stdout, received); printf("\n");
+    }
+
+        // compare the values, which also parses the lazily inserted expressions
+    classad::ClassAdUnParser unp;
+    unp.SetOldClassAd(true, true);
+    for (classad::ClassAd::const_iterator it = sent.begin(); it != sent.end(); ++it) {
+        classad::Value want, have;
+        std::string want_str, have_str;
+        sent.EvaluateAttr(it->first, want);
+        if ( ! received.Lookup(it->first)) {
+            printf("FAILED, %s is missing\n", it->first.c_str());
+            failed = true;
+            continue;
+        }
+        received.EvaluateAttr(it->first, have);
+        unp.Unparse(want_str, want);
+        unp.Unparse(have_str, have);
+            // the attributes of a nested ad may be unparsed in any order
+        classad::ClassAd *want_ad = NULL, *have_ad = NULL;
+        bool same = want.IsClassAdValue(want_ad) && have.IsClassAdValue(have_ad)
+                  ? want_ad->SameAs(have_ad)
+                  : want_str == have_str && want.GetType() == have.GetType();
+        if ( ! same) {
+            printf("FAILED, %s is %s, expected %s\n", it->first.c_str(),
+                   have_str.c_str(), want_str.c_str());
+            failed = true;
+        }
+    }
+    if (received.size() != sent.size()) {
+        printf("FAILED, received %d attributes, expected %d\n",
+               (int)received.size(), (int)sent.size());
+        failed = true;
+    }
+
+    return failed;
+}
+//}}}
+
 int main(int argc, char **argv)
 {
     bool verbose;
@@ -522,6 +668,11 @@ int main(int argc, char **argv)
         verbose = false;
     }
 
+        // the socket pair is bound to the loopback interface of the
+        // protocols that the configuration enables
+    set_mySubSystem("TEST_CLASSAD_PUT", SUBSYSTEM_TYPE_TOOL);
+    config();
+
     printf("testing server time\n");
     test_put_server_time(verbose);
     printf("Server time complete.\n-----------------\nTesting chained ads.\n");
@@ -529,4 +680,30 @@ int main(int argc, char **argv)
     //test_put_chained_ads(verbose);
 
     printf("chained ads complete.\n-----------------\n");
+
+        // a peer built from this tree is sent the binary format, a peer
+        // of the last release without the reader is sent text
+    const char *peer_versions[] = {
+        "$CondorVersion: 8.9.11 Jan 04 2021 BuildID: 526068 PackageID: 8.9.11-1 $",
+        CondorVersion(),
+    };
+    int failures = 0;
+    for (int binary = 0; binary < 2; binary++) {
+        const char *format = binary ? "binary" : "text";
+        const char *peer_version = peer_versions[binary];
+        printf("Round trip of the %s format with getClassAd\n", format);
+        classad::ClassAdSetExpressionCaching(false);
+        if (test_put_get_round_trip(peer_version, binary, 0, verbose)) failures++;
+
+        printf("Round trip of the %s format with getClassAdEx\n", format);
+        if (test_put_get_round_trip(peer_version, binary, GET_CLASSAD_FAST, verbose)) failures++;
+
+        printf("Round trip of the %s format with lazy parsing\n", format);
+        classad::ClassAdSetExpressionCaching(true);
+        if (test_put_get_round_trip(peer_version, binary, GET_CLASSAD_FAST | GET_CLASSAD_LAZY_PARSE, verbose)) failures++;
+        classad::ClassAdSetExpressionCaching(false);
+    }
+    printf("round trips complete, %d failed.\n-----------------\n", failures);
+
+    return failures ? 1 : 0;
 }
@@ -0,0 +1,382 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for putClassAd() called from several threads at once, the way
+// the collector's query threads send the ads of a snapshot (see
+// COLLECTOR_QUERY_THREADS and collector_query_pool.h).  The ads are read
+// through the ClassAd cache, as the collector reads them, so they share
+// expressions.  Each thread sends all of them over a socket of its own,
+// in the old and the binary format, with and without private attributes
+// and with a projection, while the main thread goes on reading more ads
+// into the cache.  Every thread must send the same bytes as one thread
+// sending on its own, and those must read back as the ads that were sent.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_classad.h"
+#include "condor_attributes.h"
+#include "condor_version.h"
+#include "condor_ver_info.h"
+#include "reli_sock.h"
+#include "test_check.h"
+
+#include <pthread.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+static const int NUM_ADS = 300;
+
+static CondorVersionInfo binary_version( CondorVersion() );
+static std::atomic<int> writers_running( 0 );
+
+static void
+make_ad_text( int i, ClassAd &ad )
+{
+	std::string name;
+	formatstr( name, "slot%d@host%d.example.com", i % 8 + 1, i / 8 );
+	ad.Assign( ATTR_NAME, name );
+	ad.Assign( ATTR_MY_TYPE, "Machine" );
+	ad.Assign( ATTR_ARCH, "X86_64" );
+	ad.Assign( ATTR_MEMORY, 1024 * (i % 16 + 1) );
+	ad.Assign( ATTR_CPUS, i % 4 + 1 );
+	ad.Assign( ATTR_LOAD_AVG, i * 0.01 );
+	ad.AssignExpr( ATTR_REQUIREMENTS, "TARGET.RequestMemory <= Memory && Cpus > 0" );
+	ad.AssignExpr( ATTR_RANK, "TARGET.Owner == \"alice\" ? 10 : 0" );
+	ad.AssignExpr( "Groups", "{ \"physics\", \"chemistry\" }" );
+	std::string claim;
+	formatstr( claim, "<10.0.%d.%d:9618>#1600000000#%d#secret", i / 250, i % 250, i );
+	ad.Assign( ATTR_CAPABILITY, claim );
+	ad.Assign( ATTR_CLAIM_ID, claim );
+	for ( int j = 0; j < 20; ++j ) {
+		std::string attr;
+			// the same in every ad, so shared in the cache
+		formatstr( attr, "Common%d", j );
+		ad.Assign( attr, j );
+		formatstr( attr, "Unique%d", j );
+		ad.Assign( attr, i * 100 + j );
+	}
+}
+
+// set up by main() before any thread runs
+static classad::References projection;
+
+// The options a thread sends ad i with: every attribute, no private
+// attributes, or a projection.
+static int
+put_options( int i, const classad::References *&whitelist )
+{
+	whitelist = NULL;
+	switch ( i % 3 ) {
+	case 1: return PUT_CLASSAD_NO_PRIVATE;
+	case 2: whitelist = &projection; return PUT_CLASSAD_NO_PRIVATE;
+	default: return 0;
+	}
+}
+
+// Sends ad on one end of a socketpair and reads it back on the other,
+// through the ClassAd cache the way the collector reads updates.
+static ClassAd *
+cache_ad( ReliSock &out, ReliSock &in, ClassAd &ad )
+{
+	out.encode();
+	if ( ! putClassAd( &out, ad ) || ! out.end_of_message() ) {
+		return NULL;
+	}
+	ClassAd *cached = new ClassAd();
+	in.decode();
+	if ( ! getClassAdEx( &in, *cached, GET_CLASSAD_FAST ) || ! in.end_of_message() ) {
+		delete cached;
+		return NULL;
+	}
+	return cached;
+}
+
+static bool
+connect_pair( ReliSock &a, ReliSock &b )
+{
+	int pair[2];
+	if ( socketpair( AF_UNIX, SOCK_STREAM, 0, pair ) != 0 ) {
+		check_failed( "socketpair failed: %s", strerror( errno ) );
+		return false;
+	}
+	a.assignDomainSocket( pair[0] );
+	b.assignDomainSocket( pair[1] );
+	return true;
+}
+
+struct Writer {
+	const std::vector<ClassAd *> *ads;
+	int fd;
+	bool binary;
+	int rounds;
+	bool ok;
+};
+
+// Sends the ads rounds times, one message per round, the way a query
+// reply is sent.
+static void *
+writer_main( void *arg )
+{
+	Writer *w = (Writer *)arg;
+	ReliSock sock;
+	sock.assignDomainSocket( w->fd );
+	if ( w->binary ) {
+		sock.set_peer_version( &binary_version );
+	}
+	sock.encode();
+	w->ok = true;
+	for ( int round = 0; round < w->rounds && w->ok; ++round ) {
+		for ( size_t i = 0; i < w->ads->size() && w->ok; ++i ) {
+			const classad::References *whitelist = NULL;
+			int options = put_options( (int)i, whitelist );
+			int more = 1;
+			w->ok = sock.code( more ) && putClassAd( &sock, *(*w->ads)[i], options, whitelist );
+		}
+		int more = 0;
+		w->ok = w->ok && sock.code( more ) && sock.end_of_message();
+	}
+	sock.close();
+	--writers_running;
+	return NULL;
+}
+
+struct Reader {
+	int fd;
+	std::string data;
+};
+
+// Reads the raw bytes that a writer sends until it closes its socket.
+static void *
+reader_main( void *arg )
+{
+	Reader *r = (Reader *)arg;
+	char buf[65536];
+	ssize_t n;
+	while ( (n = read( r->fd, buf, sizeof(buf) )) != 0 ) {
+		if ( n < 0 && errno != EINTR ) {
+			break;
+		}
+		if ( n > 0 ) {
+			r->data.append( buf, n );
+		}
+	}
+	close( r->fd );
+	return NULL;
+}
+
+// Runs num_threads writers at once, each with a reader of its own, and
+// returns what each reader got.  While they run the main thread reads
+// ads into the cache, if churn is true.
+static std::vector<std::string>
+send_ads( const std::vector<ClassAd *> &ads, bool binary, int num_threads, int rounds, bool churn )
+{
+	std::vector<Writer> writers( num_threads );
+	std::vector<Reader> readers( num_threads );
+	std::vector<pthread_t> threads;
+	writers_running = num_threads;
+	for ( int t = 0; t < num_threads; ++t ) {
+		int pair[2];
+		if ( socketpair( AF_UNIX, SOCK_STREAM, 0, pair ) != 0 ) {
+			EXCEPT( "socketpair failed: %s", strerror( errno ) );
+		}
+		writers[t].ads = &ads;
+		writers[t].fd = pair[0];
+		writers[t].binary = binary;
+		writers[t].rounds = rounds;
+		writers[t].ok = false;
+		readers[t].fd = pair[1];
+	}
+	for ( int t = 0; t < num_threads; ++t ) {
+		pthread_t tid;
+		pthread_create( &tid, NULL, reader_main, &readers[t] );
+		threads.push_back( tid );
+		pthread_create( &tid, NULL, writer_main, &writers[t] );
+		threads.push_back( tid );
+	}
+
+	int churned = 0;
+	if ( churn ) {
+		ReliSock out, in;
+		if ( connect_pair( out, in ) ) {
+			for ( int i = 0; writers_running > 0; i = (i + 1) % NUM_ADS ) {
+				ClassAd ad;
+				make_ad_text( i, ad );
+				delete cache_ad( out, in, ad );
+				++churned;
+			}
+		}
+	}
+
+	for ( size_t i = 0; i < threads.size(); ++i ) {
+		pthread_join( threads[i], NULL );
+	}
+	std::vector<std::string> result;
+	for ( int t = 0; t < num_threads; ++t ) {
+		if ( ! writers[t].ok ) {
+			check_failed( "thread %d could not send the ads", t );
+		}
+		result.push_back( readers[t].data );
+	}
+	if ( churn && churned == 0 ) {
+		check_failed( "no ads were read into the cache while the threads ran" );
+	}
+	return result;
+}
+
+// Reads back one round of ads sent by a single writer, and checks that
+// each is the ad that was sent, less what its options leave out.
+static void
+check_round_trip( const char *name, const std::vector<ClassAd *> &ads, bool binary )
+{
+	int pair[2];
+	if ( socketpair( AF_UNIX, SOCK_STREAM, 0, pair ) != 0 ) {
+		check_failed( "socketpair failed: %s", strerror( errno ) );
+		return;
+	}
+	Writer w;
+	w.ads = &ads;
+	w.fd = pair[0];
+	w.binary = binary;
+	w.rounds = 1;
+	w.ok = false;
+	writers_running = 1;
+	pthread_t tid;
+	pthread_create( &tid, NULL, writer_main, &w );
+
+	ReliSock in;
+	in.assignDomainSocket( pair[1] );
+	in.decode();
+	in.timeout( 20 );
+	classad::ClassAdUnParser unp;
+	int differ = 0;
+	size_t received = 0;
+	int more = 0;
+	while ( in.code( more ) && more ) {
+		ClassAd ad;
+		if ( ! getClassAd( &in, ad ) || received >= ads.size() ) {
+			differ++;
+			break;
+		}
+		const classad::References *whitelist = NULL;
+		int options = put_options( (int)received, whitelist );
+		const ClassAd &sent = *ads[received];
+		for ( auto it = sent.begin(); it != sent.end(); ++it ) {
+			bool expected = ( ! whitelist || whitelist->count( it->first ) ||
+			                  strcasecmp( it->first.c_str(), "Cpus" ) == 0 ||
+			                  strcasecmp( it->first.c_str(), "Memory" ) == 0 ) &&
+				! ( (options & PUT_CLASSAD_NO_PRIVATE) && ClassAdAttributeIsPrivate( it->first ) );
+			classad::ExprTree *got = ad.Lookup( it->first );
+			std::string want_str, got_str;
+			unp.Unparse( want_str, it->second );
+			if ( got ) {
+				unp.Unparse( got_str, got );
+			}
+			if ( (got != NULL) != expected || (got && got_str != want_str) ) {
+				if ( differ++ < 3 ) {
+					check_failed( "%s: ad %d, %s = %s, received %s", name, (int)received,
+						it->first.c_str(), want_str.c_str(), got ? got_str.c_str() : "nothing" );
+				}
+			}
+		}
+		received++;
+	}
+	in.end_of_message();
+	in.close();
+	pthread_join( tid, NULL );
+	if ( w.ok && received == ads.size() && differ == 0 ) {
+		check_passed( "%s: one thread sends the ads intact", name );
+	} else if ( differ == 0 ) {
+		check_failed( "%s: %d of %d ads received", name, (int)received, (int)ads.size() );
+	}
+}
+
+static void
+test_threads( const char *name, const std::vector<ClassAd *> &ads, bool binary )
+{
+	check_round_trip( name, ads, binary );
+
+	std::vector<std::string> single = send_ads( ads, binary, 1, 1, false );
+	std::string expected = single[0];
+	if ( expected.size() < ads.size() * 100 ) {
+		check_failed( "%s: one thread sent only %d bytes", name, (int)expected.size() );
+		return;
+	}
+
+	const int rounds = 10;
+	const int thread_counts[] = { 2, 8 };
+	for ( size_t c = 0; c < sizeof(thread_counts) / sizeof(thread_counts[0]); ++c ) {
+		int n = thread_counts[c];
+		std::vector<std::string> sent = send_ads( ads, binary, n, rounds, true );
+		int differ = 0;
+		for ( int t = 0; t < n; ++t ) {
+			bool same = sent[t].size() == expected.size() * rounds;
+			for ( int r = 0; same && r < rounds; ++r ) {
+				same = sent[t].compare( r * expected.size(), expected.size(), expected ) == 0;
+			}
+			if ( ! same ) {
+				check_failed( "%s: thread %d of %d sent %d bytes that differ from one thread's %d",
+					name, t, n, (int)sent[t].size(), (int)( expected.size() * rounds ) );
+				differ++;
+			}
+		}
+		if ( differ == 0 ) {
+			check_passed( "%s: %d threads at once send what one thread does", name, n );
+		}
+	}
+}
+
+int
+main( int /*argc*/, char ** /*argv*/ )
+{
+	signal( SIGPIPE, SIG_IGN );
+	dprintf_make_thread_safe();
+
+		// Requirements brings in Memory and Cpus, Capability is private
+	projection.insert( ATTR_NAME );
+	projection.insert( ATTR_REQUIREMENTS );
+	projection.insert( ATTR_CAPABILITY );
+
+		// the ads of the snapshot, read through the cache
+	std::vector<ClassAd *> ads;
+	{
+		ReliSock out, in;
+		if ( ! connect_pair( out, in ) ) {
+			return check_results();
+		}
+		for ( int i = 0; i < NUM_ADS; ++i ) {
+			ClassAd ad;
+			make_ad_text( i, ad );
+			ClassAd *cached = cache_ad( out, in, ad );
+			if ( ! cached ) {
+				check_failed( "cannot read ad %d into the cache", i );
+				return check_results();
+			}
+			ads.push_back( cached );
+		}
+	}
+
+	test_threads( "old format", ads, false );
+	test_threads( "binary format", ads, true );
+
+	for ( size_t i = 0; i < ads.size(); ++i ) {
+		delete ads[i];
+	}
+	return check_results();
+}
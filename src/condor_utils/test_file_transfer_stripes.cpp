@@ -0,0 +1,185 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for moving a file striped across parallel streams (see
+// FILE_TRANSFER_PARALLEL_STREAMS).  Checks how files are split into
+// stripes, then sends files over socketpairs from a child process and
+// checks that what arrives is the same, and that a short file or a
+// failed write are reported the way FileTransfer expects.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "reli_sock.h"
+#include "dc_transfer_queue.h"
+#include "file_transfer_stripes.h"
+#include "test_check.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+static const char *src_file = "test_file_transfer_stripes.src";
+static const char *dst_file = "test_file_transfer_stripes.dst";
+static const int num_streams = 3;
+static const int timeout = 20;
+
+static void
+test_split( filesize_t size )
+{
+	std::vector<int> socks = { 10, 11, 12 };
+	std::vector<ParallelStripe> stripes = SplitIntoStripes( socks, size );
+	std::string name = "split " + std::to_string( (long long)size ) + " bytes";
+
+	bool ok = stripes.size() == socks.size();
+	filesize_t offset = 0;
+	for ( size_t ix = 0; ok && ix < stripes.size(); ++ix ) {
+		ok = stripes[ix].sock == socks[ix] && stripes[ix].offset == offset &&
+			stripes[ix].end >= stripes[ix].offset &&
+			(stripes[ix].end == size || stripes[ix].end % PARALLEL_CHUNK == 0);
+		offset = stripes[ix].end;
+	}
+	check( name + " into contiguous aligned stripes", ok && offset == size );
+}
+
+// A file of the given size where every byte depends on its offset.
+static void
+write_file( const char *name, filesize_t size )
+{
+	FILE *fp = safe_fopen_wrapper_follow( name, "w" );
+	for ( filesize_t ix = 0; ix < size; ++ix ) {
+		fputc( (int)((ix * 131 + ix / 4093) & 0xff), fp );
+	}
+	fclose( fp );
+}
+
+static bool
+same_files( const char *a, const char *b )
+{
+	FILE *fa = safe_fopen_wrapper_follow( a, "r" );
+	FILE *fb = safe_fopen_wrapper_follow( b, "r" );
+	bool same = fa && fb;
+	while ( same ) {
+		int ca = fgetc( fa );
+		int cb = fgetc( fb );
+		if ( ca != cb ) same = false;
+		if ( ca == EOF ) break;
+	}
+	if ( fa ) fclose( fa );
+	if ( fb ) fclose( fb );
+	return same;
+}
+
+// Sends size bytes of the source file from a child process over
+// socketpairs and receives them into recv_fd.  The sender is told the
+// file is size bytes whether it is or not.  Returns what the receiver
+// got from MoveParallelStripes(), and the sender's in send_rc.
+static int
+transfer( filesize_t size, int recv_fd, int &send_rc )
+{
+	TransferQueueContactInfo contact;
+	DCTransferQueue xfer_queue( contact );
+	std::vector<int> send_socks, recv_socks;
+	for ( int ix = 0; ix < num_streams; ++ix ) {
+		int pair[2];
+		if ( socketpair( AF_UNIX, SOCK_STREAM, 0, pair ) != 0 ) {
+			fprintf( stderr, "socketpair failed: %s\n", strerror( errno ) );
+			exit( 1 );
+		}
+		send_socks.push_back( pair[0] );
+		recv_socks.push_back( pair[1] );
+	}
+
+	pid_t pid = fork();
+	if ( pid == 0 ) {
+		for ( int sock : recv_socks ) close( sock );
+		int fd = safe_open_wrapper_follow( src_file, O_RDONLY );
+		std::vector<ParallelStripe> stripes = SplitIntoStripes( send_socks, size );
+		int rc = MoveParallelStripes( stripes, fd, true, timeout, xfer_queue );
+		_exit( rc == 0 ? 0 : 1 );
+	}
+	for ( int sock : send_socks ) close( sock );
+
+	std::vector<ParallelStripe> stripes = SplitIntoStripes( recv_socks, size );
+	int rc = MoveParallelStripes( stripes, recv_fd, false, timeout, xfer_queue );
+	for ( int sock : recv_socks ) close( sock );
+
+	int status = 0;
+	waitpid( pid, &status, 0 );
+	send_rc = (WIFEXITED( status ) && WEXITSTATUS( status ) == 0) ? 0 : -1;
+	return rc;
+}
+
+static void
+test_round_trip( filesize_t size )
+{
+	std::string name = "send " + std::to_string( (long long)size ) + " bytes";
+	write_file( src_file, size );
+	unlink( dst_file );
+	int fd = safe_open_wrapper_follow( dst_file, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	int send_rc = -1;
+	int rc = transfer( size, fd, send_rc );
+	close( fd );
+	check( name + " over " + std::to_string( num_streams ) + " streams",
+		rc == 0 && send_rc == 0 && same_files( src_file, dst_file ) );
+}
+
+static void
+test_failures()
+{
+	filesize_t size = 2 * PARALLEL_CHUNK + 1000;
+	int send_rc = 0;
+
+		// the file got shorter since its size was sent
+	write_file( src_file, size - 5000 );
+	unlink( dst_file );
+	int fd = safe_open_wrapper_follow( dst_file, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	int rc = transfer( size, fd, send_rc );
+	close( fd );
+	check( "a short file fails both sides", rc == -1 && send_rc == -1 );
+
+		// the receiver can't write, but still takes all of the data so
+		// the sender can finish
+	write_file( src_file, size );
+	fd = safe_open_wrapper_follow( src_file, O_RDONLY );
+	rc = transfer( size, fd, send_rc );
+	close( fd );
+	check( "a failed write is reported to the receiver only", rc == GET_FILE_WRITE_FAILED && send_rc == 0 );
+
+		// no file to receive into
+	rc = transfer( size, -1, send_rc );
+	check( "data can be thrown away", rc == 0 && send_rc == 0 );
+}
+
+int
+main( int /*argc*/, char ** /*argv*/ )
+{
+	filesize_t sizes[] = { 0, 1, PARALLEL_CHUNK - 1, PARALLEL_CHUNK, 3 * PARALLEL_CHUNK + 12345, 7 * PARALLEL_CHUNK };
+	for ( filesize_t size : sizes ) {
+		test_split( size );
+	}
+	for ( filesize_t size : sizes ) {
+		test_round_trip( size );
+	}
+	test_failures();
+
+	unlink( src_file );
+	unlink( dst_file );
+
+	return check_results();
+}
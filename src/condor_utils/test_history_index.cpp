@@ -0,0 +1,211 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for the history index (see ENABLE_HISTORY_INDEX).  Parses well
+// formed and malformed index lines, and evaluates constraints against index
+// entries, checking which ones the index can answer and which ones need the
+// job ad to be read.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_classad.h"
+#include "compat_classad_util.h"
+#include "historyIndex.h"
+#include "test_check.h"
+
+#include <stdio.h>
+#include <string>
+
+static const char *
+result_name( HistoryIndexResult result )
+{
+	switch ( result ) {
+	case HISTORY_INDEX_FALSE: return "false";
+	case HISTORY_INDEX_TRUE: return "true";
+	case HISTORY_INDEX_NOT_TRUE: return "not true";
+	case HISTORY_INDEX_UNKNOWN: return "unknown";
+	}
+	return "?";
+}
+
+static void
+test_parse()
+{
+	struct {
+		const char *line;
+		bool ok;
+		long long offset, end;
+		int cluster, proc;
+		long long completion;
+		const char *owner;
+	} tests[] = {
+		{ "0 1234 12 3 1600000000 alice\n", true, 0, 1234, 12, 3, 1600000000, "alice" },
+		{ "1234 2000 -1 -1 -1 ?\n", true, 1234, 2000, -1, -1, -1, "?" },
+		{ "5 6 1 0 7 alice@example.com\n", true, 5, 6, 1, 0, 7, "alice@example.com" },
+		{ "0 1234  12  3  1600000000   alice\n", true, 0, 1234, 12, 3, 1600000000, "alice" },
+
+		{ "", false },
+		{ "\n", false },
+		{ "0 1234 12 3 1600000000\n", false },        // no owner
+		{ "0 1234 12 3 1600000000 \n", false },       // empty owner
+		{ "0 1234 12 3 1600000000 alice", false },    // cut off before the newline
+		{ "0 1234 12 3\n", false },
+		{ "0 1234 x 3 1600000000 alice\n", false },
+		{ "-1 1234 12 3 1600000000 alice\n", false }, // negative offset
+		{ "1234 1234 12 3 1600000000 alice\n", false }, // empty ad
+		{ "1234 100 12 3 1600000000 alice\n", false },  // end before offset
+	};
+
+	for ( auto & test : tests ) {
+		HistoryIndexEntry entry;
+		bool ok = parseHistoryIndexEntry( test.line, entry );
+		std::string text = test.line;
+		if ( ! text.empty() && text[text.size() - 1] == '\n' ) text.erase( text.size() - 1 );
+		std::string name = "parse '" + text + "'";
+		if ( ok != test.ok ) {
+			check_failed( "%s: %s", name.c_str(), ok ? "parsed" : "did not parse" );
+		} else if ( ok && (entry.offset != test.offset || entry.end != test.end ||
+		                   entry.cluster != test.cluster || entry.proc != test.proc ||
+		                   entry.completion != test.completion || entry.owner != test.owner) ) {
+			check_failed( "%s: got %lld %lld %d %d %lld '%s'", name.c_str(),
+				entry.offset, entry.end, entry.cluster, entry.proc, entry.completion, entry.owner.c_str() );
+		} else {
+			check_passed( "%s", name.c_str() );
+		}
+	}
+
+		// what formatHistoryIndexEntry() writes parses back the same
+	HistoryIndexEntry entry, parsed;
+	entry.offset = 1LL << 33;
+	entry.end = entry.offset + 4096;
+	entry.cluster = 123456;
+	entry.proc = 0;
+	entry.completion = 1600000000;
+	std::string line;
+	formatHistoryIndexEntry( line, entry );
+	bool ok = parseHistoryIndexEntry( line.c_str(), parsed );
+	if ( ! ok || parsed.offset != entry.offset || parsed.end != entry.end || parsed.cluster != entry.cluster ||
+	     parsed.proc != entry.proc || parsed.completion != entry.completion || parsed.owner != "?" ) {
+		check_failed( "round trip of an entry without an owner: %s", line.c_str() );
+	} else {
+		check_passed( "round trip of an entry without an owner" );
+	}
+}
+
+static void
+check_eval( const HistoryIndexEntry & entry, const char *constraint, HistoryIndexResult expected )
+{
+	classad::ExprTree *expr = NULL;
+	if ( ParseClassAdRvalExpr( constraint, expr ) != 0 ) {
+		check_failed( "cannot parse %s", constraint );
+		return;
+	}
+	HistoryIndexResult result = EvalHistoryIndexExpr( expr, entry );
+	if ( result != expected ) {
+		check_failed( "%s is %s, expected %s", constraint, result_name( result ), result_name( expected ) );
+	} else {
+		check_passed( "%s is %s", constraint, result_name( result ) );
+	}
+	delete expr;
+}
+
+static void
+test_eval()
+{
+	HistoryIndexEntry entry;
+	parseHistoryIndexEntry( "0 1234 12 3 1600000000 alice\n", entry );
+
+		// comparisons the index can answer
+	check_eval( entry, "ClusterId == 12", HISTORY_INDEX_TRUE );
+	check_eval( entry, "12 == ClusterId", HISTORY_INDEX_TRUE );
+	check_eval( entry, "clusterid == 12.0", HISTORY_INDEX_TRUE );
+	check_eval( entry, "ClusterId == 13", HISTORY_INDEX_FALSE );
+	check_eval( entry, "ClusterId =!= 13", HISTORY_INDEX_TRUE );
+	check_eval( entry, "ProcId < 5", HISTORY_INDEX_TRUE );
+	check_eval( entry, "5 < ProcId", HISTORY_INDEX_FALSE );
+	check_eval( entry, "3 >= ProcId", HISTORY_INDEX_TRUE );
+	check_eval( entry, "ProcId > 3", HISTORY_INDEX_FALSE );
+	check_eval( entry, "CompletionDate >= 1600000000", HISTORY_INDEX_TRUE );
+	check_eval( entry, "CompletionDate < 1500000000.5", HISTORY_INDEX_FALSE );
+	check_eval( entry, "Owner == \"ALICE\"", HISTORY_INDEX_TRUE );
+	check_eval( entry, "Owner != \"bob\"", HISTORY_INDEX_TRUE );
+	check_eval( entry, "Owner =?= \"alice\"", HISTORY_INDEX_TRUE );
+	check_eval( entry, "Owner =?= \"ALICE\"", HISTORY_INDEX_FALSE );
+	check_eval( entry, "(Owner == \"bob\")", HISTORY_INDEX_FALSE );
+	check_eval( entry, "true", HISTORY_INDEX_TRUE );
+	check_eval( entry, "false", HISTORY_INDEX_FALSE );
+
+		// combinations of those
+	check_eval( entry, "ClusterId == 12 && ProcId == 3", HISTORY_INDEX_TRUE );
+	check_eval( entry, "ClusterId == 12 && ProcId == 4", HISTORY_INDEX_FALSE );
+	check_eval( entry, "ClusterId == 99 || Owner == \"alice\"", HISTORY_INDEX_TRUE );
+	check_eval( entry, "ClusterId == 99 || ProcId == 99", HISTORY_INDEX_FALSE );
+	check_eval( entry, "!(ClusterId == 99)", HISTORY_INDEX_TRUE );
+	check_eval( entry, "!(Owner == \"alice\" && ProcId == 3)", HISTORY_INDEX_FALSE );
+
+		// comparisons the index can't answer
+	check_eval( entry, "JobStatus == 4", HISTORY_INDEX_UNKNOWN );
+	check_eval( entry, "ClusterId == ProcId", HISTORY_INDEX_UNKNOWN );
+	check_eval( entry, "ClusterId + 1 == 13", HISTORY_INDEX_UNKNOWN );
+	check_eval( entry, "MY.ClusterId == 12", HISTORY_INDEX_UNKNOWN );
+	check_eval( entry, "ClusterId =?= 12.0", HISTORY_INDEX_UNKNOWN );
+	check_eval( entry, "ClusterId == \"12\"", HISTORY_INDEX_UNKNOWN );
+	check_eval( entry, "Owner == 12", HISTORY_INDEX_UNKNOWN );
+	check_eval( entry, "Owner < \"bob\"", HISTORY_INDEX_UNKNOWN );
+	check_eval( entry, "regexp(\"^al\", Owner)", HISTORY_INDEX_UNKNOWN );
+	check_eval( entry, "!(JobStatus == 4)", HISTORY_INDEX_UNKNOWN );
+
+		// and combined with ones it can, which follow the ClassAd rules for
+		// undefined and error.  error && false is error, which is not true,
+		// and error || true is error, so an unknown left side can't make
+		// || true.
+	check_eval( entry, "ClusterId == 12 && JobStatus == 4", HISTORY_INDEX_UNKNOWN );
+	check_eval( entry, "ClusterId == 13 && JobStatus == 4", HISTORY_INDEX_FALSE );
+	check_eval( entry, "JobStatus == 4 && ClusterId == 13", HISTORY_INDEX_NOT_TRUE );
+	check_eval( entry, "ClusterId == 12 || JobStatus == 4", HISTORY_INDEX_TRUE );
+	check_eval( entry, "JobStatus == 4 || ClusterId == 12", HISTORY_INDEX_UNKNOWN );
+	check_eval( entry, "JobStatus == 4 || ClusterId == 13", HISTORY_INDEX_UNKNOWN );
+	check_eval( entry, "ClusterId == 13 || (JobStatus == 4 && ProcId == 9)", HISTORY_INDEX_NOT_TRUE );
+	check_eval( entry, "!(JobStatus == 4 && ClusterId == 13)", HISTORY_INDEX_UNKNOWN );
+
+		// an ad without the attributes in the index
+	HistoryIndexEntry missing;
+	parseHistoryIndexEntry( "1234 2000 -1 -1 -1 ?\n", missing );
+	check_eval( missing, "ClusterId == 12", HISTORY_INDEX_UNKNOWN );
+	check_eval( missing, "CompletionDate > 0", HISTORY_INDEX_UNKNOWN );
+	check_eval( missing, "Owner == \"alice\"", HISTORY_INDEX_UNKNOWN );
+	check_eval( missing, "Owner =?= \"?\"", HISTORY_INDEX_UNKNOWN );
+	check_eval( missing, "ClusterId == 12 || true", HISTORY_INDEX_UNKNOWN );
+	check_eval( missing, "true || ClusterId == 12", HISTORY_INDEX_TRUE );
+
+	if ( EvalHistoryIndexExpr( NULL, entry ) != HISTORY_INDEX_UNKNOWN ) {
+		check_failed( "no expression is not unknown" );
+	} else {
+		check_passed( "no expression is unknown" );
+	}
+}
+
+int
+main( int /*argc*/, char ** /*argv*/ )
+{
+	test_parse();
+	test_eval();
+
+	return check_results();
+}
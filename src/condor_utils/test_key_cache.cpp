@@ -0,0 +1,251 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for the index and the expiration queue of the security session
+// cache, KeyCache.  Sessions are found by peer address, by server command
+// socket and by server process, including a session whose peer is the
+// server itself, and can be removed through the index the way SecMan
+// removes them.  getExpiredKeys() must list the sessions that are due,
+// soonest first, follow changes to their expiration and leases that were
+// renewed, and the counters must count each lookup and each expired
+// session once.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_classad.h"
+#include "condor_attributes.h"
+#include "KeyCache.h"
+#include "test_check.h"
+
+#include <string>
+#include <vector>
+
+static const char *server_a = "<10.0.0.1:9618>";
+static const char *server_b = "<10.0.0.2:9618>";
+static const char *client_c = "<10.0.0.3:40000>";
+
+static void
+add_session( KeyCache &cache, const char *id, const char *peer, const char *server,
+             const char *parent_id, int server_pid, int expiration, int lease = 0 )
+{
+	condor_sockaddr addr;
+	if ( peer ) {
+		addr.from_sinful( peer );
+	}
+	ClassAd policy;
+	if ( server ) {
+		policy.Assign( ATTR_SEC_SERVER_COMMAND_SOCK, server );
+	}
+	if ( parent_id ) {
+		policy.Assign( ATTR_SEC_PARENT_UNIQUE_ID, parent_id );
+		policy.Assign( ATTR_SEC_SERVER_PID, server_pid );
+	}
+	KeyCacheEntry entry( id, peer ? &addr : NULL, NULL, &policy, expiration, lease );
+	if ( ! cache.insert( entry ) ) {
+		check_failed( "cannot insert session %s", id );
+	}
+}
+
+// The session ids of a list, in order, or "none".
+static std::string
+ids( StringList *list )
+{
+	if ( ! list ) {
+		return "none";
+	}
+	std::string result;
+	list->rewind();
+	const char *id;
+	while ( (id = list->next()) ) {
+		if ( ! result.empty() ) {
+			result += ",";
+		}
+		result += id;
+	}
+	delete list;
+	return result;
+}
+
+// The ids of a list, sorted, since the index lists them in no order.
+static std::string
+sorted_ids( StringList *list )
+{
+	if ( list ) {
+		list->qsort();
+	}
+	return ids( list );
+}
+
+static void
+check_ids( const char *name, const std::string &got, const char *expected )
+{
+	if ( got == expected ) {
+		check_passed( "%s", name );
+	} else {
+		check_failed( "%s: got %s, expected %s", name, got.c_str(), expected );
+	}
+}
+
+static void
+test_index()
+{
+	KeyCache cache;
+	add_session( cache, "s1", client_c, server_a, "parentA", 100, 0 );
+	add_session( cache, "s2", client_c, server_b, "parentB", 200, 0 );
+	add_session( cache, "s3", server_a, NULL, NULL, 0, 0 );
+		// the peer is the server itself, so both addresses are the same
+	add_session( cache, "s4", server_b, server_b, "parentB", 200, 0 );
+	add_session( cache, "s5", NULL, server_a, "parentA", 101, 0 );
+
+	check_ids( "sessions by peer address", sorted_ids( cache.getKeysForPeerAddress( client_c ) ), "s1,s2" );
+	check_ids( "sessions by server or peer address",
+		sorted_ids( cache.getKeysForPeerAddress( server_a ) ), "s1,s3,s5" );
+	check_ids( "a session whose peer is the server is listed once",
+		sorted_ids( cache.getKeysForPeerAddress( server_b ) ), "s2,s4" );
+	check_ids( "sessions by server process",
+		sorted_ids( cache.getKeysForProcess( "parentB", 200 ) ), "s2,s4" );
+	check_ids( "a process with no sessions", ids( cache.getKeysForProcess( "parentA", 102 ) ), "none" );
+	check_ids( "an address with no sessions", ids( cache.getKeysForPeerAddress( "<10.0.0.9:1>" ) ), "none" );
+
+		// remove the sessions of server_b the way SecMan invalidates
+		// the sessions of a peer
+	StringList *keys = cache.getKeysForPeerAddress( server_b );
+	keys->rewind();
+	const char *id;
+	while ( (id = keys->next()) ) {
+		cache.remove( id );
+	}
+	delete keys;
+	check( "removing by address leaves the other sessions", cache.count() == 3 );
+	check_ids( "removed sessions leave the index of their server",
+		ids( cache.getKeysForPeerAddress( server_b ) ), "none" );
+	check_ids( "removed sessions leave the index of their process",
+		ids( cache.getKeysForProcess( "parentB", 200 ) ), "none" );
+	check_ids( "removed sessions leave the index of their peer",
+		sorted_ids( cache.getKeysForPeerAddress( client_c ) ), "s1" );
+
+	KeyCache copy( cache );
+	check_ids( "a copy of the cache has the same index",
+		sorted_ids( copy.getKeysForPeerAddress( server_a ) ), "s1,s3,s5" );
+
+	cache.remove( "s3" );
+	check_ids( "removing one session leaves the others of its address",
+		sorted_ids( cache.getKeysForPeerAddress( server_a ) ), "s1,s5" );
+	add_session( cache, "s4", server_b, server_b, NULL, 0, 0 );
+	check_ids( "a session whose peer is the server can be inserted again",
+		ids( cache.getKeysForPeerAddress( server_b ) ), "s4" );
+	check( "and removed again", cache.remove( "s4" ) && ! cache.remove( "s4" ) &&
+		ids( cache.getKeysForPeerAddress( server_b ) ) == "none" );
+}
+
+static void
+test_expiration()
+{
+	KeyCache cache;
+	time_t now = time( NULL );
+	add_session( cache, "later", client_c, NULL, NULL, 0, now + 1000 );
+	add_session( cache, "five", client_c, NULL, NULL, 0, now - 5 );
+	add_session( cache, "never", client_c, NULL, NULL, 0, 0 );
+	add_session( cache, "ten", client_c, NULL, NULL, 0, now - 10 );
+	add_session( cache, "one", client_c, NULL, NULL, 0, now - 1 );
+
+	check_ids( "expired sessions are listed soonest first", ids( cache.getExpiredKeys() ), "ten,five,one" );
+	check_ids( "listing them does not remove them", ids( cache.getExpiredKeys() ), "ten,five,one" );
+	check( "listing them does not count them", cache.expiredCount() == 0 && cache.count() == 5 );
+
+	KeyCacheEntry *e = NULL;
+	cache.lookup( "later", e );
+	e->setExpiration( now - 20 );
+	cache.expirationChanged( e );
+	cache.lookup( "five", e );
+	e->setExpiration( 0 );
+	cache.expirationChanged( e );
+	cache.lookup( "never", e );
+	e->setExpiration( now - 3 );
+	cache.expirationChanged( e );
+	check_ids( "changes to expirations are followed", ids( cache.getExpiredKeys() ), "later,ten,never,one" );
+
+	cache.lookup( "ten", e );
+	cache.expire( e );
+	cache.remove( "one" );
+	cache.remove( "five" );
+	check( "expired sessions are counted once as they are removed",
+		cache.expiredCount() == 2 && cache.count() == 2 );
+	check_ids( "removed sessions leave the queue", ids( cache.getExpiredKeys() ), "later,never" );
+
+	KeyCache copy( cache );
+	check_ids( "a copy of the cache has the same queue", ids( copy.getExpiredKeys() ), "later,never" );
+	check( "a copy starts its own counters", copy.expiredCount() == 0 );
+
+	cache.clear();
+	check( "clear() empties the queue", cache.count() == 0 && ids( cache.getExpiredKeys() ) == "" );
+}
+
+static void
+test_lease()
+{
+	KeyCache cache;
+	add_session( cache, "leased", client_c, NULL, NULL, 0, 0, 1 );
+	add_session( cache, "other", client_c, NULL, NULL, 0, time( NULL ) + 1000, 1 );
+
+	KeyCacheEntry *e = NULL;
+	time_t due = time( NULL ) + 1;
+	while ( time( NULL ) <= due ) {
+		sleep( 1 );
+	}
+		// both are due at the same time, so in no particular order
+	check_ids( "sessions whose lease ran out are listed", sorted_ids( cache.getExpiredKeys() ), "leased,other" );
+
+	cache.lookup( "leased", e );
+	e->renewLease();
+	check_ids( "a renewed lease is requeued, not listed", ids( cache.getExpiredKeys() ), "other" );
+
+	due = time( NULL ) + 1;
+	while ( time( NULL ) <= due ) {
+		sleep( 1 );
+	}
+	check_ids( "it is listed once the renewed lease runs out", ids( cache.getExpiredKeys() ), "other,leased" );
+}
+
+static void
+test_counters()
+{
+	KeyCache cache;
+	add_session( cache, "s1", client_c, server_a, NULL, 0, 0 );
+	KeyCacheEntry *e = NULL;
+	cache.lookup( "s1", e );
+	cache.lookup( "s1", e );
+	cache.lookup( "nope", e );
+	check( "lookups count hits and misses", cache.lookupHits() == 2 && cache.lookupMisses() == 1 );
+
+	cache.remove( "s1" );
+	check( "removing a session that has not expired does not count it", cache.expiredCount() == 0 );
+	cache.lookup( "s1", e );
+	check( "a removed session is a miss", cache.lookupHits() == 2 && cache.lookupMisses() == 2 );
+}
+
+int
+main( int /*argc*/, char ** /*argv*/ )
+{
+	test_index();
+	test_expiration();
+	test_counters();
+	test_lease();
+	return check_results();
+}
@@ -0,0 +1,511 @@
+/***************************************************************
+ *
+ * Copyright (C) 2019, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for the Selector, with select() and with a persistent (epoll)
+// Selector.  Checks that added fds are reported when they are ready and
+// only then, that deleted and dropped fds are not, that a wait with
+// nothing ready times out, and that a persistent Selector follows fds
+// that are closed and reused, including when it is not told about it.
+// Then, as a stress test, watches a growing number of pipes, a few of
+// which are readable, the way DaemonCore::Driver() does: add all the fds,
+// wait, then check every fd for readiness.  Reports the cost of one such
+// wakeup with select() and with a persistent Selector, and fails if either
+// one reports the wrong fds as ready.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "selector.h"
+#include "test_check.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+static double
+now_usec()
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+static const char *
+mode_name( bool persistent )
+{
+	return persistent ? "epoll" : "select";
+}
+
+// Makes a Selector in the given mode, returns false if it can't.
+static bool
+make_selector( Selector &selector, bool persistent )
+{
+	if ( persistent && !selector.set_persistent( true ) ) {
+		printf( "skipping epoll tests, a persistent Selector is not available\n" );
+		return false;
+	}
+	return true;
+}
+
+static bool
+make_pipe( int p[2] )
+{
+	if ( pipe( p ) < 0 ) {
+		check_failed( "pipe failed: %s", strerror( errno ) );
+		return false;
+	}
+	return true;
+}
+
+static bool
+write_byte( int fd )
+{
+	if ( write( fd, "x", 1 ) != 1 ) {
+		check_failed( "write to pipe failed: %s", strerror( errno ) );
+		return false;
+	}
+	return true;
+}
+
+static void
+read_byte( int fd )
+{
+	char c;
+	if ( read( fd, &c, 1 ) != 1 ) {
+		check_failed( "read from pipe failed: %s", strerror( errno ) );
+	}
+}
+
+// Waits for the given fd, which is the only one that may be ready, and
+// returns whether it was reported ready for reading.  For a persistent
+// Selector, also checks that ready_fds() agrees with fd_ready().
+static bool
+wait_for( Selector &selector, int fd, long timeout_usec = 0 )
+{
+	selector.reset();
+	selector.add_fd( fd, Selector::IO_READ );
+	selector.set_timeout( 0, timeout_usec );
+	selector.execute();
+	bool ready = selector.has_ready() && selector.fd_ready( fd, Selector::IO_READ );
+	if ( selector.is_persistent() ) {
+		const std::vector<int> &fds = selector.ready_fds();
+		bool listed = fds.size() == 1 && fds[0] == fd;
+		if ( listed != ready ) {
+			check_failed( "fd %d is %sready, but ready_fds() has %d fds", fd, ready ? "" : "not ",
+						  (int)fds.size() );
+		}
+	}
+	return ready;
+}
+
+static void
+test_add( bool persistent )
+{
+	Selector selector;
+	int p[2], q[2];
+	if ( !make_selector( selector, persistent ) || !make_pipe( p ) || !make_pipe( q ) ) {
+		return;
+	}
+	std::string mode = mode_name( persistent );
+
+	selector.add_fd( p[0], Selector::IO_READ );
+	selector.add_fd( q[0], Selector::IO_READ );
+	selector.set_timeout( 0 );
+	selector.execute();
+	check( mode + ": empty pipes are not reported", selector.timed_out() && !selector.has_ready() );
+
+	write_byte( q[1] );
+	selector.reset();
+	selector.add_fd( p[0], Selector::IO_READ );
+	selector.add_fd( q[0], Selector::IO_READ );
+	selector.add_fd( p[1], Selector::IO_WRITE );
+	selector.set_timeout( 0 );
+	selector.execute();
+	check( mode + ": a readable and a writable pipe are reported",
+		   selector.has_ready() && selector.select_retval() == 2 &&
+		   selector.fd_ready( q[0], Selector::IO_READ ) &&
+		   selector.fd_ready( p[1], Selector::IO_WRITE ) &&
+		   !selector.fd_ready( p[0], Selector::IO_READ ) &&
+		   !selector.fd_ready( q[0], Selector::IO_WRITE ) );
+
+		// the persistent Selector keeps q[0] registered, and must still
+		// report it while it stays readable
+	check( mode + ": a pipe that stays readable is reported again", wait_for( selector, q[0] ) );
+	read_byte( q[0] );
+	check( mode + ": a drained pipe is not reported", !wait_for( selector, q[0] ) );
+
+		// a hangup makes the read end readable, as with select()
+	close( q[1] );
+	check( mode + ": a pipe with no writer is reported", wait_for( selector, q[0] ) );
+
+	Selector::fd_closing( p[0] );
+	Selector::fd_closing( p[1] );
+	Selector::fd_closing( q[0] );
+	close( p[0] );
+	close( p[1] );
+	close( q[0] );
+}
+
+static void
+test_remove( bool persistent )
+{
+	Selector selector;
+	int p[2], q[2];
+	if ( !make_selector( selector, persistent ) || !make_pipe( p ) || !make_pipe( q ) ) {
+		return;
+	}
+	std::string mode = mode_name( persistent );
+
+	write_byte( p[1] );
+	write_byte( q[1] );
+
+	selector.add_fd( p[0], Selector::IO_READ );
+	selector.add_fd( q[0], Selector::IO_READ );
+	selector.delete_fd( p[0], Selector::IO_READ );
+	selector.set_timeout( 0 );
+	selector.execute();
+	check( mode + ": a deleted fd is not reported",
+		   selector.fd_ready( q[0], Selector::IO_READ ) &&
+		   !selector.fd_ready( p[0], Selector::IO_READ ) );
+
+		// p[0] is registered now, then not added after the next reset()
+	selector.reset();
+	selector.add_fd( p[0], Selector::IO_READ );
+	selector.add_fd( q[0], Selector::IO_READ );
+	selector.set_timeout( 0 );
+	selector.execute();
+	bool both = selector.fd_ready( p[0], Selector::IO_READ ) && selector.fd_ready( q[0], Selector::IO_READ );
+	selector.reset();
+	selector.add_fd( q[0], Selector::IO_READ );
+	selector.set_timeout( 0 );
+	selector.execute();
+	check( mode + ": an fd that is not added again after reset() is not reported",
+		   both && selector.select_retval() == 1 &&
+		   selector.fd_ready( q[0], Selector::IO_READ ) &&
+		   !selector.fd_ready( p[0], Selector::IO_READ ) );
+
+	Selector::fd_closing( p[0] );
+	Selector::fd_closing( q[0] );
+	close( p[0] );
+	close( p[1] );
+	close( q[0] );
+	close( q[1] );
+}
+
+static void
+test_timeout( bool persistent )
+{
+	Selector selector;
+	int p[2];
+	if ( !make_selector( selector, persistent ) || !make_pipe( p ) ) {
+		return;
+	}
+	std::string mode = mode_name( persistent );
+
+	double begin = now_usec();
+	bool ready = wait_for( selector, p[0], 50000 );
+	double waited = now_usec() - begin;
+	check( mode + ": a wait with nothing ready times out after the timeout",
+		   !ready && selector.timed_out() && selector.select_retval() == 0 &&
+		   waited >= 45000 );
+
+		// no fds at all
+	selector.reset();
+	selector.set_timeout( 0, 10000 );
+	selector.execute();
+	check( mode + ": a wait with no fds times out", selector.timed_out() );
+
+		// a byte that arrives during the wait ends it
+	pid_t pid = fork();
+	if ( pid == 0 ) {
+		usleep( 20000 );
+		_exit( write( p[1], "x", 1 ) == 1 ? 0 : 1 );
+	}
+	begin = now_usec();
+	ready = wait_for( selector, p[0], 5000000 );
+	waited = now_usec() - begin;
+	int status = 0;
+	waitpid( pid, &status, 0 );
+	check( mode + ": a wait ends when an fd becomes ready", ready && waited < 4000000 );
+
+	Selector::fd_closing( p[0] );
+	close( p[0] );
+	close( p[1] );
+}
+
+// How the owner of a watched pipe tells the Selector about a change
+enum { REUSE_FD_CLOSING, REUSE_FD_OPENED, KEEP_FD_OPENED };
+
+// Makes a new pipe whose read end has the number fd, returns false if it can't.
+static bool
+reuse_fd( int fd, int q[2] )
+{
+	if ( !make_pipe( q ) ) {
+		return false;
+	}
+	if ( q[0] != fd ) {
+		if ( q[1] == fd ) {
+			q[1] = dup( q[1] );
+		}
+		dup2( q[0], fd );
+		close( q[0] );
+		q[0] = fd;
+	}
+	return true;
+}
+
+// Watches the read end of a pipe with a persistent Selector, then makes a
+// new pipe with the same read fd and checks that a byte written to it is
+// reported.
+static void
+test_fd_reuse( int how )
+{
+	Selector selector;
+	int p[2];
+	if ( !make_selector( selector, true ) || !make_pipe( p ) ) {
+		return;
+	}
+
+	int fd = p[0];
+	if ( wait_for( selector, fd ) ) {
+		check_failed( "empty pipe fd %d was reported", fd );
+	}
+
+	int q[2] = { p[0], p[1] };
+	if ( how == REUSE_FD_CLOSING ) {
+		Selector::fd_closing( fd );
+	}
+	if ( how != KEEP_FD_OPENED ) {
+		close( p[0] );
+		close( p[1] );
+		if ( !reuse_fd( fd, q ) ) {
+			return;
+		}
+	}
+	if ( how != REUSE_FD_CLOSING ) {
+			// what DaemonCore and Sock do when they get a new fd
+		Selector::fd_opened( fd );
+	}
+
+	const char *names[] = {
+		"epoll: a reused fd is reported after fd_closing()",
+		"epoll: a reused fd is reported after fd_opened()",
+		"epoll: an fd is reported after fd_opened() without a reuse",
+	};
+	check( names[how], write_byte( q[1] ) && wait_for( selector, fd ) );
+
+	Selector::fd_closing( fd );
+	close( q[0] );
+	close( q[1] );
+}
+
+// An fd that is closed without a call to fd_closing(), while a copy of it
+// (as a forked child would have) keeps the file open, stays in the epoll
+// set.  The Selector must not report its events, whether the number is
+// unused or was reused for another file.
+static void
+test_stale_fd( bool reuse )
+{
+	Selector selector;
+	int p[2], r[2];
+	if ( !make_selector( selector, true ) || !make_pipe( p ) || !make_pipe( r ) ) {
+		return;
+	}
+
+	int fd = p[0];
+	wait_for( selector, fd );
+	int copy = dup( fd );
+	close( fd );
+	write_byte( p[1] );
+
+	int q[2] = { -1, -1 };
+	if ( reuse ) {
+		if ( !reuse_fd( fd, q ) ) {
+			return;
+		}
+			// what DaemonCore and Sock do when they get a new fd
+		Selector::fd_opened( fd );
+	}
+
+		// watch the new file with that number, or another pipe, twice:
+		// the first wait must get rid of the old file's events
+	int watch = reuse ? fd : r[0];
+	bool reported = false, timed_out = true;
+	for ( int i = 0; i < 2; i++ ) {
+		reported = wait_for( selector, watch, 50000 ) || reported;
+		timed_out = timed_out && selector.timed_out();
+	}
+	if ( reuse ) {
+		check( "epoll: the events of a closed file are not reported for the fd that reused its number",
+			   !reported && timed_out );
+		check( "epoll: the fd that reused the number is still watched",
+			   write_byte( q[1] ) && wait_for( selector, fd ) );
+		Selector::fd_closing( fd );
+		close( q[0] );
+		close( q[1] );
+	} else {
+		check( "epoll: a stale fd that is no longer used does not wake the Selector",
+			   !reported && timed_out );
+	}
+
+	Selector::fd_closing( r[0] );
+	close( copy );
+	close( p[1] );
+	close( r[0] );
+	close( r[1] );
+}
+
+// Returns the average time for one wakeup in microseconds, or -1 if
+// the Selector did not report exactly the readable pipes.
+static double
+time_wakeups( bool persistent, const std::vector<int> &fds, int num_ready, int iterations )
+{
+	Selector selector;
+	if ( persistent && !selector.set_persistent( true ) ) {
+		return 0;
+	}
+
+		// The first pass registers every fd with a persistent Selector,
+		// so it is not timed.
+	double begin = 0;
+	for ( int iter = -1; iter < iterations; iter++ ) {
+		if ( iter == 0 ) {
+			begin = now_usec();
+		}
+		selector.reset();
+		for ( size_t i = 0; i < fds.size(); i++ ) {
+			selector.add_fd( fds[i], Selector::IO_READ );
+		}
+		selector.set_timeout( 0 );
+		selector.execute();
+		if ( selector.failed() ) {
+			check_failed( "%s: execute() failed: %s", mode_name( persistent ),
+						  strerror( selector.select_errno() ) );
+			return -1;
+		}
+
+		int ready = 0;
+		for ( size_t i = 0; i < fds.size(); i++ ) {
+			if ( selector.fd_ready( fds[i], Selector::IO_READ ) ) {
+				if ( (int)i >= num_ready ) {
+					check_failed( "%s: fd %d is not readable, but was reported",
+								  mode_name( persistent ), fds[i] );
+					return -1;
+				}
+				ready++;
+			}
+		}
+		if ( ready != num_ready ) {
+			check_failed( "%s: %d fds reported ready, expected %d",
+						  mode_name( persistent ), ready, num_ready );
+			return -1;
+		}
+	}
+	return ( now_usec() - begin ) / iterations;
+}
+
+int
+main( int argc, char *argv[] )
+{
+	int max_fds = 50000;
+	int num_ready = 10;
+	int iterations = 100;
+
+	for ( int i = 1; i < argc; i++ ) {
+		if ( strcmp( argv[i], "-max" ) == 0 && i + 1 < argc ) {
+			max_fds = atoi( argv[++i] );
+		} else if ( strcmp( argv[i], "-ready" ) == 0 && i + 1 < argc ) {
+			num_ready = atoi( argv[++i] );
+		} else if ( strcmp( argv[i], "-iterations" ) == 0 && i + 1 < argc ) {
+			iterations = atoi( argv[++i] );
+		} else {
+			fprintf( stderr, "usage: %s [-max <fds>] [-ready <fds>] [-iterations <n>]\n", argv[0] );
+			return 1;
+		}
+	}
+	if ( iterations < 1 ) {
+		iterations = 1;
+	}
+
+		// Each pipe takes two descriptors.  This must happen before the
+		// first Selector is made, since it sizes its fd_sets from the limit.
+	struct rlimit rl;
+	if ( getrlimit( RLIMIT_NOFILE, &rl ) == 0 ) {
+		rlim_t want = (rlim_t)max_fds * 2 + 64;
+		if ( rl.rlim_cur < want ) {
+			rl.rlim_cur = ( rl.rlim_max == RLIM_INFINITY || rl.rlim_max > want ) ? want : rl.rlim_max;
+			setrlimit( RLIMIT_NOFILE, &rl );
+		}
+	}
+
+	for ( int persistent = 0; persistent <= 1; persistent++ ) {
+		test_add( persistent );
+		test_remove( persistent );
+		test_timeout( persistent );
+	}
+	for ( int how = REUSE_FD_CLOSING; how <= KEEP_FD_OPENED; how++ ) {
+		test_fd_reuse( how );
+	}
+	test_stale_fd( false );
+	test_stale_fd( true );
+
+	const int sizes[] = { 1000, 5000, 10000, 20000, 50000 };
+	std::vector<int> read_fds;
+	std::vector<int> write_fds;
+
+	printf( "%8s %8s %14s %14s\n", "fds", "ready", "select (us)", "epoll (us)" );
+	for ( size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]) && sizes[s] <= max_fds; s++ ) {
+		while ( (int)read_fds.size() < sizes[s] ) {
+			int p[2];
+			if ( pipe( p ) < 0 ) {
+				break;
+			}
+			read_fds.push_back( p[0] );
+			write_fds.push_back( p[1] );
+		}
+		if ( (int)read_fds.size() < sizes[s] ) {
+			printf( "stopping at %d fds: %s\n", (int)read_fds.size(), strerror( errno ) );
+			break;
+		}
+
+			// the first num_ready pipes have a byte waiting
+		int ready = num_ready < sizes[s] ? num_ready : sizes[s];
+		for ( int i = 0; i < ready; i++ ) {
+			if ( write_fds[i] >= 0 ) {
+				if ( !write_byte( write_fds[i] ) ) {
+					return check_results();
+				}
+				close( write_fds[i] );
+				write_fds[i] = -1;
+			}
+		}
+
+		double select_usec = time_wakeups( false, read_fds, ready, iterations );
+		double epoll_usec = time_wakeups( true, read_fds, ready, iterations );
+		printf( "%8d %8d %14.1f %14.1f\n", sizes[s], ready, select_usec, epoll_usec );
+	}
+
+	for ( size_t i = 0; i < read_fds.size(); i++ ) {
+		close( read_fds[i] );
+		if ( write_fds[i] >= 0 ) {
+			close( write_fds[i] );
+		}
+	}
+
+	return check_results();
+}
@@ -0,0 +1,329 @@
+/***************************************************************
+ *
+ * Copyright (C) 2020, Condor Team, Computer Sciences Department,
+ * University of Wisconsin-Madison, WI.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you
+ * may not use this file except in compliance with the License.  You may
+ * obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ***************************************************************/
+
+// Tests for the heap of DaemonCore timers in the TimerManager.  Timers
+// are scheduled, reset and cancelled in a random order, on deadlines a
+// few steps apart so that many of them fall due at the same time, and
+// must then be called in the order of their deadlines, ties going to the
+// one that was scheduled first.  That is checked with no limit on the
+// timers called per Timeout(), where they are sorted, and with a limit
+// of one, where each comes off the top of the heap.  Also checks
+// ResetTimerMs() and TimeoutMs(), timers that cancel or reset themselves
+// or each other from their handlers, and that periodic timers go back
+// into the heap one period after they were called.
+
+#include "condor_common.h"
+#include "condor_debug.h"
+#include "condor_config.h"
+#include "condor_daemon_core.h"
+#include "test_check.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+// the labels of the timers in the order they were called
+static std::vector<int> fired;
+
+class TestTimer : public Service {
+ public:
+	TestTimer() : label(0), id(-1), cancel_id(-1), reset_id(-1), reset_ms(0) {}
+
+	void handler() {
+		fired.push_back( label );
+		if ( cancel_id >= 0 ) {
+			TimerManager::GetTimerManager().CancelTimer( cancel_id );
+		}
+		if ( reset_id >= 0 ) {
+			TimerManager::GetTimerManager().ResetTimerMs( reset_id, reset_ms );
+		}
+	}
+
+	int label;
+	int id;
+	int cancel_id; // the timer the handler cancels, -1 for none
+	int reset_id;  // the timer the handler resets, -1 for none
+	unsigned reset_ms;
+};
+
+static void
+set_max_timer_events( int max_events )
+{
+	std::string value = std::to_string( max_events );
+	param_insert( "MAX_TIMER_EVENTS_PER_CYCLE", value.c_str() );
+	TimerManager::GetTimerManager().reconfig();
+}
+
+// Calls Timeout() until no more timers are due, returns how many times
+// it was called.
+static int
+run_timeouts()
+{
+	int calls = 0;
+	int num_fired = 0;
+	do {
+		TimerManager::GetTimerManager().Timeout( &num_fired );
+		calls++;
+	} while ( num_fired > 0 );
+	return calls;
+}
+
+static std::string
+labels( const std::vector<int> &order )
+{
+	std::string str;
+	for ( size_t i = 0; i < order.size() && i < 20; ++i ) {
+		formatstr_cat( str, "%s%d", i ? " " : "", order[i] );
+	}
+	if ( order.size() > 20 ) {
+		str += " ...";
+	}
+	return str;
+}
+
+struct Scheduled {
+	int step;  // the deadline, in steps from now
+	int seq;   // when it was last (re)scheduled
+	int label;
+	bool operator<( const Scheduled &other ) const {
+		return step < other.step || ( step == other.step && seq < other.seq );
+	}
+};
+
+// Schedules, resets and cancels timers at random, none of them due
+// before the first step, then checks that they are called in the order
+// of their deadlines, and of when they were scheduled among those with
+// the same deadline.  The deadlines are STEP_MS apart, which is much
+// longer than it takes to schedule all of the timers, so the ones on the
+// same step differ only by the milliseconds that passed between
+// scheduling them, if at all.
+static void
+test_order( int max_events )
+{
+	const int STEP_MS = 40;
+	const int STEPS = 5;
+	const int NUM_TIMERS = 200;
+	TimerManager &tm = TimerManager::GetTimerManager();
+	set_max_timer_events( max_events );
+
+	srand( 42 + max_events );
+	std::vector<TestTimer> timers( NUM_TIMERS );
+	std::vector<Scheduled> scheduled( NUM_TIMERS );
+	std::vector<bool> cancelled( NUM_TIMERS, false );
+	int seq = 0;
+	for ( int i = 0; i < NUM_TIMERS; ++i ) {
+		int step = 1 + rand() % STEPS;
+		timers[i].label = i;
+		timers[i].id = tm.NewTimerMs( &timers[i], step * STEP_MS,
+			(TimerHandlercpp)&TestTimer::handler, "test_order" );
+		scheduled[i].step = step;
+		scheduled[i].seq = seq++;
+		scheduled[i].label = i;
+	}
+		// move timers that are already in the heap, both ways
+	for ( int n = 0; n < NUM_TIMERS / 2; ++n ) {
+		int i = rand() % NUM_TIMERS;
+		int step = 1 + rand() % STEPS;
+		tm.ResetTimerMs( timers[i].id, (unsigned)( step * STEP_MS ) );
+		scheduled[i].step = step;
+		scheduled[i].seq = seq++;
+	}
+	for ( int n = 0; n < NUM_TIMERS / 4; ++n ) {
+		int i = rand() % NUM_TIMERS;
+		if ( ! cancelled[i] ) {
+			tm.CancelTimer( timers[i].id );
+			cancelled[i] = true;
+		}
+	}
+
+	std::vector<Scheduled> expected_order;
+	for ( int i = 0; i < NUM_TIMERS; ++i ) {
+		if ( ! cancelled[i] ) {
+			expected_order.push_back( scheduled[i] );
+		}
+	}
+	std::sort( expected_order.begin(), expected_order.end() );
+	std::vector<int> expected;
+	for ( size_t i = 0; i < expected_order.size(); ++i ) {
+		expected.push_back( expected_order[i].label );
+	}
+
+		// none are due yet, so this calls none of them
+	int ms = tm.TimeoutMs();
+	usleep( ( STEPS + 1 ) * STEP_MS * 1000 );
+	fired.clear();
+	int calls = run_timeouts();
+
+	std::string name;
+	formatstr( name, "%d timers called in order, %s", (int)expected.size(),
+		max_events ? "one per Timeout()" : "all in one Timeout()" );
+	if ( fired != expected ) {
+		check_failed( "%s: called %s, expected %s", name.c_str(),
+			labels( fired ).c_str(), labels( expected ).c_str() );
+	} else if ( ms <= 0 || ms > STEP_MS ) {
+		check_failed( "%s: TimeoutMs() returned %d before any were due", name.c_str(), ms );
+	} else if ( max_events == 1 && calls != (int)expected.size() + 1 ) {
+		check_failed( "%s: %d calls to Timeout()", name.c_str(), calls );
+	} else {
+		check_passed( "%s", name.c_str() );
+	}
+	check( "no timers are left once they have all been called", tm.TimeoutMs() == -1 );
+	set_max_timer_events( 0 );
+}
+
+// ResetTimerMs() moves a timer that is in the heap, and TimeoutMs() says
+// when the first one is due.
+static void
+test_reset_ms()
+{
+	TimerManager &tm = TimerManager::GetTimerManager();
+	TestTimer a, b;
+	a.label = 1;
+	b.label = 2;
+	a.id = tm.NewTimer( &a, 100, (TimerHandlercpp)&TestTimer::handler, "test_reset_ms a" );
+	b.id = tm.NewTimer( &b, 200, (TimerHandlercpp)&TestTimer::handler, "test_reset_ms b" );
+	int first_ms = tm.TimeoutMs();
+	int first_s = tm.Timeout();
+
+	tm.ResetTimerMs( b.id, 50 );
+	int reset_ms = tm.TimeoutMs();
+	check( "TimeoutMs() and Timeout() give the first deadline, in ms and rounded up to seconds",
+	       first_ms > 99000 && first_ms <= 100000 && first_s == 100 );
+	check( "ResetTimerMs() moves a timer to the top of the heap", reset_ms > 0 && reset_ms <= 50 );
+	check( "GetNextRuntime() rounds up to the second",
+	       tm.GetNextRuntime( b.id ) >= time( NULL ) && tm.GetNextRuntime( b.id ) <= time( NULL ) + 1 );
+
+	fired.clear();
+	tm.Timeout();
+	bool early = ! fired.empty();
+	usleep( 60 * 1000 );
+	tm.Timeout();
+	check( "a timer reset to a deadline in ms is called then, and not before",
+	       ! early && fired.size() == 1 && fired[0] == 2 );
+	check( "a reset one-shot timer is gone once called", tm.GetNextRuntime( b.id ) == 0 );
+
+	tm.ResetTimerMs( a.id, TIMER_NEVER );
+	check( "a timer reset to TIMER_NEVER is never due", tm.TimeoutMs() == INT_MAX );
+	check( "resetting or cancelling a timer that is gone fails",
+	       tm.ResetTimerMs( b.id, 0 ) == -1 && tm.CancelTimer( b.id ) == -1 );
+	tm.CancelTimer( a.id );
+	check( "cancelling the last timer empties the heap", tm.TimeoutMs() == -1 );
+}
+
+// Handlers that cancel or reset themselves, or timers that are still in
+// the heap.
+static void
+test_handlers()
+{
+	TimerManager &tm = TimerManager::GetTimerManager();
+	TestTimer t[5];
+	for ( int i = 0; i < 5; ++i ) {
+		t[i].label = i;
+		t[i].id = tm.NewTimerMs( &t[i], 10 * i, (TimerHandlercpp)&TestTimer::handler,
+			"test_handlers", 1000 );
+	}
+	t[0].cancel_id = t[0].id;    // cancels itself
+	t[1].cancel_id = t[3].id;    // cancels a timer that is due after it
+	t[2].reset_id = t[2].id;     // resets itself, to after its period
+	t[2].reset_ms = 5000;
+	t[4].reset_id = t[4].id;     // resets itself, to now
+	t[4].reset_ms = 0;
+
+	usleep( 50 * 1000 );
+	fired.clear();
+	tm.Timeout();
+	std::vector<int> expected;
+	expected.push_back( 0 );
+	expected.push_back( 1 );
+	expected.push_back( 2 );
+	expected.push_back( 4 );
+	bool ok = fired == expected;
+	check( "a handler can cancel itself or a timer that is still to be called", ok &&
+	       tm.GetNextRuntime( t[0].id ) == 0 && tm.GetNextRuntime( t[3].id ) == 0 );
+	check( "a handler that resets its own periodic timer keeps the new deadline",
+	       tm.GetNextRuntime( t[2].id ) >= time( NULL ) + 4 );
+
+		// t[4] is due again, but was not due when Timeout() started
+	fired.clear();
+	tm.Timeout();
+	check( "a timer that resets itself to now is called in the next Timeout()",
+	       ok && fired.size() == 1 && fired[0] == 4 );
+
+	t[4].reset_id = -1;
+	tm.CancelTimer( t[1].id );
+	tm.CancelTimer( t[2].id );
+	tm.CancelTimer( t[4].id );
+	check( "all the timers are gone", tm.TimeoutMs() == -1 );
+}
+
+// A periodic timer goes back into the heap one period after it was
+// called, among one-shot timers that are due in between.
+static void
+test_periodic()
+{
+	TimerManager &tm = TimerManager::GetTimerManager();
+	TestTimer periodic, one_shot[3];
+	periodic.label = 100;
+	periodic.id = tm.NewTimerMs( &periodic, 0, (TimerHandlercpp)&TestTimer::handler,
+		"test_periodic", 100 );
+	for ( int i = 0; i < 3; ++i ) {
+		one_shot[i].label = i;
+		one_shot[i].id = tm.NewTimerMs( &one_shot[i], 50 + 100 * i,
+			(TimerHandlercpp)&TestTimer::handler, "test_periodic one-shot" );
+	}
+
+	fired.clear();
+	for ( int i = 0; i < 7; ++i ) {
+		tm.Timeout();
+		int ms = tm.TimeoutMs();
+		if ( ms > 0 ) {
+			usleep( ms * 1000 );
+		}
+	}
+	int expected[] = { 100, 0, 100, 1, 100, 2, 100 };
+	bool in_order = fired.size() == 7;
+	for ( size_t i = 0; in_order && i < fired.size(); ++i ) {
+		in_order = fired[i] == expected[i];
+	}
+	if ( in_order ) {
+		check_passed( "a periodic timer is called every period, between the one-shot timers" );
+	} else {
+		check_failed( "a periodic timer is called every period: called %s", labels( fired ).c_str() );
+	}
+	int next_ms = tm.TimeoutMs();
+	check( "the periodic timer is back in the heap after its last call",
+	       next_ms > 0 && next_ms <= 100 );
+	tm.CancelTimer( periodic.id );
+}
+
+int
+main( int /*argc*/, char ** /*argv*/ )
+{
+	config();
+		// Timeout() checks the priv state after each handler
+	daemonCore = new DaemonCore();
+
+	test_order( 0 );
+	test_order( 1 );
+	test_reset_ms();
+	test_handlers();
+	test_periodic();
+
+	return check_results();
+}
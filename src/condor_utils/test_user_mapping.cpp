@@ -122,6 +122,18 @@ char hash_canon[] =
 	"GSI \"/DC=com/DC=DigiCert-Grid/O=Open Science Grid/OU=People/CN=Jack Miller\" jmiller\n"
 	;
 
+char anchored_canon[] =
+	"TOKEN /^alice@example\\.org$/ alice\n"
+	"TOKEN /^bob@(.*)$/ bob_\\1\n"
+	"TOKEN /^bob@example\\.org$/ never\n"
+	"TOKEN /^(.*)@example\\.org$/ \\1_org\n"
+	"TOKEN /^carol/ \\0_pre\n"
+	"TOKEN /@test\\.com$/ tester\n"
+	"TOKEN /^dave@example\\.org$/i dave\n"
+	"TOKEN /^(.*)@example\\.com$/ \\1_com\n"
+	"TOKEN /^.*$/ nobody\n"
+	;
+
 void print_usage(FILE * out, MapFile * mf, double elapsed_time)
 {
 	MapFileUsage useage;
@@ -238,6 +250,96 @@ void testing_lookups(bool verbose, const char * mode)
 	}
 }
 
+// regexes that are anchored literals are matched by hash lookups rather than by pcre,
+// the results must be the same as if each regex was tried in turn.
+void testing_anchored(bool verbose)
+{
+#ifdef USE_MAPFILE_V2
+	if (verbose) {
+		fprintf( stdout, "\n----- testing_anchored ----\n\n");
+	}
+
+	delete gmf; gmf = NULL;
+	gmf = new MapFile;
+	MyStringCharSource src(anchored_canon, false);
+	REQUIRE(gmf->ParseCanonicalization(src, "anchored_canon", true) == 0);
+	if (verbose) {
+		print_usage(stdout, gmf, gelapsed_time);
+	}
+
+	double dstart = _condor_debug_get_time_double();
+	for (int pass = 0; pass < 2; ++pass) { // the second pass is answered from the lookup cache
+		REQUIRE( lookup("TOKEN", "alice@example.org") == "alice" );
+		REQUIRE( lookup("TOKEN", "bob@example.org") == "bob_example.org" );
+		REQUIRE( lookup("TOKEN", "eve@example.org") == "eve_org" );
+		REQUIRE( lookup("TOKEN", "carol@example.org") == "carol_org" );
+		REQUIRE( lookup("TOKEN", "carolyn@nowhere") == "carol_pre" );
+		REQUIRE( lookup("TOKEN", "zed@test.com") == "tester" );
+		REQUIRE( lookup("TOKEN", "DAVE@EXAMPLE.ORG") == "dave" );
+		REQUIRE( lookup("TOKEN", "fred@example.com") == "fred_com" );
+		REQUIRE( lookup("TOKEN", "fred@example.net") == "nobody" );
+		// $ matches before a trailing newline, and . does not match a newline, not even in the catch-all
+		REQUIRE( lookup("TOKEN", "alice@example.org\n") == "alice" );
+		REQUIRE( lookup("TOKEN", "bob@example\norg") == "" );
+		REQUIRE( lookup("GSI", "alice@example.org") == "" );
+	}
+
+	if (verbose) {
+		double elapsed_time = _condor_debug_get_time_double() - dstart;
+		fprintf(stdout, "    %.3f millisec\n", elapsed_time*1000);
+	}
+#else
+	if (verbose) {
+		fprintf( stdout, "\n----- testing_anchored (skipped for v1) ----\n\n");
+	}
+#endif
+}
+
+// time parsing a map of num_entries certificate DNs and looking up each of them,
+// once with regexes that are anchored literals, and once with regexes that can't be
+// matched that way because they are caseless.
+void bench_lookups(int num_entries)
+{
+	const char * modes[] = { "anchored", "caseless" };
+	for (int mode = 0; mode < 2; ++mode) {
+		MyString map;
+		for (int ii = 0; ii < num_entries; ++ii) {
+			map.formatstr_cat("GSI /^\\/DC=org\\/DC=bench\\/OU=People\\/CN=User %d$/%s user%d\n", ii, mode ? "i" : "", ii);
+		}
+		map += "GSI /.*/ nobody\n";
+
+		delete gmf; gmf = NULL;
+		gmf = new MapFile;
+		double dstart = _condor_debug_get_time_double();
+		MyStringCharSource src(map.detach_buffer(), true);
+		int rval = gmf->ParseCanonicalization(src, "bench", true);
+		double parse_time = _condor_debug_get_time_double() - dstart;
+		if (rval) {
+			fprintf(stderr, "bench map failed to parse: %d\n", rval);
+			++fail_count;
+			return;
+		}
+
+		std::string principal;
+		int cFailed = 0;
+		double lookup_time[2];
+		for (int pass = 0; pass < 2; ++pass) { // the second pass is answered from the lookup cache, if it is big enough
+			dstart = _condor_debug_get_time_double();
+			for (int ii = 0; ii < num_entries; ++ii) {
+				formatstr(principal, "/DC=org/DC=bench/OU=People/CN=User %d", ii);
+				gmstr.clear();
+				if ( ! gmf->GetCanonicalization("GSI", principal.c_str(), gmstr)) { ++cFailed; }
+			}
+			lookup_time[pass] = _condor_debug_get_time_double() - dstart;
+		}
+		fprintf(stdout, "%s: %d entries, parse %.3f ms, %d lookups %.3f ms, repeated %.3f ms, %d failed\n",
+			modes[mode], num_entries, parse_time*1000, num_entries, lookup_time[0]*1000, lookup_time[1]*1000, cFailed);
+		if (dash_verbose) {
+			print_usage(stdout, gmf, parse_time);
+		}
+	}
+}
+
 int read_mapfile(const char * mapfile, bool assume_hash, const char * lookup_method, const char * user)
 {
 	int rval = 0;
@@ -417,6 +519,7 @@ void Usage(const char * appname, FILE * out)
 		"    -help\tPrint this message\n"
 		"    -verbose\tMore verbose output\n\n"
 		"  <tests> is one or more letters choosing specific subtests\n"
+		"    a  anchored regex lookup tests\n"
 		"    l  lookup tests\n"
 		"    p  parse tests\n"
 		"  If no arguments are given (or just -verbose) all tests are run.\n"
@@ -437,12 +540,14 @@ void Usage(const char * appname, FILE * out)
 		"    -timelist <file>\t Map each line from <file> against <mapfile> or <gridfile>\n"
 		"                         and report total time spent doing the mapping. This option does\n"
 		"                         not print the results, it is just a timing test\n"
+		"    -bench <num>\t Time parsing a map of <num> certificate DNs and looking up each of them\n"
 		, appname);
 }
 
 // runs all of the tests in non-verbose mode by default (i.e. printing only failures)
 // individual groups of tests can be run by using the -t:<tests> option where <tests>
 // is one or more of 
+//   a   testing_anchored
 //   l   testing_lookups
 //   P   testing_parser  config/submit/metaknob parser.
 //
@@ -458,6 +563,7 @@ int main( int /*argc*/, const char ** argv) {
 	const char * userfile = NULL;
 	const char * user = NULL;
 	const char * lookup_method = NULL;
+	int bench_entries = 0;
 
 	// if we don't init dprintf, calls to it will be will be malloc'ed and stored
 	// for later. this form of init will match the fewest possible issues.
@@ -478,6 +584,7 @@ int main( int /*argc*/, const char ** argv) {
 					switch (*pcolon) {
 					case 'l': test_flags |= 0x0011; break; // lookup
 					case 'p': test_flags |= 0x0022; break; // parse
+					case 'a': test_flags |= 0x0100; break; // anchored
 					}
 				}
 			} else {
@@ -525,6 +632,15 @@ int main( int /*argc*/, const char ** argv) {
 				fprintf(stderr, "-method requires a method argument\n");
 				return 1;
 			}
+		} else if (is_dash_arg_prefix(arg, "bench", 2)) {
+			const char * num = argv[ii+1];
+			if (num && (bench_entries = atoi(num)) > 0) {
+				++ii;
+			} else {
+				fprintf(stderr, "-bench requires a number of entries argument\n");
+				return 1;
+			}
+			other_arg = true;
 		} else if (is_dash_arg_prefix(arg, "hash", 2)) {
 			assume_hash = true;
 		} else {
@@ -539,6 +655,11 @@ int main( int /*argc*/, const char ** argv) {
 	if (test_flags & 0x0002) testing_lookups(dash_verbose, "regex");
 	if (test_flags & 0x0010) testing_parser(dash_verbose, "hash");
 	if (test_flags & 0x0020) testing_lookups(dash_verbose, "hash");
+	if (test_flags & 0x0100) testing_anchored(dash_verbose);
+
+	if (bench_entries) {
+		bench_lookups(bench_entries);
+	}
 
 	if (mapfile) {
 		int rval = read_mapfile(mapfile, assume_hash, lookup_method, user);